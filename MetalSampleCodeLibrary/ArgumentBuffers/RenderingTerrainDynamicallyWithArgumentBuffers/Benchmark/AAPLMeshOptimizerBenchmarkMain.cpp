@@ -0,0 +1,286 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that measures how many vertices a simulated post-transform cache
+ transforms, how much a view-independent rasterizer overdraws, and how many bytes vertex
+ fetches read, before and after each pass of the mesh optimizer.
+*/
+#include "../Renderer/AAPLMeshOptimizer.h"
+#include "../Renderer/AAPLObjFile.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --size N             Rows of the generated meshes (default 128)\n"
+            "  --obj PATH           Optimize this OBJ file instead of the generated meshes\n"
+            "  --caches LIST        Comma separated FIFO cache sizes to simulate (default 16,32)\n"
+            "  --threshold T        Overdraw threshold (default 1.05)\n",
+            program);
+}
+
+std::vector<uint32_t> parseList(const char* list)
+{
+    std::vector<uint32_t> values;
+    for (const char* p = list; p; )
+    {
+        values.push_back((uint32_t)atoi(p));
+        p = strchr(p, ',');
+        if (p)
+            ++p;
+    }
+    return values;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+struct Mesh
+{
+    std::string                     name;
+    std::vector<AAPLObjFileVertex>  vertices;
+    std::vector<uint32_t>           indices;
+};
+
+// Builds a grid of rows x columns quads in scanline order, with the vertices of each row
+//  before the next, and wraps it onto a surface.
+template <typename Surface>
+Mesh makeGrid(const char* name, uint32_t rows, uint32_t columns, Surface surface)
+{
+    Mesh mesh;
+    mesh.name = name;
+
+    for (uint32_t y = 0; y <= rows; ++y)
+    {
+        for (uint32_t x = 0; x <= columns; ++x)
+        {
+            AAPLObjFileVertex vertex = {};
+            vertex.texcoord[0] = (float)x / columns;
+            vertex.texcoord[1] = (float)y / rows;
+            surface(vertex.texcoord[0], vertex.texcoord[1], vertex.position, vertex.normal);
+            mesh.vertices.push_back(vertex);
+        }
+    }
+
+    for (uint32_t y = 0; y < rows; ++y)
+    {
+        for (uint32_t x = 0; x < columns; ++x)
+        {
+            const uint32_t a = y * (columns + 1) + x, b = a + 1, c = a + columns + 1, d = c + 1;
+            mesh.indices.insert(mesh.indices.end(), { a, b, c, b, d, c });
+        }
+    }
+    return mesh;
+}
+
+// Returns the mesh with its triangles and vertices in random order, as a tool that doesn't
+//  care about order might write them.
+Mesh shuffle(const Mesh& source, const char* name)
+{
+    Mesh mesh;
+    mesh.name = name;
+
+    std::mt19937 random(1);
+    std::vector<uint32_t> remap(source.vertices.size());
+    for (size_t v = 0; v < remap.size(); ++v)
+        remap[v] = (uint32_t)v;
+    std::shuffle(remap.begin(), remap.end(), random);
+
+    mesh.vertices.resize(source.vertices.size());
+    AAPLMeshRemapVertices(mesh.vertices.data(), source.vertices.data(), source.vertices.size(),
+                          sizeof(AAPLObjFileVertex), remap.data());
+
+    std::vector<uint32_t> triangles(source.indices.size() / 3);
+    for (size_t t = 0; t < triangles.size(); ++t)
+        triangles[t] = (uint32_t)t;
+    std::shuffle(triangles.begin(), triangles.end(), random);
+
+    for (uint32_t t : triangles)
+    {
+        for (int corner = 0; corner < 3; ++corner)
+            mesh.indices.push_back(remap[source.indices[t * 3 + corner]]);
+    }
+    return mesh;
+}
+
+std::vector<Mesh> makeMeshes(uint32_t size)
+{
+    std::vector<Mesh> meshes;
+
+    meshes.push_back(makeGrid("plane", size, size, [](float u, float v, float* position, float* normal)
+    {
+        position[0] = u * 2.0f - 1.0f;
+        position[1] = 0.1f * sinf(u * 17.0f) * cosf(v * 13.0f);
+        position[2] = v * 2.0f - 1.0f;
+        normal[0] = 0.0f;
+        normal[1] = 1.0f;
+        normal[2] = 0.0f;
+    }));
+
+    meshes.push_back(makeGrid("sphere", size, size * 2, [](float u, float v, float* position, float* normal)
+    {
+        const float theta = (float)M_PI * v, phi = 2.0f * (float)M_PI * u;
+        normal[0] = sinf(theta) * cosf(phi);
+        normal[1] = cosf(theta);
+        normal[2] = -sinf(theta) * sinf(phi);
+        memcpy(position, normal, sizeof(float) * 3);
+    }));
+
+    // A torus whose tube swells and narrows, so that parts of it hide others from most views.
+    meshes.push_back(makeGrid("torus", size, size * 2, [](float u, float v, float* position, float* normal)
+    {
+        const float ring = 2.0f * (float)M_PI * v, tube = 2.0f * (float)M_PI * u;
+        const float radius = 0.35f + 0.1f * sinf(5.0f * ring);
+        normal[0] = cosf(tube) * cosf(ring);
+        normal[1] = sinf(tube);
+        normal[2] = cosf(tube) * sinf(ring);
+        position[0] = cosf(ring) + radius * normal[0];
+        position[1] = radius * normal[1];
+        position[2] = sinf(ring) + radius * normal[2];
+    }));
+
+    meshes.push_back(shuffle(meshes.back(), "shuffled torus"));
+    return meshes;
+}
+
+void printStatistics(const char* step, const Mesh& mesh, const std::vector<uint32_t>& cacheSizes, double time)
+{
+    const size_t vertexCount = mesh.vertices.size();
+    const float* positions = mesh.vertices[0].position;
+
+    printf("  %-16s", step);
+    for (uint32_t cacheSize : cacheSizes)
+    {
+        const AAPLVertexCacheStatistics cache = AAPLMeshAnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(),
+                                                                           vertexCount, cacheSize);
+        printf("  %6.3f %6.3f", cache.acmr, cache.atvr);
+    }
+
+    const AAPLOverdrawStatistics overdraw = AAPLMeshAnalyzeOverdraw(mesh.indices.data(), mesh.indices.size(), positions,
+                                                                    vertexCount, sizeof(AAPLObjFileVertex));
+    const AAPLVertexFetchStatistics fetch = AAPLMeshAnalyzeVertexFetch(mesh.indices.data(), mesh.indices.size(),
+                                                                       vertexCount, sizeof(AAPLObjFileVertex));
+    printf("  %8.3f %9.3f", overdraw.overdraw, fetch.overfetch);
+    if (time > 0.0)
+        printf("  %8.2f ms", time * 1000.0);
+    printf("\n");
+}
+
+void optimize(Mesh& mesh, const std::vector<uint32_t>& cacheSizes, float threshold)
+{
+    const size_t vertexCount = mesh.vertices.size();
+    const size_t indexCount = mesh.indices.size();
+    const float* positions = mesh.vertices[0].position;
+
+    printf("%s: %zu vertices, %zu triangles\n", mesh.name.c_str(), vertexCount, indexCount / 3);
+    printf("  %-16s", "");
+    for (uint32_t cacheSize : cacheSizes)
+        printf("  ACMR%-3u ATVR%-2u", cacheSize, cacheSize);
+    printf("  overdraw overfetch\n");
+
+    printStatistics("original", mesh, cacheSizes, 0.0);
+
+    auto begin = std::chrono::steady_clock::now();
+    AAPLMeshOptimizeVertexCache(mesh.indices.data(), mesh.indices.data(), indexCount, vertexCount);
+    printStatistics("vertex cache", mesh, cacheSizes, seconds(begin));
+
+    begin = std::chrono::steady_clock::now();
+    AAPLMeshOptimizeOverdraw(mesh.indices.data(), mesh.indices.data(), indexCount,
+                             positions, vertexCount, sizeof(AAPLObjFileVertex), threshold);
+    printStatistics("overdraw", mesh, cacheSizes, seconds(begin));
+
+    begin = std::chrono::steady_clock::now();
+    std::vector<uint32_t> remap(vertexCount);
+    AAPLMeshOptimizeVertexFetchRemap(remap.data(), mesh.indices.data(), indexCount, vertexCount);
+    AAPLMeshRemapIndices(mesh.indices.data(), mesh.indices.data(), indexCount, remap.data());
+    std::vector<AAPLObjFileVertex> vertices(vertexCount);
+    AAPLMeshRemapVertices(vertices.data(), mesh.vertices.data(), vertexCount, sizeof(AAPLObjFileVertex), remap.data());
+    mesh.vertices.swap(vertices);
+    printStatistics("vertex fetch", mesh, cacheSizes, seconds(begin));
+    printf("\n");
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    uint32_t size = 128;
+    const char* objPath = nullptr;
+    std::vector<uint32_t> cacheSizes = { 16, 32 };
+    float threshold = AAPLMeshDefaultOverdrawThreshold;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--size") && i + 1 < argc)
+            size = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--obj") && i + 1 < argc)
+            objPath = argv[++i];
+        else if (!strcmp(argv[i], "--caches") && i + 1 < argc)
+            cacheSizes = parseList(argv[++i]);
+        else if (!strcmp(argv[i], "--threshold") && i + 1 < argc)
+            threshold = (float)atof(argv[++i]);
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (size == 0 || threshold < 1.0f || cacheSizes.empty() ||
+        std::find(cacheSizes.begin(), cacheSizes.end(), 0u) != cacheSizes.end())
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<Mesh> meshes;
+    if (objPath)
+    {
+        AAPLObjFile file;
+        std::string error;
+        if (!file.open(objPath, 0, error))
+        {
+            fprintf(stderr, "Failed to load %s: %s\n", objPath, error.c_str());
+            return 1;
+        }
+
+        Mesh mesh;
+        mesh.name = objPath;
+        mesh.vertices = file.vertices();
+        mesh.indices = file.indices();
+        meshes.push_back(std::move(mesh));
+    }
+    else
+    {
+        meshes = makeMeshes(size);
+    }
+
+    for (Mesh& mesh : meshes)
+    {
+        if (mesh.indices.empty())
+        {
+            printf("%s: no triangles\n", mesh.name.c_str());
+            continue;
+        }
+        optimize(mesh, cacheSizes, threshold);
+    }
+
+    return 0;
+}
@@ -0,0 +1,346 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that measures how fast the OBJ reader loads a large generated OBJ file,
+ against reading it line by line with sscanf and a std::unordered_map, as the sample did.
+*/
+#include "../Renderer/AAPLObjFile.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --size MB            Size of the generated file (default 100)\n"
+            "  --obj PATH           Read this OBJ file instead of generating one\n"
+            "  --threads LIST       Comma separated thread counts, 0 for one per core (default 1,2,4,0)\n"
+            "  --runs N             Loads with each thread count, keeping the fastest (default 3)\n"
+            "  --file PATH          Where to write the generated file (default a temporary file)\n",
+            program);
+}
+
+std::vector<uint32_t> parseList(const char* list)
+{
+    std::vector<uint32_t> values;
+    for (const char* p = list; p; )
+    {
+        values.push_back((uint32_t)atoi(p));
+        p = strchr(p, ',');
+        if (p)
+            ++p;
+    }
+    return values;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Writes a wavy grid of quads with positions, texture coordinates and normals, and switches
+//  between four materials every few rows, until the file reaches about `size` bytes.
+bool writeOBJ(const char* path, size_t size)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    // Each cell of the grid takes about 160 bytes.
+    const uint32_t cells = (uint32_t)sqrt((double)size / 160.0);
+    const uint32_t columns = cells + 1;
+
+    fprintf(file, "# Generated by AAPLObjBenchmarkMain\no grid\n");
+    for (uint32_t y = 0; y <= cells; ++y)
+    {
+        for (uint32_t x = 0; x <= cells; ++x)
+        {
+            const float u = (float)x / cells, v = (float)y / cells;
+            const float height = 0.25f * sinf(u * 37.0f) * cosf(v * 23.0f);
+            fprintf(file, "v %.6f %.6f %.6f\n", u * 100.0f - 50.0f, height, v * 100.0f - 50.0f);
+            fprintf(file, "vt %.6f %.6f\n", u, v);
+            fprintf(file, "vn %.6f %.6f %.6f\n", -height * 0.3f, 0.953939f, height * 0.1f);
+        }
+    }
+
+    for (uint32_t y = 0; y < cells; ++y)
+    {
+        if (y % 16 == 0)
+            fprintf(file, "usemtl material%u\n", (y / 16) % 4);
+
+        for (uint32_t x = 0; x < cells; ++x)
+        {
+            const uint32_t i = y * columns + x + 1;
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n",
+                    i, i, i, i + 1, i + 1, i + 1, i + columns + 1, i + columns + 1, i + columns + 1,
+                    i + columns, i + columns, i + columns);
+        }
+    }
+
+    const bool failed = ferror(file);
+    fclose(file);
+    return !failed;
+}
+
+struct BaselineVertex
+{
+    float   position[3];
+    float   normal[3];
+    float   texcoord[3];
+
+    bool operator==(const BaselineVertex& other) const
+    {
+        return !memcmp(this, &other, sizeof(*this));
+    }
+};
+
+struct BaselineVertexHash
+{
+    size_t operator()(const BaselineVertex& vertex) const
+    {
+        size_t hash = 0;
+        const uint32_t* words = (const uint32_t*)&vertex;
+        for (size_t w = 0; w < sizeof(vertex) / sizeof(uint32_t); ++w)
+            hash = hash * 31 + words[w];
+        return hash;
+    }
+};
+
+// Reads the file as the sample's loaders did: a line at a time, `sscanf` for each kind of line,
+//  and a `std::unordered_map` from vertex values to indices.  Only reads triangles and quads
+//  of `v/vt/vn` corners, which is what the generated file has.
+bool loadBaseline(const char* path, std::vector<BaselineVertex>& vertices, std::vector<uint32_t>& indices)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    std::vector<float> positions, normals, texcoords;
+    std::unordered_map<BaselineVertex, uint32_t, BaselineVertexHash> vertexMap;
+    char line[1024];
+    while (fgets(line, sizeof(line), file))
+    {
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        uint32_t iv[4], ivt[4], ivn[4];
+        int count;
+
+        if (sscanf(line, " v %f %f %f", &x, &y, &z) == 3)
+            positions.insert(positions.end(), { x, y, z });
+        else if (sscanf(line, " vt %f %f %f", &x, &y, &z) >= 2)
+            texcoords.insert(texcoords.end(), { x, y, z });
+        else if (sscanf(line, " vn %f %f %f", &x, &y, &z) == 3)
+            normals.insert(normals.end(), { x, y, z });
+        else if ((count = sscanf(line, " f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u",
+                                 &iv[0], &ivt[0], &ivn[0], &iv[1], &ivt[1], &ivn[1],
+                                 &iv[2], &ivt[2], &ivn[2], &iv[3], &ivt[3], &ivn[3])) >= 9)
+        {
+            uint32_t corners[4];
+            for (int c = 0; c < count / 3; ++c)
+            {
+                BaselineVertex vertex;
+                memcpy(vertex.position, &positions[(iv[c] - 1) * 3], sizeof(vertex.position));
+                memcpy(vertex.normal, &normals[(ivn[c] - 1) * 3], sizeof(vertex.normal));
+                memcpy(vertex.texcoord, &texcoords[(ivt[c] - 1) * 3], sizeof(vertex.texcoord));
+
+                auto found = vertexMap.emplace(vertex, (uint32_t)vertices.size());
+                if (found.second)
+                    vertices.push_back(vertex);
+                corners[c] = found.first->second;
+            }
+
+            indices.insert(indices.end(), { corners[0], corners[1], corners[2] });
+            if (count == 12)
+                indices.insert(indices.end(), { corners[0], corners[2], corners[3] });
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Hashes the values of a triangle's vertices, whose layouts match.
+template <typename Vertex>
+uint64_t hashTriangle(const Vertex* a, const Vertex* b, const Vertex* c)
+{
+    static_assert(sizeof(Vertex) == 9 * sizeof(float), "The vertices must have the same layout");
+
+    uint64_t hash = 14695981039346656037ull;
+    for (const Vertex* vertex : { a, b, c })
+    {
+        const uint8_t* bytes = (const uint8_t*)vertex;
+        for (size_t i = 0; i < sizeof(Vertex); ++i)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t size = 100;
+    const char* objPath = nullptr;
+    std::vector<uint32_t> threadCounts = { 1, 2, 4, 0 };
+    uint32_t runs = 3;
+    std::string path;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(arg, "--size") && hasValue)
+            size = (size_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--obj") && hasValue)
+            objPath = argv[++i];
+        else if (!strcmp(arg, "--threads") && hasValue)
+            threadCounts = parseList(argv[++i]);
+        else if (!strcmp(arg, "--runs") && hasValue)
+            runs = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--file") && hasValue)
+            path = argv[++i];
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (size == 0 || runs == 0 || threadCounts.empty())
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    bool removeFile = false;
+    if (objPath)
+    {
+        path = objPath;
+    }
+    else
+    {
+        if (path.empty())
+        {
+            char temporaryPath[] = "/tmp/AAPLObjBenchmarkXXXXXX";
+            const int file = mkstemp(temporaryPath);
+            if (file < 0)
+            {
+                fprintf(stderr, "Couldn't create a temporary file\n");
+                return 1;
+            }
+            close(file);
+            path = temporaryPath;
+            removeFile = true;
+        }
+
+        if (!writeOBJ(path.c_str(), size << 20))
+        {
+            fprintf(stderr, "Couldn't write %s\n", path.c_str());
+            return 1;
+        }
+    }
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Couldn't open %s\n", path.c_str());
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    const double megabytes = ftell(file) / (1024.0 * 1024.0);
+    fclose(file);
+
+    printf("%s: %.1f MB\n\n", path.c_str(), megabytes);
+    printf("%-24s %10s %10s %10s %10s %6s\n", "loader", "ms", "MB/s", "vertices", "indices", "index");
+
+    // The baseline only reads the corners that the generated file uses.
+    std::vector<BaselineVertex> baselineVertices;
+    std::vector<uint32_t> baselineIndices;
+    std::vector<uint64_t> baselineHashes;
+    if (!objPath)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        loadBaseline(path.c_str(), baselineVertices, baselineIndices);
+        const double time = seconds(begin);
+        printf("%-24s %10.1f %10.1f %10zu %10zu %6s\n", "sscanf, unordered_map", time * 1000.0, megabytes / time,
+               baselineVertices.size(), baselineIndices.size(), "4");
+
+        for (size_t i = 0; i < baselineIndices.size(); i += 3)
+        {
+            baselineHashes.push_back(hashTriangle(&baselineVertices[baselineIndices[i]],
+                                                  &baselineVertices[baselineIndices[i + 1]],
+                                                  &baselineVertices[baselineIndices[i + 2]]));
+        }
+        std::sort(baselineHashes.begin(), baselineHashes.end());
+    }
+
+    bool passed = true;
+    std::vector<uint32_t> firstIndices;
+    for (uint32_t threadCount : threadCounts)
+    {
+        AAPLObjFile objFile;
+        double bestTime = INFINITY;
+        for (uint32_t run = 0; run < runs; ++run)
+        {
+            std::string error;
+            auto begin = std::chrono::steady_clock::now();
+            if (!objFile.open(path.c_str(), threadCount, error))
+            {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+            bestTime = std::min(bestTime, seconds(begin));
+        }
+
+        const std::string name = "AAPLObjFile, " + (threadCount ? std::to_string(threadCount) : std::string("all")) +
+                                 (threadCount == 1 ? " thread" : " threads");
+        printf("%-24s %10.1f %10.1f %10zu %10zu %6zu\n", name.c_str(), bestTime * 1000.0, megabytes / bestTime,
+               objFile.vertices().size(), objFile.indices().size(), objFile.indexSize());
+
+        // Every thread count must build the same mesh.
+        if (firstIndices.empty())
+            firstIndices = objFile.indices();
+        else if (firstIndices != objFile.indices())
+            passed = false;
+
+        // The triangles must have the same vertices as the baseline's, although the reader
+        //  groups them by material rather than keeping them in file order.
+        if (!baselineIndices.empty())
+        {
+            std::vector<uint64_t> hashes;
+            for (size_t i = 0; i < objFile.indices().size(); i += 3)
+            {
+                const AAPLObjFileVertex* vertices = objFile.vertices().data();
+                const uint32_t* triangle = &objFile.indices()[i];
+                hashes.push_back(hashTriangle(&vertices[triangle[0]], &vertices[triangle[1]], &vertices[triangle[2]]));
+            }
+
+            std::sort(hashes.begin(), hashes.end());
+            passed &= hashes == baselineHashes;
+        }
+    }
+
+    if (removeFile)
+        unlink(path.c_str());
+
+    if (!passed)
+    {
+        fprintf(stderr, "The loaders disagree\n");
+        return 1;
+    }
+    return 0;
+}
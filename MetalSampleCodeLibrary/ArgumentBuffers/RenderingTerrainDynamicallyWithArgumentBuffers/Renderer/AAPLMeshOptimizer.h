@@ -0,0 +1,91 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the mesh optimizer, which reorders the triangles and vertices of indexed triangle
+ lists so that the GPU transforms, shades and fetches less, and measures how well it did.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// How much the triangles that a view-independent overdraw order may cost in extra vertex
+//  transforms, relative to the vertex cache order: 1.05 allows 5% more.
+static const float AAPLMeshDefaultOverdrawThreshold = 1.05f;
+
+// A simulated FIFO post-transform vertex cache's results for a list of triangles.
+struct AAPLVertexCacheStatistics
+{
+    uint32_t    transformedVertexCount;
+    float       acmr;       // Transformed vertices per triangle: 3 at worst, about 0.5 for large grids.
+    float       atvr;       // Transformed vertices per vertex: 1 at best.
+};
+
+// Fragments that pass the depth test, against the pixels the mesh covers, summed over views
+//  from both ends of each axis.
+struct AAPLOverdrawStatistics
+{
+    uint64_t    coveredPixelCount;
+    uint64_t    shadedPixelCount;
+    float       overdraw;   // Shaded pixels per covered pixel: 1 at best.
+};
+
+// Bytes that vertex fetches read through a simulated 16 KB cache of 64-byte lines.
+struct AAPLVertexFetchStatistics
+{
+    uint64_t    bytesFetched;
+    float       overfetch;  // Bytes fetched per byte of vertex data: 1 at best.
+};
+
+// Reorders triangles so that consecutive triangles share vertices, following Tom Forsyth's
+//  linear-speed vertex cache optimization.  `destination` may be `indices`.
+void AAPLMeshOptimizeVertexCache(uint16_t* destination, const uint16_t* indices, size_t indexCount, size_t vertexCount);
+void AAPLMeshOptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Reorders triangles that `AAPLMeshOptimizeVertexCache` ordered so that, from most views,
+//  those facing away from the middle of the mesh draw first and hide the ones behind them.
+//  It splits the triangles into clusters where a vertex cache would restart anyway, or where
+//  restarting costs at most `threshold` times more transforms, and sorts the clusters.
+//  `positions` are three floats, `positionStride` bytes apart.  `destination` may be `indices`.
+void AAPLMeshOptimizeOverdraw(uint16_t* destination, const uint16_t* indices, size_t indexCount,
+                              const float* positions, size_t vertexCount, size_t positionStride, float threshold);
+void AAPLMeshOptimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+                              const float* positions, size_t vertexCount, size_t positionStride, float threshold);
+
+// Fills `remap` with each vertex's new index, so that vertices come in the order the triangles
+//  first use them, followed by the vertices they don't use in their original order.  Returns
+//  the number of vertices the triangles use.
+size_t AAPLMeshOptimizeVertexFetchRemap(uint32_t* remap, const uint16_t* indices, size_t indexCount, size_t vertexCount);
+size_t AAPLMeshOptimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Applies a remap to indices, and to vertices of `vertexSize` bytes.  `destination` may be
+//  `indices`, but not `vertices`.
+void AAPLMeshRemapIndices(uint16_t* destination, const uint16_t* indices, size_t indexCount, const uint32_t* remap);
+void AAPLMeshRemapIndices(uint32_t* destination, const uint32_t* indices, size_t indexCount, const uint32_t* remap);
+void AAPLMeshRemapVertices(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize,
+                           const uint32_t* remap);
+
+// Runs all three optimizations on a triangle list with interleaved vertices of `vertexSize`
+//  bytes, whose positions are three floats at `positionOffset`, in place.
+void AAPLMeshOptimize(uint16_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize,
+                      size_t positionOffset);
+void AAPLMeshOptimize(uint32_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize,
+                      size_t positionOffset);
+
+AAPLVertexCacheStatistics AAPLMeshAnalyzeVertexCache(const uint16_t* indices, size_t indexCount, size_t vertexCount,
+                                                     uint32_t cacheSize);
+AAPLVertexCacheStatistics AAPLMeshAnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                                     uint32_t cacheSize);
+
+// Rasterizes the mesh, fit to a 256x256 grid, from both ends of each axis, drawing the triangles
+//  that face the viewer with counterclockwise winding in order, with a depth test.
+AAPLOverdrawStatistics AAPLMeshAnalyzeOverdraw(const uint16_t* indices, size_t indexCount,
+                                               const float* positions, size_t vertexCount, size_t positionStride);
+AAPLOverdrawStatistics AAPLMeshAnalyzeOverdraw(const uint32_t* indices, size_t indexCount,
+                                               const float* positions, size_t vertexCount, size_t positionStride);
+
+AAPLVertexFetchStatistics AAPLMeshAnalyzeVertexFetch(const uint16_t* indices, size_t indexCount, size_t vertexCount,
+                                                     size_t vertexSize);
+AAPLVertexFetchStatistics AAPLMeshAnalyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                                     size_t vertexSize);
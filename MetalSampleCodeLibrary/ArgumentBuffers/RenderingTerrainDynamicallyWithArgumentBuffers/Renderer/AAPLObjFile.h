@@ -0,0 +1,99 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the OBJ reader, which maps OBJ files, parses them on several threads and
+ builds indexed meshes with the materials of their MTL files.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// A vertex made of one position, normal and texture coordinate of the file.  Attributes the
+//  file doesn't give a face are zero.  Texture coordinates keep their third component, which
+//  some files use for colors.
+struct AAPLObjFileVertex
+{
+    float   position[3];
+    float   normal[3];
+    float   texcoord[3];
+};
+
+// The settings of a `newmtl` block of an MTL file that the samples use.
+struct AAPLObjMaterial
+{
+    std::string name;
+    float       diffuseColor[3];    // Kd, or white if the block doesn't set it.
+    std::string diffuseMap;         // map_Kd, relative to the MTL file, or empty.
+};
+
+// The triangles of the file that use one material, as a range of the indices.
+struct AAPLObjSubmesh
+{
+    uint32_t    material;
+    uint32_t    firstIndex;
+    uint32_t    indexCount;
+};
+
+// Reads the positions, normals, texture coordinates and polygons of an OBJ file, and the
+//  materials of the MTL files it names.
+//
+// The reader splits the file into chunks that end at line boundaries and parses them on
+//  several threads.  It turns polygons into triangle fans and keeps one vertex for each
+//  combination of position, normal and texture coordinate indices, in the order that faces
+//  first use them.  It groups the triangles into a submesh for each material, in the order
+//  of the materials' first triangles; triangles before any `usemtl` line use a material with
+//  an empty name.  The results don't depend on the number of threads.
+class AAPLObjFile
+{
+public:
+    // Most vertices that 16-bit indices can address.
+    static const uint32_t Max16BitVertexCount = 1u << 16;
+
+    // Maps the file at `path` and parses it, reading MTL files from the same directory.  With
+    //  a thread count of 0, it parses on one thread per core.
+    bool open(const char* path, unsigned threadCount, std::string& error);
+
+    // Parses a file already in memory.  Reads MTL files from `materialDirectory`, or ignores
+    //  `mtllib` lines without one.
+    bool parse(const char* data, size_t size, const char* materialDirectory, unsigned threadCount,
+               std::string& error);
+
+    // Forgets the mesh.
+    void clear();
+
+    const std::vector<AAPLObjFileVertex>&   vertices() const    { return _vertices; }
+    const std::vector<uint32_t>&            indices() const     { return _indices; }
+    const std::vector<AAPLObjMaterial>&     materials() const   { return _materials; }
+    const std::vector<AAPLObjSubmesh>&      submeshes() const   { return _submeshes; }
+
+    // The smallest index size, in bytes, that holds every index: 2 if the mesh has at most
+    //  `Max16BitVertexCount` vertices, or 4.
+    size_t indexSize() const;
+
+    // Copies `count` indices from `first` with indices of `indexSize` bytes, 2 or 4.
+    void copyIndices(void* destination, size_t indexSize, uint32_t first, uint32_t count) const;
+
+    // Counts of the file's attributes and faces, before building vertices.
+    size_t positionCount() const    { return _positionCount; }
+    size_t normalCount() const      { return _normalCount; }
+    size_t texcoordCount() const    { return _texcoordCount; }
+    size_t faceCount() const        { return _faceCount; }
+
+private:
+    bool parseMaterialFile(const std::string& path, std::string& error);
+
+    std::vector<AAPLObjFileVertex>  _vertices;
+    std::vector<uint32_t>           _indices;
+    std::vector<AAPLObjMaterial>    _materials;
+    std::vector<AAPLObjSubmesh>     _submeshes;
+
+    size_t                          _positionCount  = 0;
+    size_t                          _normalCount    = 0;
+    size_t                          _texcoordCount  = 0;
+    size_t                          _faceCount      = 0;
+};
@@ -8,23 +8,9 @@ Declaration of the AAPLObjLoader.
 
 #import <Foundation/Foundation.h>
 #import <simd/simd.h>
-#import <vector>
-#import <unordered_map>
 #import <Metal/Metal.h>
 #import "AAPLMainRenderer_shared.h"
 
-// Hash function definition for the std::hash protocol to handle our ObjVertex as a hash key
-template<> struct std::hash<AAPLObjVertex>
-{
-    std::size_t operator()(const AAPLObjVertex& k) const
-    {
-        std::size_t hash = 0;
-        for (uint w = 0; w < sizeof(AAPLObjVertex) / sizeof(std::size_t); w++)
-            hash ^= (((std::size_t*)&k)[w] ^ (hash << 8) ^ (hash >> 8));
-        return hash;
-    }
-};
-
 // A simple class containing our standardized OBJ geometry
 @interface AAPLObjMesh : NSObject
 
@@ -32,12 +18,16 @@ template<> struct std::hash<AAPLObjVertex>
 @property id <MTLBuffer> vertexBuffer;
 @property id <MTLBuffer> indexBuffer;
 
+// 16-bit indices when the mesh has few enough vertices, or 32-bit ones
+@property MTLIndexType   indexType;
+
 - (NSUInteger)indexCount;
 - (NSUInteger)vertexCount;
 
 @end
 
-// A small OBJ file loader that generates AAPLObjMesh objects for further use
+// A small OBJ file loader that generates AAPLObjMesh objects for further use, reading files
+//  with AAPLObjFile
 @interface AAPLObjLoader : NSObject
 
 - (instancetype)initWithDevice:(id <MTLDevice>)device;
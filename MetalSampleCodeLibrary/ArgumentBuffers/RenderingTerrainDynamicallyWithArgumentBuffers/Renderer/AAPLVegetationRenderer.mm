@@ -268,7 +268,7 @@ using namespace simd;
         [renderEncoder setVertexBuffer:globalUniforms.getBuffer() offset:globalUniforms.getOffset() atIndex:2];
         [renderEncoder setFragmentBuffer:globalUniforms.getBuffer() offset:globalUniforms.getOffset() atIndex:0];
         [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
-                                   indexType:MTLIndexTypeUInt16
+                                   indexType:pop.mesh.indexType
                                  indexBuffer:pop.mesh.indexBuffer
                            indexBufferOffset:0
                               indirectBuffer:_indirectBuffer
@@ -290,7 +290,7 @@ using namespace simd;
         [renderEncoder setVertexBuffer:globalUniforms.getBuffer() offset:globalUniforms.getOffset() atIndex:2];
         [renderEncoder setFragmentBuffer:globalUniforms.getBuffer() offset:globalUniforms.getOffset() atIndex:0];
         [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
-                                   indexType:MTLIndexTypeUInt16
+                                   indexType:pop.mesh.indexType
                                  indexBuffer:pop.mesh.indexBuffer
                            indexBufferOffset:0
                               indirectBuffer:_indirectBuffer
@@ -0,0 +1,749 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the mesh optimizer.
+*/
+
+#include "AAPLMeshOptimizer.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+// Size of the LRU cache that the vertex cache optimization models.  Scoring a larger cache
+//  than the hardware's costs little, because the scores favor the most recent vertices.
+static const uint32_t ScoredCacheSize = 32;
+
+// Tom Forsyth's scoring constants.
+static const float CacheDecayPower      = 1.5f;
+static const float LastTriangleScore    = 0.75f;
+static const float ValenceBoostScale    = 2.0f;
+static const float ValenceBoostPower    = 0.5f;
+
+// Valences that the optimization keeps scores for; higher valences score as this one.
+static const uint32_t MaxScoredValence = 64;
+
+// Size of the FIFO cache that finds where the overdraw optimization may split clusters.
+static const uint32_t ClusterCacheSize = 16;
+
+// The grid that the overdraw analysis rasterizes to, and its subpixel precision.
+static const int OverdrawGridSize = 256;
+static const int SubpixelBits = 4;
+
+// The cache that the vertex fetch analysis models.
+static const uint32_t FetchLineSize = 64;
+static const uint32_t FetchSetCount = 64;
+static const uint32_t FetchWayCount = 4;
+
+struct ScoreTables
+{
+    float   cache[ScoredCacheSize];
+    float   valence[MaxScoredValence + 1];
+
+    ScoreTables()
+    {
+        for (uint32_t position = 0; position < ScoredCacheSize; ++position)
+        {
+            // The three vertices of the last triangle score the same, so that the next
+            //  triangle doesn't favor any of its edges.
+            if (position < 3)
+                cache[position] = LastTriangleScore;
+            else
+                cache[position] = powf(1.0f - (float)(position - 3) / (ScoredCacheSize - 3), CacheDecayPower);
+        }
+
+        valence[0] = 0.0f;
+        for (uint32_t count = 1; count <= MaxScoredValence; ++count)
+            valence[count] = ValenceBoostScale * powf((float)count, -ValenceBoostPower);
+    }
+};
+
+const ScoreTables& scoreTables()
+{
+    static const ScoreTables tables;
+    return tables;
+}
+
+// A vertex with no triangles left to draw scores nothing, so it never attracts a triangle.
+inline float vertexScore(const ScoreTables& tables, int cachePosition, uint32_t liveTriangleCount)
+{
+    if (liveTriangleCount == 0)
+        return -1.0f;
+
+    float score = tables.valence[std::min(liveTriangleCount, MaxScoredValence)];
+    if (cachePosition >= 0)
+        score += tables.cache[cachePosition];
+    return score;
+}
+
+// The triangles that use each vertex, as ranges of one array.
+struct Adjacency
+{
+    std::vector<uint32_t>   offsets;
+    std::vector<uint32_t>   counts;
+    std::vector<uint32_t>   triangles;
+
+    template <typename Index>
+    void build(const Index* indices, size_t indexCount, size_t vertexCount)
+    {
+        offsets.assign(vertexCount + 1, 0);
+        counts.assign(vertexCount, 0);
+        triangles.resize(indexCount);
+
+        for (size_t i = 0; i < indexCount; ++i)
+            counts[indices[i]]++;
+
+        for (size_t v = 0; v < vertexCount; ++v)
+            offsets[v + 1] = offsets[v] + counts[v];
+
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            const Index vertex = indices[i];
+            triangles[offsets[vertex] + counts[vertex]++] = (uint32_t)(i / 3);
+        }
+    }
+
+    // Removes a drawn triangle from a vertex's live triangles, which come first in its range.
+    void remove(uint32_t vertex, uint32_t triangle)
+    {
+        uint32_t* begin = &triangles[offsets[vertex]];
+        uint32_t* end = begin + counts[vertex];
+        uint32_t* found = std::find(begin, end, triangle);
+        std::swap(*found, end[-1]);
+        counts[vertex]--;
+    }
+};
+
+template <typename Index>
+void optimizeVertexCache(Index* destination, const Index* source, size_t indexCount, size_t vertexCount)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // The source may be the destination.
+    std::vector<Index> indices(source, source + triangleCount * 3);
+
+    const ScoreTables& tables = scoreTables();
+
+    Adjacency adjacency;
+    adjacency.build(indices.data(), triangleCount * 3, vertexCount);
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScores[v] = vertexScore(tables, -1, adjacency.counts[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        triangleScores[t] = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] +
+                            vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> drawn(triangleCount, false);
+
+    // The cache holds the triangle's three vertices before evicting the oldest.
+    uint32_t cache[ScoredCacheSize + 3];
+    uint32_t newCache[ScoredCacheSize + 3];
+    uint32_t cacheCount = 0;
+
+    // The first triangle is the one with the best score, and later triangles come from the
+    //  vertices in the cache, or from the next triangle in the list that hasn't been drawn.
+    uint32_t best = (uint32_t)(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+    size_t nextUndrawn = 0;
+
+    for (size_t output = 0; output < triangleCount; ++output)
+    {
+        if (best == UINT32_MAX)
+        {
+            while (drawn[nextUndrawn])
+                nextUndrawn++;
+            best = (uint32_t)nextUndrawn;
+        }
+
+        const Index* triangle = &indices[best * 3];
+        memcpy(&destination[output * 3], triangle, sizeof(Index) * 3);
+        drawn[best] = true;
+
+        // Put the triangle's vertices at the front of the cache, and move the rest back.
+        uint32_t newCount = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            newCache[newCount++] = triangle[corner];
+            adjacency.remove(triangle[corner], best);
+        }
+
+        for (uint32_t i = 0; i < cacheCount; ++i)
+        {
+            const uint32_t vertex = cache[i];
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                newCache[newCount++] = vertex;
+        }
+
+        // Rescore the vertices in the cache and the ones that left it, and update the scores of
+        //  their live triangles, keeping the best triangle.
+        best = UINT32_MAX;
+        float bestScore = 0.0f;
+        for (uint32_t i = 0; i < newCount; ++i)
+        {
+            const uint32_t vertex = newCache[i];
+            const int position = i < ScoredCacheSize ? (int)i : -1;
+            cachePositions[vertex] = position;
+
+            const float score = vertexScore(tables, position, adjacency.counts[vertex]);
+            const float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+
+            const uint32_t* triangles = &adjacency.triangles[adjacency.offsets[vertex]];
+            for (uint32_t j = 0; j < adjacency.counts[vertex]; ++j)
+            {
+                float& triangleScore = triangleScores[triangles[j]];
+                triangleScore += delta;
+
+                if (triangleScore > bestScore)
+                {
+                    bestScore = triangleScore;
+                    best = triangles[j];
+                }
+            }
+        }
+
+        cacheCount = std::min(newCount, ScoredCacheSize);
+        memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+    }
+}
+
+// Simulates a FIFO cache, and returns whether the vertex was already in it.
+class FIFOCache
+{
+public:
+    FIFOCache(size_t vertexCount, uint32_t cacheSize)
+    : _timestamps(vertexCount, 0)
+    , _cacheSize(cacheSize)
+    {
+    }
+
+    bool access(uint32_t vertex)
+    {
+        // A vertex is in the cache if fewer than `cacheSize` misses have happened since it entered.
+        if (_timestamps[vertex] != 0 && _time - _timestamps[vertex] < _cacheSize)
+            return true;
+
+        _timestamps[vertex] = ++_time;
+        return false;
+    }
+
+    // Empties the cache.
+    void flush()
+    {
+        _time += _cacheSize;
+    }
+
+private:
+    std::vector<uint64_t>   _timestamps;
+    uint64_t                _time       = 0;
+    uint32_t                _cacheSize;
+};
+
+template <typename Index>
+uint32_t triangleMisses(FIFOCache& cache, const Index* triangle)
+{
+    // Access all three vertices before any of them can push another out.
+    const bool hit0 = cache.access(triangle[0]);
+    const bool hit1 = cache.access(triangle[1]);
+    const bool hit2 = cache.access(triangle[2]);
+    return !hit0 + !hit1 + !hit2;
+}
+
+struct Vector3
+{
+    float x, y, z;
+};
+
+inline Vector3 loadPosition(const float* positions, size_t positionStride, size_t vertex)
+{
+    const float* position = (const float*)((const uint8_t*)positions + vertex * positionStride);
+    return { position[0], position[1], position[2] };
+}
+
+template <typename Index>
+void optimizeOverdraw(Index* destination, const Index* source, size_t indexCount,
+                      const float* positions, size_t vertexCount, size_t positionStride, float threshold)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    std::vector<Index> indices(source, source + triangleCount * 3);
+
+    // Hard boundaries are where the cache misses every vertex of a triangle, so starting
+    //  a cluster there costs nothing.
+    std::vector<uint32_t> hardClusters;
+    {
+        FIFOCache cache(vertexCount, ClusterCacheSize);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            if (triangleMisses(cache, &indices[t * 3]) == 3)
+                hardClusters.push_back((uint32_t)t);
+        }
+    }
+    hardClusters.push_back((uint32_t)triangleCount);
+
+    // Soft boundaries split a hard cluster wherever the triangles since the last split have
+    //  cost no more than `threshold` times the cluster's average, starting from an empty cache.
+    std::vector<uint32_t> clusters;
+    for (size_t h = 0; h + 1 < hardClusters.size(); ++h)
+    {
+        const uint32_t begin = hardClusters[h], end = hardClusters[h + 1];
+
+        FIFOCache cache(vertexCount, ClusterCacheSize);
+        uint32_t misses = 0;
+        for (uint32_t t = begin; t < end; ++t)
+            misses += triangleMisses(cache, &indices[t * 3]);
+        const float clusterACMR = (float)misses / (end - begin);
+
+        cache.flush();
+        clusters.push_back(begin);
+        uint32_t runMisses = 0, runTriangles = 0;
+        for (uint32_t t = begin; t < end; ++t)
+        {
+            runMisses += triangleMisses(cache, &indices[t * 3]);
+            runTriangles++;
+
+            if (t + 1 < end && (float)runMisses / runTriangles <= threshold * clusterACMR)
+            {
+                clusters.push_back(t + 1);
+                cache.flush();
+                runMisses = 0;
+                runTriangles = 0;
+            }
+        }
+    }
+    clusters.push_back((uint32_t)triangleCount);
+
+    // Sort the clusters by how far their area-weighted center lies from the mesh's, along
+    //  their average normal.  Clusters on the outside that face outward draw first.
+    const size_t clusterCount = clusters.size() - 1;
+    std::vector<Vector3> centers(clusterCount), normals(clusterCount);
+    Vector3 meshCenter = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        Vector3 center = { 0.0f, 0.0f, 0.0f }, normal = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const Vector3 a = loadPosition(positions, positionStride, indices[t * 3 + 0]);
+            const Vector3 b = loadPosition(positions, positionStride, indices[t * 3 + 1]);
+            const Vector3 p = loadPosition(positions, positionStride, indices[t * 3 + 2]);
+
+            const Vector3 e1 = { b.x - a.x, b.y - a.y, b.z - a.z };
+            const Vector3 e2 = { p.x - a.x, p.y - a.y, p.z - a.z };
+            const Vector3 n = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+            const float triangleArea = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+            center.x += (a.x + b.x + p.x) * (triangleArea / 3.0f);
+            center.y += (a.y + b.y + p.y) * (triangleArea / 3.0f);
+            center.z += (a.z + b.z + p.z) * (triangleArea / 3.0f);
+            normal.x += n.x;
+            normal.y += n.y;
+            normal.z += n.z;
+            area += triangleArea;
+        }
+
+        meshCenter.x += center.x;
+        meshCenter.y += center.y;
+        meshCenter.z += center.z;
+        meshArea += area;
+
+        const float inverseArea = area > 0.0f ? 1.0f / area : 0.0f;
+        centers[c] = { center.x * inverseArea, center.y * inverseArea, center.z * inverseArea };
+
+        const float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        const float inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+        normals[c] = { normal.x * inverseLength, normal.y * inverseLength, normal.z * inverseLength };
+    }
+
+    const float inverseMeshArea = meshArea > 0.0f ? 1.0f / meshArea : 0.0f;
+    meshCenter = { meshCenter.x * inverseMeshArea, meshCenter.y * inverseMeshArea, meshCenter.z * inverseMeshArea };
+
+    std::vector<float> sortKeys(clusterCount);
+    std::vector<uint32_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        sortKeys[c] = (centers[c].x - meshCenter.x) * normals[c].x + (centers[c].y - meshCenter.y) * normals[c].y +
+                      (centers[c].z - meshCenter.z) * normals[c].z;
+        order[c] = (uint32_t)c;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    size_t output = 0;
+    for (uint32_t c : order)
+    {
+        const size_t count = (clusters[c + 1] - clusters[c]) * 3;
+        memcpy(&destination[output], &indices[clusters[c] * 3], count * sizeof(Index));
+        output += count;
+    }
+}
+
+template <typename Index>
+size_t optimizeVertexFetchRemap(uint32_t* remap, const Index* indices, size_t indexCount, size_t vertexCount)
+{
+    std::fill(remap, remap + vertexCount, UINT32_MAX);
+
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        if (remap[indices[i]] == UINT32_MAX)
+            remap[indices[i]] = next++;
+    }
+
+    const size_t usedCount = next;
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        if (remap[v] == UINT32_MAX)
+            remap[v] = next++;
+    }
+    return usedCount;
+}
+
+template <typename Index>
+void remapIndices(Index* destination, const Index* indices, size_t indexCount, const uint32_t* remap)
+{
+    for (size_t i = 0; i < indexCount; ++i)
+        destination[i] = (Index)remap[indices[i]];
+}
+
+template <typename Index>
+void optimize(Index* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize,
+              size_t positionOffset)
+{
+    const float* positions = (const float*)((const uint8_t*)vertices + positionOffset);
+
+    optimizeVertexCache(indices, indices, indexCount, vertexCount);
+    optimizeOverdraw(indices, indices, indexCount, positions, vertexCount, vertexSize, AAPLMeshDefaultOverdrawThreshold);
+
+    std::vector<uint32_t> remap(vertexCount);
+    optimizeVertexFetchRemap(remap.data(), indices, indexCount, vertexCount);
+    remapIndices(indices, indices, indexCount, remap.data());
+
+    std::vector<uint8_t> remappedVertices(vertexCount * vertexSize);
+    AAPLMeshRemapVertices(remappedVertices.data(), vertices, vertexCount, vertexSize, remap.data());
+    memcpy(vertices, remappedVertices.data(), remappedVertices.size());
+}
+
+template <typename Index>
+AAPLVertexCacheStatistics analyzeVertexCache(const Index* indices, size_t indexCount, size_t vertexCount,
+                                             uint32_t cacheSize)
+{
+    AAPLVertexCacheStatistics statistics = {};
+
+    FIFOCache cache(vertexCount, cacheSize);
+    std::vector<bool> used(vertexCount, false);
+    size_t usedCount = 0;
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        statistics.transformedVertexCount += triangleMisses(cache, &indices[i]);
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            if (!used[indices[i + corner]])
+            {
+                used[indices[i + corner]] = true;
+                usedCount++;
+            }
+        }
+    }
+
+    const size_t triangleCount = indexCount / 3;
+    statistics.acmr = triangleCount ? (float)statistics.transformedVertexCount / triangleCount : 0.0f;
+    statistics.atvr = usedCount ? (float)statistics.transformedVertexCount / usedCount : 0.0f;
+    return statistics;
+}
+
+struct Rasterizer
+{
+    std::vector<float>  depth;
+    uint64_t            covered = 0;
+    uint64_t            shaded  = 0;
+
+    Rasterizer() : depth(OverdrawGridSize * OverdrawGridSize) {}
+
+    void clear()
+    {
+        std::fill(depth.begin(), depth.end(), INFINITY);
+    }
+
+    void finish()
+    {
+        for (float d : depth)
+            covered += d != INFINITY;
+    }
+
+    // Draws a triangle with a depth test.  Positions are in pixels.
+    void draw(const Vector3& a, const Vector3& b, const Vector3& c)
+    {
+        const int scale = 1 << SubpixelBits;
+        int x0 = (int)lrintf(a.x * scale), y0 = (int)lrintf(a.y * scale);
+        int x1 = (int)lrintf(b.x * scale), y1 = (int)lrintf(b.y * scale);
+        int x2 = (int)lrintf(c.x * scale), y2 = (int)lrintf(c.y * scale);
+        float z0 = a.z, z1 = b.z, z2 = c.z;
+
+        int64_t area = (int64_t)(x1 - x0) * (y2 - y0) - (int64_t)(x2 - x0) * (y1 - y0);
+        if (area == 0)
+            return;
+
+        // Rasterize counterclockwise triangles only.
+        if (area < 0)
+        {
+            std::swap(x1, x2);
+            std::swap(y1, y2);
+            std::swap(z1, z2);
+            area = -area;
+        }
+
+        const int minX = std::max(0, (std::min({ x0, x1, x2 }) >> SubpixelBits));
+        const int maxX = std::min(OverdrawGridSize - 1, (std::max({ x0, x1, x2 }) >> SubpixelBits));
+        const int minY = std::max(0, (std::min({ y0, y1, y2 }) >> SubpixelBits));
+        const int maxY = std::min(OverdrawGridSize - 1, (std::max({ y0, y1, y2 }) >> SubpixelBits));
+
+        // Edges that are top or left include the pixels on them, so shared edges don't
+        //  cover a pixel twice.
+        const auto edgeBias = [](int ax, int ay, int bx, int by)
+        {
+            const bool topLeft = (ay == by && bx < ax) || by < ay;
+            return topLeft ? 0 : -1;
+        };
+        const int bias0 = edgeBias(x1, y1, x2, y2);
+        const int bias1 = edgeBias(x2, y2, x0, y0);
+        const int bias2 = edgeBias(x0, y0, x1, y1);
+        const float inverseArea = 1.0f / (float)area;
+
+        for (int py = minY; py <= maxY; ++py)
+        {
+            const int sy = (py << SubpixelBits) + scale / 2;
+            for (int px = minX; px <= maxX; ++px)
+            {
+                const int sx = (px << SubpixelBits) + scale / 2;
+                const int64_t w0 = (int64_t)(x2 - x1) * (sy - y1) - (int64_t)(y2 - y1) * (sx - x1);
+                const int64_t w1 = (int64_t)(x0 - x2) * (sy - y2) - (int64_t)(y0 - y2) * (sx - x2);
+                const int64_t w2 = (int64_t)(x1 - x0) * (sy - y0) - (int64_t)(y1 - y0) * (sx - x0);
+                if (w0 + bias0 < 0 || w1 + bias1 < 0 || w2 + bias2 < 0)
+                    continue;
+
+                const float z = (w0 * z0 + w1 * z1 + w2 * z2) * inverseArea;
+                float& stored = depth[py * OverdrawGridSize + px];
+                if (z < stored)
+                {
+                    stored = z;
+                    shaded++;
+                }
+            }
+        }
+    }
+};
+
+template <typename Index>
+AAPLOverdrawStatistics analyzeOverdraw(const Index* indices, size_t indexCount,
+                                       const float* positions, size_t vertexCount, size_t positionStride)
+{
+    AAPLOverdrawStatistics statistics = {};
+    if (vertexCount == 0)
+        return statistics;
+
+    // Fit the mesh's bounding box into the grid, keeping its proportions.
+    Vector3 minimum = loadPosition(positions, positionStride, 0), maximum = minimum;
+    for (size_t v = 1; v < vertexCount; ++v)
+    {
+        const Vector3 p = loadPosition(positions, positionStride, v);
+        minimum = { std::min(minimum.x, p.x), std::min(minimum.y, p.y), std::min(minimum.z, p.z) };
+        maximum = { std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z) };
+    }
+
+    const float extent = std::max({ maximum.x - minimum.x, maximum.y - minimum.y, maximum.z - minimum.z });
+    const float scale = extent > 0.0f ? (OverdrawGridSize - 1) / extent : 0.0f;
+
+    // Look down each axis from both ends, with depths that grow away from the viewer, and draw
+    //  the triangles that face the viewer with counterclockwise winding.
+    Rasterizer rasterizer;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (int side = 0; side < 2; ++side)
+        {
+            const float direction = side ? -1.0f : 1.0f;
+
+            rasterizer.clear();
+            for (size_t i = 0; i + 2 < indexCount; i += 3)
+            {
+                float coordinates[3][3];
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    const Vector3 p = loadPosition(positions, positionStride, indices[i + corner]);
+                    coordinates[corner][0] = (p.x - minimum.x) * scale;
+                    coordinates[corner][1] = (p.y - minimum.y) * scale;
+                    coordinates[corner][2] = (p.z - minimum.z) * scale;
+                }
+
+                const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                const float facing = (coordinates[1][u] - coordinates[0][u]) * (coordinates[2][v] - coordinates[0][v]) -
+                                     (coordinates[2][u] - coordinates[0][u]) * (coordinates[1][v] - coordinates[0][v]);
+                if (facing * direction >= 0.0f)
+                    continue;
+
+                Vector3 corners[3];
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    corners[corner] = { coordinates[corner][u], coordinates[corner][v],
+                                        coordinates[corner][axis] * direction };
+                }
+                rasterizer.draw(corners[0], corners[1], corners[2]);
+            }
+            rasterizer.finish();
+        }
+    }
+
+    statistics.coveredPixelCount = rasterizer.covered;
+    statistics.shadedPixelCount = rasterizer.shaded;
+    statistics.overdraw = rasterizer.covered ? (float)rasterizer.shaded / rasterizer.covered : 0.0f;
+    return statistics;
+}
+
+template <typename Index>
+AAPLVertexFetchStatistics analyzeVertexFetch(const Index* indices, size_t indexCount, size_t vertexCount,
+                                             size_t vertexSize)
+{
+    AAPLVertexFetchStatistics statistics = {};
+
+    // A set-associative cache of lines of the vertex buffer, with LRU replacement in each set.
+    std::vector<uint64_t> lines(FetchSetCount * FetchWayCount, UINT64_MAX);
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const uint64_t begin = indices[i] * (uint64_t)vertexSize / FetchLineSize;
+        const uint64_t end = (indices[i] * (uint64_t)vertexSize + vertexSize - 1) / FetchLineSize;
+        for (uint64_t line = begin; line <= end; ++line)
+        {
+            uint64_t* ways = &lines[(line % FetchSetCount) * FetchWayCount];
+            uint64_t* found = std::find(ways, ways + FetchWayCount, line);
+            if (found == ways + FetchWayCount)
+            {
+                statistics.bytesFetched += FetchLineSize;
+                found = ways + FetchWayCount - 1;
+            }
+
+            // Move the line to the front of its set.
+            std::rotate(ways, found, found + 1);
+            ways[0] = line;
+        }
+    }
+
+    const uint64_t vertexBytes = vertexCount * (uint64_t)vertexSize;
+    statistics.overfetch = vertexBytes ? (float)statistics.bytesFetched / vertexBytes : 0.0f;
+    return statistics;
+}
+
+} // namespace
+
+void AAPLMeshOptimizeVertexCache(uint16_t* destination, const uint16_t* indices, size_t indexCount, size_t vertexCount)
+{
+    optimizeVertexCache(destination, indices, indexCount, vertexCount);
+}
+
+void AAPLMeshOptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    optimizeVertexCache(destination, indices, indexCount, vertexCount);
+}
+
+void AAPLMeshOptimizeOverdraw(uint16_t* destination, const uint16_t* indices, size_t indexCount,
+                              const float* positions, size_t vertexCount, size_t positionStride, float threshold)
+{
+    optimizeOverdraw(destination, indices, indexCount, positions, vertexCount, positionStride, threshold);
+}
+
+void AAPLMeshOptimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+                              const float* positions, size_t vertexCount, size_t positionStride, float threshold)
+{
+    optimizeOverdraw(destination, indices, indexCount, positions, vertexCount, positionStride, threshold);
+}
+
+size_t AAPLMeshOptimizeVertexFetchRemap(uint32_t* remap, const uint16_t* indices, size_t indexCount, size_t vertexCount)
+{
+    return optimizeVertexFetchRemap(remap, indices, indexCount, vertexCount);
+}
+
+size_t AAPLMeshOptimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    return optimizeVertexFetchRemap(remap, indices, indexCount, vertexCount);
+}
+
+void AAPLMeshRemapIndices(uint16_t* destination, const uint16_t* indices, size_t indexCount, const uint32_t* remap)
+{
+    remapIndices(destination, indices, indexCount, remap);
+}
+
+void AAPLMeshRemapIndices(uint32_t* destination, const uint32_t* indices, size_t indexCount, const uint32_t* remap)
+{
+    remapIndices(destination, indices, indexCount, remap);
+}
+
+void AAPLMeshRemapVertices(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize,
+                           const uint32_t* remap)
+{
+    for (size_t v = 0; v < vertexCount; ++v)
+        memcpy((uint8_t*)destination + remap[v] * vertexSize, (const uint8_t*)vertices + v * vertexSize, vertexSize);
+}
+
+void AAPLMeshOptimize(uint16_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize,
+                      size_t positionOffset)
+{
+    optimize(indices, indexCount, vertices, vertexCount, vertexSize, positionOffset);
+}
+
+void AAPLMeshOptimize(uint32_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize,
+                      size_t positionOffset)
+{
+    optimize(indices, indexCount, vertices, vertexCount, vertexSize, positionOffset);
+}
+
+AAPLVertexCacheStatistics AAPLMeshAnalyzeVertexCache(const uint16_t* indices, size_t indexCount, size_t vertexCount,
+                                                     uint32_t cacheSize)
+{
+    return analyzeVertexCache(indices, indexCount, vertexCount, cacheSize);
+}
+
+AAPLVertexCacheStatistics AAPLMeshAnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                                     uint32_t cacheSize)
+{
+    return analyzeVertexCache(indices, indexCount, vertexCount, cacheSize);
+}
+
+AAPLOverdrawStatistics AAPLMeshAnalyzeOverdraw(const uint16_t* indices, size_t indexCount,
+                                               const float* positions, size_t vertexCount, size_t positionStride)
+{
+    return analyzeOverdraw(indices, indexCount, positions, vertexCount, positionStride);
+}
+
+AAPLOverdrawStatistics AAPLMeshAnalyzeOverdraw(const uint32_t* indices, size_t indexCount,
+                                               const float* positions, size_t vertexCount, size_t positionStride)
+{
+    return analyzeOverdraw(indices, indexCount, positions, vertexCount, positionStride);
+}
+
+AAPLVertexFetchStatistics AAPLMeshAnalyzeVertexFetch(const uint16_t* indices, size_t indexCount, size_t vertexCount,
+                                                     size_t vertexSize)
+{
+    return analyzeVertexFetch(indices, indexCount, vertexCount, vertexSize);
+}
+
+AAPLVertexFetchStatistics AAPLMeshAnalyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                                     size_t vertexSize)
+{
+    return analyzeVertexFetch(indices, indexCount, vertexCount, vertexSize);
+}
@@ -173,7 +173,9 @@ static const uint32_t kBloomTargetCount = kBlurDirectionCount * kBloomTargetScal
 
     // Sphere
     id <MTLBuffer> _sphereVertexBuffer;
+    id <MTLBuffer> _sphereIndexBuffer;
     uint32_t _numSphereVerts;
+    uint32_t _numSphereIndices;
 
     //-------------
     // Post process
@@ -525,11 +527,15 @@ static const uint32_t kBloomTargetCount = kBlurDirectionCount * kBloomTargetScal
     // MARK: Create vertex buffer
 
     // Create the vertex buffer for the scene, a sphere
-    AAPLVertex* sphereVerts = generate_sphere_data(&_numSphereVerts);
+    uint16_t* sphereIndices = NULL;
+    AAPLVertex* sphereVerts = generate_sphere_data(&_numSphereVerts, &sphereIndices, &_numSphereIndices);
     _sphereVertexBuffer = [_device newBufferWithBytes:sphereVerts
                                                length:_numSphereVerts * sizeof(AAPLVertex)
                                               options:MTLResourceOptionCPUCacheModeDefault];
-    delete_sphere_data(sphereVerts);
+    _sphereIndexBuffer = [_device newBufferWithBytes:sphereIndices
+                                              length:_numSphereIndices * sizeof(uint16_t)
+                                             options:MTLResourceOptionCPUCacheModeDefault];
+    delete_sphere_data(sphereVerts, sphereIndices);
 
     //-----------------------------
     // MARK: Create uniform buffers
@@ -863,7 +869,12 @@ static const uint32_t kBloomTargetCount = kBlurDirectionCount * kBloomTargetScal
     [rce setVertexBuffer:_sphereVertexBuffer offset:0 atIndex:AAPLBufferIndexVertices];
     [rce setVertexBuffer:_dynamicUniformBuffers[_currentUniformIndex] offset:0 atIndex:AAPLBufferIndexUniforms];
     [rce setFragmentBuffer:_dynamicUniformBuffers[_currentUniformIndex] offset:0 atIndex:AAPLBufferIndexUniforms];
-    [rce drawPrimitives:MTLPrimitiveTypeTriangle vertexStart:0 vertexCount:_numSphereVerts instanceCount:OBJECT_COUNT];
+    [rce drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                    indexCount:_numSphereIndices
+                     indexType:MTLIndexTypeUInt16
+                   indexBuffer:_sphereIndexBuffer
+             indexBufferOffset:0
+                 instanceCount:OBJECT_COUNT];
 
     [rce endEncoding];
 }
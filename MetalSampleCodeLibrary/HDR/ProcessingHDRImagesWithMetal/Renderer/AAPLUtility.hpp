@@ -30,10 +30,11 @@ float lerpf(float v0, float v1, float t);
 NSString * string_for_tonemap_operator_type(uint32_t typeIndex);
 NSString * string_for_exposure_control_type(uint32_t typeIndex);
 
-/// Creates an array of AAPLVertex representing postion and normals for a unit sphere
+/// Creates an array of AAPLVertex representing postion and normals for a unit sphere, and an array of 16-bit
+/// triangle indices into it, ordered for the vertex cache, overdraw and vertex fetch
 /// Caller is responsible for freeing data
-struct AAPLVertex * generate_sphere_data(uint32_t * vertexCount);
-void delete_sphere_data(struct AAPLVertex * data);
+struct AAPLVertex * generate_sphere_data(uint32_t * vertexCount, uint16_t ** indices, uint32_t * indexCount);
+void delete_sphere_data(struct AAPLVertex * data, uint16_t * indices);
 
 /// As a source of HDR input, renderer leverages radiance (.hdr) files. This helper method provides a radiance file
 /// loaded into an MTLTexture given a source file name and MTLDevice
@@ -7,6 +7,7 @@ Implementation of common utility functions.
 
 #import "AAPLUtility.hpp"
 #import "AAPLMathUtilities.h"
+#import "AAPLMeshOptimizer.h"
 #import "AAPLShaderTypes.h"
 
 #import <Foundation/Foundation.h>
@@ -14,6 +15,8 @@ Implementation of common utility functions.
 #import <Metal/Metal.h>
 
 #import <simd/simd.h>
+#import <array>
+#import <map>
 #import <vector>
 
 namespace Utility
@@ -214,42 +217,57 @@ NSString * string_for_exposure_control_type(uint32_t typeIndex)
 
 #pragma mark Geometry
 
-/// Creates an array of AAPLVertex representing position and normals for a unit sphere
+/// Creates an array of AAPLVertex representing position and normals for a unit sphere, and the indices of its
+/// triangles, ordered for the vertex cache, overdraw and vertex fetch
 /// Caller is responsible for freeing data
-AAPLVertex * generate_sphere_data(uint32_t * vertexCount)
+AAPLVertex * generate_sphere_data(uint32_t * vertexCount, uint16_t ** indices, uint32_t * indexCount)
 {
     const uint32_t NUM_SPHERE_ITERATIONS = 4;
     Utility::SphereTriangle::Vector sphere = Utility::s_GenSphere(NUM_SPHERE_ITERATIONS);
     const uint32_t triCount = static_cast<uint32_t>(sphere.size());
-    const uint32_t vtxCount = triCount * 3;
+    const uint32_t idxCount = triCount * 3;
 
-    AAPLVertex * sVerts = new AAPLVertex[vtxCount];
+    // Neighboring triangles compute their shared midpoints from the same corners, so shared
+    // vertices have identical positions and collapse to one vertex
+    std::vector<AAPLVertex> verts;
+    std::map<std::array<float, 3>, uint16_t> vertIndices;
+    uint16_t * sIndices = new uint16_t[idxCount];
 
     for (size_t iTri = 0; iTri < triCount; ++iTri)
     {
-        size_t iVert = iTri * 3;
-        sVerts[iVert].position = sphere[iTri].v0;
-        sVerts[iVert].normal = sphere[iTri].v0;
+        const vector_float3 corners[] = { sphere[iTri].v0, sphere[iTri].v1, sphere[iTri].v2 };
+        for (size_t iCorner = 0; iCorner < 3; ++iCorner)
+        {
+            const vector_float3& corner = corners[iCorner];
+            auto inserted = vertIndices.insert({ {corner.x, corner.y, corner.z}, static_cast<uint16_t>(verts.size()) });
+            if (inserted.second)
+            {
+                AAPLVertex vert;
+                vert.position = corner;
+                vert.normal = corner;
+                verts.push_back(vert);
+            }
+            sIndices[iTri * 3 + iCorner] = inserted.first->second;
+        }
+    }
 
-        sVerts[iVert + 1].position = sphere[iTri].v1;
-        sVerts[iVert + 1].normal = sphere[iTri].v1;
+    const uint32_t vtxCount = static_cast<uint32_t>(verts.size());
+    AAPLVertex * sVerts = new AAPLVertex[vtxCount];
+    std::copy(verts.begin(), verts.end(), sVerts);
 
-        sVerts[iVert + 2].position = sphere[iTri].v2;
-        sVerts[iVert + 2].normal = sphere[iTri].v2;
-    }
+    AAPLMeshOptimize(sIndices, idxCount, sVerts, vtxCount, sizeof(AAPLVertex), offsetof(AAPLVertex, position));
 
     *vertexCount = vtxCount;
+    *indices = sIndices;
+    *indexCount = idxCount;
     return sVerts;
 }
 
 /// Frees the sphere data
-void delete_sphere_data(AAPLVertex* data)
+void delete_sphere_data(AAPLVertex* data, uint16_t* indices)
 {
-    if (data)
-    {
-        delete [] data;
-        data = nullptr;
-    }
+    delete [] data;
+    delete [] indices;
 }
 
 #pragma mark Texture Load
@@ -0,0 +1,328 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that measures how the light animation scales with the number of lights and
+ threads, against the renderer's former loop over one light at a time.
+*/
+
+#include "../Renderer/AAPLJobPool.h"
+#include "../Renderer/AAPLLightAnimation.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --counts LIST        Comma separated light counts (default 256,4096,65536,1048576)\n"
+            "  --threads LIST       Comma separated thread counts (default 1 and one per core)\n"
+            "  --frames N           Frames to animate for each measurement (default 100)\n"
+            "  --grain N            Lights per job (default 4096)\n",
+            program);
+}
+
+std::vector<uint32_t> parseList(const char* list)
+{
+    std::vector<uint32_t> values;
+    for(const char* p = list; p; )
+    {
+        values.push_back((uint32_t)atoi(p));
+        p = strchr(p, ',');
+        if(p)
+        {
+            ++p;
+        }
+    }
+    return values;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// MARK: - Scene
+
+struct Light
+{
+    float x, y, z, w;
+    float speed;
+};
+
+/// Places lights like Renderer::populateLights: 30% around the tree, 40% on the ground inside
+/// the columns and 30% around the outside of the columns.
+std::vector<Light> makeLights(size_t count, size_t treeLightCount)
+{
+    std::mt19937 random(0x134e5348);
+    auto uniform = [&](float low, float high) { return std::uniform_real_distribution<float>(low, high)(random); };
+
+    std::vector<Light> lights(count);
+    const size_t groundLights = treeLightCount + count * 4 / 10;
+    for(size_t i = 0; i < count; i++)
+    {
+        float distance, height, speed;
+        if(i < treeLightCount)
+        {
+            distance = uniform(38, 42);
+            height = uniform(0, 1);
+            speed = uniform(0.003, 0.014);
+        }
+        else if(i < groundLights)
+        {
+            distance = uniform(140, 260);
+            height = uniform(140, 150);
+            speed = uniform(0.006, 0.027) * (random() % 2 ? 1 : -1);
+        }
+        else
+        {
+            distance = uniform(365, 380);
+            height = uniform(150, 190);
+            speed = uniform(0.004, 0.014) * (random() % 2 ? 1 : -1);
+        }
+        const float angle = uniform(0, M_PI * 2);
+
+        lights[i] = { distance * sinf(angle), height, distance * cosf(angle), 1, speed * 0.5f };
+    }
+    return lights;
+}
+
+/// A view matrix that turns and moves the scene like the sample's camera.
+void makeModelViewMatrix(float* m)
+{
+    const float angle = 0.7f, c = cosf(angle), s = sinf(angle);
+    const float columns[16] =
+    {
+           c, 0,  -s, 0,
+           0, 1,   0, 0,
+           s, 0,   c, 0,
+        -100, -300, 1000, 1
+    };
+    memcpy(m, columns, sizeof(columns));
+}
+
+// MARK: - Baseline
+
+void multiply(float* result, const float* m, const float* v)
+{
+    for(int row = 0; row < 4; row++)
+    {
+        result[row] = m[row] * v[0] + m[4 + row] * v[1] + m[8 + row] * v[2] + m[12 + row] * v[3];
+    }
+}
+
+/// The renderer's former loop: builds a rotation matrix for each orbiting light the way
+/// matrix4x4_rotation does, and transforms one light at a time.
+void animateBaseline(float* positions, const std::vector<Light>& lights, size_t treeLightCount,
+                     uint64_t frameNumber, const float* modelViewMatrix)
+{
+    for(size_t i = 0; i < lights.size(); i++)
+    {
+        const Light& light = lights[i];
+        float position[4];
+
+        if(i < treeLightCount)
+        {
+            double lightPeriod = light.speed * frameNumber;
+            lightPeriod += light.y;
+            lightPeriod -= floor(lightPeriod);
+
+            float r = 1.2 + 10.0 * powf(lightPeriod, 5.0);
+
+            position[0] = light.x * r;
+            position[1] = 200.0f + lightPeriod * 400.0f;
+            position[2] = light.z * r;
+            position[3] = 1;
+        }
+        else
+        {
+            const float radians = light.speed * frameNumber;
+            const float axis[3] = { 0, 1, 0 };
+            const float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            const float x = axis[0] / length, y = axis[1] / length, z = axis[2] / length;
+            const float ct = cosf(radians), st = sinf(radians), ci = 1 - ct;
+
+            // Column-major
+            const float rotation[16] =
+            {
+                ct + x * x * ci,     y * x * ci + z * st, z * x * ci - y * st, 0,
+                x * y * ci - z * st, ct + y * y * ci,     z * y * ci + x * st, 0,
+                x * z * ci + y * st, y * z * ci - x * st, ct + z * z * ci,     0,
+                0,                   0,                   0,                   1
+            };
+            multiply(position, rotation, &light.x);
+        }
+
+        multiply(positions + i * 4, modelViewMatrix, position);
+    }
+}
+
+// MARK: - Checks
+
+/// Returns the largest distance between the animation's positions and the baseline's, or a
+/// negative distance if splitting the lights into jobs changes any position.
+double largestError(size_t count, uint64_t frameNumber)
+{
+    const size_t treeLightCount = count * 3 / 10;
+    const std::vector<Light> lights = makeLights(count, treeLightCount);
+
+    LightAnimation animation;
+    animation.resize(count, treeLightCount);
+    for(size_t i = 0; i < count; i++)
+    {
+        animation.setLight(i, lights[i].x, lights[i].y, lights[i].z, lights[i].speed);
+    }
+
+    float modelView[16];
+    makeModelViewMatrix(modelView);
+
+    std::vector<float> expected(count * 4), positions(count * 4);
+    animateBaseline(expected.data(), lights, treeLightCount, frameNumber, modelView);
+    animation.animate(positions.data(), frameNumber, modelView, 0, count);
+
+    // Ranges that end inside vectors and inside the tree lights must give the same bits.
+    std::vector<float> jobPositions(count * 4);
+    JobPool jobPool(3);
+    jobPool.parallelFor(count, 999, [&](size_t begin, size_t end)
+    {
+        animation.animate(jobPositions.data(), frameNumber, modelView, begin, end);
+    });
+    if(memcmp(positions.data(), jobPositions.data(), positions.size() * sizeof(float)))
+    {
+        return -1;
+    }
+
+    double largest = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        double squared = 0;
+        for(int c = 0; c < 4; c++)
+        {
+            const double d = (double)positions[i * 4 + c] - expected[i * 4 + c];
+            squared += d * d;
+        }
+        largest = std::max(largest, sqrt(squared));
+    }
+    return largest;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    std::vector<uint32_t> counts = { 256, 4096, 65536, 1048576 };
+    std::vector<uint32_t> threadCounts = { 1, std::max(1u, std::thread::hardware_concurrency()) };
+    uint32_t frames = 100;
+    uint32_t grainSize = 4096;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--counts") && i + 1 < argc)
+        {
+            counts = parseList(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            threadCounts = parseList(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            frames = (uint32_t)atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--grain") && i + 1 < argc)
+        {
+            grainSize = (uint32_t)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(frames == 0 || grainSize == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    // The lights are about a thousand units from the camera, so distances around a thousandth
+    // of a unit are float rounding rather than a different animation.
+    bool failed = false;
+    printf("Largest distance from the baseline's positions, in scene units:\n");
+    for(uint64_t frameNumber : { 1ull, 1000ull, 100000ull, 10000000ull })
+    {
+        const double error = largestError(10007, frameNumber);
+        if(error < 0)
+        {
+            printf("  frame %-10llu FAILED: jobs changed the positions\n", (unsigned long long)frameNumber);
+        }
+        else
+        {
+            printf("  frame %-10llu %.5f\n", (unsigned long long)frameNumber, error);
+        }
+        failed |= error < 0 || error > 0.01;
+    }
+
+    printf("\n%10s %12s", "lights", "baseline");
+    for(uint32_t threadCount : threadCounts)
+    {
+        printf(" %9u thr", threadCount);
+    }
+    printf("   (nanoseconds per light, per frame)\n");
+
+    for(uint32_t count : counts)
+    {
+        const size_t treeLightCount = count * 3 / 10;
+        const std::vector<Light> lights = makeLights(count, treeLightCount);
+
+        LightAnimation animation;
+        animation.resize(count, treeLightCount);
+        for(size_t i = 0; i < count; i++)
+        {
+            animation.setLight(i, lights[i].x, lights[i].y, lights[i].z, lights[i].speed);
+        }
+
+        float modelView[16];
+        makeModelViewMatrix(modelView);
+        std::vector<float> positions(count * 4);
+
+        auto begin = std::chrono::steady_clock::now();
+        for(uint32_t frame = 0; frame < frames; frame++)
+        {
+            animateBaseline(positions.data(), lights, treeLightCount, frame, modelView);
+        }
+        printf("%10u %12.2f", count, seconds(begin) / frames / count * 1e9);
+
+        for(uint32_t threadCount : threadCounts)
+        {
+            JobPool jobPool(threadCount);
+
+            begin = std::chrono::steady_clock::now();
+            for(uint32_t frame = 0; frame < frames; frame++)
+            {
+                jobPool.parallelFor(count, grainSize, [&](size_t first, size_t end)
+                {
+                    animation.animate(positions.data(), frame, modelView, first, end);
+                });
+            }
+            printf(" %13.2f", seconds(begin) / frames / count * 1e9);
+        }
+        printf("\n");
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,805 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that checks that every path of the batch math functions returns the same
+ bits as the scalar helpers, and measures their throughput.
+*/
+
+#include "../Renderer/AAPLMathBatch.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+// The helpers of AAPLMathUtilities.cpp need the simd library, so the tool checks against them
+// where it exists, and against copies of their expressions elsewhere.
+#if __has_include(<simd/simd.h>)
+#include "../Renderer/AAPLMathUtilities.h"
+#define AAPL_HAS_MATH_UTILITIES 1
+#endif
+
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+// GCC's SLP vectorizer can still turn alternating adds and subtracts into fused instructions.
+#pragma GCC optimize("fp-contract=off", "no-tree-slp-vectorize")
+#endif
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --sizes LIST         Comma separated element counts (default 1000,10000,100000,1000000)\n"
+            "  --runs N             Runs of each function, keeping the fastest (default 5)\n",
+            program);
+}
+
+std::vector<uint32_t> parseList(const char* list)
+{
+    std::vector<uint32_t> values;
+    for(const char* p = list; p; )
+    {
+        values.push_back((uint32_t)atoi(p));
+        p = strchr(p, ',');
+        if(p)
+        {
+            ++p;
+        }
+    }
+    return values;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// MARK: - Scalar helpers
+
+struct Quaternion
+{
+    float x, y, z, w;
+};
+
+#if AAPL_HAS_MATH_UTILITIES
+
+Quaternion referenceQuaternionMultiply(Quaternion a, Quaternion b)
+{
+    quaternion_float q = quaternion_multiply(quaternion(a.x, a.y, a.z, a.w), quaternion(b.x, b.y, b.z, b.w));
+    return { q.x, q.y, q.z, q.w };
+}
+
+void referenceMatrixFromQuaternion(float* matrix, Quaternion q)
+{
+    matrix_float4x4 m = matrix4x4_from_quaternion(quaternion(q.x, q.y, q.z, q.w));
+    memcpy(matrix, &m, sizeof(m));
+}
+
+#else
+
+// The expressions of quaternion_multiply.
+Quaternion referenceQuaternionMultiply(Quaternion q0, Quaternion q1)
+{
+    Quaternion q;
+    q.x = q0.w*q1.x + q0.x*q1.w + q0.y*q1.z - q0.z*q1.y;
+    q.y = q0.w*q1.y - q0.x*q1.z + q0.y*q1.w + q0.z*q1.x;
+    q.z = q0.w*q1.z + q0.x*q1.y - q0.y*q1.x + q0.z*q1.w;
+    q.w = q0.w*q1.w - q0.x*q1.x - q0.y*q1.y - q0.z*q1.z;
+    return q;
+}
+
+// The expressions of matrix4x4_from_quaternion.
+void referenceMatrixFromQuaternion(float* matrix, Quaternion q)
+{
+    float xx = q.x * q.x;
+    float xy = q.x * q.y;
+    float xz = q.x * q.z;
+    float xw = q.x * q.w;
+    float yy = q.y * q.y;
+    float yz = q.y * q.z;
+    float yw = q.y * q.w;
+    float zz = q.z * q.z;
+    float zw = q.z * q.w;
+
+    // indices are m<column><row>
+    float m00 = 1 - 2 * (yy + zz);
+    float m10 = 2 * (xy - zw);
+    float m20 = 2 * (xz + yw);
+
+    float m01 = 2 * (xy + zw);
+    float m11 = 1 - 2 * (xx + zz);
+    float m21 = 2 * (yz - xw);
+
+    float m02 = 2 * (xz - yw);
+    float m12 = 2 * (yz + xw);
+    float m22 = 1 - 2 * (xx + yy);
+
+    const float columns[16] =
+    {
+        m00, m01, m02, 0,
+        m10, m11, m12, 0,
+        m20, m21, m22, 0,
+          0,   0,   0, 1
+    };
+    memcpy(matrix, columns, sizeof(columns));
+}
+
+#endif
+
+// Multiplies matrices column by column, summing the columns of the left matrix in order.
+void referenceMatrixMultiply(float* result, const float* a, const float* b)
+{
+    for(int column = 0; column < 4; column++)
+    {
+        for(int row = 0; row < 4; row++)
+        {
+            result[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+                                       a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+        }
+    }
+}
+
+// The batch functions normalize with a division by the length, which the simd library's
+// normalize may round differently, so the tool checks them against copies of their
+// expressions everywhere, and against the helpers to within rounding where they exist.
+
+void normalize(float& x, float& y, float& z)
+{
+    const float length = sqrtf(x * x + y * y + z * z);
+    x = x / length;
+    y = y / length;
+    z = z / length;
+}
+
+// The expressions of matrix4x4_rotation.
+void referenceRotation(float* matrix, float radians, float x, float y, float z)
+{
+    normalize(x, y, z);
+    float ct = cosf(radians);
+    float st = sinf(radians);
+    float ci = 1 - ct;
+
+    const float columns[16] =
+    {
+        ct + x * x * ci,     y * x * ci + z * st, z * x * ci - y * st, 0,
+        x * y * ci - z * st, ct + y * y * ci,     z * y * ci + x * st, 0,
+        x * z * ci + y * st, y * z * ci - x * st, ct + z * z * ci,     0,
+        0,                   0,                   0,                   1
+    };
+    memcpy(matrix, columns, sizeof(columns));
+}
+
+// The expressions of matrix_look_at_left_hand.
+void referenceLookAt(float* matrix, const float eye[3], const float target[3], const float up[3])
+{
+    float z[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+    normalize(z[0], z[1], z[2]);
+
+    float x[3] = { up[1] * z[2] - up[2] * z[1], up[2] * z[0] - up[0] * z[2], up[0] * z[1] - up[1] * z[0] };
+    normalize(x[0], x[1], x[2]);
+
+    const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+    const float columns[16] =
+    {
+        x[0], y[0], z[0], 0,
+        x[1], y[1], z[1], 0,
+        x[2], y[2], z[2], 0,
+        -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]),
+        -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]),
+        -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]),
+        1
+    };
+    memcpy(matrix, columns, sizeof(columns));
+}
+
+// The inverse transpose from cofactors, reading the column-major matrix as the row-major
+// matrix `a`, which is its transpose, and writing the inverse of `a` column major.
+void referenceInverseTranspose(float* result, const float* a)
+{
+    const float s0 = a[0] * a[5] - a[4] * a[1];
+    const float s1 = a[0] * a[6] - a[4] * a[2];
+    const float s2 = a[0] * a[7] - a[4] * a[3];
+    const float s3 = a[1] * a[6] - a[5] * a[2];
+    const float s4 = a[1] * a[7] - a[5] * a[3];
+    const float s5 = a[2] * a[7] - a[6] * a[3];
+
+    const float c0 = a[8] * a[13] - a[12] * a[9];
+    const float c1 = a[8] * a[14] - a[12] * a[10];
+    const float c2 = a[8] * a[15] - a[12] * a[11];
+    const float c3 = a[9] * a[14] - a[13] * a[10];
+    const float c4 = a[9] * a[15] - a[13] * a[11];
+    const float c5 = a[10] * a[15] - a[14] * a[11];
+
+    const float positive = 1 / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+    const float negative = positive * -1;
+
+    const float inverse[16] =
+    {
+        (a[5] * c5 - a[6] * c4 + a[7] * c3) * positive,
+        (a[1] * c5 - a[2] * c4 + a[3] * c3) * negative,
+        (a[13] * s5 - a[14] * s4 + a[15] * s3) * positive,
+        (a[9] * s5 - a[10] * s4 + a[11] * s3) * negative,
+        (a[4] * c5 - a[6] * c2 + a[7] * c1) * negative,
+        (a[0] * c5 - a[2] * c2 + a[3] * c1) * positive,
+        (a[12] * s5 - a[14] * s2 + a[15] * s1) * negative,
+        (a[8] * s5 - a[10] * s2 + a[11] * s1) * positive,
+        (a[4] * c4 - a[5] * c2 + a[7] * c0) * positive,
+        (a[0] * c4 - a[1] * c2 + a[3] * c0) * negative,
+        (a[12] * s4 - a[13] * s2 + a[15] * s0) * positive,
+        (a[8] * s4 - a[9] * s2 + a[11] * s0) * negative,
+        (a[4] * c3 - a[5] * c1 + a[6] * c0) * negative,
+        (a[0] * c3 - a[1] * c1 + a[2] * c0) * positive,
+        (a[12] * s3 - a[13] * s1 + a[14] * s0) * negative,
+        (a[8] * s3 - a[9] * s1 + a[10] * s0) * positive,
+    };
+
+    for(int row = 0; row < 4; row++)
+    {
+        for(int column = 0; column < 4; column++)
+        {
+            result[column * 4 + row] = inverse[row * 4 + column];
+        }
+    }
+}
+
+// MARK: - Data
+
+struct QuaternionArrays
+{
+    std::vector<float> x, y, z, w;
+
+    explicit QuaternionArrays(size_t count) : x(count), y(count), z(count), w(count) {}
+
+    quaternion_float_soa soa() { return { x.data(), y.data(), z.data(), w.data() }; }
+
+    Quaternion operator[](size_t i) const { return { x[i], y[i], z[i], w[i] }; }
+
+    bool operator==(const QuaternionArrays& other) const
+    {
+        return x == other.x && y == other.y && z == other.z && w == other.w;
+    }
+};
+
+struct VectorArrays
+{
+    std::vector<float> x, y, z;
+
+    explicit VectorArrays(size_t count) : x(count), y(count), z(count) {}
+
+    vector_float3_soa soa() { return { x.data(), y.data(), z.data() }; }
+};
+
+struct SphereArrays
+{
+    std::vector<float> x, y, z, radius;
+
+    explicit SphereArrays(size_t count) : x(count), y(count), z(count), radius(count) {}
+
+    sphere_float_soa soa() { return { x.data(), y.data(), z.data(), radius.data() }; }
+
+    bool operator==(const SphereArrays& other) const
+    {
+        return x == other.x && y == other.y && z == other.z && radius == other.radius;
+    }
+};
+
+// Compares floats by their bits, so that the checks tell apart values that compare equal,
+// like 0 and -0.
+bool sameBits(const std::vector<float>& a, const std::vector<float>& b)
+{
+    return a.size() == b.size() && !memcmp(a.data(), b.data(), a.size() * sizeof(float));
+}
+
+bool sameBits(const QuaternionArrays& a, const QuaternionArrays& b)
+{
+    return sameBits(a.x, b.x) && sameBits(a.y, b.y) && sameBits(a.z, b.z) && sameBits(a.w, b.w);
+}
+
+bool sameBits(const SphereArrays& a, const SphereArrays& b)
+{
+    return sameBits(a.x, b.x) && sameBits(a.y, b.y) && sameBits(a.z, b.z) && sameBits(a.radius, b.radius);
+}
+
+struct Inputs
+{
+    QuaternionArrays        q0, q1;
+    std::vector<float>      radians;
+    VectorArrays            axes, eyes, targets, ups;
+    std::vector<float>      matrices0, matrices1;
+    std::vector<float>      transforms;
+    SphereArrays            spheres;
+    float                   view[16];
+
+    explicit Inputs(size_t count)
+    : q0(count)
+    , q1(count)
+    , radians(count)
+    , axes(count)
+    , eyes(count)
+    , targets(count)
+    , ups(count)
+    , matrices0(count * 16)
+    , matrices1(count * 16)
+    , transforms(count * 16)
+    , spheres(count)
+    {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+        for(QuaternionArrays* q : { &q0, &q1 })
+        {
+            for(size_t i = 0; i < count; i++)
+            {
+                float x = unit(random), y = unit(random), z = unit(random), w = unit(random);
+                const float length = sqrtf(x * x + y * y + z * z + w * w);
+                q->x[i] = x / length;
+                q->y[i] = y / length;
+                q->z[i] = z / length;
+                q->w[i] = w / length;
+            }
+        }
+
+        for(size_t i = 0; i < count; i++)
+        {
+            radians[i] = unit(random) * 4.0f;
+            for(VectorArrays* v : { &axes, &eyes, &targets, &ups })
+            {
+                v->x[i] = unit(random) * 50.0f;
+                v->y[i] = unit(random) * 50.0f;
+                v->z[i] = unit(random) * 50.0f;
+            }
+        }
+
+        // Transforms whose diagonals dominate, so that their inverses are accurate.
+        for(size_t i = 0; i < transforms.size(); i++)
+        {
+            transforms[i] = unit(random) + ((i % 16) % 5 == 0 ? 8.0f : 0.0f);
+        }
+
+        for(float& value : matrices0)
+        {
+            value = unit(random) * 10.0f;
+        }
+        for(float& value : matrices1)
+        {
+            value = unit(random) * 10.0f;
+        }
+
+        for(size_t i = 0; i < count; i++)
+        {
+            spheres.x[i] = unit(random) * 100.0f;
+            spheres.y[i] = unit(random) * 100.0f;
+            spheres.z[i] = unit(random) * 100.0f;
+            spheres.radius[i] = (unit(random) + 1.0f) * 5.0f;
+        }
+
+        for(float& value : view)
+        {
+            value = unit(random);
+        }
+    }
+};
+
+// MARK: - Checks
+
+struct Outputs
+{
+    QuaternionArrays        products;
+    std::vector<float>      rotations;
+    std::vector<float>      axisRotations;
+    std::vector<float>      views;
+    std::vector<float>      inverseTransposes;
+    std::vector<float>      pairProducts;
+    std::vector<float>      viewProducts;
+    SphereArrays            spheres;
+
+    explicit Outputs(size_t count)
+    : products(count)
+    , rotations(count * 16)
+    , axisRotations(count * 16)
+    , views(count * 16)
+    , inverseTransposes(count * 16)
+    , pairProducts(count * 16)
+    , viewProducts(count * 16)
+    , spheres(count)
+    {
+    }
+
+    void compute(Inputs& inputs, size_t count)
+    {
+        quaternion_multiply_batch(products.soa(), inputs.q0.soa(), inputs.q1.soa(), count);
+        matrix4x4_from_quaternion_batch(rotations.data(), inputs.q0.soa(), count);
+        matrix4x4_rotation_batch(axisRotations.data(), inputs.radians.data(), inputs.axes.soa(), count);
+        matrix_look_at_left_hand_batch(views.data(), inputs.eyes.soa(), inputs.targets.soa(), inputs.ups.soa(), count);
+        matrix_inverse_transpose_batch(inverseTransposes.data(), inputs.transforms.data(), count);
+        matrix_multiply_batch(pairProducts.data(), inputs.matrices0.data(), inputs.matrices1.data(), count);
+        matrix_premultiply_batch(viewProducts.data(), inputs.view, inputs.matrices1.data(), count);
+        sphere_transform_batch(spheres.soa(), inputs.view, inputs.spheres.soa(), count);
+    }
+};
+
+// Checks the scalar path against the helpers, and every other path against the scalar path,
+// with a count that leaves a partial vector at the end.  Returns the number of failures.
+int check(size_t count)
+{
+    int failures = 0;
+    Inputs inputs(count);
+
+    math_batch_set_path(MathBatchPathScalar);
+    Outputs scalar(count);
+    scalar.compute(inputs, count);
+
+    size_t mismatches = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        const Quaternion q = referenceQuaternionMultiply(inputs.q0[i], inputs.q1[i]);
+        const Quaternion product = scalar.products[i];
+        if(memcmp(&q, &product, sizeof(q)))
+        {
+            mismatches++;
+        }
+
+        float matrix[16];
+        referenceMatrixFromQuaternion(matrix, inputs.q0[i]);
+        if(memcmp(matrix, &scalar.rotations[i * 16], sizeof(matrix)))
+        {
+            mismatches++;
+        }
+
+        referenceRotation(matrix, inputs.radians[i], inputs.axes.x[i], inputs.axes.y[i], inputs.axes.z[i]);
+        if(memcmp(matrix, &scalar.axisRotations[i * 16], sizeof(matrix)))
+        {
+            mismatches++;
+        }
+
+        const float eye[3] = { inputs.eyes.x[i], inputs.eyes.y[i], inputs.eyes.z[i] };
+        const float target[3] = { inputs.targets.x[i], inputs.targets.y[i], inputs.targets.z[i] };
+        const float up[3] = { inputs.ups.x[i], inputs.ups.y[i], inputs.ups.z[i] };
+        referenceLookAt(matrix, eye, target, up);
+        if(memcmp(matrix, &scalar.views[i * 16], sizeof(matrix)))
+        {
+            mismatches++;
+        }
+
+        referenceInverseTranspose(matrix, &inputs.transforms[i * 16]);
+        if(memcmp(matrix, &scalar.inverseTransposes[i * 16], sizeof(matrix)))
+        {
+            mismatches++;
+        }
+
+        referenceMatrixMultiply(matrix, &inputs.matrices0[i * 16], &inputs.matrices1[i * 16]);
+        if(memcmp(matrix, &scalar.pairProducts[i * 16], sizeof(matrix)))
+        {
+            mismatches++;
+        }
+
+        referenceMatrixMultiply(matrix, inputs.view, &inputs.matrices1[i * 16]);
+        if(memcmp(matrix, &scalar.viewProducts[i * 16], sizeof(matrix)))
+        {
+            mismatches++;
+        }
+    }
+    printf("Scalar path against the scalar helpers: %s\n", mismatches ? "FAILED" : "same bits");
+    failures += mismatches != 0;
+
+    // The transpose of each inverse transpose times its matrix is the identity.
+    float worstError = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        float inverse[16], product[16];
+        for(int column = 0; column < 4; column++)
+        {
+            for(int row = 0; row < 4; row++)
+            {
+                inverse[column * 4 + row] = scalar.inverseTransposes[i * 16 + row * 4 + column];
+            }
+        }
+        referenceMatrixMultiply(product, inverse, &inputs.transforms[i * 16]);
+        for(int element = 0; element < 16; element++)
+        {
+            worstError = std::max(worstError, fabsf(product[element] - (element % 5 == 0 ? 1.0f : 0.0f)));
+        }
+    }
+    printf("Inverse transposes against the identity: %s (largest error %g)\n",
+           worstError < 1e-5f ? "within rounding" : "FAILED", worstError);
+    failures += !(worstError < 1e-5f);
+
+#if AAPL_HAS_MATH_UTILITIES
+    float worstDifference = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        const vector_float3 axis = { inputs.axes.x[i], inputs.axes.y[i], inputs.axes.z[i] };
+        const vector_float3 eye = { inputs.eyes.x[i], inputs.eyes.y[i], inputs.eyes.z[i] };
+        const vector_float3 target = { inputs.targets.x[i], inputs.targets.y[i], inputs.targets.z[i] };
+        const vector_float3 up = { inputs.ups.x[i], inputs.ups.y[i], inputs.ups.z[i] };
+        matrix_float4x4 transform;
+        memcpy(&transform, &inputs.transforms[i * 16], sizeof(transform));
+
+        const matrix_float4x4 helpers[3] =
+        {
+            matrix4x4_rotation(inputs.radians[i], axis),
+            matrix_look_at_left_hand(eye, target, up),
+            matrix_inverse_transpose(transform),
+        };
+        const float* batches[3] = { &scalar.axisRotations[i * 16], &scalar.views[i * 16], &scalar.inverseTransposes[i * 16] };
+
+        for(int function = 0; function < 3; function++)
+        {
+            const float* helper = (const float*)&helpers[function];
+            for(int element = 0; element < 16; element++)
+            {
+                const float difference = fabsf(helper[element] - batches[function][element]);
+                worstDifference = std::max(worstDifference, difference / std::max(1.0f, fabsf(helper[element])));
+            }
+        }
+    }
+    printf("Rotations, views and inverse transposes against the helpers: %s (largest difference %g)\n",
+           worstDifference < 1e-5f ? "within rounding" : "FAILED", worstDifference);
+    failures += !(worstDifference < 1e-5f);
+#endif
+
+    for(MathBatchPath path : { MathBatchPathSSE41, MathBatchPathAVX2, MathBatchPathAVX512, MathBatchPathNEON })
+    {
+        if(!math_batch_set_path(path))
+        {
+            continue;
+        }
+
+        Outputs outputs(count);
+        outputs.compute(inputs, count);
+
+        const bool same = sameBits(outputs.products, scalar.products) &&
+                          sameBits(outputs.rotations, scalar.rotations) &&
+                          sameBits(outputs.axisRotations, scalar.axisRotations) &&
+                          sameBits(outputs.views, scalar.views) &&
+                          sameBits(outputs.inverseTransposes, scalar.inverseTransposes) &&
+                          sameBits(outputs.pairProducts, scalar.pairProducts) &&
+                          sameBits(outputs.viewProducts, scalar.viewProducts) &&
+                          sameBits(outputs.spheres, scalar.spheres);
+
+        // Results may also overwrite their inputs.
+        Inputs inPlace(count);
+        quaternion_multiply_batch(inPlace.q0.soa(), inPlace.q0.soa(), inPlace.q1.soa(), count);
+        matrix_multiply_batch(inPlace.matrices0.data(), inPlace.matrices0.data(), inPlace.matrices1.data(), count);
+        matrix_inverse_transpose_batch(inPlace.transforms.data(), inPlace.transforms.data(), count);
+        sphere_transform_batch(inPlace.spheres.soa(), inPlace.view, inPlace.spheres.soa(), count);
+        const bool sameInPlace = sameBits(inPlace.q0, scalar.products) &&
+                                 sameBits(inPlace.transforms, scalar.inverseTransposes) &&
+                                 sameBits(inPlace.matrices0, scalar.pairProducts) &&
+                                 sameBits(inPlace.spheres, scalar.spheres);
+
+        printf("%-7s path against the scalar path: %s\n", math_batch_path_name(path),
+               same && sameInPlace ? "same bits" : "FAILED");
+        failures += !(same && sameInPlace);
+    }
+
+    return failures;
+}
+
+// MARK: - Throughput
+
+template <typename Function>
+double bestTime(uint32_t runs, Function function)
+{
+    double best = INFINITY;
+    for(uint32_t run = 0; run < runs; run++)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        function();
+        best = std::min(best, seconds(begin));
+    }
+    return best;
+}
+
+void measure(size_t count, uint32_t runs)
+{
+    Inputs inputs(count);
+    Outputs outputs(count);
+
+    printf("\n%zu elements, millions per second\n", count);
+    printf("  %-28s %10s", "", "per call");
+    std::vector<MathBatchPath> paths;
+    for(MathBatchPath path : { MathBatchPathScalar, MathBatchPathSSE41, MathBatchPathAVX2,
+                               MathBatchPathAVX512, MathBatchPathNEON })
+    {
+        if(math_batch_path_supported(path))
+        {
+            paths.push_back(path);
+            printf(" %10s", math_batch_path_name(path));
+        }
+    }
+    printf("\n");
+
+    struct Function
+    {
+        const char* name;
+        void (*call)(Inputs&, Outputs&, size_t);
+        void (*perElement)(Inputs&, Outputs&, size_t);
+    };
+
+    const Function functions[] =
+    {
+        {
+            "quaternion_multiply",
+            [](Inputs& in, Outputs& out, size_t n) { quaternion_multiply_batch(out.products.soa(), in.q0.soa(), in.q1.soa(), n); },
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                for(size_t i = 0; i < n; i++)
+                {
+                    const Quaternion q = referenceQuaternionMultiply(in.q0[i], in.q1[i]);
+                    out.products.x[i] = q.x;
+                    out.products.y[i] = q.y;
+                    out.products.z[i] = q.z;
+                    out.products.w[i] = q.w;
+                }
+            }
+        },
+        {
+            "matrix4x4_from_quaternion",
+            [](Inputs& in, Outputs& out, size_t n) { matrix4x4_from_quaternion_batch(out.rotations.data(), in.q0.soa(), n); },
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                for(size_t i = 0; i < n; i++)
+                {
+                    referenceMatrixFromQuaternion(&out.rotations[i * 16], in.q0[i]);
+                }
+            }
+        },
+        {
+            "matrix4x4_rotation",
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                matrix4x4_rotation_batch(out.axisRotations.data(), in.radians.data(), in.axes.soa(), n);
+            },
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                for(size_t i = 0; i < n; i++)
+                {
+                    referenceRotation(&out.axisRotations[i * 16], in.radians[i], in.axes.x[i], in.axes.y[i], in.axes.z[i]);
+                }
+            }
+        },
+        {
+            "matrix_look_at_left_hand",
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                matrix_look_at_left_hand_batch(out.views.data(), in.eyes.soa(), in.targets.soa(), in.ups.soa(), n);
+            },
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                for(size_t i = 0; i < n; i++)
+                {
+                    const float eye[3] = { in.eyes.x[i], in.eyes.y[i], in.eyes.z[i] };
+                    const float target[3] = { in.targets.x[i], in.targets.y[i], in.targets.z[i] };
+                    const float up[3] = { in.ups.x[i], in.ups.y[i], in.ups.z[i] };
+                    referenceLookAt(&out.views[i * 16], eye, target, up);
+                }
+            }
+        },
+        {
+            "matrix_inverse_transpose",
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                matrix_inverse_transpose_batch(out.inverseTransposes.data(), in.transforms.data(), n);
+            },
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                for(size_t i = 0; i < n; i++)
+                {
+                    referenceInverseTranspose(&out.inverseTransposes[i * 16], &in.transforms[i * 16]);
+                }
+            }
+        },
+        {
+            "matrix_multiply",
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                matrix_multiply_batch(out.pairProducts.data(), in.matrices0.data(), in.matrices1.data(), n);
+            },
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                for(size_t i = 0; i < n; i++)
+                {
+                    referenceMatrixMultiply(&out.pairProducts[i * 16], &in.matrices0[i * 16], &in.matrices1[i * 16]);
+                }
+            }
+        },
+        {
+            "matrix_premultiply",
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                matrix_premultiply_batch(out.viewProducts.data(), in.view, in.matrices1.data(), n);
+            },
+            [](Inputs& in, Outputs& out, size_t n)
+            {
+                for(size_t i = 0; i < n; i++)
+                {
+                    referenceMatrixMultiply(&out.viewProducts[i * 16], in.view, &in.matrices1[i * 16]);
+                }
+            }
+        },
+        {
+            "sphere_transform",
+            [](Inputs& in, Outputs& out, size_t n) { sphere_transform_batch(out.spheres.soa(), in.view, in.spheres.soa(), n); },
+            nullptr
+        },
+    };
+
+    for(const Function& function : functions)
+    {
+        printf("  %-28s", function.name);
+
+        if(function.perElement)
+        {
+            const double time = bestTime(runs, [&] { function.perElement(inputs, outputs, count); });
+            printf(" %10.1f", count / time * 1e-6);
+        }
+        else
+        {
+            printf(" %10s", "-");
+        }
+
+        for(MathBatchPath path : paths)
+        {
+            math_batch_set_path(path);
+            const double time = bestTime(runs, [&] { function.call(inputs, outputs, count); });
+            printf(" %10.1f", count / time * 1e-6);
+        }
+        printf("\n");
+    }
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    std::vector<uint32_t> sizes = { 1000, 10000, 100000, 1000000 };
+    uint32_t runs = 5;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--sizes") && i + 1 < argc)
+        {
+            sizes = parseList(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--runs") && i + 1 < argc)
+        {
+            runs = (uint32_t)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(runs == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const MathBatchPath widestPath = math_batch_path();
+    printf("Widest supported path: %s\n", math_batch_path_name(widestPath));
+
+    const int failures = check(10007);
+
+    for(uint32_t size : sizes)
+    {
+        measure(size, runs);
+    }
+
+    return failures ? 1 : 0;
+}
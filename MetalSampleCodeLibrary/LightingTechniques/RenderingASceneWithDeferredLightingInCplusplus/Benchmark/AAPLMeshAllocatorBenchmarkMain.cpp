@@ -0,0 +1,638 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that loads thousands of generated sphere meshes through the arena allocators,
+ with memory in place of Metal buffers, checks how they're packed and how many allocations the
+ load makes, and measures the allocators against the system allocator.
+*/
+
+#include "../Renderer/AAPLArena.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// MARK: - Allocation counting
+
+// Counts every allocation through `new`, which the standard library's containers also use.
+static std::atomic<size_t> s_allocationCount( 0 );
+
+void* operator new(size_t size)
+{
+    s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if(void* pMemory = malloc(size ? size : 1))
+    {
+        return pMemory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pMemory) noexcept
+{
+    free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+    free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+    free(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+    free(pMemory);
+}
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --meshes N           Sphere meshes to load (default 5000)\n"
+            "  --page-size N        Bytes in each page of mesh data (default 1048576)\n"
+            "  --allocations N      Allocations in each measured frame (default 10000)\n"
+            "  --frames N           Frames to measure (default 200)\n",
+            program);
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// MARK: - Mesh loading
+
+// The alignment of mesh buffers in the renderer's Metal buffers
+const size_t MeshBufferAlignment = 256;
+
+// Strides of the sky's vertex buffers: a float3 position and a float3 normal.
+const size_t PositionStride = 12;
+const size_t NormalStride = 12;
+
+/// Where a mesh's index and vertex data landed, and a checksum of the indices it wrote.
+struct LoadedMesh
+{
+    PagedSubAllocator::Allocation buffers[3];
+    size_t lengths[3];
+    uint32_t indexChecksum;
+};
+
+/// Backs each page of a `PagedSubAllocator` with aligned memory, like `MeshBufferAllocator`
+/// backs them with Metal buffers.
+class MeshMemory
+{
+public:
+
+    explicit MeshMemory(size_t pageSize)
+    : m_pages(pageSize)
+    {
+    }
+
+    PagedSubAllocator::Allocation allocate(size_t length)
+    {
+        const PagedSubAllocator::Allocation allocation = m_pages.allocate(length, MeshBufferAlignment);
+        while(m_memory.size() < m_pages.pageCount())
+        {
+            const size_t size = m_pages.pageSize((uint32_t)m_memory.size()) + MeshBufferAlignment;
+            m_memory.emplace_back(new uint8_t[size]);
+        }
+        return allocation;
+    }
+
+    uint8_t* contents(const PagedSubAllocator::Allocation& allocation) const
+    {
+        const uintptr_t base = (uintptr_t)m_memory[allocation.page].get();
+        return (uint8_t*)((base + MeshBufferAlignment - 1) & ~(uintptr_t)(MeshBufferAlignment - 1)) + allocation.offset;
+    }
+
+    const PagedSubAllocator& pages() const { return m_pages; }
+
+private:
+
+    PagedSubAllocator m_pages;
+    std::vector<std::unique_ptr<uint8_t[]>> m_memory;
+};
+
+uint32_t checksum(const uint16_t* indices, size_t count)
+{
+    uint32_t value = 2166136261u;
+    for(size_t i = 0; i < count; i++)
+    {
+        value = (value ^ indices[i]) * 16777619u;
+    }
+    return value;
+}
+
+/// Builds a sphere like `makeSphereMesh`: allocates its index and vertex buffers, keeps its
+/// positions in scratch memory, and reorders its vertices through a scratch remap table.
+LoadedMesh loadSphere(MeshMemory& memory, LinearArena& scratch,
+                      uint32_t radialSegments, uint32_t verticalSegments, float radius)
+{
+    const size_t vertexCount = 2 + radialSegments * (verticalSegments - 1);
+    const size_t indexCount = 6 * radialSegments * (verticalSegments - 1);
+
+    LoadedMesh mesh;
+    mesh.lengths[0] = indexCount * sizeof(uint16_t);
+    mesh.lengths[1] = vertexCount * PositionStride;
+    mesh.lengths[2] = vertexCount * NormalStride;
+    for(int i = 0; i < 3; i++)
+    {
+        mesh.buffers[i] = memory.allocate(mesh.lengths[i]);
+    }
+
+    LinearArena::Scope scope(scratch);
+    float* positions = scratch.allocateArray<float>(vertexCount * 4);
+    size_t positionCount = 0;
+
+    auto addVertex = [&](float x, float y, float z)
+    {
+        float* pPosition = positions + 4 * positionCount++;
+        pPosition[0] = radius * x;
+        pPosition[1] = radius * y;
+        pPosition[2] = radius * z;
+        pPosition[3] = 1;
+    };
+
+    addVertex(0, 1, 0);
+    for(uint32_t vertical = 1; vertical < verticalSegments; vertical++)
+    {
+        const double verticalPosition = vertical * M_PI / verticalSegments;
+        for(uint32_t radial = 0; radial < radialSegments; radial++)
+        {
+            const double radialPosition = radial * 2 * M_PI / radialSegments;
+            addVertex(sin(verticalPosition) * cos(radialPosition),
+                      cos(verticalPosition),
+                      sin(verticalPosition) * sin(radialPosition));
+        }
+    }
+    addVertex(0, -1, 0);
+
+    uint16_t* indices = (uint16_t*)memory.contents(mesh.buffers[0]);
+    size_t currentIndex = 0;
+    for(uint32_t phi = 0; phi < radialSegments; phi++)
+    {
+        indices[currentIndex++] = 0;
+        indices[currentIndex++] = 1 + (phi + 1) % radialSegments;
+        indices[currentIndex++] = 1 + phi;
+    }
+    for(uint32_t theta = 0; theta + 2 < verticalSegments; theta++)
+    {
+        for(uint32_t phi = 0; phi < radialSegments; phi++)
+        {
+            const uint16_t topRight = 1 + theta * radialSegments + phi;
+            const uint16_t topLeft = 1 + theta * radialSegments + (phi + 1) % radialSegments;
+            const uint16_t bottomRight = topRight + radialSegments;
+            const uint16_t bottomLeft = topLeft + radialSegments;
+            const uint16_t quad[] = { topRight, bottomLeft, bottomRight, topRight, topLeft, bottomLeft };
+            memcpy(indices + currentIndex, quad, sizeof(quad));
+            currentIndex += 6;
+        }
+    }
+    const uint16_t lastIndex = (uint16_t)(vertexCount - 1);
+    for(uint32_t phi = 0; phi < radialSegments; phi++)
+    {
+        indices[currentIndex++] = lastIndex;
+        indices[currentIndex++] = lastIndex - radialSegments + phi;
+        indices[currentIndex++] = lastIndex - radialSegments + (phi + 1) % radialSegments;
+    }
+
+    // Number the vertices in the order the triangles first use them, as the optimizer does.
+    uint32_t* remap = scratch.allocateArray<uint32_t>(vertexCount);
+    memset(remap, 0xFF, vertexCount * sizeof(uint32_t));
+    uint32_t nextVertex = 0;
+    for(size_t i = 0; i < indexCount; i++)
+    {
+        if(remap[indices[i]] == UINT32_MAX)
+        {
+            remap[indices[i]] = nextVertex++;
+        }
+        indices[i] = (uint16_t)remap[indices[i]];
+    }
+
+    float* pPositionData = (float*)memory.contents(mesh.buffers[1]);
+    float* pNormalData = (float*)memory.contents(mesh.buffers[2]);
+    for(size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        const float* pPosition = positions + 4 * vertex;
+        float* pOutPosition = pPositionData + 3 * remap[vertex];
+        float* pOutNormal = pNormalData + 3 * remap[vertex];
+        for(int i = 0; i < 3; i++)
+        {
+            pOutPosition[i] = pPosition[i];
+            pOutNormal[i] = pPosition[i] / radius;
+        }
+    }
+
+    mesh.indexChecksum = checksum(indices, indexCount);
+    return mesh;
+}
+
+// MARK: - Checks
+
+/// Returns an empty string if every mesh's buffers are aligned, inside their page, apart from
+/// every other buffer, and still hold what the mesh wrote, or a description of what's wrong.
+std::string checkMeshes(const MeshMemory& memory, const std::vector<LoadedMesh>& meshes)
+{
+    struct Range
+    {
+        uint32_t page;
+        size_t begin;
+        size_t end;
+    };
+
+    std::vector<Range> ranges;
+    for(const LoadedMesh& mesh : meshes)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            const PagedSubAllocator::Allocation& allocation = mesh.buffers[i];
+            if((uintptr_t)memory.contents(allocation) % MeshBufferAlignment)
+            {
+                return "a buffer isn't aligned";
+            }
+            if(allocation.offset + mesh.lengths[i] > memory.pages().pageSize(allocation.page))
+            {
+                return "a buffer runs past the end of its page";
+            }
+            ranges.push_back(Range{ allocation.page, allocation.offset, allocation.offset + mesh.lengths[i] });
+        }
+
+        const size_t indexCount = mesh.lengths[0] / sizeof(uint16_t);
+        if(checksum((const uint16_t*)memory.contents(mesh.buffers[0]), indexCount) != mesh.indexChecksum)
+        {
+            return "another mesh overwrote a mesh's indices";
+        }
+    }
+
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b)
+    {
+        return a.page != b.page ? a.page < b.page : a.begin < b.begin;
+    });
+    for(size_t i = 1; i < ranges.size(); i++)
+    {
+        if(ranges[i].page == ranges[i - 1].page && ranges[i].begin < ranges[i - 1].end)
+        {
+            return "two buffers overlap";
+        }
+    }
+    return std::string();
+}
+
+void printStats(const char* name, const AllocatorStats& stats)
+{
+    printf("  %-8s %8zu allocations, %8.2f MB requested, %8.2f MB high water, %5zu blocks, %8.2f MB reserved\n",
+           name, stats.allocationCount, stats.bytesRequested / 1e6, stats.highWaterBytes / 1e6,
+           stats.blockCount, stats.bytesReserved / 1e6);
+}
+
+/// Loads `meshCount` spheres of random sizes, checks them, and returns the number of failures.
+uint32_t checkLoad(uint32_t meshCount, size_t pageSize)
+{
+    std::mt19937 random(7);
+    std::uniform_int_distribution<uint32_t> segments(4, 48);
+
+    // The largest sphere's scratch memory: its positions and its remap table
+    const size_t largestVertexCount = 2 + 48 * 47;
+    const size_t largestScratch = largestVertexCount * (4 * sizeof(float) + sizeof(uint32_t)) + 2 * alignof(max_align_t);
+
+    std::vector<LoadedMesh> meshes;
+    meshes.reserve(meshCount);
+
+    MeshMemory memory(pageSize);
+    LinearArena scratch;
+
+    const size_t allocationsBefore = s_allocationCount.load();
+    const auto begin = std::chrono::steady_clock::now();
+    size_t unpackedBytes = 0;
+    for(uint32_t i = 0; i < meshCount; i++)
+    {
+        meshes.push_back(loadSphere(memory, scratch, segments(random), segments(random), 1 + i % 8));
+
+        // What a Metal buffer per mesh, with each section aligned, would have reserved
+        for(size_t length : meshes.back().lengths)
+        {
+            unpackedBytes += (length + MeshBufferAlignment - 1) & ~(MeshBufferAlignment - 1);
+        }
+    }
+    const double loadSeconds = seconds(begin);
+    const size_t allocations = s_allocationCount.load() - allocationsBefore;
+
+    const AllocatorStats& pageStats = memory.pages().stats();
+    const AllocatorStats& scratchStats = scratch.stats();
+
+    printf("Loading %u sphere meshes into %zu byte pages (%.1f microseconds per mesh):\n",
+           meshCount, pageSize, loadSeconds * 1e6 / meshCount);
+    printStats("pages", pageStats);
+    printStats("scratch", scratchStats);
+    printf("  %zu system allocations, against %u for a buffer per mesh; %.1f%% of a buffer per mesh's bytes\n",
+           allocations, meshCount, 100.0 * pageStats.bytesReserved / unpackedBytes);
+
+    uint32_t failures = 0;
+    const std::string error = checkMeshes(memory, meshes);
+    if(!error.empty())
+    {
+        printf("  FAILED: %s\n", error.c_str());
+        failures++;
+    }
+
+    // Each page costs an allocation for its memory and may grow the allocator's page arrays.
+    const size_t allocationBound = 2 * pageStats.blockCount + 2 * scratchStats.blockCount + 64;
+    if(allocations > allocationBound)
+    {
+        printf("  FAILED: %zu allocations is more than the bound of %zu\n", allocations, allocationBound);
+        failures++;
+    }
+    if(scratchStats.highWaterBytes > largestScratch)
+    {
+        printf("  FAILED: scratch memory reached %zu bytes, more than the largest mesh's %zu\n",
+               scratchStats.highWaterBytes, largestScratch);
+        failures++;
+    }
+    if(scratchStats.bytesUsed != 0)
+    {
+        printf("  FAILED: the meshes left %zu bytes of scratch memory allocated\n", scratchStats.bytesUsed);
+        failures++;
+    }
+    if(pageStats.bytesUsed > pageStats.bytesReserved)
+    {
+        printf("  FAILED: the pages use more bytes than they reserve\n");
+        failures++;
+    }
+
+    // Allocate again after a reset, which reuses the pages without allocating any.
+    scratch.reset();
+    const size_t allocationsBeforeReuse = s_allocationCount.load();
+    {
+        LinearArena::Scope scope(scratch);
+        for(uint32_t i = 0; i < 1000; i++)
+        {
+            scratch.allocate(1 + i % 512, 16);
+        }
+    }
+    if(s_allocationCount.load() != allocationsBeforeReuse || scratch.stats().blockCount != scratchStats.blockCount)
+    {
+        printf("  FAILED: reusing the scratch memory allocated\n");
+        failures++;
+    }
+
+    printf("  %s\n", failures ? "FAILED" : "passed");
+    return failures;
+}
+
+/// Checks the allocators' alignment and stats on their own.
+uint32_t checkAllocators()
+{
+    uint32_t failures = 0;
+    std::mt19937 random(11);
+
+    LinearArena arena(4096);
+    size_t blocks = 0;
+    for(int round = 0; round < 2; round++)
+    {
+        size_t requested = 0;
+        for(int i = 0; i < 2000; i++)
+        {
+            const size_t alignment = (size_t)1 << (random() % 9);
+            const size_t size = random() % (i % 100 == 0 ? 20000 : 300);
+            uint8_t* pMemory = (uint8_t*)arena.allocate(size, alignment);
+            memset(pMemory, 0xAB, size);
+            failures += ((uintptr_t)pMemory % alignment) != 0;
+            requested += size;
+        }
+        failures += arena.stats().bytesRequested != requested;
+        failures += arena.stats().bytesUsed < requested;
+        failures += arena.stats().highWaterBytes < arena.stats().bytesUsed;
+
+        // The second round makes the same allocations, which fit in the pages that the first made.
+        if(round == 1)
+        {
+            failures += arena.stats().blockCount != blocks;
+        }
+        blocks = arena.stats().blockCount;
+        arena.reset();
+        failures += arena.stats().bytesUsed != 0;
+        random.seed(11);
+    }
+
+    LinearArena::Marker marker = arena.mark();
+    void* pFirst = arena.allocate(100, 16);
+    arena.rewind(marker);
+    failures += arena.allocate(100, 16) != pFirst;
+
+    PagedSubAllocator pages(1000);
+    PagedSubAllocator::Allocation small = pages.allocate(600, 256);
+    PagedSubAllocator::Allocation fits = pages.allocate(100, 256);
+    PagedSubAllocator::Allocation large = pages.allocate(5000, 256);
+    PagedSubAllocator::Allocation tail = pages.allocate(200, 256);
+    failures += small.page != 0 || small.offset != 0;
+    failures += fits.page != 0 || fits.offset != 768;
+    failures += large.page != 1 || large.offset != 0 || pages.pageSize(1) != 5000;
+    failures += tail.page != 2 || tail.offset != 0;
+    failures += pages.stats().highWaterBytes != 868 + 5000 + 200;
+
+    printf("Allocator checks: %s\n", failures ? "FAILED" : "passed");
+    return failures;
+}
+
+// MARK: - Measurements
+
+/// Measures frames of `allocationCount` temporary allocations of random sizes, freed at the end
+/// of each frame, from the arena, from `malloc`, and as vectors.
+void measureTemporaryAllocations(uint32_t allocationCount, uint32_t frames)
+{
+    std::vector<uint32_t> sizes(allocationCount);
+    std::mt19937 random(3);
+    for(uint32_t& size : sizes)
+    {
+        size = 16 + random() % 1024;
+    }
+
+    std::vector<void*> pointers(allocationCount);
+    uint64_t sum = 0;
+
+    printf("\nTemporary allocations of 16 to 1040 bytes, freed each frame (nanoseconds per allocation):\n");
+
+    LinearArena arena;
+    auto begin = std::chrono::steady_clock::now();
+    for(uint32_t frame = 0; frame < frames; frame++)
+    {
+        LinearArena::Scope scope(arena);
+        for(uint32_t i = 0; i < allocationCount; i++)
+        {
+            uint8_t* pMemory = (uint8_t*)arena.allocate(sizes[i], 16);
+            pMemory[0] = (uint8_t)i;
+            sum += pMemory[0];
+        }
+    }
+    const double arenaSeconds = seconds(begin);
+
+    begin = std::chrono::steady_clock::now();
+    for(uint32_t frame = 0; frame < frames; frame++)
+    {
+        for(uint32_t i = 0; i < allocationCount; i++)
+        {
+            uint8_t* pMemory = (uint8_t*)malloc(sizes[i]);
+            pMemory[0] = (uint8_t)i;
+            sum += pMemory[0];
+            pointers[i] = pMemory;
+        }
+        for(uint32_t i = 0; i < allocationCount; i++)
+        {
+            free(pointers[i]);
+        }
+    }
+    const double mallocSeconds = seconds(begin);
+
+    begin = std::chrono::steady_clock::now();
+    for(uint32_t frame = 0; frame < frames; frame++)
+    {
+        std::vector<std::vector<uint8_t>> vectors;
+        for(uint32_t i = 0; i < allocationCount; i++)
+        {
+            vectors.emplace_back(sizes[i]);
+            sum += vectors.back()[0];
+        }
+    }
+    const double vectorSeconds = seconds(begin);
+
+    const double count = (double)allocationCount * frames;
+    printf("  %-10s %8.2f\n", "arena", arenaSeconds * 1e9 / count);
+    printf("  %-10s %8.2f\n", "malloc", mallocSeconds * 1e9 / count);
+    printf("  %-10s %8.2f\n", "vector", vectorSeconds * 1e9 / count);
+    printStats("arena", arena.stats());
+
+    if(sum == 1)
+    {
+        printf("\n");
+    }
+}
+
+/// Measures placing a load's mesh buffers in shared pages, against a block of memory per mesh.
+void measureMeshBuffers(uint32_t meshCount, size_t pageSize, uint32_t frames)
+{
+    std::vector<size_t> lengths(meshCount * 3);
+    std::mt19937 random(5);
+    for(size_t& length : lengths)
+    {
+        length = 64 + random() % 32768;
+    }
+
+    printf("\nPlacing the buffers of %u meshes (nanoseconds per mesh):\n", meshCount);
+
+    size_t pageAllocations = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(uint32_t frame = 0; frame < frames; frame++)
+    {
+        const size_t allocationsBefore = s_allocationCount.load();
+        MeshMemory memory(pageSize);
+        size_t offsets = 0;
+        for(uint32_t mesh = 0; mesh < meshCount; mesh++)
+        {
+            for(int i = 0; i < 3; i++)
+            {
+                offsets += memory.allocate(lengths[3 * mesh + i]).offset;
+            }
+        }
+        pageAllocations = s_allocationCount.load() - allocationsBefore;
+        if(offsets == 1)
+        {
+            printf("\n");
+        }
+    }
+    const double pagedSeconds = seconds(begin);
+
+    size_t blockAllocations = 0;
+    begin = std::chrono::steady_clock::now();
+    for(uint32_t frame = 0; frame < frames; frame++)
+    {
+        const size_t allocationsBefore = s_allocationCount.load();
+        std::vector<std::unique_ptr<uint8_t[]>> blocks;
+        blocks.reserve(meshCount);
+        for(uint32_t mesh = 0; mesh < meshCount; mesh++)
+        {
+            size_t length = 0;
+            for(int i = 0; i < 3; i++)
+            {
+                length += (lengths[3 * mesh + i] + MeshBufferAlignment - 1) & ~(MeshBufferAlignment - 1);
+            }
+            blocks.emplace_back(new uint8_t[length]);
+        }
+        blockAllocations = s_allocationCount.load() - allocationsBefore;
+    }
+    const double blockSeconds = seconds(begin);
+
+    printf("  %-16s %8.1f  %6zu allocations\n", "shared pages", pagedSeconds * 1e9 / ((double)meshCount * frames), pageAllocations);
+    printf("  %-16s %8.1f  %6zu allocations\n", "block per mesh", blockSeconds * 1e9 / ((double)meshCount * frames), blockAllocations);
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    uint32_t meshCount = 5000;
+    size_t pageSize = PagedSubAllocator::DefaultPageSize;
+    uint32_t allocationCount = 10000;
+    uint32_t frames = 200;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--meshes") && i + 1 < argc)
+        {
+            meshCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--page-size") && i + 1 < argc)
+        {
+            pageSize = (size_t)atol(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--allocations") && i + 1 < argc)
+        {
+            allocationCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            frames = (uint32_t)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(meshCount == 0 || pageSize == 0 || allocationCount == 0 || frames == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    uint32_t failures = checkAllocators();
+    failures += checkLoad(meshCount, pageSize);
+
+    measureTemporaryAllocations(allocationCount, frames);
+    measureMeshBuffers(meshCount, pageSize, std::max(1u, frames / 20));
+
+    return failures ? 1 : 0;
+}
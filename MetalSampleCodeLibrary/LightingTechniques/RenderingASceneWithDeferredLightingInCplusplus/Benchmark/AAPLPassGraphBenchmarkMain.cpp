@@ -0,0 +1,511 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that checks that the pass graph submits passes in an order that respects
+ their dependencies, with a backend that only records, and measures how recording scales with
+ the number of threads.
+*/
+
+#include "../Renderer/AAPLJobPool.h"
+#include "../Renderer/AAPLPassGraph.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --threads LIST       Comma separated thread counts (default 1,2,4 and one per core)\n"
+            "  --passes N           Passes in the measured frame (default 8)\n"
+            "  --draws N            Draws that each pass records (default 2000)\n"
+            "  --cost N             Iterations of work that each draw costs to record (default 200)\n"
+            "  --frames N           Frames to record for each measurement (default 200)\n",
+            program);
+}
+
+std::vector<uint32_t> parseList(const char* list)
+{
+    std::vector<uint32_t> values;
+    for(const char* p = list; p; )
+    {
+        values.push_back((uint32_t)atoi(p));
+        p = strchr(p, ',');
+        if(p)
+        {
+            ++p;
+        }
+    }
+    return values;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// MARK: - Recording backend
+
+/// A command list that only remembers what was recorded into it, in place of a Metal encoder.
+struct CommandList
+{
+    uint32_t pass;
+    std::vector<uint64_t> commands;
+    bool closed;
+};
+
+/// Stands in for the time that an encoder takes to record a draw.
+uint64_t drawCommand(uint32_t pass, uint32_t draw, uint32_t cost)
+{
+    uint64_t value = ((uint64_t)pass << 32) | draw;
+    for(uint32_t i = 0; i < cost; i++)
+    {
+        // Keep the compiler from dropping work whose result isn't used
+        __asm__ volatile("" : "+r"(value));
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    return ((uint64_t)pass << 32) | draw;
+}
+
+/// Records frames of a graph, and keeps the order in which it opened and submitted passes.
+class RecordingBackend
+{
+public:
+
+    explicit RecordingBackend(uint32_t passCount)
+    : m_lists(passCount)
+    , m_recording(0)
+    , m_mostRecording(0)
+    {
+    }
+
+    void execute(JobPool& jobPool, const PassGraph<CommandList>& graph)
+    {
+        m_opened.clear();
+        m_submitted.clear();
+        m_submittedUnclosed = false;
+
+        graph.execute(jobPool,
+                      [this](uint32_t pass)
+                      {
+                          m_opened.push_back(pass);
+                          CommandList& list = m_lists[pass];
+                          list.pass = pass;
+                          list.commands.clear();
+                          list.closed = false;
+                          return &list;
+                      },
+                      [](uint32_t, CommandList& list)
+                      {
+                          list.closed = true;
+                      },
+                      [this](uint32_t pass, CommandList& list)
+                      {
+                          m_submittedUnclosed |= !list.closed || list.pass != pass;
+                          m_submitted.push_back(pass);
+                      });
+    }
+
+    /// Called by passes while they record, to count how many record at once.
+    void beginRecording()
+    {
+        const uint32_t recording = m_recording.fetch_add(1) + 1;
+        uint32_t most = m_mostRecording.load();
+        while(recording > most && !m_mostRecording.compare_exchange_weak(most, recording))
+        {
+        }
+    }
+
+    void endRecording()
+    {
+        m_recording.fetch_sub(1);
+    }
+
+    const std::vector<CommandList>& lists() const { return m_lists; }
+    const std::vector<uint32_t>& opened() const { return m_opened; }
+    const std::vector<uint32_t>& submitted() const { return m_submitted; }
+    bool submittedUnclosed() const { return m_submittedUnclosed; }
+    uint32_t mostRecording() const { return m_mostRecording.load(); }
+
+private:
+
+    std::vector<CommandList> m_lists;
+    std::vector<uint32_t> m_opened;
+    std::vector<uint32_t> m_submitted;
+    bool m_submittedUnclosed;
+
+    std::atomic<uint32_t> m_recording;
+    std::atomic<uint32_t> m_mostRecording;
+};
+
+/// Adds a pass that records `draws` draws, optionally splitting them into jobs of its own.
+void addPass(PassGraph<CommandList>& graph, RecordingBackend& backend, JobPool* pNestedJobs,
+             const char* name, uint32_t draws, uint32_t cost)
+{
+    const uint32_t pass = graph.passCount();
+    graph.addPass(name, [&backend, pNestedJobs, pass, draws, cost](CommandList& list)
+    {
+        backend.beginRecording();
+        list.commands.resize(draws);
+        if(pNestedJobs)
+        {
+            pNestedJobs->parallelFor(draws, 64, [&](size_t begin, size_t end)
+            {
+                for(size_t draw = begin; draw < end; draw++)
+                {
+                    list.commands[draw] = drawCommand(pass, (uint32_t)draw, cost);
+                }
+            });
+        }
+        else
+        {
+            for(uint32_t draw = 0; draw < draws; draw++)
+            {
+                list.commands[draw] = drawCommand(pass, draw, cost);
+            }
+        }
+        backend.endRecording();
+    });
+}
+
+// MARK: - Checks
+
+/// Returns an empty string if the backend saw a valid frame of a graph whose passes have
+/// `dependencies`, or a description of what's wrong.
+std::string checkFrame(const PassGraph<CommandList>& graph,
+                       const std::vector<std::vector<uint32_t>>& dependencies,
+                       const RecordingBackend& backend,
+                       uint32_t draws)
+{
+    const uint32_t count = graph.passCount();
+    const std::vector<uint32_t>& order = graph.submissionOrder();
+
+    if(order.size() != count)
+    {
+        return "the graph left passes out of its order";
+    }
+    if(backend.opened() != order || backend.submitted() != order)
+    {
+        return "passes opened or submitted out of the graph's order";
+    }
+    if(backend.submittedUnclosed())
+    {
+        return "a pass was submitted before it closed";
+    }
+
+    std::vector<uint32_t> position(count, UINT32_MAX);
+    for(uint32_t i = 0; i < order.size(); i++)
+    {
+        if(order[i] >= count || position[order[i]] != UINT32_MAX)
+        {
+            return "a pass was submitted twice or not at all";
+        }
+        position[order[i]] = i;
+    }
+
+    for(uint32_t pass = 0; pass < count; pass++)
+    {
+        for(uint32_t dependency : dependencies[pass])
+        {
+            if(position[dependency] > position[pass])
+            {
+                return std::string(graph.passName(pass)) + " was submitted before " + graph.passName(dependency);
+            }
+        }
+
+        const CommandList& list = backend.lists()[pass];
+        if(list.commands.size() != draws)
+        {
+            return std::string(graph.passName(pass)) + " recorded the wrong number of commands";
+        }
+        for(uint32_t draw = 0; draw < draws; draw++)
+        {
+            if(list.commands[draw] != (((uint64_t)pass << 32) | draw))
+            {
+                return std::string(graph.passName(pass)) + " has another pass's commands";
+            }
+        }
+    }
+
+    // Each pass must be the first one, in the order passes were added, that's ready when it's
+    // submitted, so that passes that don't depend on each other keep their order.
+    std::vector<bool> submitted(count, false);
+    for(uint32_t pass : order)
+    {
+        for(uint32_t earlier = 0; earlier < pass; earlier++)
+        {
+            bool ready = !submitted[earlier];
+            for(uint32_t dependency : dependencies[earlier])
+            {
+                ready &= submitted[dependency];
+            }
+            if(ready)
+            {
+                return std::string(graph.passName(earlier)) + " was ready but submitted after " + graph.passName(pass);
+            }
+        }
+        submitted[pass] = true;
+    }
+
+    return std::string();
+}
+
+/// Records random acyclic graphs, and the deferred renderers' graphs, on `jobPool`.  Returns the
+/// number of failures.
+uint32_t checkGraphs(JobPool& jobPool, bool nested)
+{
+    uint32_t failures = 0;
+    std::mt19937 random(0x9a55 + jobPool.threadCount());
+
+    for(uint32_t graphIndex = 0; graphIndex < 300; graphIndex++)
+    {
+        const uint32_t count = 1 + random() % 40;
+        const uint32_t draws = 1 + random() % 300;
+
+        // Shuffle a chain of passes so that dependencies point both forward and backward in
+        // the order passes are added.
+        std::vector<uint32_t> rank(count);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            rank[i] = i;
+        }
+        std::shuffle(rank.begin(), rank.end(), random);
+
+        PassGraph<CommandList> graph;
+        RecordingBackend backend(count);
+        std::vector<std::string> names(count);
+        for(uint32_t pass = 0; pass < count; pass++)
+        {
+            names[pass] = "Pass " + std::to_string(pass);
+        }
+        for(uint32_t pass = 0; pass < count; pass++)
+        {
+            addPass(graph, backend, nested ? &jobPool : nullptr, names[pass].c_str(), draws, 0);
+        }
+
+        std::vector<std::vector<uint32_t>> dependencies(count);
+        for(uint32_t pass = 0; pass < count; pass++)
+        {
+            for(uint32_t other = 0; other < count; other++)
+            {
+                if(rank[other] < rank[pass] && random() % 4 == 0)
+                {
+                    graph.addDependency(pass, other);
+                    dependencies[pass].push_back(other);
+                }
+            }
+        }
+
+        std::string error;
+        if(!graph.compile(error))
+        {
+            printf("  graph %u: FAILED to compile: %s\n", graphIndex, error.c_str());
+            failures++;
+            continue;
+        }
+
+        // Record each graph twice to check that command lists start over each frame.
+        for(int frame = 0; frame < 2; frame++)
+        {
+            backend.execute(jobPool, graph);
+            error = checkFrame(graph, dependencies, backend, draws);
+            if(!error.empty())
+            {
+                printf("  graph %u: FAILED: %s\n", graphIndex, error.c_str());
+                failures++;
+                break;
+            }
+        }
+    }
+
+    // A cycle through passes 1, 2 and 3 leaves no valid order.
+    {
+        PassGraph<CommandList> graph;
+        RecordingBackend backend(4);
+        addPass(graph, backend, nullptr, "Shadow Map", 1, 0);
+        addPass(graph, backend, nullptr, "A", 1, 0);
+        addPass(graph, backend, nullptr, "B", 1, 0);
+        addPass(graph, backend, nullptr, "C", 1, 0);
+        graph.addDependency(1, 0);
+        graph.addDependency(2, 1);
+        graph.addDependency(3, 2);
+        graph.addDependency(1, 3);
+
+        std::string error;
+        if(graph.compile(error) || error.find(" A B C") == std::string::npos || error.find("Shadow") != std::string::npos)
+        {
+            printf("  cycle: FAILED: compiled, or described the wrong passes (\"%s\")\n", error.c_str());
+            failures++;
+        }
+    }
+
+    // The renderers' graphs must submit in the order they always drew on one thread.
+    const std::vector<std::vector<const char*>> rendererGraphs =
+    {
+        { "Shadow Map", "GBuffer" },
+        { "Directional Light", "Point Light Mask", "Point Lights", "Sky", "Fairies" },
+        { "GBuffer", "Directional Light", "Point Light Mask", "Point Lights", "Sky", "Fairies" },
+    };
+    for(const std::vector<const char*>& names : rendererGraphs)
+    {
+        const uint32_t count = (uint32_t)names.size();
+        PassGraph<CommandList> graph;
+        RecordingBackend backend(count);
+        std::vector<std::vector<uint32_t>> dependencies(count);
+        for(uint32_t pass = 0; pass < count; pass++)
+        {
+            addPass(graph, backend, nullptr, names[pass], 100, 0);
+            if(pass > 0)
+            {
+                graph.addDependency(pass, pass - 1);
+                dependencies[pass].push_back(pass - 1);
+            }
+        }
+
+        std::string error;
+        graph.compile(error);
+        backend.execute(jobPool, graph);
+        error = checkFrame(graph, dependencies, backend, 100);
+        for(uint32_t i = 0; i < count && error.empty(); i++)
+        {
+            if(backend.submitted()[i] != i)
+            {
+                error = "passes submitted out of drawing order";
+            }
+        }
+        if(!error.empty())
+        {
+            printf("  %s...: FAILED: %s\n", names[0], error.c_str());
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    std::vector<uint32_t> threadCounts = { 1, 2, 4, std::max(1u, std::thread::hardware_concurrency()) };
+    uint32_t passCount = 8;
+    uint32_t draws = 2000;
+    uint32_t cost = 200;
+    uint32_t frames = 200;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            threadCounts = parseList(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--passes") && i + 1 < argc)
+        {
+            passCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--draws") && i + 1 < argc)
+        {
+            draws = (uint32_t)atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--cost") && i + 1 < argc)
+        {
+            cost = (uint32_t)atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            frames = (uint32_t)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(passCount == 0 || frames == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    std::sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    uint32_t failures = 0;
+    printf("Dependency checks of 300 random graphs, the renderers' graphs and a cycle:\n");
+    for(uint32_t threadCount : threadCounts)
+    {
+        JobPool jobPool(threadCount);
+        for(bool nested : { false, true })
+        {
+            const uint32_t graphFailures = checkGraphs(jobPool, nested);
+            printf("  %2u threads%s: %s\n", threadCount, nested ? ", nested jobs" : "              ",
+                   graphFailures ? "FAILED" : "passed");
+            failures += graphFailures;
+        }
+    }
+
+    // Passes that don't depend on each other, like a frame's shadow and GBuffer passes, and a
+    // chain, like its lighting passes.  Neither changes how long recording takes, since passes
+    // record at the same time either way; only the order of submission differs.
+    printf("\nRecording %u passes of %u draws each (microseconds per frame):\n", passCount, draws);
+    printf("%10s %12s %12s %10s %14s\n", "threads", "independent", "chain", "speedup", "most at once");
+
+    double oneThread = 0;
+    for(uint32_t threadCount : threadCounts)
+    {
+        JobPool jobPool(threadCount);
+        double microseconds[2];
+        uint32_t mostRecording = 0;
+
+        for(int chain = 0; chain < 2; chain++)
+        {
+            PassGraph<CommandList> graph;
+            RecordingBackend backend(passCount);
+            std::vector<std::string> names(passCount);
+            for(uint32_t pass = 0; pass < passCount; pass++)
+            {
+                names[pass] = "Pass " + std::to_string(pass);
+                addPass(graph, backend, nullptr, names[pass].c_str(), draws, cost);
+                if(chain && pass > 0)
+                {
+                    graph.addDependency(pass, pass - 1);
+                }
+            }
+
+            std::string error;
+            graph.compile(error);
+            backend.execute(jobPool, graph);
+
+            const auto begin = std::chrono::steady_clock::now();
+            for(uint32_t frame = 0; frame < frames; frame++)
+            {
+                backend.execute(jobPool, graph);
+            }
+            microseconds[chain] = seconds(begin) / frames * 1e6;
+            mostRecording = std::max(mostRecording, backend.mostRecording());
+        }
+
+        if(oneThread == 0)
+        {
+            oneThread = microseconds[0];
+        }
+        printf("%10u %12.1f %12.1f %9.2fx %14u\n", threadCount, microseconds[0], microseconds[1],
+               oneThread / microseconds[0], mostRecording);
+    }
+
+    return failures ? 1 : 0;
+}
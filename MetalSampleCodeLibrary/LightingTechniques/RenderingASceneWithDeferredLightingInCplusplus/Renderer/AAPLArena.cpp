@@ -0,0 +1,138 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the arena allocators, which hand out memory from a few large blocks instead
+ of asking the system for each allocation.
+*/
+
+#include "AAPLArena.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace
+{
+
+inline size_t alignUp( size_t value, size_t alignment )
+{
+    assert( alignment && ( alignment & ( alignment - 1 ) ) == 0 && "Alignment must be a power of 2" );
+    return ( value + alignment - 1 ) & ~( alignment - 1 );
+}
+
+inline void recordAllocation( AllocatorStats& stats, size_t size, size_t bytesUsed )
+{
+    stats.allocationCount++;
+    stats.bytesRequested += size;
+    stats.bytesUsed = bytesUsed;
+    stats.highWaterBytes = std::max( stats.highWaterBytes, bytesUsed );
+}
+
+} // namespace
+
+// MARK: - LinearArena
+
+LinearArena::LinearArena( size_t pageSize )
+: m_pageSize( std::max<size_t>( pageSize, 1 ) )
+, m_page( 0 )
+, m_offset( 0 )
+, m_bytesUsedBeforePage( 0 )
+{
+    memset( &m_stats, 0, sizeof(m_stats) );
+}
+
+void* LinearArena::allocate( size_t size, size_t alignment )
+{
+    for( ;; )
+    {
+        if( m_page == m_pages.size() )
+        {
+            // Size a page for a large request so that it fits whatever the address of the memory.
+            const size_t pageSize = std::max( m_pageSize, size + alignment );
+            m_pages.push_back( Page{ std::unique_ptr<uint8_t[]>( new uint8_t[pageSize] ), pageSize } );
+            m_stats.blockCount++;
+            m_stats.bytesReserved += pageSize;
+        }
+
+        Page& page = m_pages[m_page];
+        const uintptr_t base = (uintptr_t)page.memory.get();
+        const size_t offset = alignUp( base + m_offset, alignment ) - base;
+        if( offset + size <= page.size )
+        {
+            m_offset = offset + size;
+            recordAllocation( m_stats, size, m_bytesUsedBeforePage + m_offset );
+            return page.memory.get() + offset;
+        }
+
+        // Move on to the next page, which is empty, or make one.
+        m_bytesUsedBeforePage += m_offset;
+        m_page++;
+        m_offset = 0;
+    }
+}
+
+void LinearArena::rewind( const Marker& marker )
+{
+    m_page = marker.page;
+    m_offset = marker.offset;
+    m_bytesUsedBeforePage = marker.bytesUsedBeforePage;
+    m_stats.bytesUsed = m_bytesUsedBeforePage + m_offset;
+}
+
+void LinearArena::reset()
+{
+    rewind( Marker{ 0, 0, 0 } );
+    m_stats.allocationCount = 0;
+    m_stats.bytesRequested = 0;
+}
+
+// MARK: - PagedSubAllocator
+
+PagedSubAllocator::PagedSubAllocator( size_t pageSize )
+: m_pageSize( std::max<size_t>( pageSize, 1 ) )
+{
+    memset( &m_stats, 0, sizeof(m_stats) );
+}
+
+PagedSubAllocator::Allocation PagedSubAllocator::allocate( size_t size, size_t alignment )
+{
+    uint32_t pageIndex = 0;
+    size_t offset = 0;
+    for( ; pageIndex < m_pages.size(); pageIndex++ )
+    {
+        offset = alignUp( m_pages[pageIndex].used, alignment );
+        if( offset + size <= m_pages[pageIndex].size )
+        {
+            break;
+        }
+    }
+
+    if( pageIndex == m_pages.size() )
+    {
+        const size_t pageSize = std::max( m_pageSize, size );
+        m_pages.push_back( Page{ pageSize, 0 } );
+        m_stats.blockCount++;
+        m_stats.bytesReserved += pageSize;
+        offset = 0;
+    }
+
+    Page& page = m_pages[pageIndex];
+    m_stats.bytesUsed += offset + size - page.used;
+    page.used = offset + size;
+    recordAllocation( m_stats, size, m_stats.bytesUsed );
+
+    return Allocation{ pageIndex, offset };
+}
+
+void PagedSubAllocator::reset()
+{
+    for( Page& page : m_pages )
+    {
+        page.used = 0;
+    }
+    m_stats.allocationCount = 0;
+    m_stats.bytesRequested = 0;
+    m_stats.bytesUsed = 0;
+}
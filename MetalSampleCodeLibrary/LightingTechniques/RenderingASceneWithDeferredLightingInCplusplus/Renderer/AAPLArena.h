@@ -0,0 +1,212 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the arena allocators, which hand out memory from a few large blocks instead of
+ asking the system for each allocation.
+*/
+
+#ifndef AAPLArena_h
+#define AAPLArena_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/// What an allocator has handed out and how much memory backs it.
+struct AllocatorStats
+{
+    // Allocations, and the bytes they asked for, since the allocator was created or reset
+    size_t allocationCount;
+    size_t bytesRequested;
+
+    // Bytes between the start of each block and the end of its last allocation, which includes
+    // alignment padding, and the most there have been at once
+    size_t bytesUsed;
+    size_t highWaterBytes;
+
+    // The blocks that back the allocations, which the allocator keeps when it resets
+    size_t blockCount;
+    size_t bytesReserved;
+};
+
+/// Hands out memory for temporary arrays, such as those that build a mesh, by moving a pointer
+/// through pages that it keeps for its whole life.  Rewinding or resetting the arena frees
+/// everything allocated since, at once, so a load or a frame that uses the same arena again
+/// doesn't allocate at all once the pages are large enough.
+///
+/// The arena doesn't run destructors, so it only holds trivially destructible types.
+class LinearArena
+{
+public:
+
+    static const size_t DefaultPageSize = 256 * 1024;
+
+    /// A position in the arena to rewind to.
+    struct Marker
+    {
+        size_t page;
+        size_t offset;
+        size_t bytesUsedBeforePage;
+    };
+
+    /// Rewinds the arena, when it goes out of scope, to where it was when the scope began.
+    class Scope
+    {
+    public:
+
+        explicit Scope( LinearArena& arena );
+
+        ~Scope();
+
+        Scope( const Scope& ) = delete;
+
+        Scope& operator=( const Scope& ) = delete;
+
+    private:
+
+        LinearArena& m_arena;
+        Marker m_marker;
+    };
+
+    explicit LinearArena( size_t pageSize = DefaultPageSize );
+
+    LinearArena( const LinearArena& ) = delete;
+
+    LinearArena& operator=( const LinearArena& ) = delete;
+
+    /// Returns `size` bytes at an address that's a multiple of `alignment`, a power of 2.
+    /// Requests larger than a page get a page of their own.
+    void* allocate( size_t size, size_t alignment = alignof(max_align_t) );
+
+    /// Returns uninitialized room for `count` values of type `T`.
+    template <typename T>
+    T* allocateArray( size_t count );
+
+    Marker mark() const;
+
+    /// Frees everything allocated since `marker`.
+    void rewind( const Marker& marker );
+
+    /// Frees everything, and starts the counts of allocations over.
+    void reset();
+
+    const AllocatorStats& stats() const;
+
+private:
+
+    struct Page
+    {
+        std::unique_ptr<uint8_t[]> memory;
+        size_t size;
+    };
+
+    std::vector<Page> m_pages;
+
+    size_t m_pageSize;
+
+    // The page that the next allocation tries first, and the offset of its free space
+    size_t m_page;
+    size_t m_offset;
+
+    // Bytes used in the pages before `m_page`
+    size_t m_bytesUsedBeforePage;
+
+    AllocatorStats m_stats;
+};
+
+/// Packs allocations into pages, which the caller backs with buffers of its own such as Metal
+/// buffers, so that many meshes share a few large buffers.  It only computes where each
+/// allocation goes: an allocation goes at the end of the first page with room for it, and a new
+/// page begins when none has room.  Requests larger than a page get a page of their own, sized
+/// to fit.
+class PagedSubAllocator
+{
+public:
+
+    static const size_t DefaultPageSize = 1024 * 1024;
+
+    struct Allocation
+    {
+        uint32_t page;
+        size_t offset;
+    };
+
+    explicit PagedSubAllocator( size_t pageSize = DefaultPageSize );
+
+    /// Places `size` bytes at an offset that's a multiple of `alignment`, a power of 2, from the
+    /// start of a page.  Backing each page with memory aligned to at least `alignment` keeps
+    /// the allocation aligned.
+    Allocation allocate( size_t size, size_t alignment );
+
+    uint32_t pageCount() const;
+
+    size_t pageSize( uint32_t page ) const;
+
+    /// Forgets every allocation but keeps the pages, and starts the counts of allocations over.
+    void reset();
+
+    const AllocatorStats& stats() const;
+
+private:
+
+    struct Page
+    {
+        size_t size;
+        size_t used;
+    };
+
+    std::vector<Page> m_pages;
+
+    size_t m_pageSize;
+
+    AllocatorStats m_stats;
+};
+
+template <typename T>
+inline T* LinearArena::allocateArray( size_t count )
+{
+    static_assert( std::is_trivially_destructible<T>::value, "The arena doesn't run destructors" );
+    return static_cast<T*>( allocate( count * sizeof(T), alignof(T) ) );
+}
+
+inline LinearArena::Marker LinearArena::mark() const
+{
+    return Marker{ m_page, m_offset, m_bytesUsedBeforePage };
+}
+
+inline const AllocatorStats& LinearArena::stats() const
+{
+    return m_stats;
+}
+
+inline LinearArena::Scope::Scope( LinearArena& arena )
+: m_arena( arena )
+, m_marker( arena.mark() )
+{
+}
+
+inline LinearArena::Scope::~Scope()
+{
+    m_arena.rewind( m_marker );
+}
+
+inline uint32_t PagedSubAllocator::pageCount() const
+{
+    return (uint32_t)m_pages.size();
+}
+
+inline size_t PagedSubAllocator::pageSize( uint32_t page ) const
+{
+    return m_pages[page].size;
+}
+
+inline const AllocatorStats& PagedSubAllocator::stats() const
+{
+    return m_stats;
+}
+
+#endif // AAPLArena_h
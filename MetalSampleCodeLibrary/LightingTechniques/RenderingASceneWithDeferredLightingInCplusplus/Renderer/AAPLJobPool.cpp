@@ -0,0 +1,209 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of a pool of worker threads that run the frame's jobs, stealing from each other
+ when their own queue runs dry.
+*/
+
+#include "AAPLJobPool.h"
+
+#include <algorithm>
+
+namespace
+{
+
+// The pool whose worker the current thread is, if any, and the worker's queue
+thread_local const JobPool* t_pWorkerPool = nullptr;
+thread_local unsigned t_workerQueueIndex = 0;
+
+} // namespace
+
+JobGroup::JobGroup()
+: m_pending( 0 )
+{
+}
+
+JobPool::JobPool( unsigned threadCount )
+: m_queuedJobs( 0 )
+, m_stopping( false )
+{
+    if( threadCount == 0 )
+    {
+        threadCount = std::max( 1u, std::thread::hardware_concurrency() );
+    }
+
+    for( unsigned i = 0; i < threadCount; i++ )
+    {
+        m_queues.emplace_back( new Queue );
+    }
+
+    for( unsigned i = 1; i < threadCount; i++ )
+    {
+        m_workers.emplace_back( &JobPool::workerMain, this, i );
+    }
+}
+
+JobPool::~JobPool()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_sleepMutex );
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for( std::thread& worker : m_workers )
+    {
+        worker.join();
+    }
+}
+
+void JobPool::run( JobGroup& group, std::function<void()> job )
+{
+    group.m_pending.fetch_add( 1, std::memory_order_relaxed );
+
+    Queue& queue = *m_queues[currentQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock( queue.mutex );
+        queue.jobs.push_back( Job{ std::move( job ), &group } );
+    }
+    m_queuedJobs.fetch_add( 1, std::memory_order_release );
+
+    // Take the sleep mutex so that a worker that just found no jobs is either still awake to
+    // see this one, or already waiting for the notification.
+    if( !m_workers.empty() )
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_sleepMutex );
+        }
+        m_wake.notify_one();
+    }
+}
+
+void JobPool::wait( JobGroup& group )
+{
+    const unsigned queueIndex = currentQueueIndex();
+
+    Job job;
+    while( !group.finished() )
+    {
+        if( takeJob( queueIndex, job ) )
+        {
+            runJob( job );
+        }
+        else
+        {
+            // The group's last jobs are running on other threads.
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobPool::parallelFor( size_t count,
+                           size_t grainSize,
+                           const std::function<void(size_t, size_t)>& task )
+{
+    grainSize = std::max<size_t>( grainSize, 1 );
+
+    if( m_workers.empty() || count <= grainSize )
+    {
+        for( size_t begin = 0; begin < count; begin += grainSize )
+        {
+            task( begin, std::min( begin + grainSize, count ) );
+        }
+        return;
+    }
+
+    // Queue every range at once, so that the workers wake to a full queue to steal from.
+    JobGroup group;
+    const size_t rangeCount = ( count + grainSize - 1 ) / grainSize;
+    group.m_pending.store( (uint32_t)rangeCount, std::memory_order_relaxed );
+
+    Queue& queue = *m_queues[currentQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock( queue.mutex );
+        for( size_t begin = 0; begin < count; begin += grainSize )
+        {
+            const size_t end = std::min( begin + grainSize, count );
+            queue.jobs.push_back( Job{ [&task, begin, end] { task( begin, end ); }, &group } );
+        }
+    }
+    m_queuedJobs.fetch_add( rangeCount, std::memory_order_release );
+
+    {
+        std::lock_guard<std::mutex> lock( m_sleepMutex );
+    }
+    m_wake.notify_all();
+
+    wait( group );
+}
+
+unsigned JobPool::currentQueueIndex() const
+{
+    return t_pWorkerPool == this ? t_workerQueueIndex : 0;
+}
+
+bool JobPool::takeJob( unsigned queueIndex, Job& job )
+{
+    if( m_queuedJobs.load( std::memory_order_acquire ) == 0 )
+    {
+        return false;
+    }
+
+    const unsigned queueCount = (unsigned)m_queues.size();
+    for( unsigned i = 0; i < queueCount; i++ )
+    {
+        const bool own = ( i == 0 );
+        Queue& queue = *m_queues[( queueIndex + i ) % queueCount];
+
+        std::lock_guard<std::mutex> lock( queue.mutex );
+        if( !queue.jobs.empty() )
+        {
+            if( own )
+            {
+                job = std::move( queue.jobs.back() );
+                queue.jobs.pop_back();
+            }
+            else
+            {
+                job = std::move( queue.jobs.front() );
+                queue.jobs.pop_front();
+            }
+            m_queuedJobs.fetch_sub( 1, std::memory_order_relaxed );
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobPool::runJob( Job& job )
+{
+    job.function();
+    job.function = nullptr;
+
+    // Release, so that a thread that sees the group finish also sees what the job wrote.
+    job.pGroup->m_pending.fetch_sub( 1, std::memory_order_release );
+}
+
+void JobPool::workerMain( unsigned queueIndex )
+{
+    t_pWorkerPool = this;
+    t_workerQueueIndex = queueIndex;
+
+    Job job;
+    for( ;; )
+    {
+        if( takeJob( queueIndex, job ) )
+        {
+            runJob( job );
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock( m_sleepMutex );
+        m_wake.wait( lock, [this] { return m_stopping || m_queuedJobs.load( std::memory_order_acquire ) > 0; } );
+        if( m_stopping )
+        {
+            return;
+        }
+    }
+}
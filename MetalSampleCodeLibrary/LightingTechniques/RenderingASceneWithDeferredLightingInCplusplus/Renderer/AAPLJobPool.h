@@ -0,0 +1,133 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for a pool of worker threads that run the frame's jobs, stealing from each other when
+ their own queue runs dry.
+*/
+
+#ifndef AAPLJobPool_h
+#define AAPLJobPool_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Counts the jobs of a group that haven't finished, so that a thread can wait for them.
+class JobGroup
+{
+public:
+
+    JobGroup();
+
+    JobGroup( const JobGroup& ) = delete;
+
+    JobGroup& operator=( const JobGroup& ) = delete;
+
+    bool finished() const;
+
+private:
+
+    friend class JobPool;
+
+    std::atomic<uint32_t> m_pending;
+};
+
+/// A fixed set of worker threads that wait between frames, so that per-frame work doesn't pay
+/// to create threads.
+///
+/// Each thread has its own queue of jobs.  A thread runs the jobs it queued newest first, and a
+/// thread whose queue is empty takes the oldest job from another thread's queue, so that jobs
+/// spread out without a shared queue that every thread contends for.  Threads that aren't
+/// workers, such as the one that renders, share one queue.
+///
+/// Workers run jobs outside of any autorelease pool, so a job that calls Metal drains its own.
+class JobPool
+{
+public:
+
+    /// Starts `threadCount - 1` workers; a thread that waits for jobs is the last one.
+    /// A count of 0 uses one thread per core.
+    explicit JobPool( unsigned threadCount = 0 );
+
+    ~JobPool();
+
+    JobPool( const JobPool& ) = delete;
+
+    JobPool& operator=( const JobPool& ) = delete;
+
+    unsigned threadCount() const;
+
+    /// Queues `job` on the calling thread's queue as part of `group`.
+    void run( JobGroup& group, std::function<void()> job );
+
+    /// Runs queued jobs, including those of other groups, until every job of `group` has
+    /// finished.  Jobs may wait for groups of their own.
+    void wait( JobGroup& group );
+
+    /// Calls `task(begin, end)` on ranges of at most `grainSize` items that together cover
+    /// [0, `count`), on every thread of the pool, and returns when they have all finished.
+    /// Runs on the calling thread alone when `count` fits in one range.
+    void parallelFor( size_t count,
+                      size_t grainSize,
+                      const std::function<void(size_t begin, size_t end)>& task );
+
+private:
+
+    struct Job
+    {
+        std::function<void()> function;
+        JobGroup* pGroup;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void workerMain( unsigned queueIndex );
+
+    unsigned currentQueueIndex() const;
+
+    /// Takes the newest job from queue `queueIndex` or, failing that, the oldest job from
+    /// another queue.
+    bool takeJob( unsigned queueIndex, Job& job );
+
+    void runJob( Job& job );
+
+    std::vector<std::thread> m_workers;
+
+    // Queue 0 belongs to the threads that aren't workers, and queue i to worker i
+    std::vector<std::unique_ptr<Queue>> m_queues;
+
+    // The number of jobs in all queues, which workers check before they sleep
+    std::atomic<size_t> m_queuedJobs;
+
+    std::mutex m_sleepMutex;
+
+    // Signals sleeping workers that a job was queued or that the pool is stopping
+    std::condition_variable m_wake;
+
+    bool m_stopping;
+};
+
+inline bool JobGroup::finished() const
+{
+    return m_pending.load( std::memory_order_acquire ) == 0;
+}
+
+inline unsigned JobPool::threadCount() const
+{
+    return (unsigned)m_workers.size() + 1;
+}
+
+#endif // AAPLJobPool_h
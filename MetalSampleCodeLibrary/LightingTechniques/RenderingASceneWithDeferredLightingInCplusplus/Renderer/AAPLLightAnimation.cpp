@@ -0,0 +1,203 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the light animation, which moves the fairy lights each frame several at a time.
+*/
+
+#include "AAPLLightAnimation.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace
+{
+
+// The kernels use GCC and clang vector extensions, which compile to SSE or AVX on x86_64 and
+// NEON on arm64 without a path for each.
+#if defined(__AVX__)
+static const size_t Width = 8;
+#else
+static const size_t Width = 4;
+#endif
+
+typedef float    FloatV __attribute__((vector_size(Width * sizeof(float))));
+typedef int32_t  IntV   __attribute__((vector_size(Width * sizeof(int32_t))));
+typedef uint32_t MaskV  __attribute__((vector_size(Width * sizeof(uint32_t))));
+typedef double   DoubleV __attribute__((vector_size(Width * sizeof(double))));
+
+inline FloatV splat(float f)
+{
+    FloatV v;
+    for(size_t lane = 0; lane < Width; lane++)
+    {
+        v[lane] = f;
+    }
+    return v;
+}
+
+/// Loads `count` floats, which may be fewer than a whole vector, and zeros the other lanes.
+/// The kernels call it with a constant `Width` except at the end of a range, so that the copy
+/// compiles to one load.
+inline FloatV load(const float* p, size_t count)
+{
+    FloatV v = {};
+    memcpy(&v, p, count * sizeof(float));
+    return v;
+}
+
+inline FloatV select(MaskV mask, FloatV a, FloatV b)
+{
+    return (FloatV)((mask & (MaskV)a) | (~mask & (MaskV)b));
+}
+
+/// Rounds to the nearest integer, with ties away from zero.
+inline IntV roundToInt(FloatV x)
+{
+    const MaskV sign = (MaskV)x & 0x80000000u;
+    return __builtin_convertvector(x + (FloatV)((MaskV)splat(0.5f) | sign), IntV);
+}
+
+/// Computes the sine and cosine of `angle` with Cephes' single precision polynomials, after
+/// subtracting the nearest multiple of pi/2 in double precision, which keeps both within a few
+/// units in the last place of `sinf` and `cosf` for any angle that a float frame number gives.
+inline void sinCos(FloatV angle, FloatV& sine, FloatV& cosine)
+{
+    const IntV quadrant = roundToInt(angle * splat(0.636619772f));
+
+    const DoubleV reduced = __builtin_convertvector(angle, DoubleV) -
+                            __builtin_convertvector(quadrant, DoubleV) * 1.5707963267948966;
+    const FloatV r = __builtin_convertvector(reduced, FloatV);
+    const FloatV r2 = r * r;
+
+    const FloatV s = r + r * r2 * ((splat(-1.9515295891e-4f) * r2 + splat(8.3321608736e-3f)) * r2 + splat(-1.6666654611e-1f));
+    const FloatV c = splat(1.0f) - splat(0.5f) * r2 +
+                     r2 * r2 * ((splat(2.443315711809948e-5f) * r2 + splat(-1.388731625493765e-3f)) * r2 + splat(4.166664568298827e-2f));
+
+    // Odd quadrants swap sine and cosine.  Sine is negative in quadrants 2 and 3, and cosine in
+    // quadrants 1 and 2.
+    const MaskV q = (MaskV)quadrant;
+    const MaskV odd = (MaskV)((q & 1u) != 0u);
+    sine = (FloatV)((MaskV)select(odd, c, s) ^ ((q & 2u) << 30));
+    cosine = (FloatV)((MaskV)select(odd, s, c) ^ (((q + 1u) & 2u) << 30));
+}
+
+/// Writes `count` positions, transformed by a column-major matrix, as 4 floats each.
+inline void storeTransformed(float* positions, const float* m, FloatV x, FloatV y, FloatV z, size_t count)
+{
+    FloatV transformed[4];
+    for(int row = 0; row < 4; row++)
+    {
+        transformed[row] = ((splat(m[row]) * x + splat(m[4 + row]) * y) + splat(m[8 + row]) * z) + splat(m[12 + row]);
+    }
+
+    for(size_t lane = 0; lane < count; lane++)
+    {
+        float* position = positions + lane * 4;
+        position[0] = transformed[0][lane];
+        position[1] = transformed[1][lane];
+        position[2] = transformed[2][lane];
+        position[3] = transformed[3][lane];
+    }
+}
+
+/// Moves tree lights, which climb a fraction of the way up each frame and start over at the top.
+/// They move outward as the fifth power of that fraction, so that they clear the branches.
+inline void animateTreeLights(float* positions, const float* m, FloatV frame,
+                              const float* x, const float* y, const float* z, const float* speed,
+                              size_t count)
+{
+    // Add the starting height and take the fractional part in double precision, like the
+    // renderer always has, so that lights don't jump after many frames.  The sum stays within
+    // the range of 32-bit integers for any frame that a float frame number can count.
+    const DoubleV climb = __builtin_convertvector(load(speed, count) * frame, DoubleV) +
+                          __builtin_convertvector(load(y, count), DoubleV);
+    const DoubleV truncated = __builtin_convertvector(__builtin_convertvector(climb, IntV), DoubleV);
+    const DoubleV floor = truncated + __builtin_convertvector(truncated > climb, DoubleV);   // true is -1
+    const FloatV period = __builtin_convertvector(climb - floor, FloatV);
+
+    const FloatV period2 = period * period;
+    const FloatV radius = splat(1.2f) + splat(10.0f) * (period2 * period2 * period);
+
+    storeTransformed(positions, m,
+                     load(x, count) * radius,
+                     splat(200.0f) + period * splat(400.0f),
+                     load(z, count) * radius,
+                     count);
+}
+
+/// Moves the other lights, which rotate about the Y axis by a closed form of matrix4x4_rotation.
+inline void animateOrbitingLights(float* positions, const float* m, FloatV frame,
+                                  const float* x, const float* y, const float* z, const float* speed,
+                                  size_t count)
+{
+    FloatV sine, cosine;
+    sinCos(load(speed, count) * frame, sine, cosine);
+
+    const FloatV startX = load(x, count), startZ = load(z, count);
+
+    storeTransformed(positions, m,
+                     cosine * startX + sine * startZ,
+                     load(y, count),
+                     cosine * startZ - sine * startX,
+                     count);
+}
+
+} // namespace
+
+LightAnimation::LightAnimation()
+: m_treeLightCount(0)
+{
+}
+
+void LightAnimation::resize(size_t count, size_t treeLightCount)
+{
+    m_x.resize(count);
+    m_y.resize(count);
+    m_z.resize(count);
+    m_speed.resize(count);
+    m_treeLightCount = std::min(treeLightCount, count);
+}
+
+void LightAnimation::setLight(size_t index, float x, float y, float z, float speed)
+{
+    m_x[index] = x;
+    m_y[index] = y;
+    m_z[index] = z;
+    m_speed[index] = speed;
+}
+
+void LightAnimation::animate(float* positions,
+                             uint64_t frameNumber,
+                             const float* modelViewMatrix,
+                             size_t begin,
+                             size_t end) const
+{
+    float m[16];
+    memcpy(m, modelViewMatrix, sizeof(m));
+
+    const FloatV frame = splat((float)frameNumber);
+
+    // Run whole vectors first, and then the lights left over at the end of each range.
+    const size_t treeEnd = std::min(end, m_treeLightCount);
+    size_t i = begin;
+    for(; i + Width <= treeEnd; i += Width)
+    {
+        animateTreeLights(positions + i * 4, m, frame, &m_x[i], &m_y[i], &m_z[i], &m_speed[i], Width);
+    }
+    if(i < treeEnd)
+    {
+        animateTreeLights(positions + i * 4, m, frame, &m_x[i], &m_y[i], &m_z[i], &m_speed[i], treeEnd - i);
+    }
+
+    i = std::max(begin, m_treeLightCount);
+    for(; i + Width <= end; i += Width)
+    {
+        animateOrbitingLights(positions + i * 4, m, frame, &m_x[i], &m_y[i], &m_z[i], &m_speed[i], Width);
+    }
+    if(i < end)
+    {
+        animateOrbitingLights(positions + i * 4, m, frame, &m_x[i], &m_y[i], &m_z[i], &m_speed[i], end - i);
+    }
+}
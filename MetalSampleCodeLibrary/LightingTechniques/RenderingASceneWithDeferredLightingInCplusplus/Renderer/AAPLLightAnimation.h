@@ -0,0 +1,66 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the light animation, which moves the fairy lights each frame several at a time.
+*/
+
+#ifndef AAPLLightAnimation_h
+#define AAPLLightAnimation_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/// The starting positions and speeds of the fairy lights, stored as structures of arrays so
+/// that each vector instruction animates the same component of several lights.
+///
+/// The first `treeLightCount` lights climb the tree: each frame they rise by their speed, as a
+/// fraction of the climb, and move outward near the top.  The rest circle the Y axis at their
+/// speed in radians per frame.
+class LightAnimation
+{
+public:
+
+    LightAnimation();
+
+    /// Makes room for `count` lights, of which the first `treeLightCount` climb the tree.
+    void resize( size_t count, size_t treeLightCount );
+
+    size_t count() const;
+
+    size_t treeLightCount() const;
+
+    void setLight( size_t index, float x, float y, float z, float speed );
+
+    /// Writes the positions of lights [`begin`, `end`) in the given frame, transformed by
+    /// `modelViewMatrix`, to `positions`, as 4 floats per light with w = 1.
+    /// `modelViewMatrix` is 16 floats in column-major order, the layout of matrix_float4x4.
+    void animate( float* positions,
+                  uint64_t frameNumber,
+                  const float* modelViewMatrix,
+                  size_t begin,
+                  size_t end ) const;
+
+private:
+
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+    std::vector<float> m_speed;
+
+    size_t m_treeLightCount;
+};
+
+inline size_t LightAnimation::count() const
+{
+    return m_x.size();
+}
+
+inline size_t LightAnimation::treeLightCount() const
+{
+    return m_treeLightCount;
+}
+
+#endif // AAPLLightAnimation_h
@@ -0,0 +1,543 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of batched math functions, with a path for each instruction set and the
+ dispatch that picks one at runtime.
+*/
+
+#include "AAPLMathBatch.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AAPL_MATH_BATCH_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__arm64__)
+#define AAPL_MATH_BATCH_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Fusing a multiply and an add rounds once instead of twice, so a compiler that fuses them on
+// some paths and not others would break the promise that all paths return the same bits.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+// GCC's SLP vectorizer can still turn alternating adds and subtracts into fused instructions.
+#pragma GCC optimize("fp-contract=off", "no-tree-slp-vectorize")
+#endif
+
+// Compiles the functions between these macros for an instruction set that the rest of the
+// file doesn't assume, so that the dispatch can call them only on CPUs that support it.
+#define AAPL_PRAGMA(x) _Pragma(#x)
+#if defined(__clang__)
+#define AAPL_BEGIN_TARGET(isa) AAPL_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define AAPL_END_TARGET AAPL_PRAGMA(clang attribute pop)
+#else
+#define AAPL_BEGIN_TARGET(isa) AAPL_PRAGMA(GCC push_options) AAPL_PRAGMA(GCC target(isa))
+#define AAPL_END_TARGET AAPL_PRAGMA(GCC pop_options)
+#endif
+
+namespace
+{
+
+// MARK: - Scalar
+
+namespace scalar
+{
+typedef float Vec;
+static const size_t Width = 1;
+
+inline Vec load(const float* p)         { return *p; }
+inline void store(float* p, Vec v)      { *p = v; }
+inline Vec splat(float f)               { return f; }
+inline Vec add(Vec a, Vec b)            { return a + b; }
+inline Vec sub(Vec a, Vec b)            { return a - b; }
+inline Vec mul(Vec a, Vec b)            { return a * b; }
+inline Vec div(Vec a, Vec b)            { return a / b; }
+inline Vec sqrt(Vec a)                  { return sqrtf(a); }
+
+inline void storeColumns(float* matrices, Vec c0, Vec c1, Vec c2)
+{
+    matrices[0] = c0;
+    matrices[1] = c1;
+    matrices[2] = c2;
+    matrices[3] = 0;
+}
+
+/// Multiplies each column of `b` by `a`, summing the columns of `a` in order.
+inline void multiplyMatrix(float* result, const float* a, const float* b)
+{
+    // Copy the inputs first because the result may be either one.
+    float left[16], right[16];
+    memcpy(left, a, sizeof(left));
+    memcpy(right, b, sizeof(right));
+
+    for(int column = 0; column < 4; column++)
+    {
+        const float* r = right + column * 4;
+        for(int row = 0; row < 4; row++)
+        {
+            result[column * 4 + row] = left[row] * r[0] + left[4 + row] * r[1] + left[8 + row] * r[2] + left[12 + row] * r[3];
+        }
+    }
+}
+
+#include "AAPLMathBatchKernels.h"
+} // namespace scalar
+
+#if AAPL_MATH_BATCH_X86
+
+// MARK: - SSE4.1
+
+AAPL_BEGIN_TARGET("sse4.1")
+namespace sse41
+{
+typedef __m128 Vec;
+static const size_t Width = 4;
+
+inline Vec load(const float* p)         { return _mm_loadu_ps(p); }
+inline void store(float* p, Vec v)      { _mm_storeu_ps(p, v); }
+inline Vec splat(float f)               { return _mm_set1_ps(f); }
+inline Vec add(Vec a, Vec b)            { return _mm_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b)            { return _mm_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b)            { return _mm_mul_ps(a, b); }
+inline Vec div(Vec a, Vec b)            { return _mm_div_ps(a, b); }
+inline Vec sqrt(Vec a)                  { return _mm_sqrt_ps(a); }
+
+inline void storeColumns(float* matrices, Vec c0, Vec c1, Vec c2)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 c01Low = _mm_unpacklo_ps(c0, c1), c01High = _mm_unpackhi_ps(c0, c1);
+    const __m128 c2Low = _mm_unpacklo_ps(c2, zero), c2High = _mm_unpackhi_ps(c2, zero);
+
+    _mm_storeu_ps(matrices,      _mm_movelh_ps(c01Low, c2Low));
+    _mm_storeu_ps(matrices + 16, _mm_movehl_ps(c2Low, c01Low));
+    _mm_storeu_ps(matrices + 32, _mm_movelh_ps(c01High, c2High));
+    _mm_storeu_ps(matrices + 48, _mm_movehl_ps(c2High, c01High));
+}
+
+inline void multiplyMatrix(float* result, const float* a, const float* b)
+{
+    const __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+
+    __m128 columns[4];
+    for(int column = 0; column < 4; column++)
+    {
+        const __m128 b0 = _mm_loadu_ps(b + column * 4);
+        columns[column] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_shuffle_ps(b0, b0, 0x00)),
+                                                           _mm_mul_ps(a1, _mm_shuffle_ps(b0, b0, 0x55))),
+                                                _mm_mul_ps(a2, _mm_shuffle_ps(b0, b0, 0xAA))),
+                                     _mm_mul_ps(a3, _mm_shuffle_ps(b0, b0, 0xFF)));
+    }
+
+    for(int column = 0; column < 4; column++)
+    {
+        _mm_storeu_ps(result + column * 4, columns[column]);
+    }
+}
+
+#include "AAPLMathBatchKernels.h"
+} // namespace sse41
+AAPL_END_TARGET
+
+// MARK: - AVX2
+
+AAPL_BEGIN_TARGET("avx2")
+namespace avx2
+{
+typedef __m256 Vec;
+static const size_t Width = 8;
+
+inline Vec load(const float* p)         { return _mm256_loadu_ps(p); }
+inline void store(float* p, Vec v)      { _mm256_storeu_ps(p, v); }
+inline Vec splat(float f)               { return _mm256_set1_ps(f); }
+inline Vec add(Vec a, Vec b)            { return _mm256_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b)            { return _mm256_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b)            { return _mm256_mul_ps(a, b); }
+inline Vec div(Vec a, Vec b)            { return _mm256_div_ps(a, b); }
+inline Vec sqrt(Vec a)                  { return _mm256_sqrt_ps(a); }
+
+/// Transposes within each 128-bit half, so each vector holds a column of lanes `i` and `i + 4`.
+inline void storeColumns(float* matrices, Vec c0, Vec c1, Vec c2)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 c01Low = _mm256_unpacklo_ps(c0, c1), c01High = _mm256_unpackhi_ps(c0, c1);
+    const __m256 c2Low = _mm256_unpacklo_ps(c2, zero), c2High = _mm256_unpackhi_ps(c2, zero);
+
+    const __m256 lanes[4] =
+    {
+        _mm256_shuffle_ps(c01Low, c2Low, 0x44),
+        _mm256_shuffle_ps(c01Low, c2Low, 0xEE),
+        _mm256_shuffle_ps(c01High, c2High, 0x44),
+        _mm256_shuffle_ps(c01High, c2High, 0xEE),
+    };
+    for(int lane = 0; lane < 4; lane++)
+    {
+        _mm_storeu_ps(matrices + lane * 16,       _mm256_castps256_ps128(lanes[lane]));
+        _mm_storeu_ps(matrices + (lane + 4) * 16, _mm256_extractf128_ps(lanes[lane], 1));
+    }
+}
+
+/// Computes two columns of the result per vector, with each column of `a` in both halves.
+inline void multiplyMatrix(float* result, const float* a, const float* b)
+{
+    const __m256 a0 = _mm256_broadcast_ps((const __m128*)a);
+    const __m256 a1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+    const __m256 a2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+    const __m256 a3 = _mm256_broadcast_ps((const __m128*)(a + 12));
+
+    __m256 columns[2];
+    for(int pair = 0; pair < 2; pair++)
+    {
+        const __m256 b01 = _mm256_loadu_ps(b + pair * 8);
+        columns[pair] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, 0x00)),
+                                                                  _mm256_mul_ps(a1, _mm256_shuffle_ps(b01, b01, 0x55))),
+                                                    _mm256_mul_ps(a2, _mm256_shuffle_ps(b01, b01, 0xAA))),
+                                      _mm256_mul_ps(a3, _mm256_shuffle_ps(b01, b01, 0xFF)));
+    }
+
+    _mm256_storeu_ps(result, columns[0]);
+    _mm256_storeu_ps(result + 8, columns[1]);
+}
+
+#include "AAPLMathBatchKernels.h"
+} // namespace avx2
+AAPL_END_TARGET
+
+// MARK: - AVX-512
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC's AVX-512 intrinsics pass an uninitialized vector as the unused merge operand.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+AAPL_BEGIN_TARGET("avx512f")
+namespace avx512
+{
+typedef __m512 Vec;
+static const size_t Width = 16;
+
+inline Vec load(const float* p)         { return _mm512_loadu_ps(p); }
+inline void store(float* p, Vec v)      { _mm512_storeu_ps(p, v); }
+inline Vec splat(float f)               { return _mm512_set1_ps(f); }
+inline Vec add(Vec a, Vec b)            { return _mm512_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b)            { return _mm512_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b)            { return _mm512_mul_ps(a, b); }
+inline Vec div(Vec a, Vec b)            { return _mm512_div_ps(a, b); }
+inline Vec sqrt(Vec a)                  { return _mm512_sqrt_ps(a); }
+
+/// Transposes within each 128-bit quarter, so each vector holds a column of lanes `i`,
+/// `i + 4`, `i + 8` and `i + 12`.
+inline void storeColumns(float* matrices, Vec c0, Vec c1, Vec c2)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 c01Low = _mm512_unpacklo_ps(c0, c1), c01High = _mm512_unpackhi_ps(c0, c1);
+    const __m512 c2Low = _mm512_unpacklo_ps(c2, zero), c2High = _mm512_unpackhi_ps(c2, zero);
+
+    const __m512 lanes[4] =
+    {
+        _mm512_shuffle_ps(c01Low, c2Low, 0x44),
+        _mm512_shuffle_ps(c01Low, c2Low, 0xEE),
+        _mm512_shuffle_ps(c01High, c2High, 0x44),
+        _mm512_shuffle_ps(c01High, c2High, 0xEE),
+    };
+    for(int lane = 0; lane < 4; lane++)
+    {
+        _mm_storeu_ps(matrices + lane * 16,        _mm512_extractf32x4_ps(lanes[lane], 0));
+        _mm_storeu_ps(matrices + (lane + 4) * 16,  _mm512_extractf32x4_ps(lanes[lane], 1));
+        _mm_storeu_ps(matrices + (lane + 8) * 16,  _mm512_extractf32x4_ps(lanes[lane], 2));
+        _mm_storeu_ps(matrices + (lane + 12) * 16, _mm512_extractf32x4_ps(lanes[lane], 3));
+    }
+}
+
+/// Computes the whole result in one vector, with each column of `a` in all four quarters.
+inline void multiplyMatrix(float* result, const float* a, const float* b)
+{
+    const __m512 left = _mm512_loadu_ps(a);
+    const __m512 a0 = _mm512_shuffle_f32x4(left, left, 0x00);
+    const __m512 a1 = _mm512_shuffle_f32x4(left, left, 0x55);
+    const __m512 a2 = _mm512_shuffle_f32x4(left, left, 0xAA);
+    const __m512 a3 = _mm512_shuffle_f32x4(left, left, 0xFF);
+    const __m512 right = _mm512_loadu_ps(b);
+
+    const __m512 product = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(a0, _mm512_permute_ps(right, 0x00)),
+                                                                     _mm512_mul_ps(a1, _mm512_permute_ps(right, 0x55))),
+                                                       _mm512_mul_ps(a2, _mm512_permute_ps(right, 0xAA))),
+                                         _mm512_mul_ps(a3, _mm512_permute_ps(right, 0xFF)));
+    _mm512_storeu_ps(result, product);
+}
+
+#include "AAPLMathBatchKernels.h"
+} // namespace avx512
+AAPL_END_TARGET
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // AAPL_MATH_BATCH_X86
+
+#if AAPL_MATH_BATCH_NEON
+
+// MARK: - NEON
+
+namespace neon
+{
+typedef float32x4_t Vec;
+static const size_t Width = 4;
+
+inline Vec load(const float* p)         { return vld1q_f32(p); }
+inline void store(float* p, Vec v)      { vst1q_f32(p, v); }
+inline Vec splat(float f)               { return vdupq_n_f32(f); }
+inline Vec add(Vec a, Vec b)            { return vaddq_f32(a, b); }
+inline Vec sub(Vec a, Vec b)            { return vsubq_f32(a, b); }
+inline Vec mul(Vec a, Vec b)            { return vmulq_f32(a, b); }
+inline Vec div(Vec a, Vec b)            { return vdivq_f32(a, b); }
+inline Vec sqrt(Vec a)                  { return vsqrtq_f32(a); }
+
+inline void storeColumns(float* matrices, Vec c0, Vec c1, Vec c2)
+{
+    const float32x4_t zero = vdupq_n_f32(0);
+    const float32x4_t c01Low = vzip1q_f32(c0, c1), c01High = vzip2q_f32(c0, c1);
+    const float32x4_t c2Low = vzip1q_f32(c2, zero), c2High = vzip2q_f32(c2, zero);
+
+    vst1q_f32(matrices,      vcombine_f32(vget_low_f32(c01Low), vget_low_f32(c2Low)));
+    vst1q_f32(matrices + 16, vcombine_f32(vget_high_f32(c01Low), vget_high_f32(c2Low)));
+    vst1q_f32(matrices + 32, vcombine_f32(vget_low_f32(c01High), vget_low_f32(c2High)));
+    vst1q_f32(matrices + 48, vcombine_f32(vget_high_f32(c01High), vget_high_f32(c2High)));
+}
+
+inline void multiplyMatrix(float* result, const float* a, const float* b)
+{
+    const float32x4_t a0 = vld1q_f32(a), a1 = vld1q_f32(a + 4), a2 = vld1q_f32(a + 8), a3 = vld1q_f32(a + 12);
+
+    float32x4_t columns[4];
+    for(int column = 0; column < 4; column++)
+    {
+        const float* r = b + column * 4;
+        columns[column] = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_n_f32(a0, r[0]), vmulq_n_f32(a1, r[1])),
+                                              vmulq_n_f32(a2, r[2])),
+                                    vmulq_n_f32(a3, r[3]));
+    }
+
+    for(int column = 0; column < 4; column++)
+    {
+        vst1q_f32(result + column * 4, columns[column]);
+    }
+}
+
+#include "AAPLMathBatchKernels.h"
+} // namespace neon
+
+#endif // AAPL_MATH_BATCH_NEON
+
+// MARK: - Dispatch
+
+struct Kernels
+{
+    size_t (*quaternionMultiply)(quaternion_float_soa, quaternion_float_soa, quaternion_float_soa, size_t);
+    size_t (*matrixFromQuaternion)(float*, quaternion_float_soa, size_t);
+    size_t (*matrixRotation)(float*, const float*, vector_float3_soa, size_t);
+    size_t (*matrixLookAtLeftHand)(float*, vector_float3_soa, vector_float3_soa, vector_float3_soa, size_t);
+    size_t (*matrixInverseTranspose)(float*, const float*, size_t);
+    void   (*matrixMultiply)(float*, const float*, const float*, size_t);
+    void   (*matrixPremultiply)(float*, const float*, const float*, size_t);
+    size_t (*sphereTransform)(sphere_float_soa, const float*, float, sphere_float_soa, size_t);
+};
+
+#define AAPL_KERNELS(path) { path::quaternionMultiply, path::matrixFromQuaternion, path::matrixRotation, \
+                             path::matrixLookAtLeftHand, path::matrixInverseTranspose, path::matrixMultiply, \
+                             path::matrixPremultiply, path::sphereTransform }
+
+const Kernels& kernelsForPath(MathBatchPath path)
+{
+    static const Kernels scalarKernels = AAPL_KERNELS(scalar);
+#if AAPL_MATH_BATCH_X86
+    static const Kernels sse41Kernels  = AAPL_KERNELS(sse41);
+    static const Kernels avx2Kernels   = AAPL_KERNELS(avx2);
+    static const Kernels avx512Kernels = AAPL_KERNELS(avx512);
+#elif AAPL_MATH_BATCH_NEON
+    static const Kernels neonKernels   = AAPL_KERNELS(neon);
+#endif
+
+    switch(path)
+    {
+#if AAPL_MATH_BATCH_X86
+        case MathBatchPathSSE41:    return sse41Kernels;
+        case MathBatchPathAVX2:     return avx2Kernels;
+        case MathBatchPathAVX512:   return avx512Kernels;
+#elif AAPL_MATH_BATCH_NEON
+        case MathBatchPathNEON:     return neonKernels;
+#endif
+        default:                    return scalarKernels;
+    }
+}
+
+MathBatchPath widestSupportedPath()
+{
+    static const MathBatchPath paths[] =
+    {
+        MathBatchPathAVX512, MathBatchPathAVX2, MathBatchPathSSE41, MathBatchPathNEON
+    };
+
+    for(MathBatchPath path : paths)
+    {
+        if(math_batch_path_supported(path))
+        {
+            return path;
+        }
+    }
+    return MathBatchPathScalar;
+}
+
+std::atomic<const Kernels*>& currentKernels()
+{
+    static std::atomic<const Kernels*> kernels(&kernelsForPath(widestSupportedPath()));
+    return kernels;
+}
+
+std::atomic<MathBatchPath>& currentPath()
+{
+    static std::atomic<MathBatchPath> path(widestSupportedPath());
+    return path;
+}
+
+inline quaternion_float_soa offset(quaternion_float_soa q, size_t i)
+{
+    return { q.x + i, q.y + i, q.z + i, q.w + i };
+}
+
+inline vector_float3_soa offset(vector_float3_soa v, size_t i)
+{
+    return { v.x + i, v.y + i, v.z + i };
+}
+
+inline sphere_float_soa offset(sphere_float_soa s, size_t i)
+{
+    return { s.x + i, s.y + i, s.z + i, s.radius ? s.radius + i : nullptr };
+}
+
+} // namespace
+
+bool math_batch_path_supported(MathBatchPath path)
+{
+    switch(path)
+    {
+        case MathBatchPathScalar:   return true;
+#if AAPL_MATH_BATCH_X86
+        case MathBatchPathSSE41:    return __builtin_cpu_supports("sse4.1");
+        case MathBatchPathAVX2:     return __builtin_cpu_supports("avx2");
+        case MathBatchPathAVX512:   return __builtin_cpu_supports("avx512f");
+#elif AAPL_MATH_BATCH_NEON
+        case MathBatchPathNEON:     return true;
+#endif
+        default:                    return false;
+    }
+}
+
+MathBatchPath math_batch_path()
+{
+    return currentPath().load(std::memory_order_relaxed);
+}
+
+bool math_batch_set_path(MathBatchPath path)
+{
+    if(!math_batch_path_supported(path))
+    {
+        return false;
+    }
+
+    currentPath().store(path, std::memory_order_relaxed);
+    currentKernels().store(&kernelsForPath(path), std::memory_order_relaxed);
+    return true;
+}
+
+const char* math_batch_path_name(MathBatchPath path)
+{
+    switch(path)
+    {
+        case MathBatchPathScalar:   return "Scalar";
+        case MathBatchPathSSE41:    return "SSE4.1";
+        case MathBatchPathAVX2:     return "AVX2";
+        case MathBatchPathAVX512:   return "AVX-512";
+        case MathBatchPathNEON:     return "NEON";
+    }
+    return "Unknown";
+}
+
+void quaternion_multiply_batch(quaternion_float_soa result,
+                               quaternion_float_soa q0,
+                               quaternion_float_soa q1,
+                               size_t count)
+{
+    const size_t done = currentKernels().load(std::memory_order_relaxed)->quaternionMultiply(result, q0, q1, count);
+    scalar::quaternionMultiply(offset(result, done), offset(q0, done), offset(q1, done), count - done);
+}
+
+void matrix4x4_from_quaternion_batch(float* matrices, quaternion_float_soa q, size_t count)
+{
+    const size_t done = currentKernels().load(std::memory_order_relaxed)->matrixFromQuaternion(matrices, q, count);
+    scalar::matrixFromQuaternion(matrices + done * 16, offset(q, done), count - done);
+}
+
+void matrix4x4_rotation_batch(float* matrices, const float* radians, vector_float3_soa axes, size_t count)
+{
+    const size_t done = currentKernels().load(std::memory_order_relaxed)->matrixRotation(matrices, radians, axes, count);
+    scalar::matrixRotation(matrices + done * 16, radians + done, offset(axes, done), count - done);
+}
+
+void matrix_look_at_left_hand_batch(float* matrices,
+                                    vector_float3_soa eyes,
+                                    vector_float3_soa targets,
+                                    vector_float3_soa ups,
+                                    size_t count)
+{
+    const size_t done = currentKernels().load(std::memory_order_relaxed)->matrixLookAtLeftHand(matrices, eyes, targets, ups, count);
+    scalar::matrixLookAtLeftHand(matrices + done * 16, offset(eyes, done), offset(targets, done), offset(ups, done), count - done);
+}
+
+void matrix_inverse_transpose_batch(float* result, const float* matrices, size_t count)
+{
+    const size_t done = currentKernels().load(std::memory_order_relaxed)->matrixInverseTranspose(result, matrices, count);
+    scalar::matrixInverseTranspose(result + done * 16, matrices + done * 16, count - done);
+}
+
+void matrix_multiply_batch(float* result, const float* left, const float* right, size_t count)
+{
+    currentKernels().load(std::memory_order_relaxed)->matrixMultiply(result, left, right, count);
+}
+
+void matrix_premultiply_batch(float* result, const float* left, const float* right, size_t count)
+{
+    // Copy the shared matrix so the kernel can't overwrite it while using it.
+    float leftMatrix[16];
+    memcpy(leftMatrix, left, sizeof(leftMatrix));
+
+    currentKernels().load(std::memory_order_relaxed)->matrixPremultiply(result, leftMatrix, right, count);
+}
+
+void sphere_transform_batch(sphere_float_soa result,
+                            const float* matrix,
+                            sphere_float_soa spheres,
+                            size_t count)
+{
+    float m[16];
+    memcpy(m, matrix, sizeof(m));
+
+    // The longest of the first three columns is the most that the matrix stretches any direction
+    // when it doesn't shear.
+    float lengthSquared = 0;
+    for(int column = 0; column < 3; column++)
+    {
+        const float* c = m + column * 4;
+        lengthSquared = std::max(lengthSquared, c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+    }
+    const float scale = sqrtf(lengthSquared);
+
+    const size_t done = currentKernels().load(std::memory_order_relaxed)->sphereTransform(result, m, scale, spheres, count);
+    scalar::sphereTransform(offset(result, done), m, scale, offset(spheres, done), count - done);
+}
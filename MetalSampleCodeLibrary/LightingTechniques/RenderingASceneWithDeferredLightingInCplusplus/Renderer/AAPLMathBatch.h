@@ -0,0 +1,124 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for batched math functions that compose and transform many matrices, quaternions,
+ and bounding spheres per call.
+*/
+
+#ifndef AAPLMathBatch_h
+#define AAPLMathBatch_h
+
+#include <stddef.h>
+
+// The batch functions take quaternions and bounding spheres as structures of arrays, with one
+// array per component, and 4x4 matrices as arrays of 16 floats in column-major order, the
+// layout of matrix_float4x4.  They run on the widest vector unit the CPU supports: AVX-512,
+// AVX2 or SSE4.1 on x86_64, and NEON on arm64.
+//
+// Every path computes each element with separate multiplies and adds, in the same order as
+// the scalar path, so all paths return the same bits.  The scalar path evaluates the same
+// expressions as the functions of AAPLMathUtilities.cpp, and returns the same bits as they do
+// when the compiler doesn't fuse their multiplies and adds, except where a function below
+// notes otherwise.
+
+/// Quaternions stored as four arrays of components.
+struct quaternion_float_soa
+{
+    float* x;
+    float* y;
+    float* z;
+    float* w;
+};
+
+/// 3D vectors stored as three arrays of components.
+struct vector_float3_soa
+{
+    float* x;
+    float* y;
+    float* z;
+};
+
+/// Bounding spheres stored as arrays of center components and radii.
+/// A null `radius` array means the spheres are points.
+struct sphere_float_soa
+{
+    float* x;
+    float* y;
+    float* z;
+    float* radius;
+};
+
+/// The instruction sets that batch functions can run on.
+enum MathBatchPath
+{
+    MathBatchPathScalar,
+    MathBatchPathSSE41,
+    MathBatchPathAVX2,
+    MathBatchPathAVX512,
+    MathBatchPathNEON,
+};
+
+/// Returns the path that batch functions run on: the widest one the CPU supports, unless
+/// `math_batch_set_path` chose another.
+MathBatchPath math_batch_path();
+
+/// Makes batch functions run on the given path.  Returns false, keeping the current path,
+/// if the CPU doesn't support it.
+bool math_batch_set_path(MathBatchPath path);
+
+/// Returns whether the CPU supports the given path.
+bool math_batch_path_supported(MathBatchPath path);
+
+/// Returns the name of the given path, such as "AVX2".
+const char* math_batch_path_name(MathBatchPath path);
+
+/// Computes `result[i] = q0[i] * q1[i]` like quaternion_multiply.
+/// The result arrays may be the input arrays.
+void quaternion_multiply_batch(quaternion_float_soa result,
+                               quaternion_float_soa q0,
+                               quaternion_float_soa q1,
+                               size_t count);
+
+/// Converts unit-norm quaternions into homogeneous rotation matrices like
+/// matrix4x4_from_quaternion, writing `count` matrices to `matrices`.
+void matrix4x4_from_quaternion_batch(float* matrices, quaternion_float_soa q, size_t count);
+
+/// Builds matrices that rotate by `radians[i]` about `axes[i]` like matrix4x4_rotation,
+/// writing `count` matrices to `matrices`.  The axes needn't have unit length.  The functions
+/// normalize them with a division by their length, where the simd library may round its
+/// reciprocal square root differently, so the matrices can differ from matrix4x4_rotation's in
+/// the last bit unless the axes are unit length.
+void matrix4x4_rotation_batch(float* matrices, const float* radians, vector_float3_soa axes, size_t count);
+
+/// Builds left-handed view matrices like matrix_look_at_left_hand, writing `count` matrices to
+/// `matrices`.  They normalize vectors like matrix4x4_rotation_batch.
+void matrix_look_at_left_hand_batch(float* matrices,
+                                    vector_float3_soa eyes,
+                                    vector_float3_soa targets,
+                                    vector_float3_soa ups,
+                                    size_t count);
+
+/// Computes the inverse transpose of `count` matrices, such as normal matrices from model view
+/// matrices, from their cofactors and determinants.  matrix_inverse_transpose calls the simd
+/// library's matrix_invert, whose steps it doesn't document, so the results agree with it only
+/// to within rounding.  The result may be `matrices`.
+void matrix_inverse_transpose_batch(float* result, const float* matrices, size_t count);
+
+/// Computes `result[i] = left[i] * right[i]` for `count` pairs of matrices, summing the
+/// columns of `left` in order.  The result may be either input.
+void matrix_multiply_batch(float* result, const float* left, const float* right, size_t count);
+
+/// Computes `result[i] = left * right[i]` with one matrix on the left, such as a view matrix
+/// applied to many model matrices.  The result may be `right`.
+void matrix_premultiply_batch(float* result, const float* left, const float* right, size_t count);
+
+/// Transforms the centers of bounding spheres as points by a matrix, and scales their radii
+/// by the matrix's largest axis scale so that the spheres still bound their contents.
+/// The result arrays may be the input arrays.
+void sphere_transform_batch(sphere_float_soa result,
+                            const float* matrix,
+                            sphere_float_soa spheres,
+                            size_t count);
+
+#endif /* AAPLMathBatch_h */
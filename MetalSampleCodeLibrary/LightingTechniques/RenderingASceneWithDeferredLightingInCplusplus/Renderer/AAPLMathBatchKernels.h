@@ -0,0 +1,343 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Batch math kernels, which AAPLMathBatch.cpp includes once for each instruction set.
+*/
+
+// Each inclusion is inside a namespace that defines the vector type `Vec`, its lane count
+// `Width`, the operations `load`, `store`, `splat`, `add`, `sub`, `mul`, `div` and `sqrt`,
+// which round like their scalar operators and sqrtf; `storeColumns`,
+// which writes lane `i` of three vectors and a zero to `matrices + i * 16`; and
+// `multiplyMatrix`, which multiplies one pair of matrices.  The kernels that take structures
+// of arrays process whole vectors only and return how many elements they processed, so the
+// caller finishes the rest on the scalar path.
+
+/// Computes the products of quaternions, with the expressions of quaternion_multiply.
+size_t quaternionMultiply(quaternion_float_soa result,
+                          quaternion_float_soa q0,
+                          quaternion_float_soa q1,
+                          size_t count)
+{
+    size_t i = 0;
+    for(; i + Width <= count; i += Width)
+    {
+        const Vec ax = load(q0.x + i), ay = load(q0.y + i), az = load(q0.z + i), aw = load(q0.w + i);
+        const Vec bx = load(q1.x + i), by = load(q1.y + i), bz = load(q1.z + i), bw = load(q1.w + i);
+
+        const Vec x = sub(add(add(mul(aw, bx), mul(ax, bw)), mul(ay, bz)), mul(az, by));
+        const Vec y = add(add(sub(mul(aw, by), mul(ax, bz)), mul(ay, bw)), mul(az, bx));
+        const Vec z = add(sub(add(mul(aw, bz), mul(ax, by)), mul(ay, bx)), mul(az, bw));
+        const Vec w = sub(sub(sub(mul(aw, bw), mul(ax, bx)), mul(ay, by)), mul(az, bz));
+
+        store(result.x + i, x);
+        store(result.y + i, y);
+        store(result.z + i, z);
+        store(result.w + i, w);
+    }
+    return i;
+}
+
+/// Builds rotation matrices from quaternions, with the expressions of matrix4x4_from_quaternion.
+size_t matrixFromQuaternion(float* matrices, quaternion_float_soa q, size_t count)
+{
+    const Vec one = splat(1.0f), two = splat(2.0f);
+
+    size_t i = 0;
+    for(; i + Width <= count; i += Width)
+    {
+        const Vec x = load(q.x + i), y = load(q.y + i), z = load(q.z + i), w = load(q.w + i);
+
+        const Vec xx = mul(x, x), xy = mul(x, y), xz = mul(x, z), xw = mul(x, w);
+        const Vec yy = mul(y, y), yz = mul(y, z), yw = mul(y, w);
+        const Vec zz = mul(z, z), zw = mul(z, w);
+
+        // Indices are m<column><row>
+        const Vec m00 = sub(one, mul(two, add(yy, zz)));
+        const Vec m10 = mul(two, sub(xy, zw));
+        const Vec m20 = mul(two, add(xz, yw));
+
+        const Vec m01 = mul(two, add(xy, zw));
+        const Vec m11 = sub(one, mul(two, add(xx, zz)));
+        const Vec m21 = mul(two, sub(yz, xw));
+
+        const Vec m02 = mul(two, sub(xz, yw));
+        const Vec m12 = mul(two, add(yz, xw));
+        const Vec m22 = sub(one, mul(two, add(xx, yy)));
+
+        float* matrix = matrices + i * 16;
+        storeColumns(matrix,     m00, m01, m02);
+        storeColumns(matrix + 4, m10, m11, m12);
+        storeColumns(matrix + 8, m20, m21, m22);
+        for(size_t lane = 0; lane < Width; lane++)
+        {
+            matrix[lane * 16 + 12] = 0;
+            matrix[lane * 16 + 13] = 0;
+            matrix[lane * 16 + 14] = 0;
+            matrix[lane * 16 + 15] = 1;
+        }
+    }
+    return i;
+}
+
+inline Vec dot(Vec ax, Vec ay, Vec az, Vec bx, Vec by, Vec bz)
+{
+    return add(add(mul(ax, bx), mul(ay, by)), mul(az, bz));
+}
+
+inline void cross(Vec ax, Vec ay, Vec az, Vec bx, Vec by, Vec bz, Vec& x, Vec& y, Vec& z)
+{
+    x = sub(mul(ay, bz), mul(az, by));
+    y = sub(mul(az, bx), mul(ax, bz));
+    z = sub(mul(ax, by), mul(ay, bx));
+}
+
+/// Divides a vector by its length.
+inline void normalize(Vec& x, Vec& y, Vec& z)
+{
+    const Vec length = sqrt(dot(x, y, z, x, y, z));
+    x = div(x, length);
+    y = div(y, length);
+    z = div(z, length);
+}
+
+/// Builds rotation matrices, with the expressions of matrix4x4_rotation.  Every path takes the
+/// sines and cosines from sinf and cosf, so that they return the same bits.
+size_t matrixRotation(float* matrices, const float* radians, vector_float3_soa axes, size_t count)
+{
+    const Vec one = splat(1.0f);
+
+    size_t i = 0;
+    for(; i + Width <= count; i += Width)
+    {
+        float cosines[Width], sines[Width];
+        for(size_t lane = 0; lane < Width; lane++)
+        {
+            cosines[lane] = cosf(radians[i + lane]);
+            sines[lane] = sinf(radians[i + lane]);
+        }
+
+        Vec x = load(axes.x + i), y = load(axes.y + i), z = load(axes.z + i);
+        normalize(x, y, z);
+
+        const Vec ct = load(cosines), st = load(sines);
+        const Vec ci = sub(one, ct);
+
+        // Indices are m<column><row>
+        const Vec m00 = add(ct, mul(mul(x, x), ci));
+        const Vec m01 = add(mul(mul(y, x), ci), mul(z, st));
+        const Vec m02 = sub(mul(mul(z, x), ci), mul(y, st));
+
+        const Vec m10 = sub(mul(mul(x, y), ci), mul(z, st));
+        const Vec m11 = add(ct, mul(mul(y, y), ci));
+        const Vec m12 = add(mul(mul(z, y), ci), mul(x, st));
+
+        const Vec m20 = add(mul(mul(x, z), ci), mul(y, st));
+        const Vec m21 = sub(mul(mul(y, z), ci), mul(x, st));
+        const Vec m22 = add(ct, mul(mul(z, z), ci));
+
+        float* matrix = matrices + i * 16;
+        storeColumns(matrix,     m00, m01, m02);
+        storeColumns(matrix + 4, m10, m11, m12);
+        storeColumns(matrix + 8, m20, m21, m22);
+        for(size_t lane = 0; lane < Width; lane++)
+        {
+            matrix[lane * 16 + 12] = 0;
+            matrix[lane * 16 + 13] = 0;
+            matrix[lane * 16 + 14] = 0;
+            matrix[lane * 16 + 15] = 1;
+        }
+    }
+    return i;
+}
+
+/// Builds view matrices, with the expressions of matrix_look_at_left_hand.
+size_t matrixLookAtLeftHand(float* matrices,
+                            vector_float3_soa eyes,
+                            vector_float3_soa targets,
+                            vector_float3_soa ups,
+                            size_t count)
+{
+    // Negating by multiplying gives -0 for a zero dot product, like the unary minus.
+    const Vec minusOne = splat(-1.0f);
+
+    size_t i = 0;
+    for(; i + Width <= count; i += Width)
+    {
+        const Vec eyeX = load(eyes.x + i), eyeY = load(eyes.y + i), eyeZ = load(eyes.z + i);
+
+        Vec zx = sub(load(targets.x + i), eyeX), zy = sub(load(targets.y + i), eyeY), zz = sub(load(targets.z + i), eyeZ);
+        normalize(zx, zy, zz);
+
+        Vec xx, xy, xz;
+        cross(load(ups.x + i), load(ups.y + i), load(ups.z + i), zx, zy, zz, xx, xy, xz);
+        normalize(xx, xy, xz);
+
+        Vec yx, yy, yz;
+        cross(zx, zy, zz, xx, xy, xz, yx, yy, yz);
+
+        const Vec tx = mul(dot(xx, xy, xz, eyeX, eyeY, eyeZ), minusOne);
+        const Vec ty = mul(dot(yx, yy, yz, eyeX, eyeY, eyeZ), minusOne);
+        const Vec tz = mul(dot(zx, zy, zz, eyeX, eyeY, eyeZ), minusOne);
+
+        float* matrix = matrices + i * 16;
+        storeColumns(matrix,      xx, yx, zx);
+        storeColumns(matrix + 4,  xy, yy, zy);
+        storeColumns(matrix + 8,  xz, yz, zz);
+        storeColumns(matrix + 12, tx, ty, tz);
+        for(size_t lane = 0; lane < Width; lane++)
+        {
+            matrix[lane * 16 + 15] = 1;
+        }
+    }
+    return i;
+}
+
+/// Computes `(p * u - q * v + r * w) * scale`, one element of an inverse.
+inline Vec cofactor(Vec p, Vec q, Vec r, Vec u, Vec v, Vec w, Vec scale)
+{
+    return mul(add(sub(mul(p, u), mul(q, v)), mul(r, w)), scale);
+}
+
+/// Computes inverse transposes from the 2x2 determinants of the first two and last two rows of
+/// the transposed matrices.  Reading a column-major matrix as row major transposes it, so the
+/// inverse of what the kernel reads is the inverse transpose, which it writes column major.
+size_t matrixInverseTranspose(float* result, const float* matrices, size_t count)
+{
+    const Vec one = splat(1.0f), minusOne = splat(-1.0f);
+
+    size_t i = 0;
+    for(; i + Width <= count; i += Width)
+    {
+        // Gather each element of the matrices into a vector.  a[row * 4 + column] is an element
+        // of the transposed matrix.
+        float elements[16][Width];
+        for(size_t lane = 0; lane < Width; lane++)
+        {
+            for(int element = 0; element < 16; element++)
+            {
+                elements[element][lane] = matrices[(i + lane) * 16 + element];
+            }
+        }
+
+        Vec a[16];
+        for(int element = 0; element < 16; element++)
+        {
+            a[element] = load(elements[element]);
+        }
+
+        const Vec s0 = sub(mul(a[0], a[5]), mul(a[4], a[1]));
+        const Vec s1 = sub(mul(a[0], a[6]), mul(a[4], a[2]));
+        const Vec s2 = sub(mul(a[0], a[7]), mul(a[4], a[3]));
+        const Vec s3 = sub(mul(a[1], a[6]), mul(a[5], a[2]));
+        const Vec s4 = sub(mul(a[1], a[7]), mul(a[5], a[3]));
+        const Vec s5 = sub(mul(a[2], a[7]), mul(a[6], a[3]));
+
+        const Vec c0 = sub(mul(a[8], a[13]), mul(a[12], a[9]));
+        const Vec c1 = sub(mul(a[8], a[14]), mul(a[12], a[10]));
+        const Vec c2 = sub(mul(a[8], a[15]), mul(a[12], a[11]));
+        const Vec c3 = sub(mul(a[9], a[14]), mul(a[13], a[10]));
+        const Vec c4 = sub(mul(a[9], a[15]), mul(a[13], a[11]));
+        const Vec c5 = sub(mul(a[10], a[15]), mul(a[14], a[11]));
+
+        const Vec determinant = add(sub(add(add(sub(mul(s0, c5), mul(s1, c4)), mul(s2, c3)), mul(s3, c2)), mul(s4, c1)), mul(s5, c0));
+        const Vec positive = div(one, determinant);
+        const Vec negative = mul(positive, minusOne);
+
+        // Each element of the inverse is a cofactor over the determinant, with its sign.
+        Vec inverse[16];
+        inverse[0]  = cofactor(a[5],  a[6],  a[7],  c5, c4, c3, positive);
+        inverse[1]  = cofactor(a[1],  a[2],  a[3],  c5, c4, c3, negative);
+        inverse[2]  = cofactor(a[13], a[14], a[15], s5, s4, s3, positive);
+        inverse[3]  = cofactor(a[9],  a[10], a[11], s5, s4, s3, negative);
+        inverse[4]  = cofactor(a[4],  a[6],  a[7],  c5, c2, c1, negative);
+        inverse[5]  = cofactor(a[0],  a[2],  a[3],  c5, c2, c1, positive);
+        inverse[6]  = cofactor(a[12], a[14], a[15], s5, s2, s1, negative);
+        inverse[7]  = cofactor(a[8],  a[10], a[11], s5, s2, s1, positive);
+        inverse[8]  = cofactor(a[4],  a[5],  a[7],  c4, c2, c0, positive);
+        inverse[9]  = cofactor(a[0],  a[1],  a[3],  c4, c2, c0, negative);
+        inverse[10] = cofactor(a[12], a[13], a[15], s4, s2, s0, positive);
+        inverse[11] = cofactor(a[8],  a[9],  a[11], s4, s2, s0, negative);
+        inverse[12] = cofactor(a[4],  a[5],  a[6],  c3, c1, c0, negative);
+        inverse[13] = cofactor(a[0],  a[1],  a[2],  c3, c1, c0, positive);
+        inverse[14] = cofactor(a[12], a[13], a[14], s3, s1, s0, negative);
+        inverse[15] = cofactor(a[8],  a[9],  a[10], s3, s1, s0, positive);
+
+        // Scatter the inverse of the transposed matrix as row major.
+        for(int element = 0; element < 16; element++)
+        {
+            store(elements[element], inverse[element]);
+        }
+        for(size_t lane = 0; lane < Width; lane++)
+        {
+            for(int row = 0; row < 4; row++)
+            {
+                for(int column = 0; column < 4; column++)
+                {
+                    result[(i + lane) * 16 + column * 4 + row] = elements[row * 4 + column][lane];
+                }
+            }
+        }
+    }
+    return i;
+}
+
+void matrixMultiply(float* result, const float* left, const float* right, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        multiplyMatrix(result + i * 16, left + i * 16, right + i * 16);
+    }
+}
+
+void matrixPremultiply(float* result, const float* left, const float* right, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        multiplyMatrix(result + i * 16, left, right + i * 16);
+    }
+}
+
+/// Transforms sphere centers as points, adding the matrix's translation column last, and
+/// multiplies radii by `scale`.
+size_t sphereTransform(sphere_float_soa result,
+                       const float* matrix,
+                       float scale,
+                       sphere_float_soa spheres,
+                       size_t count)
+{
+    Vec columns[4][3];
+    for(int column = 0; column < 4; column++)
+    {
+        for(int row = 0; row < 3; row++)
+        {
+            columns[column][row] = splat(matrix[column * 4 + row]);
+        }
+    }
+    const Vec radiusScale = splat(scale);
+    const bool transformRadii = spheres.radius && result.radius;
+
+    size_t i = 0;
+    for(; i + Width <= count; i += Width)
+    {
+        const Vec x = load(spheres.x + i), y = load(spheres.y + i), z = load(spheres.z + i);
+
+        Vec transformed[3];
+        for(int row = 0; row < 3; row++)
+        {
+            transformed[row] = add(add(add(mul(columns[0][row], x), mul(columns[1][row], y)),
+                                       mul(columns[2][row], z)),
+                                   columns[3][row]);
+        }
+
+        store(result.x + i, transformed[0]);
+        store(result.y + i, transformed[1]);
+        store(result.z + i, transformed[2]);
+
+        if(transformRadii)
+        {
+            store(result.radius + i, mul(load(spheres.radius + i), radiusScale));
+        }
+    }
+    return i;
+}
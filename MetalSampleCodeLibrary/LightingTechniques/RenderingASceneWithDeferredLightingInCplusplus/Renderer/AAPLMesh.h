@@ -10,6 +10,7 @@ Header for mesh and submesh objects used for managing models.
 #include <unordered_map>
 
 #include "AAPLShaderTypes.h"
+#include "AAPLArena.h"
 #include <vector>
 #include <array>
 
@@ -25,6 +26,8 @@ struct MeshVertex
     vector_float3 bitangent;
 };
 
+class MeshBufferAllocator;
+
 class MeshBuffer
 {
 public:
@@ -50,11 +53,17 @@ public:
     NS::UInteger argumentIndex() const;
     NS::UInteger offset() const;
 
+    /// Allocates an index buffer of `indexBufferSize` bytes, and a buffer for each vertex buffer
+    /// layout of `pDescriptor`, from `allocator`.
     static std::vector<MeshBuffer>
-    makeVertexBuffers(MTL::Device* pDevice,
+    makeVertexBuffers(MeshBufferAllocator& allocator,
                       const MTL::VertexDescriptor* pDescriptor,
                       NS::UInteger vertexCount,
-                      NS::UInteger indexBufferSize);
+                      NS::UInteger indexBufferSize,
+                      MeshBuffer& indexBuffer);
+
+    /// Returns the address of the mesh buffer's first byte.
+    uint8_t* contents() const;
 
 private:
 
@@ -116,8 +125,8 @@ public:
 
     Mesh();
 
-    Mesh(const std::vector<Submesh> & submeshes,
-         const std::vector<MeshBuffer> & vertexBuffers);
+    Mesh(std::vector<Submesh> submeshes,
+         std::vector<MeshBuffer> vertexBuffers);
 
     Mesh(const Submesh & submesh,
          const std::vector<MeshBuffer> & vertexBuffers);
@@ -141,17 +150,56 @@ private:
     std::vector<MeshBuffer> m_vertexBuffers;
 };
 
+/// Packs the vertices and indices of many meshes into a few large Metal buffers, and provides
+/// scratch memory for building them, for as long as a scene loads.  Mesh buffers retain their
+/// Metal buffer, so meshes outlive the allocator.
+class MeshBufferAllocator
+{
+public:
+
+    explicit MeshBufferAllocator(MTL::Device* pDevice,
+                                 NS::UInteger pageSize = PagedSubAllocator::DefaultPageSize);
+
+    ~MeshBufferAllocator();
+
+    MeshBufferAllocator(const MeshBufferAllocator&) = delete;
+    MeshBufferAllocator& operator=(const MeshBufferAllocator&) = delete;
+
+    MTL::Device* device() const;
+
+    /// Returns `length` bytes of one of the allocator's Metal buffers, at an offset that any
+    /// vertex, index, or constant buffer binding accepts.
+    MeshBuffer allocate(NS::UInteger length, NS::UInteger argumentIndex = NS::UIntegerMax);
+
+    /// Memory for temporary arrays while building a mesh.  Each mesh builder rewinds it when done.
+    LinearArena& scratch();
+
+    /// How the allocator packed mesh data into Metal buffers.
+    const AllocatorStats& stats() const;
+
+private:
+
+    MTL::Device* m_pDevice;
+
+    PagedSubAllocator m_pages;
+
+    // The Metal buffer that backs each page
+    std::vector<MTL::Buffer*> m_buffers;
+
+    LinearArena m_scratch;
+};
+
 std::vector<Mesh> newMeshesFromBundlePath(const char* bundlePath,
-                                          MTL::Device* pDevice,
+                                          MeshBufferAllocator& allocator,
                                           const MTL::VertexDescriptor& vertexDescriptor,
                                           NS::Error **pError);
 
 
-Mesh makeSphereMesh(MTL::Device* pDevice,
+Mesh makeSphereMesh(MeshBufferAllocator& allocator,
                     const MTL::VertexDescriptor& vertexDescriptor,
                     int radialSegments, int verticalSegments, float radius);
 
-Mesh makeIcosahedronMesh(MTL::Device* pDevice,
+Mesh makeIcosahedronMesh(MeshBufferAllocator& allocator,
                          const MTL::VertexDescriptor& vertexDescriptor,
                          float radius);
 
@@ -179,6 +227,28 @@ inline NS::UInteger MeshBuffer::argumentIndex() const
     return m_argumentIndex;
 }
 
+inline uint8_t* MeshBuffer::contents() const
+{
+    return (uint8_t*)m_pBuffer->contents() + m_offset;
+}
+
+#pragma mark - MeshBufferAllocator inline implementations
+
+inline MTL::Device* MeshBufferAllocator::device() const
+{
+    return m_pDevice;
+}
+
+inline LinearArena& MeshBufferAllocator::scratch()
+{
+    return m_scratch;
+}
+
+inline const AllocatorStats& MeshBufferAllocator::stats() const
+{
+    return m_pages.stats();
+}
+
 #pragma mark - Submesh inline implementations
 
 inline MTL::PrimitiveType Submesh::primitiveType() const
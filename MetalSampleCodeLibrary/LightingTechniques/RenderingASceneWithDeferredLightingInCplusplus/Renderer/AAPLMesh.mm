@@ -6,10 +6,10 @@ Implementation for mesh and submesh objects.
 */
 #include <MetalKit/MetalKit.h>
 #include <ModelIO/ModelIO.h>
-#include <set>
 #include <unordered_map>
 
 #include "AAPLMesh.h"
+#include "AAPLMeshOptimizer.h"
 
 // Include the header shared between C code here, which executes Metal API commands, and .metal files.
 #include "AAPLShaderTypes.h"
@@ -209,10 +209,10 @@ Mesh::Mesh()
 }
 
 
-inline Mesh::Mesh(const std::vector<Submesh>& submeshes,
-                  const std::vector<MeshBuffer>& vertexBuffers)
-: m_submeshes(submeshes)
-, m_vertexBuffers(vertexBuffers)
+inline Mesh::Mesh(std::vector<Submesh> submeshes,
+                  std::vector<MeshBuffer> vertexBuffers)
+: m_submeshes(std::move(submeshes))
+, m_vertexBuffers(std::move(vertexBuffers))
 {
     
 }
@@ -239,17 +239,18 @@ Mesh& Mesh::operator=(const Mesh& rhs)
     return *this;
 }
 
+// Moving a mesh takes its arrays, rather than copying and retaining every buffer and texture.
 Mesh::Mesh(Mesh&& rhs)
-: m_submeshes( rhs.m_submeshes)
-, m_vertexBuffers( rhs.m_vertexBuffers )
+: m_submeshes( std::move(rhs.m_submeshes) )
+, m_vertexBuffers( std::move(rhs.m_vertexBuffers) )
 {
     
 }
 
 Mesh& Mesh::operator=(Mesh&& rhs)
 {
-    m_submeshes = rhs.m_submeshes;
-    m_vertexBuffers = rhs.m_vertexBuffers;
+    m_submeshes = std::move(rhs.m_submeshes);
+    m_vertexBuffers = std::move(rhs.m_vertexBuffers);
     return *this;
 }
 
@@ -257,6 +258,42 @@ Mesh::~Mesh()
 {
 }
 
+#pragma mark - MeshBufferAllocator Implementation
+
+// Offsets that Metal accepts for every buffer binding, including constant buffers on macOS
+static const NS::UInteger MeshBufferAlignment = 256;
+
+MeshBufferAllocator::MeshBufferAllocator(MTL::Device* pDevice, NS::UInteger pageSize)
+: m_pDevice( pDevice->retain() )
+, m_pages( pageSize )
+{
+    
+}
+
+MeshBufferAllocator::~MeshBufferAllocator()
+{
+    // Mesh buffers retain the pages they use, so this only frees pages that no mesh uses.
+    for(MTL::Buffer* pBuffer : m_buffers)
+    {
+        pBuffer->release();
+    }
+    m_pDevice->release();
+}
+
+MeshBuffer MeshBufferAllocator::allocate(NS::UInteger length, NS::UInteger argumentIndex)
+{
+    const PagedSubAllocator::Allocation allocation = m_pages.allocate(length, MeshBufferAlignment);
+
+    // Back each new page with a shared Metal buffer, whose contents are page-aligned.
+    while(m_buffers.size() < m_pages.pageCount())
+    {
+        const uint32_t page = (uint32_t)m_buffers.size();
+        m_buffers.push_back( m_pDevice->newBuffer(m_pages.pageSize(page), MTL::ResourceStorageModeShared) );
+    }
+
+    return MeshBuffer(m_buffers[allocation.page], allocation.offset, length, argumentIndex);
+}
+
 static MTL::Texture* createTextureFromMaterial(MDLMaterial * material,
                                          MDLMaterialSemantic materialSemantic,
                                          MTKTextureLoader* textureLoader)
@@ -374,10 +411,120 @@ static Submesh createSubmesh(MDLSubmesh *modelIOSubmesh,
 }
 
 
+// Copies a ModelIO index buffer's indices to 32-bit indices, or back.
+static void readModelIOIndices(uint32_t* pIndices, const void* pData, MDLIndexBitDepth indexType, NSUInteger indexCount)
+{
+    for(NSUInteger i = 0; i < indexCount; i++)
+    {
+        switch(indexType)
+        {
+            case MDLIndexBitDepthUInt8:  pIndices[i] = ((const uint8_t*)pData)[i];  break;
+            case MDLIndexBitDepthUInt16: pIndices[i] = ((const uint16_t*)pData)[i]; break;
+            default:                     pIndices[i] = ((const uint32_t*)pData)[i]; break;
+        }
+    }
+}
+
+static void writeModelIOIndices(void* pData, const uint32_t* pIndices, MDLIndexBitDepth indexType, NSUInteger indexCount)
+{
+    for(NSUInteger i = 0; i < indexCount; i++)
+    {
+        switch(indexType)
+        {
+            case MDLIndexBitDepthUInt8:  ((uint8_t*)pData)[i]  = (uint8_t)pIndices[i];  break;
+            case MDLIndexBitDepthUInt16: ((uint16_t*)pData)[i] = (uint16_t)pIndices[i]; break;
+            default:                     ((uint32_t*)pData)[i] = pIndices[i];           break;
+        }
+    }
+}
+
+// Reorders the triangles of each submesh of a ModelIO mesh for the vertex cache and overdraw,
+// and the vertices in the order that the submeshes first use them.  The vertices that triangles
+// use come first, so their new indices still fit each submesh's index type.
+static void optimizeModelIOMesh(MDLMesh *modelIOMesh, LinearArena& scratch)
+{
+    const NSUInteger vertexCount = modelIOMesh.vertexCount;
+
+    MDLVertexAttributeData *positions = [modelIOMesh vertexAttributeDataForAttributeNamed:MDLVertexAttributePosition
+                                                                                 asFormat:MDLVertexFormatFloat3];
+    if(!vertexCount || !positions)
+    {
+        return;
+    }
+
+    for(MDLSubmesh *submesh in modelIOMesh.submeshes)
+    {
+        if(submesh.geometryType != MDLGeometryTypeTriangles)
+        {
+            return;
+        }
+    }
+
+    // Keep the temporary arrays in the load's scratch memory, which this returns when done.
+    LinearArena::Scope scope(scratch);
+
+    NSUInteger totalIndexCount = 0;
+    for(MDLSubmesh *submesh in modelIOMesh.submeshes)
+    {
+        totalIndexCount += submesh.indexCount;
+    }
+
+    NSMutableArray<MDLMeshBufferMap *> *indexMaps = [NSMutableArray new];
+    NSUInteger *firstIndices = scratch.allocateArray<NSUInteger>(modelIOMesh.submeshes.count);
+    uint32_t *indices = scratch.allocateArray<uint32_t>(totalIndexCount);
+
+    NSUInteger indexCount = 0;
+    for(MDLSubmesh *submesh in modelIOMesh.submeshes)
+    {
+        MDLMeshBufferMap *indexMap = [submesh.indexBuffer map];
+        [indexMaps addObject:indexMap];
+
+        const NSUInteger firstIndex = indexCount;
+        firstIndices[indexMaps.count - 1] = firstIndex;
+        indexCount += submesh.indexCount;
+
+        uint32_t *submeshIndices = indices + firstIndex;
+        readModelIOIndices(submeshIndices, indexMap.bytes, submesh.indexType, submesh.indexCount);
+
+        AAPLMeshOptimizeVertexCache(submeshIndices, submeshIndices, submesh.indexCount, vertexCount);
+        AAPLMeshOptimizeOverdraw(submeshIndices, submeshIndices, submesh.indexCount,
+                                 (const float *)positions.dataStart, vertexCount, positions.stride,
+                                 AAPLMeshDefaultOverdrawThreshold);
+    }
+
+    uint32_t *remap = scratch.allocateArray<uint32_t>(vertexCount);
+    AAPLMeshOptimizeVertexFetchRemap(remap, indices, totalIndexCount, vertexCount);
+    AAPLMeshRemapIndices(indices, indices, totalIndexCount, remap);
+
+    for(NSUInteger index = 0; index < modelIOMesh.submeshes.count; index++)
+    {
+        MDLSubmesh *submesh = modelIOMesh.submeshes[index];
+        writeModelIOIndices(indexMaps[index].bytes, indices + firstIndices[index],
+                            submesh.indexType, submesh.indexCount);
+    }
+
+    for(NSUInteger bufferIndex = 0; bufferIndex < modelIOMesh.vertexBuffers.count; bufferIndex++)
+    {
+        const NSUInteger stride = modelIOMesh.vertexDescriptor.layouts[bufferIndex].stride;
+        id<MDLMeshBuffer> vertexBuffer = modelIOMesh.vertexBuffers[bufferIndex];
+        if(!stride || vertexBuffer.length < vertexCount * stride)
+        {
+            continue;
+        }
+
+        LinearArena::Scope vertexScope(scratch);
+        uint8_t *vertices = scratch.allocateArray<uint8_t>(vertexCount * stride);
+
+        MDLMeshBufferMap *vertexMap = [vertexBuffer map];
+        memcpy(vertices, vertexMap.bytes, vertexCount * stride);
+        AAPLMeshRemapVertices(vertexMap.bytes, vertices, vertexCount, stride, remap);
+    }
+}
+
 Mesh createMeshFromModelIOMesh(MDLMesh *modelIOMesh,
                                MDLVertexDescriptor *vertexDescriptor,
                                MTKTextureLoader* textureLoader,
-                               MTL::Device* pDevice,
+                               MeshBufferAllocator& allocator,
                                NS::Error** pError)
 {
 
@@ -405,6 +552,8 @@ Mesh createMeshFromModelIOMesh(MDLMesh *modelIOMesh,
 
     modelIOMesh.vertexDescriptor = vertexDescriptor;
 
+    // Reorder the relaid out vertices and the triangles before MetalKit copies them to Metal buffers.
+    optimizeModelIOMesh(modelIOMesh, allocator.scratch());
 
     NSError* err = nil;
     
@@ -412,7 +561,7 @@ Mesh createMeshFromModelIOMesh(MDLMesh *modelIOMesh,
     // Create the MetalKit mesh which will contain the Metal buffer(s) with the mesh's vertex data
     //   and submeshes with info to draw the mesh.
     MTKMesh* metalKitMesh = [[MTKMesh alloc] initWithMesh:modelIOMesh
-                                                   device:(__bridge id<MTLDevice>)pDevice
+                                                   device:(__bridge id<MTLDevice>)allocator.device()
                                                     error:&err];
 
     AAPL_ASSERT( !err, "Error loading MTKMesh" );
@@ -436,6 +585,7 @@ Mesh createMeshFromModelIOMesh(MDLMesh *modelIOMesh,
     }
 
     std::vector<Submesh> submeshes;
+    submeshes.reserve(metalKitMesh.submeshes.count);
 
     // Create a submesh object for each submesh and add it to the submesh's array.
     for(NSUInteger index = 0; index < metalKitMesh.submeshes.count; index++)
@@ -443,14 +593,14 @@ Mesh createMeshFromModelIOMesh(MDLMesh *modelIOMesh,
         // Create an app specific submesh to hold the MetalKit submesh
         auto submesh = createSubmesh(modelIOMesh.submeshes[index],
                                      metalKitMesh.submeshes[index],
-                                     pDevice,
+                                     allocator.device(),
                                      textureLoader);
         
         submeshes.push_back( submesh );
     }
 
 
-    Mesh mesh(submeshes, vertexBuffers);
+    Mesh mesh(std::move(submeshes), std::move(vertexBuffers));
 
     return mesh;
 }
@@ -458,7 +608,7 @@ Mesh createMeshFromModelIOMesh(MDLMesh *modelIOMesh,
 static std::vector<Mesh> createMeshesFromModelIOObject(MDLObject* object,
                                                        MDLVertexDescriptor * vertexDescriptor,
                                                        MTKTextureLoader* textureLoader,
-                                                       MTL::Device* pDevice,
+                                                       MeshBufferAllocator& allocator,
                                                        NS::Error** pError)
 {
     std::vector<Mesh> newMeshes;
@@ -472,10 +622,10 @@ static std::vector<Mesh> createMeshesFromModelIOObject(MDLObject* object,
         auto mesh = createMeshFromModelIOMesh(modelIOMesh,
                                                vertexDescriptor,
                                                textureLoader,
-                                               pDevice,
+                                               allocator,
                                                pError);
 
-        newMeshes.push_back( mesh );
+        newMeshes.push_back( std::move(mesh) );
     }
 
     // Recursively traverse the ModelIO asset hierarchy to find ModelIO meshes that are children
@@ -484,16 +634,18 @@ static std::vector<Mesh> createMeshesFromModelIOObject(MDLObject* object,
     {
         std::vector<Mesh> childMeshes;
 
-        childMeshes = createMeshesFromModelIOObject(child, vertexDescriptor, textureLoader, pDevice, pError);
+        childMeshes = createMeshesFromModelIOObject(child, vertexDescriptor, textureLoader, allocator, pError);
 
-        newMeshes.insert(newMeshes.end(), childMeshes.begin(), childMeshes.end());
+        newMeshes.insert(newMeshes.end(),
+                         std::make_move_iterator(childMeshes.begin()),
+                         std::make_move_iterator(childMeshes.end()));
     }
 
     return newMeshes;
 }
 
 std::vector<Mesh> newMeshesFromBundlePath(const char* bundlePath,
-                                          MTL::Device* pDevice,
+                                          MeshBufferAllocator& allocator,
                                           const MTL::VertexDescriptor& vertexDescriptor,
                                           NS::Error** pError)
 {
@@ -517,7 +669,7 @@ std::vector<Mesh> newMeshesFromBundlePath(const char* bundlePath,
     // Create a MetalKit mesh buffer allocator so that ModelIO will load mesh data directly into
     // Metal buffers accessible by the GPU.
     MTKMeshBufferAllocator *bufferAllocator =
-        [[MTKMeshBufferAllocator alloc] initWithDevice:(__bridge id<MTLDevice>)pDevice];
+        [[MTKMeshBufferAllocator alloc] initWithDevice:(__bridge id<MTLDevice>)allocator.device()];
 
     // Use ModelIO to load the model file at the URL.  This returns a ModelIO asset object, which
     // contains a hierarchy of ModelIO objects composing a "scene" described by the model file.
@@ -531,7 +683,7 @@ std::vector<Mesh> newMeshesFromBundlePath(const char* bundlePath,
 
     // Create a MetalKit texture loader to load material textures from files or the asset catalog
     //   into Metal textures.
-    MTKTextureLoader* textureLoader = [[MTKTextureLoader alloc] initWithDevice:(__bridge id<MTLDevice>)pDevice];
+    MTKTextureLoader* textureLoader = [[MTKTextureLoader alloc] initWithDevice:(__bridge id<MTLDevice>)allocator.device()];
 
     std::vector<Mesh> newMeshes;
 
@@ -541,13 +693,15 @@ std::vector<Mesh> newMeshesFromBundlePath(const char* bundlePath,
     // mesh objects from those ModelIO meshes.
     for(MDLObject* object in asset)
     {
-        const std::vector<Mesh>& assetMeshes = createMeshesFromModelIOObject(object,
-                                                                             modelIOVertexDescriptor,
-                                                                             textureLoader,
-                                                                             pDevice,
-                                                                             &pInternalError);
+        std::vector<Mesh> assetMeshes = createMeshesFromModelIOObject(object,
+                                                                      modelIOVertexDescriptor,
+                                                                      textureLoader,
+                                                                      allocator,
+                                                                      &pInternalError);
         
-        newMeshes.insert(newMeshes.end(), assetMeshes.begin(), assetMeshes.end());
+        newMeshes.insert(newMeshes.end(),
+                         std::make_move_iterator(assetMeshes.begin()),
+                         std::make_move_iterator(assetMeshes.end()));
     }
 
     AAPL_ASSERT_NULL_ERROR( pInternalError, "Error loading model:" );
@@ -559,53 +713,35 @@ std::vector<Mesh> newMeshesFromBundlePath(const char* bundlePath,
     return newMeshes;
 }
 
-static size_t alignSize(size_t inSize, size_t alignment)
-{
-    // Asset if align is not a power of 2
-    assert(((alignment-1) & alignment) == 0);
-
-    const NSUInteger alignmentMask = alignment - 1;
-
-    return ((inSize + alignmentMask) & (~alignmentMask));
-}
-
 std::vector<MeshBuffer>
-MeshBuffer::makeVertexBuffers(MTL::Device* pDevice,
+MeshBuffer::makeVertexBuffers(MeshBufferAllocator& allocator,
                               const MTL::VertexDescriptor* pDescriptor,
                               NS::UInteger vertexCount,
-                              NS::UInteger indexBufferSize)
+                              NS::UInteger indexBufferSize,
+                              MeshBuffer& indexBuffer)
 {
-    std::set<NS::UInteger> bufferIndicessUsed;
+    // There are 31 buffer indices, so a mask of the ones the attributes use fits in 32 bits.
+    uint32_t bufferIndicesUsed = 0;
 
     for(int i = 0; i < 31; i++)
     {
-        bufferIndicessUsed.insert(pDescriptor->attributes()->object(i)->bufferIndex());
+        bufferIndicesUsed |= 1u << pDescriptor->attributes()->object(i)->bufferIndex();
     }
 
-    std::vector<MeshBuffer> vertexBuffers;
+    indexBuffer = allocator.allocate(indexBufferSize);
 
-    indexBufferSize = alignSize(indexBufferSize, 256);
+    std::vector<MeshBuffer> vertexBuffers;
+    vertexBuffers.reserve(__builtin_popcount(bufferIndicesUsed));
 
-    NS::UInteger bufferLength = indexBufferSize;
-    for(auto bufferIndex : bufferIndicessUsed)
+    for(NS::UInteger bufferIndex = 0; bufferIndex < 31; bufferIndex++)
     {
-        NS::UInteger offset = bufferLength;
-        NS::UInteger sectionLength = alignSize(vertexCount * pDescriptor->layouts()->object(bufferIndex)->stride(), 256);
-
-        bufferLength += sectionLength;
-
-        vertexBuffers.emplace_back( MeshBuffer(nullptr, offset, sectionLength, bufferIndex) );
-    }
-
-    MTL::Buffer* pMetalBuffer = pDevice->newBuffer(bufferLength, MTL::ResourceStorageModeShared);
+        if(bufferIndicesUsed & (1u << bufferIndex))
+        {
+            NS::UInteger length = vertexCount * pDescriptor->layouts()->object(bufferIndex)->stride();
 
-    for(auto&& vertexBuffer : vertexBuffers)
-    {
-        // safe to assume vertexBuffer.m_pBuffer is nullptr, no need to release it here
-        vertexBuffer.m_pBuffer = pMetalBuffer->retain();
+            vertexBuffers.emplace_back( allocator.allocate(length, bufferIndex) );
+        }
     }
-    
-    pMetalBuffer->release();
 
     return vertexBuffers;
 }
@@ -668,7 +804,41 @@ static void packVertexData(void *output, MTL::VertexFormat format, vector_float4
     }
 }
 
-Mesh makeSphereMesh(MTL::Device* pDevice,
+// Reorders a generated mesh's triangles for the vertex cache and overdraw, and the vertices of
+// each of its vertex buffers in the order that the triangles first use them.
+static void optimizeGeneratedMesh(uint16_t* indices,
+                                  NS::UInteger indexCount,
+                                  const vector_float4* positions,
+                                  NS::UInteger vertexCount,
+                                  const MTL::VertexDescriptor& vertexDescriptor,
+                                  const std::vector<MeshBuffer>& vertexBuffers,
+                                  LinearArena& scratch)
+{
+    LinearArena::Scope scope(scratch);
+
+    AAPLMeshOptimizeVertexCache(indices, indices, indexCount, vertexCount);
+    AAPLMeshOptimizeOverdraw(indices, indices, indexCount,
+                             (const float*)positions, vertexCount, sizeof(vector_float4),
+                             AAPLMeshDefaultOverdrawThreshold);
+
+    uint32_t* remap = scratch.allocateArray<uint32_t>(vertexCount);
+    AAPLMeshOptimizeVertexFetchRemap(remap, indices, indexCount, vertexCount);
+    AAPLMeshRemapIndices(indices, indices, indexCount, remap);
+
+    for(auto&& vertexBuffer : vertexBuffers)
+    {
+        const NS::UInteger stride = vertexDescriptor.layouts()->object(vertexBuffer.argumentIndex())->stride();
+        uint8_t* vertexData = vertexBuffer.contents();
+
+        LinearArena::Scope vertexScope(scratch);
+        uint8_t* vertices = scratch.allocateArray<uint8_t>(vertexCount * stride);
+
+        memcpy(vertices, vertexData, vertexCount * stride);
+        AAPLMeshRemapVertices(vertexData, vertices, vertexCount, stride, remap);
+    }
+}
+
+Mesh makeSphereMesh(MeshBufferAllocator& allocator,
                     const MTL::VertexDescriptor& vertexDescriptor,
                     int radialSegments, int verticalSegments, float radius)
 {
@@ -679,25 +849,20 @@ Mesh makeSphereMesh(MTL::Device* pDevice,
 
     assert(vertexCount < UINT16_MAX);
 
-    std::vector<MeshBuffer> vertexBuffers;
-
-    vertexBuffers = MeshBuffer::makeVertexBuffers(pDevice,
-                                                  &vertexDescriptor,
-                                                  vertexCount,
-                                                  indexBufferSize);
+    // Create the index and vertex buffers in the allocator's Metal buffers, which other meshes
+    // share.
+    MeshBuffer indexBuffer;
 
-    MTL::Buffer* pMetalBuffer = vertexBuffers[0].buffer();
-
-    // Create index buffer from the Metal buffer shared with the vertices and reserve space at the
-    // beginning for indices.
-    MeshBuffer indexBuffer(pMetalBuffer, 0, indexBufferSize);
+    std::vector<MeshBuffer> vertexBuffers = MeshBuffer::makeVertexBuffers(allocator,
+                                                                          &vertexDescriptor,
+                                                                          vertexCount,
+                                                                          indexBufferSize,
+                                                                          indexBuffer);
 
-    uint8_t *bufferContents =  (uint8_t *)pMetalBuffer->contents();
+    ushort *indices = (ushort *)indexBuffer.contents();
 
     // Fill IndexBuffer
     {
-        ushort *indices = (ushort *)bufferContents;
-
         NS::UInteger currentIndex = 0;
 
         // Indices for top of sphere
@@ -771,29 +936,31 @@ Mesh makeSphereMesh(MTL::Device* pDevice,
         }
     }
 
-    // Fill positions and normals
+    // Fill positions and normals, keeping the positions for the optimizer in scratch memory
+    LinearArena::Scope scope(allocator.scratch());
+    vector_float4 *positions = allocator.scratch().allocateArray<vector_float4>(vertexCount);
+    NS::UInteger positionCount = 0;
     {
         MTL::VertexFormat positionFormat      = vertexDescriptor.attributes()->object(VertexAttributePosition)->format();
         NS::UInteger positionBufferIndex  = vertexDescriptor.attributes()->object(VertexAttributePosition)->bufferIndex();
         NS::UInteger positionVertexOffset = vertexDescriptor.attributes()->object(VertexAttributePosition)->offset();
-        NS::UInteger positionBufferOffset = vertexBuffers[positionBufferIndex].offset();
         NS::UInteger positionStride       = vertexDescriptor.layouts()->object(positionBufferIndex)->stride();
 
         MTL::VertexFormat normalFormat       = vertexDescriptor.attributes()->object(VertexAttributeNormal)->format();
         NS::UInteger normalBufferIndex  = vertexDescriptor.attributes()->object(VertexAttributeNormal)->bufferIndex();
         NS::UInteger normalVertexOffset = vertexDescriptor.attributes()->object(VertexAttributeNormal)->offset();
-        NS::UInteger normalBufferOffset = vertexBuffers[normalBufferIndex].offset();
         NS::UInteger normalStride       = vertexDescriptor.layouts()->object(normalBufferIndex)->stride();
 
         const double radialDelta   = 2 * (M_PI / radialSegments);
         const double verticalDelta = (M_PI / verticalSegments);
 
-        uint8_t *positionData = bufferContents + positionBufferOffset + positionVertexOffset;
-        uint8_t *normalData   = bufferContents + normalBufferOffset + normalVertexOffset;
+        uint8_t *positionData = vertexBuffers[positionBufferIndex].contents() + positionVertexOffset;
+        uint8_t *normalData   = vertexBuffers[normalBufferIndex].contents() + normalVertexOffset;
 
         vector_float4 vertexPosition = {0, radius, 0, 1};
         vector_float4 vertexNormal = {0, 1, 0, 1};;
 
+        positions[positionCount++] = vertexPosition;
         packVertexData(positionData, positionFormat, vertexPosition);
         packVertexData(normalData, normalFormat, vertexNormal);
 
@@ -820,6 +987,7 @@ Mesh makeSphereMesh(MTL::Device* pDevice,
                 vertexPosition = radius * unscaledPosition;
                 vertexNormal   = unscaledPosition;
 
+                positions[positionCount++] = vertexPosition;
                 packVertexData(positionData, positionFormat, vertexPosition);
                 packVertexData(normalData, normalFormat, vertexNormal);
 
@@ -832,11 +1000,17 @@ Mesh makeSphereMesh(MTL::Device* pDevice,
         vertexPosition = {0, -radius, 0, 1};
         vertexNormal = {0, -1, 0, 1};;
 
+        positions[positionCount++] = vertexPosition;
         packVertexData(positionData, positionFormat, vertexPosition);
         packVertexData(normalData, normalFormat, vertexNormal);
 
     }
 
+    assert(positionCount == vertexCount);
+
+    optimizeGeneratedMesh(indices, indexCount, positions, vertexCount,
+                          vertexDescriptor, vertexBuffers, allocator.scratch());
+
     Submesh submesh(MTL::PrimitiveTypeTriangle,
                     MTL::IndexTypeUInt16,
                     indexCount,
@@ -846,7 +1020,7 @@ Mesh makeSphereMesh(MTL::Device* pDevice,
 }
 
 
-Mesh makeIcosahedronMesh(MTL::Device* pDevice,
+Mesh makeIcosahedronMesh(MeshBufferAllocator& allocator,
                          const MTL::VertexDescriptor& vertexDescriptor,
                          float radius)
 {
@@ -897,28 +1071,24 @@ Mesh makeIcosahedronMesh(MTL::Device* pDevice,
     NS::UInteger indexCount = sizeof(indices) / sizeof(uint16_t);
     NS::UInteger indexBufferSize = sizeof(indices);
 
-    std::vector<MeshBuffer> vertexBuffers = MeshBuffer::makeVertexBuffers(pDevice,
+    MeshBuffer indexBuffer;
+
+    std::vector<MeshBuffer> vertexBuffers = MeshBuffer::makeVertexBuffers(allocator,
                                                                           &vertexDescriptor,
                                                                           vertexCount,
-                                                                          indexBufferSize);
-
-    MTL::Buffer* pBuffer = vertexBuffers[0].buffer();
+                                                                          indexBufferSize,
+                                                                          indexBuffer);
 
-    MeshBuffer indexBuffer(pBuffer, 0, indexBufferSize);
-
-    uint8_t * bufferContents = (uint8_t*)pBuffer->contents();
-
-    memcpy(bufferContents, indices, indexBufferSize);
+    memcpy(indexBuffer.contents(), indices, indexBufferSize);
 
     {
         MTL::VertexFormat positionFormat      = vertexDescriptor.attributes()->object(VertexAttributePosition)->format();
         NS::UInteger positionBufferIndex  = vertexDescriptor.attributes()->object(VertexAttributePosition)->bufferIndex();
         NS::UInteger positionVertexOffset = vertexDescriptor.attributes()->object(VertexAttributePosition)->offset();
-        NS::UInteger positionBufferOffset = vertexBuffers[positionBufferIndex].offset();
         NS::UInteger positionStride       = vertexDescriptor.layouts()->object(positionBufferIndex)->stride();
 
 
-        uint8_t *positionData = bufferContents + positionBufferOffset + positionVertexOffset;
+        uint8_t *positionData = vertexBuffers[positionBufferIndex].contents() + positionVertexOffset;
 
         for(uint16_t vertexIndex = 0; vertexIndex < vertexCount; vertexIndex++)
         {
@@ -927,6 +1097,9 @@ Mesh makeIcosahedronMesh(MTL::Device* pDevice,
         }
     }
 
+    optimizeGeneratedMesh((uint16_t *)indexBuffer.contents(), indexCount, positions, vertexCount,
+                          vertexDescriptor, vertexBuffers, allocator.scratch());
+
     Submesh submesh(MTL::PrimitiveTypeTriangle,
                     MTL::IndexTypeUInt16,
                     indexCount,
@@ -0,0 +1,202 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the pass graph, which records a frame's passes on the job pool and submits them in
+ an order that respects their dependencies.
+*/
+
+#ifndef AAPLPassGraph_h
+#define AAPLPassGraph_h
+
+#include "AAPLJobPool.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// The passes of a frame, which passes each one depends on, and how to record them.
+///
+/// Recording doesn't depend on other passes, so every pass records at the same time, each on its
+/// own job and into its own command list.  Only the order in which the GPU sees the command lists
+/// depends on the graph: each pass comes after the passes it depends on, and passes that don't
+/// depend on each other keep the order in which they were added.
+///
+/// `CommandList` is whatever a pass records into, such as a Metal render command encoder, so
+/// that the graph and the job pool don't depend on Metal.
+template <typename CommandList>
+class PassGraph
+{
+public:
+
+    typedef std::function<void(CommandList& commandList)> RecordFunction;
+
+    /// The `JobScope` of `execute` when jobs need nothing around their pass.
+    struct NoJobScope { NoJobScope() {} };
+
+    /// Adds a pass that `record` records, and returns its index.
+    uint32_t addPass( const char* name, RecordFunction record );
+
+    /// Makes pass `pass` come after pass `dependency`.
+    void addDependency( uint32_t pass, uint32_t dependency );
+
+    uint32_t passCount() const;
+
+    const char* passName( uint32_t pass ) const;
+
+    /// Orders the passes for submission.  Returns false and describes the passes that depend on
+    /// each other in a cycle in `error` when there's no such order.
+    bool compile( std::string& error );
+
+    /// The passes in the order that `execute` opens and submits them, once compiled.
+    const std::vector<uint32_t>& submissionOrder() const;
+
+    /// Records every pass of the compiled graph and returns when they're all submitted:
+    ///  - `open(pass)` runs on the calling thread in submission order and returns the command
+    ///    list for the pass, so that command lists that must be created in order are;
+    ///  - the pass's record function, then `close(pass, commandList)`, run on a job;
+    ///  - `submit(pass, commandList)` runs on the calling thread in submission order once the
+    ///    pass has closed.
+    /// Passes start recording as soon as they're open, while later passes open.
+    ///
+    /// Each job constructs a `JobScope` before the pass records and destroys it once the pass has
+    /// closed, such as one that drains the objects Metal autoreleases on the job's thread.
+    template <typename JobScope = NoJobScope, typename Open, typename Close, typename Submit>
+    void execute( JobPool& jobPool, Open open, Close close, Submit submit ) const;
+
+private:
+
+    struct Pass
+    {
+        const char* name;
+        RecordFunction record;
+        std::vector<uint32_t> dependencies;
+    };
+
+    std::vector<Pass> m_passes;
+
+    std::vector<uint32_t> m_order;
+};
+
+template <typename CommandList>
+uint32_t PassGraph<CommandList>::addPass( const char* name, RecordFunction record )
+{
+    m_passes.push_back( Pass{ name, std::move( record ), {} } );
+    m_order.clear();
+    return (uint32_t)m_passes.size() - 1;
+}
+
+template <typename CommandList>
+void PassGraph<CommandList>::addDependency( uint32_t pass, uint32_t dependency )
+{
+    assert( pass < m_passes.size() && dependency < m_passes.size() );
+    m_passes[pass].dependencies.push_back( dependency );
+    m_order.clear();
+}
+
+template <typename CommandList>
+inline uint32_t PassGraph<CommandList>::passCount() const
+{
+    return (uint32_t)m_passes.size();
+}
+
+template <typename CommandList>
+inline const char* PassGraph<CommandList>::passName( uint32_t pass ) const
+{
+    return m_passes[pass].name;
+}
+
+template <typename CommandList>
+inline const std::vector<uint32_t>& PassGraph<CommandList>::submissionOrder() const
+{
+    return m_order;
+}
+
+template <typename CommandList>
+bool PassGraph<CommandList>::compile( std::string& error )
+{
+    // Repeatedly take the first pass, in the order they were added, whose dependencies have all
+    // been taken.  Graphs have a handful of passes, so the quadratic search doesn't matter.
+    const size_t count = m_passes.size();
+    std::vector<uint32_t> waitingFor( count );
+    std::vector<std::vector<uint32_t>> dependents( count );
+    for( uint32_t pass = 0; pass < count; pass++ )
+    {
+        waitingFor[pass] = (uint32_t)m_passes[pass].dependencies.size();
+        for( uint32_t dependency : m_passes[pass].dependencies )
+        {
+            dependents[dependency].push_back( pass );
+        }
+    }
+
+    std::vector<bool> ordered( count, false );
+    m_order.clear();
+    while( m_order.size() < count )
+    {
+        uint32_t next = 0;
+        while( next < count && ( ordered[next] || waitingFor[next] ) )
+        {
+            next++;
+        }
+
+        if( next == count )
+        {
+            error = "Passes depend on each other in a cycle:";
+            for( uint32_t pass = 0; pass < count; pass++ )
+            {
+                if( !ordered[pass] )
+                {
+                    error += std::string( " " ) + m_passes[pass].name;
+                }
+            }
+            m_order.clear();
+            return false;
+        }
+
+        ordered[next] = true;
+        m_order.push_back( next );
+        for( uint32_t dependent : dependents[next] )
+        {
+            waitingFor[dependent]--;
+        }
+    }
+    return true;
+}
+
+template <typename CommandList>
+template <typename JobScope, typename Open, typename Close, typename Submit>
+void PassGraph<CommandList>::execute( JobPool& jobPool, Open open, Close close, Submit submit ) const
+{
+    assert( m_order.size() == m_passes.size() && "Compile the pass graph before executing it" );
+
+    const size_t count = m_order.size();
+    std::vector<CommandList*> commandLists( count );
+    std::unique_ptr<JobGroup[]> recorded( new JobGroup[count] );
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        const uint32_t pass = m_order[i];
+        CommandList* pCommandList = open( pass );
+        commandLists[i] = pCommandList;
+
+        const Pass* pPass = &m_passes[pass];
+        jobPool.run( recorded[i], [pPass, pass, pCommandList, &close]
+        {
+            JobScope scope;
+            pPass->record( *pCommandList );
+            close( pass, *pCommandList );
+        });
+    }
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        jobPool.wait( recorded[i] );
+        submit( m_order[i], *commandLists[i] );
+    }
+}
+
+#endif // AAPLPassGraph_h
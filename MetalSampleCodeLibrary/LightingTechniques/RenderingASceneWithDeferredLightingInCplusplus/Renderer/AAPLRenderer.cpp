@@ -44,9 +44,11 @@ static const uint32_t TreeLights   = 0            + 0.30 * NumLights;
 static const uint32_t GroundLights = TreeLights   + 0.40 * NumLights;
 static const uint32_t ColumnLights = GroundLights + 0.30 * NumLights;
 
+// Number of lights that one job of the light animation moves
+static const uint32_t LightsPerJob = 4096;
+
 Renderer::Renderer( MTL::Device* pDevice )
 : m_pDevice( pDevice->retain() )
-, m_originalLightPositions(nullptr)
 , m_frameDataBufferIndex(0)
 , m_frameNumber(0)
 #if SUPPORT_BUFFER_EXAMINATION
@@ -93,8 +95,6 @@ Renderer::~Renderer()
     
     m_pCommandQueue->release();
     m_pDevice->release();
-    
-    delete [] m_originalLightPositions;
 }
 
 /// Create Metal render state objects
@@ -565,7 +565,11 @@ void Renderer::loadScene()
     // Create and load assets into Metal objects including meshes and textures
     NS::Error* pError = nullptr;
 
-    m_meshes = newMeshesFromBundlePath("Meshes/Temple.obj", m_pDevice, *m_pDefaultVertexDescriptor, &pError);
+    // Pack the generated meshes' vertices and indices into a few shared Metal buffers, and build
+    // them in scratch memory that this load reuses and frees when it's done.
+    MeshBufferAllocator meshAllocator( m_pDevice );
+
+    m_meshes = newMeshesFromBundlePath("Meshes/Temple.obj", meshAllocator, *m_pDefaultVertexDescriptor, &pError);
 
     AAPL_ASSERT_NULL_ERROR( pError, "Could not create meshes from model file" );
 
@@ -625,14 +629,14 @@ void Renderer::loadScene()
         // Calculate radius such that minimum radius of icosahedronDescriptor is 1
         const float icoshedronRadius = 1.0 / (sqrtf(3.0) / 12.0 * (3.0 + sqrtf(5.0)));
 
-        m_icosahedronMesh = makeIcosahedronMesh(m_pDevice, *pIcosahedronDescriptor, icoshedronRadius);
+        m_icosahedronMesh = makeIcosahedronMesh(meshAllocator, *pIcosahedronDescriptor, icoshedronRadius);
         
         pIcosahedronDescriptor->release();
     }
 
     // Create a sphere for the skybox
     {
-        m_skyMesh = makeSphereMesh(m_pDevice, *m_pSkyVertexDescriptor, 20, 20, 150.0 );
+        m_skyMesh = makeSphereMesh(meshAllocator, *m_pSkyVertexDescriptor, 20, 20, 150.0 );
     }
 
     // Load textures for nonmesh assets.
@@ -647,9 +651,7 @@ void Renderer::populateLights()
 {
     PointLight *light_data = (PointLight*)m_pLightsData->contents();
 
-    m_originalLightPositions = new float4[ NumLights ];
-
-    float4 *light_position = m_originalLightPositions;
+    m_lightAnimation.resize( NumLights, TreeLights );
 
     srandom(0x134e5348);
 
@@ -685,7 +687,7 @@ void Renderer::populateLights()
         }
 
         speed *= .5;
-        *light_position = (float4){ distance*sinf(angle),height,distance*cosf(angle),1};
+        m_lightAnimation.setLight( lightId, distance*sinf(angle), height, distance*cosf(angle), speed );
         light_data->light_radius = random_float(25,35)/10.0;
         light_data->light_speed  = speed;
 
@@ -699,48 +701,24 @@ void Renderer::populateLights()
         }
 
         light_data++;
-        light_position++;
     }
 }
 
 /// Update light positions
 void Renderer::updateLights(const float4x4 & modelViewMatrix)
 {
-    PointLight *lightData = (PointLight*)m_pLightsData->contents();
+    // Write each light's position straight into this frame's buffer, splitting the lights
+    // into jobs once there are more than one job's worth.
+    float *currentBuffer = (float*) m_lightPositions[m_frameDataBufferIndex]->contents();
 
-    float4 *currentBuffer =
-        (float4*) m_lightPositions[m_frameDataBufferIndex]->contents();
+    const LightAnimation& lightAnimation = m_lightAnimation;
+    const uint64_t frameNumber = m_frameNumber;
+    const float *modelView = (const float*) &modelViewMatrix;
 
-    float4 *originalLightPositions =  (float4 *)m_originalLightPositions;
-
-    for(int i = 0; i < NumLights; i++)
+    m_jobPool.parallelFor( NumLights, LightsPerJob, [&](size_t begin, size_t end)
     {
-        float4 currentPosition;
-
-        if(i < TreeLights)
-        {
-            double lightPeriod = lightData[i].light_speed  * m_frameNumber;
-            lightPeriod += originalLightPositions[i].y;
-            lightPeriod -= floor(lightPeriod);  // Get fractional part
-
-            // Use pow to slowly move the light outward as it reaches the branches of the tree
-            float r = 1.2 + 10.0 * powf(lightPeriod, 5.0);
-
-            currentPosition.x = originalLightPositions[i].x * r;
-            currentPosition.y = 200.0f + lightPeriod * 400.0f;
-            currentPosition.z = originalLightPositions[i].z * r;
-            currentPosition.w = 1;
-        }
-        else
-        {
-            float rotationRadians = lightData[i].light_speed * m_frameNumber;
-            float4x4 rotation = matrix4x4_rotation(rotationRadians, 0, 1, 0);
-            currentPosition = rotation * originalLightPositions[i];
-        }
-
-        currentPosition = modelViewMatrix * currentPosition;
-        currentBuffer[i] = currentPosition;
-    }
+        lightAnimation.animate( currentBuffer, frameNumber, modelView, begin, end );
+    });
 }
 
 /// Update application state for the current frame
@@ -970,6 +948,15 @@ MTL::CommandBuffer* Renderer::beginDrawableCommands()
     return pCommandBuffer;
 }
 
+/// Get another command buffer for the current frame, so that passes in different command buffers
+/// can record at the same time.  The completed handler of the frame's drawable command buffer
+/// still signals the end of the frame, since Metal runs command buffers in the order they're
+/// committed or enqueued.
+MTL::CommandBuffer* Renderer::beginPassCommands()
+{
+    return m_pCommandQueue->commandBuffer();
+}
+
 /// Perform cleanup operations including presenting the drawable and committing the command buffer
 /// for the current frame.  Also, when enabled, draw buffer examination elements before all this.
 void Renderer::endFrame(MTL::CommandBuffer* pCommandBuffer, MTL::Drawable* pCurrentDrawable)
@@ -998,13 +985,47 @@ void Renderer::endFrame(MTL::CommandBuffer* pCommandBuffer, MTL::Drawable* pCurr
     pCommandBuffer->commit();
 }
 
-/// Draw to the depth texture from the directional lights point of view to generate the shadow map
-void Renderer::drawShadow(MTL::CommandBuffer* pCommandBuffer)
+/// Record the passes of `graph` into a render pass, each into its own subencoder of a parallel
+/// render command encoder and on its own job.  The parallel encoder runs its subencoders in the
+/// order they're created rather than the order they finish, and the graph creates them in its
+/// submission order, so the passes draw in an order that respects their dependencies.  Each job
+/// records inside an autorelease pool of its own.
+void Renderer::recordRenderPass( MTL::CommandBuffer* pCommandBuffer,
+                                 const MTL::RenderPassDescriptor* pRenderPassDescriptor,
+                                 const NS::String* pLabel,
+                                 const RenderPassGraph& graph )
+{
+    MTL::ParallelRenderCommandEncoder* pParallelEncoder = pCommandBuffer->parallelRenderCommandEncoder( pRenderPassDescriptor );
+    pParallelEncoder->setLabel( pLabel );
+
+    graph.execute<JobAutoreleasePool>( m_jobPool,
+                                       [pParallelEncoder]( uint32_t )
+                                       {
+                                           return pParallelEncoder->renderCommandEncoder();
+                                       },
+                                       []( uint32_t, MTL::RenderCommandEncoder& renderEncoder )
+                                       {
+                                           renderEncoder.endEncoding();
+                                       },
+                                       // Ending the parallel encoder submits every subencoder at once
+                                       []( uint32_t, MTL::RenderCommandEncoder& ) {} );
+
+    pParallelEncoder->endEncoding();
+}
+
+/// Begin the render pass that draws the shadow map
+MTL::RenderCommandEncoder* Renderer::beginShadowPass(MTL::CommandBuffer* pCommandBuffer)
 {
     MTL::RenderCommandEncoder* pEncoder = pCommandBuffer->renderCommandEncoder(m_pShadowRenderPassDescriptor);
 
     pEncoder->setLabel( AAPLSTR( "Shadow Map Pass" ) );
 
+    return pEncoder;
+}
+
+/// Draw to the depth texture from the directional lights point of view to generate the shadow map
+void Renderer::drawShadow(MTL::RenderCommandEncoder* pEncoder)
+{
     pEncoder->setRenderPipelineState( m_pShadowGenPipelineState );
     pEncoder->setDepthStencilState( m_pShadowDepthStencilState );
     pEncoder->setCullMode( MTL::CullModeBack );
@@ -1013,8 +1034,6 @@ void Renderer::drawShadow(MTL::CommandBuffer* pCommandBuffer)
     pEncoder->setVertexBuffer( m_frameDataBuffers[m_frameDataBufferIndex], 0, BufferIndexFrameData );
 
     drawMeshes( pEncoder );
-
-    pEncoder->endEncoding();
 }
 
 /// Draw to the three textures which compose the GBuffer
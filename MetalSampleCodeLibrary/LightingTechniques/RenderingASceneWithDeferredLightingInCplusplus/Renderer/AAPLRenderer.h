@@ -9,7 +9,10 @@ Header for renderer class that performs Metal setup and per-frame rendering.
 #include "AAPLConfig.h"
 #include "AAPLBufferExaminationManager.h"
 
+#include "AAPLJobPool.h"
+#include "AAPLLightAnimation.h"
 #include "AAPLMesh.h"
+#include "AAPLPassGraph.h"
 
 #include <Metal/Metal.hpp>
 
@@ -71,6 +74,24 @@ public:
 
 protected:
 
+    // Passes that each record into their own render command encoder
+    typedef PassGraph<MTL::RenderCommandEncoder> RenderPassGraph;
+
+    // Drains the objects that Metal autoreleases while a job records.  The job pool's workers run
+    // outside of any autorelease pool, so every job that calls Metal constructs one of these first.
+    class JobAutoreleasePool
+    {
+    public:
+        JobAutoreleasePool();
+        ~JobAutoreleasePool();
+
+    private:
+        JobAutoreleasePool( const JobAutoreleasePool& ) = delete;
+        JobAutoreleasePool& operator=( const JobAutoreleasePool& ) = delete;
+
+        NS::AutoreleasePool* m_pPool;
+    };
+
     virtual void loadMetal();
 
     void loadScene();
@@ -79,9 +100,20 @@ protected:
 
     MTL::CommandBuffer* beginDrawableCommands();
 
+    MTL::CommandBuffer* beginPassCommands();
+
     void endFrame(MTL::CommandBuffer* pCommandBuffer, MTL::Drawable* pCurrentDrawable);
 
-    void drawShadow( MTL::CommandBuffer* pCommandBuffer );
+    void recordRenderPass( MTL::CommandBuffer* pCommandBuffer,
+                           const MTL::RenderPassDescriptor* pRenderPassDescriptor,
+                           const NS::String* pLabel,
+                           const RenderPassGraph& graph );
+
+    JobPool& jobPool();
+
+    MTL::RenderCommandEncoder* beginShadowPass( MTL::CommandBuffer* pCommandBuffer );
+
+    void drawShadow( MTL::RenderCommandEncoder* pRenderEncoder );
 
     void drawGBuffer( MTL::RenderCommandEncoder* pRenderEncoder );
 
@@ -204,8 +236,12 @@ private:
     // Vertex descriptor for models loaded with MetalKit
     MTL::VertexDescriptor* m_pSkyVertexDescriptor;
 
-    // Light positions before transformation to positions in current frame
-    simd::float4 *m_originalLightPositions;
+    // Light positions and speeds before transformation to positions in current frame
+    LightAnimation m_lightAnimation;
+
+    // Worker threads for per-frame loops and for recording passes
+    JobPool m_jobPool;
+
     // Mesh for an icosahedron used for rendering point lights
     Mesh m_icosahedronMesh;
 
@@ -222,6 +258,16 @@ protected:
 };
 
 
+inline Renderer::JobAutoreleasePool::JobAutoreleasePool()
+: m_pPool( NS::AutoreleasePool::alloc()->init() )
+{
+}
+
+inline Renderer::JobAutoreleasePool::~JobAutoreleasePool()
+{
+    m_pPool->release();
+}
+
 inline MTL::Device* Renderer::device() const
 {
     return m_pDevice;
@@ -247,6 +293,11 @@ inline const MTL::Buffer* Renderer::quadVertexBuffer() const
     return m_pQuadVertexBuffer;
 }
 
+inline JobPool& Renderer::jobPool()
+{
+    return m_jobPool;
+}
+
 inline int8_t Renderer::frameDataBufferIndex() const
 {
     return m_frameDataBufferIndex;
@@ -14,6 +14,8 @@ Implementation of the renderer class which performs Metal setup and per frame re
 
 #include "AAPLUtilities.h"
 
+#include <string>
+
 Renderer_SinglePassDeferred::Renderer_SinglePassDeferred( MTL::Device* pDevice )
 : Renderer( pDevice )
 {
@@ -23,6 +25,7 @@ Renderer_SinglePassDeferred::Renderer_SinglePassDeferred( MTL::Device* pDevice )
 
     loadMetalInternal();
     loadScene();
+    buildPassGraph();
 }
 
 Renderer_SinglePassDeferred::~Renderer_SinglePassDeferred()
@@ -105,42 +108,93 @@ void Renderer_SinglePassDeferred::drawableSizeWillChange(const MTL::Size& size,
 }
 
 /// Frame drawing routine
-void Renderer_SinglePassDeferred::drawInView( bool isPaused, MTL::Drawable* pCurrentDrawable, MTL::Texture* pDepthStencilTexture )
+/// Describe the passes of the render pass to the drawable so that they can record on several
+/// threads at once
+void Renderer_SinglePassDeferred::buildPassGraph()
 {
-    MTL::CommandBuffer* pCommandBuffer = beginFrame( isPaused );
-    pCommandBuffer->setLabel( AAPLSTR( "Shadow commands" ) );
+    m_viewPasses.addPass( "GBuffer", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        Renderer::drawGBuffer( &renderEncoder );
+    });
 
-    drawShadow( pCommandBuffer );
-    pCommandBuffer->commit();
+    m_viewPasses.addPass( "Directional Light", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        drawDirectionalLight( &renderEncoder );
+    });
 
-    pCommandBuffer = beginDrawableCommands();
-    pCommandBuffer->setLabel( AAPLSTR( "GBuffer & Lighting Commands" ) );
+    m_viewPasses.addPass( "Point Light Mask", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        Renderer::drawPointLightMask( &renderEncoder );
+    });
 
-    MTL::Texture* pDrawableTexture = currentDrawableTexture( pCurrentDrawable );
-    if ( pDrawableTexture )
+    m_viewPasses.addPass( "Point Lights", [this]( MTL::RenderCommandEncoder& renderEncoder )
     {
-        m_pViewRenderPassDescriptor->colorAttachments()->object(RenderTargetLighting)->setTexture( pDrawableTexture );
-        m_pViewRenderPassDescriptor->depthAttachment()->setTexture( pDepthStencilTexture );
-        m_pViewRenderPassDescriptor->stencilAttachment()->setTexture( pDepthStencilTexture );
+        drawPointLights( &renderEncoder );
+    });
 
-        MTL::RenderCommandEncoder* pRenderEncoder = pCommandBuffer->renderCommandEncoder(m_pViewRenderPassDescriptor);
-        pRenderEncoder->setLabel( AAPLSTR( "Combined GBuffer & Lighting Pass" ) );
+    m_viewPasses.addPass( "Sky", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        Renderer::drawSky( &renderEncoder );
+    });
 
-        Renderer::drawGBuffer( pRenderEncoder );
+    m_viewPasses.addPass( "Fairies", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        Renderer::drawFairies( &renderEncoder );
+    });
 
-        drawDirectionalLight( pRenderEncoder );
+    // Each pass reads the GBuffer from tile memory, tests against the stencil, or blends onto
+    // the colors that the passes before it leave, so each depends on the one drawn before it on
+    // one thread.
+    for( uint32_t pass = 1; pass < m_viewPasses.passCount(); pass++ )
+    {
+        m_viewPasses.addDependency( pass, pass - 1 );
+    }
 
-        Renderer::drawPointLightMask( pRenderEncoder );
+    std::string error;
+    AAPL_ASSERT( m_viewPasses.compile( error ), error );
+}
 
-        drawPointLights( pRenderEncoder );
+void Renderer_SinglePassDeferred::drawInView( bool isPaused, MTL::Drawable* pCurrentDrawable, MTL::Texture* pDepthStencilTexture )
+{
+    MTL::CommandBuffer* pShadowCommandBuffer = beginFrame( isPaused );
+    pShadowCommandBuffer->setLabel( AAPLSTR( "Shadow commands" ) );
 
-        Renderer::drawSky( pRenderEncoder );
+    // Reserve the shadow commands' place in the queue, ahead of the commands that sample the
+    // shadow map, so that a job can record and commit them while this thread waits for the
+    // drawable and records the rest of the frame.
+    pShadowCommandBuffer->enqueue();
 
-        Renderer::drawFairies( pRenderEncoder );
+    JobGroup shadowJob;
+    jobPool().run( shadowJob, [this, pShadowCommandBuffer]
+    {
+        JobAutoreleasePool autoreleasePool;
 
+        MTL::RenderCommandEncoder* pRenderEncoder = beginShadowPass( pShadowCommandBuffer );
+        drawShadow( pRenderEncoder );
         pRenderEncoder->endEncoding();
+
+        pShadowCommandBuffer->commit();
+    });
+
+    MTL::CommandBuffer* pCommandBuffer = beginDrawableCommands();
+    pCommandBuffer->setLabel( AAPLSTR( "GBuffer & Lighting Commands" ) );
+
+    MTL::Texture* pDrawableTexture = currentDrawableTexture( pCurrentDrawable );
+    if ( pDrawableTexture )
+    {
+        m_pViewRenderPassDescriptor->colorAttachments()->object(RenderTargetLighting)->setTexture( pDrawableTexture );
+        m_pViewRenderPassDescriptor->depthAttachment()->setTexture( pDepthStencilTexture );
+        m_pViewRenderPassDescriptor->stencilAttachment()->setTexture( pDepthStencilTexture );
+
+        recordRenderPass( pCommandBuffer,
+                          m_pViewRenderPassDescriptor,
+                          AAPLSTR( "Combined GBuffer & Lighting Pass" ),
+                          m_viewPasses );
     }
 
+    // The shadow job reads this frame's state, which the next frame changes
+    jobPool().wait( shadowJob );
+
     endFrame( pCommandBuffer, pCurrentDrawable );
 }
 
@@ -33,6 +33,8 @@ private:
 
     void loadMetalInternal();
 
+    void buildPassGraph();
+
     void drawDirectionalLight(MTL::RenderCommandEncoder* pRenderEncoder);
 
     void drawPointLights(MTL::RenderCommandEncoder* pRenderEncoder);
@@ -41,6 +43,9 @@ private:
 
     MTL::RenderPassDescriptor* m_pViewRenderPassDescriptor;
 
+    // The passes that fill the GBuffer, light it and composite the frame in one render pass
+    RenderPassGraph m_viewPasses;
+
     MTL::StorageMode m_GBufferStorageMode;
     
     MTL::Size m_drawableSize;
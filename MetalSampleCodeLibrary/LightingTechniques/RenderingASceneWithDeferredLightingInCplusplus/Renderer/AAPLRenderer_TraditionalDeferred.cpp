@@ -14,12 +14,28 @@ Implementation of the renderer class that performs Metal setup and per-frame ren
 
 #include "AAPLUtilities.h"
 
+#include <string>
+
+namespace
+{
+
+// The passes of the geometry pass graph, in the order it adds them
+enum GeometryPass : uint32_t
+{
+    GeometryPassShadow,
+    GeometryPassGBuffer,
+    GeometryPassCount
+};
+
+} // namespace
+
 Renderer_TraditionalDeferred::Renderer_TraditionalDeferred(MTL::Device* pDevice)
 : Renderer( pDevice )
 {
     m_singlePassDeferred = false;
     loadMetalInternal();
     loadScene();
+    buildPassGraphs();
 }
 
 Renderer_TraditionalDeferred::~Renderer_TraditionalDeferred()
@@ -123,6 +139,61 @@ void Renderer_TraditionalDeferred::drawableSizeWillChange(const MTL::Size& size,
     m_pGBufferRenderPassDescriptor->colorAttachments()->object(RenderTargetDepth)->setTexture( m_depth_GBuffer );
 }
 
+/// Describe the frame's passes so that they can record on several threads at once
+void Renderer_TraditionalDeferred::buildPassGraphs()
+{
+    std::string error;
+
+    m_geometryPasses.addPass( "Shadow Map", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        Renderer::drawShadow( &renderEncoder );
+    });
+
+    m_geometryPasses.addPass( "GBuffer", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        Renderer::drawGBuffer( &renderEncoder );
+    });
+
+    // The GBuffer pass samples the shadow map
+    m_geometryPasses.addDependency( GeometryPassGBuffer, GeometryPassShadow );
+
+    AAPL_ASSERT( m_geometryPasses.compile( error ), error );
+
+    m_lightingPasses.addPass( "Directional Light", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        drawDirectionalLight( &renderEncoder );
+    });
+
+    m_lightingPasses.addPass( "Point Light Mask", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        Renderer::drawPointLightMask( &renderEncoder );
+    });
+
+    m_lightingPasses.addPass( "Point Lights", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        drawPointLights( &renderEncoder );
+    });
+
+    m_lightingPasses.addPass( "Sky", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        Renderer::drawSky( &renderEncoder );
+    });
+
+    m_lightingPasses.addPass( "Fairies", [this]( MTL::RenderCommandEncoder& renderEncoder )
+    {
+        Renderer::drawFairies( &renderEncoder );
+    });
+
+    // Each lighting pass tests against the stencil or blends onto the colors that the passes
+    // before it leave, so each depends on the one drawn before it on one thread.
+    for( uint32_t pass = 1; pass < m_lightingPasses.passCount(); pass++ )
+    {
+        m_lightingPasses.addDependency( pass, pass - 1 );
+    }
+
+    AAPL_ASSERT( m_lightingPasses.compile( error ), error );
+}
+
 /// Draw directional lighting, which, with a tradition deferred renderer needs to set GBuffers as
 /// textures before executing common rendering code to draw the light
 void Renderer_TraditionalDeferred::drawDirectionalLight(MTL::RenderCommandEncoder* pRenderEncoder)
@@ -160,24 +231,41 @@ void Renderer_TraditionalDeferred::drawPointLights(MTL::RenderCommandEncoder* pR
 void Renderer_TraditionalDeferred::drawInView( bool isPaused, MTL::Drawable* pCurrentDrawable, MTL::Texture* pDepthStencilTexture )
 {
     {
-        MTL::CommandBuffer* pCommandBuffer = Renderer::beginFrame( isPaused );
-        pCommandBuffer->setLabel( AAPLSTR( "Shadow & GBuffer Commands" ) );
+        // Record the shadow and GBuffer passes at the same time, each into a command buffer of
+        // its own, which the graph commits in order.
+        MTL::CommandBuffer* pCommandBuffers[GeometryPassCount];
+
+        pCommandBuffers[GeometryPassShadow] = Renderer::beginFrame( isPaused );
+        pCommandBuffers[GeometryPassShadow]->setLabel( AAPLSTR( "Shadow Commands" ) );
 
-        Renderer::drawShadow( pCommandBuffer );
+        pCommandBuffers[GeometryPassGBuffer] = Renderer::beginPassCommands();
+        pCommandBuffers[GeometryPassGBuffer]->setLabel( AAPLSTR( "GBuffer Commands" ) );
 
         m_pGBufferRenderPassDescriptor->depthAttachment()->setTexture( pDepthStencilTexture );
         m_pGBufferRenderPassDescriptor->stencilAttachment()->setTexture( pDepthStencilTexture );
 
-        MTL::RenderCommandEncoder* pRenderEncoder = pCommandBuffer->renderCommandEncoder( m_pGBufferRenderPassDescriptor );
-        pRenderEncoder->setLabel( AAPLSTR( "GBuffer Generation" ) );
-
-        Renderer::drawGBuffer( pRenderEncoder );
-
-        pRenderEncoder->endEncoding();
-
-        // Commit commands so that Metal can begin working on nondrawable dependent work without
-        // waiting for a drawable to become available
-        pCommandBuffer->commit();
+        m_geometryPasses.execute<JobAutoreleasePool>( Renderer::jobPool(),
+                                                      [&]( uint32_t pass )
+                                                      {
+                                                          if( pass == GeometryPassShadow )
+                                                          {
+                                                              return Renderer::beginShadowPass( pCommandBuffers[pass] );
+                                                          }
+
+                                                          MTL::RenderCommandEncoder* pRenderEncoder = pCommandBuffers[pass]->renderCommandEncoder( m_pGBufferRenderPassDescriptor );
+                                                          pRenderEncoder->setLabel( AAPLSTR( "GBuffer Generation" ) );
+                                                          return pRenderEncoder;
+                                                      },
+                                                      []( uint32_t, MTL::RenderCommandEncoder& renderEncoder )
+                                                      {
+                                                          renderEncoder.endEncoding();
+                                                      },
+                                                      // Commit commands so that Metal can begin working on nondrawable
+                                                      // dependent work without waiting for a drawable to become available
+                                                      [&]( uint32_t pass, MTL::RenderCommandEncoder& )
+                                                      {
+                                                          pCommandBuffers[pass]->commit();
+                                                      });
     }
 
     {
@@ -197,20 +285,10 @@ void Renderer_TraditionalDeferred::drawInView( bool isPaused, MTL::Drawable* pCu
             m_pFinalRenderPassDescriptor->depthAttachment()->setTexture( pDepthStencilTexture );
             m_pFinalRenderPassDescriptor->stencilAttachment()->setTexture( pDepthStencilTexture );
 
-            MTL::RenderCommandEncoder* pRenderEncoder = pCommandBuffer->renderCommandEncoder( m_pFinalRenderPassDescriptor );
-            pRenderEncoder->setLabel( AAPLSTR( "Lighting & Composition Pass" ) );
-
-            drawDirectionalLight( pRenderEncoder );
-
-            Renderer::drawPointLightMask( pRenderEncoder );
-
-            drawPointLights( pRenderEncoder );
-
-            Renderer::drawSky( pRenderEncoder );
-
-            Renderer::drawFairies( pRenderEncoder );
-
-            pRenderEncoder->endEncoding();
+            Renderer::recordRenderPass( pCommandBuffer,
+                                        m_pFinalRenderPassDescriptor,
+                                        AAPLSTR( "Lighting & Composition Pass" ),
+                                        m_lightingPasses );
         }
 
         Renderer::endFrame( pCommandBuffer, pCurrentDrawable );
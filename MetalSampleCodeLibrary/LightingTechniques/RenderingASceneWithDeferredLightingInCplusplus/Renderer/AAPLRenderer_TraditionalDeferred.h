@@ -38,8 +38,16 @@ private:
     MTL::RenderPassDescriptor* m_pGBufferRenderPassDescriptor;
     MTL::RenderPassDescriptor* m_pFinalRenderPassDescriptor;
 
+    // The shadow and GBuffer passes, which record into command buffers of their own
+    RenderPassGraph m_geometryPasses;
+
+    // The passes that light the GBuffer and composite the frame, which record into one render pass
+    RenderPassGraph m_lightingPasses;
+
     void loadMetalInternal();
 
+    void buildPassGraphs();
+
     void drawDirectionalLight(MTL::RenderCommandEncoder* renderEncoder);
 
     void drawPointLights(MTL::RenderCommandEncoder* renderEncoder);
@@ -7,6 +7,8 @@ Header for classes which read texture and mesh data from a file.
 
 #import <Metal/Metal.h>
 
+#import "AAPLMeshFile.h"
+
 @class AAPLMeshData;
 
 // Uncompresses a block of data to another block.
@@ -15,6 +17,8 @@ NSData * _Nonnull uncompressData(NSData * _Nonnull data);
 size_t uncompressedDataSize(NSData * _Nonnull data);
 // Uncompresses a block of data to a dynamically allocated buffer.
 void uncompressData(NSData * _Nonnull data, uint8_t * _Nonnull(^ _Nonnull allocatorCallback)(size_t));
+// Uncompresses several blocks of a mesh file in parallel, each to a buffer of its uncompressed size.
+void uncompressData(const AAPLMeshFileBlock * _Nonnull blocks, uint8_t * _Nonnull const * _Nonnull dstBuffers, NSUInteger count);
 
 #if !TARGET_OS_IPHONE
 // Helper to get the properties of block compressed pixel formats used by this sample.
@@ -23,9 +27,9 @@ void getBCProperties(MTLPixelFormat pixelFormat, NSUInteger &blockSize, NSUInteg
 
 void getPixelFormatBlockDesc(MTLPixelFormat pixelFormat, NSUInteger &blockSize, NSUInteger &bytesPerBlock);
 
-// Class to decode texture content from binary data.
+// Class to describe a texture stored in a mesh file.
 FOUNDATION_EXPORT
-@interface AAPLTextureData : NSObject <NSSecureCoding>
+@interface AAPLTextureData : NSObject
 
 // Path to original texture.
 @property (nonatomic, readonly, nonnull) NSString *path;
@@ -44,38 +48,20 @@ FOUNDATION_EXPORT
 @property (nonatomic, readonly, nonnull) NSArray* mipOffsets;
 @property (nonatomic, readonly, nonnull) NSArray* mipLengths;
 
-+ (BOOL)supportsSecureCoding;
-
-// NSCoding protocol initialization.
-- (nonnull instancetype)initWithCoder:(nonnull NSCoder *)coder;
-
-// NSCoding protocol serialization.
-- (void)encodeWithCoder:(nonnull NSCoder *)coder;
+// Initialization from the texture's description in a mesh file.
+- (nonnull instancetype)initWithMeshFileTexture:(const AAPLMeshFileTexture &)texture;
 
 @end
 
-// Class to decode mesh content from binary data.
+// Class to access mesh content in a memory mapped mesh file.
 FOUNDATION_EXPORT
-@interface AAPLMeshData : NSObject <NSSecureCoding>
-
-@property (nonatomic, readonly, nullable) NSData *textureData;
-
-@property (nonatomic, readonly, nullable) NSData *vertexData;
-@property (nonatomic, readonly, nullable) NSData *normalData;
-@property (nonatomic, readonly, nullable) NSData *tangentData;
-@property (nonatomic, readonly, nullable) NSData *uvData;
+@interface AAPLMeshData : NSObject
 
-// Indices for rendering.
-@property (nonatomic, readonly, nullable) NSData *indexData;
+// The mapped file, whose compressed streams uncompress straight into their destination.
+@property (nonatomic, readonly, nonnull) const AAPLMeshFile *file;
 
-// Chunk data in AAPLMeshChunk format.
-@property (nonatomic, readonly, nullable) NSData *chunkData;
-
-// Mesh data in AAPLSubMesh format.
-@property (nonatomic, readonly, nullable) NSData *meshData;
-
-// Material data in AAPLMaterial format.
-@property (nonatomic, readonly, nullable) NSData *materialData;
+// Uncompressed texture data, which maps the file and keeps it mapped while referenced.
+@property (nonatomic, readonly, nonnull) NSData *textureData;
 
 // Type of indices.
 @property (nonatomic, readonly) NSUInteger indexType;
@@ -97,13 +83,7 @@ FOUNDATION_EXPORT
 @property (nonatomic, readonly) NSUInteger transparentMeshCount;
 
 // Texture objects stored by use in separate arrays
-@property (nonatomic, readonly, nullable) NSArray<AAPLTextureData *> *textures;
-
-// NSCoding protocol initialization.
-- (nonnull instancetype)initWithCoder:(nonnull NSCoder *)coder;
-
-// NSCoding protocol serialization.
-- (void)encodeWithCoder:(nonnull NSCoder *)coder;
+@property (nonatomic, readonly, nonnull) NSArray<AAPLTextureData *> *textures;
 
 // High level method to create.
 + (nullable AAPLMeshData *)meshWithFilename:(nonnull NSString *)filename;
@@ -5,17 +5,11 @@ Abstract:
 Implementation of classes which read texture and mesh data from a file.
 */
 #import "AAPLAsset.h"
+#import "AAPLBCCodec.h"
+#import "AAPLMeshFile.h"
 
-#import <compression.h>
-#import <sys/types.h>
-#import <sys/stat.h>
-#import <unistd.h>
-#import <sys/mman.h>
-
-#import <Foundation/NSKeyedArchiver.h>
-
-#define MESH_MAGIC   0x4853454D
-#define MESH_VERSION 16
+#import <memory>
+#import <vector>
 
 #define LOG_UNCOMPRESS_TIME (0)
 
@@ -23,22 +17,6 @@ Implementation of classes which read texture and mesh data from a file.
 #import <mach/mach_time.h>
 #endif
 
-// Header for the file.
-struct AAPLFileHeader
-{
-    uint32_t magic;         // Marker to indicate file type - should be `MESH_MAGIC`.
-    uint32_t version;       // Marker to indicate file version  - should be `MESH_VERSION`.
-    uint32_t dataOffset;    // Offset to mesh data in the file.
-};
-
-// Header for compressed blocks.
-struct AAPLCompressionHeader
-{
-    uint32_t compressionMode;       // Compression mode in block - of type compression_algorithm.
-    uint64_t uncompressedSize;      // Size of uncompressed data.
-    uint64_t compressedSize;        // Size of compressed data.
-};
-
 AAPLCompressionHeader* getCompressionHeader(NSData *data)
 {
     assert(data != nullptr);
@@ -65,7 +43,8 @@ size_t uncompressedDataSize(NSData *data)
     return getCompressionHeader(data)->uncompressedSize;
 }
 
-void uncompressData(const AAPLCompressionHeader& header, const void *data, void *dstBuffer)
+// Uncompresses a set of blocks, spreading chunked blocks across all cores.
+static void uncompressData(const AAPLDecompressRequest *requests, NSUInteger count)
 {
 #if LOG_UNCOMPRESS_TIME
     double tbConversionFactor = 0;
@@ -79,21 +58,29 @@ void uncompressData(const AAPLCompressionHeader& header, const void *data, void
     uint64_t beginTime = mach_absolute_time();
 #endif // LOG_UNCOMPRESS_TIME
 
-    size_t a = compression_decode_buffer((uint8_t*)dstBuffer, header.uncompressedSize,
-                                         (const uint8_t*)data, header.compressedSize,
-                                         NULL, (compression_algorithm)header.compressionMode);
+    bool success = AAPLDecompressBlocks(requests, count);
 
 #if LOG_UNCOMPRESS_TIME
     uint64_t endTime = mach_absolute_time();
 
     double diff = (endTime - beginTime) * tbConversionFactor;
 
-    printf("uncompress (%llu kb): %.3f ms\n", header.compressedSize/1024, diff);
+    uint64_t compressedSize = 0;
+    uint64_t uncompressedSize = 0;
+    for (NSUInteger i = 0; i < count; ++i)
+    {
+        compressedSize      += requests[i].header.compressedSize;
+        uncompressedSize    += requests[i].header.uncompressedSize;
+    }
+
+    printf("uncompress %lu blocks (%llu kb) on %lu threads: %.3f ms, %.1f MB/s\n",
+           (unsigned long)count, compressedSize/1024, (unsigned long)NSProcessInfo.processInfo.activeProcessorCount,
+           diff, uncompressedSize / (diff * 1e3));
 #endif
 
-    if(a != header.uncompressedSize)
+    if(!success)
     {
-        NSCAssert(a == header.uncompressedSize, @"Error decompressing data");
+        NSCAssert(success, @"Error decompressing data");
     }
 }
 
@@ -103,7 +90,8 @@ NSData *uncompressData(NSData *data)
 
     NSMutableData *decompressedData = [NSMutableData dataWithLength:header->uncompressedSize];
 
-    uncompressData(*header, (header+1), decompressedData.mutableBytes);
+    AAPLDecompressRequest request = { *header, (header+1), decompressedData.mutableBytes };
+    uncompressData(&request, 1);
 
     return decompressedData;
 }
@@ -114,43 +102,39 @@ void uncompressData(NSData *data, uint8_t *(^allocatorCallback)(size_t))
 
     uint8_t *dstBuffer = allocatorCallback(header->uncompressedSize);
 
-    uncompressData(*header, (header+1), dstBuffer);
+    AAPLDecompressRequest request = { *header, (header+1), dstBuffer };
+    uncompressData(&request, 1);
+}
+
+void uncompressData(const AAPLMeshFileBlock *blocks, uint8_t * const *dstBuffers, NSUInteger count)
+{
+    std::vector<AAPLDecompressRequest> requests(count);
+
+    for (NSUInteger i = 0; i < count; ++i)
+    {
+        NSCAssert(blocks[i].valid(), @"Invalid mesh file block");
+        requests[i] = { blocks[i].header, blocks[i].payload.data, dstBuffers[i] };
+    }
+
+    uncompressData(requests.data(), requests.size());
 }
 
 //------------------------------------------------------------------------------
 
 #if !TARGET_OS_IPHONE
 // Helper to get the properties of block compressed pixel formats used by this sample.
+//  Leaves the outputs unchanged for formats the BC codec doesn't handle.
 void getBCProperties(MTLPixelFormat pixelFormat, NSUInteger &blockSize, NSUInteger &bytesPerBlock, NSUInteger &channels, int &alpha)
 {
-    if (pixelFormat == MTLPixelFormatBC5_RGUnorm || pixelFormat == MTLPixelFormatBC5_RGSnorm)
-    {
-        blockSize = 4;
-        bytesPerBlock = 16;
-        channels = 2;
-        alpha = 0;
-    }
-    else if (pixelFormat == MTLPixelFormatBC4_RUnorm)
-    {
-        blockSize = 4;
-        bytesPerBlock = 8;
-        channels = 1;
-        alpha = 0;
-    }
-    else if (pixelFormat == MTLPixelFormatBC1_RGBA_sRGB || pixelFormat == MTLPixelFormatBC1_RGBA)
-    {
-        blockSize = 4;
-        bytesPerBlock = 8;
-        channels = 4;
-        alpha = 0;
-    }
-    else if (pixelFormat == MTLPixelFormatBC3_RGBA_sRGB || pixelFormat == MTLPixelFormatBC3_RGBA)
-    {
-        blockSize = 4;
-        bytesPerBlock = 16;
-        channels = 4;
-        alpha = 1;
-    }
+    AAPLBCFormat format;
+    if (!AAPLBCFormatForPixelFormat(pixelFormat, format))
+        return;
+
+    const AAPLBCFormatInfo& info = AAPLBCGetFormatInfo(format);
+    blockSize       = info.blockSize;
+    bytesPerBlock   = info.bytesPerBlock;
+    channels        = info.channels;
+    alpha           = info.alpha ? 1 : 0;
 }
 #endif
 
@@ -170,229 +154,134 @@ void getPixelFormatBlockDesc(MTLPixelFormat pixelFormat, NSUInteger &blockSize,
 
 @implementation AAPLTextureData
 
-+ (BOOL)supportsSecureCoding
-{
-    return YES;
-}
-
-- (nonnull instancetype)initWithCoder:(nonnull NSCoder *)coder
+- (nonnull instancetype)initWithMeshFileTexture:(const AAPLMeshFileTexture &)texture
 {
     self = [super init];
 
     if (self)
     {
-        _path               = (NSString *)[coder decodeObjectForKey:@"path"];
-        _width              = (uint64_t)[coder decodeInt64ForKey:@"width"];
-        _height             = (uint64_t)[coder decodeInt64ForKey:@"height"];
-        _mipmapLevelCount   = (uint64_t)[coder decodeInt64ForKey:@"mipmapLevelCount"];
-        _pixelFormat        = (MTLPixelFormat)[coder decodeInt64ForKey:@"pixelFormat"];
-        _pixelDataOffset    = (uint64_t)[coder decodeInt64ForKey:@"pixelDataOffset"];
-        _pixelDataLength    = (uint64_t)[coder decodeInt64ForKey:@"pixelDataLength"];
-        _mipOffsets         = (NSArray*)[coder decodeObjectForKey:@"mipOffsets"];
-        _mipLengths         = (NSArray*)[coder decodeObjectForKey:@"mipLengths"];
+        _path               = [NSString stringWithUTF8String:texture.path.c_str()];
+        _width              = texture.width;
+        _height             = texture.height;
+        _mipmapLevelCount   = texture.mipmapLevelCount;
+        _pixelFormat        = (MTLPixelFormat)texture.pixelFormat;
+        _pixelDataOffset    = texture.pixelDataOffset;
+        _pixelDataLength    = texture.pixelDataLength;
+
+        NSMutableArray *mipOffsets = [NSMutableArray arrayWithCapacity:texture.mipOffsets.size()];
+        NSMutableArray *mipLengths = [NSMutableArray arrayWithCapacity:texture.mipLengths.size()];
+        for (size_t mip = 0; mip < texture.mipOffsets.size(); ++mip)
+        {
+            [mipOffsets addObject:@(texture.mipOffsets[mip])];
+            [mipLengths addObject:@(texture.mipLengths[mip])];
+        }
+        _mipOffsets         = mipOffsets;
+        _mipLengths         = mipLengths;
     }
 
     return self;
 }
 
-- (void)encodeWithCoder:(NSCoder *)coder
-{
-    [coder encodeObject:_path forKey:@"path"];
-    [coder encodeInt64:(int64_t)_width forKey:@"width"];
-    [coder encodeInt64:(int64_t)_height forKey:@"height"];
-    [coder encodeInt64:(int64_t)_mipmapLevelCount forKey:@"mipmapLevelCount"];
-    [coder encodeInt64:(int64_t)_pixelFormat forKey:@"pixelFormat"];
-    [coder encodeInt64:(int64_t)_pixelDataOffset forKey:@"pixelDataOffset"];
-    [coder encodeInt64:(int64_t)_pixelDataLength forKey:@"pixelDataLength"];
-    [coder encodeObject:_mipOffsets forKey:@"mipOffsets"];
-    [coder encodeObject:_mipLengths forKey:@"mipLengths"];
-}
-
 @end
 
 //------------------------------------------------------------------------------
 
 @implementation AAPLMeshData
-
-+ (BOOL)supportsSecureCoding
 {
-    return YES;
+    // The mapped file, shared with the deallocator of `textureData` so that textures can
+    //  keep streaming from it after the mesh data is released.
+    std::shared_ptr<AAPLMeshFile> _file;
 }
 
-- (nonnull instancetype)initWithCoder:(nonnull NSCoder *)coder
+- (nullable instancetype)initWithMeshFile:(const std::shared_ptr<AAPLMeshFile> &)file
 {
     self = [super init];
 
     if (self)
     {
-        _vertexCount            = (uint64_t)[coder decodeInt64ForKey:@"vertexCount"];
-        _indexCount             = (uint64_t)[coder decodeInt64ForKey:@"indexCount"];
-        _indexType              = (uint64_t)[coder decodeInt64ForKey:@"indexType"];
-
-        _chunkCount             = (uint64_t)[coder decodeInt64ForKey:@"chunkCount"];
-        _meshCount              = (uint64_t)[coder decodeInt64ForKey:@"meshCount"];
-
-        _opaqueChunkCount       = (uint64_t)[coder decodeInt64ForKey:@"opaqueChunkCount"];
-        _opaqueMeshCount        = (uint64_t)[coder decodeInt64ForKey:@"opaqueMeshCount"];
-
-        _alphaMaskedChunkCount  = (uint64_t)[coder decodeInt64ForKey:@"alphaMaskedChunkCount"];
-        _alphaMaskedMeshCount   = (uint64_t)[coder decodeInt64ForKey:@"alphaMaskedMeshCount"];
-
-        _transparentChunkCount  = (uint64_t)[coder decodeInt64ForKey:@"transparentChunkCount"];
-        _transparentMeshCount   = (uint64_t)[coder decodeInt64ForKey:@"transparentMeshCount"];
-
-        _materialCount          = (uint64_t)[coder decodeInt64ForKey:@"materialCount"];
-
-        _vertexData     = (NSData *)[coder decodeObjectForKey:@"vertexData"];
-        _normalData     = (NSData *)[coder decodeObjectForKey:@"normalData"];
-        _tangentData    = (NSData *)[coder decodeObjectForKey:@"tangentData"];
-        _uvData         = (NSData *)[coder decodeObjectForKey:@"uvData"];
-
-        _indexData          = (NSData *)[coder decodeObjectForKey:@"indexData"];
-        _chunkData          = (NSData *)[coder decodeObjectForKey:@"chunkData"];
-        _meshData           = (NSData *)[coder decodeObjectForKey:@"meshData"];
-        _materialData       = (NSData *)[coder decodeObjectForKey:@"materialData"];
-
-        _textures       = (NSArray<AAPLTextureData *> *)[coder decodeObjectForKey:@"textures"];
-        _textureData    = (NSData *)[coder decodeObjectForKey:@"textureData"];
-    }
-
-    return self;
-}
-
-- (void)encodeWithCoder:(nonnull NSCoder *)coder
-{
-    [coder encodeInt64:(int64_t)_vertexCount forKey:@"vertexCount"];
-    [coder encodeInt64:(int64_t)_indexCount forKey:@"indexCount"];
-    [coder encodeInt64:(int64_t)_indexType forKey:@"indexType"];
-
-    [coder encodeInt64:(int64_t)_chunkCount forKey:@"chunkCount"];
-    [coder encodeInt64:(int64_t)_meshCount forKey:@"meshCount"];
-
-    [coder encodeInt64:(int64_t)_opaqueChunkCount forKey:@"opaqueChunkCount"];
-    [coder encodeInt64:(int64_t)_opaqueMeshCount forKey:@"opaqueMeshCount"];
-
-    [coder encodeInt64:(int64_t)_alphaMaskedChunkCount forKey:@"alphaMaskedChunkCount"];
-    [coder encodeInt64:(int64_t)_alphaMaskedMeshCount forKey:@"alphaMaskedMeshCount"];
-
-    [coder encodeInt64:(int64_t)_transparentChunkCount forKey:@"transparentChunkCount"];
-    [coder encodeInt64:(int64_t)_transparentMeshCount forKey:@"transparentMeshCount"];
-
-    [coder encodeInt64:(int64_t)_materialCount forKey:@"materialCount"];
-
-    [coder encodeObject:_vertexData forKey:@"vertexData"];
-    [coder encodeObject:_normalData forKey:@"normalData"];
-    [coder encodeObject:_tangentData forKey:@"tangentData"];
-    [coder encodeObject:_uvData forKey:@"uvData"];
-
-    [coder encodeObject:_indexData forKey:@"indexData"];
-    [coder encodeObject:_chunkData forKey:@"chunkData"];
-    [coder encodeObject:_meshData forKey:@"meshData"];
-    [coder encodeObject:_materialData forKey:@"materialData"];
-
-    [coder encodeObject:_textures forKey:@"textures"];
-    [coder encodeObject:_textureData forKey:@"textureData"];
-}
-
-+ (nullable AAPLMeshData *)meshWithFilename:(nonnull NSString *)filename
-{
-    @autoreleasepool
-    {
-        NSURL *URL = [[NSBundle mainBundle] URLForResource:filename withExtension:nil];
-
-        if (!URL)
+        const AAPLMeshFileBlock blocks[] =
         {
-            NSLog(@"Could not find resource '%@'", filename);
-            return nil;
-        }
+            file->vertexBlock(), file->normalBlock(), file->tangentBlock(), file->uvBlock(),
+            file->indexBlock(), file->chunkBlock(), file->meshBlock(), file->materialBlock(),
+        };
 
-        int fd = open(URL.fileSystemRepresentation, O_RDONLY, 0);
-
-        if (fd < 0)
+        for (const AAPLMeshFileBlock& block : blocks)
         {
-            NSLog(@"Could not open '%@'", URL);
-            return nil;
+            if (!block.valid())
+            {
+                NSLog(@"Mesh file is missing a stream");
+                return nil;
+            }
         }
 
-        struct stat fileInfo;
+        _file                   = file;
 
-        if (fstat(fd, &fileInfo))
-        {
-            NSLog(@"Could not get file size for '%@'", URL);
-            close(fd);
-            return nil;
-        }
+        _vertexCount            = file->vertexCount();
+        _indexCount             = file->indexCount();
+        _indexType              = file->indexType();
 
-        if (fileInfo.st_size < sizeof(AAPLFileHeader))
-        {
-            NSLog(@"File '%@' is too small", URL);
-            close(fd);
-            return nil;
-        }
+        _chunkCount             = file->chunkCount();
+        _meshCount              = file->meshCount();
 
-        unsigned char *mappedData = (unsigned char *)mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        _opaqueChunkCount       = file->opaqueChunkCount();
+        _opaqueMeshCount        = file->opaqueMeshCount();
 
-        close(fd);
+        _alphaMaskedChunkCount  = file->alphaMaskedChunkCount();
+        _alphaMaskedMeshCount   = file->alphaMaskedMeshCount();
 
-        if (mappedData == MAP_FAILED)
-        {
-            NSLog(@"Could not map '%@': %d", URL, errno);
-            return nil;
-        }
+        _transparentChunkCount  = file->transparentChunkCount();
+        _transparentMeshCount   = file->transparentMeshCount();
 
-        unsigned char *fileData = mappedData;
+        _materialCount          = file->materialCount();
 
-        AAPLFileHeader header = *(AAPLFileHeader *)fileData;
-        fileData += sizeof(AAPLFileHeader);
+        NSMutableArray<AAPLTextureData *> *textures = [NSMutableArray arrayWithCapacity:file->textures().size()];
+        for (const AAPLMeshFileTexture& texture : file->textures())
+            [textures addObject:[[AAPLTextureData alloc] initWithMeshFileTexture:texture]];
+        _textures = textures;
 
-        if (header.magic != MESH_MAGIC)
+        // Reference the texture data in place, keeping the file mapped until the data goes away.
+        const AAPLSpan<uint8_t> textureBytes = file->textureData();
+        if (textureBytes.empty())
         {
-            NSLog(@"File is not a mesh file");
-            munmap(mappedData, fileInfo.st_size);
-            return nil;
+            _textureData = [NSData data];
         }
-
-        if (header.version != MESH_VERSION)
+        else
         {
-            NSLog(@"Unsupported mesh file version");
-            munmap(mappedData, fileInfo.st_size);
-            return nil;
+            std::shared_ptr<AAPLMeshFile> owner = file;
+            _textureData = [[NSData alloc] initWithBytesNoCopy:(void *)textureBytes.data
+                                                        length:textureBytes.size()
+                                                   deallocator:^(void *, NSUInteger) { (void)owner; }];
         }
+    }
 
-        NSData *archivedData = [NSData dataWithBytesNoCopy:fileData
-                                                    length:header.dataOffset
-                                              freeWhenDone:NO];
-
-        NSError *error;
-
-        NSSet *allowedClasses = [NSSet setWithArray:@[
-            [AAPLMeshData class],
-            [NSMutableArray class],
-            [AAPLTextureData class],
-            [NSMutableString class],
-            [NSData class],
-            [NSNumber class],
-            [NSString class]
-        ]];
+    return self;
+}
 
-        [NSKeyedUnarchiver setClass:[AAPLTextureData class] forClassName:@"Texture"];
-        [NSKeyedUnarchiver setClass:[AAPLMeshData class] forClassName:@"Mesh"];
+- (const AAPLMeshFile *)file
+{
+    return _file.get();
+}
 
-        AAPLMeshData *mesh = [NSKeyedUnarchiver unarchivedObjectOfClasses:allowedClasses
-                                                                 fromData:archivedData
-                                                                    error:&error];
++ (nullable AAPLMeshData *)meshWithFilename:(nonnull NSString *)filename
+{
+    NSURL *URL = [[NSBundle mainBundle] URLForResource:filename withExtension:nil];
 
-        if (!mesh)
-        {
-            NSLog(@"Failed to decode mesh: %@", error);
-            munmap(mappedData, fileInfo.st_size);
-            return nil;
-        }
+    if (!URL)
+    {
+        NSLog(@"Could not find resource '%@'", filename);
+        return nil;
+    }
 
-        fileData += header.dataOffset;
+    // Map the file and read its streams in place, instead of unarchiving copies of them.
+    std::shared_ptr<AAPLMeshFile> file = std::make_shared<AAPLMeshFile>();
 
-        return mesh;
+    if (!file->open(URL.fileSystemRepresentation))
+    {
+        NSLog(@"Failed to load mesh '%@': %s", URL, file->error().c_str());
+        return nil;
     }
+
+    return [[AAPLMeshData alloc] initWithMeshFile:file];
 }
 
 @end
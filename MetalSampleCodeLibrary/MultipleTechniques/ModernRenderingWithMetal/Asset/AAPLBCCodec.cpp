@@ -0,0 +1,805 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the CPU encoder and decoder of the BC1, BC3, BC4 and BC5 formats.
+*/
+#include "AAPLBCCodec.h"
+
+#include "../Renderer/RenderTech/AAPLCPUSIMD.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using AAPLSIMD::Float;
+
+static const AAPLBCFormatInfo FormatInfos[] =
+{
+    // blockSize, bytesPerBlock, channels, alpha
+    { 4,  8, 4, false },    // BC1
+    { 4, 16, 4, true  },    // BC3
+    { 4,  8, 1, false },    // BC4
+    { 4,  8, 1, false },    // BC4Signed
+    { 4, 16, 2, false },    // BC5
+    { 4, 16, 2, false },    // BC5Signed
+};
+
+// Blocks across and down each encoding task.
+static const uint32_t TileBlocks = 16;
+
+// Passes of the neighbourhood search of high quality endpoints.
+static const uint32_t MaxSearchPasses = 8;
+
+// Runs `task` for every index in [0, count) on up to `threadCount` threads.
+void parallelFor(size_t count, unsigned threadCount, const std::function<void(size_t)>& task)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = (unsigned)std::min<size_t>(threadCount, count);
+
+    std::atomic<size_t> next(0);
+    const auto worker = [&]()
+    {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+            task(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < threadCount; ++t)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+inline bool isSigned(AAPLBCFormat format)
+{
+    return format == AAPLBCFormat::BC4Signed || format == AAPLBCFormat::BC5Signed;
+}
+
+inline int roundDivide(int numerator, int denominator)
+{
+    return (int)floorf((float)numerator / (float)denominator + 0.5f);
+}
+
+//------------------------------------------------------------------------------
+// Palettes, shared by the encoder and the decoder so that the encoder measures the error
+//  of exactly what decodes.
+
+// Expands a 5:6:5 color to 8 bits per channel by replicating the high bits.
+inline void expand565(uint16_t color, int rgb[3])
+{
+    const int r = (color >> 11) & 31;
+    const int g = (color >> 5) & 63;
+    const int b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+inline uint16_t quantize565(float r, float g, float b)
+{
+    const int qr = (int)lrintf(std::min(std::max(r, 0.0f), 255.0f) * (31.0f / 255.0f));
+    const int qg = (int)lrintf(std::min(std::max(g, 0.0f), 255.0f) * (63.0f / 255.0f));
+    const int qb = (int)lrintf(std::min(std::max(b, 0.0f), 255.0f) * (31.0f / 255.0f));
+    return (uint16_t)((qr << 11) | (qg << 5) | qb);
+}
+
+// Colors of the indices of a BC1 block, with alpha.  Blocks with `color0 <= color1` have
+//  three colors and transparent black, except in BC3, where blocks always have four colors.
+void paletteBC1(uint16_t color0, uint16_t color1, bool fourColors, int palette[4][4])
+{
+    expand565(color0, palette[0]);
+    expand565(color1, palette[1]);
+    palette[0][3] = palette[1][3] = 255;
+
+    for (int c = 0; c < 3; ++c)
+    {
+        const int a = palette[0][c];
+        const int b = palette[1][c];
+        if (fourColors || color0 > color1)
+        {
+            palette[2][c] = (2 * a + b + 1) / 3;
+            palette[3][c] = (a + 2 * b + 1) / 3;
+        }
+        else
+        {
+            palette[2][c] = (a + b) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = (fourColors || color0 > color1) ? 255 : 0;
+}
+
+// Values of the indices of a BC4 block.  Blocks with `value0 > value1` interpolate 6 values;
+//  others interpolate 4 and add the ends of the range.
+void paletteBC4(int value0, int value1, bool isSigned, int palette[8])
+{
+    palette[0] = value0;
+    palette[1] = value1;
+    if (value0 > value1)
+    {
+        for (int i = 2; i < 8; ++i)
+            palette[i] = roundDivide((8 - i) * value0 + (i - 1) * value1, 7);
+    }
+    else
+    {
+        for (int i = 2; i < 6; ++i)
+            palette[i] = roundDivide((6 - i) * value0 + (i - 1) * value1, 5);
+        palette[6] = isSigned ? -127 : 0;
+        palette[7] = isSigned ? 127 : 255;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Encoder.
+
+// The 16 pixels of a block, one array per channel, so that they load as vectors.
+struct BlockPixels
+{
+    float channel[4][16];
+};
+
+// Picks the nearest of `K` palette entries for each pixel over `C` channels from `first`, and
+//  returns the sum of the squared errors.  Ties go to the lower index.
+template <int C, int K>
+float fitIndices(const BlockPixels& pixels, int first, const float (&palette)[K][4], uint8_t indices[16])
+{
+    static_assert(16 % Float::Lanes == 0, "Blocks hold a whole number of vectors");
+
+    float errors[16];
+    float best[16];
+
+    for (uint32_t i = 0; i < 16; i += Float::Lanes)
+    {
+        Float value[C];
+        for (int c = 0; c < C; ++c)
+            value[c] = Float::load(&pixels.channel[first + c][i]);
+
+        Float bestError = Float::splat(FLT_MAX);
+        Float bestIndex = Float::splat(0.0f);
+        for (int k = 0; k < K; ++k)
+        {
+            Float error = Float::splat(0.0f);
+            for (int c = 0; c < C; ++c)
+            {
+                const Float d = value[c] - Float::splat(palette[k][c]);
+                error = error + d * d;
+            }
+            const Float closer = error < bestError;
+            bestError = select(closer, error, bestError);
+            bestIndex = select(closer, Float::splat((float)k), bestIndex);
+        }
+        bestError.store(&errors[i]);
+        bestIndex.store(&best[i]);
+    }
+
+    float total = 0.0f;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        total += errors[i];
+        indices[i] = (uint8_t)best[i];
+    }
+    return total;
+}
+
+struct ColorFit
+{
+    uint16_t    color0;
+    uint16_t    color1;
+    uint8_t     indices[16];
+    float       error;
+};
+
+// Fits indices to a pair of 5:6:5 endpoints, ordered so that the block has four colors.
+//  Equal endpoints would make a three color block, so all pixels take the first.
+void fitColors(uint16_t a, uint16_t b, const BlockPixels& pixels, ColorFit& fit)
+{
+    fit.color0 = std::max(a, b);
+    fit.color1 = std::min(a, b);
+
+    int palette[4][4];
+    paletteBC1(fit.color0, fit.color1, true, palette);
+
+    if (fit.color0 == fit.color1)
+    {
+        const float single[1][4] = { { (float)palette[0][0], (float)palette[0][1], (float)palette[0][2], 0.0f } };
+        fit.error = fitIndices<3, 1>(pixels, 0, single, fit.indices);
+        return;
+    }
+
+    float values[4][4];
+    for (int k = 0; k < 4; ++k)
+    {
+        for (int c = 0; c < 4; ++c)
+            values[k][c] = (float)palette[k][c];
+    }
+    fit.error = fitIndices<3, 4>(pixels, 0, values, fit.indices);
+}
+
+// Solves for the endpoints that minimize the squared error of pixels with fixed weights of
+//  the first endpoint, which is least squares over the pairs (w, 1 - w).
+bool solveEndpoints(const float* weights, const float* const* values, int channels, const bool* used,
+                    float* end0, float* end1)
+{
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    float av[4] = {}, bv[4] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+        if (used && !used[i])
+            continue;
+
+        const float a = weights[i];
+        const float b = 1.0f - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (int c = 0; c < channels; ++c)
+        {
+            av[c] += a * values[c][i];
+            bv[c] += b * values[c][i];
+        }
+    }
+
+    const float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) < 1e-6f)
+        return false;
+
+    const float inverse = 1.0f / determinant;
+    for (int c = 0; c < channels; ++c)
+    {
+        end0[c] = (av[c] * bb - bv[c] * ab) * inverse;
+        end1[c] = (bv[c] * aa - av[c] * ab) * inverse;
+    }
+    return true;
+}
+
+// Refines the endpoints of a fit by least squares over its indices.  Returns whether the
+//  error fell.
+bool refineColors(const BlockPixels& pixels, ColorFit& fit)
+{
+    static const float Weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+    float weights[16];
+    for (int i = 0; i < 16; ++i)
+        weights[i] = Weights[fit.indices[i]];
+
+    const float* values[3] = { pixels.channel[0], pixels.channel[1], pixels.channel[2] };
+    float end0[3], end1[3];
+    if (!solveEndpoints(weights, values, 3, nullptr, end0, end1))
+        return false;
+
+    ColorFit refined;
+    fitColors(quantize565(end0[0], end0[1], end0[2]), quantize565(end1[0], end1[1], end1[2]), pixels, refined);
+    if (refined.error >= fit.error)
+        return false;
+
+    fit = refined;
+    return true;
+}
+
+// Adds `delta` to one channel of a 5:6:5 color, returning false if it leaves the range.
+bool offset565(uint16_t color, int channel, int delta, uint16_t& result)
+{
+    static const int Shift[3]   = { 11, 5, 0 };
+    static const int Mask[3]    = { 31, 63, 31 };
+
+    const int value = ((color >> Shift[channel]) & Mask[channel]) + delta;
+    if (value < 0 || value > Mask[channel])
+        return false;
+
+    result = (uint16_t)((color & ~(Mask[channel] << Shift[channel])) | (value << Shift[channel]));
+    return true;
+}
+
+void encodeColorBlock(const BlockPixels& pixels, AAPLBCQuality quality, uint8_t* block)
+{
+    // Find the principal axis of the colors by power iteration on their covariance.
+    float mean[3] = {};
+    for (int c = 0; c < 3; ++c)
+    {
+        for (int i = 0; i < 16; ++i)
+            mean[c] += pixels.channel[c][i];
+        mean[c] *= 1.0f / 16.0f;
+    }
+
+    float covariance[6] = {};   // xx, xy, xz, yy, yz, zz
+    for (int i = 0; i < 16; ++i)
+    {
+        const float r = pixels.channel[0][i] - mean[0];
+        const float g = pixels.channel[1][i] - mean[1];
+        const float b = pixels.channel[2][i] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        const float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+        const float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+        const float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+        const float largest = std::max(fabsf(x), std::max(fabsf(y), fabsf(z)));
+        if (largest < 1e-6f)
+            break;
+        axis[0] = x / largest;
+        axis[1] = y / largest;
+        axis[2] = z / largest;
+    }
+
+    // Start from the pixels at both ends of the axis.
+    int lowest = 0, highest = 0;
+    float lowestProjection = FLT_MAX, highestProjection = -FLT_MAX;
+    for (int i = 0; i < 16; ++i)
+    {
+        const float projection = pixels.channel[0][i] * axis[0] + pixels.channel[1][i] * axis[1] + pixels.channel[2][i] * axis[2];
+        if (projection < lowestProjection)
+        {
+            lowestProjection = projection;
+            lowest = i;
+        }
+        if (projection > highestProjection)
+        {
+            highestProjection = projection;
+            highest = i;
+        }
+    }
+
+    ColorFit fit;
+    fitColors(quantize565(pixels.channel[0][highest], pixels.channel[1][highest], pixels.channel[2][highest]),
+              quantize565(pixels.channel[0][lowest], pixels.channel[1][lowest], pixels.channel[2][lowest]),
+              pixels, fit);
+
+    if (fit.error > 0.0f)
+    {
+        if (quality == AAPLBCQuality::Fast)
+        {
+            refineColors(pixels, fit);
+        }
+        else
+        {
+            for (int iteration = 0; iteration < 8 && fit.error > 0.0f && refineColors(pixels, fit); ++iteration)
+                ;
+
+            // Step each channel of each endpoint while that lowers the error.
+            for (uint32_t pass = 0; pass < MaxSearchPasses && fit.error > 0.0f; ++pass)
+            {
+                bool improved = false;
+                for (int endpoint = 0; endpoint < 2; ++endpoint)
+                {
+                    for (int channel = 0; channel < 3; ++channel)
+                    {
+                        for (int delta = -1; delta <= 1; delta += 2)
+                        {
+                            uint16_t colors[2] = { fit.color0, fit.color1 };
+                            if (!offset565(colors[endpoint], channel, delta, colors[endpoint]))
+                                continue;
+
+                            ColorFit candidate;
+                            fitColors(colors[0], colors[1], pixels, candidate);
+                            if (candidate.error < fit.error)
+                            {
+                                fit = candidate;
+                                improved = true;
+                            }
+                        }
+                    }
+                }
+                if (!improved)
+                    break;
+            }
+        }
+    }
+
+    uint32_t indices = 0;
+    for (int i = 0; i < 16; ++i)
+        indices |= (uint32_t)fit.indices[i] << (2 * i);
+
+    memcpy(block,     &fit.color0, 2);
+    memcpy(block + 2, &fit.color1, 2);
+    memcpy(block + 4, &indices, 4);
+}
+
+struct ValueFit
+{
+    int         value0;
+    int         value1;
+    uint8_t     indices[16];
+    float       error;
+};
+
+void fitValues(int value0, int value1, bool isSigned, const BlockPixels& pixels, int channel, ValueFit& fit)
+{
+    int palette[8];
+    paletteBC4(value0, value1, isSigned, palette);
+
+    float values[8][4] = {};
+    for (int k = 0; k < 8; ++k)
+        values[k][0] = (float)palette[k];
+
+    fit.value0  = value0;
+    fit.value1  = value1;
+    fit.error   = fitIndices<1, 8>(pixels, channel, values, fit.indices);
+}
+
+// Refines the endpoints of a fit by least squares, keeping the mode of the block.
+bool refineValues(bool isSigned, const BlockPixels& pixels, int channel, ValueFit& fit)
+{
+    const bool interpolatesSix  = fit.value0 > fit.value1;
+    const int  low              = isSigned ? -127 : 0;
+    const int  high             = isSigned ? 127 : 255;
+
+    float weights[16];
+    bool  used[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        const int index = fit.indices[i];
+        used[i] = interpolatesSix || index < 6;
+        weights[i] = index == 0 ? 1.0f : index == 1 ? 0.0f :
+                     interpolatesSix ? (8 - index) / 7.0f : (6 - index) / 5.0f;
+    }
+
+    const float* values[1] = { pixels.channel[channel] };
+    float end0, end1;
+    if (!solveEndpoints(weights, values, 1, used, &end0, &end1))
+        return false;
+
+    int value0 = std::min(std::max((int)lrintf(end0), low), high);
+    int value1 = std::min(std::max((int)lrintf(end1), low), high);
+
+    // Keep the order of the endpoints, which selects the mode.
+    if (interpolatesSix && value0 <= value1)
+    {
+        if (value0 == value1 && value0 < high)
+            ++value0;
+        else if (value0 == value1)
+            --value1;
+        else
+            std::swap(value0, value1);
+    }
+    else if (!interpolatesSix && value0 > value1)
+    {
+        std::swap(value0, value1);
+    }
+
+    ValueFit refined;
+    fitValues(value0, value1, isSigned, pixels, channel, refined);
+    if (refined.error >= fit.error)
+        return false;
+
+    fit = refined;
+    return true;
+}
+
+// Steps each endpoint while that lowers the error, within the mode of the block.
+void searchValues(bool isSigned, const BlockPixels& pixels, int channel, ValueFit& fit)
+{
+    const bool interpolatesSix  = fit.value0 > fit.value1;
+    const int  low              = isSigned ? -127 : 0;
+    const int  high             = isSigned ? 127 : 255;
+
+    for (uint32_t pass = 0; pass < MaxSearchPasses && fit.error > 0.0f; ++pass)
+    {
+        bool improved = false;
+        for (int endpoint = 0; endpoint < 2; ++endpoint)
+        {
+            for (int delta = -1; delta <= 1; delta += 2)
+            {
+                int values[2] = { fit.value0, fit.value1 };
+                values[endpoint] += delta;
+                if (values[endpoint] < low || values[endpoint] > high || (values[0] > values[1]) != interpolatesSix)
+                    continue;
+
+                ValueFit candidate;
+                fitValues(values[0], values[1], isSigned, pixels, channel, candidate);
+                if (candidate.error < fit.error)
+                {
+                    fit = candidate;
+                    improved = true;
+                }
+            }
+        }
+        if (!improved)
+            break;
+    }
+}
+
+void encodeValueBlock(const BlockPixels& pixels, int channel, bool isSigned, AAPLBCQuality quality, uint8_t* block)
+{
+    const float* values = pixels.channel[channel];
+    const int low  = isSigned ? -127 : 0;
+    const int high = isSigned ? 127 : 255;
+
+    int minimum = high, maximum = low;
+    int innerMinimum = high, innerMaximum = low;    // Without the ends of the range.
+    for (int i = 0; i < 16; ++i)
+    {
+        const int value = (int)values[i];
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+        if (value != low && value != high)
+        {
+            innerMinimum = std::min(innerMinimum, value);
+            innerMaximum = std::max(innerMaximum, value);
+        }
+    }
+
+    ValueFit fit;
+    if (minimum == maximum)
+    {
+        fitValues(minimum, maximum, isSigned, pixels, channel, fit);
+    }
+    else
+    {
+        // Six interpolated values between the extremes.
+        fitValues(maximum, minimum, isSigned, pixels, channel, fit);
+        if (quality == AAPLBCQuality::Fast)
+        {
+            refineValues(isSigned, pixels, channel, fit);
+        }
+        else
+        {
+            for (int iteration = 0; iteration < 8 && fit.error > 0.0f && refineValues(isSigned, pixels, channel, fit); ++iteration)
+                ;
+            searchValues(isSigned, pixels, channel, fit);
+
+            // Four interpolated values between the extremes that aren't at the ends of the range,
+            //  which the other two indices represent exactly.
+            if (fit.error > 0.0f)
+            {
+                ValueFit other;
+                if (innerMinimum > innerMaximum)
+                    fitValues(low, high, isSigned, pixels, channel, other);
+                else
+                    fitValues(innerMinimum, innerMaximum, isSigned, pixels, channel, other);
+
+                for (int iteration = 0; iteration < 8 && other.error > 0.0f && refineValues(isSigned, pixels, channel, other); ++iteration)
+                    ;
+                searchValues(isSigned, pixels, channel, other);
+
+                if (other.error < fit.error)
+                    fit = other;
+            }
+        }
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 16; ++i)
+        indices |= (uint64_t)fit.indices[i] << (3 * i);
+
+    block[0] = (uint8_t)fit.value0;
+    block[1] = (uint8_t)fit.value1;
+    for (int i = 0; i < 6; ++i)
+        block[2 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+// Loads the pixels of a block, as signed values for signed formats.
+void loadBlock(const uint8_t pixels[64], bool isSigned, BlockPixels& block)
+{
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            const uint8_t value = pixels[i * 4 + c];
+            block.channel[c][i] = isSigned ? (float)std::max((int)(int8_t)value, -127) : (float)value;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Decoder.
+
+void decodeColorBlock(const uint8_t* block, bool fourColors, uint8_t pixels[64])
+{
+    uint16_t color0, color1;
+    uint32_t indices;
+    memcpy(&color0, block, 2);
+    memcpy(&color1, block + 2, 2);
+    memcpy(&indices, block + 4, 4);
+
+    int palette[4][4];
+    paletteBC1(color0, color1, fourColors, palette);
+
+    for (int i = 0; i < 16; ++i)
+    {
+        const int* color = palette[(indices >> (2 * i)) & 3];
+        for (int c = 0; c < 4; ++c)
+            pixels[i * 4 + c] = (uint8_t)color[c];
+    }
+}
+
+void decodeValueBlock(const uint8_t* block, bool isSigned, uint8_t pixels[64], int channel)
+{
+    const int value0 = isSigned ? std::max((int)(int8_t)block[0], -127) : block[0];
+    const int value1 = isSigned ? std::max((int)(int8_t)block[1], -127) : block[1];
+
+    int palette[8];
+    paletteBC4(value0, value1, isSigned, palette);
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; ++i)
+        indices |= (uint64_t)block[2 + i] << (8 * i);
+
+    for (int i = 0; i < 16; ++i)
+        pixels[i * 4 + channel] = (uint8_t)palette[(indices >> (3 * i)) & 7];
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+const AAPLBCFormatInfo& AAPLBCGetFormatInfo(AAPLBCFormat format)
+{
+    return FormatInfos[(uint32_t)format];
+}
+
+size_t AAPLBCEncodedSize(AAPLBCFormat format, uint32_t width, uint32_t height)
+{
+    const AAPLBCFormatInfo& info = AAPLBCGetFormatInfo(format);
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * info.bytesPerBlock;
+}
+
+void AAPLBCEncodeBlock(AAPLBCFormat format, const uint8_t pixels[64], void* destination, AAPLBCQuality quality)
+{
+    BlockPixels block;
+    loadBlock(pixels, isSigned(format), block);
+
+    uint8_t* output = (uint8_t*)destination;
+    switch (format)
+    {
+        case AAPLBCFormat::BC1:
+            encodeColorBlock(block, quality, output);
+            break;
+        case AAPLBCFormat::BC3:
+            encodeValueBlock(block, 3, false, quality, output);
+            encodeColorBlock(block, quality, output + 8);
+            break;
+        case AAPLBCFormat::BC4:
+        case AAPLBCFormat::BC4Signed:
+            encodeValueBlock(block, 0, isSigned(format), quality, output);
+            break;
+        case AAPLBCFormat::BC5:
+        case AAPLBCFormat::BC5Signed:
+            encodeValueBlock(block, 0, isSigned(format), quality, output);
+            encodeValueBlock(block, 1, isSigned(format), quality, output + 8);
+            break;
+    }
+}
+
+void AAPLBCDecodeBlock(AAPLBCFormat format, const void* source, uint8_t pixels[64])
+{
+    const uint8_t* block = (const uint8_t*)source;
+    switch (format)
+    {
+        case AAPLBCFormat::BC1:
+            decodeColorBlock(block, false, pixels);
+            break;
+        case AAPLBCFormat::BC3:
+            decodeColorBlock(block + 8, true, pixels);
+            decodeValueBlock(block, false, pixels, 3);
+            break;
+        case AAPLBCFormat::BC4:
+        case AAPLBCFormat::BC4Signed:
+            for (int i = 0; i < 16; ++i)
+            {
+                pixels[i * 4 + 1] = pixels[i * 4 + 2] = 0;
+                pixels[i * 4 + 3] = 255;
+            }
+            decodeValueBlock(block, isSigned(format), pixels, 0);
+            break;
+        case AAPLBCFormat::BC5:
+        case AAPLBCFormat::BC5Signed:
+            for (int i = 0; i < 16; ++i)
+            {
+                pixels[i * 4 + 2] = 0;
+                pixels[i * 4 + 3] = 255;
+            }
+            decodeValueBlock(block, isSigned(format), pixels, 0);
+            decodeValueBlock(block + 8, isSigned(format), pixels, 1);
+            break;
+    }
+}
+
+void AAPLBCEncode(AAPLBCFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, size_t bytesPerRow,
+                  void* destination, const AAPLBCEncodeOptions& options)
+{
+    if (width == 0 || height == 0)
+        return;
+
+    const uint32_t bytesPerBlock    = AAPLBCGetFormatInfo(format).bytesPerBlock;
+    const uint32_t blocksWide       = (width + 3) / 4;
+    const uint32_t blocksHigh       = (height + 3) / 4;
+    const uint32_t tilesWide        = (blocksWide + TileBlocks - 1) / TileBlocks;
+    const uint32_t tilesHigh        = (blocksHigh + TileBlocks - 1) / TileBlocks;
+
+    parallelFor((size_t)tilesWide * tilesHigh, options.threadCount, [&](size_t tile)
+    {
+        const uint32_t tileX = (uint32_t)(tile % tilesWide) * TileBlocks;
+        const uint32_t tileY = (uint32_t)(tile / tilesWide) * TileBlocks;
+
+        for (uint32_t blockY = tileY; blockY < std::min(tileY + TileBlocks, blocksHigh); ++blockY)
+        {
+            for (uint32_t blockX = tileX; blockX < std::min(tileX + TileBlocks, blocksWide); ++blockX)
+            {
+                uint8_t block[64];
+                for (uint32_t y = 0; y < 4; ++y)
+                {
+                    const uint8_t* row = pixels + std::min(blockY * 4 + y, height - 1) * bytesPerRow;
+                    for (uint32_t x = 0; x < 4; ++x)
+                        memcpy(block + (y * 4 + x) * 4, row + std::min(blockX * 4 + x, width - 1) * 4, 4);
+                }
+
+                uint8_t* output = (uint8_t*)destination + ((size_t)blockY * blocksWide + blockX) * bytesPerBlock;
+                AAPLBCEncodeBlock(format, block, output, options.quality);
+            }
+        }
+    });
+}
+
+void AAPLBCDecode(AAPLBCFormat format, const void* blocks, uint32_t width, uint32_t height,
+                  uint8_t* pixels, size_t bytesPerRow, unsigned threadCount)
+{
+    const uint32_t bytesPerBlock    = AAPLBCGetFormatInfo(format).bytesPerBlock;
+    const uint32_t blocksWide       = (width + 3) / 4;
+    const uint32_t blocksHigh       = (height + 3) / 4;
+
+    parallelFor(blocksHigh, threadCount, [&](size_t blockY)
+    {
+        for (uint32_t blockX = 0; blockX < blocksWide; ++blockX)
+        {
+            uint8_t block[64];
+            AAPLBCDecodeBlock(format, (const uint8_t*)blocks + (blockY * blocksWide + blockX) * bytesPerBlock, block);
+
+            const uint32_t rows     = std::min(4u, height - (uint32_t)blockY * 4);
+            const uint32_t columns  = std::min(4u, width - blockX * 4);
+            for (uint32_t y = 0; y < rows; ++y)
+                memcpy(pixels + (blockY * 4 + y) * bytesPerRow + blockX * 16, block + y * 16, columns * 4);
+        }
+    });
+}
+
+double AAPLBCComputePSNR(AAPLBCFormat format, const uint8_t* reference, const uint8_t* pixels,
+                         uint32_t width, uint32_t height, size_t bytesPerRow)
+{
+    const AAPLBCFormatInfo& info = AAPLBCGetFormatInfo(format);
+    const uint32_t channels = info.alpha ? info.channels : std::min(info.channels, 3u);
+    const bool     signedValues = isSigned(format);
+
+    double squaredError = 0.0;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width * 4; x += 4)
+        {
+            for (uint32_t c = 0; c < channels; ++c)
+            {
+                const uint8_t a = reference[y * bytesPerRow + x + c];
+                const uint8_t b = pixels[y * bytesPerRow + x + c];
+                const int difference = signedValues ? std::max((int)(int8_t)a, -127) - std::max((int)(int8_t)b, -127) : a - b;
+                squaredError += difference * difference;
+            }
+        }
+    }
+
+    if (squaredError == 0.0)
+        return INFINITY;
+
+    const double meanSquaredError = squaredError / ((double)width * height * channels);
+    return 10.0 * log10(255.0 * 255.0 / meanSquaredError);
+}
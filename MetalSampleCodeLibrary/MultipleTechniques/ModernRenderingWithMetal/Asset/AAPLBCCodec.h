@@ -0,0 +1,101 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the CPU encoder and decoder of the BC1, BC3, BC4 and BC5 block-compressed
+ texture formats.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __OBJC__
+#import <Metal/Metal.h>
+#endif
+
+// Block-compressed formats the codec encodes and decodes.  Signed formats read and write
+//  their channels as int8_t in two's complement.
+enum class AAPLBCFormat : uint32_t
+{
+    BC1,            // RGB, opaque.
+    BC3,            // RGBA.
+    BC4,            // R.
+    BC4Signed,
+    BC5,            // RG.
+    BC5Signed,
+};
+
+// Layout of a format.  Every format has 4x4 pixel blocks.
+struct AAPLBCFormatInfo
+{
+    uint32_t    blockSize;
+    uint32_t    bytesPerBlock;
+    uint32_t    channels;       // Leading channels of RGBA in the pixel format.
+    bool        alpha;          // Whether blocks store alpha; BC1 blocks the codec writes are opaque.
+};
+
+const AAPLBCFormatInfo& AAPLBCGetFormatInfo(AAPLBCFormat format);
+
+// Bytes of the blocks of an image.  Partial blocks at the right and bottom edges are whole.
+size_t AAPLBCEncodedSize(AAPLBCFormat format, uint32_t width, uint32_t height);
+
+enum class AAPLBCQuality : uint32_t
+{
+    // Endpoints from the extremes of the block along its principal axis, refined once
+    //  by least squares.
+    Fast,
+    // Also refines the endpoints until the error stops falling, searches the neighbouring
+    //  endpoints of the result, and tries both modes of BC4 blocks.
+    High,
+};
+
+struct AAPLBCEncodeOptions
+{
+    AAPLBCQuality   quality     = AAPLBCQuality::High;
+    unsigned        threadCount = 0;        // 0 for one thread per core.
+};
+
+// Encodes an RGBA8 image, `bytesPerRow` bytes apart, to `destination`, which must hold
+//  `AAPLBCEncodedSize` bytes.  Tiles of blocks encode in parallel.  Pixels past the edge of
+//  the image repeat the last row and column.
+void AAPLBCEncode(AAPLBCFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, size_t bytesPerRow,
+                  void* destination, const AAPLBCEncodeOptions& options = AAPLBCEncodeOptions());
+
+// Decodes blocks to an RGBA8 image, `bytesPerRow` bytes apart.  Channels that a format
+//  doesn't store decode to 0, and alpha to 255, as a texture samples them.
+void AAPLBCDecode(AAPLBCFormat format, const void* blocks, uint32_t width, uint32_t height,
+                  uint8_t* pixels, size_t bytesPerRow, unsigned threadCount = 1);
+
+// Encodes or decodes a single block of 16 RGBA8 pixels, row by row.
+void AAPLBCEncodeBlock(AAPLBCFormat format, const uint8_t pixels[64], void* block, AAPLBCQuality quality);
+void AAPLBCDecodeBlock(AAPLBCFormat format, const void* block, uint8_t pixels[64]);
+
+// Peak signal to noise ratio in dB between two RGBA8 images, over the channels the format
+//  stores.  Identical images return infinity.
+double AAPLBCComputePSNR(AAPLBCFormat format, const uint8_t* reference, const uint8_t* pixels,
+                         uint32_t width, uint32_t height, size_t bytesPerRow);
+
+#ifdef __OBJC__
+
+// Returns false for pixel formats the codec doesn't handle.  sRGB formats encode the same
+//  blocks as their linear counterparts.
+inline bool AAPLBCFormatForPixelFormat(MTLPixelFormat pixelFormat, AAPLBCFormat& format)
+{
+    switch (pixelFormat)
+    {
+#if !TARGET_OS_IPHONE
+        case MTLPixelFormatBC1_RGBA:
+        case MTLPixelFormatBC1_RGBA_sRGB:   format = AAPLBCFormat::BC1;         return true;
+        case MTLPixelFormatBC3_RGBA:
+        case MTLPixelFormatBC3_RGBA_sRGB:   format = AAPLBCFormat::BC3;         return true;
+        case MTLPixelFormatBC4_RUnorm:      format = AAPLBCFormat::BC4;         return true;
+        case MTLPixelFormatBC4_RSnorm:      format = AAPLBCFormat::BC4Signed;   return true;
+        case MTLPixelFormatBC5_RGUnorm:     format = AAPLBCFormat::BC5;         return true;
+        case MTLPixelFormatBC5_RGSnorm:     format = AAPLBCFormat::BC5Signed;   return true;
+#endif
+        default:                            return false;
+    }
+}
+
+#endif
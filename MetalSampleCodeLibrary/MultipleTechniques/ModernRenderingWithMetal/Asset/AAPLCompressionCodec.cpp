@@ -0,0 +1,601 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the compression codecs used by compressed blocks in mesh files, and of
+ the parallel decoder for chunked blocks.
+*/
+#include "AAPLCompressionCodec.h"
+#include "../Renderer/RenderTech/AAPLTaskPool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#if defined(__APPLE__)
+#include <compression.h>
+#else
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define AAPL_HAS_ZLIB 1
+#endif
+#if __has_include(<lz4.h>)
+#include <lz4.h>
+#define AAPL_HAS_LZ4 1
+#endif
+#if __has_include(<lzfse.h>)
+#include <lzfse.h>
+#define AAPL_HAS_LZFSE 1
+#endif
+#endif // !defined(__APPLE__)
+
+#if __has_include(<zstd.h>)
+#include <zstd.h>
+#define AAPL_HAS_ZSTD 1
+#endif
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+class NoneCodec : public AAPLCompressionCodec
+{
+public:
+    uint32_t    mode() const override { return AAPLCompressionModeNone; }
+    const char* name() const override { return "none"; }
+
+    bool decode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) const override
+    {
+        if (srcSize != dstSize)
+            return false;
+        memcpy(dst, src, dstSize);
+        return true;
+    }
+
+    bool canEncode() const override { return true; }
+
+    size_t encode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) const override
+    {
+        if (srcSize > dstCapacity)
+            return 0;
+        memcpy(dst, src, srcSize);
+        return srcSize;
+    }
+};
+
+#if defined(__APPLE__)
+
+// Any algorithm provided by libcompression.
+class LibCompressionCodec : public AAPLCompressionCodec
+{
+public:
+    LibCompressionCodec(compression_algorithm algorithm, const char* name)
+        : _algorithm(algorithm)
+        , _name(name) {}
+
+    uint32_t    mode() const override { return (uint32_t)_algorithm; }
+    const char* name() const override { return _name; }
+
+    bool decode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) const override
+    {
+        return compression_decode_buffer(dst, dstSize, src, srcSize, NULL, _algorithm) == dstSize;
+    }
+
+    bool canEncode() const override { return true; }
+
+    size_t encode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) const override
+    {
+        return compression_encode_buffer(dst, dstCapacity, src, srcSize, NULL, _algorithm);
+    }
+
+private:
+    compression_algorithm   _algorithm;
+    const char*             _name;
+};
+
+#else
+
+// Decodes a raw LZ4 block.  Returns the number of bytes written to `dst`, or 0 on error.
+size_t decodeLZ4Block(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+    const uint8_t* srcEnd = src + srcSize;
+    uint8_t* const dstBegin = dst;
+    uint8_t* const dstEnd = dst + dstSize;
+
+    auto readLength = [&](size_t length) -> size_t
+    {
+        if (length != 15)
+            return length;
+        uint8_t byte;
+        do
+        {
+            if (src >= srcEnd)
+                return SIZE_MAX;
+            byte = *src++;
+            length += byte;
+        } while (byte == 255);
+        return length;
+    };
+
+    while (src < srcEnd)
+    {
+        const uint8_t token = *src++;
+
+        const size_t literalLength = readLength(token >> 4);
+        if (literalLength > (size_t)(srcEnd - src) || literalLength > (size_t)(dstEnd - dst))
+            return 0;
+        memcpy(dst, src, literalLength);
+        src += literalLength;
+        dst += literalLength;
+
+        // The last sequence of a block has literals only.
+        if (src == srcEnd)
+            break;
+
+        if (srcEnd - src < 2)
+            return 0;
+        const size_t offset = src[0] | (src[1] << 8);
+        src += 2;
+        if (offset == 0 || offset > (size_t)(dst - dstBegin))
+            return 0;
+
+        const size_t matchLength = readLength(token & 15);
+        if (matchLength == SIZE_MAX || matchLength + 4 > (size_t)(dstEnd - dst))
+            return 0;
+
+        // Matches may overlap their output, so copy byte by byte.
+        const uint8_t* match = dst - offset;
+        for (size_t i = 0; i < matchLength + 4; ++i)
+            *dst++ = *match++;
+    }
+
+    return dst - dstBegin;
+}
+
+// The block-framed LZ4 stream written by compression_encode_buffer.
+class LZ4Codec : public AAPLCompressionCodec
+{
+public:
+    uint32_t    mode() const override { return AAPLCompressionModeLZ4; }
+    const char* name() const override { return "lz4"; }
+
+    bool decode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) const override
+    {
+        const uint8_t* srcEnd = src + srcSize;
+        size_t written = 0;
+
+        auto read32 = [](const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; };
+
+        while (srcEnd - src >= 4)
+        {
+            if (memcmp(src, "bv4$", 4) == 0)
+                return written == dstSize;
+
+            if (memcmp(src, "bv41", 4) == 0 && srcEnd - src >= 12)
+            {
+                const uint32_t decodedSize = read32(src + 4);
+                const uint32_t encodedSize = read32(src + 8);
+                src += 12;
+                if (encodedSize > (size_t)(srcEnd - src) || decodedSize > dstSize - written)
+                    return false;
+                if (decodeLZ4Block(src, encodedSize, dst + written, decodedSize) != decodedSize)
+                    return false;
+                src += encodedSize;
+                written += decodedSize;
+            }
+            else if (memcmp(src, "bv4-", 4) == 0 && srcEnd - src >= 8)
+            {
+                const uint32_t size = read32(src + 4);
+                src += 8;
+                if (size > (size_t)(srcEnd - src) || size > dstSize - written)
+                    return false;
+                memcpy(dst + written, src, size);
+                src += size;
+                written += size;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return false;
+    }
+};
+
+class LZ4RawCodec : public AAPLCompressionCodec
+{
+public:
+    uint32_t    mode() const override { return AAPLCompressionModeLZ4Raw; }
+    const char* name() const override { return "lz4-raw"; }
+
+    bool decode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) const override
+    {
+        return decodeLZ4Block(src, srcSize, dst, dstSize) == dstSize;
+    }
+
+#if AAPL_HAS_LZ4
+    bool canEncode() const override { return true; }
+
+    size_t encode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) const override
+    {
+        const int size = LZ4_compress_default((const char*)src, (char*)dst, (int)srcSize, (int)dstCapacity);
+        return size > 0 ? size : 0;
+    }
+#endif
+};
+
+#if AAPL_HAS_ZLIB
+// Raw DEFLATE, which is what COMPRESSION_ZLIB produces.
+class ZlibCodec : public AAPLCompressionCodec
+{
+public:
+    uint32_t    mode() const override { return AAPLCompressionModeZLIB; }
+    const char* name() const override { return "zlib"; }
+
+    bool decode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) const override
+    {
+        z_stream stream = {};
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+            return false;
+
+        stream.next_in   = (Bytef*)src;
+        stream.avail_in  = (uInt)srcSize;
+        stream.next_out  = dst;
+        stream.avail_out = (uInt)dstSize;
+
+        const int result = inflate(&stream, Z_FINISH);
+        const size_t written = stream.total_out;
+        inflateEnd(&stream);
+
+        return result == Z_STREAM_END && written == dstSize;
+    }
+
+    bool canEncode() const override { return true; }
+
+    size_t encode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) const override
+    {
+        z_stream stream = {};
+        if (deflateInit2(&stream, 5, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            return 0;
+
+        stream.next_in   = (Bytef*)src;
+        stream.avail_in  = (uInt)srcSize;
+        stream.next_out  = dst;
+        stream.avail_out = (uInt)dstCapacity;
+
+        const int result = deflate(&stream, Z_FINISH);
+        const size_t written = stream.total_out;
+        deflateEnd(&stream);
+
+        return result == Z_STREAM_END ? written : 0;
+    }
+};
+#endif // AAPL_HAS_ZLIB
+
+#if AAPL_HAS_LZFSE
+// The reference LZFSE library, compatible with COMPRESSION_LZFSE.
+class LZFSECodec : public AAPLCompressionCodec
+{
+public:
+    uint32_t    mode() const override { return AAPLCompressionModeLZFSE; }
+    const char* name() const override { return "lzfse"; }
+
+    bool decode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) const override
+    {
+        std::vector<uint8_t> scratch(lzfse_decode_scratch_size());
+        return lzfse_decode_buffer(dst, dstSize, src, srcSize, scratch.data()) == dstSize;
+    }
+
+    bool canEncode() const override { return true; }
+
+    size_t encode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) const override
+    {
+        std::vector<uint8_t> scratch(lzfse_encode_scratch_size());
+        return lzfse_encode_buffer(dst, dstCapacity, src, srcSize, scratch.data());
+    }
+};
+#endif // AAPL_HAS_LZFSE
+
+#endif // !defined(__APPLE__)
+
+#if AAPL_HAS_ZSTD
+class ZstdCodec : public AAPLCompressionCodec
+{
+public:
+    uint32_t    mode() const override { return AAPLCompressionModeZSTD; }
+    const char* name() const override { return "zstd"; }
+
+    bool decode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) const override
+    {
+        const size_t size = ZSTD_decompress(dst, dstSize, src, srcSize);
+        return !ZSTD_isError(size) && size == dstSize;
+    }
+
+    bool canEncode() const override { return true; }
+
+    size_t encode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) const override
+    {
+        const size_t size = ZSTD_compress(dst, dstCapacity, src, srcSize, 3);
+        return ZSTD_isError(size) ? 0 : size;
+    }
+};
+#endif // AAPL_HAS_ZSTD
+
+// Codecs indexed by mode, filled with the built-in codecs on first use.
+struct CodecRegistry
+{
+    CodecRegistry()
+    {
+        static NoneCodec none;
+        codecs.push_back(&none);
+
+#if defined(__APPLE__)
+        static LibCompressionCodec lz4(COMPRESSION_LZ4, "lz4");
+        static LibCompressionCodec lz4Raw(COMPRESSION_LZ4_RAW, "lz4-raw");
+        static LibCompressionCodec zlib(COMPRESSION_ZLIB, "zlib");
+        static LibCompressionCodec lzma(COMPRESSION_LZMA, "lzma");
+        static LibCompressionCodec lzfse(COMPRESSION_LZFSE, "lzfse");
+        codecs.insert(codecs.end(), { &lz4, &lz4Raw, &zlib, &lzma, &lzfse });
+#else
+        static LZ4Codec lz4;
+        static LZ4RawCodec lz4Raw;
+        codecs.insert(codecs.end(), { &lz4, &lz4Raw });
+#if AAPL_HAS_ZLIB
+        static ZlibCodec zlib;
+        codecs.push_back(&zlib);
+#endif
+#if AAPL_HAS_LZFSE
+        static LZFSECodec lzfse;
+        codecs.push_back(&lzfse);
+#endif
+#endif // !defined(__APPLE__)
+
+#if AAPL_HAS_ZSTD
+        static ZstdCodec zstd;
+        codecs.push_back(&zstd);
+#endif
+    }
+
+    std::mutex                                  mutex;
+    std::vector<const AAPLCompressionCodec*>    codecs;
+};
+
+CodecRegistry& registry()
+{
+    static CodecRegistry registry;
+    return registry;
+}
+
+// Reports, once per mode, a block that this platform can't uncompress.  Returns false.
+bool reportMissingCodec(uint32_t mode)
+{
+    static std::mutex mutex;
+    static std::vector<uint32_t> reported;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::find(reported.begin(), reported.end(), mode) == reported.end())
+    {
+        reported.push_back(mode);
+        fprintf(stderr, "No codec for %s blocks (compression mode 0x%x) on this platform.%s\n",
+                AAPLCompressionModeName(mode), mode,
+                mode == AAPLCompressionModeLZFSE ? " Build with the LZFSE library, or re-encode the file with another codec." : "");
+    }
+    return false;
+}
+
+// A unit of decoding work: one plain block, or one sub-block of a chunked block.
+struct DecodeTask
+{
+    const AAPLCompressionCodec* codec;
+    const uint8_t*              src;
+    size_t                      srcSize;
+    uint8_t*                    dst;
+    size_t                      dstSize;
+};
+
+// Splits a request into tasks.  Returns false if the request is malformed or its codec is
+//  not available.
+bool appendDecodeTasks(const AAPLDecompressRequest& request, std::vector<DecodeTask>& tasks)
+{
+    const AAPLCompressionHeader& header = request.header;
+    const uint8_t* src = (const uint8_t*)request.src;
+    uint8_t* dst = (uint8_t*)request.dst;
+
+    if (header.compressionMode != AAPLCompressionModeChunked)
+    {
+        const AAPLCompressionCodec* codec = AAPLCompressionCodecForMode(header.compressionMode);
+        if (!codec)
+            return reportMissingCodec(header.compressionMode);
+        tasks.push_back({ codec, src, (size_t)header.compressedSize, dst, (size_t)header.uncompressedSize });
+        return true;
+    }
+
+    AAPLChunkedCompressionHeader chunked;
+    if (header.compressedSize < sizeof(chunked))
+        return false;
+    memcpy(&chunked, src, sizeof(chunked));
+
+    if (chunked.blockSize == 0 || chunked.codec == AAPLCompressionModeChunked)
+        return false;
+
+    const uint64_t blockCount = (header.uncompressedSize + chunked.blockSize - 1) / chunked.blockSize;
+    const uint64_t tableSize = (blockCount + 1) * sizeof(uint64_t);
+    if (chunked.blockCount != blockCount || header.compressedSize - sizeof(chunked) < tableSize)
+        return false;
+
+    const uint8_t* table = src + sizeof(chunked);
+    const uint8_t* blocks = table + tableSize;
+    const uint64_t blocksSize = header.compressedSize - sizeof(chunked) - tableSize;
+
+    const AAPLCompressionCodec* codec = AAPLCompressionCodecForMode(chunked.codec);
+    const AAPLCompressionCodec* none = AAPLCompressionCodecForMode(AAPLCompressionModeNone);
+    if (!codec)
+        return reportMissingCodec(chunked.codec);
+
+    uint64_t begin;
+    memcpy(&begin, table, sizeof(begin));
+    if (begin != 0)
+        return false;
+
+    for (uint64_t i = 0; i < blockCount; ++i)
+    {
+        uint64_t end;
+        memcpy(&end, table + (i + 1) * sizeof(uint64_t), sizeof(end));
+        if (end < begin || end > blocksSize)
+            return false;
+
+        const uint64_t dstOffset = i * chunked.blockSize;
+        const size_t dstSize = (size_t)std::min<uint64_t>(chunked.blockSize, header.uncompressedSize - dstOffset);
+        const size_t srcSize = (size_t)(end - begin);
+
+        // Blocks that didn't shrink are stored as is.
+        tasks.push_back({ srcSize == dstSize ? none : codec, blocks + begin, srcSize, dst + dstOffset, dstSize });
+        begin = end;
+    }
+
+    return begin == blocksSize;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+void AAPLRegisterCompressionCodec(const AAPLCompressionCodec* codec)
+{
+    CodecRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    for (const AAPLCompressionCodec*& existing : r.codecs)
+    {
+        if (existing->mode() == codec->mode())
+        {
+            existing = codec;
+            return;
+        }
+    }
+    r.codecs.push_back(codec);
+}
+
+const AAPLCompressionCodec* AAPLCompressionCodecForMode(uint32_t mode)
+{
+    CodecRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    for (const AAPLCompressionCodec* codec : r.codecs)
+    {
+        if (codec->mode() == mode)
+            return codec;
+    }
+    return nullptr;
+}
+
+const char* AAPLCompressionModeName(uint32_t mode)
+{
+    switch (mode)
+    {
+        case AAPLCompressionModeNone:       return "none";
+        case AAPLCompressionModeLZ4:        return "lz4";
+        case AAPLCompressionModeLZ4Raw:     return "lz4-raw";
+        case AAPLCompressionModeZLIB:       return "zlib";
+        case AAPLCompressionModeLZMA:       return "lzma";
+        case AAPLCompressionModeLZFSE:      return "lzfse";
+        case AAPLCompressionModeZSTD:       return "zstd";
+        case AAPLCompressionModeChunked:    return "chunked";
+        default:                            return "unknown";
+    }
+}
+
+bool AAPLDecompressBlocks(const AAPLDecompressRequest* requests, size_t count, AAPLTaskPool* pool)
+{
+    std::vector<DecodeTask> tasks;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!appendDecodeTasks(requests[i], tasks))
+            return false;
+    }
+
+    // Once a block fails, skip the rest.
+    std::atomic<bool> success(true);
+
+    (pool ? *pool : AAPLTaskPool::shared()).parallelFor(tasks.size(), [&](size_t index, unsigned)
+    {
+        const DecodeTask& task = tasks[index];
+        if (success.load(std::memory_order_relaxed) && !task.codec->decode(task.src, task.srcSize, task.dst, task.dstSize))
+            success.store(false, std::memory_order_relaxed);
+    });
+
+    return success;
+}
+
+bool AAPLDecompressBlock(const AAPLCompressionHeader& header, const void* src, void* dst)
+{
+    const AAPLDecompressRequest request = { header, src, dst };
+    return AAPLDecompressBlocks(&request, 1);
+}
+
+bool AAPLCompressChunked(uint32_t codecMode, const void* src, size_t size, uint32_t blockSize,
+                         std::vector<uint8_t>& out, AAPLTaskPool* pool)
+{
+    const AAPLCompressionCodec* codec = AAPLCompressionCodecForMode(codecMode);
+    if (!codec || !codec->canEncode() || blockSize == 0 || codecMode == AAPLCompressionModeChunked)
+        return false;
+
+    const size_t blockCount = (size + blockSize - 1) / blockSize;
+    std::vector<std::vector<uint8_t>> blocks(blockCount);
+
+    (pool ? *pool : AAPLTaskPool::shared()).parallelFor(blockCount, [&](size_t index, unsigned)
+    {
+        const uint8_t* blockSrc = (const uint8_t*)src + index * blockSize;
+        const size_t blockSrcSize = std::min<size_t>(blockSize, size - index * blockSize);
+
+        // Keep the compressed block only if it is smaller than the uncompressed data.
+        std::vector<uint8_t>& block = blocks[index];
+        block.resize(blockSrcSize);
+        size_t compressedSize = blockSrcSize ? codec->encode(blockSrc, blockSrcSize, block.data(), blockSrcSize - 1) : 0;
+
+        if (compressedSize == 0)
+        {
+            memcpy(block.data(), blockSrc, blockSrcSize);
+            compressedSize = blockSrcSize;
+        }
+
+        block.resize(compressedSize);
+    });
+
+    AAPLChunkedCompressionHeader chunked = {};
+    chunked.codec       = codecMode;
+    chunked.blockSize   = blockSize;
+    chunked.blockCount  = (uint32_t)blockCount;
+
+    std::vector<uint64_t> offsets(blockCount + 1, 0);
+    for (size_t i = 0; i < blockCount; ++i)
+        offsets[i + 1] = offsets[i] + blocks[i].size();
+
+    AAPLCompressionHeader header = {};
+    header.compressionMode  = AAPLCompressionModeChunked;
+    header.uncompressedSize = size;
+    header.compressedSize   = sizeof(chunked) + offsets.size() * sizeof(uint64_t) + offsets.back();
+
+    out.resize(sizeof(header) + header.compressedSize);
+
+    uint8_t* dst = out.data();
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    memcpy(dst, &chunked, sizeof(chunked));
+    dst += sizeof(chunked);
+    memcpy(dst, offsets.data(), offsets.size() * sizeof(uint64_t));
+    dst += offsets.size() * sizeof(uint64_t);
+
+    for (const std::vector<uint8_t>& block : blocks)
+    {
+        memcpy(dst, block.data(), block.size());
+        dst += block.size();
+    }
+
+    return true;
+}
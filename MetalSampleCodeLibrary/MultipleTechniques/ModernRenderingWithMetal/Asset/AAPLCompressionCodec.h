@@ -0,0 +1,108 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the compression codecs used by compressed blocks in mesh files, and for the
+ chunked block layout which uncompresses in parallel.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+class AAPLTaskPool;
+
+// Header for compressed blocks.
+struct AAPLCompressionHeader
+{
+    uint32_t compressionMode;       // Compression mode in block - of type compression_algorithm.
+    uint64_t uncompressedSize;      // Size of uncompressed data.
+    uint64_t compressedSize;        // Size of compressed data.
+};
+
+// Compression modes.  Values below 0x1000 match compression_algorithm; the others are
+//  not libcompression algorithms and are decoded by this sample.
+enum AAPLCompressionMode : uint32_t
+{
+    AAPLCompressionModeNone     = 0x000,    // Block stored without compression.
+    AAPLCompressionModeLZ4      = 0x100,
+    AAPLCompressionModeLZ4Raw   = 0x101,
+    AAPLCompressionModeZLIB     = 0x205,
+    AAPLCompressionModeLZMA     = 0x306,
+    AAPLCompressionModeLZFSE    = 0x801,
+    AAPLCompressionModeZSTD     = 0x1001,
+    AAPLCompressionModeChunked  = 0x1100,   // Seek table of independently compressed blocks.
+};
+
+// Follows the AAPLCompressionHeader of a block in `AAPLCompressionModeChunked` mode. The
+//  header is followed by `blockCount + 1` uint64_t offsets of each block relative to the
+//  end of the offset table.  Every block uncompresses to `blockSize` bytes, except the last.
+struct AAPLChunkedCompressionHeader
+{
+    uint32_t codec;                 // Compression mode of each block.
+    uint32_t blockSize;             // Uncompressed size of each block.
+    uint32_t blockCount;            // Number of blocks.
+    uint32_t reserved;
+};
+
+// Interface to a compression algorithm.  Codecs are looked up by compression mode, so an
+//  application can register its own codec for a mode to replace the built-in one.
+class AAPLCompressionCodec
+{
+public:
+    virtual ~AAPLCompressionCodec() {}
+
+    virtual uint32_t    mode() const = 0;
+    virtual const char* name() const = 0;
+
+    // Uncompresses `srcSize` bytes into exactly `dstSize` bytes.  Returns false on error.
+    virtual bool decode(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) const = 0;
+
+    // Codecs which can only decode on this platform return false.
+    virtual bool canEncode() const { return false; }
+
+    // Compresses into `dst`.  Returns the compressed size, or 0 if the data doesn't fit.
+    virtual size_t encode(const uint8_t* /*src*/, size_t /*srcSize*/, uint8_t* /*dst*/, size_t /*dstCapacity*/) const
+    {
+        return 0;
+    }
+};
+
+// Registers a codec, replacing any codec previously registered for the same mode.
+//  The codec must outlive all decompression calls.
+void AAPLRegisterCompressionCodec(const AAPLCompressionCodec* codec);
+
+// Returns the codec for a mode, or nullptr if no codec is available on this platform.
+const AAPLCompressionCodec* AAPLCompressionCodecForMode(uint32_t mode);
+
+// Returns the name of a compression mode, whether or not a codec is available for it.
+const char* AAPLCompressionModeName(uint32_t mode);
+
+// A block to uncompress: its header, the compressed payload following it, and the
+//  destination, which must hold `header.uncompressedSize` bytes.
+struct AAPLDecompressRequest
+{
+    AAPLCompressionHeader   header;
+    const void*             src;
+    void*                   dst;
+};
+
+// Uncompresses a set of blocks.  Chunked blocks are split into their sub-blocks, and all
+//  sub-blocks of all requests are spread across the threads of `pool`, or of the shared pool
+//  when null.  Returns false if any block fails.  A block whose compression mode has no codec
+//  on this platform, such as LZFSE on a platform without the LZFSE library, fails and reports
+//  the missing codec on stderr.
+bool AAPLDecompressBlocks(const AAPLDecompressRequest* requests, size_t count, AAPLTaskPool* pool = nullptr);
+
+// Uncompresses a block described by `header` from `src` into `dst`, which must be able to hold
+//  `header.uncompressedSize` bytes.  Returns false if the block is corrupt or if its
+//  compression mode is not available on this platform.
+bool AAPLDecompressBlock(const AAPLCompressionHeader& header, const void* src, void* dst);
+
+// Compresses `src` into `out` as an AAPLCompressionHeader followed by a chunked payload
+//  with blocks of `blockSize` bytes each compressed by `codec`.  Blocks that don't shrink
+//  are stored uncompressed.  Returns false if `codec` can't encode on this platform.
+bool AAPLCompressChunked(uint32_t codec, const void* src, size_t size, uint32_t blockSize,
+                         std::vector<uint8_t>& out, AAPLTaskPool* pool = nullptr);
@@ -0,0 +1,910 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the offline builder of mesh chunks.
+*/
+#include "AAPLMeshChunkBuilder.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#if defined(__APPLE__)
+#include "AAPLMeshTypes.h"
+#endif
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+#if defined(__APPLE__)
+static_assert(sizeof(AAPLMeshFileChunk) == sizeof(AAPLMeshChunk)
+              && offsetof(AAPLMeshFileChunk, boundingSphere) == offsetof(AAPLMeshChunk, boundingSphere)
+              && offsetof(AAPLMeshFileChunk, indexBegin) == offsetof(AAPLMeshChunk, indexBegin),
+              "AAPLMeshFileChunk doesn't match AAPLMeshChunk");
+static_assert(sizeof(AAPLMeshFileSubMesh) == sizeof(AAPLSubMesh)
+              && offsetof(AAPLMeshFileSubMesh, boundingSphere) == offsetof(AAPLSubMesh, boundingSphere)
+              && offsetof(AAPLMeshFileSubMesh, chunkStart) == offsetof(AAPLSubMesh, chunkStart),
+              "AAPLMeshFileSubMesh doesn't match AAPLSubMesh");
+#endif
+
+// Triangles of a submesh are clustered in spatially sorted blocks of this size, one
+//  block per task.
+static const size_t BlockTriangles = 65536;
+
+// Number of unused triangles, in spatial order, considered to continue a chunk that has
+//  no unused neighbors left.
+static const size_t SeedWindow = 32;
+
+struct Float3
+{
+    float x, y, z;
+};
+
+inline Float3 operator+(Float3 a, Float3 b)     { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Float3 operator-(Float3 a, Float3 b)     { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Float3 operator*(Float3 a, float s)      { return { a.x * s, a.y * s, a.z * s }; }
+inline float  dot(Float3 a, Float3 b)           { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float  length(Float3 a)                  { return sqrtf(dot(a, a)); }
+inline Float3 min(Float3 a, Float3 b)           { return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) }; }
+inline Float3 max(Float3 a, Float3 b)           { return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) }; }
+
+inline Float3 cross(Float3 a, Float3 b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+inline Float3 normalize(Float3 a)
+{
+    const float l = length(a);
+    return l > 0.0f ? a * (1.0f / l) : Float3{ 0.0f, 0.0f, 0.0f };
+}
+
+// Runs `task` for every index in [0, count) on up to `threadCount` threads.
+void parallelFor(size_t count, unsigned threadCount, const std::function<void(size_t)>& task)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = (unsigned)std::min<size_t>(threadCount, count);
+
+    std::atomic<size_t> next(0);
+    const auto worker = [&]()
+    {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+            task(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < threadCount; ++t)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+// Spreads the lower 10 bits of `v` to every third bit.
+inline uint32_t spreadBits(uint32_t v)
+{
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v <<  8)) & 0x0300F00F;
+    v = (v | (v <<  4)) & 0x030C30C3;
+    v = (v | (v <<  2)) & 0x09249249;
+    return v;
+}
+
+// Number of vertex shader invocations with a FIFO post-transform cache of `cacheSize` entries.
+size_t countCacheMisses(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    // A vertex is cached while fewer than `cacheSize` misses happened since its own.
+    std::vector<uint64_t> missedAt(vertexCount, 0);
+    uint64_t misses = 0;
+
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint64_t& at = missedAt[indices[i]];
+        if (at == 0 || misses + 1 - at > cacheSize)
+            at = ++misses;
+    }
+
+    return (size_t)misses;
+}
+
+//------------------------------------------------------------------------------
+
+struct Submesh
+{
+    const AAPLMeshBuilderSubmesh*   input;
+    std::vector<uint32_t>           triangles;      // Non degenerate triangles in spatial order.
+};
+
+struct Block
+{
+    const Submesh*  submesh;
+    size_t          first;
+    size_t          count;
+};
+
+// Chunks of a block, with indices relative to the block.
+struct BlockResult
+{
+    std::vector<uint32_t>       indices;
+    std::vector<AAPLMeshFileChunk>    chunks;
+    std::vector<uint32_t>       chunkVertexCounts;
+};
+
+class BlockBuilder
+{
+public:
+    BlockBuilder(const AAPLMeshBuilderInput& input, const AAPLMeshChunkBuilderConfig& config)
+        : _input(input)
+        , _config(config)
+    {
+    }
+
+    void build(const Block& block, BlockResult& result);
+
+private:
+    Float3 position(uint32_t vertex) const
+    {
+        const float* p = _input.positions + (size_t)vertex * 3;
+        return { p[0], p[1], p[2] };
+    }
+
+    // Number of vertices of a triangle that the current chunk doesn't have yet.
+    uint32_t newVertexCount(uint32_t triangle) const
+    {
+        uint32_t count = 0;
+        for (int k = 0; k < 3; ++k)
+            count += _vertexStamp[_localIndices[triangle * 3 + k]] != _stamp;
+        return count;
+    }
+
+    float score(uint32_t triangle, Float3 center, Float3 axis) const
+    {
+        const float distance    = length(_centroids[triangle] - center) / _expectedRadius;
+        const float deviation   = 1.0f - dot(_normals[triangle], axis);
+
+        return (1.0f - _config.coneWeight) * distance + _config.coneWeight * deviation;
+    }
+
+    void add(uint32_t triangle);
+    void emit(uint32_t materialIndex, BlockResult& result);
+    void optimizeChunkForCache();
+
+    const AAPLMeshBuilderInput&         _input;
+    const AAPLMeshChunkBuilderConfig&   _config;
+
+    // Triangles of the block.
+    std::vector<uint32_t>   _localIndices;      // Indices into `_vertices`.
+    std::vector<Float3>     _centroids;
+    std::vector<Float3>     _normals;           // Unit face normals, or 0 for degenerate triangles.
+    std::vector<bool>       _used;
+    std::vector<uint32_t>   _candidateStamp;
+    float                   _expectedRadius = 1.0f;
+
+    // Unique vertices of the block and the triangles using them.
+    std::vector<uint32_t>   _vertices;
+    std::vector<uint32_t>   _adjacencyOffsets;
+    std::vector<uint32_t>   _adjacency;
+    std::vector<uint32_t>   _vertexStamp;
+    std::vector<uint32_t>   _vertexSlot;        // Index of the vertex in the current chunk.
+
+    // Current chunk.
+    uint32_t                _stamp = 0;
+    std::vector<uint32_t>   _chunkVertices;
+    std::vector<uint32_t>   _chunkTriangles;
+    std::vector<uint32_t>   _candidates;
+    Float3                  _centroidSum;
+    Float3                  _normalSum;
+};
+
+void BlockBuilder::build(const Block& block, BlockResult& result)
+{
+    const uint32_t* indices = block.submesh->input->indices;
+    const uint32_t triangleCount = (uint32_t)block.count;
+
+    // Local vertex numbering and the triangles around each vertex.
+    _vertices.resize(triangleCount * 3);
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32_t triangle = block.submesh->triangles[block.first + t];
+        for (int k = 0; k < 3; ++k)
+            _vertices[t * 3 + k] = indices[triangle * 3 + k];
+    }
+
+    std::sort(_vertices.begin(), _vertices.end());
+    _vertices.erase(std::unique(_vertices.begin(), _vertices.end()), _vertices.end());
+
+    _localIndices.resize(triangleCount * 3);
+    _centroids.resize(triangleCount);
+    _normals.resize(triangleCount);
+
+    _adjacencyOffsets.assign(_vertices.size() + 1, 0);
+
+    double area = 0.0;
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32_t triangle = block.submesh->triangles[block.first + t];
+
+        Float3 p[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint32_t vertex = indices[triangle * 3 + k];
+            const uint32_t local = (uint32_t)(std::lower_bound(_vertices.begin(), _vertices.end(), vertex) - _vertices.begin());
+
+            _localIndices[t * 3 + k] = local;
+            ++_adjacencyOffsets[local + 1];
+
+            p[k] = position(vertex);
+        }
+
+        const Float3 n = cross(p[1] - p[0], p[2] - p[0]);
+
+        _centroids[t]   = (p[0] + p[1] + p[2]) * (1.0f / 3.0f);
+        _normals[t]     = normalize(n);
+        area           += 0.5 * length(n);
+    }
+
+    for (size_t v = 0; v < _vertices.size(); ++v)
+        _adjacencyOffsets[v + 1] += _adjacencyOffsets[v];
+
+    _adjacency.resize(triangleCount * 3);
+    std::vector<uint32_t> fill(_adjacencyOffsets.begin(), _adjacencyOffsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            _adjacency[fill[_localIndices[t * 3 + k]]++] = t;
+
+    // Radius of a disc with the area of a full chunk, which scales distances in the score.
+    _expectedRadius = (float)sqrt(area / triangleCount * _config.maxTriangles / M_PI);
+    if (!(_expectedRadius > 0.0f))
+        _expectedRadius = 1.0f;
+
+    _used.assign(triangleCount, false);
+    _candidateStamp.assign(triangleCount, 0);
+    _vertexStamp.assign(_vertices.size(), 0);
+    _vertexSlot.assign(_vertices.size(), 0);
+    _stamp = 0;
+
+    const uint32_t materialIndex = block.submesh->input->materialIndex;
+
+    uint32_t seed = 0;
+    for (;;)
+    {
+        while (seed < triangleCount && _used[seed])
+            ++seed;
+
+        if (seed == triangleCount)
+            break;
+
+        ++_stamp;
+        _chunkVertices.clear();
+        _chunkTriangles.clear();
+        _candidates.clear();
+        _centroidSum    = { 0.0f, 0.0f, 0.0f };
+        _normalSum      = { 0.0f, 0.0f, 0.0f };
+
+        add(seed);
+
+        while (_chunkTriangles.size() < _config.maxTriangles)
+        {
+            const Float3 center = _centroidSum * (1.0f / _chunkTriangles.size());
+            const Float3 axis   = normalize(_normalSum);
+
+            // Prefer triangles adding the fewest vertices, then the closest and best aligned.
+            uint32_t best           = UINT32_MAX;
+            uint32_t bestNewCount   = UINT32_MAX;
+            float    bestScore      = FLT_MAX;
+
+            const auto consider = [&](uint32_t triangle, uint32_t newCount)
+            {
+                if (newCount > bestNewCount)
+                    return;
+
+                const float s = score(triangle, center, axis);
+                if (newCount < bestNewCount || s < bestScore)
+                {
+                    best            = triangle;
+                    bestNewCount    = newCount;
+                    bestScore       = s;
+                }
+            };
+
+            // Triangles which are used or no longer fit never become candidates again.
+            size_t kept = 0;
+            for (uint32_t triangle : _candidates)
+            {
+                if (_used[triangle])
+                    continue;
+
+                const uint32_t newCount = newVertexCount(triangle);
+                if (_chunkVertices.size() + newCount > _config.maxVertices)
+                    continue;
+
+                _candidates[kept++] = triangle;
+                consider(triangle, newCount);
+            }
+            _candidates.resize(kept);
+
+            // Continue disconnected geometry with nearby triangles in spatial order.
+            if (best == UINT32_MAX)
+            {
+                while (seed < triangleCount && _used[seed])
+                    ++seed;
+
+                size_t considered = 0;
+                for (uint32_t triangle = seed; triangle < triangleCount && considered < SeedWindow; ++triangle)
+                {
+                    if (_used[triangle])
+                        continue;
+
+                    ++considered;
+
+                    const uint32_t newCount = newVertexCount(triangle);
+                    if (_chunkVertices.size() + newCount <= _config.maxVertices)
+                        consider(triangle, newCount);
+                }
+            }
+
+            if (best == UINT32_MAX)
+                break;
+
+            add(best);
+        }
+
+        emit(materialIndex, result);
+    }
+}
+
+void BlockBuilder::add(uint32_t triangle)
+{
+    _used[triangle] = true;
+    _chunkTriangles.push_back(triangle);
+
+    _centroidSum    = _centroidSum + _centroids[triangle];
+    _normalSum      = _normalSum + _normals[triangle];
+
+    for (int k = 0; k < 3; ++k)
+    {
+        const uint32_t vertex = _localIndices[triangle * 3 + k];
+        if (_vertexStamp[vertex] == _stamp)
+            continue;
+
+        _vertexStamp[vertex] = _stamp;
+        _vertexSlot[vertex]  = (uint32_t)_chunkVertices.size();
+        _chunkVertices.push_back(vertex);
+
+        // The neighbors of vertices already in the chunk are candidates already.
+        for (uint32_t i = _adjacencyOffsets[vertex]; i < _adjacencyOffsets[vertex + 1]; ++i)
+        {
+            const uint32_t neighbor = _adjacency[i];
+            if (!_used[neighbor] && _candidateStamp[neighbor] != _stamp)
+            {
+                _candidateStamp[neighbor] = _stamp;
+                _candidates.push_back(neighbor);
+            }
+        }
+    }
+}
+
+// Reorders the triangles of the current chunk for the post-transform cache, with the
+//  vertex scores of Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+void BlockBuilder::optimizeChunkForCache()
+{
+    const uint32_t cacheSize     = std::max(_config.cacheSize, 4u);
+    const size_t   vertexCount   = _chunkVertices.size();
+    const size_t   triangleCount = _chunkTriangles.size();
+
+    // Scores by position in the LRU cache, where position `cacheSize` is out of the cache,
+    //  and by number of triangles left.  The last triangle's vertices get a fixed score so
+    //  that strips aren't favored.
+    std::vector<float> cacheScores(cacheSize + 1, 0.0f);
+    for (uint32_t i = 0; i < cacheSize; ++i)
+        cacheScores[i] = i < 3 ? 0.75f : powf(1.0f - (i - 3) / (float)(cacheSize - 3), 1.5f);
+
+    std::vector<float> valenceScores(triangleCount + 1, 0.0f);
+    for (size_t i = 1; i <= triangleCount; ++i)
+        valenceScores[i] = 2.0f / sqrtf((float)i);
+
+    std::vector<uint32_t> corners(triangleCount * 3);
+    std::vector<uint32_t> valence(vertexCount, 0);
+    std::vector<uint32_t> cachePosition(vertexCount, cacheSize);
+    std::vector<float>    vertexScore(vertexCount);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> touched;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> remaining(triangleCount);
+
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        remaining[t] = (uint32_t)t;
+        for (int k = 0; k < 3; ++k)
+        {
+            corners[t * 3 + k] = _vertexSlot[_localIndices[_chunkTriangles[t] * 3 + k]];
+            ++valence[corners[t * 3 + k]];
+        }
+    }
+
+    const auto score = [&](uint32_t v)
+    {
+        return valence[v] ? cacheScores[cachePosition[v]] + valenceScores[valence[v]] : -1.0f;
+    };
+
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = score((uint32_t)v);
+
+    while (!remaining.empty())
+    {
+        size_t bestIndex = 0;
+        float  bestScore = -FLT_MAX;
+
+        for (size_t i = 0; i < remaining.size(); ++i)
+        {
+            const uint32_t* c = &corners[remaining[i] * 3];
+            const float s = vertexScore[c[0]] + vertexScore[c[1]] + vertexScore[c[2]];
+            if (s > bestScore)
+            {
+                bestIndex   = i;
+                bestScore   = s;
+            }
+        }
+
+        const uint32_t best = remaining[bestIndex];
+        remaining[bestIndex] = remaining.back();
+        remaining.pop_back();
+
+        order.push_back(_chunkTriangles[best]);
+
+        // Move the triangle's vertices to the front of the cache.  Only the scores of the
+        //  vertices in the cache before or after change.
+        touched = cache;
+        for (int k = 2; k >= 0; --k)
+        {
+            const uint32_t v = corners[best * 3 + k];
+            --valence[v];
+
+            cache.erase(std::remove(cache.begin(), cache.end(), v), cache.end());
+            cache.insert(cache.begin(), v);
+            touched.push_back(v);
+        }
+
+        for (uint32_t v : touched)
+            cachePosition[v] = cacheSize;
+        if (cache.size() > cacheSize)
+            cache.resize(cacheSize);
+        for (size_t i = 0; i < cache.size(); ++i)
+            cachePosition[cache[i]] = (uint32_t)i;
+
+        for (uint32_t v : touched)
+            vertexScore[v] = score(v);
+    }
+
+    _chunkTriangles = order;
+}
+
+void BlockBuilder::emit(uint32_t materialIndex, BlockResult& result)
+{
+    optimizeChunkForCache();
+
+    AAPLMeshFileChunk chunk = {};
+    chunk.materialIndex = materialIndex;
+    chunk.indexBegin    = (uint32_t)result.indices.size();
+    chunk.indexCount    = (uint32_t)_chunkTriangles.size() * 3;
+
+    for (uint32_t triangle : _chunkTriangles)
+        for (int k = 0; k < 3; ++k)
+            result.indices.push_back(_vertices[_localIndices[triangle * 3 + k]]);
+
+    // Bounding box and mean of the vertices.
+    Float3 boxMin = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+    Float3 boxMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    Float3 mean   = { 0.0f, 0.0f, 0.0f };
+
+    for (uint32_t vertex : _chunkVertices)
+    {
+        const Float3 p = position(_vertices[vertex]);
+        boxMin  = min(boxMin, p);
+        boxMax  = max(boxMax, p);
+        mean    = mean + p;
+    }
+    mean = mean * (1.0f / _chunkVertices.size());
+
+    // Bounding sphere: Ritter's sphere grown from the two most distant extreme points, or
+    //  the sphere around the box center if smaller.
+    const auto farthest = [&](Float3 from)
+    {
+        Float3 result = from;
+        float distance = -1.0f;
+        for (uint32_t vertex : _chunkVertices)
+        {
+            const Float3 p = position(_vertices[vertex]);
+            const float d = dot(p - from, p - from);
+            if (d > distance)
+            {
+                distance    = d;
+                result      = p;
+            }
+        }
+        return result;
+    };
+
+    const Float3 a = farthest(position(_vertices[_chunkVertices[0]]));
+    const Float3 b = farthest(a);
+
+    Float3 center = (a + b) * 0.5f;
+    float  radius = length(b - a) * 0.5f;
+
+    for (uint32_t vertex : _chunkVertices)
+    {
+        const Float3 p = position(_vertices[vertex]);
+        const float d = length(p - center);
+        if (d > radius)
+        {
+            const float grownRadius = (radius + d) * 0.5f;
+            center = center + (p - center) * ((grownRadius - radius) / d);
+            radius = grownRadius;
+        }
+    }
+
+    const Float3 boxCenter = (boxMin + boxMax) * 0.5f;
+    float boxRadius = 0.0f;
+    for (uint32_t vertex : _chunkVertices)
+    {
+        const Float3 p = position(_vertices[vertex]);
+        boxRadius = std::max(boxRadius, length(p - boxCenter));
+        radius    = std::max(radius, length(p - center));   // Covers rounding in the growth above.
+    }
+
+    if (boxRadius < radius)
+    {
+        center = boxCenter;
+        radius = boxRadius;
+    }
+
+    // Normal cone around the average face normal.  Degenerate triangles have no normal.
+    const Float3 axis = normalize(_normalSum);
+    float cosAngle = 1.0f;
+    if (dot(axis, axis) > 0.0f)
+    {
+        for (uint32_t triangle : _chunkTriangles)
+        {
+            if (dot(_normals[triangle], _normals[triangle]) > 0.0f)
+                cosAngle = std::min(cosAngle, dot(_normals[triangle], axis));
+        }
+    }
+    else
+    {
+        cosAngle = -1.0f;
+    }
+
+    const float boxValues[2][3] = { { boxMin.x, boxMin.y, boxMin.z }, { boxMax.x, boxMax.y, boxMax.z } };
+    memcpy(chunk.boxMin, boxValues[0], sizeof(boxValues[0]));
+    memcpy(chunk.boxMax, boxValues[1], sizeof(boxValues[1]));
+
+    chunk.normalDistribution[0] = axis.x;
+    chunk.normalDistribution[1] = axis.y;
+    chunk.normalDistribution[2] = axis.z;
+    chunk.normalDistribution[3] = std::max(-1.0f, std::min(cosAngle, 1.0f));
+
+    chunk.clusterMean[0]    = mean.x;
+    chunk.clusterMean[1]    = mean.y;
+    chunk.clusterMean[2]    = mean.z;
+
+    chunk.boundingSphere[0] = center.x;
+    chunk.boundingSphere[1] = center.y;
+    chunk.boundingSphere[2] = center.z;
+    chunk.boundingSphere[3] = radius;
+
+    result.chunks.push_back(chunk);
+    result.chunkVertexCounts.push_back((uint32_t)_chunkVertices.size());
+}
+
+template <typename T>
+void appendBytes(std::vector<uint8_t>& out, const T* data, size_t count)
+{
+    const size_t offset = out.size();
+    out.resize(offset + count * sizeof(T));
+    if (count)
+        memcpy(out.data() + offset, data, count * sizeof(T));
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+bool AAPLBuildMeshChunks(const AAPLMeshBuilderInput& input, const AAPLMeshChunkBuilderConfig& config,
+                         AAPLMeshFileContents& contents, AAPLMeshChunkBuilderStats* stats)
+{
+    if (!input.positions || input.vertexCount > UINT32_MAX || config.maxVertices < 3 || config.maxTriangles == 0)
+        return false;
+
+    if (input.materialCount && (!input.materialData || input.materialSize == 0))
+        return false;
+
+    for (const AAPLMeshBuilderSubmesh& submesh : input.submeshes)
+    {
+        if (submesh.indexCount % 3 != 0 || (submesh.indexCount && !submesh.indices))
+            return false;
+
+        if (input.materialCount && submesh.materialIndex >= input.materialCount)
+            return false;
+
+        for (size_t i = 0; i < submesh.indexCount; ++i)
+        {
+            if (submesh.indices[i] >= input.vertexCount)
+                return false;
+        }
+    }
+
+    // Opaque submeshes first, then alpha masked and transparent ones, as AAPLMeshRenderer
+    //  draws them from consecutive ranges.
+    std::vector<Submesh> submeshes(input.submeshes.size());
+    for (size_t i = 0; i < submeshes.size(); ++i)
+        submeshes[i].input = &input.submeshes[i];
+
+    std::stable_sort(submeshes.begin(), submeshes.end(), [](const Submesh& a, const Submesh& b)
+    {
+        return a.input->blendMode < b.input->blendMode;
+    });
+
+    // Sort the triangles of each submesh along a Morton curve through their centroids, so
+    //  that blocks and chunk seeds are spatially coherent.
+    std::vector<Block> blocks;
+    for (Submesh& submesh : submeshes)
+    {
+        const uint32_t* indices = submesh.input->indices;
+        const size_t triangleCount = submesh.input->indexCount / 3;
+
+        std::vector<float> centroids(triangleCount * 3);
+        parallelFor((triangleCount + BlockTriangles - 1) / BlockTriangles, config.threadCount, [&](size_t range)
+        {
+            const size_t end = std::min(triangleCount, (range + 1) * BlockTriangles);
+            for (size_t t = range * BlockTriangles; t < end; ++t)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    centroids[t * 3 + c] = (input.positions[(size_t)indices[t * 3 + 0] * 3 + c]
+                                          + input.positions[(size_t)indices[t * 3 + 1] * 3 + c]
+                                          + input.positions[(size_t)indices[t * 3 + 2] * 3 + c]) * (1.0f / 3.0f);
+                }
+            }
+        });
+
+        float boundsMin[3] = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+        float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                boundsMin[c] = std::min(boundsMin[c], centroids[t * 3 + c]);
+                boundsMax[c] = std::max(boundsMax[c], centroids[t * 3 + c]);
+            }
+        }
+
+        float scale = 0.0f;
+        for (int c = 0; c < 3; ++c)
+            scale = std::max(scale, boundsMax[c] - boundsMin[c]);
+        scale = scale > 0.0f ? 1023.0f / scale : 0.0f;
+
+        std::vector<uint64_t> keys;
+        keys.reserve(triangleCount);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            const uint32_t* tri = indices + t * 3;
+            if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+                continue;
+
+            uint32_t code = 0;
+            for (int c = 0; c < 3; ++c)
+                code |= spreadBits((uint32_t)((centroids[t * 3 + c] - boundsMin[c]) * scale)) << c;
+
+            keys.push_back(((uint64_t)code << 32) | t);
+        }
+
+        std::sort(keys.begin(), keys.end());
+
+        submesh.triangles.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i)
+            submesh.triangles[i] = (uint32_t)keys[i];
+
+        const size_t blockCount = (keys.size() + BlockTriangles - 1) / BlockTriangles;
+        for (size_t b = 0; b < blockCount; ++b)
+        {
+            const size_t first = keys.size() * b / blockCount;
+            const size_t end   = keys.size() * (b + 1) / blockCount;
+            blocks.push_back({ &submesh, first, end - first });
+        }
+    }
+
+    std::vector<BlockResult> results(blocks.size());
+    parallelFor(blocks.size(), config.threadCount, [&](size_t b)
+    {
+        BlockBuilder builder(input, config);
+        builder.build(blocks[b], results[b]);
+    });
+
+    // Concatenate the blocks, submesh by submesh.
+    std::vector<uint32_t>       indices;
+    std::vector<AAPLMeshFileChunk>    chunks;
+    std::vector<AAPLMeshFileSubMesh>  meshes;
+
+    contents = AAPLMeshFileContents();
+
+    size_t block = 0;
+    for (const Submesh& submesh : submeshes)
+    {
+        AAPLMeshFileSubMesh mesh = {};
+        mesh.materialIndex  = submesh.input->materialIndex;
+        mesh.indexBegin     = (uint32_t)indices.size();
+        mesh.chunkStart     = (uint32_t)chunks.size();
+
+        Float3 boxMin = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+        Float3 boxMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        for (; block < blocks.size() && blocks[block].submesh == &submesh; ++block)
+        {
+            const BlockResult& result = results[block];
+            const uint32_t indexOffset = (uint32_t)indices.size();
+
+            indices.insert(indices.end(), result.indices.begin(), result.indices.end());
+
+            for (AAPLMeshFileChunk chunk : result.chunks)
+            {
+                chunk.indexBegin += indexOffset;
+                chunks.push_back(chunk);
+
+                boxMin = min(boxMin, { chunk.boxMin[0], chunk.boxMin[1], chunk.boxMin[2] });
+                boxMax = max(boxMax, { chunk.boxMax[0], chunk.boxMax[1], chunk.boxMax[2] });
+            }
+        }
+
+        mesh.indexCount = (uint32_t)indices.size() - mesh.indexBegin;
+        mesh.chunkCount = (uint32_t)chunks.size() - mesh.chunkStart;
+
+        if (mesh.chunkCount == 0)
+            continue;
+
+        const Float3 center = (boxMin + boxMax) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t c = mesh.chunkStart; c < mesh.chunkStart + mesh.chunkCount; ++c)
+        {
+            const float* sphere = chunks[c].boundingSphere;
+            radius = std::max(radius, length(Float3{ sphere[0], sphere[1], sphere[2] } - center) + sphere[3]);
+        }
+
+        const float values[3][4] =
+        {
+            { boxMin.x, boxMin.y, boxMin.z, 0.0f },
+            { boxMax.x, boxMax.y, boxMax.z, 0.0f },
+            { center.x, center.y, center.z, radius },
+        };
+        memcpy(mesh.boxMin, values[0], sizeof(values[0]));
+        memcpy(mesh.boxMax, values[1], sizeof(values[1]));
+        memcpy(mesh.boundingSphere, values[2], sizeof(values[2]));
+
+        meshes.push_back(mesh);
+
+        switch (submesh.input->blendMode)
+        {
+            case AAPLMeshBlendMode::Opaque:
+                contents.opaqueMeshCount++;
+                contents.opaqueChunkCount += mesh.chunkCount;
+                break;
+            case AAPLMeshBlendMode::AlphaMasked:
+                contents.alphaMaskedMeshCount++;
+                contents.alphaMaskedChunkCount += mesh.chunkCount;
+                break;
+            case AAPLMeshBlendMode::Transparent:
+                contents.transparentMeshCount++;
+                contents.transparentChunkCount += mesh.chunkCount;
+                break;
+        }
+    }
+
+    // Number vertices in order of first use, so that chunks fetch nearby vertices, and drop
+    //  unused ones.
+    std::vector<uint32_t> remap(input.vertexCount, UINT32_MAX);
+    std::vector<uint32_t> vertices;
+    vertices.reserve(input.vertexCount);
+
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = (uint32_t)vertices.size();
+            vertices.push_back(index);
+        }
+        index = remap[index];
+    }
+
+    const auto packStream = [&](const float* stream, size_t components, std::vector<uint8_t>& out)
+    {
+        out.assign(vertices.size() * components * sizeof(float), 0);
+        if (!stream)
+            return;
+
+        float* dst = (float*)out.data();
+        for (size_t v = 0; v < vertices.size(); ++v)
+            memcpy(dst + v * components, stream + (size_t)vertices[v] * components, components * sizeof(float));
+    };
+
+    packStream(input.positions, 3, contents.vertexData);
+    packStream(input.normals,   3, contents.normalData);
+    packStream(input.tangents,  3, contents.tangentData);
+    packStream(input.uvs,       2, contents.uvData);
+
+    appendBytes(contents.indexData, indices.data(), indices.size());
+    appendBytes(contents.chunkData, chunks.data(), chunks.size());
+    appendBytes(contents.meshData, meshes.data(), meshes.size());
+    appendBytes(contents.materialData, (const uint8_t*)input.materialData, input.materialCount * input.materialSize);
+
+    contents.vertexCount    = vertices.size();
+    contents.indexCount     = indices.size();
+    contents.indexType      = 1;    // MTLIndexTypeUInt32.
+    contents.chunkCount     = chunks.size();
+    contents.meshCount      = meshes.size();
+    contents.materialCount  = input.materialCount;
+
+    if (stats)
+    {
+        memset(stats, 0, sizeof(*stats));
+
+        stats->chunkCount       = chunks.size();
+        stats->triangleCount    = indices.size() / 3;
+
+        size_t cullable = 0;
+        for (size_t b = 0; b < results.size(); ++b)
+        {
+            for (size_t c = 0; c < results[b].chunks.size(); ++c)
+            {
+                const AAPLMeshFileChunk& chunk = results[b].chunks[c];
+
+                const double angle = acos(chunk.normalDistribution[3]) * 180.0 / M_PI;
+
+                const Float3 diagonal = Float3{ chunk.boxMax[0], chunk.boxMax[1], chunk.boxMax[2] }
+                                      - Float3{ chunk.boxMin[0], chunk.boxMin[1], chunk.boxMin[2] };
+                const float halfDiagonal = length(diagonal) * 0.5f;
+
+                stats->averageVertices          += results[b].chunkVertexCounts[c];
+                stats->averageTriangles         += chunk.indexCount / 3;
+                stats->averageConeAngle         += angle;
+                stats->maxConeAngle              = std::max(stats->maxConeAngle, angle);
+                stats->averageSphereTightness   += halfDiagonal > 0.0f ? chunk.boundingSphere[3] / halfDiagonal : 1.0;
+
+                cullable += chunk.normalDistribution[3] > 0.0f;
+            }
+        }
+
+        if (!chunks.empty())
+        {
+            const double count = (double)chunks.size();
+            stats->averageVertices          /= count;
+            stats->averageTriangles         /= count;
+            stats->averageConeAngle         /= count;
+            stats->averageSphereTightness   /= count;
+            stats->backfaceCullableRatio     = cullable / count;
+        }
+
+        size_t inputMisses = 0;
+        size_t inputTriangles = 0;
+        for (const AAPLMeshBuilderSubmesh& submesh : input.submeshes)
+        {
+            inputMisses     += countCacheMisses(submesh.indices, submesh.indexCount, input.vertexCount, config.cacheSize);
+            inputTriangles  += submesh.indexCount / 3;
+        }
+
+        stats->inputACMR    = inputTriangles ? (double)inputMisses / inputTriangles : 0.0;
+        stats->outputACMR   = indices.empty() ? 0.0
+                            : (double)countCacheMisses(indices.data(), indices.size(), vertices.size(), config.cacheSize) / (indices.size() / 3);
+    }
+
+    return true;
+}
@@ -0,0 +1,91 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the offline builder which partitions raw meshes into the chunks the renderer
+ culls, and produces the streams of a mesh file.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "AAPLMeshFile.h"
+
+// Decides which range of submeshes and chunks a submesh is drawn with.
+enum class AAPLMeshBlendMode : uint32_t
+{
+    Opaque,
+    AlphaMasked,
+    Transparent,
+};
+
+// A range of triangles drawn with one material.
+struct AAPLMeshBuilderSubmesh
+{
+    uint32_t            materialIndex   = 0;
+    AAPLMeshBlendMode   blendMode       = AAPLMeshBlendMode::Opaque;
+    const uint32_t*     indices         = nullptr;
+    size_t              indexCount      = 0;
+};
+
+// Raw mesh to build chunks for.  Vertex streams are tightly packed; all but positions
+//  are optional and written as zeros when missing.
+struct AAPLMeshBuilderInput
+{
+    const float*                        positions       = nullptr;  // xyz.
+    const float*                        normals         = nullptr;  // xyz.
+    const float*                        tangents        = nullptr;  // xyz.
+    const float*                        uvs             = nullptr;  // uv.
+    size_t                              vertexCount     = 0;
+
+    std::vector<AAPLMeshBuilderSubmesh> submeshes;
+
+    const void*                         materialData    = nullptr;  // AAPLMaterial array.
+    size_t                              materialCount   = 0;
+    size_t                              materialSize    = 0;        // Size of one AAPLMaterial.
+};
+
+struct AAPLMeshChunkBuilderConfig
+{
+    uint32_t    maxVertices     = 128;      // Unique vertices per chunk.
+    uint32_t    maxTriangles    = 128;      // Triangles per chunk.
+
+    // From 0 to 1: how much to favor tight normal cones, which cull back facing chunks,
+    //  over compact chunks, which cull against the frustum and the depth pyramid.
+    float       coneWeight      = 0.5f;
+
+    uint32_t    cacheSize       = 16;       // Entries of the post-transform cache to optimize for.
+    unsigned    threadCount     = 0;        // 0 for one thread per core.
+};
+
+// Quality of the chunks built.  Cone angles are half angles in degrees.
+struct AAPLMeshChunkBuilderStats
+{
+    size_t      chunkCount;
+    size_t      triangleCount;
+    double      averageVertices;            // Unique vertices per chunk.
+    double      averageTriangles;
+
+    double      averageConeAngle;
+    double      maxConeAngle;
+    double      backfaceCullableRatio;      // Ratio of chunks with cones narrower than 90 degrees.
+
+    // Bounding sphere radius relative to half the diagonal of the chunk's bounding box.
+    double      averageSphereTightness;
+
+    // Vertex shader invocations per triangle with a FIFO post-transform cache of the
+    //  configured size, for the input indices and for the built ones.
+    double      inputACMR;
+    double      outputACMR;
+};
+
+// Partitions the submeshes into chunks of coherent triangles with tight normal cones,
+//  reorders the triangles of each chunk for the post-transform cache and the vertices
+//  for fetch locality, and fills `contents` with the streams and counts of a mesh file.
+//  Large submeshes are split spatially and built on all cores.  `stats` may be null.
+//  Returns false if the input is malformed.
+bool AAPLBuildMeshChunks(const AAPLMeshBuilderInput& input, const AAPLMeshChunkBuilderConfig& config,
+                         AAPLMeshFileContents& contents, AAPLMeshChunkBuilderStats* stats);
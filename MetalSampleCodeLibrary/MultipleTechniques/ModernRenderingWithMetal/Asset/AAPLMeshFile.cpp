@@ -0,0 +1,880 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of a portable C++ reader and writer of the mesh file format.
+*/
+#include "AAPLMeshFile.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <map>
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+// Minimal reader for the binary property list ("bplist00") that NSKeyedArchiver produces.
+class BinaryPropertyList
+{
+public:
+    enum Type
+    {
+        TypeInvalid,
+        TypeBool,
+        TypeInteger,
+        TypeReal,
+        TypeData,
+        TypeString,
+        TypeUID,
+        TypeArray,
+        TypeDictionary,
+    };
+
+    // A decoded object; containers keep the position of their reference list.
+    struct Object
+    {
+        Type            type    = TypeInvalid;
+        uint64_t        integer = 0;
+        double          real    = 0;
+        const uint8_t*  bytes   = nullptr;
+        size_t          count   = 0;
+    };
+
+    bool init(const uint8_t* data, size_t size)
+    {
+        static const size_t trailerSize = 32;
+
+        if (size < 8 + trailerSize || memcmp(data, "bplist00", 8) != 0)
+            return false;
+
+        _data = data;
+        _size = size;
+
+        const uint8_t* trailer = data + size - trailerSize;
+        _offsetSize     = trailer[6];
+        _refSize        = trailer[7];
+        _objectCount    = readBigEndian(trailer + 8, 8);
+        _topObject      = readBigEndian(trailer + 16, 8);
+        _offsetTable    = readBigEndian(trailer + 24, 8);
+
+        if (_offsetSize == 0 || _offsetSize > 8 || _refSize == 0 || _refSize > 8)
+            return false;
+        if (_offsetTable > size - trailerSize || _objectCount > (size - trailerSize - _offsetTable) / _offsetSize)
+            return false;
+
+        return _topObject < _objectCount;
+    }
+
+    uint64_t topObject() const { return _topObject; }
+
+    Object object(uint64_t index) const
+    {
+        Object result;
+        if (index >= _objectCount)
+            return result;
+
+        const uint64_t offset = readBigEndian(_data + _offsetTable + index * _offsetSize, _offsetSize);
+        if (offset >= _offsetTable)
+            return result;
+
+        const uint8_t* p = _data + offset;
+        const uint8_t* end = _data + _offsetTable;
+        const uint8_t marker = *p++;
+        const uint8_t info = marker & 0xF;
+
+        // Reads the element count that follows the marker of variable length objects.
+        auto readCount = [&](size_t& count) -> bool
+        {
+            count = info;
+            if (info != 0xF)
+                return true;
+            if (p >= end || (*p & 0xF0) != 0x10)
+                return false;
+            const size_t intSize = 1u << (*p & 0xF);
+            if (intSize > 8 || (size_t)(end - p - 1) < intSize)
+                return false;
+            count = readBigEndian(p + 1, intSize);
+            p += 1 + intSize;
+            return true;
+        };
+
+        size_t count = 0;
+        switch (marker >> 4)
+        {
+            case 0x0:
+                if (marker == 0x08 || marker == 0x09)
+                {
+                    result.type = TypeBool;
+                    result.integer = (marker == 0x09);
+                }
+                break;
+            case 0x1:
+                if ((1u << info) <= 8 && (size_t)(end - p) >= (1u << info))
+                {
+                    result.type = TypeInteger;
+                    result.integer = readBigEndian(p, 1u << info);
+                }
+                break;
+            case 0x2:
+                if (info == 2 && end - p >= 4)
+                {
+                    uint32_t bits = (uint32_t)readBigEndian(p, 4);
+                    float value;
+                    memcpy(&value, &bits, 4);
+                    result.type = TypeReal;
+                    result.real = value;
+                }
+                else if (info == 3 && end - p >= 8)
+                {
+                    uint64_t bits = readBigEndian(p, 8);
+                    memcpy(&result.real, &bits, 8);
+                    result.type = TypeReal;
+                }
+                break;
+            case 0x4:
+            case 0x5:
+                if (readCount(count) && count <= (size_t)(end - p))
+                {
+                    result.type = (marker >> 4) == 0x4 ? TypeData : TypeString;
+                    result.bytes = p;
+                    result.count = count;
+                }
+                break;
+            case 0x8:
+                if ((size_t)(end - p) > info)
+                {
+                    result.type = TypeUID;
+                    result.integer = readBigEndian(p, info + 1);
+                }
+                break;
+            case 0xA:
+            case 0xD:
+            {
+                const size_t refsPerEntry = (marker >> 4) == 0xD ? 2 : 1;
+                if (readCount(count) && count * refsPerEntry <= (size_t)(end - p) / _refSize)
+                {
+                    result.type = (marker >> 4) == 0xD ? TypeDictionary : TypeArray;
+                    result.bytes = p;
+                    result.count = count;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        return result;
+    }
+
+    // Object index of element `i` of an array, or of key/value `i` of a dictionary.
+    uint64_t arrayElement(const Object& array, size_t i) const
+    {
+        return readBigEndian(array.bytes + i * _refSize, _refSize);
+    }
+
+    uint64_t dictionaryKey(const Object& dictionary, size_t i) const
+    {
+        return readBigEndian(dictionary.bytes + i * _refSize, _refSize);
+    }
+
+    uint64_t dictionaryValue(const Object& dictionary, size_t i) const
+    {
+        return readBigEndian(dictionary.bytes + (dictionary.count + i) * _refSize, _refSize);
+    }
+
+    // Finds the value for an ASCII key in a dictionary.
+    Object lookup(const Object& dictionary, const char* key) const
+    {
+        if (dictionary.type != TypeDictionary)
+            return Object();
+
+        const size_t keyLength = strlen(key);
+        for (size_t i = 0; i < dictionary.count; ++i)
+        {
+            const Object k = object(dictionaryKey(dictionary, i));
+            if (k.type == TypeString && k.count == keyLength && memcmp(k.bytes, key, keyLength) == 0)
+                return object(dictionaryValue(dictionary, i));
+        }
+
+        return Object();
+    }
+
+private:
+    static uint64_t readBigEndian(const uint8_t* p, size_t size)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; ++i)
+            value = (value << 8) | p[i];
+        return value;
+    }
+
+    const uint8_t*  _data           = nullptr;
+    size_t          _size           = 0;
+    size_t          _offsetSize     = 0;
+    size_t          _refSize        = 0;
+    uint64_t        _objectCount    = 0;
+    uint64_t        _topObject      = 0;
+    uint64_t        _offsetTable    = 0;
+};
+
+// Resolves the object graph of an NSKeyedArchiver archive.
+class KeyedArchive
+{
+public:
+    typedef BinaryPropertyList::Object Object;
+
+    bool init(const uint8_t* data, size_t size)
+    {
+        if (!_plist.init(data, size))
+            return false;
+
+        const Object top = _plist.object(_plist.topObject());
+        _objects = _plist.lookup(top, "$objects");
+        if (_objects.type != BinaryPropertyList::TypeArray)
+            return false;
+
+        _root = resolve(_plist.lookup(_plist.lookup(top, "$top"), "root"));
+        return _root.type == BinaryPropertyList::TypeDictionary;
+    }
+
+    const BinaryPropertyList& plist() const { return _plist; }
+    const Object& root() const              { return _root; }
+
+    // Follows a UID reference into the $objects array; other objects are returned as is.
+    Object resolve(const Object& object) const
+    {
+        if (object.type != BinaryPropertyList::TypeUID)
+            return object;
+        if (object.integer >= _objects.count)
+            return Object();
+        return _plist.object(_plist.arrayElement(_objects, object.integer));
+    }
+
+    Object value(const Object& dictionary, const char* key) const
+    {
+        return resolve(_plist.lookup(dictionary, key));
+    }
+
+    // Unwraps NSData, which is archived either inline or as a dictionary with `NS.data`.
+    Object data(const Object& object) const
+    {
+        Object resolved = resolve(object);
+        if (resolved.type == BinaryPropertyList::TypeDictionary)
+            resolved = value(resolved, "NS.data");
+        return resolved.type == BinaryPropertyList::TypeData ? resolved : Object();
+    }
+
+    std::string string(const Object& object) const
+    {
+        Object resolved = resolve(object);
+        if (resolved.type == BinaryPropertyList::TypeDictionary)
+            resolved = value(resolved, "NS.string");
+        if (resolved.type != BinaryPropertyList::TypeString)
+            return std::string();
+        return std::string((const char*)resolved.bytes, resolved.count);
+    }
+
+    // Returns the element objects of an archived NSArray.
+    std::vector<Object> array(const Object& object) const
+    {
+        std::vector<Object> elements;
+        const Object list = value(resolve(object), "NS.objects");
+        if (list.type != BinaryPropertyList::TypeArray)
+            return elements;
+
+        elements.reserve(list.count);
+        for (size_t i = 0; i < list.count; ++i)
+            elements.push_back(resolve(_plist.object(_plist.arrayElement(list, i))));
+        return elements;
+    }
+
+private:
+    BinaryPropertyList  _plist;
+    Object              _objects;
+    Object              _root;
+};
+
+
+// Writer for the subset of binary property lists that BinaryPropertyList reads.  Data
+//  objects aren't copied and must stay alive until `write` returns.
+class BinaryPropertyListWriter
+{
+public:
+    typedef uint64_t Ref;
+
+    Ref integer(uint64_t value)
+    {
+        Object o;
+        o.marker    = 0x10;
+        o.integer   = value;
+        return add(o);
+    }
+
+    // Strings must be ASCII.  Equal strings share one object.
+    Ref string(const std::string& value)
+    {
+        const auto found = _strings.find(value);
+        if (found != _strings.end())
+            return found->second;
+
+        Object o;
+        o.marker    = 0x50;
+        o.count     = value.size();
+        o.string    = value;
+
+        const Ref ref = add(o);
+        _strings[value] = ref;
+        return ref;
+    }
+
+    Ref data(const uint8_t* bytes, size_t size)
+    {
+        Object o;
+        o.marker    = 0x40;
+        o.bytes     = bytes;
+        o.count     = size;
+        return add(o);
+    }
+
+    Ref uid(uint64_t value)
+    {
+        Object o;
+        o.marker    = 0x80;
+        o.integer   = value;
+        return add(o);
+    }
+
+    Ref array(const std::vector<Ref>& elements)
+    {
+        Object o;
+        o.marker    = 0xA0;
+        o.count     = elements.size();
+        o.refs      = elements;
+        return add(o);
+    }
+
+    Ref dictionary(const std::vector<std::pair<std::string, Ref>>& entries)
+    {
+        Object o;
+        o.marker    = 0xD0;
+        o.count     = entries.size();
+        for (const auto& entry : entries)
+            o.refs.push_back(string(entry.first));
+        for (const auto& entry : entries)
+            o.refs.push_back(entry.second);
+        return add(o);
+    }
+
+    // Size of the property list `write` produces.
+    uint64_t size() const
+    {
+        uint64_t offsetTable;
+        size_t offsetSize;
+        layout(offsetTable, offsetSize);
+
+        return offsetTable + _objects.size() * offsetSize + TrailerSize;
+    }
+
+    bool write(FILE* file, Ref top) const
+    {
+        uint64_t offsetTable;
+        size_t offsetSize;
+        layout(offsetTable, offsetSize);
+
+        const size_t refSize = bytesFor(_objects.size());
+
+        std::vector<uint8_t> buffer;
+        std::vector<uint64_t> offsets;
+        offsets.reserve(_objects.size());
+
+        uint64_t offset = 8;
+        if (fwrite("bplist00", 1, 8, file) != 8)
+            return false;
+
+        for (const Object& o : _objects)
+        {
+            offsets.push_back(offset);
+
+            buffer.clear();
+            switch (o.marker)
+            {
+                case 0x10:
+                    appendInteger(buffer, o.integer);
+                    break;
+                case 0x80:
+                    buffer.push_back((uint8_t)(0x80 | (bytesFor(o.integer) - 1)));
+                    appendBigEndian(buffer, o.integer, bytesFor(o.integer));
+                    break;
+                default:
+                    appendMarker(buffer, o.marker, o.count);
+                    for (Ref ref : o.refs)
+                        appendBigEndian(buffer, ref, refSize);
+                    break;
+            }
+
+            if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+                return false;
+            const size_t payloadSize = payload(o) ? o.count : 0;
+            if (payloadSize && fwrite(payload(o), 1, payloadSize, file) != payloadSize)
+                return false;
+
+            offset += buffer.size() + payloadSize;
+        }
+
+        buffer.clear();
+        for (uint64_t objectOffset : offsets)
+            appendBigEndian(buffer, objectOffset, offsetSize);
+
+        // Trailer: 6 unused bytes, the sizes of offsets and references, the object count,
+        //  the top object and the offset of the offset table.
+        buffer.insert(buffer.end(), 6, 0);
+        buffer.push_back((uint8_t)offsetSize);
+        buffer.push_back((uint8_t)refSize);
+        appendBigEndian(buffer, _objects.size(), 8);
+        appendBigEndian(buffer, top, 8);
+        appendBigEndian(buffer, offsetTable, 8);
+
+        return fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    }
+
+private:
+    static const size_t TrailerSize = 32;
+
+    struct Object
+    {
+        uint8_t             marker  = 0;
+        uint64_t            integer = 0;
+        const uint8_t*      bytes   = nullptr;
+        size_t              count   = 0;
+        std::vector<Ref>    refs;
+        std::string         string;
+    };
+
+    // Bytes following the marker of strings and data.
+    static const uint8_t* payload(const Object& o)
+    {
+        return o.marker == 0x50 ? (const uint8_t*)o.string.data() : o.bytes;
+    }
+
+    Ref add(const Object& o)
+    {
+        _objects.push_back(o);
+        return _objects.size() - 1;
+    }
+
+    // Bytes of the smallest power of two size holding `value`.
+    static size_t bytesFor(uint64_t value)
+    {
+        return value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : value <= 0xFFFFFFFF ? 4 : 8;
+    }
+
+    static void appendBigEndian(std::vector<uint8_t>& out, uint64_t value, size_t size)
+    {
+        for (size_t i = size; i-- > 0; )
+            out.push_back((uint8_t)(value >> (i * 8)));
+    }
+
+    static void appendInteger(std::vector<uint8_t>& out, uint64_t value)
+    {
+        const size_t size = bytesFor(value);
+        out.push_back((uint8_t)(0x10 | (size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3)));
+        appendBigEndian(out, value, size);
+    }
+
+    // Marker of a variable length object followed by its count when it doesn't fit in the marker.
+    static void appendMarker(std::vector<uint8_t>& out, uint8_t marker, size_t count)
+    {
+        if (count < 0xF)
+        {
+            out.push_back((uint8_t)(marker | count));
+            return;
+        }
+        out.push_back((uint8_t)(marker | 0xF));
+        appendInteger(out, count);
+    }
+
+    void layout(uint64_t& offsetTable, size_t& offsetSize) const
+    {
+        const size_t refSize = bytesFor(_objects.size());
+
+        std::vector<uint8_t> header;
+        offsetTable = 8;
+        for (const Object& o : _objects)
+        {
+            header.clear();
+            switch (o.marker)
+            {
+                case 0x10:  appendInteger(header, o.integer);                           break;
+                case 0x80:  header.resize(1 + bytesFor(o.integer));                     break;
+                default:    appendMarker(header, o.marker, o.count);
+                            header.resize(header.size() + o.refs.size() * refSize);     break;
+            }
+            offsetTable += header.size() + (payload(o) ? o.count : 0);
+        }
+
+        offsetSize = bytesFor(offsetTable);
+    }
+
+    std::vector<Object>             _objects;
+    std::map<std::string, Ref>      _strings;
+};
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+AAPLMeshFile::~AAPLMeshFile()
+{
+    close();
+}
+
+bool AAPLMeshFile::fail(const std::string& message)
+{
+    close();
+    _error = message;
+    return false;
+}
+
+void AAPLMeshFile::close()
+{
+    if (_mapping)
+        munmap(_mapping, _mappingSize);
+
+    _mapping        = nullptr;
+    _mappingSize    = 0;
+    _values.clear();
+    _textures.clear();
+}
+
+bool AAPLMeshFile::open(const char* path)
+{
+    close();
+    _error.clear();
+
+    int fd = ::open(path, O_RDONLY, 0);
+
+    if (fd < 0)
+        return fail(std::string("Could not open '") + path + "'");
+
+    struct stat fileInfo;
+
+    if (fstat(fd, &fileInfo))
+    {
+        ::close(fd);
+        return fail(std::string("Could not get file size for '") + path + "'");
+    }
+
+    if ((size_t)fileInfo.st_size < sizeof(AAPLFileHeader))
+    {
+        ::close(fd);
+        return fail(std::string("File '") + path + "' is too small");
+    }
+
+    void* mapping = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+        return fail(std::string("Could not map '") + path + "'");
+
+    _mapping        = (uint8_t*)mapping;
+    _mappingSize    = fileInfo.st_size;
+
+    AAPLFileHeader header;
+    memcpy(&header, _mapping, sizeof(header));
+
+    if (header.magic != MESH_MAGIC)
+        return fail("File is not a mesh file");
+
+    if (header.version != MESH_VERSION)
+        return fail("Unsupported mesh file version");
+
+    if (header.dataOffset > _mappingSize - sizeof(AAPLFileHeader))
+        return fail("Mesh data offset is out of bounds");
+
+    KeyedArchive archive;
+    if (!archive.init(_mapping + sizeof(AAPLFileHeader), header.dataOffset))
+        return fail("Failed to decode mesh archive");
+
+    const BinaryPropertyList& plist = archive.plist();
+    const KeyedArchive::Object& root = archive.root();
+
+    // Flatten the root object so that lookups don't walk the property list.
+    for (size_t i = 0; i < root.count; ++i)
+    {
+        const KeyedArchive::Object key = plist.object(plist.dictionaryKey(root, i));
+        if (key.type != BinaryPropertyList::TypeString)
+            continue;
+
+        const KeyedArchive::Object value = archive.resolve(plist.object(plist.dictionaryValue(root, i)));
+
+        Value entry;
+        entry.key = std::string((const char*)key.bytes, key.count);
+
+        if (value.type == BinaryPropertyList::TypeInteger || value.type == BinaryPropertyList::TypeBool)
+        {
+            entry.integer = value.integer;
+        }
+        else
+        {
+            const KeyedArchive::Object data = archive.data(value);
+            if (data.type == BinaryPropertyList::TypeData)
+                entry.bytes = { data.bytes, data.count };
+        }
+
+        _values.push_back(entry);
+    }
+
+    for (const KeyedArchive::Object& texture : archive.array(archive.value(root, "textures")))
+    {
+        AAPLMeshFileTexture desc;
+        desc.path               = archive.string(plist.lookup(texture, "path"));
+        desc.width              = archive.value(texture, "width").integer;
+        desc.height             = archive.value(texture, "height").integer;
+        desc.mipmapLevelCount   = archive.value(texture, "mipmapLevelCount").integer;
+        desc.pixelFormat        = archive.value(texture, "pixelFormat").integer;
+        desc.pixelDataOffset    = archive.value(texture, "pixelDataOffset").integer;
+        desc.pixelDataLength    = archive.value(texture, "pixelDataLength").integer;
+
+        for (const KeyedArchive::Object& offset : archive.array(plist.lookup(texture, "mipOffsets")))
+            desc.mipOffsets.push_back(offset.integer);
+        for (const KeyedArchive::Object& length : archive.array(plist.lookup(texture, "mipLengths")))
+            desc.mipLengths.push_back(length.integer);
+
+        if (desc.mipOffsets.size() != desc.mipLengths.size())
+            return fail("Texture '" + desc.path + "' has mismatched mip tables");
+
+        _textures.push_back(std::move(desc));
+    }
+
+    return true;
+}
+
+const AAPLMeshFile::Value* AAPLMeshFile::value(const char* key) const
+{
+    for (const Value& value : _values)
+    {
+        if (value.key == key)
+            return &value;
+    }
+    return nullptr;
+}
+
+uint64_t AAPLMeshFile::integer(const char* key) const
+{
+    const Value* v = value(key);
+    return v ? v->integer : 0;
+}
+
+AAPLSpan<uint8_t> AAPLMeshFile::bytes(const char* key) const
+{
+    const Value* v = value(key);
+    return v ? v->bytes : AAPLSpan<uint8_t>();
+}
+
+AAPLMeshFileBlock AAPLMeshFile::block(const char* key) const
+{
+    AAPLMeshFileBlock result;
+
+    const AAPLSpan<uint8_t> data = bytes(key);
+    if (data.size() < sizeof(AAPLCompressionHeader))
+        return result;
+
+    memcpy(&result.header, data.data, sizeof(AAPLCompressionHeader));
+
+    if (data.size() - sizeof(AAPLCompressionHeader) != result.header.compressedSize)
+    {
+        result.header = {};
+        return result;
+    }
+
+    result.payload = { data.data + sizeof(AAPLCompressionHeader), (size_t)result.header.compressedSize };
+    return result;
+}
+
+bool AAPLMeshFile::decompress(const AAPLMeshFileBlock& block, void* dst, size_t dstSize)
+{
+    if (!block.valid() || dstSize < block.uncompressedSize())
+        return false;
+
+    return AAPLDecompressBlock(block.header, block.payload.data, dst);
+}
+
+//------------------------------------------------------------------------------
+
+bool AAPLWriteMeshFile(const char* path, const AAPLMeshFileContents& contents, uint32_t codec,
+                       uint32_t blockSize, std::string& error)
+{
+    typedef BinaryPropertyListWriter::Ref Ref;
+
+    // Compress the streams first; the archive refers to the compressed blocks.
+    const std::pair<const char*, const std::vector<uint8_t>*> streams[] =
+    {
+        { "vertexData",     &contents.vertexData },
+        { "normalData",     &contents.normalData },
+        { "tangentData",    &contents.tangentData },
+        { "uvData",         &contents.uvData },
+        { "indexData",      &contents.indexData },
+        { "chunkData",      &contents.chunkData },
+        { "meshData",       &contents.meshData },
+        { "materialData",   &contents.materialData },
+    };
+
+    std::vector<std::vector<uint8_t>> blocks(sizeof(streams) / sizeof(streams[0]));
+
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        const std::vector<uint8_t>& stream = *streams[i].second;
+
+        if (codec == AAPLCompressionModeNone)
+        {
+            AAPLCompressionHeader header = {};
+            header.compressionMode  = AAPLCompressionModeNone;
+            header.uncompressedSize = stream.size();
+            header.compressedSize   = stream.size();
+
+            blocks[i].resize(sizeof(header));
+            memcpy(blocks[i].data(), &header, sizeof(header));
+            blocks[i].insert(blocks[i].end(), stream.begin(), stream.end());
+        }
+        else if (!AAPLCompressChunked(codec, stream.data(), stream.size(), blockSize, blocks[i]))
+        {
+            error = std::string("Could not compress '") + streams[i].first + "'";
+            return false;
+        }
+    }
+
+    // NSKeyedArchiver layout: objects live in the `$objects` array and refer to each other by
+    //  UIDs, which are indices into that array.  Index 0 is the nil object and 1 the root.
+    BinaryPropertyListWriter plist;
+    std::vector<Ref> objects = { plist.string("$null"), 0 };
+
+    const auto archive = [&](Ref object)
+    {
+        objects.push_back(object);
+        return plist.uid(objects.size() - 1);
+    };
+
+    const auto archiveClass = [&](const std::vector<std::string>& classes)
+    {
+        std::vector<Ref> names;
+        for (const std::string& name : classes)
+            names.push_back(plist.string(name));
+
+        return archive(plist.dictionary({ { "$classname", plist.string(classes[0]) }, { "$classes", plist.array(names) } }));
+    };
+
+    const Ref arrayClass = archiveClass({ "NSMutableArray", "NSArray", "NSObject" });
+
+    const auto archiveArray = [&](const std::vector<Ref>& elements)
+    {
+        return archive(plist.dictionary({ { "NS.objects", plist.array(elements) }, { "$class", arrayClass } }));
+    };
+
+    const auto archiveIntegers = [&](const std::vector<uint64_t>& values)
+    {
+        std::vector<Ref> elements;
+        for (uint64_t value : values)
+            elements.push_back(archive(plist.integer(value)));
+        return archiveArray(elements);
+    };
+
+    const Ref textureClass = archiveClass({ "Texture", "NSObject" });
+
+    std::vector<Ref> textures;
+    for (const AAPLMeshFileTexture& texture : contents.textures)
+    {
+        for (char c : texture.path)
+        {
+            if ((unsigned char)c >= 0x80)
+            {
+                error = "Texture path '" + texture.path + "' is not ASCII";
+                return false;
+            }
+        }
+
+        textures.push_back(archive(plist.dictionary(
+        {
+            { "$class",             textureClass },
+            { "path",               archive(plist.string(texture.path)) },
+            { "width",              plist.integer(texture.width) },
+            { "height",             plist.integer(texture.height) },
+            { "mipmapLevelCount",   plist.integer(texture.mipmapLevelCount) },
+            { "pixelFormat",        plist.integer(texture.pixelFormat) },
+            { "pixelDataOffset",    plist.integer(texture.pixelDataOffset) },
+            { "pixelDataLength",    plist.integer(texture.pixelDataLength) },
+            { "mipOffsets",         archiveIntegers(texture.mipOffsets) },
+            { "mipLengths",         archiveIntegers(texture.mipLengths) },
+        })));
+    }
+
+    std::vector<std::pair<std::string, Ref>> root =
+    {
+        { "$class",                 archiveClass({ "Mesh", "NSObject" }) },
+        { "vertexCount",            plist.integer(contents.vertexCount) },
+        { "indexCount",             plist.integer(contents.indexCount) },
+        { "indexType",              plist.integer(contents.indexType) },
+        { "chunkCount",             plist.integer(contents.chunkCount) },
+        { "meshCount",              plist.integer(contents.meshCount) },
+        { "opaqueChunkCount",       plist.integer(contents.opaqueChunkCount) },
+        { "opaqueMeshCount",        plist.integer(contents.opaqueMeshCount) },
+        { "alphaMaskedChunkCount",  plist.integer(contents.alphaMaskedChunkCount) },
+        { "alphaMaskedMeshCount",   plist.integer(contents.alphaMaskedMeshCount) },
+        { "transparentChunkCount",  plist.integer(contents.transparentChunkCount) },
+        { "transparentMeshCount",   plist.integer(contents.transparentMeshCount) },
+        { "materialCount",          plist.integer(contents.materialCount) },
+        { "textures",               archiveArray(textures) },
+        { "textureData",            archive(plist.data(contents.textureData.data(), contents.textureData.size())) },
+    };
+
+    for (size_t i = 0; i < blocks.size(); ++i)
+        root.push_back({ streams[i].first, archive(plist.data(blocks[i].data(), blocks[i].size())) });
+
+    objects[1] = plist.dictionary(root);
+
+    const Ref top = plist.dictionary(
+    {
+        { "$version",   plist.integer(100000) },
+        { "$archiver",  plist.string("NSKeyedArchiver") },
+        { "$top",       plist.dictionary({ { "root", plist.uid(1) } }) },
+        { "$objects",   plist.array(objects) },
+    });
+
+    const uint64_t archiveSize = plist.size();
+    if (archiveSize > UINT32_MAX)
+    {
+        error = "Mesh data is too large for the file header";
+        return false;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        error = std::string("Could not create '") + path + "'";
+        return false;
+    }
+
+    AAPLFileHeader header;
+    header.magic        = MESH_MAGIC;
+    header.version      = MESH_VERSION;
+    header.dataOffset   = (uint32_t)archiveSize;
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && plist.write(file, top);
+    written = (fclose(file) == 0) && written;
+
+    if (!written)
+    {
+        error = std::string("Could not write '") + path + "'";
+        return false;
+    }
+
+    return true;
+}
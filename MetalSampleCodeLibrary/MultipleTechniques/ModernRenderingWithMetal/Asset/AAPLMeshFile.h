@@ -0,0 +1,223 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for a portable C++ reader of the mesh file format, which maps the file into memory
+ and exposes its streams without copying, and for a writer of the format.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "AAPLCompressionCodec.h"
+
+#define MESH_MAGIC   0x4853454D
+#define MESH_VERSION 16
+
+// Header for the file.
+struct AAPLFileHeader
+{
+    uint32_t magic;         // Marker to indicate file type - should be `MESH_MAGIC`.
+    uint32_t version;       // Marker to indicate file version  - should be `MESH_VERSION`.
+    uint32_t dataOffset;    // Offset to mesh data in the file.
+};
+
+// Read-only view of `count` contiguous objects of type T.
+template <typename T>
+struct AAPLSpan
+{
+    const T*    data    = nullptr;
+    size_t      count   = 0;
+
+    const T*    begin() const                   { return data; }
+    const T*    end() const                     { return data + count; }
+    size_t      size() const                    { return count; }
+    bool        empty() const                   { return count == 0; }
+    const T&    operator[](size_t index) const  { return data[index]; }
+};
+
+// A compressed block inside the mapped file: its header and the compressed payload following it.
+struct AAPLMeshFileBlock
+{
+    AAPLCompressionHeader   header  = {};
+    AAPLSpan<uint8_t>       payload;
+
+    bool     valid() const            { return payload.data != nullptr; }
+    uint64_t uncompressedSize() const { return header.uncompressedSize; }
+};
+
+// Description of a texture stored in the file, matching the fields of AAPLTextureData.
+struct AAPLMeshFileTexture
+{
+    std::string             path;
+    uint64_t                width               = 0;
+    uint64_t                height              = 0;
+    uint64_t                mipmapLevelCount    = 0;
+    uint64_t                pixelFormat         = 0;
+    uint64_t                pixelDataOffset     = 0;
+    uint64_t                pixelDataLength     = 0;
+    std::vector<uint64_t>   mipOffsets;
+    std::vector<uint64_t>   mipLengths;
+};
+
+// Memory maps a mesh file and decodes the keyed archive at its start.  Blocks returned
+//  by this class point into the mapping and remain valid until the file is closed.
+class AAPLMeshFile
+{
+public:
+    AAPLMeshFile() {}
+    ~AAPLMeshFile();
+
+    AAPLMeshFile(const AAPLMeshFile&) = delete;
+    AAPLMeshFile& operator=(const AAPLMeshFile&) = delete;
+
+    // Maps and validates the file.  On failure returns false and sets `error`.
+    bool open(const char* path);
+    void close();
+
+    const std::string& error() const                { return _error; }
+
+    // Counts of objects in data buffers.
+    uint64_t vertexCount() const                    { return integer("vertexCount"); }
+    uint64_t indexCount() const                     { return integer("indexCount"); }
+    uint64_t indexType() const                      { return integer("indexType"); }
+    uint64_t chunkCount() const                     { return integer("chunkCount"); }
+    uint64_t meshCount() const                      { return integer("meshCount"); }
+    uint64_t materialCount() const                  { return integer("materialCount"); }
+    uint64_t opaqueChunkCount() const               { return integer("opaqueChunkCount"); }
+    uint64_t opaqueMeshCount() const                { return integer("opaqueMeshCount"); }
+    uint64_t alphaMaskedChunkCount() const          { return integer("alphaMaskedChunkCount"); }
+    uint64_t alphaMaskedMeshCount() const           { return integer("alphaMaskedMeshCount"); }
+    uint64_t transparentChunkCount() const          { return integer("transparentChunkCount"); }
+    uint64_t transparentMeshCount() const           { return integer("transparentMeshCount"); }
+
+    // Compressed streams.
+    AAPLMeshFileBlock vertexBlock() const           { return block("vertexData"); }
+    AAPLMeshFileBlock normalBlock() const           { return block("normalData"); }
+    AAPLMeshFileBlock tangentBlock() const          { return block("tangentData"); }
+    AAPLMeshFileBlock uvBlock() const               { return block("uvData"); }
+    AAPLMeshFileBlock indexBlock() const            { return block("indexData"); }
+    AAPLMeshFileBlock chunkBlock() const            { return block("chunkData"); }
+    AAPLMeshFileBlock meshBlock() const             { return block("meshData"); }
+    AAPLMeshFileBlock materialBlock() const         { return block("materialData"); }
+
+    // Uncompressed texture payload, addressed by AAPLMeshFileTexture::pixelDataOffset.
+    AAPLSpan<uint8_t> textureData() const           { return bytes("textureData"); }
+
+    const std::vector<AAPLMeshFileTexture>& textures() const { return _textures; }
+
+    // Uncompresses `block` straight into `dst`, which must hold `block.uncompressedSize()` bytes.
+    static bool decompress(const AAPLMeshFileBlock& block, void* dst, size_t dstSize);
+
+    // Returns a typed view of `block`.  Blocks stored without compression are returned
+    //  in place; others are uncompressed into `storage`, which the caller keeps alive.
+    template <typename T>
+    AAPLSpan<T> typedBlock(const AAPLMeshFileBlock& block, std::vector<uint8_t>& storage) const
+    {
+        if (!block.valid() || block.uncompressedSize() % sizeof(T) != 0)
+            return {};
+
+        if (block.header.compressionMode == AAPLCompressionModeNone)
+            return { (const T*)block.payload.data, block.uncompressedSize() / sizeof(T) };
+
+        storage.resize(block.uncompressedSize());
+        if (!decompress(block, storage.data(), storage.size()))
+            return {};
+
+        return { (const T*)storage.data(), storage.size() / sizeof(T) };
+    }
+
+    // Generic access to values of the root archive object, by key.
+    uint64_t          integer(const char* key) const;
+    AAPLSpan<uint8_t> bytes(const char* key) const;
+    AAPLMeshFileBlock block(const char* key) const;
+
+private:
+    // Value of a key in the root archive object.
+    struct Value
+    {
+        std::string         key;
+        uint64_t            integer = 0;
+        AAPLSpan<uint8_t>   bytes;
+    };
+
+    const Value*    value(const char* key) const;
+    bool            fail(const std::string& message);
+
+    uint8_t*        _mapping        = nullptr;
+    size_t          _mappingSize    = 0;
+
+    std::vector<Value>                  _values;
+    std::vector<AAPLMeshFileTexture>    _textures;
+    std::string                         _error;
+};
+
+//------------------------------------------------------------------------------
+
+// Layout of AAPLMeshChunk, whose simd members are 16 byte aligned, for code built without
+//  the simd headers.
+struct alignas(16) AAPLMeshFileChunk
+{
+    float       boxMin[4];
+    float       boxMax[4];
+    float       normalDistribution[4];
+    float       clusterMean[4];
+    float       boundingSphere[4];
+    uint32_t    materialIndex;
+    uint32_t    indexBegin;
+    uint32_t    indexCount;
+};
+
+// Layout of AAPLSubMesh.
+struct alignas(16) AAPLMeshFileSubMesh
+{
+    uint32_t                materialIndex;
+    alignas(16) float       boxMin[4];
+    float                   boxMax[4];
+    float                   boundingSphere[4];
+    uint32_t                indexBegin;
+    uint32_t                indexCount;
+    uint32_t                chunkStart;
+    uint32_t                chunkCount;
+};
+
+static_assert(sizeof(AAPLMeshFileChunk) == 96 && sizeof(AAPLMeshFileSubMesh) == 80, "Unexpected layouts");
+
+// Contents of a mesh file to write, with uncompressed streams in the layouts AAPLMesh uses.
+struct AAPLMeshFileContents
+{
+    uint64_t                vertexCount             = 0;
+    uint64_t                indexCount              = 0;
+    uint64_t                indexType               = 1;    // MTLIndexTypeUInt32.
+    uint64_t                chunkCount              = 0;
+    uint64_t                meshCount               = 0;
+    uint64_t                materialCount           = 0;
+    uint64_t                opaqueChunkCount        = 0;
+    uint64_t                opaqueMeshCount         = 0;
+    uint64_t                alphaMaskedChunkCount   = 0;
+    uint64_t                alphaMaskedMeshCount    = 0;
+    uint64_t                transparentChunkCount   = 0;
+    uint64_t                transparentMeshCount    = 0;
+
+    std::vector<uint8_t>    vertexData;         // Packed float3 positions.
+    std::vector<uint8_t>    normalData;         // Packed float3 normals.
+    std::vector<uint8_t>    tangentData;        // Packed float3 tangents.
+    std::vector<uint8_t>    uvData;             // float2 texture coordinates.
+    std::vector<uint8_t>    indexData;
+    std::vector<uint8_t>    chunkData;          // AAPLMeshChunk array.
+    std::vector<uint8_t>    meshData;           // AAPLSubMesh array.
+    std::vector<uint8_t>    materialData;       // AAPLMaterial array.
+
+    std::vector<AAPLMeshFileTexture>    textures;
+    std::vector<uint8_t>                textureData;
+};
+
+// Writes a file that both AAPLMeshData and AAPLMeshFile read.  Streams are compressed with
+//  AAPLCompressChunked in blocks of `blockSize` bytes, or stored as is when `codec` is
+//  AAPLCompressionModeNone.  On failure returns false and sets `error`.
+bool AAPLWriteMeshFile(const char* path, const AAPLMeshFileContents& contents, uint32_t codec,
+                       uint32_t blockSize, std::string& error);
@@ -0,0 +1,274 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the offline texture cooker.
+*/
+#include "AAPLTextureCooker.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace
+{
+
+static const uint8_t  KTX2Identifier[12]  = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+static const size_t   KTX2HeaderSize      = 80;
+static const size_t   KTX2LevelIndexSize  = 24;
+static const char     WriterKey[]         = "KTXwriter";
+static const char     WriterValue[]       = "AAPLTextureCooker";
+
+// Khronos data format descriptor values for BC formats.
+static const uint32_t ColorPrimariesBT709 = 1;
+static const uint32_t TransferLinear      = 1;
+static const uint32_t TransferSRGB        = 2;
+static const uint32_t ChannelSigned       = 0x40;
+
+// Per format: KTX2 codes without and with sRGB, and the descriptor's color model and channels.
+struct FormatCodes
+{
+    uint32_t    vkFormat;
+    uint32_t    vkFormatSRGB;
+    uint32_t    colorModel;
+    uint32_t    sampleCount;
+    uint32_t    channels[2];
+};
+
+static const FormatCodes Codes[] =
+{
+    { 133, 134, 128, 1, {  1, 0 } },    // BC1, with the channel that marks punch-through alpha.
+    { 137, 138, 130, 2, { 15, 0 } },    // BC3, alpha block then color block.
+    { 139,   0, 131, 1, {  0, 0 } },    // BC4
+    { 140,   0, 131, 1, {  0, 0 } },
+    { 141,   0, 132, 2, {  0, 1 } },    // BC5, red block then green block.
+    { 142,   0, 132, 2, {  0, 1 } },
+};
+
+inline void append32(std::vector<uint8_t>& data, uint32_t value)
+{
+    uint8_t bytes[4];
+    memcpy(bytes, &value, sizeof(value));
+    data.insert(data.end(), bytes, bytes + 4);
+}
+
+inline void write32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+{
+    memcpy(&data[offset], &value, sizeof(value));
+}
+
+inline void write64(std::vector<uint8_t>& data, size_t offset, uint64_t value)
+{
+    memcpy(&data[offset], &value, sizeof(value));
+}
+
+inline void padTo(std::vector<uint8_t>& data, size_t alignment)
+{
+    data.resize((data.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+inline float sRGBToLinear(float value)
+{
+    return value <= 0.04045f ? value * (1.0f / 12.92f) : powf((value + 0.055f) * (1.0f / 1.055f), 2.4f);
+}
+
+inline float linearToSRGB(float value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+// Decoding and encoding of a channel for filtering.
+struct ChannelCodec
+{
+    float   toFilter[256];
+    bool    sRGB;
+    bool    isSigned;
+
+    uint8_t fromFilter(float value) const
+    {
+        if (isSigned)
+            return (uint8_t)(int8_t)lrintf(std::min(std::max(value, -127.0f), 127.0f));
+        if (sRGB)
+            value = linearToSRGB(std::min(std::max(value, 0.0f), 1.0f)) * 255.0f;
+        return (uint8_t)lrintf(std::min(std::max(value, 0.0f), 255.0f));
+    }
+};
+
+ChannelCodec channelCodec(bool sRGB, bool isSigned)
+{
+    ChannelCodec codec;
+    codec.sRGB      = sRGB && !isSigned;
+    codec.isSigned  = isSigned;
+    for (int i = 0; i < 256; ++i)
+    {
+        codec.toFilter[i] = isSigned ? (float)std::max((int)(int8_t)i, -127) :
+                            codec.sRGB ? sRGBToLinear(i / 255.0f) : (float)i;
+    }
+    return codec;
+}
+
+// Averages 2x2 pixels of `source` into each pixel of the next mipmap level.
+void downsample(const std::vector<uint8_t>& source, uint32_t width, uint32_t height,
+                const ChannelCodec& color, const ChannelCodec& alpha, std::vector<uint8_t>& destination)
+{
+    const uint32_t nextWidth  = std::max(width / 2, 1u);
+    const uint32_t nextHeight = std::max(height / 2, 1u);
+    destination.resize((size_t)nextWidth * nextHeight * 4);
+
+    for (uint32_t y = 0; y < nextHeight; ++y)
+    {
+        const uint32_t y0 = std::min(y * 2, height - 1);
+        const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+        for (uint32_t x = 0; x < nextWidth; ++x)
+        {
+            const uint32_t x0 = std::min(x * 2, width - 1);
+            const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+            const uint8_t* p[4] =
+            {
+                &source[((size_t)y0 * width + x0) * 4], &source[((size_t)y0 * width + x1) * 4],
+                &source[((size_t)y1 * width + x0) * 4], &source[((size_t)y1 * width + x1) * 4],
+            };
+            for (int c = 0; c < 4; ++c)
+            {
+                const ChannelCodec& codec = c == 3 ? alpha : color;
+                const float sum = codec.toFilter[p[0][c]] + codec.toFilter[p[1][c]] + codec.toFilter[p[2][c]] + codec.toFilter[p[3][c]];
+                destination[((size_t)y * nextWidth + x) * 4 + c] = codec.fromFilter(sum * 0.25f);
+            }
+        }
+    }
+}
+
+// Appends a basic data format descriptor for a BC format.
+void appendDescriptor(std::vector<uint8_t>& data, AAPLBCFormat format, bool sRGB)
+{
+    const FormatCodes& codes = Codes[(uint32_t)format];
+    const bool isSigned = format == AAPLBCFormat::BC4Signed || format == AAPLBCFormat::BC5Signed;
+    const uint32_t blockSize = 24 + 16 * codes.sampleCount;
+
+    append32(data, 4 + blockSize);                                  // Total size.
+    append32(data, 0);                                              // Khronos vendor, basic descriptor.
+    append32(data, 2 | (blockSize << 16));                          // Version and block size.
+    append32(data, codes.colorModel | (ColorPrimariesBT709 << 8) | ((sRGB ? TransferSRGB : TransferLinear) << 16));
+    append32(data, 3 | (3 << 8));                                   // 4x4 texel blocks.
+    append32(data, AAPLBCGetFormatInfo(format).bytesPerBlock);      // Bytes of plane 0.
+    append32(data, 0);
+
+    for (uint32_t s = 0; s < codes.sampleCount; ++s)
+    {
+        append32(data, (s * 64) | (63 << 16) | ((codes.channels[s] | (isSigned ? ChannelSigned : 0)) << 24));
+        append32(data, 0);                                          // Sample position.
+        append32(data, isSigned ? 0x80000000u : 0);
+        append32(data, isSigned ? 0x7FFFFFFFu : 0xFFFFFFFFu);
+    }
+}
+
+} // namespace
+
+bool AAPLCookTexture(const uint8_t* pixels, uint32_t width, uint32_t height, size_t bytesPerRow,
+                     const AAPLTextureCookerOptions& options, std::vector<uint8_t>& ktx, std::string& error,
+                     AAPLTextureCookerStats* stats)
+{
+    const AAPLBCFormat format = options.format;
+    const FormatCodes& codes = Codes[(uint32_t)format];
+    const bool isSigned = format == AAPLBCFormat::BC4Signed || format == AAPLBCFormat::BC5Signed;
+
+    if (width == 0 || height == 0)
+    {
+        error = "The image is empty";
+        return false;
+    }
+
+    if (options.sRGB && codes.vkFormatSRGB == 0)
+    {
+        error = "The format has no sRGB variant";
+        return false;
+    }
+
+    uint32_t levelCount = 1;
+    if (options.mipmaps)
+    {
+        while ((std::max(width, height) >> levelCount) > 0)
+            ++levelCount;
+    }
+
+    const ChannelCodec color = channelCodec(options.sRGB, isSigned);
+    const ChannelCodec alpha = channelCodec(false, isSigned);
+
+    // Build the levels from the base, encoding each as it's made.
+    std::vector<std::vector<uint8_t>> blocks(levelCount);
+    std::vector<uint8_t> level((size_t)width * height * 4);
+    std::vector<uint8_t> next;
+    for (uint32_t y = 0; y < height; ++y)
+        memcpy(&level[(size_t)y * width * 4], pixels + y * bytesPerRow, (size_t)width * 4);
+
+    size_t uncompressedSize = 0;
+    size_t compressedSize   = 0;
+    for (uint32_t i = 0; i < levelCount; ++i)
+    {
+        const uint32_t levelWidth  = std::max(width >> i, 1u);
+        const uint32_t levelHeight = std::max(height >> i, 1u);
+
+        blocks[i].resize(AAPLBCEncodedSize(format, levelWidth, levelHeight));
+        AAPLBCEncode(format, level.data(), levelWidth, levelHeight, (size_t)levelWidth * 4, blocks[i].data(), options.encode);
+
+        uncompressedSize += level.size();
+        compressedSize   += blocks[i].size();
+
+        if (i == 0 && stats)
+        {
+            std::vector<uint8_t> decoded(level.size());
+            AAPLBCDecode(format, blocks[0].data(), width, height, decoded.data(), (size_t)width * 4, options.encode.threadCount);
+            stats->basePSNR = AAPLBCComputePSNR(format, level.data(), decoded.data(), width, height, (size_t)width * 4);
+        }
+
+        if (i + 1 < levelCount)
+        {
+            downsample(level, levelWidth, levelHeight, color, alpha, next);
+            level.swap(next);
+        }
+    }
+
+    // Header, level index, data format descriptor and key/value data, then the levels from
+    //  the smallest, each aligned to its block size.
+    ktx.assign(KTX2HeaderSize + levelCount * KTX2LevelIndexSize, 0);
+    memcpy(ktx.data(), KTX2Identifier, sizeof(KTX2Identifier));
+    write32(ktx, 12, options.sRGB ? codes.vkFormatSRGB : codes.vkFormat);
+    write32(ktx, 16, 1);
+    write32(ktx, 20, width);
+    write32(ktx, 24, height);
+    write32(ktx, 36, 1);
+    write32(ktx, 40, levelCount);
+
+    const size_t descriptorOffset = ktx.size();
+    appendDescriptor(ktx, format, options.sRGB);
+    write32(ktx, 48, (uint32_t)descriptorOffset);
+    write32(ktx, 52, (uint32_t)(ktx.size() - descriptorOffset));
+
+    const size_t keyValueOffset = ktx.size();
+    append32(ktx, sizeof(WriterKey) + sizeof(WriterValue));
+    ktx.insert(ktx.end(), WriterKey, WriterKey + sizeof(WriterKey));
+    ktx.insert(ktx.end(), WriterValue, WriterValue + sizeof(WriterValue));
+    padTo(ktx, 4);
+    write32(ktx, 56, (uint32_t)keyValueOffset);
+    write32(ktx, 60, (uint32_t)(ktx.size() - keyValueOffset));
+
+    const size_t alignment = AAPLBCGetFormatInfo(format).bytesPerBlock;
+    for (uint32_t i = levelCount; i-- > 0;)
+    {
+        padTo(ktx, alignment);
+        const size_t entry = KTX2HeaderSize + i * KTX2LevelIndexSize;
+        write64(ktx, entry,      ktx.size());
+        write64(ktx, entry + 8,  blocks[i].size());
+        write64(ktx, entry + 16, blocks[i].size());
+        ktx.insert(ktx.end(), blocks[i].begin(), blocks[i].end());
+    }
+
+    if (stats)
+    {
+        stats->levelCount       = levelCount;
+        stats->uncompressedSize = uncompressedSize;
+        stats->compressedSize   = compressedSize;
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the offline texture cooker, which builds the mipmaps of an image, encodes them
+ to a BC format, and writes a KTX2 file the renderer loads without conversion.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "AAPLBCCodec.h"
+
+struct AAPLTextureCookerOptions
+{
+    AAPLBCFormat        format      = AAPLBCFormat::BC1;
+
+    // Filters the mipmaps of color channels in linear space, and writes an sRGB format.
+    //  Only BC1 and BC3 have sRGB formats.
+    bool                sRGB        = false;
+
+    // Writes the whole mipmap chain, rather than only the base level.
+    bool                mipmaps     = true;
+
+    AAPLBCEncodeOptions encode;
+};
+
+// Sizes of what the cooker wrote, and the error of its base level.
+struct AAPLTextureCookerStats
+{
+    uint32_t    levelCount;
+    size_t      uncompressedSize;   // Of the RGBA8 mipmaps.
+    size_t      compressedSize;     // Of the BC blocks of the mipmaps.
+    double      basePSNR;           // Over the channels the format stores.
+};
+
+// Cooks an RGBA8 image, `bytesPerRow` bytes apart, into `ktx` as a KTX2 file.  Each mipmap
+//  averages 2x2 pixels of the one above, clamping at odd edges.  Signed formats read and
+//  average their channels as int8_t.
+bool AAPLCookTexture(const uint8_t* pixels, uint32_t width, uint32_t height, size_t bytesPerRow,
+                     const AAPLTextureCookerOptions& options, std::vector<uint8_t>& ktx, std::string& error,
+                     AAPLTextureCookerStats* stats = nullptr);
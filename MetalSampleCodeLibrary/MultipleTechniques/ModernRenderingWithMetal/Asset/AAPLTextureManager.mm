@@ -8,13 +8,27 @@ Implementation of class tracking source (asset) textures.
 #import "AAPLTextureManager.h"
 
 #import "AAPLAsset.h"
+#import "AAPLTextureStreamer.h"
+#import "AAPLTextureStreamingScheduler.h"
 
+#import <pthread/qos.h>
+#import <memory>
 #import <unordered_map>
 #import <vector>
 #import <atomic>
 
 #define USE_SEPARATE_COMMAND_QUEUE  (1)
 #define MAX_BLIT_CMD_BUFFERS        (4)
+#define STREAMING_WORKER_COUNT      (4)
+
+// Share of the heap that streamed textures may occupy, and per frame upload limits.
+#define STREAMING_HEAP_BUDGET               (0.9)
+#define STREAMING_UPLOAD_BYTES_PER_FRAME    (64 * 1024 * 1024)
+#define STREAMING_LOADS_PER_FRAME           (32)
+
+// Writes the required mips of each frame to a trace in the temporary directory, for
+//  replaying with AAPLReplayTextureStreamingTrace.
+#define RECORD_STREAMING_TRACE      (0 && USE_TEXTURE_STREAMING)
 
 #define TRACK_STREAMING_STATS       (1 && USE_TEXTURE_STREAMING)
 
@@ -45,20 +59,25 @@ NSUInteger calculateMipSizeInBlocks(NSUInteger size, NSUInteger blockSize, NSUIn
     return MAX(blocksWide >> mip, 1U);
 }
 
-//----------------------------------------------------
+NSUInteger calculateMipSize(const AAPLTextureData* texture, NSUInteger mip)
+{
+    NSUInteger blockSize, bytesPerBlock;
+    getPixelFormatBlockDesc(texture.pixelFormat, blockSize, bytesPerBlock);
+
+    return calculateMipSizeInBlocks(texture.width, blockSize, mip)
+         * calculateMipSizeInBlocks(texture.height, blockSize, mip) * bytesPerBlock;
+}
 
-enum class RequestState
+float calculateMipTexelArea(const AAPLTextureData* texture, NSUInteger mip)
 {
-    NONE,
-    IN_QUEUE,
-    PROCESSING
-};
+    return (float)(MAX(texture.width >> mip, 1) * MAX(texture.height >> mip, 1));
+}
+
+//----------------------------------------------------
 
 struct TextureRequest
 {
-    NSUInteger      mip;
-    NSLock*         lock;
-    RequestState    state;
+    uint32_t        index;      // Index of the texture in the streamer.
 
 #if TRACK_STREAMING_STATS
     uint64_t        time;
@@ -72,6 +91,10 @@ struct TextureEntry
     NSData*                 data;
     NSUInteger              currentMip;
     NSUInteger              requiredMip;
+    float                   requiredPriority;   // Screen area covered by the required mip.
+
+    // Texture replacing `texture` once its streaming request completes.
+    id<MTLTexture>          pendingTexture;
 
 #if SUPPORT_SPARSE_TEXTURES
     std::vector<int>        mipLastAccess;
@@ -87,13 +110,6 @@ struct TextureEntry
     TextureRequest  request;
 };
 
-struct TextureUpdate
-{
-    unsigned int    hash;
-    id<MTLTexture>  texture;
-    NSUInteger      mip;
-};
-
 #if TRACK_STREAMING_STATS
 struct StatsEntry
 {
@@ -105,6 +121,7 @@ struct StatsEntry
 
 struct PendingBlit
 {
+    TextureEntry*           entry;              // Entry to update once the blit completes, or null.
     id<MTLTexture>          texture;
     id<MTLBuffer>           tempBuffer;
     id<MTLTexture>          originalTexture;
@@ -116,6 +133,41 @@ struct PendingBlit
 
 //----------------------------------------------------
 
+#if USE_TEXTURE_STREAMING
+@interface AAPLTextureManager ()
+- (void)processRequest:(uint32_t)index mipLevel:(NSUInteger)mipLevel;
+@end
+
+// Forwards requests from the streamer's worker threads to the texture manager.
+class TextureStreamingBackend : public AAPLTextureStreamer::Backend
+{
+public:
+    explicit TextureStreamingBackend(AAPLTextureManager* manager)
+        : _manager(manager) {}
+
+    void process(uint32_t texture, uint32_t mip) override
+    {
+        // Loading runs in the background so that it doesn't compete with rendering.
+        static thread_local bool qosSet = false;
+        if(!qosSet)
+        {
+            pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0);
+            qosSet = true;
+        }
+
+        @autoreleasepool
+        {
+            [_manager processRequest:texture mipLevel:mip];
+        }
+    }
+
+private:
+    __weak AAPLTextureManager* _manager;
+};
+#endif // USE_TEXTURE_STREAMING
+
+//----------------------------------------------------
+
 @implementation AAPLTextureManager
 {
     id<MTLDevice>       _device;
@@ -133,16 +185,27 @@ struct PendingBlit
     std::vector<PendingBlit>   _pendingBlits;
 
     dispatch_semaphore_t       _blitSemaphore;
-
-    NSLock*                    _lockCompletedRequests;
-
-    std::vector<TextureUpdate> _texturesUpdates;
 #endif
 
 #if USE_TEXTURE_STREAMING
     std::vector<id<MTLTexture>> _textureToDelete[MAX_FRAMES_IN_FLIGHT];
 
-    dispatch_queue_t    _loadingQueue;
+    // Entries by streamer index.  Elements of `_textures` keep their address as the map
+    //  grows, so worker threads and command buffer completion handlers reach their entry
+    //  through this instead of searching the map while the main thread modifies it.
+    //  Reserved up front so that worker threads can read it while textures are added.
+    std::vector<TextureEntry*>                  _streamingEntries;
+
+    // The streamer is declared after its backend so that its workers stop first.
+    std::unique_ptr<TextureStreamingBackend>    _streamingBackend;
+    std::unique_ptr<AAPLTextureStreamer>        _streamer;
+
+    // Decides which requests to submit, sharing texture indices with the streamer.
+    std::unique_ptr<AAPLTextureStreamingScheduler> _scheduler;
+
+#if RECORD_STREAMING_TRACE
+    FILE*               _streamingTrace;
+#endif
 
     NSThread*           _blitThread;
 
@@ -220,10 +283,26 @@ struct PendingBlit
         _maxTextureSize         = maxTextureSize;
 
 #if USE_TEXTURE_STREAMING
-        dispatch_queue_attr_t queueAttributes = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_CONCURRENT, QOS_CLASS_BACKGROUND, 0);
-        _loadingQueue = dispatch_queue_create("com.apple.texture-loading", queueAttributes);
+        _streamingEntries.reserve(AAPLTextureStreamer::MaxTextures);
+        _streamingBackend   = std::make_unique<TextureStreamingBackend>(self);
+        _streamer           = std::make_unique<AAPLTextureStreamer>(*_streamingBackend, STREAMING_WORKER_COUNT);
+
+        AAPLTextureStreamingScheduler::Config schedulerConfig;
+        schedulerConfig.budgetBytes         = (uint64_t)(_heap.size * STREAMING_HEAP_BUDGET);
+        schedulerConfig.uploadBytesPerFrame = STREAMING_UPLOAD_BYTES_PER_FRAME;
+        schedulerConfig.loadsPerFrame       = STREAMING_LOADS_PER_FRAME;
+#if SUPPORT_SPARSE_TEXTURES
+        // Sparse textures drop the mips the GPU stops accessing in `dropMipsSparse`.
+        schedulerConfig.evict               = !_useSparseTextures;
+#endif
 
-        _lockCompletedRequests  = [NSLock new];
+        _scheduler = std::make_unique<AAPLTextureStreamingScheduler>(schedulerConfig);
+
+#if RECORD_STREAMING_TRACE
+        NSString* tracePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"TextureStreaming.trace"];
+        _streamingTrace     = fopen(tracePath.fileSystemRepresentation, "w");
+        _scheduler->record(_streamingTrace);
+#endif
 
         _blitThread     = [[NSThread alloc] initWithTarget:self selector:@selector(blitThreadLoop) object:nil];
         _blitCondition  = [NSCondition new];
@@ -237,6 +316,16 @@ struct PendingBlit
     return self;
 }
 
+#if RECORD_STREAMING_TRACE
+- (void)dealloc
+{
+    _scheduler->record(nullptr);
+
+    if(_streamingTrace)
+        fclose(_streamingTrace);
+}
+#endif
+
 - (void)update:(NSUInteger)frameIndex deltaTime:(float)deltaTime forceTextureSize:(NSUInteger)forceTextureSize
 {
 #if SUPPORT_PAGE_ACCESS_COUNTERS
@@ -278,53 +367,50 @@ struct PendingBlit
     }
 #endif // SUPPORT_SPARSE_TEXTURES
 
-    [_lockCompletedRequests lock];
-
-    // Process sucessfull texture updates
-    if(_texturesUpdates.size() > 0)
-    {
-        _numRequests -= (uint)_texturesUpdates.size();
-
 #if TRACK_STREAMING_STATS
-        double tbConversionFactor = 0;
+    double tbConversionFactor = 0;
 
-        mach_timebase_info_data_t timeInfo;
-        if(mach_timebase_info(&timeInfo) == KERN_SUCCESS)
-        {
-            tbConversionFactor = timeInfo.numer / (1e6*timeInfo.denom); // ns->ms
-        }
+    mach_timebase_info_data_t timeInfo;
+    if(mach_timebase_info(&timeInfo) == KERN_SUCCESS)
+    {
+        tbConversionFactor = timeInfo.numer / (1e6*timeInfo.denom); // ns->ms
+    }
 
-        uint64_t currentTime = mach_absolute_time();
+    uint64_t currentTime = mach_absolute_time();
 #endif
 
-        for(const auto& update : _texturesUpdates)
+    // Process texture updates
+    const size_t numCompleted = _streamer->drainCompletions([&](uint32_t index, uint32_t mip, bool completed)
+    {
+        if(!completed)
         {
-            assert(_textures.find(update.hash) != _textures.end());
+            // The texture couldn't be allocated, so make room before trying again.
+            _scheduler->cancel(index, true);
+            ++_numFailedRequests;
+            return;
+        }
 
-            TextureEntry& te = _textures[update.hash];
+        _scheduler->complete(index, mip);
 
-            assert(te.request.state == RequestState::PROCESSING);
+        TextureEntry& te = *_streamingEntries[index];
 
-            // Need to keep reference to textures since GPU might still read them
-            _textureToDelete[frameIndex].push_back(te.texture);
+        // Need to keep reference to textures since GPU might still read them
+        _textureToDelete[frameIndex].push_back(te.texture);
 
-            te.texture          = update.texture;
-            te.currentMip       = update.mip;
-            te.request.state    = RequestState::NONE;
+        te.texture          = te.pendingTexture;
+        te.pendingTexture   = nil;
+        te.currentMip       = mip;
 
 #if TRACK_STREAMING_STATS
-            double latency = (currentTime - te.request.time) * tbConversionFactor;
+        double latency = (currentTime - te.request.time) * tbConversionFactor;
 
-            _statsEntries[_statsIndex].sumLatency += latency;
-            _statsEntries[_statsIndex].count++;
-            _statsEntries[_statsIndex].maxLatency = MAX(_statsEntries[_statsIndex].maxLatency, latency);
+        _statsEntries[_statsIndex].sumLatency += latency;
+        _statsEntries[_statsIndex].count++;
+        _statsEntries[_statsIndex].maxLatency = MAX(_statsEntries[_statsIndex].maxLatency, latency);
 #endif
-        }
-
-        _texturesUpdates.clear();
-    }
+    });
 
-    [_lockCompletedRequests unlock];
+    _numRequests -= (uint)numCompleted;
 
 #if TRACK_STREAMING_STATS
     _statsTimeAccum += deltaTime;
@@ -347,13 +433,16 @@ struct PendingBlit
     }
 #endif
 
-    // Submit new streaming requests
+    // Pass this frame's requirements to the scheduler
     for(auto& kv : _textures)
     {
         TextureEntry& te = kv.second;
 
         if(forceTextureSize)
-            te.requiredMip = calculateMinMip(te.desc, forceTextureSize);
+        {
+            te.requiredMip      = calculateMinMip(te.desc, forceTextureSize);
+            te.requiredPriority = calculateMipTexelArea(te.desc, te.requiredMip);
+        }
 
 #if SUPPORT_SPARSE_TEXTURES
         if(_useSparseTextures)
@@ -362,10 +451,14 @@ struct PendingBlit
             te.requiredMip = MIN(te.requiredMip, te.texture.firstMipmapInTail);
         }
 #endif
-        if(te.currentMip != te.requiredMip && te.request.mip != te.requiredMip)
-        {
-            [self request:kv.first];
-        }
+        if(te.requiredPriority > 0.0f)
+            _scheduler->setRequiredMip(te.request.index, (uint32_t)te.requiredMip, te.requiredPriority);
+    }
+
+    // Submit new streaming requests, highest priority first
+    for(const AAPLTextureStreamingScheduler::Decision& decision : _scheduler->schedule())
+    {
+        [self request:*_streamingEntries[decision.texture] mipLevel:decision.mip];
     }
 
 #if 0
@@ -377,7 +470,10 @@ struct PendingBlit
 
     // clear required mips for next frame
     for(auto& kv : _textures)
-        kv.second.requiredMip = calculateMinMip(kv.second.desc, _permanentTextureSize);
+    {
+        kv.second.requiredMip       = calculateMinMip(kv.second.desc, _permanentTextureSize);
+        kv.second.requiredPriority  = 0.0f;
+    }
 
 #endif //USE_TEXTURE_STREAMING
 }
@@ -456,11 +552,12 @@ struct PendingBlit
 #endif // SUPPORT_SPARSE_TEXTURES
 
             TextureEntry te;
-            te.texture      = texture;
-            te.desc         = textureAsset;
-            te.data         = data;
-            te.currentMip   = minMip;
-            te.requiredMip  = minMip;
+            te.texture          = texture;
+            te.desc             = textureAsset;
+            te.data             = data;
+            te.currentMip       = minMip;
+            te.requiredMip      = minMip;
+            te.requiredPriority = 0.0f;
 
 #if SUPPORT_SPARSE_TEXTURES
             if(_useSparseTextures)
@@ -476,11 +573,24 @@ struct PendingBlit
             }
 #endif // SUPPORT_SPARSE_TEXTURES
 
-            te.request.mip      = minMip;
-            te.request.lock     = [NSLock new];
-            te.request.state    = RequestState::NONE;
+#if USE_TEXTURE_STREAMING
+            te.request.index    = _streamer->addTexture((uint32_t)minMip);
 
-            _textures[textureHash] = te;
+            std::vector<uint64_t> mipSizes(textureAsset.mipmapLevelCount);
+            for(NSUInteger mip = 0; mip < mipSizes.size(); ++mip)
+                mipSizes[mip] = calculateMipSize(textureAsset, mip);
+
+            const uint32_t schedulerIndex = _scheduler->addTexture(mipSizes.data(), (uint32_t)mipSizes.size(), (uint32_t)minMip);
+            assert(schedulerIndex == te.request.index);
+            (void)schedulerIndex;
+#endif
+
+            TextureEntry& entry = _textures[textureHash];
+            entry = te;
+
+#if USE_TEXTURE_STREAMING
+            _streamingEntries.push_back(&entry);
+#endif
         }
     }
 
@@ -532,134 +642,92 @@ struct PendingBlit
 }
 
 #if USE_TEXTURE_STREAMING
-- (void)request:(unsigned int)hash
+- (void)request:(TextureEntry&)te mipLevel:(NSUInteger)mipLevel
 {
-    const auto it = _textures.find(hash);
-    if (it == _textures.end())
-        return;
-
-    TextureEntry& te = it->second;
-
 #if SUPPORT_SPARSE_TEXTURES
-    if(_useSparseTextures && te.requiredMip > te.currentMip)
-    {
-        // Dropping mips of sparse textures happens on main update.
-        return;
-    }
+    // Dropping mips of sparse textures happens on main update, so the scheduler doesn't evict them.
+    assert(!(_useSparseTextures && mipLevel > te.currentMip));
 #endif //SUPPORT_SPARSE_TEXTURES
 
-    [te.request.lock lock];
-
-    assert(te.requiredMip != te.currentMip);
-
-    bool newRequest = (te.request.state == RequestState::NONE);
+    assert(mipLevel != te.currentMip);
 
-    if(te.request.state != RequestState::PROCESSING)
+    // The scheduler only makes decisions for textures without a request.
+    if(!_streamer->request(te.request.index, (uint32_t)mipLevel))
     {
-        te.request.mip      = te.requiredMip;
-        te.request.state    = RequestState::IN_QUEUE;
+        _scheduler->cancel(te.request.index, false);
+        return;
     }
 
-    assert(te.request.mip != te.currentMip);
-
 #if TRACK_STREAMING_STATS
-    if(newRequest)
-        te.request.time = mach_absolute_time();
+    te.request.time = mach_absolute_time();
 #endif
 
-    [te.request.lock unlock];
-
-    if(!newRequest)
-        return;
-
     ++_numRequests;
+}
 
-    dispatch_async(_loadingQueue, ^
-    {
-        [te.request.lock lock];
-
-        assert(te.request.state == RequestState::IN_QUEUE);
-
-        te.request.state = RequestState::PROCESSING;
-
-        NSUInteger mipLevel = te.request.mip;
-
-        assert(mipLevel != te.currentMip);
+// Called on a streaming worker thread to load or drop the mips of a request.
+- (void)processRequest:(uint32_t)index mipLevel:(NSUInteger)mipLevel
+{
+    TextureEntry& te = *_streamingEntries[index];
 
-        [te.request.lock unlock];
+    assert(mipLevel != te.currentMip);
 
 #if SUPPORT_SPARSE_TEXTURES
-        const bool dropMips = te.currentMip < mipLevel;
+    const bool dropMips = te.currentMip < mipLevel;
 #else
-        const bool dropMips = te.texture.mipmapLevelCount > te.desc.mipmapLevelCount - mipLevel;
+    const bool dropMips = te.texture.mipmapLevelCount > te.desc.mipmapLevelCount - mipLevel;
 #endif
 
-        id<MTLTexture> newTexture;
+    id<MTLTexture> newTexture;
 
 #if SUPPORT_SPARSE_TEXTURES
-        // Dropping mips of sparse textures happens on main thread.
-        assert(!(self->_useSparseTextures && dropMips));
+    // Dropping mips of sparse textures happens on main thread.
+    assert(!(_useSparseTextures && dropMips));
 
-        if(self->_useSparseTextures)
-        {
-            newTexture = te.texture;
-        }
-        else
+    if(_useSparseTextures)
+    {
+        newTexture = te.texture;
+    }
+    else
 #endif
-        {
-            newTexture = [self createTexture:te.desc baseMip:mipLevel];
-
-            if(newTexture == nil)
-            {
-                [te.request.lock lock];
-
-                te.request.mip      = te.currentMip; // reset request so we try again later
-                te.request.state    = RequestState::NONE;
-
-                [te.request.lock unlock];
-
-                --self->_numRequests;
-                ++self->_numFailedRequests;
-
-                return;
-            }
-        }
-
-        newTexture.label = te.desc.path;
-
-        if(!newTexture.label)
-        {
-            newTexture.label = @"Unnamed Material";
-        }
+    {
+        newTexture = [self createTexture:te.desc baseMip:mipLevel];
 
-        if(dropMips)
+        if(newTexture == nil)
         {
-            id<MTLCommandBuffer> cmdBuffer = [self->_blitQueue commandBuffer];
-            cmdBuffer.label = @"Drop Mips Cmd Buffer";
-            [self dropMips:hash desc:te.desc texture:newTexture originalTexture:te.texture minMip:mipLevel currentMip:te.currentMip
-                 cmdBuffer:cmdBuffer];
+            // reset request so we try again later
+            _streamer->cancel(index, (uint32_t)te.currentMip);
 
-            [cmdBuffer addCompletedHandler:^(id<MTLCommandBuffer> _Nonnull)
-            {
-                TextureUpdate update;
-                update.hash     = hash;
-                update.texture  = newTexture;
-                update.mip      = mipLevel;
+            return;
+        }
+    }
 
-                [self->_lockCompletedRequests lock];
+    newTexture.label = te.desc.path;
 
-                self->_texturesUpdates.push_back(update);
+    if(!newTexture.label)
+    {
+        newTexture.label = @"Unnamed Material";
+    }
 
-                [self->_lockCompletedRequests unlock];
-            }];
+    if(dropMips)
+    {
+        id<MTLCommandBuffer> cmdBuffer = [_blitQueue commandBuffer];
+        cmdBuffer.label = @"Drop Mips Cmd Buffer";
+        [self dropMips:te.desc texture:newTexture originalTexture:te.texture minMip:mipLevel currentMip:te.currentMip
+             cmdBuffer:cmdBuffer];
 
-            [cmdBuffer commit];
-        }
-        else
+        [cmdBuffer addCompletedHandler:^(id<MTLCommandBuffer> _Nonnull)
         {
-            [self addMips:hash desc:te.desc texture:newTexture originalTexture:te.texture data:te.data minMip:mipLevel currentMip:te.currentMip];
-        }
-    });
+            te.pendingTexture = newTexture;
+            self->_streamer->complete(index, (uint32_t)mipLevel);
+        }];
+
+        [cmdBuffer commit];
+    }
+    else
+    {
+        [self addMips:&te texture:newTexture originalTexture:te.texture data:te.data minMip:mipLevel currentMip:te.currentMip];
+    }
 }
 
 - (void)setRequiredMip:(unsigned int)hash mipLevel:(NSUInteger)mipLevel
@@ -668,12 +736,19 @@ struct PendingBlit
     if (it == _textures.end())
         return;
 
-    NSUInteger topMip = calculateMinMip(it->second.desc, _maxTextureSize);
-    NSUInteger botMip = calculateMinMip(it->second.desc, _permanentTextureSize);
+    // Without a screen area, rank the texture as if it covered one pixel per texel.
+    [self requireMip:it->second mipLevel:mipLevel priority:calculateMipTexelArea(it->second.desc, mipLevel)];
+}
+
+- (void)requireMip:(TextureEntry&)te mipLevel:(NSUInteger)mipLevel priority:(float)priority
+{
+    NSUInteger topMip = calculateMinMip(te.desc, _maxTextureSize);
+    NSUInteger botMip = calculateMinMip(te.desc, _permanentTextureSize);
 
     mipLevel = MAX(topMip, MIN(botMip, mipLevel));
 
-    it->second.requiredMip = MIN(mipLevel, it->second.requiredMip);
+    te.requiredMip      = MIN(mipLevel, te.requiredMip);
+    te.requiredPriority = MAX(priority, te.requiredPriority);
 }
 
 - (void)setRequiredMip:(unsigned int)hash screenArea:(float)screenArea
@@ -686,7 +761,7 @@ struct PendingBlit
 
     NSUInteger mipLevel = (0.5f * log2(topMipmapTexelArea / screenArea));
 
-    [self setRequiredMip:hash mipLevel:mipLevel];
+    [self requireMip:it->second mipLevel:mipLevel priority:screenArea];
 }
 
 #endif
@@ -736,6 +811,7 @@ struct PendingBlit
     }
 
     PendingBlit pendingBlit;
+    pendingBlit.entry           = nullptr;
     pendingBlit.texture         = texture;
     pendingBlit.tempBuffer      = tempBuffer;
     pendingBlit.originalTexture = nil;
@@ -747,11 +823,13 @@ struct PendingBlit
     return pendingBlit;
 }
 
-- (void)addMips:(unsigned int)hash desc:(const AAPLTextureData*)desc
+- (void)addMips:(TextureEntry*)entry
         texture:(id<MTLTexture>)texture originalTexture:(id<MTLTexture>)originalTexture
            data:(NSData *)data
          minMip:(NSUInteger)minMip currentMip:(NSUInteger)currentMip
 {
+    const AAPLTextureData* desc = entry->desc;
+
     assert(minMip < desc.mipmapLevelCount);
 
     NSData *textureData = [NSData dataWithBytesNoCopy:(uint8_t *)data.bytes + desc.pixelDataOffset
@@ -771,6 +849,8 @@ struct PendingBlit
     PendingBlit pendingBlit = [self loadMipsToTexture:texture desc:desc textureData:textureData
                                               baseMip:minMip mipCount:mipCount mipOffset:mipOffset];
 
+    pendingBlit.entry = entry;
+
 #if SUPPORT_SPARSE_TEXTURES
     if(!_useSparseTextures)
 #endif
@@ -786,10 +866,10 @@ struct PendingBlit
     [_blitCondition unlock];
 }
 
-- (void)dropMips:(unsigned int)hash desc:(const AAPLTextureData*)desc
-                   texture:(id<MTLTexture>)texture originalTexture:(id<MTLTexture>)originalTexture
-                    minMip:(NSUInteger)minMip currentMip:(NSUInteger)currentMip
-                 cmdBuffer:(id<MTLCommandBuffer>)cmdBuffer
+- (void)dropMips:(const AAPLTextureData*)desc
+         texture:(id<MTLTexture>)texture originalTexture:(id<MTLTexture>)originalTexture
+          minMip:(NSUInteger)minMip currentMip:(NSUInteger)currentMip
+       cmdBuffer:(id<MTLCommandBuffer>)cmdBuffer
 {
     assert(texture != nil);
     assert(minMip < desc.mipmapLevelCount);
@@ -925,22 +1005,15 @@ struct PendingBlit
 
         if(firstGPUMip - te.currentMip > 0)
         {
-            [te.request.lock lock];
-
-            if(te.request.state != RequestState::NONE)
-            {
-                [te.request.lock unlock];
+            if(!_streamer->beginProcessing(te.request.index, (uint32_t)firstGPUMip))
                 continue;
-            }
-            te.request.mip      = firstGPUMip;
-            te.request.state    = RequestState::PROCESSING;
+
+            _scheduler->markInFlight(te.request.index, (uint32_t)firstGPUMip);
 
 #if TRACK_STREAMING_STATS
             te.request.time = mach_absolute_time();
 #endif
 
-            [te.request.lock unlock];
-
             ++_numRequests;
 
             // drop mips
@@ -953,16 +1026,8 @@ struct PendingBlit
 
             [cmdBuffer addCompletedHandler:^(id<MTLCommandBuffer> _Nonnull)
             {
-                TextureUpdate update;
-                update.hash     = kv.first;
-                update.texture  = te.texture;
-                update.mip      = firstGPUMip;
-
-                [self->_lockCompletedRequests lock];
-
-                self->_texturesUpdates.push_back(update);
-
-                [self->_lockCompletedRequests unlock];
+                te.pendingTexture = te.texture;
+                self->_streamer->complete(te.request.index, (uint32_t)firstGPUMip);
             }];
         }
     }
@@ -1021,24 +1086,13 @@ struct PendingBlit
 
             [cmdBuffer addCompletedHandler:^(id<MTLCommandBuffer> _Nonnull)
             {
-                [self->_lockCompletedRequests lock];
-
                 for(auto& blit : pendingBlits)
                 {
-                    TextureUpdate update;
+                    TextureEntry& te = *blit.entry;
 
-                    // NOTE: It is generally not a good idea to cast a 64-bit hash key to 32-bits which
-                    // clips out half the key since it increases the chance of hash aliasing.  However,
-                    // since these are hash keys for relatively short strings, it is unlikely to
-                    // produce such hash aliasing.
-                    update.hash     = (uint32_t)blit.desc.path.hash;
-                    update.texture  = blit.texture;
-                    update.mip      = blit.baseMip;
-
-                    self->_texturesUpdates.push_back(update);
+                    te.pendingTexture = blit.texture;
+                    self->_streamer->complete(te.request.index, (uint32_t)blit.baseMip);
                 }
-
-                [self->_lockCompletedRequests unlock];
             }];
 
             [cmdBuffer commit];
@@ -1201,7 +1255,8 @@ struct PendingBlit
     [output appendString:baseInfo];
 
 #if USE_TEXTURE_STREAMING
-    NSString* streamingInfo = [NSString stringWithFormat:@"Pending Streaming Requests: %03u\n", (uint)_numRequests];
+    NSString* streamingInfo = [NSString stringWithFormat:@"Pending Streaming Requests: %03u\nStreaming Budget: %05.1f / %.1f MiB\n",
+                               (uint)_numRequests, _scheduler->committedBytes() * mbScale, _scheduler->budgetBytes() * mbScale];
 
     [output appendString:streamingInfo];
 
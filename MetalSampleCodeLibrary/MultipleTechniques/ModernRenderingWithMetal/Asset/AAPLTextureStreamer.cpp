@@ -0,0 +1,158 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the portable core of texture streaming.
+*/
+#include "AAPLTextureStreamer.h"
+
+#include <assert.h>
+
+AAPLTextureStreamer::AAPLTextureStreamer(Backend& backend, unsigned workerCount)
+    : _backend(backend)
+    , _requests(MaxTextures)
+    , _completions(MaxTextures)
+{
+    if (workerCount == 0)
+        workerCount = 1;
+
+    for (unsigned i = 0; i < workerCount; ++i)
+        _workers.emplace_back(&AAPLTextureStreamer::workerLoop, this);
+}
+
+AAPLTextureStreamer::~AAPLTextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+
+    for (std::thread& worker : _workers)
+        worker.join();
+}
+
+uint32_t AAPLTextureStreamer::addTexture(uint32_t mip)
+{
+    assert(_textureCount < MaxTextures);
+
+    const uint32_t texture = _textureCount;
+
+    std::unique_ptr<Slot[]>& page = _pages[texture / SlotsPerPage];
+    if (!page)
+        page.reset(new Slot[SlotsPerPage]);
+
+    page[texture % SlotsPerPage].word.store(pack(RequestState::NONE, mip), std::memory_order_release);
+
+    ++_textureCount;
+
+    return texture;
+}
+
+bool AAPLTextureStreamer::request(uint32_t texture, uint32_t mip)
+{
+    Slot& s = slot(texture);
+
+    uint64_t word = s.word.load(std::memory_order_acquire);
+    for (;;)
+    {
+        const RequestState state = (RequestState)(word & 0xFFFFFFFF);
+
+        if (state == RequestState::PROCESSING)
+            return false;
+
+        // Coalesce with a queued request by replacing its mip.
+        if (s.word.compare_exchange_weak(word, pack(RequestState::IN_QUEUE, mip), std::memory_order_acq_rel))
+        {
+            if (state == RequestState::IN_QUEUE)
+                return false;
+            break;
+        }
+    }
+
+    const bool pushed = _requests.tryPush(texture);
+    assert(pushed);
+    (void)pushed;
+
+    // Sequentially consistent, pairing with the sleeping worker count in `workerLoop`.
+    ++_pendingRequests;
+
+    if (_sleepingWorkers > 0)
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _wake.notify_one();
+    }
+
+    return true;
+}
+
+bool AAPLTextureStreamer::beginProcessing(uint32_t texture, uint32_t mip)
+{
+    Slot& s = slot(texture);
+
+    uint64_t word = s.word.load(std::memory_order_acquire);
+    while ((RequestState)(word & 0xFFFFFFFF) == RequestState::NONE)
+    {
+        if (s.word.compare_exchange_weak(word, pack(RequestState::PROCESSING, mip), std::memory_order_acq_rel))
+            return true;
+    }
+
+    return false;
+}
+
+void AAPLTextureStreamer::complete(uint32_t texture, uint32_t mip)
+{
+    assert(state(texture) == RequestState::PROCESSING);
+
+    const bool pushed = _completions.tryPush({ texture, mip, true });
+    assert(pushed);
+    (void)pushed;
+}
+
+void AAPLTextureStreamer::cancel(uint32_t texture, uint32_t mip)
+{
+    assert(state(texture) == RequestState::PROCESSING);
+
+    const bool pushed = _completions.tryPush({ texture, mip, false });
+    assert(pushed);
+    (void)pushed;
+}
+
+void AAPLTextureStreamer::workerLoop()
+{
+    for (;;)
+    {
+        uint32_t texture;
+
+        if (!_requests.tryPop(texture))
+        {
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+
+            ++_sleepingWorkers;
+            _wake.wait(lock, [this] { return _stop || _pendingRequests > 0; });
+            --_sleepingWorkers;
+
+            if (_stop)
+                return;
+
+            continue;
+        }
+
+        --_pendingRequests;
+
+        // Take the request together with the latest mip it was coalesced to.
+        Slot& s = slot(texture);
+        uint64_t word = s.word.load(std::memory_order_acquire);
+        uint32_t mip;
+        for (;;)
+        {
+            assert((RequestState)(word & 0xFFFFFFFF) == RequestState::IN_QUEUE);
+
+            mip = (uint32_t)(word >> 32);
+            if (s.word.compare_exchange_weak(word, pack(RequestState::PROCESSING, mip), std::memory_order_acq_rel))
+                break;
+        }
+
+        _backend.process(texture, mip);
+    }
+}
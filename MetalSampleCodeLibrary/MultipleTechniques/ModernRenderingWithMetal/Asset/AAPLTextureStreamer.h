@@ -0,0 +1,247 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the portable core of texture streaming: the per texture request state machine,
+ the lock-free request and completion queues, and the worker pool that processes requests.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bounded lock-free queue for any number of producers and consumers.  Each cell carries
+//  a sequence number which tells producers and consumers whether the cell is theirs.
+template <typename T>
+class AAPLBoundedQueue
+{
+public:
+    // Capacity is rounded up to a power of two.
+    explicit AAPLBoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+
+        _cells.reset(new Cell[size]);
+        _mask = size - 1;
+
+        for (size_t i = 0; i < size; ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return _mask + 1; }
+
+    // Returns false if the queue is full.
+    bool tryPush(const T& value)
+    {
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = _cells[pos & _mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+            if (diff == 0)
+            {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false if the queue is empty.
+    bool tryPop(T& value)
+    {
+        size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = _cells[pos & _mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+            if (diff == 0)
+            {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value;
+                    cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T                   value;
+    };
+
+    std::unique_ptr<Cell[]>         _cells;
+    size_t                          _mask = 0;
+
+    alignas(64) std::atomic<size_t> _enqueuePos{0};
+    alignas(64) std::atomic<size_t> _dequeuePos{0};
+};
+
+//----------------------------------------------------
+
+// Tracks streaming requests for textures identified by a dense index.  The main thread
+//  submits requests, a fixed pool of workers hands them to the backend, and the backend
+//  reports completion or cancellation from any thread.  The main thread then drains both.
+//
+// A texture has at most one outstanding request:
+//  - NONE:       no request; `request` queues one.
+//  - IN_QUEUE:   waiting for a worker; further requests replace its mip level.
+//  - PROCESSING: owned by the backend until `complete` or `cancel`.
+class AAPLTextureStreamer
+{
+public:
+    enum class RequestState : uint32_t
+    {
+        NONE,
+        IN_QUEUE,
+        PROCESSING
+    };
+
+    // Performs requests.  `process` runs on a worker thread and must eventually call
+    //  `complete` or `cancel` for the texture, on any thread.
+    class Backend
+    {
+    public:
+        virtual ~Backend() {}
+        virtual void process(uint32_t texture, uint32_t mip) = 0;
+    };
+
+    static const uint32_t MaxTextures = 1 << 16;
+
+    AAPLTextureStreamer(Backend& backend, unsigned workerCount);
+    ~AAPLTextureStreamer();
+
+    AAPLTextureStreamer(const AAPLTextureStreamer&) = delete;
+    AAPLTextureStreamer& operator=(const AAPLTextureStreamer&) = delete;
+
+    // Registers a texture whose currently loaded mip is `mip` and returns its index.
+    //  Called from the main thread.
+    uint32_t addTexture(uint32_t mip);
+
+    // Requests `mip` for a texture.  Returns true if a new request was queued, or false if
+    //  the request was merged into a queued one or the texture is being processed.
+    bool request(uint32_t texture, uint32_t mip);
+
+    // Moves a texture without a request straight to PROCESSING, for work that the
+    //  caller performs itself.  Returns false if the texture already has a request.
+    bool beginProcessing(uint32_t texture, uint32_t mip);
+
+    // Reports that the request of a texture finished; its completion is delivered by
+    //  the next `drainCompletions`.
+    void complete(uint32_t texture, uint32_t mip);
+
+    // Abandons the request of a texture; the next `drainCompletions` resets its requested
+    //  mip to `mip`.
+    void cancel(uint32_t texture, uint32_t mip);
+
+    // Calls `callback(texture, mip, completed)` for each completed or cancelled request and
+    //  resets the texture to NONE.  Called from the main thread.  Returns the number of requests.
+    template <typename Callback>
+    size_t drainCompletions(Callback&& callback)
+    {
+        size_t count = 0;
+        Completion completion;
+        while (_completions.tryPop(completion))
+        {
+            callback(completion.texture, completion.mip, completion.completed);
+            slot(completion.texture).word.store(pack(RequestState::NONE, completion.mip), std::memory_order_release);
+            ++count;
+        }
+        return count;
+    }
+
+    RequestState state(uint32_t texture) const
+    {
+        return (RequestState)(slot(texture).word.load(std::memory_order_acquire) & 0xFFFFFFFF);
+    }
+
+    uint32_t requestedMip(uint32_t texture) const
+    {
+        return (uint32_t)(slot(texture).word.load(std::memory_order_acquire) >> 32);
+    }
+
+    uint32_t textureCount() const { return _textureCount; }
+
+private:
+    // State and mip are updated together, so a worker always processes the mip that was
+    //  requested when it took the request.
+    struct Slot
+    {
+        std::atomic<uint64_t> word{0};
+    };
+
+    static uint64_t pack(RequestState state, uint32_t mip)
+    {
+        return ((uint64_t)mip << 32) | (uint32_t)state;
+    }
+
+    struct Completion
+    {
+        uint32_t texture;
+        uint32_t mip;
+        bool     completed;
+    };
+
+    static const uint32_t SlotsPerPage = 256;
+
+    Slot& slot(uint32_t texture) const
+    {
+        return _pages[texture / SlotsPerPage][texture % SlotsPerPage];
+    }
+
+    void workerLoop();
+
+    Backend&                                _backend;
+
+    // Slots are allocated in pages so that adding textures never moves existing slots.
+    std::unique_ptr<Slot[]>                 _pages[MaxTextures / SlotsPerPage];
+    uint32_t                                _textureCount = 0;
+
+    // Each texture is in each queue at most once, so neither can overflow.
+    AAPLBoundedQueue<uint32_t>              _requests;
+    AAPLBoundedQueue<Completion>            _completions;
+
+    // Idle workers sleep on the condition; producers only take the mutex when a worker sleeps.
+    std::atomic<size_t>                     _pendingRequests{0};
+    std::atomic<unsigned>                   _sleepingWorkers{0};
+    std::atomic<bool>                       _stop{false};
+    std::mutex                              _sleepMutex;
+    std::condition_variable                 _wake;
+    std::vector<std::thread>                _workers;
+};
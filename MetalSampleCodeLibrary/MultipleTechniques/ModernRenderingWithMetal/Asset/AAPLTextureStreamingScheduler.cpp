@@ -0,0 +1,378 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the portable texture streaming scheduler.
+*/
+#include "AAPLTextureStreamingScheduler.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+
+AAPLTextureStreamingScheduler::AAPLTextureStreamingScheduler(const Config& config)
+    : _config(config)
+{
+}
+
+uint32_t AAPLTextureStreamingScheduler::addTexture(const uint64_t* mipSizes, uint32_t mipCount, uint32_t permanentMip)
+{
+    assert(permanentMip < mipCount);
+
+    Texture t;
+    t.firstChainByte    = (uint32_t)_chainBytes.size();
+    t.permanentMip      = permanentMip;
+    t.residentMip       = permanentMip;
+    t.inFlightMip       = permanentMip;
+    t.inFlight          = false;
+    t.requiredMip       = permanentMip;
+    t.priority          = 0.0f;
+    t.lastRequiredFrame = 0;
+
+    // Chain sizes from the coarsest mip up, with a trailing 0 for an empty chain.
+    _chainBytes.resize(_chainBytes.size() + mipCount + 1);
+    _chainBytes[t.firstChainByte + mipCount] = 0;
+    for (uint32_t mip = mipCount; mip-- > 0; )
+        _chainBytes[t.firstChainByte + mip] = _chainBytes[t.firstChainByte + mip + 1] + mipSizes[mip];
+
+    const uint32_t texture = (uint32_t)_textures.size();
+    _textures.push_back(t);
+
+    _committedBytes += footprint(t);
+
+    if (_trace)
+    {
+        fprintf(_trace, "texture %u %u", mipCount, permanentMip);
+        for (uint32_t mip = 0; mip < mipCount; ++mip)
+            fprintf(_trace, " %llu", (unsigned long long)mipSizes[mip]);
+        fprintf(_trace, "\n");
+    }
+
+    return texture;
+}
+
+void AAPLTextureStreamingScheduler::setRequiredMip(uint32_t texture, uint32_t mip, float priority)
+{
+    Texture& t = _textures[texture];
+
+    t.requiredMip       = std::min(t.requiredMip, std::min(mip, t.permanentMip));
+    t.priority          = std::max(t.priority, priority);
+    t.lastRequiredFrame = _frame;
+
+    if (_trace)
+        fprintf(_trace, "mip %u %u %.9g\n", texture, mip, priority);
+}
+
+uint64_t AAPLTextureStreamingScheduler::budgetBytes() const
+{
+    return std::min(_config.budgetBytes, _outOfMemoryBudget);
+}
+
+uint64_t AAPLTextureStreamingScheduler::footprint(const Texture& t) const
+{
+    const uint32_t mip = t.inFlight ? std::min(t.residentMip, t.inFlightMip) : t.residentMip;
+
+    return _chainBytes[t.firstChainByte + mip];
+}
+
+void AAPLTextureStreamingScheduler::markInFlight(uint32_t texture, uint32_t mip)
+{
+    Texture& t = _textures[texture];
+
+    assert(!t.inFlight && mip != t.residentMip);
+
+    _committedBytes -= footprint(t);
+
+    t.inFlight      = true;
+    t.inFlightMip   = mip;
+
+    _committedBytes += footprint(t);
+
+    if (mip > t.residentMip)
+        _releasingBytes += chainBytes(texture, t.residentMip) - chainBytes(texture, mip);
+}
+
+void AAPLTextureStreamingScheduler::finish(uint32_t texture)
+{
+    Texture& t = _textures[texture];
+
+    assert(t.inFlight);
+
+    if (t.inFlightMip > t.residentMip)
+        _releasingBytes -= chainBytes(texture, t.residentMip) - chainBytes(texture, t.inFlightMip);
+
+    _committedBytes -= footprint(t);
+
+    t.inFlight      = false;
+    t.inFlightMip   = t.residentMip;
+}
+
+void AAPLTextureStreamingScheduler::issue(uint32_t texture, uint32_t mip)
+{
+    markInFlight(texture, mip);
+
+    _decisions.push_back({ texture, mip });
+}
+
+void AAPLTextureStreamingScheduler::complete(uint32_t texture, uint32_t mip)
+{
+    finish(texture);
+
+    Texture& t = _textures[texture];
+
+    t.residentMip   = mip;
+    t.inFlightMip   = mip;
+
+    _committedBytes += footprint(t);
+}
+
+void AAPLTextureStreamingScheduler::cancel(uint32_t texture, bool outOfMemory)
+{
+    finish(texture);
+
+    _committedBytes += footprint(_textures[texture]);
+
+    if (outOfMemory)
+    {
+        _outOfMemoryBudget  = std::min(_outOfMemoryBudget, _committedBytes);
+        _outOfMemoryFrame   = _frame;
+    }
+}
+
+const std::vector<AAPLTextureStreamingScheduler::Decision>& AAPLTextureStreamingScheduler::schedule()
+{
+    _decisions.clear();
+    _loads.clear();
+    _unrequired.clear();
+    _satisfied.clear();
+
+    if (_outOfMemoryBudget != UINT64_MAX && _frame - _outOfMemoryFrame >= OutOfMemoryFrames)
+        _outOfMemoryBudget = UINT64_MAX;
+
+    for (uint32_t i = 0; i < (uint32_t)_textures.size(); ++i)
+    {
+        const Texture& t = _textures[i];
+
+        if (t.inFlight)
+            continue;
+
+        if (t.requiredMip < t.residentMip)
+            _loads.push_back(i);
+        else if (t.requiredMip > t.residentMip)
+            _unrequired.push_back(i);
+        else if (t.residentMip < t.permanentMip)
+            _satisfied.push_back(i);
+    }
+
+    // Highest priority first, then the textures missing the most mips.
+    std::sort(_loads.begin(), _loads.end(), [this](uint32_t a, uint32_t b)
+    {
+        const Texture& ta = _textures[a];
+        const Texture& tb = _textures[b];
+
+        if (ta.priority != tb.priority)
+            return ta.priority > tb.priority;
+
+        return ta.residentMip - ta.requiredMip > tb.residentMip - tb.requiredMip;
+    });
+
+    // Eviction candidates: lowest priority first, then the least recently required.
+    const auto evictionOrder = [this](uint32_t a, uint32_t b)
+    {
+        const Texture& ta = _textures[a];
+        const Texture& tb = _textures[b];
+
+        if (ta.priority != tb.priority)
+            return ta.priority < tb.priority;
+
+        return ta.lastRequiredFrame < tb.lastRequiredFrame;
+    };
+
+    if (_config.evict)
+    {
+        std::sort(_unrequired.begin(), _unrequired.end(), evictionOrder);
+        std::sort(_satisfied.begin(), _satisfied.end(), evictionOrder);
+    }
+
+    const uint64_t budget = budgetBytes();
+
+    size_t nextUnrequired = 0;
+    size_t nextSatisfied  = 0;
+
+    uint64_t uploadBytes = 0;
+    uint32_t loadCount   = 0;
+
+    for (uint32_t texture : _loads)
+    {
+        const Texture& t = _textures[texture];
+
+        if (loadCount == _config.loadsPerFrame)
+            break;
+
+        // Always allow one load so that mips larger than the cap still stream in.
+        const uint64_t size = chainBytes(texture, t.requiredMip) - chainBytes(texture, t.residentMip);
+        if (uploadBytes > 0 && uploadBytes + size > _config.uploadBytesPerFrame)
+            break;
+
+        // Drops release memory only once they complete, so a load which needs room waits for
+        //  the drops in flight and for the ones it issues here, and loads of lower priority
+        //  wait as well so that the memory goes to this one first.  Drops are only issued if
+        //  together with those in flight they make enough room for the load.
+        if (_config.evict && _committedBytes - _releasingBytes + size > budget)
+        {
+            const uint64_t needed = _committedBytes - _releasingBytes + size - budget;
+
+            uint64_t released       = 0;
+            size_t   endUnrequired  = nextUnrequired;
+            size_t   endSatisfied   = nextSatisfied;
+
+            while (released < needed)
+            {
+                if (endUnrequired < _unrequired.size())
+                {
+                    const uint32_t victim = _unrequired[endUnrequired++];
+                    released += chainBytes(victim, _textures[victim].residentMip) - chainBytes(victim, _textures[victim].requiredMip);
+                }
+                else if (endSatisfied < _satisfied.size() && _textures[_satisfied[endSatisfied]].priority < t.priority)
+                {
+                    const uint32_t victim = _satisfied[endSatisfied++];
+                    released += chainBytes(victim, _textures[victim].residentMip) - chainBytes(victim, _textures[victim].residentMip + 1);
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            if (released < needed)
+                break;
+
+            for (; nextUnrequired < endUnrequired; ++nextUnrequired)
+            {
+                const uint32_t victim = _unrequired[nextUnrequired];
+                issue(victim, _textures[victim].requiredMip);
+            }
+
+            for (; nextSatisfied < endSatisfied; ++nextSatisfied)
+            {
+                const uint32_t victim = _satisfied[nextSatisfied];
+                issue(victim, _textures[victim].residentMip + 1);
+            }
+        }
+
+        if (_committedBytes + size > budget)
+            break;
+
+        issue(texture, t.requiredMip);
+
+        uploadBytes += size;
+        ++loadCount;
+    }
+
+    for (Texture& t : _textures)
+    {
+        t.requiredMip   = t.permanentMip;
+        t.priority      = 0.0f;
+    }
+
+    if (_trace)
+        fprintf(_trace, "frame\n");
+
+    ++_frame;
+
+    return _decisions;
+}
+
+//----------------------------------------------------
+
+bool AAPLReplayTextureStreamingTrace(FILE* trace, const AAPLTextureStreamingScheduler::Config& config,
+                                     uint32_t latencyFrames, AAPLTextureStreamingReplayStats& stats)
+{
+    struct PendingDecision
+    {
+        uint32_t                                    frame;
+        AAPLTextureStreamingScheduler::Decision     decision;
+    };
+
+    memset(&stats, 0, sizeof(stats));
+
+    AAPLTextureStreamingScheduler scheduler(config);
+
+    std::deque<PendingDecision> pending;
+    std::vector<uint64_t>       mipSizes;
+
+    char tag[16];
+    while (fscanf(trace, "%15s", tag) == 1)
+    {
+        if (strcmp(tag, "texture") == 0)
+        {
+            unsigned mipCount, permanentMip;
+            if (fscanf(trace, "%u %u", &mipCount, &permanentMip) != 2 || permanentMip >= mipCount)
+                return false;
+
+            mipSizes.resize(mipCount);
+            for (uint64_t& size : mipSizes)
+            {
+                unsigned long long value;
+                if (fscanf(trace, "%llu", &value) != 1)
+                    return false;
+                size = value;
+            }
+
+            scheduler.addTexture(mipSizes.data(), mipCount, permanentMip);
+        }
+        else if (strcmp(tag, "mip") == 0)
+        {
+            unsigned texture, mip;
+            float priority;
+            if (fscanf(trace, "%u %u %f", &texture, &mip, &priority) != 3 || texture >= scheduler.textureCount())
+                return false;
+
+            scheduler.setRequiredMip(texture, mip, priority);
+        }
+        else if (strcmp(tag, "frame") == 0)
+        {
+            while (!pending.empty() && pending.front().frame + latencyFrames <= stats.frames)
+            {
+                scheduler.complete(pending.front().decision.texture, pending.front().decision.mip);
+                pending.pop_front();
+            }
+
+            for (uint32_t i = 0; i < scheduler.textureCount(); ++i)
+            {
+                if (scheduler.residentMip(i) > scheduler.requiredMip(i))
+                    stats.missingPriority += scheduler.priority(i);
+            }
+
+            for (const AAPLTextureStreamingScheduler::Decision& decision : scheduler.schedule())
+            {
+                const uint32_t residentMip = scheduler.residentMip(decision.texture);
+
+                if (decision.mip < residentMip)
+                {
+                    ++stats.loads;
+                    stats.uploadedBytes += scheduler.chainBytes(decision.texture, decision.mip)
+                                         - scheduler.chainBytes(decision.texture, residentMip);
+                }
+                else
+                {
+                    ++stats.drops;
+                }
+
+                pending.push_back({ stats.frames, decision });
+            }
+
+            stats.peakCommittedBytes = std::max(stats.peakCommittedBytes, scheduler.committedBytes());
+
+            ++stats.frames;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return feof(trace) != 0;
+}
@@ -0,0 +1,151 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the portable texture streaming scheduler, which decides each frame which mips to
+ load and which to drop within a memory budget, and for replaying recorded scheduling traces.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+// Ranks the mips required by the current frame and turns them into load and drop decisions.
+//
+// Each frame the caller reports the mip each visible texture requires together with a
+//  priority, such as the screen area it covers, then calls `schedule`.  Loads are issued in
+//  order of decreasing priority until the per frame upload caps are reached.  A load that
+//  would exceed the memory budget first drops mips nobody requires, lowest priority first,
+//  and then coarsens textures of lower priority than its own.  It's issued once those drops
+//  complete, and loads of lower priority wait for it.  Drops are only issued when they make
+//  enough room.
+//
+// Memory is accounted for by the size of the resident mip chain of each texture.  Loads
+//  count as soon as they're issued, while drops only release memory once they complete.
+class AAPLTextureStreamingScheduler
+{
+public:
+    struct Config
+    {
+        uint64_t    budgetBytes         = UINT64_MAX;   // Size all textures may occupy together.
+        uint64_t    uploadBytesPerFrame = UINT64_MAX;   // Size of mips loaded per frame.
+        uint32_t    loadsPerFrame       = UINT32_MAX;   // Number of loads issued per frame.
+        bool        evict               = true;         // Whether to drop mips to make room.
+    };
+
+    // Changes a texture to `mip`: a load when finer than its resident mip, a drop otherwise.
+    struct Decision
+    {
+        uint32_t    texture;
+        uint32_t    mip;
+    };
+
+    // Number of frames for which an allocation failure lowers the budget.
+    static const uint32_t OutOfMemoryFrames = 60;
+
+    explicit AAPLTextureStreamingScheduler(const Config& config);
+
+    // Registers a texture resident from `permanentMip`, which is never dropped.  `mipSizes`
+    //  holds the size in bytes of each of its `mipCount` mips.  Returns the texture's index.
+    uint32_t addTexture(const uint64_t* mipSizes, uint32_t mipCount, uint32_t permanentMip);
+
+    // Requires `mip` for the current frame.  Textures required several times keep the finest
+    //  mip and the highest priority; textures not required fall back to their permanent mip.
+    void setRequiredMip(uint32_t texture, uint32_t mip, float priority);
+
+    // Decides the loads and drops for the current frame and starts the next one.  Each
+    //  decision must be followed by `complete` or `cancel` for its texture.
+    const std::vector<Decision>& schedule();
+
+    // Reports a change started outside the scheduler, which then leaves the texture alone
+    //  until it completes.
+    void markInFlight(uint32_t texture, uint32_t mip);
+
+    void complete(uint32_t texture, uint32_t mip);
+
+    // Abandons a change.  A load which failed to allocate lowers the budget to the memory in
+    //  use for `OutOfMemoryFrames` frames.
+    void cancel(uint32_t texture, bool outOfMemory);
+
+    // Writes texture registrations, required mips and frame boundaries to `file` so that the
+    //  session can be replayed with `AAPLReplayTextureStreamingTrace`.  Pass nullptr to stop.
+    void record(FILE* file) { _trace = file; }
+
+    // Size of the mip chain of a texture starting at `mip`.
+    uint64_t chainBytes(uint32_t texture, uint32_t mip) const
+    {
+        return _chainBytes[_textures[texture].firstChainByte + mip];
+    }
+
+    uint32_t residentMip(uint32_t texture) const    { return _textures[texture].residentMip; }
+    uint32_t requiredMip(uint32_t texture) const    { return _textures[texture].requiredMip; }
+    float    priority(uint32_t texture) const       { return _textures[texture].priority; }
+    bool     inFlight(uint32_t texture) const       { return _textures[texture].inFlight; }
+
+    uint32_t textureCount() const                   { return (uint32_t)_textures.size(); }
+    uint64_t committedBytes() const                 { return _committedBytes; }
+    uint64_t budgetBytes() const;
+
+private:
+    struct Texture
+    {
+        uint32_t    firstChainByte;     // Index of the texture's chain sizes in `_chainBytes`.
+        uint32_t    permanentMip;
+        uint32_t    residentMip;
+        uint32_t    inFlightMip;        // Target of the change in flight.
+        bool        inFlight;
+
+        // Requirement of the current frame.
+        uint32_t    requiredMip;
+        float       priority;
+        uint32_t    lastRequiredFrame;
+    };
+
+    // Memory held by a texture: its resident chain, or the target chain of a load in flight.
+    uint64_t footprint(const Texture& t) const;
+
+    void issue(uint32_t texture, uint32_t mip);
+    void finish(uint32_t texture);
+
+    Config                  _config;
+
+    std::vector<Texture>    _textures;
+    std::vector<uint64_t>   _chainBytes;
+
+    uint64_t                _committedBytes = 0;
+    uint64_t                _releasingBytes = 0;    // Memory that drops in flight will release.
+
+    uint64_t                _outOfMemoryBudget = UINT64_MAX;
+    uint32_t                _outOfMemoryFrame = 0;
+
+    uint32_t                _frame = 0;
+
+    std::vector<Decision>   _decisions;
+    std::vector<uint32_t>   _loads;
+    std::vector<uint32_t>   _unrequired;
+    std::vector<uint32_t>   _satisfied;
+
+    FILE*                   _trace = nullptr;
+};
+
+//----------------------------------------------------
+
+struct AAPLTextureStreamingReplayStats
+{
+    uint32_t    frames;
+    uint64_t    loads;
+    uint64_t    drops;
+    uint64_t    uploadedBytes;
+    uint64_t    peakCommittedBytes;
+
+    // Sum over all frames of the priority of textures drawn coarser than they require.
+    double      missingPriority;
+};
+
+// Replays a trace written by `AAPLTextureStreamingScheduler::record` with `config`, completing
+//  each decision `latencyFrames` frames after it's made.  Returns false if the trace is malformed.
+bool AAPLReplayTextureStreamingTrace(FILE* trace, const AAPLTextureStreamingScheduler::Config& config,
+                                     uint32_t latencyFrames, AAPLTextureStreamingReplayStats& stats);
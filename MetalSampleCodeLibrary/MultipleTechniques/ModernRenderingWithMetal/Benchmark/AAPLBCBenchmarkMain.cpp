@@ -0,0 +1,339 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that measures the throughput and quality of the BC encoder on each
+ format, quality and thread count, and checks the quality against recorded minimums.
+*/
+#include "../Asset/AAPLBCCodec.h"
+#include "../Asset/AAPLTextureCooker.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --width N            Width of the synthetic images (default 2048)\n"
+            "  --height N           Height of the synthetic images (default 2048)\n"
+            "  --rgba PATH          Raw RGBA8 image of --width x --height to measure instead\n"
+            "  --threads LIST       Comma separated thread counts (default 1 and one per core)\n"
+            "  --repeat N           Encodes per measurement, keeping the fastest (default 3)\n"
+            "  --cook               Also time cooking the whole mipmap chain to KTX2\n"
+            "  --check              Only compare the PSNR of 512 x 512 images against the minimums\n",
+            program);
+}
+
+enum class ImageKind
+{
+    Smooth,     // Gradients and slow waves.
+    Detail,     // Gradients with noise, hard edges and a punch-through alpha pattern.
+    Normal,     // A tangent space normal map with x and y in red and green.
+};
+
+static const char* ImageNames[] = { "smooth", "detail", "normal" };
+
+static const char* FormatNames[] = { "BC1", "BC3", "BC4", "BC4s", "BC5", "BC5s" };
+
+// Deterministic pixels, so that the PSNR doesn't depend on the platform's random numbers.
+std::vector<uint8_t> makeImage(ImageKind kind, uint32_t width, uint32_t height)
+{
+    std::vector<uint8_t> pixels((size_t)width * height * 4);
+    uint32_t state = 0x9E3779B9u;
+    auto random = [&state]()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+    auto clamp = [](float v) { return (uint8_t)std::min(std::max(v, 0.0f), 255.0f); };
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint8_t* p = &pixels[((size_t)y * width + x) * 4];
+            const float u = x / (float)width;
+            const float v = y / (float)height;
+            switch (kind)
+            {
+                case ImageKind::Smooth:
+                    p[0] = clamp(127.5f + 127.5f * sinf(u * 7.0f + v * 3.0f));
+                    p[1] = clamp(255.0f * v);
+                    p[2] = clamp(127.5f + 127.5f * cosf(u * 11.0f));
+                    p[3] = clamp(255.0f * u);
+                    break;
+                case ImageKind::Detail:
+                {
+                    const float noise = (float)(random() % 41) - 20.0f;
+                    const float edge  = ((x / 13 + y / 17) & 1) ? 60.0f : 0.0f;
+                    p[0] = clamp(200.0f * u + noise + edge);
+                    p[1] = clamp(180.0f * v + noise);
+                    p[2] = clamp(90.0f + noise - edge);
+                    p[3] = ((x / 5 + y / 7) % 3) ? 255 : 0;
+                    break;
+                }
+                case ImageKind::Normal:
+                {
+                    const float nx = 0.5f * sinf(u * 40.0f);
+                    const float ny = 0.5f * cosf(v * 30.0f);
+                    p[0] = clamp(127.5f + 127.5f * nx);
+                    p[1] = clamp(127.5f + 127.5f * ny);
+                    p[2] = clamp(127.5f + 127.5f * sqrtf(1.0f - nx * nx - ny * ny));
+                    p[3] = 255;
+                    break;
+                }
+            }
+        }
+    }
+    return pixels;
+}
+
+// Lowest PSNR in dB of each format, quality and image at 512 x 512, a little below what the
+//  encoder reached when it was recorded.  Signed formats read the same bytes as int8_t, so
+//  values wrap around 127 and their images are harsher.
+struct Minimum
+{
+    AAPLBCFormat    format;
+    AAPLBCQuality   quality;
+    ImageKind       image;
+    double          psnr;
+};
+
+static const Minimum Minimums[] =
+{
+    { AAPLBCFormat::BC1,        AAPLBCQuality::Fast,  ImageKind::Smooth,  44.3 },
+    { AAPLBCFormat::BC1,        AAPLBCQuality::Fast,  ImageKind::Detail,  29.5 },
+    { AAPLBCFormat::BC1,        AAPLBCQuality::High,  ImageKind::Smooth,  45.6 },
+    { AAPLBCFormat::BC1,        AAPLBCQuality::High,  ImageKind::Detail,  30.4 },
+    { AAPLBCFormat::BC3,        AAPLBCQuality::Fast,  ImageKind::Smooth,  45.5 },
+    { AAPLBCFormat::BC3,        AAPLBCQuality::Fast,  ImageKind::Detail,  30.7 },
+    { AAPLBCFormat::BC3,        AAPLBCQuality::High,  ImageKind::Smooth,  46.9 },
+    { AAPLBCFormat::BC3,        AAPLBCQuality::High,  ImageKind::Detail,  31.6 },
+    { AAPLBCFormat::BC4,        AAPLBCQuality::Fast,  ImageKind::Smooth,  69.1 },
+    { AAPLBCFormat::BC4,        AAPLBCQuality::Fast,  ImageKind::Detail,  40.9 },
+    { AAPLBCFormat::BC4,        AAPLBCQuality::High,  ImageKind::Smooth,  74.0 },
+    { AAPLBCFormat::BC4,        AAPLBCQuality::High,  ImageKind::Detail,  41.5 },
+    { AAPLBCFormat::BC4Signed,  AAPLBCQuality::Fast,  ImageKind::Smooth,  61.7 },
+    { AAPLBCFormat::BC4Signed,  AAPLBCQuality::Fast,  ImageKind::Detail,  34.4 },
+    { AAPLBCFormat::BC4Signed,  AAPLBCQuality::High,  ImageKind::Smooth,  70.0 },
+    { AAPLBCFormat::BC4Signed,  AAPLBCQuality::High,  ImageKind::Detail,  36.8 },
+    { AAPLBCFormat::BC5,        AAPLBCQuality::Fast,  ImageKind::Detail,  42.6 },
+    { AAPLBCFormat::BC5,        AAPLBCQuality::Fast,  ImageKind::Normal,  56.2 },
+    { AAPLBCFormat::BC5,        AAPLBCQuality::High,  ImageKind::Detail,  43.3 },
+    { AAPLBCFormat::BC5,        AAPLBCQuality::High,  ImageKind::Normal,  57.1 },
+    { AAPLBCFormat::BC5Signed,  AAPLBCQuality::Fast,  ImageKind::Detail,  35.2 },
+    { AAPLBCFormat::BC5Signed,  AAPLBCQuality::Fast,  ImageKind::Normal,  48.7 },
+    { AAPLBCFormat::BC5Signed,  AAPLBCQuality::High,  ImageKind::Detail,  38.4 },
+    { AAPLBCFormat::BC5Signed,  AAPLBCQuality::High,  ImageKind::Normal,  53.9 },
+};
+
+double seconds(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+struct Measurement
+{
+    double encodeSeconds;
+    double decodeSeconds;
+    double psnr;
+};
+
+Measurement measure(AAPLBCFormat format, AAPLBCQuality quality, unsigned threadCount, unsigned repeat,
+                    const std::vector<uint8_t>& image, uint32_t width, uint32_t height)
+{
+    std::vector<uint8_t> blocks(AAPLBCEncodedSize(format, width, height));
+    std::vector<uint8_t> decoded(image.size());
+
+    AAPLBCEncodeOptions options;
+    options.quality     = quality;
+    options.threadCount = threadCount;
+
+    Measurement m = { INFINITY, INFINITY, 0.0 };
+    for (unsigned i = 0; i < repeat; ++i)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        AAPLBCEncode(format, image.data(), width, height, (size_t)width * 4, blocks.data(), options);
+        auto middle = std::chrono::steady_clock::now();
+        AAPLBCDecode(format, blocks.data(), width, height, decoded.data(), (size_t)width * 4, threadCount);
+        auto end = std::chrono::steady_clock::now();
+
+        m.encodeSeconds = std::min(m.encodeSeconds, seconds(begin, middle));
+        m.decodeSeconds = std::min(m.decodeSeconds, seconds(middle, end));
+    }
+    m.psnr = AAPLBCComputePSNR(format, image.data(), decoded.data(), width, height, (size_t)width * 4);
+    return m;
+}
+
+int check()
+{
+    const uint32_t size = 512;
+    int failures = 0;
+    for (const Minimum& minimum : Minimums)
+    {
+        const std::vector<uint8_t> image = makeImage(minimum.image, size, size);
+        const Measurement m = measure(minimum.format, minimum.quality, 0, 1, image, size, size);
+        const bool passed = m.psnr >= minimum.psnr;
+        failures += !passed;
+        printf("%-5s %-5s %-7s %6.2f dB (minimum %6.2f)%s\n", FormatNames[(uint32_t)minimum.format],
+               minimum.quality == AAPLBCQuality::Fast ? "fast" : "high", ImageNames[(uint32_t)minimum.image],
+               m.psnr, minimum.psnr, passed ? "" : "  FAILED");
+    }
+    printf("%d of %zu checks failed\n", failures, sizeof(Minimums) / sizeof(Minimums[0]));
+    return failures ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t width  = 2048;
+    uint32_t height = 2048;
+    unsigned repeat = 3;
+    bool     cook   = false;
+    const char* rgbaPath = nullptr;
+    std::vector<unsigned> threadCounts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(arg, "--width") && hasValue)
+            width = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--height") && hasValue)
+            height = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--rgba") && hasValue)
+            rgbaPath = argv[++i];
+        else if (!strcmp(arg, "--repeat") && hasValue)
+            repeat = (unsigned)std::max(1, atoi(argv[++i]));
+        else if (!strcmp(arg, "--threads") && hasValue)
+        {
+            for (const char* p = argv[++i]; *p; )
+            {
+                threadCounts.push_back((unsigned)std::max(1, atoi(p)));
+                p = strchr(p, ',');
+                if (!p)
+                    break;
+                ++p;
+            }
+        }
+        else if (!strcmp(arg, "--cook"))
+            cook = true;
+        else if (!strcmp(arg, "--check"))
+            return check();
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (width == 0 || height == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (threadCounts.empty())
+    {
+        threadCounts.push_back(1);
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        if (cores > 1)
+            threadCounts.push_back(cores);
+    }
+
+    // Each format measures the image it's meant for, or the given image.
+    std::vector<std::vector<uint8_t>> images;
+    std::vector<std::string> imageNames;
+    if (rgbaPath)
+    {
+        FILE* file = fopen(rgbaPath, "rb");
+        std::vector<uint8_t> image((size_t)width * height * 4);
+        if (!file || fread(image.data(), 1, image.size(), file) != image.size())
+        {
+            fprintf(stderr, "Couldn't read %u x %u RGBA8 pixels from %s\n", width, height, rgbaPath);
+            if (file)
+                fclose(file);
+            return 1;
+        }
+        fclose(file);
+        images.push_back(image);
+        imageNames.push_back(rgbaPath);
+    }
+    else
+    {
+        for (uint32_t kind = 0; kind < 3; ++kind)
+        {
+            images.push_back(makeImage((ImageKind)kind, width, height));
+            imageNames.push_back(ImageNames[kind]);
+        }
+    }
+
+    const double megapixels = (double)width * height * 1e-6;
+    printf("%u x %u, best of %u\n", width, height, repeat);
+    printf("%-5s %-5s %-8s %7s %12s %12s %9s\n", "", "", "image", "threads", "encode Mp/s", "decode Mp/s", "PSNR dB");
+
+    for (uint32_t f = 0; f < 6; ++f)
+    {
+        const AAPLBCFormat format = (AAPLBCFormat)f;
+        const size_t image = rgbaPath ? 0 : (format == AAPLBCFormat::BC5 || format == AAPLBCFormat::BC5Signed) ? 2 : 1;
+        for (uint32_t q = 0; q < 2; ++q)
+        {
+            for (unsigned threadCount : threadCounts)
+            {
+                const Measurement m = measure(format, (AAPLBCQuality)q, threadCount, repeat, images[image], width, height);
+                printf("%-5s %-5s %-8s %7u %12.1f %12.1f %9.2f\n", FormatNames[f], q ? "high" : "fast",
+                       imageNames[image].c_str(), threadCount, megapixels / m.encodeSeconds, megapixels / m.decodeSeconds, m.psnr);
+            }
+        }
+    }
+
+    if (cook)
+    {
+        printf("\nCooking %s with all mipmaps on %u threads\n", imageNames[rgbaPath ? 0 : 1].c_str(), threadCounts.back());
+        for (uint32_t f = 0; f < 6; ++f)
+        {
+            for (uint32_t q = 0; q < 2; ++q)
+            {
+                AAPLTextureCookerOptions options;
+                options.format              = (AAPLBCFormat)f;
+                options.sRGB                = options.format == AAPLBCFormat::BC1 || options.format == AAPLBCFormat::BC3;
+                options.encode.quality      = (AAPLBCQuality)q;
+                options.encode.threadCount  = threadCounts.back();
+
+                std::vector<uint8_t> ktx;
+                std::string error;
+                AAPLTextureCookerStats stats;
+                auto begin = std::chrono::steady_clock::now();
+                const bool cooked = AAPLCookTexture(images[rgbaPath ? 0 : 1].data(), width, height, (size_t)width * 4,
+                                                    options, ktx, error, &stats);
+                auto end = std::chrono::steady_clock::now();
+                if (!cooked)
+                {
+                    fprintf(stderr, "%s\n", error.c_str());
+                    return 1;
+                }
+                printf("%-5s %-5s %2u levels %8.1f ms  %6.1f MB -> %5.1f MB (%.0fx)\n", FormatNames[f], q ? "high" : "fast",
+                       stats.levelCount, seconds(begin, end) * 1e3, stats.uncompressedSize * 1e-6, ktx.size() * 1e-6,
+                       (double)stats.uncompressedSize / ktx.size());
+            }
+        }
+    }
+
+    return 0;
+}
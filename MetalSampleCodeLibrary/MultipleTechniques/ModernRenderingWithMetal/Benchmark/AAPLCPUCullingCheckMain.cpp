@@ -0,0 +1,349 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that checks the SIMD chunk culler against its scalar version for each
+ camera and test, checks the depth pyramid against a known occluder, and measures both.
+*/
+#include "../Asset/AAPLMeshFile.h"
+#include "../Renderer/RenderTech/AAPLCPUCulling.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --chunks N           Number of synthetic chunks (default 200000)\n"
+            "  --mesh PATH          Cull the chunks of a mesh file, such as bistro.dxt.bin, instead\n"
+            "  --repeat N           Culls per measurement, keeping the fastest (default 5)\n"
+            "  --seed N             Seed of the synthetic chunks (default 1)\n",
+            program);
+}
+
+struct Random
+{
+    uint32_t state;
+
+    // Returns a float in [0, 1).
+    float next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float range(float low, float high) { return low + (high - low) * next(); }
+};
+
+float dot3(const float a[3], const float b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void normalize3(float v[3])
+{
+    const float invLength = 1.0f / sqrtf(dot3(v, v));
+    v[0] *= invLength;
+    v[1] *= invLength;
+    v[2] *= invLength;
+}
+
+void cross3(const float a[3], const float b[3], float out[3])
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Column major `a` * `b`.
+void multiply(const float a[16], const float b[16], float out[16])
+{
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 4; ++r)
+            out[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+}
+
+// Left handed camera looking along `direction`, with depths from 0 at the near plane to 1 at
+//  the far plane, as AAPLCamera.  Orthographic cameras cover `viewAngle` at the target.
+void setCamera(const float position[3], const float direction[3], bool orthographic, float viewAngle,
+               float aspectRatio, float nearPlane, float farPlane, float targetDistance, AAPLCPUCullParams& params)
+{
+    float z[3] = { direction[0], direction[1], direction[2] };
+    normalize3(z);
+    const float up[3] = { 0, 1, 0 };
+    float x[3];
+    cross3(up, z, x);
+    normalize3(x);
+    float y[3];
+    cross3(z, x, y);
+
+    const float view[16] = { x[0], y[0], z[0], 0,
+                             x[1], y[1], z[1], 0,
+                             x[2], y[2], z[2], 0,
+                             -dot3(x, position), -dot3(y, position), -dot3(z, position), 1 };
+
+    float projection[16] = {};
+    if (orthographic)
+    {
+        const float ys = 1.0f / (targetDistance * tanf(viewAngle * 0.5f));
+        const float zs = 1.0f / (farPlane - nearPlane);
+        projection[0]  = ys / aspectRatio;
+        projection[5]  = ys;
+        projection[10] = zs;
+        projection[14] = -nearPlane * zs;
+        projection[15] = 1;
+    }
+    else
+    {
+        const float ys = 1.0f / tanf(viewAngle * 0.5f);
+        const float zs = farPlane / (farPlane - nearPlane);
+        projection[0]  = ys / aspectRatio;
+        projection[5]  = ys;
+        projection[10] = zs;
+        projection[11] = 1;
+        projection[14] = -nearPlane * zs;
+    }
+
+    multiply(projection, view, params.viewProjectionMatrix);
+
+    // Planes from the rows of the view projection matrix: left, right, up, down, near, far.
+    const float* vpm = params.viewProjectionMatrix;
+    for (int i = 0; i < 6; ++i)
+    {
+        const int   row  = i / 2;
+        const float sign = (i & 1) ? -1.0f : 1.0f;
+
+        float* plane = params.frustumPlanes[i];
+        for (int c = 0; c < 4; ++c)
+            plane[c] = vpm[c * 4 + 3] + sign * vpm[c * 4 + row];
+
+        const float invLength = 1.0f / sqrtf(dot3(plane, plane));
+        for (int c = 0; c < 4; ++c)
+            plane[c] *= invLength;
+    }
+
+    params.orthographic = orthographic;
+    memcpy(params.cameraPosition, position, sizeof(params.cameraPosition));
+    memcpy(params.viewDirection, z, sizeof(params.viewDirection));
+}
+
+// Scatters chunks of a few meters around the camera, with normal cones from a single
+//  direction to a full sphere.
+void createSyntheticChunks(uint32_t count, uint32_t seed, AAPLCPUCullChunks& chunks)
+{
+    Random random = { seed };
+
+    chunks.clear();
+    chunks.reserve(count);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float center[3] = { random.range(-120, 120), random.range(-30, 30), random.range(-80, 160) };
+        const float radius    = random.range(0.25f, 4.0f);
+
+        float cone[4] = { random.range(-1, 1), random.range(-1, 1), random.range(-1, 1), random.range(-0.25f, 1.0f) };
+        normalize3(cone);
+
+        float boxMin[3], boxMax[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            const float extent = radius * random.range(0.3f, 0.577f);
+            boxMin[c] = center[c] - extent;
+            boxMax[c] = center[c] + extent;
+        }
+
+        chunks.push_back(center, radius, cone, boxMin, boxMax);
+    }
+}
+
+bool loadChunks(const char* path, AAPLCPUCullChunks& chunks)
+{
+    AAPLMeshFile file;
+    if (!file.open(path))
+    {
+        fprintf(stderr, "%s\n", file.error().c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> storage;
+    const AAPLSpan<AAPLMeshFileChunk> meshChunks = file.typedBlock<AAPLMeshFileChunk>(file.chunkBlock(), storage);
+    if (meshChunks.empty())
+    {
+        fprintf(stderr, "No chunks in '%s'\n", path);
+        return false;
+    }
+
+    chunks.clear();
+    chunks.reserve(meshChunks.size());
+    for (const AAPLMeshFileChunk& chunk : meshChunks)
+        chunks.push_back(chunk.boundingSphere, chunk.boundingSphere[3], chunk.normalDistribution, chunk.boxMin, chunk.boxMax);
+    return true;
+}
+
+// A wall across the view, 40 meters ahead of the camera.
+const float WallPositions[] = { -30, -20, 0,   30, -20, 0,   30, 20, 0,   -30, 20, 0 };
+const uint32_t WallIndices[] = { 0, 1, 2,   0, 2, 3 };
+
+// Checks boxes behind, in front of and beside the wall.  Returns the number of failures.
+int checkOccluder(const AAPLCPUDepthPyramid& depthPyramid, const AAPLCPUCullParams& params)
+{
+    const struct
+    {
+        const char* name;
+        float       boxMin[3];
+        float       boxMax[3];
+        bool        occluded;
+    }
+    boxes[] =
+    {
+        { "behind the wall",    { -2, -2, 10 },  { 2, 2, 14 },    true  },
+        { "in front of it",     { -2, -2, -14 }, { 2, 2, -10 },   false },
+        { "beside it",          { 40, -2, 10 },  { 44, 2, 14 },   false },
+        { "across its edge",    { 26, -2, 10 },  { 34, 2, 14 },   false },
+    };
+
+    int failures = 0;
+    for (const auto& box : boxes)
+    {
+        if (depthPyramid.isOccluded(box.boxMin, box.boxMax, params.viewProjectionMatrix) != box.occluded)
+        {
+            printf("  A box %s is %s\n", box.name, box.occluded ? "visible" : "occluded");
+            failures++;
+        }
+    }
+    return failures;
+}
+
+template <typename Function>
+double measure(unsigned repeat, Function function)
+{
+    double best = 1e30;
+    for (unsigned r = 0; r < repeat; ++r)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    uint32_t chunkCount = 200000;
+    const char* meshPath = nullptr;
+    unsigned repeat = 5;
+    uint32_t seed = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--chunks") && i + 1 < argc)
+        {
+            chunkCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--mesh") && i + 1 < argc)
+        {
+            meshPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+        {
+            repeat = (unsigned)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = (uint32_t)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (chunkCount == 0 || repeat == 0 || seed == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    AAPLCPUCullChunks chunks;
+    if (meshPath)
+    {
+        if (!loadChunks(meshPath, chunks))
+            return 1;
+    }
+    else
+    {
+        createSyntheticChunks(chunkCount, seed, chunks);
+    }
+
+    printf("%zu chunks (ns per chunk)\n\n", chunks.size());
+    printf("  %-13s %-9s %-10s %9s %9s %9s %9s %8s %8s\n",
+           "camera", "cones", "occlusion", "visible", "frustum", "backface", "occluded", "batch", "scalar");
+
+    std::vector<uint8_t> batchResults(chunks.size());
+    std::vector<uint8_t> scalarResults(chunks.size());
+
+    const float position[3]  = { 0, 0, -40 };
+    const float direction[3] = { 0, 0, 1 };
+
+    int failures = 0;
+
+    for (bool orthographic : { false, true })
+    {
+        AAPLCPUCullParams params;
+        setCamera(position, direction, orthographic, 60.0f * (float)M_PI / 180.0f, 16.0f / 9.0f, 0.5f, 250.0f, 40.0f, params);
+
+        AAPLCPUDepthPyramid depthPyramid;
+        depthPyramid.resize(512, 288);
+        depthPyramid.clear();
+        depthPyramid.rasterizeTriangles(WallPositions, WallIndices, 2, params.viewProjectionMatrix);
+        depthPyramid.build();
+
+        failures += checkOccluder(depthPyramid, params);
+
+        for (bool cullBackfaces : { false, true })
+        {
+            for (bool occlusion : { false, true })
+            {
+                params.cullBackfaces = cullBackfaces;
+                const AAPLCPUDepthPyramid* pyramid = occlusion ? &depthPyramid : nullptr;
+
+                const double batch  = measure(repeat, [&]() { AAPLCPUCullChunksBatch(chunks, params, pyramid, batchResults.data()); });
+                const double scalar = measure(repeat, [&]() { AAPLCPUCullChunksScalar(chunks, params, pyramid, scalarResults.data()); });
+
+                size_t counts[4] = {};
+                for (uint8_t result : batchResults)
+                    counts[std::min<uint8_t>(result, 3)]++;
+
+                const bool match = batchResults == scalarResults;
+
+                printf("  %-13s %-9s %-10s %9zu %9zu %9zu %9zu %8.1f %8.1f%s\n",
+                       orthographic ? "orthographic" : "perspective", cullBackfaces ? "on" : "off", occlusion ? "on" : "off",
+                       counts[AAPLCullResultNotCulled], counts[AAPLCullResultFrustumCulled],
+                       counts[AAPLCullResultBackfaceCulled], counts[AAPLCullResultOcclusionCulled],
+                       batch * 1e9 / chunks.size(), scalar * 1e9 / chunks.size(),
+                       match ? "" : "   results differ");
+
+                if (!match)
+                    failures++;
+            }
+        }
+    }
+
+    printf("\n%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
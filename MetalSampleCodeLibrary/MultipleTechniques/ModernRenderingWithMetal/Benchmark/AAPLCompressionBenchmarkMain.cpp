@@ -0,0 +1,348 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that measures the decompression throughput of each codec, as one block
+ per stream and as chunked blocks spread over each thread count.
+*/
+#include "../Asset/AAPLCompressionCodec.h"
+#include "../Asset/AAPLMeshFile.h"
+#include "../Renderer/RenderTech/AAPLTaskPool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --size N             Megabytes of synthetic mesh streams (default 64)\n"
+            "  --mesh PATH          Measure the uncompressed streams of a mesh file instead\n"
+            "  --block-size N       Uncompressed size of each chunked block (default 65536)\n"
+            "  --threads LIST       Comma separated thread counts (default 1, 2, 4 and one per core)\n"
+            "  --repeat N           Decodes per measurement, keeping the fastest (default 5)\n",
+            program);
+}
+
+std::vector<unsigned> parseList(const char* list)
+{
+    std::vector<unsigned> values;
+    for (const char* p = list; *p; )
+    {
+        values.push_back((unsigned)strtoul(p, (char**)&p, 10));
+        if (*p == ',')
+            ++p;
+        else if (*p)
+            return {};
+    }
+    return values;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+// Streams shaped like the sample's: quantized positions and normals along a path, and
+//  triangle indices that mostly refer to recent vertices.
+std::vector<std::vector<uint8_t>> makeStreams(size_t totalSize)
+{
+    std::vector<std::vector<uint8_t>> streams;
+    uint32_t state = 0x9E3779B9u;
+    auto random = [&state]()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    const size_t vertexCount = totalSize / (2 * 12 + 8 + 3 * 4);
+
+    std::vector<float> positions(vertexCount * 3);
+    std::vector<float> normals(vertexCount * 3);
+    std::vector<float> uvs(vertexCount * 2);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        const float t = v * 0.001f;
+        positions[v * 3 + 0] = floorf((t + (random() % 64) * 1e-4f) * 1024.0f) / 1024.0f;
+        positions[v * 3 + 1] = floorf(sinf(t) * 1024.0f) / 1024.0f;
+        positions[v * 3 + 2] = floorf(((random() % 1024) * 1e-3f) * 256.0f) / 256.0f;
+        normals[v * 3 + 0] = (random() % 3) * 0.5f - 0.5f;
+        normals[v * 3 + 1] = 1.0f;
+        normals[v * 3 + 2] = 0.0f;
+        uvs[v * 2 + 0] = (v % 256) / 256.0f;
+        uvs[v * 2 + 1] = (random() % 16) / 16.0f;
+    }
+
+    std::vector<uint32_t> indices(vertexCount * 3);
+    for (size_t i = 0; i < indices.size(); ++i)
+        indices[i] = (uint32_t)std::min<size_t>(vertexCount - 1, i / 3 + random() % 32);
+
+    const auto bytes = [](const void* data, size_t size)
+    {
+        return std::vector<uint8_t>((const uint8_t*)data, (const uint8_t*)data + size);
+    };
+    streams.push_back(bytes(positions.data(), positions.size() * sizeof(float)));
+    streams.push_back(bytes(normals.data(), normals.size() * sizeof(float)));
+    streams.push_back(bytes(uvs.data(), uvs.size() * sizeof(float)));
+    streams.push_back(bytes(indices.data(), indices.size() * sizeof(uint32_t)));
+    return streams;
+}
+
+bool loadStreams(const char* path, std::vector<std::vector<uint8_t>>& streams)
+{
+    AAPLMeshFile file;
+    if (!file.open(path))
+    {
+        fprintf(stderr, "%s\n", file.error().c_str());
+        return false;
+    }
+
+    const AAPLMeshFileBlock blocks[] =
+    {
+        file.vertexBlock(), file.normalBlock(), file.tangentBlock(), file.uvBlock(), file.indexBlock(),
+        file.chunkBlock(), file.meshBlock(), file.materialBlock(),
+    };
+    for (const AAPLMeshFileBlock& block : blocks)
+    {
+        streams.emplace_back(block.uncompressedSize());
+        if (!AAPLMeshFile::decompress(block, streams.back().data(), streams.back().size()))
+        {
+            fprintf(stderr, "Could not uncompress '%s'\n", path);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Streams compressed one way, ready to decode.
+struct Encoded
+{
+    std::vector<std::vector<uint8_t>>   blocks;     // AAPLCompressionHeader and payload.
+    size_t                              compressedSize = 0;
+};
+
+// Compresses each stream as one block, as the sample's files did before chunking.
+bool encodeWhole(const AAPLCompressionCodec& codec, const std::vector<std::vector<uint8_t>>& streams, Encoded& encoded)
+{
+    for (const std::vector<uint8_t>& stream : streams)
+    {
+        std::vector<uint8_t> block(sizeof(AAPLCompressionHeader) + stream.size() + stream.size() / 2 + 4096);
+        AAPLCompressionHeader header = {};
+        header.compressionMode  = codec.mode();
+        header.uncompressedSize = stream.size();
+        header.compressedSize   = codec.encode(stream.data(), stream.size(), block.data() + sizeof(header), block.size() - sizeof(header));
+        if (header.compressedSize == 0 && !stream.empty())
+            return false;
+
+        memcpy(block.data(), &header, sizeof(header));
+        block.resize(sizeof(header) + header.compressedSize);
+        encoded.compressedSize += header.compressedSize;
+        encoded.blocks.push_back(std::move(block));
+    }
+    return true;
+}
+
+bool encodeChunked(const AAPLCompressionCodec& codec, const std::vector<std::vector<uint8_t>>& streams,
+                   uint32_t blockSize, Encoded& encoded)
+{
+    for (const std::vector<uint8_t>& stream : streams)
+    {
+        std::vector<uint8_t> block;
+        if (!AAPLCompressChunked(codec.mode(), stream.data(), stream.size(), blockSize, block))
+            return false;
+        encoded.compressedSize += block.size() - sizeof(AAPLCompressionHeader);
+        encoded.blocks.push_back(std::move(block));
+    }
+    return true;
+}
+
+// Returns the fastest of `repeat` decodes of all streams, in seconds, or a negative value if
+//  the decoded streams don't match.
+double measureDecode(const Encoded& encoded, const std::vector<std::vector<uint8_t>>& streams,
+                     AAPLTaskPool* pool, unsigned repeat)
+{
+    std::vector<std::vector<uint8_t>> decoded(streams.size());
+    std::vector<AAPLDecompressRequest> requests(streams.size());
+    for (size_t i = 0; i < streams.size(); ++i)
+    {
+        decoded[i].resize(streams[i].size());
+        memcpy(&requests[i].header, encoded.blocks[i].data(), sizeof(AAPLCompressionHeader));
+        requests[i].src = encoded.blocks[i].data() + sizeof(AAPLCompressionHeader);
+        requests[i].dst = decoded[i].data();
+    }
+
+    double best = 1e30;
+    for (unsigned r = 0; r < repeat; ++r)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        bool success;
+        if (pool)
+        {
+            success = AAPLDecompressBlocks(requests.data(), requests.size(), pool);
+        }
+        else
+        {
+            // One codec call per stream on this thread, like compression_decode_buffer.
+            success = true;
+            for (const AAPLDecompressRequest& request : requests)
+            {
+                const AAPLCompressionCodec* codec = AAPLCompressionCodecForMode(request.header.compressionMode);
+                success = success && codec->decode((const uint8_t*)request.src, request.header.compressedSize,
+                                                   (uint8_t*)request.dst, request.header.uncompressedSize);
+            }
+        }
+        best = std::min(best, seconds(begin, std::chrono::steady_clock::now()));
+        if (!success)
+            return -1;
+    }
+
+    return decoded == streams ? best : -1;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    size_t size = 64;
+    const char* meshPath = nullptr;
+    uint32_t blockSize = 65536;
+    std::vector<unsigned> threadCounts;
+    unsigned repeat = 5;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--size") && i + 1 < argc)
+        {
+            size = (size_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--mesh") && i + 1 < argc)
+        {
+            meshPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--block-size") && i + 1 < argc)
+        {
+            blockSize = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            threadCounts = parseList(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+        {
+            repeat = (unsigned)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (threadCounts.empty())
+    {
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned count : { 1u, 2u, 4u, cores })
+        {
+            if (count <= cores && std::find(threadCounts.begin(), threadCounts.end(), count) == threadCounts.end())
+                threadCounts.push_back(count);
+        }
+    }
+
+    if (size == 0 || blockSize == 0 || repeat == 0 || std::count(threadCounts.begin(), threadCounts.end(), 0u))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::vector<uint8_t>> streams;
+    if (meshPath)
+    {
+        if (!loadStreams(meshPath, streams))
+            return 1;
+    }
+    else
+    {
+        streams = makeStreams(size << 20);
+    }
+
+    size_t totalSize = 0;
+    for (const std::vector<uint8_t>& stream : streams)
+        totalSize += stream.size();
+
+    printf("%.1f MB in %zu streams, chunked blocks of %u bytes (MB/s of uncompressed data)\n\n",
+           totalSize / 1e6, streams.size(), blockSize);
+
+    printf("  %-8s %7s %10s", "codec", "ratio", "one call");
+    for (unsigned count : threadCounts)
+        printf(" %7u thr", count);
+    printf("\n");
+
+    std::vector<std::unique_ptr<AAPLTaskPool>> pools;
+    for (unsigned count : threadCounts)
+        pools.emplace_back(new AAPLTaskPool(count));
+
+    int failures = 0;
+
+    const uint32_t modes[] =
+    {
+        AAPLCompressionModeLZ4Raw, AAPLCompressionModeLZ4, AAPLCompressionModeZLIB,
+        AAPLCompressionModeLZFSE, AAPLCompressionModeLZMA, AAPLCompressionModeZSTD,
+    };
+    for (uint32_t mode : modes)
+    {
+        const AAPLCompressionCodec* codec = AAPLCompressionCodecForMode(mode);
+        if (!codec || !codec->canEncode())
+        {
+            printf("  %-8s %s\n", AAPLCompressionModeName(mode), codec ? "can only decode on this platform" : "not available on this platform");
+            continue;
+        }
+
+        Encoded whole;
+        Encoded chunked;
+        if (!encodeWhole(*codec, streams, whole) || !encodeChunked(*codec, streams, blockSize, chunked))
+        {
+            printf("  %-8s FAILED to encode\n", codec->name());
+            failures++;
+            continue;
+        }
+
+        const double single = measureDecode(whole, streams, nullptr, repeat);
+        printf("  %-8s %7.2f %10.0f", codec->name(), totalSize / (double)std::max<size_t>(chunked.compressedSize, 1),
+               single > 0 ? totalSize / single / 1e6 : 0.0);
+
+        for (const std::unique_ptr<AAPLTaskPool>& pool : pools)
+        {
+            const double time = measureDecode(chunked, streams, pool.get(), repeat);
+            if (time < 0)
+            {
+                printf(" %11s", "FAILED");
+                failures++;
+            }
+            else
+            {
+                printf(" %11.0f", totalSize / time / 1e6);
+            }
+        }
+        printf("\n");
+
+        if (single < 0)
+            failures++;
+    }
+
+    printf("\n%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,708 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that checks the frame graph's culling, memory aliasing, waits, levels
+ and encoding groups against brute force versions, on the renderer's configurations and on
+ random graphs, and prints the transient memory of each configuration.
+*/
+#include "../Renderer/RenderTech/AAPLFrameGraph.h"
+#include "../Renderer/RenderTech/AAPLRendererFrameGraph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --graphs N           Random graphs to check (default 20000)\n"
+            "  --seed N             Seed of the random graphs (default 1)\n"
+            "  --verbose            Print the schedule of each configuration\n",
+            program);
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int failures = 0;
+
+void check(bool condition, const char* what, const std::string& context)
+{
+    if (!condition)
+    {
+        printf("  FAILED: %s (%s)\n", what, context.c_str());
+        failures++;
+    }
+}
+
+struct Random
+{
+    uint32_t state;
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Returns an integer in [0, count).
+    uint32_t below(uint32_t count) { return next() % count; }
+
+    bool chance(uint32_t percent) { return below(100) < percent; }
+};
+
+const uint32_t InvalidIndex = AAPLFrameGraph::InvalidIndex;
+
+// MARK: - Brute force checks
+
+// Accesses of every pass of `graph`, with the producer of each read found again from the
+//  declaration order rather than taken from the graph.
+struct DeclaredAccess
+{
+    uint32_t    pass;
+    uint32_t    resource;
+    bool        read;
+    bool        write;
+    uint32_t    producer;
+};
+
+std::vector<DeclaredAccess> declaredAccesses(const AAPLFrameGraph& graph)
+{
+    std::vector<DeclaredAccess> result;
+    std::vector<uint32_t> lastWriter(graph.resourceCount(), InvalidIndex);
+
+    for (uint32_t pass = 0; pass < graph.passCount(); ++pass)
+    {
+        size_t count;
+        const AAPLFrameGraph::Access* accesses = graph.accesses(pass, count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const AAPLFrameGraph::Access& a = accesses[i];
+            result.push_back({ pass, a.resource, a.read, a.write, a.read ? lastWriter[a.resource] : InvalidIndex });
+        }
+
+        for (size_t i = 0; i < count; ++i)
+            if (accesses[i].write)
+                lastWriter[accesses[i].resource] = pass;
+    }
+    return result;
+}
+
+// Keeps the passes with side effects or writes to outputs, and the producers of what every
+//  kept pass reads, until nothing changes.
+std::vector<bool> expectedLive(const AAPLFrameGraph& graph, const std::vector<DeclaredAccess>& accesses)
+{
+    std::vector<bool> live(graph.passCount(), false);
+    for (uint32_t pass = 0; pass < graph.passCount(); ++pass)
+        live[pass] = graph.hasSideEffects(pass);
+    for (const DeclaredAccess& a : accesses)
+        if (a.write && graph.isOutput(a.resource))
+            live[a.pass] = true;
+
+    for (bool changed = true; changed; )
+    {
+        changed = false;
+        for (const DeclaredAccess& a : accesses)
+        {
+            if (live[a.pass] && a.read && a.producer != InvalidIndex && !live[a.producer])
+            {
+                live[a.producer] = true;
+                changed = true;
+            }
+        }
+    }
+    return live;
+}
+
+// Whether pass `j` of the schedule waits for pass `i`, directly or not, as `after[j][i]`.
+std::vector<std::vector<bool>> waitClosure(const AAPLFrameGraph& graph)
+{
+    const std::vector<uint32_t>& schedule = graph.schedule();
+    const size_t count = schedule.size();
+
+    std::vector<uint32_t> scheduleIndex(graph.passCount(), InvalidIndex);
+    for (size_t i = 0; i < count; ++i)
+        scheduleIndex[schedule[i]] = (uint32_t)i;
+
+    std::vector<std::vector<bool>> after(count, std::vector<bool>(count, false));
+    for (size_t j = 0; j < count; ++j)
+    {
+        size_t waitCount;
+        const uint32_t* waits = graph.waits(schedule[j], waitCount);
+        for (size_t w = 0; w < waitCount; ++w)
+        {
+            const uint32_t i = scheduleIndex[waits[w]];
+            if (i >= j)
+                continue;   // Checked by the caller.
+
+            after[j][i] = true;
+            for (size_t k = 0; k < count; ++k)
+                if (after[i][k])
+                    after[j][k] = true;
+        }
+    }
+    return after;
+}
+
+// Checks a compiled graph against brute force versions of each step of `compile`.
+void checkGraph(AAPLFrameGraph& graph, const std::string& context)
+{
+    const std::vector<DeclaredAccess> accesses = declaredAccesses(graph);
+    const std::vector<uint32_t>& schedule = graph.schedule();
+    const uint32_t count = (uint32_t)schedule.size();
+
+    // Culling.
+    const std::vector<bool> live = expectedLive(graph, accesses);
+
+    std::vector<uint32_t> expectedSchedule;
+    for (uint32_t pass = 0; pass < graph.passCount(); ++pass)
+    {
+        check(graph.isLive(pass) == live[pass], "culling", context + ", " + graph.passName(pass));
+        if (live[pass])
+            expectedSchedule.push_back(pass);
+    }
+    check(schedule == expectedSchedule, "schedule in declaration order", context);
+    if (schedule != expectedSchedule)
+        return;
+
+    std::vector<uint32_t> scheduleIndex(graph.passCount(), InvalidIndex);
+    for (uint32_t i = 0; i < count; ++i)
+        scheduleIndex[schedule[i]] = i;
+
+    std::vector<bool> accessesResource(count * graph.resourceCount(), false);
+    std::vector<bool> writesResource(count * graph.resourceCount(), false);
+    for (const DeclaredAccess& a : accesses)
+    {
+        if (!live[a.pass])
+            continue;
+        accessesResource[scheduleIndex[a.pass] * graph.resourceCount() + a.resource] = true;
+        if (a.write)
+            writesResource[scheduleIndex[a.pass] * graph.resourceCount() + a.resource] = true;
+    }
+
+    // Placements: the schedule range using each resource, and no overlap in memory between
+    //  transient resources alive at the same time.
+    std::vector<uint32_t> placed;
+    for (uint32_t resource = 0; resource < graph.resourceCount(); ++resource)
+    {
+        const std::string resourceContext = context + ", " + graph.resourceName(resource);
+        const AAPLFrameGraph::Placement& placement = graph.placement(resource);
+
+        uint32_t first = InvalidIndex;
+        uint32_t last  = InvalidIndex;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (accessesResource[i * graph.resourceCount() + resource])
+            {
+                first = std::min(first, i);
+                last = i;
+            }
+        }
+
+        check(placement.firstPass == first && placement.lastPass == last, "placement lifetime", resourceContext);
+
+        if (graph.resourceType(resource) == AAPLFrameGraph::ResourceTypeMemoryless)
+            check(first == last, "memoryless used by one pass", resourceContext);
+
+        const bool transient = graph.resourceType(resource) == AAPLFrameGraph::ResourceTypeTransient;
+        if (!transient || first == InvalidIndex)
+        {
+            check(placement.slot == InvalidIndex, "no slot outside of the heap", resourceContext);
+            continue;
+        }
+
+        check(placement.size == graph.resourceSize(resource), "placement size", resourceContext);
+        check(placement.offset % graph.resourceAlignment(resource) == 0, "placement alignment", resourceContext);
+        check(placement.offset + placement.size <= graph.heapSize(), "placement within the heap", resourceContext);
+        check(placement.slot < graph.slotCount(), "placement slot", resourceContext);
+        placed.push_back(resource);
+    }
+
+    uint64_t unaliasedSize = 0;
+    for (uint32_t a : placed)
+    {
+        unaliasedSize += graph.resourceSize(a);
+        for (uint32_t b : placed)
+        {
+            const AAPLFrameGraph::Placement& pa = graph.placement(a);
+            const AAPLFrameGraph::Placement& pb = graph.placement(b);
+            if (a >= b || pa.lastPass < pb.firstPass || pb.lastPass < pa.firstPass)
+                continue;
+
+            check(pa.offset + pa.size <= pb.offset || pb.offset + pb.size <= pa.offset, "live resources don't alias",
+                  context + ", " + graph.resourceName(a) + " and " + graph.resourceName(b));
+        }
+    }
+    check(graph.unaliasedSize() >= unaliasedSize, "unaliased size", context);
+
+    // Interval colouring uses as many slots as there are resources alive at once.
+    uint32_t mostAlive = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t alive = 0;
+        for (uint32_t resource : placed)
+            alive += graph.placement(resource).firstPass <= i && i <= graph.placement(resource).lastPass;
+        mostAlive = std::max(mostAlive, alive);
+    }
+    check(graph.slotCount() == mostAlive, "slot count", context);
+
+    // Waits.  Passes that access a resource, one of them writing it, run in declaration order,
+    //  as do the users of resources whose memory overlaps, one after the other.
+    for (uint32_t j = 0; j < count; ++j)
+    {
+        size_t waitCount;
+        const uint32_t* waits = graph.waits(schedule[j], waitCount);
+        for (size_t w = 0; w < waitCount; ++w)
+            check(waits[w] < graph.passCount() && scheduleIndex[waits[w]] < j, "waits for an earlier pass", context);
+    }
+
+    const std::vector<std::vector<bool>> after = waitClosure(graph);
+    std::vector<std::vector<bool>> required(count, std::vector<bool>(count, false));
+
+    for (uint32_t resource = 0; resource < graph.resourceCount(); ++resource)
+    {
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            if (!accessesResource[j * graph.resourceCount() + resource])
+                continue;
+            for (uint32_t i = 0; i < j; ++i)
+            {
+                if (accessesResource[i * graph.resourceCount() + resource] &&
+                    (writesResource[i * graph.resourceCount() + resource] || writesResource[j * graph.resourceCount() + resource]))
+                {
+                    required[j][i] = true;
+                }
+            }
+        }
+    }
+
+    for (uint32_t a : placed)
+    {
+        for (uint32_t b : placed)
+        {
+            const AAPLFrameGraph::Placement& pa = graph.placement(a);
+            const AAPLFrameGraph::Placement& pb = graph.placement(b);
+            const bool overlap = pa.offset < pb.offset + pb.size && pb.offset < pa.offset + pa.size;
+            if (a == b || !overlap || pa.lastPass >= pb.firstPass)
+                continue;
+
+            for (uint32_t i = pa.firstPass; i <= pa.lastPass; ++i)
+                for (uint32_t j = pb.firstPass; j <= pb.lastPass; ++j)
+                    if (accessesResource[i * graph.resourceCount() + a] && accessesResource[j * graph.resourceCount() + b])
+                        required[j][i] = true;
+        }
+    }
+
+    // The closure of the required orderings, which the waits must match exactly.
+    for (uint32_t j = 0; j < count; ++j)
+        for (uint32_t i = j; i-- > 0; )
+            if (required[j][i])
+                for (uint32_t k = 0; k < i; ++k)
+                    if (required[i][k])
+                        required[j][k] = true;
+
+    bool ordered = true;
+    for (uint32_t j = 0; j < count; ++j)
+        for (uint32_t i = 0; i < j; ++i)
+            ordered &= required[j][i] == after[j][i];
+    check(ordered, "waits order exactly the dependent passes", context);
+
+    // Transitive reduction: no pass waits for a pass that another of its waits already waits for.
+    for (uint32_t j = 0; j < count; ++j)
+    {
+        size_t waitCount;
+        const uint32_t* waits = graph.waits(schedule[j], waitCount);
+
+        for (size_t w = 0; w < waitCount; ++w)
+        {
+            for (size_t v = 0; v < waitCount; ++v)
+            {
+                if (v != w)
+                    check(!after[scheduleIndex[waits[v]]][scheduleIndex[waits[w]]], "waits are reduced",
+                          context + ", " + graph.passName(schedule[j]));
+            }
+        }
+    }
+
+    // Signals, and levels one above the deepest wait.
+    uint32_t levelCount = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        bool waitedFor = false;
+        for (uint32_t j = i + 1; j < count && !waitedFor; ++j)
+        {
+            size_t waitCount;
+            const uint32_t* waits = graph.waits(schedule[j], waitCount);
+            waitedFor = std::find(waits, waits + waitCount, schedule[i]) != waits + waitCount;
+        }
+        check(graph.signals(schedule[i]) == waitedFor, "signals", context + ", " + graph.passName(schedule[i]));
+
+        uint32_t level = 0;
+        for (uint32_t k = 0; k < i; ++k)
+            if (after[i][k])
+                level = std::max(level, graph.level(schedule[k]) + 1);
+        check(graph.level(schedule[i]) == level, "level", context + ", " + graph.passName(schedule[i]));
+        levelCount = std::max(levelCount, level + 1);
+
+        for (uint32_t k = 0; k < i; ++k)
+            if (graph.level(schedule[k]) == graph.level(schedule[i]))
+                check(!after[i][k], "passes of a level are independent", context);
+    }
+    check(graph.levelCount() == levelCount, "level count", context);
+
+    // Encoding groups: runs of the schedule in order, none much costlier than the average.
+    float totalCost = 0.0f;
+    float largestCost = 0.0f;
+    for (uint32_t pass : schedule)
+    {
+        totalCost += graph.cost(pass);
+        largestCost = std::max(largestCost, graph.cost(pass));
+    }
+
+    std::vector<uint32_t> groupBegins;
+    for (uint32_t maxGroups = 1; maxGroups <= count + 1; ++maxGroups)
+    {
+        graph.encodingGroups(maxGroups, groupBegins);
+        const std::string groupContext = context + ", " + std::to_string(maxGroups) + " groups";
+
+        // An empty schedule has no groups, only its length.
+        check(groupBegins.size() >= (count ? 2u : 1u) && groupBegins.front() == 0 && groupBegins.back() == count,
+              "groups cover the schedule", groupContext);
+        check(groupBegins.size() - 1 <= std::max(1u, std::min(maxGroups, count)), "group count", groupContext);
+        for (size_t g = 0; g + 1 < groupBegins.size(); ++g)
+        {
+            check(groupBegins[g] < groupBegins[g + 1] || count == 0, "groups aren't empty", groupContext);
+
+            float cost = 0.0f;
+            for (uint32_t i = groupBegins[g]; i < groupBegins[g + 1] && i < count; ++i)
+                cost += graph.cost(schedule[i]);
+            const uint32_t groupCount = std::max(1u, std::min(maxGroups, count));
+            check(cost <= totalCost / groupCount + largestCost + 1e-3f, "group cost", groupContext);
+        }
+    }
+
+    // Execution runs the live passes in schedule order.
+    std::vector<uint32_t> executed;
+    for (uint32_t pass = 0; pass < graph.passCount(); ++pass)
+        graph.setExecute(pass, [&executed](uint32_t pass) { executed.push_back(pass); });
+    graph.execute();
+    check(executed == schedule, "execution order", context);
+    for (uint32_t pass = 0; pass < graph.passCount(); ++pass)
+        graph.setExecute(pass, nullptr);
+}
+
+// MARK: - Random graphs
+
+// Declares a random graph whose transient resources are always written before they're read.
+void buildRandomGraph(Random& random, AAPLFrameGraph& graph, std::vector<std::string>& names)
+{
+    graph.clear();
+
+    const uint32_t resourceCount = 1 + random.below(16);
+    const uint32_t passCount = 1 + random.below(32);
+
+    names.clear();
+    names.reserve(resourceCount + passCount);
+
+    for (uint32_t r = 0; r < resourceCount; ++r)
+    {
+        names.push_back("R" + std::to_string(r));
+        const uint32_t kind = random.below(10);
+        if (kind < 6)
+        {
+            const uint64_t alignment = 256ull << random.below(9);
+            graph.addTransient(names.back().c_str(), (1 + random.below(64)) * 4096ull + random.below(3) * 256, alignment);
+        }
+        else if (kind < 8)
+        {
+            graph.addMemoryless(names.back().c_str());
+        }
+        else
+        {
+            graph.importResource(names.back().c_str(), random.chance(50));
+        }
+    }
+
+    // Resources written by earlier passes, which a pass may read.  A pass that writes and then
+    //  reads a resource modifies it, reading what the earlier passes wrote.
+    std::vector<bool> written(resourceCount, false);
+    std::vector<bool> writtenByPass(resourceCount, false);
+    std::vector<bool> memorylessUsed(resourceCount, false);
+
+    for (uint32_t p = 0; p < passCount; ++p)
+    {
+        names.push_back("P" + std::to_string(p));
+        const uint32_t pass = graph.addPass(names.back().c_str(), (AAPLFrameGraph::PassType)random.below(3));
+        graph.setCost(pass, 0.5f + random.below(8));
+        if (random.chance(25))
+            graph.setSideEffects(pass);
+
+        std::fill(writtenByPass.begin(), writtenByPass.end(), false);
+
+        const uint32_t accessCount = 1 + random.below(4);
+        for (uint32_t a = 0; a < accessCount; ++a)
+        {
+            const uint32_t resource = random.below(resourceCount);
+            const AAPLFrameGraph::ResourceType type = graph.resourceType(resource);
+
+            // Memoryless resources belong to a single pass.
+            if (type == AAPLFrameGraph::ResourceTypeMemoryless)
+            {
+                if (memorylessUsed[resource])
+                    continue;
+                memorylessUsed[resource] = true;
+            }
+
+            const bool readable = written[resource] || type == AAPLFrameGraph::ResourceTypeImported;
+            const uint32_t kind = readable ? random.below(3) : 1;
+            if (kind == 0)
+                graph.read(pass, resource);
+            else if (kind == 1)
+                graph.write(pass, resource);
+            else
+                graph.modify(pass, resource);
+
+            writtenByPass[resource] = writtenByPass[resource] || kind != 0;
+        }
+
+        for (uint32_t r = 0; r < resourceCount; ++r)
+            written[r] = written[r] || writtenByPass[r];
+    }
+}
+
+void checkErrors()
+{
+    AAPLFrameGraph graph;
+
+    uint32_t resource = graph.addTransient("Target", 4096);
+    uint32_t pass = graph.addPass("Read", AAPLFrameGraph::PassTypeRender);
+    graph.read(pass, resource);
+    graph.setSideEffects(pass);
+    check(!graph.compile() && !graph.error().empty(), "read before write fails", "errors");
+
+    graph.clear();
+    resource = graph.addMemoryless("Tile");
+    pass = graph.addPass("Write", AAPLFrameGraph::PassTypeRender);
+    graph.write(pass, resource);
+    pass = graph.addPass("Read", AAPLFrameGraph::PassTypeRender);
+    graph.read(pass, resource);
+    graph.setSideEffects(pass);
+    check(!graph.compile(), "memoryless shared by passes fails", "errors");
+
+    graph.clear();
+    resource = graph.addTransient("Target", 4096);
+    const uint32_t first = graph.addPass("First", AAPLFrameGraph::PassTypeRender);
+    graph.addPass("Second", AAPLFrameGraph::PassTypeRender);
+    graph.write(first, resource);
+    check(!graph.compile(), "access to an earlier pass fails", "errors");
+
+    // A memoryless resource of a culled pass doesn't count.
+    graph.clear();
+    resource = graph.addMemoryless("Tile");
+    const uint32_t output = graph.importResource("Drawable", true);
+    pass = graph.addPass("Unused", AAPLFrameGraph::PassTypeRender);
+    graph.write(pass, resource);
+    pass = graph.addPass("Present", AAPLFrameGraph::PassTypeRender);
+    graph.write(pass, output);
+    check(graph.compile() && graph.schedule().size() == 1 && !graph.isLive(0), "culled pass", "errors");
+
+    graph.clear();
+    check(graph.compile() && graph.schedule().empty() && graph.heapSize() == 0, "empty graph", "errors");
+}
+
+// MARK: - Renderer configurations
+
+struct Configuration
+{
+    const char*                     name;
+    AAPLRendererFrameGraphOptions   options;
+};
+
+std::vector<Configuration> rendererConfigurations()
+{
+    std::vector<Configuration> configurations;
+
+    AAPLRendererFrameGraphOptions options;
+    configurations.push_back({ "Default", options });
+
+    // Apple GPUs: the G-buffer lives in tile memory and tile shaders cull the lights.
+    options.singlePassDeferred          = true;
+    options.depthPrepassTileShaders     = true;
+    options.lightCullingTileShaders     = true;
+    options.depthDownsampleTileShader   = true;
+    configurations.push_back({ "TBDR", options });
+
+    options = AAPLRendererFrameGraphOptions();
+    options.deferred                    = false;
+    options.clustered                   = false;
+    configurations.push_back({ "Forward", options });
+
+    options = AAPLRendererFrameGraphOptions();
+    options.indirect                    = false;
+    options.shadowsIndirect             = false;
+    options.customMainView              = true;
+    options.debugRendering              = true;
+    options.userInterface               = true;
+    configurations.push_back({ "Direct", options });
+
+    return configurations;
+}
+
+void printSchedule(const AAPLFrameGraph& graph)
+{
+    for (uint32_t pass = 0; pass < graph.passCount(); ++pass)
+    {
+        if (!graph.isLive(pass))
+        {
+            printf("    %-28s culled\n", graph.passName(pass));
+            continue;
+        }
+
+        printf("    %-28s level %u", graph.passName(pass), graph.level(pass));
+
+        size_t waitCount;
+        const uint32_t* waits = graph.waits(pass, waitCount);
+        for (size_t w = 0; w < waitCount; ++w)
+            printf("%s%s", w ? ", " : ", waits for ", graph.passName(waits[w]));
+        printf("\n");
+    }
+
+    for (uint32_t resource = 0; resource < graph.resourceCount(); ++resource)
+    {
+        const AAPLFrameGraph::Placement& placement = graph.placement(resource);
+        if (placement.slot == InvalidIndex)
+            continue;
+
+        printf("    %-28s slot %u, %6.2f MB at %6.2f MB, passes %u-%u\n", graph.resourceName(resource), placement.slot,
+               placement.size / (1024.0 * 1024.0), placement.offset / (1024.0 * 1024.0), placement.firstPass, placement.lastPass);
+    }
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    unsigned graphCount = 20000;
+    uint32_t seed = 1;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--graphs") && i + 1 < argc)
+        {
+            graphCount = (unsigned)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--verbose"))
+        {
+            verbose = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    printf("Renderer configurations (1920x1080)\n");
+    printf("  %-10s %8s %7s %6s %6s %12s %12s %7s %10s\n",
+           "", "passes", "levels", "waits", "slots", "heap MB", "unaliased MB", "saved", "compile us");
+
+    AAPLFrameGraph graph;
+    AAPLRendererFrameGraphPasses passes;
+    for (const Configuration& configuration : rendererConfigurations())
+    {
+        AAPLBuildRendererFrameGraph(configuration.options, graph, passes);
+        if (!graph.compile())
+        {
+            check(false, "compile", std::string(configuration.name) + ": " + graph.error());
+            continue;
+        }
+
+        // Time rebuilding and compiling, which the renderer does when its configuration changes.
+        const unsigned repeat = 2000;
+        const auto begin = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < repeat; ++i)
+        {
+            AAPLBuildRendererFrameGraph(configuration.options, graph, passes);
+            graph.compile();
+        }
+        const double compileMicroseconds = seconds(begin) * 1e6 / repeat;
+
+        uint32_t waitCount = 0;
+        for (uint32_t pass : graph.schedule())
+        {
+            size_t count;
+            graph.waits(pass, count);
+            waitCount += (uint32_t)count;
+        }
+
+        printf("  %-10s %3zu/%-4u %7u %6u %6u %12.1f %12.1f %6.0f%% %10.1f\n", configuration.name, graph.schedule().size(),
+               graph.passCount(), graph.levelCount(), waitCount, graph.slotCount(), graph.heapSize() / (1024.0 * 1024.0),
+               graph.unaliasedSize() / (1024.0 * 1024.0), 100.0 * (1.0 - (double)graph.heapSize() / graph.unaliasedSize()),
+               compileMicroseconds);
+
+        if (verbose)
+            printSchedule(graph);
+
+        checkGraph(graph, configuration.name);
+
+        // Each pass the renderer gates on the graph has the name it encodes with.
+        const uint32_t* indices = &passes.coarseLightCulling;
+        const size_t indexCount = sizeof(passes) / sizeof(uint32_t);
+        for (size_t i = 0; i < indexCount; ++i)
+            check(indices[i] == InvalidIndex || indices[i] < graph.passCount(), "pass index", configuration.name);
+
+        // The renderer only encodes occluders when the depth pyramid reads them.
+        const AAPLRendererFrameGraphOptions& o = configuration.options;
+        if (passes.occluders != InvalidIndex)
+            check(graph.isLive(passes.occluders) == (o.indirect && o.occlusionCulling), "occluders culled", configuration.name);
+    }
+
+    printf("\nRandom graphs\n");
+    checkErrors();
+
+    Random random = { seed ? seed : 1 };
+    std::vector<std::string> names;
+    unsigned culledCount = 0;
+    unsigned aliasedCount = 0;
+
+    const auto begin = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < graphCount && failures < 20; ++i)
+    {
+        buildRandomGraph(random, graph, names);
+        const std::string context = "random graph " + std::to_string(i);
+        if (!graph.compile())
+        {
+            check(false, "compile", context + ": " + graph.error());
+            continue;
+        }
+
+        checkGraph(graph, context);
+        culledCount += graph.schedule().size() < graph.passCount();
+        aliasedCount += graph.heapSize() < graph.unaliasedSize();
+    }
+    printf("  %u graphs checked in %.1f s, %u with culled passes, %u with aliased memory\n", graphCount, seconds(begin),
+           culledCount, aliasedCount);
+
+    printf("\n%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,1280 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the headless frame replay.
+*/
+#include "AAPLFrameReplay.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+#include "../Asset/AAPLMeshFile.h"
+#include "../Renderer/RenderTech/AAPLTaskPool.h"
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+// Number of frames whose buffers are in use at once, as MAX_FRAMES_IN_FLIGHT.
+static const uint32_t FramesInFlight = 3;
+
+// Scale of the inner cone angle of spot lights, as SPOT_LIGHT_INNER_SCALE in AAPLScene.
+static const float SpotLightInnerScale = 0.8f;
+
+//------------------------------------------------------------------------------
+// Vector and column major matrix helpers.
+
+inline float dot3(const float a[3], const float b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+inline void cross3(const float a[3], const float b[3], float out[3])
+{
+    const float c[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+    memcpy(out, c, sizeof(c));
+}
+
+inline void normalize3(float v[3])
+{
+    const float invLength = 1.0f / sqrtf(dot3(v, v));
+    for (int i = 0; i < 3; ++i)
+        v[i] *= invLength;
+}
+
+// out = a * b.
+void multiply(const float a[16], const float b[16], float out[16])
+{
+    float m[16];
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 4; ++r)
+            m[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+    memcpy(out, m, sizeof(m));
+}
+
+// out = m * (v, w).
+inline void transform(const float m[16], const float v[3], float w, float out[4])
+{
+    for (int r = 0; r < 4; ++r)
+        out[r] = m[r] * v[0] + m[4 + r] * v[1] + m[8 + r] * v[2] + m[12 + r] * w;
+}
+
+// Inverts a general matrix with cofactors.
+void invert(const float m[16], float out[16])
+{
+    float inv[16];
+
+    inv[0]  =  m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4]  = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8]  =  m[4] * m[9]  * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9]  * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1]  = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5]  =  m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9]  = -m[0] * m[9]  * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] =  m[0] * m[9]  * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2]  =  m[1] * m[6]  * m[15] - m[1] * m[7]  * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7]  - m[13] * m[3] * m[6];
+    inv[6]  = -m[0] * m[6]  * m[15] + m[0] * m[7]  * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7]  + m[12] * m[3] * m[6];
+    inv[10] =  m[0] * m[5]  * m[15] - m[0] * m[7]  * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7]  - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5]  * m[14] + m[0] * m[6]  * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6]  + m[12] * m[2] * m[5];
+    inv[3]  = -m[1] * m[6]  * m[11] + m[1] * m[7]  * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9]  * m[2] * m[7]  + m[9]  * m[3] * m[6];
+    inv[7]  =  m[0] * m[6]  * m[11] - m[0] * m[7]  * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8]  * m[2] * m[7]  - m[8]  * m[3] * m[6];
+    inv[11] = -m[0] * m[5]  * m[11] + m[0] * m[7]  * m[9]  + m[4] * m[1] * m[11] - m[4] * m[3] * m[9]  - m[8]  * m[1] * m[7]  + m[8]  * m[3] * m[5];
+    inv[15] =  m[0] * m[5]  * m[10] - m[0] * m[6]  * m[9]  - m[4] * m[1] * m[10] + m[4] * m[2] * m[9]  + m[8]  * m[1] * m[6]  - m[8]  * m[2] * m[5];
+
+    const float invDeterminant = 1.0f / (m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12]);
+    for (int i = 0; i < 16; ++i)
+        out[i] = inv[i] * invDeterminant;
+}
+
+//------------------------------------------------------------------------------
+
+// Parsed JSON value, enough for the files NSJSONSerialization writes.
+struct JsonValue
+{
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type                                            type    = Null;
+    double                                          number  = 0.0;
+    std::string                                     string;
+    std::vector<JsonValue>                          elements;
+    std::vector<std::pair<std::string, JsonValue>>  members;
+
+    const JsonValue* find(const char* key) const
+    {
+        for (const auto& member : members)
+            if (member.first == key)
+                return &member.second;
+        return nullptr;
+    }
+
+    float numberFor(const char* key) const
+    {
+        const JsonValue* value = find(key);
+        return value ? (float)value->number : 0.0f;
+    }
+
+    std::string stringFor(const char* key) const
+    {
+        const JsonValue* value = find(key);
+        return value && value->type == String ? value->string : std::string();
+    }
+
+    // Reads a 3 element array.
+    void vectorFor(const char* key, float out[3]) const
+    {
+        const JsonValue* value = find(key);
+        for (size_t i = 0; i < 3; ++i)
+            out[i] = value && i < value->elements.size() ? (float)value->elements[i].number : 0.0f;
+    }
+};
+
+class JsonParser
+{
+public:
+    JsonParser(const char* begin, const char* end)
+        : _p(begin)
+        , _end(end)
+    {
+    }
+
+    bool parse(JsonValue& value)
+    {
+        return parseValue(value, 0) && (skipSpace(), _p == _end);
+    }
+
+private:
+    static const int MaxDepth = 64;
+
+    void skipSpace()
+    {
+        while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r'))
+            ++_p;
+    }
+
+    bool literal(const char* text)
+    {
+        const size_t length = strlen(text);
+        if ((size_t)(_end - _p) < length || memcmp(_p, text, length) != 0)
+            return false;
+        _p += length;
+        return true;
+    }
+
+    bool parseString(std::string& out)
+    {
+        if (_p == _end || *_p != '"')
+            return false;
+        ++_p;
+
+        out.clear();
+        while (_p < _end && *_p != '"')
+        {
+            char c = *_p++;
+            if (c == '\\')
+            {
+                if (_p == _end)
+                    return false;
+                c = *_p++;
+                switch (c)
+                {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case 'r': c = '\r'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'u':
+                    {
+                        // Only ASCII escapes occur in scene files.
+                        if (_end - _p < 4)
+                            return false;
+                        const std::string hex(_p, 4);
+                        _p += 4;
+                        c = (char)strtol(hex.c_str(), nullptr, 16);
+                        break;
+                    }
+                    default: break;
+                }
+            }
+            out.push_back(c);
+        }
+
+        if (_p == _end)
+            return false;
+        ++_p;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value, int depth)
+    {
+        skipSpace();
+        if (_p == _end || depth > MaxDepth)
+            return false;
+
+        switch (*_p)
+        {
+            case '{':
+            {
+                value.type = JsonValue::Object;
+                ++_p;
+                skipSpace();
+                if (_p < _end && *_p == '}')
+                    return ++_p, true;
+
+                for (;;)
+                {
+                    std::pair<std::string, JsonValue> member;
+                    skipSpace();
+                    if (!parseString(member.first))
+                        return false;
+                    skipSpace();
+                    if (_p == _end || *_p++ != ':')
+                        return false;
+                    if (!parseValue(member.second, depth + 1))
+                        return false;
+                    value.members.push_back(std::move(member));
+
+                    skipSpace();
+                    if (_p == _end)
+                        return false;
+                    if (*_p == '}')
+                        return ++_p, true;
+                    if (*_p++ != ',')
+                        return false;
+                }
+            }
+            case '[':
+            {
+                value.type = JsonValue::Array;
+                ++_p;
+                skipSpace();
+                if (_p < _end && *_p == ']')
+                    return ++_p, true;
+
+                for (;;)
+                {
+                    value.elements.emplace_back();
+                    if (!parseValue(value.elements.back(), depth + 1))
+                        return false;
+
+                    skipSpace();
+                    if (_p == _end)
+                        return false;
+                    if (*_p == ']')
+                        return ++_p, true;
+                    if (*_p++ != ',')
+                        return false;
+                }
+            }
+            case '"':
+                value.type = JsonValue::String;
+                return parseString(value.string);
+            case 't':
+                value.type = JsonValue::Bool;
+                value.number = 1.0;
+                return literal("true");
+            case 'f':
+                value.type = JsonValue::Bool;
+                return literal("false");
+            case 'n':
+                return literal("null");
+            default:
+            {
+                // strtod needs a terminated string.
+                char buffer[64];
+                size_t length = 0;
+                while (_p + length < _end && length + 1 < sizeof(buffer) && strchr("+-.0123456789eE", _p[length]))
+                    ++length;
+                memcpy(buffer, _p, length);
+                buffer[length] = 0;
+
+                char* numberEnd = nullptr;
+                value.type = JsonValue::Number;
+                value.number = strtod(buffer, &numberEnd);
+                if (length == 0 || numberEnd != buffer + length)
+                    return false;
+                _p += length;
+                return true;
+            }
+        }
+    }
+
+    const char* _p;
+    const char* _end;
+};
+
+bool readFile(const char* path, std::string& contents, std::string& error)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        error = std::string("Could not open ") + path;
+        return false;
+    }
+
+    contents.clear();
+    char buffer[65536];
+    for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0; )
+        contents.append(buffer, read);
+
+    fclose(file);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+// FNV-1a, for the frame checksums.
+inline uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    return hash;
+}
+
+// Generator for the synthetic chunks, whose sequence doesn't depend on the standard library.
+struct Random
+{
+    uint64_t state;
+
+    float next()
+    {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (float)(state >> 40) / (float)(1 << 24);
+    }
+};
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+bool AAPLReplayCameraPath::load(const char* path, std::string& error)
+{
+    std::string contents;
+    if (!readFile(path, contents, error))
+        return false;
+
+    _keypoints.clear();
+    _distances.clear();
+    _totalDistance = 0.0f;
+
+    AAPLReplayKeypoint keypoint = {};
+
+    size_t lineBegin = 0;
+    while (lineBegin < contents.size())
+    {
+        size_t lineEnd = contents.find_first_of("\r\n", lineBegin);
+        if (lineEnd == std::string::npos)
+            lineEnd = contents.size();
+
+        const std::string line = contents.substr(lineBegin, lineEnd - lineBegin);
+        lineBegin = lineEnd + 1;
+
+        char record[4] = {};
+        float v[3] = {};
+        const int fields = sscanf(line.c_str(), "%3s %f %f %f", record, &v[0], &v[1], &v[2]);
+        if (fields < 1)
+            continue;
+
+        if (!strcmp(record, "x"))
+        {
+            _keypoints.push_back(keypoint);
+            keypoint = AAPLReplayKeypoint();
+        }
+        else if (!strcmp(record, "p") && fields == 4)
+            memcpy(keypoint.position, v, sizeof(v));
+        else if (!strcmp(record, "f") && fields == 4)
+            memcpy(keypoint.forward, v, sizeof(v));
+        else if (!strcmp(record, "u") && fields == 4)
+            memcpy(keypoint.up, v, sizeof(v));
+        else if (!strcmp(record, "le") && fields >= 2)
+            keypoint.lightEnv = (uint32_t)v[0];
+        else if (!strcmp(record, "t") && fields >= 2)
+        {
+            if (!_distances.empty() && !(v[0] > _distances.back()))
+            {
+                error = std::string("Distances must increase in ") + path;
+                return false;
+            }
+            _distances.push_back(v[0]);
+        }
+    }
+
+    if (_keypoints.empty())
+    {
+        error = std::string("No keypoints in ") + path;
+        return false;
+    }
+
+    if (_distances.size() == _keypoints.size())
+        _totalDistance = _distances.back();
+    else
+        updateDistances();
+
+    return true;
+}
+
+float AAPLReplayCameraPath::length() const
+{
+    return _totalDistance > 0.0f ? _totalDistance : (float)_keypoints.size();
+}
+
+uint32_t AAPLReplayCameraPath::indexFor(float time, float& t) const
+{
+    if (_totalDistance == 0.0f)
+    {
+        t = fmodf(time, 1.0f);
+        return (uint32_t)time;
+    }
+
+    float lastDistance = 0.0f;
+    for (size_t i = 0; i < _distances.size(); ++i)
+    {
+        if (time < _distances[i])
+        {
+            t = (time - lastDistance) / (_distances[i] - lastDistance);
+            return (uint32_t)i;
+        }
+        lastDistance = _distances[i];
+    }
+
+    t = 0.0f;
+    return 0;
+}
+
+// Indices of the keypoint before `time`, the two after it and the one before that.
+void AAPLReplayCameraPath::indicesAt(float time, float& t, uint32_t kp[4]) const
+{
+    const uint32_t last = (uint32_t)_keypoints.size() - 1;
+
+    kp[0] = indexFor(fmodf(time, length()), t);
+    kp[1] = std::min(kp[0] + 1, last);
+    kp[2] = std::min(kp[0] + 2, last);
+    kp[3] = kp[0] > 0 ? kp[0] - 1 : 0;
+}
+
+// Interpolates the float3 at byte offset `member` of the keypoints with a Catmull-Rom spline.
+void AAPLReplayCameraPath::interpolate(float time, size_t member, float out[3]) const
+{
+    const auto value = [&](uint32_t index) { return (const float*)((const uint8_t*)&_keypoints[index] + member); };
+
+    if (_keypoints.size() == 1)
+    {
+        memcpy(out, value(0), sizeof(float) * 3);
+        return;
+    }
+
+    float t;
+    uint32_t kp[4];
+    indicesAt(time, t, kp);
+
+    const float* p0     = value(kp[0]);
+    const float* p1     = value(kp[1]);
+    const float* p2     = value(kp[2]);
+    const float* pprev  = value(kp[3]);
+
+    const float i2 = t * t;
+    const float i3 = t * t * t;
+
+    for (int c = 0; c < 3; ++c)
+    {
+        const float m0 = ((p1[c] - p0[c]) + (p0[c] - pprev[c])) * .5f;
+        const float m1 = ((p2[c] - p1[c]) + (p1[c] - p0[c])) * .5f;
+
+        float pos = p0[c] * (2.0f * i3 - 3 * i2 + 1.0f);
+        pos += p1[c] * (-2.0f * i3 + 3 * i2);
+        pos += m0 * (i3 - 2 * i2 + t);
+        pos += m1 * (i3 - i2);
+        out[c] = pos;
+    }
+}
+
+void AAPLReplayCameraPath::sample(float time, float position[3], float forward[3]) const
+{
+    interpolate(time, offsetof(AAPLReplayKeypoint, position), position);
+    interpolate(time, offsetof(AAPLReplayKeypoint, forward), forward);
+}
+
+// Measures the path in 32 linear steps per keypoint, as `updateDistances`.
+void AAPLReplayCameraPath::updateDistances()
+{
+    _totalDistance = 0.0f;
+    float totalDistance = 0.0f;
+
+    float p[3], q[3], unused[3];
+    sample(0.0f, p, unused);
+
+    _distances.resize(_keypoints.size());
+    for (size_t i = 0; i < _keypoints.size(); ++i)
+    {
+        const uint32_t steps = 32;
+        float distance = 0.0f;
+        for (uint32_t j = 0; j < steps; ++j)
+        {
+            sample(i + (j / (float)steps), q, unused);
+            const float d[3] = { p[0] - q[0], p[1] - q[1], p[2] - q[2] };
+            distance += sqrtf(dot3(d, d));
+            memcpy(p, q, sizeof(p));
+        }
+        totalDistance += distance;
+        _distances[i] = totalDistance;
+    }
+    _totalDistance = totalDistance;
+}
+
+//------------------------------------------------------------------------------
+
+bool AAPLReplayScene::load(const char* path, std::string& error)
+{
+    std::string contents;
+    if (!readFile(path, contents, error))
+        return false;
+
+    JsonValue scene;
+    if (!JsonParser(contents.data(), contents.data() + contents.size()).parse(scene) || scene.type != JsonValue::Object)
+    {
+        error = std::string("Malformed scene ") + path;
+        return false;
+    }
+
+    meshFilename            = scene.stringFor("mesh_filename");
+    cameraKeypointsFilename = scene.stringFor("camera_keypoints_filename");
+
+    scene.vectorFor("camera_position", cameraPosition);
+    scene.vectorFor("camera_direction", cameraDirection);
+    scene.vectorFor("camera_up", cameraUp);
+    scene.vectorFor("sun_direction", sunDirection);
+
+    float centerOffset[3];
+    scene.vectorFor("center_offset", centerOffset);
+
+    pointLights.clear();
+    if (const JsonValue* lights = scene.find("point_lights"))
+    {
+        for (const JsonValue& e : lights->elements)
+        {
+            AAPLReplayPointLight light;
+            light.posRadius[0]      = e.numberFor("position_x");
+            light.posRadius[1]      = e.numberFor("position_y");
+            light.posRadius[2]      = e.numberFor("position_z");
+            light.posRadius[3]      = e.numberFor("sqrt_radius");   // Squared radius, despite the key.
+            light.forTransparent    = e.numberFor("for_transparent") != 0.0f;
+            pointLights.push_back(light);
+        }
+    }
+
+    spotLights.clear();
+    if (const JsonValue* lights = scene.find("spot_lights"))
+    {
+        for (const JsonValue& e : lights->elements)
+        {
+            const float pos[3]  = { e.numberFor("position_x"), e.numberFor("position_y"), e.numberFor("position_z") };
+            const float dir[3]  = { e.numberFor("direction_x"), e.numberFor("direction_y"), e.numberFor("direction_z") };
+            const float height  = e.numberFor("height");
+            const float angle   = e.numberFor("coneRad");
+
+            // Bounding sphere of the cone, as `addSpotLight`.
+            AAPLReplaySpotLight light;
+            if (angle > M_PI / 4.0f)
+            {
+                const float R = height * tanf(angle);
+                for (int c = 0; c < 3; ++c)
+                    light.boundingSphere[c] = pos[c] + height * dir[c];
+                light.boundingSphere[3] = R;
+            }
+            else
+            {
+                const float R = height / (2 * cos(angle) * cos(angle));
+                for (int c = 0; c < 3; ++c)
+                    light.boundingSphere[c] = pos[c] + dir[c] * R;
+                light.boundingSphere[3] = R;
+            }
+
+            for (int c = 0; c < 3; ++c)
+            {
+                light.posAndHeight[c]       = pos[c];
+                light.dirAndOuterAngle[c]   = dir[c];
+            }
+            light.posAndHeight[3]       = height;
+            light.dirAndOuterAngle[3]   = angle;
+            light.forTransparent        = e.numberFor("for_transparent") != 0.0f;
+
+            spotLights.push_back(light);
+        }
+    }
+
+    // Occluders are stored Z up and moved into the mesh's space as AAPLScene does.
+    occluderPositions.clear();
+    occluderIndices.clear();
+    if (const JsonValue* vertices = scene.find("occluder_verts"))
+    {
+        for (const JsonValue& v : vertices->elements)
+        {
+            if (v.elements.size() < 3)
+                continue;
+
+            occluderPositions.push_back((float)v.elements[0].number - centerOffset[0]);
+            occluderPositions.push_back((float)v.elements[2].number - centerOffset[1]);
+            occluderPositions.push_back((float)v.elements[1].number - centerOffset[2]);
+        }
+    }
+    if (const JsonValue* indices = scene.find("occluder_indices"))
+    {
+        for (const JsonValue& i : indices->elements)
+        {
+            if (i.number < 0 || i.number * 3 >= occluderPositions.size())
+            {
+                error = std::string("Occluder index out of range in ") + path;
+                return false;
+            }
+            occluderIndices.push_back((uint32_t)i.number);
+        }
+    }
+    occluderIndices.resize(occluderIndices.size() / 3 * 3);
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+void AAPLReplayUpdateCamera(const float position[3], const float direction[3], const float up[3],
+                            float viewAngle, float aspectRatio, float nearPlane, float farPlane,
+                            AAPLReplayCameraParams& params)
+{
+    // Look at matrix, as sInvMatrixLookat.
+    {
+        const float to[3] = { position[0] + direction[0], position[1] + direction[1], position[2] + direction[2] };
+
+        float z[3] = { to[0] - position[0], to[1] - position[1], to[2] - position[2] };
+        normalize3(z);
+        float x[3];
+        cross3(up, z, x);
+        normalize3(x);
+        float y[3];
+        cross3(z, x, y);
+
+        const float view[16] = { x[0], y[0], z[0], 0,
+                                 x[1], y[1], z[1], 0,
+                                 x[2], y[2], z[2], 0,
+                                 -dot3(x, position), -dot3(y, position), -dot3(z, position), 1 };
+        memcpy(params.viewMatrix, view, sizeof(view));
+    }
+
+    const float ys = 1.0f / tanf(viewAngle * 0.5);
+    const float xs = ys / aspectRatio;
+    const float zs = farPlane / (farPlane - nearPlane);
+    const float projection[16] = { xs, 0, 0, 0,
+                                   0, ys, 0, 0,
+                                   0, 0, zs, 1,
+                                   0, 0, -nearPlane * zs, 0 };
+    memcpy(params.projectionMatrix, projection, sizeof(projection));
+
+    multiply(params.projectionMatrix, params.viewMatrix, params.viewProjectionMatrix);
+    invert(params.projectionMatrix, params.invProjectionMatrix);
+    invert(params.viewProjectionMatrix, params.invViewProjectionMatrix);
+    invert(params.viewMatrix, params.invViewMatrix);
+
+    // Planes from the rows of the view projection matrix: left, right, up, down, near, far.
+    const float* vpm = params.viewProjectionMatrix;
+    for (int i = 0; i < 6; ++i)
+    {
+        const int   row  = i / 2;
+        const float sign = (i & 1) ? -1.0f : 1.0f;
+
+        float* plane = params.worldFrustumPlanes[i];
+        for (int c = 0; c < 4; ++c)
+            plane[c] = vpm[c * 4 + 3] + sign * vpm[c * 4 + row];
+
+        const float invLength = 1.0f / sqrtf(dot3(plane, plane));
+        for (int c = 0; c < 4; ++c)
+            plane[c] *= invLength;
+    }
+
+    const float* ip = params.invProjectionMatrix;
+    params.invProjZ[0] = ip[10];
+    params.invProjZ[1] = ip[11];
+    params.invProjZ[2] = ip[14];
+    params.invProjZ[3] = ip[15];
+
+    const float invScale = farPlane - nearPlane;
+    const float bias     = -nearPlane;
+    params.invProjZNormalized[0] = params.invProjZ[0] + (params.invProjZ[1] * bias);
+    params.invProjZNormalized[1] = params.invProjZ[1] * invScale;
+    params.invProjZNormalized[2] = params.invProjZ[2] + (params.invProjZ[3] * bias);
+    params.invProjZNormalized[3] = params.invProjZ[3] * invScale;
+}
+
+const char* AAPLReplayStageName(AAPLReplayStage stage)
+{
+    switch (stage)
+    {
+        case AAPLReplayStageCamera:             return "camera";
+        case AAPLReplayStageUniforms:           return "uniforms";
+        case AAPLReplayStageOccluders:          return "occluders";
+        case AAPLReplayStageChunkCulling:       return "chunk culling";
+        case AAPLReplayStageLightCulling:       return "light culling";
+        case AAPLReplayStageTextureStreaming:   return "texture streaming";
+        default:                                return "";
+    }
+}
+
+//------------------------------------------------------------------------------
+
+AAPLFrameReplay::AAPLFrameReplay(const AAPLFrameReplayConfig& config)
+    : _config(config)
+{
+    // Every stage, including light culling, runs its parallel loops on this pool.
+    _pool.reset(new AAPLTaskPool(config.threadCount));
+    _traceEvents.resize(_pool->threadCount());
+    _materialAreas.resize(_pool->threadCount());
+
+    _startTime = 0;
+    _startTime = now();
+}
+
+AAPLFrameReplay::~AAPLFrameReplay()
+{
+}
+
+uint64_t AAPLFrameReplay::now() const
+{
+    const auto time = std::chrono::steady_clock::now().time_since_epoch();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time).count() - _startTime;
+}
+
+void AAPLFrameReplay::trace(uint32_t thread, const char* name, uint32_t frame, uint64_t begin, uint64_t end)
+{
+    if (_config.trace)
+        _traceEvents[thread].push_back({ name, frame, begin, end });
+}
+
+unsigned AAPLFrameReplay::threadCount() const
+{
+    return _pool->threadCount();
+}
+
+uint32_t AAPLFrameReplay::frameCount() const
+{
+    if (_config.frameCount)
+        return _config.frameCount;
+
+    return (uint32_t)ceilf(_path.length() / _config.frameTime);
+}
+
+bool AAPLFrameReplay::load(const char* scenePath, const char* waypointsPath, std::string& error)
+{
+    if (_config.lightCullingTileSize % _config.occlusionDownscale != 0)
+    {
+        error = "The light culling tile size must be a multiple of the occlusion downscale";
+        return false;
+    }
+
+    if (!_scene.load(scenePath, error) || !_path.load(waypointsPath, error))
+        return false;
+
+    if (_config.meshPath.empty())
+        createSyntheticChunks();
+    else if (!loadMesh(error))
+        return false;
+
+    // Split the chunks in ranges of about equal size, a few per thread.
+    const size_t rangeCount = std::max<size_t>(1, std::min<size_t>(threadCount() * 4, _chunks.size() / 1024));
+    _chunkRanges.resize(rangeCount);
+    _chunkRangeBegins.resize(rangeCount + 1);
+    for (size_t r = 0; r <= rangeCount; ++r)
+        _chunkRangeBegins[r] = (uint32_t)(_chunks.size() * r / rangeCount);
+
+    for (size_t r = 0; r < rangeCount; ++r)
+    {
+        AAPLCPUCullChunks& range = _chunkRanges[r];
+        range.reserve(_chunkRangeBegins[r + 1] - _chunkRangeBegins[r]);
+
+        for (uint32_t i = _chunkRangeBegins[r]; i < _chunkRangeBegins[r + 1]; ++i)
+        {
+            const float center[3]   = { _chunks.centerX[i], _chunks.centerY[i], _chunks.centerZ[i] };
+            const float boxMin[3]   = { _chunks.minX[i], _chunks.minY[i], _chunks.minZ[i] };
+            const float boxMax[3]   = { _chunks.maxX[i], _chunks.maxY[i], _chunks.maxZ[i] };
+
+            // Undo the cone encoding of push_back.
+            const float sinAngle    = _chunks.coneSinAngle[i];
+            const float cone[4]     = { _chunks.coneX[i], _chunks.coneY[i], _chunks.coneZ[i],
+                                        sinAngle > 1.0f ? -1.0f : sqrtf(std::max(0.0f, 1.0f - sinAngle * sinAngle)) };
+
+            range.push_back(center, _chunks.radius[i], cone, boxMin, boxMax);
+        }
+    }
+    _cullResults.resize(_chunks.size());
+
+    _cullParams.cullBackfaces = _config.cullBackfaces;
+    _cullParams.orthographic  = false;
+
+    const uint32_t scale = _config.occlusionDownscale;
+    _depthPyramid.resize((_config.width + scale - 1) / scale, (_config.height + scale - 1) / scale);
+    _depth.resize((size_t)_depthPyramid.width() * _depthPyramid.height());
+
+    _frameBuffers.resize(FramesInFlight);
+    for (FrameBuffers& buffers : _frameBuffers)
+    {
+        buffers.pointLights.resize(_scene.pointLights.size());
+        buffers.spotLights.resize(_scene.spotLights.size());
+    }
+
+    _lightCullParams.width                      = _config.width;
+    _lightCullParams.height                     = _config.height;
+    _lightCullParams.nearPlane                  = _config.nearPlane;
+    _lightCullParams.lightCullingTileSize       = _config.lightCullingTileSize;
+    _lightCullParams.lightClusteringTileSize    = _config.lightCullingTileSize;
+    _lightCullParams.clusterDepth               = _config.clusterDepth;
+    _lightCullParams.taskPool                   = _pool.get();
+    AAPLCPULightCullCreateResult(_lightCullParams, _scene.pointLights.size(), _scene.spotLights.size(), _lightCullResult);
+
+    setUpStreaming();
+
+    return true;
+}
+
+bool AAPLFrameReplay::loadMesh(std::string& error)
+{
+    AAPLMeshFile file;
+    if (!file.open(_config.meshPath.c_str()))
+    {
+        error = file.error();
+        return false;
+    }
+
+    std::vector<uint8_t> storage;
+    const AAPLSpan<AAPLMeshFileChunk> chunks = file.typedBlock<AAPLMeshFileChunk>(file.chunkBlock(), storage);
+    if (chunks.empty())
+    {
+        error = "No chunks in " + _config.meshPath;
+        return false;
+    }
+
+    _chunks.clear();
+    _chunks.reserve(chunks.size());
+    _chunkMaterials.clear();
+    _materialCount = (uint32_t)file.materialCount();
+
+    for (const AAPLMeshFileChunk& chunk : chunks)
+    {
+        _chunks.push_back(chunk.boundingSphere, chunk.boundingSphere[3], chunk.normalDistribution, chunk.boxMin, chunk.boxMax);
+        _chunkMaterials.push_back(chunk.materialIndex);
+        _materialCount = std::max(_materialCount, chunk.materialIndex + 1);
+    }
+
+    return true;
+}
+
+// Scatters chunks of a few meters over the bounds of the scene's lights and occluders,
+//  with random normal cones.
+void AAPLFrameReplay::createSyntheticChunks()
+{
+    float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    const auto include = [&](const float p[3])
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            boundsMin[c] = std::min(boundsMin[c], p[c]);
+            boundsMax[c] = std::max(boundsMax[c], p[c]);
+        }
+    };
+
+    for (const AAPLReplayPointLight& light : _scene.pointLights)
+        include(light.posRadius);
+    for (const AAPLReplaySpotLight& light : _scene.spotLights)
+        include(light.posAndHeight);
+    for (size_t i = 0; i + 2 < _scene.occluderPositions.size(); i += 3)
+        include(&_scene.occluderPositions[i]);
+    if (boundsMin[0] > boundsMax[0])
+    {
+        std::fill(boundsMin, boundsMin + 3, -50.0f);
+        std::fill(boundsMax, boundsMax + 3, 50.0f);
+    }
+
+    Random random = { 0x5EED };
+
+    _chunks.clear();
+    _chunks.reserve(_config.syntheticChunkCount);
+    _chunkMaterials.clear();
+    _materialCount = std::max(1u, _config.syntheticMaterialCount);
+
+    for (uint32_t i = 0; i < _config.syntheticChunkCount; ++i)
+    {
+        float center[3];
+        for (int c = 0; c < 3; ++c)
+            center[c] = boundsMin[c] + (boundsMax[c] - boundsMin[c]) * random.next();
+
+        const float radius = 0.25f + 1.5f * random.next();
+
+        float boxMin[3], boxMax[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            const float extent = radius * (0.3f + 0.27f * random.next());
+            boxMin[c] = center[c] - extent;
+            boxMax[c] = center[c] + extent;
+        }
+
+        float cone[4];
+        do
+        {
+            for (int c = 0; c < 3; ++c)
+                cone[c] = random.next() * 2.0f - 1.0f;
+        } while (dot3(cone, cone) < 0.01f || dot3(cone, cone) > 1.0f);
+        normalize3(cone);
+        cone[3] = random.next() * 2.0f - 1.0f;
+
+        _chunks.push_back(center, radius, cone, boxMin, boxMax);
+        _chunkMaterials.push_back((uint32_t)(random.next() * _materialCount) % _materialCount);
+    }
+}
+
+// Registers a texture per material with the mip chain of a block compressed texture.
+void AAPLFrameReplay::setUpStreaming()
+{
+    AAPLTextureStreamingScheduler::Config config;
+    config.budgetBytes      = _config.textureBudgetBytes;
+    config.loadsPerFrame    = _config.loadsPerFrame;
+    _scheduler.reset(new AAPLTextureStreamingScheduler(config));
+
+    std::vector<uint64_t> mipSizes;
+    for (uint32_t size = _config.textureSize; ; size /= 2)
+    {
+        const uint64_t blocks = std::max(1u, size / 4);
+        mipSizes.push_back(blocks * blocks * 16);
+        if (size <= 1)
+            break;
+    }
+
+    // Mips coarser than the permanent size stay resident, as calculateMinMip.
+    const uint32_t permanentMip = std::min((uint32_t)mipSizes.size() - 1,
+                                           (uint32_t)log2(std::max(_config.textureSize / std::max(_config.permanentTextureSize, 1u), 1u)));
+
+    for (uint32_t m = 0; m < _materialCount; ++m)
+        _scheduler->addTexture(mipSizes.data(), (uint32_t)mipSizes.size(), permanentMip);
+
+    for (std::vector<float>& areas : _materialAreas)
+        areas.assign(_materialCount, 0.0f);
+
+    _pendingDecisions.clear();
+}
+
+//------------------------------------------------------------------------------
+
+void AAPLFrameReplay::runFrame(uint32_t frame, AAPLReplayFrame& result)
+{
+    _checksum = 0xCBF29CE484222325ull;
+
+    const auto run = [&](AAPLReplayStage stage, const std::function<void()>& work)
+    {
+        const uint64_t begin = now();
+        work();
+        const uint64_t end = now();
+
+        result.stageMilliseconds[stage] = (end - begin) * 1e-6;
+        trace(0, AAPLReplayStageName(stage), frame, begin, end);
+    };
+
+    const uint64_t frameBegin = now();
+
+    _currentBuffers = &_frameBuffers[frame % FramesInFlight];
+
+    run(AAPLReplayStageCamera,              [&]() { updateCamera(frame); });
+    run(AAPLReplayStageUniforms,            [&]() { packUniforms(); });
+    run(AAPLReplayStageOccluders,           [&]() { rasterizeOccluders(); });
+    run(AAPLReplayStageChunkCulling,        [&]() { cullChunks(frame); });
+    run(AAPLReplayStageLightCulling,        [&]() { cullLights(); });
+    run(AAPLReplayStageTextureStreaming,    [&]() { streamTextures(frame); });
+
+    const uint64_t frameEnd = now();
+    trace(0, "frame", frame, frameBegin, frameEnd);
+
+    result.totalMilliseconds = (frameEnd - frameBegin) * 1e-6;
+
+    result.visibleChunks = (uint32_t)std::count(_cullResults.begin(), _cullResults.end(), (uint8_t)AAPLCullResultNotCulled);
+
+    result.tileLights = 0;
+    const size_t tileCount = (size_t)_lightCullResult.tileCountX * _lightCullResult.tileCountY;
+    for (size_t t = 0; t < tileCount; ++t)
+        result.tileLights += _lightCullResult.pointLightIndices[t * AAPLCPULightsPerTile]
+                           + _lightCullResult.spotLightIndices[t * AAPLCPULightsPerTile];
+
+    result.streamingDecisions = _streamingDecisions;
+    result.checksum = _checksum;
+}
+
+// Moves the camera as the controller's `updateTimeInSeconds`, one frame time per frame.
+void AAPLFrameReplay::updateCamera(uint32_t frame)
+{
+    const float progress = fmodf((frame + 1) * _config.frameTime, _path.length());
+
+    float position[3], forward[3];
+    _path.sample(progress, position, forward);
+
+    // faceDirection:withUp:, with the world's up.
+    const float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+    float direction[3] = { forward[0], forward[1], forward[2] };
+    normalize3(direction);
+    float right[3];
+    cross3(direction, worldUp, right);
+    normalize3(right);
+    float up[3];
+    cross3(right, direction, up);
+
+    AAPLReplayUpdateCamera(position, direction, up, _config.viewAngle, (float)_config.width / (float)_config.height,
+                           _config.nearPlane, _config.farPlane, _camera);
+    memcpy(_cameraPosition, position, sizeof(position));
+
+    _checksum = hashBytes(_checksum, &_camera.viewProjectionMatrix, sizeof(_camera.viewProjectionMatrix));
+}
+
+// Writes the camera and the view space light data into the frame's buffers, as the
+//  renderer's `updateState`.
+void AAPLFrameReplay::packUniforms()
+{
+    FrameBuffers& buffers = *_currentBuffers;
+    buffers.cameraParams = _camera;
+
+    const float* view = _camera.viewMatrix;
+
+    for (size_t i = 0; i < _scene.pointLights.size(); ++i)
+    {
+        const AAPLReplayPointLight& light = _scene.pointLights[i];
+
+        AAPLCPUPointLight& culling = buffers.pointLights[i];
+        transform(view, light.posRadius, 1.0f, culling.posRadius);
+
+        const float radius = sqrtf(light.posRadius[3]);
+        culling.posRadius[3] = light.forTransparent ? radius : -radius;
+    }
+
+    // Directions transform with the inverse transpose of the view matrix.
+    float normalMatrix[16];
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 4; ++r)
+            normalMatrix[c * 4 + r] = _camera.invViewMatrix[r * 4 + c];
+
+    for (size_t i = 0; i < _scene.spotLights.size(); ++i)
+    {
+        const AAPLReplaySpotLight& light = _scene.spotLights[i];
+
+        AAPLCPUSpotLight& culling = buffers.spotLights[i];
+        transform(view, light.boundingSphere, 1.0f, culling.posRadius);
+        culling.posRadius[3] = light.forTransparent ? light.boundingSphere[3] : -light.boundingSphere[3];
+
+        transform(view, light.posAndHeight, 1.0f, culling.posAndHeight);
+        culling.posAndHeight[3] = light.posAndHeight[3];
+
+        transform(normalMatrix, light.dirAndOuterAngle, 0.0f, culling.dirAndOuterAngle);
+        culling.dirAndOuterAngle[3] = cosf(light.dirAndOuterAngle[3]);
+    }
+
+    // Camera for culling.
+    memcpy(_cullParams.frustumPlanes, _camera.worldFrustumPlanes, sizeof(_cullParams.frustumPlanes));
+    memcpy(_cullParams.viewProjectionMatrix, _camera.viewProjectionMatrix, sizeof(_cullParams.viewProjectionMatrix));
+    memcpy(_cullParams.cameraPosition, _cameraPosition, sizeof(_cullParams.cameraPosition));
+
+    memcpy(_lightCullParams.projectionMatrix, _camera.projectionMatrix, sizeof(_lightCullParams.projectionMatrix));
+}
+
+void AAPLFrameReplay::rasterizeOccluders()
+{
+    _depthPyramid.clear();
+    _depthPyramid.rasterizeTriangles(_scene.occluderPositions.data(), _scene.occluderIndices.data(),
+                                     _scene.occluderIndices.size() / 3, _camera.viewProjectionMatrix);
+    _depthPyramid.build();
+}
+
+void AAPLFrameReplay::cullChunks(uint32_t frame)
+{
+    const AAPLCPUDepthPyramid* depthPyramid = _config.occlusionCulling ? &_depthPyramid : nullptr;
+
+    _pool->parallelFor(_chunkRanges.size(), [&](size_t r, unsigned thread)
+    {
+        const uint64_t begin = now();
+        AAPLCPUCullChunksBatch(_chunkRanges[r], _cullParams, depthPyramid, &_cullResults[_chunkRangeBegins[r]]);
+        trace(thread, "cull chunks", frame, begin, now());
+    });
+
+    _checksum = hashBytes(_checksum, _cullResults.data(), _cullResults.size());
+}
+
+void AAPLFrameReplay::cullLights()
+{
+    const FrameBuffers& buffers = *_currentBuffers;
+
+    // Linear depth at the resolution of the depth pyramid, whose texels each cover a block of
+    //  pixels, so that the light culling tiles cover the same blocks of texels.
+    _depthPyramid.storeDepth(_depth.data());
+
+    const float* invProjZ = _camera.invProjZ;
+    for (float& depth : _depth)
+        depth = (invProjZ[0] * depth + invProjZ[2]) / (invProjZ[1] * depth + invProjZ[3]);
+
+    AAPLCPULightCullParams depthParams = _lightCullParams;
+    depthParams.width                   = _depthPyramid.width();
+    depthParams.height                  = _depthPyramid.height();
+    depthParams.lightCullingTileSize    = _config.lightCullingTileSize / _config.occlusionDownscale;
+    AAPLCPULightCullDepthBounds(depthParams, _depth.data(), _depthBounds);
+
+    const AAPLCPUPointLight* pointLights = buffers.pointLights.data();
+    const AAPLCPUSpotLight*  spotLights  = buffers.spotLights.data();
+    const size_t pointLightCount = buffers.pointLights.size();
+    const size_t spotLightCount  = buffers.spotLights.size();
+
+    AAPLCPULightCullCoarse(_lightCullParams, pointLights, pointLightCount, spotLights, spotLightCount, _lightCullResult);
+    AAPLCPULightCullTiles(_lightCullParams, _depthBounds.data(), pointLights, pointLightCount, spotLights, spotLightCount, _lightCullResult);
+
+    _checksum = hashBytes(_checksum, _lightCullResult.pointLightIndices.data(), _lightCullResult.pointLightIndices.size());
+    _checksum = hashBytes(_checksum, _lightCullResult.spotLightIndices.data(), _lightCullResult.spotLightIndices.size());
+
+    if (_config.lightClustering)
+    {
+        AAPLCPULightCullClusters(_lightCullParams, pointLights, pointLightCount, spotLights, spotLightCount, _lightCullResult);
+
+        _checksum = hashBytes(_checksum, _lightCullResult.pointLightClusterIndices.data(), _lightCullResult.pointLightClusterIndices.size());
+        _checksum = hashBytes(_checksum, _lightCullResult.spotLightClusterIndices.data(), _lightCullResult.spotLightClusterIndices.size());
+    }
+}
+
+// Requires mips from the screen area of the chunks in the frustum, as the renderer does for
+//  each chunk's material, then schedules loads and drops.  Decisions complete after the
+//  configured latency, as if uploaded by the streamer.
+void AAPLFrameReplay::streamTextures(uint32_t frame)
+{
+    const float focalLength         = _camera.projectionMatrix[0];
+    const float focalLengthSquared  = focalLength * focalLength;
+    const float viewArea            = (float)_config.width * (float)_config.height;
+
+    _pool->parallelFor(_chunkRanges.size(), [&](size_t r, unsigned thread)
+    {
+        const uint64_t begin = now();
+        std::vector<float>& areas = _materialAreas[thread];
+
+        for (uint32_t i = _chunkRangeBegins[r]; i < _chunkRangeBegins[r + 1]; ++i)
+        {
+            if (_cullResults[i] == AAPLCullResultFrustumCulled)
+                continue;
+
+            const float center[3] = { _chunks.centerX[i], _chunks.centerY[i], _chunks.centerZ[i] };
+            const float radius = _chunks.radius[i];
+
+            float origin[4];
+            transform(_camera.viewMatrix, center, 1.0f, origin);
+
+            float area;
+            if (origin[2] <= radius)
+            {
+                area = viewArea;
+            }
+            else
+            {
+                const float radiusSquared = radius * radius;
+                const float z2 = origin[2] * origin[2];
+                const float l2 = dot3(origin, origin);
+
+                area = -M_PI * focalLengthSquared * radiusSquared * sqrt(fabs((l2 - radiusSquared) / (radiusSquared - z2))) / (radiusSquared - z2);
+                area *= viewArea * 0.25f;
+            }
+
+            float& materialArea = areas[_chunkMaterials[i]];
+            materialArea = std::max(materialArea, area);
+        }
+
+        trace(thread, "texture areas", frame, begin, now());
+    });
+
+    for (const PendingDecision& pending : _pendingDecisions)
+        if (pending.completionFrame <= frame)
+            _scheduler->complete(pending.decision.texture, pending.decision.mip);
+    _pendingDecisions.erase(std::remove_if(_pendingDecisions.begin(), _pendingDecisions.end(),
+                                           [&](const PendingDecision& pending) { return pending.completionFrame <= frame; }),
+                            _pendingDecisions.end());
+
+    // Mips between the finest and the permanent one, as `requireMip`.
+    const float topTexelArea = (float)_config.textureSize * (float)_config.textureSize;
+    const uint32_t permanentMip = (uint32_t)log2(std::max(_config.textureSize / std::max(_config.permanentTextureSize, 1u), 1u));
+
+    for (uint32_t m = 0; m < _materialCount; ++m)
+    {
+        float area = 0.0f;
+        for (std::vector<float>& areas : _materialAreas)
+        {
+            area = std::max(area, areas[m]);
+            areas[m] = 0.0f;
+        }
+
+        if (area > 0.0f)
+        {
+            const float mip = 0.5f * log2f(topTexelArea / area);
+            _scheduler->setRequiredMip(m, std::min(permanentMip, (uint32_t)std::max(mip, 0.0f)), area);
+        }
+    }
+
+    const std::vector<AAPLTextureStreamingScheduler::Decision>& decisions = _scheduler->schedule();
+    for (const AAPLTextureStreamingScheduler::Decision& decision : decisions)
+        _pendingDecisions.push_back({ decision, frame + _config.streamingLatencyFrames });
+
+    _streamingDecisions = (uint32_t)decisions.size();
+    if (!decisions.empty())
+        _checksum = hashBytes(_checksum, decisions.data(), decisions.size() * sizeof(decisions[0]));
+}
+
+//------------------------------------------------------------------------------
+
+bool AAPLFrameReplay::writeTrace(const char* path, std::string& error) const
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        error = std::string("Could not create ") + path;
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (size_t thread = 0; thread < _traceEvents.size(); ++thread)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%zu,\"args\":{\"name\":\"%s %zu\"}}",
+                first ? "" : ",\n", thread, thread ? "worker" : "main", thread);
+        first = false;
+
+        for (const TraceEvent& event : _traceEvents[thread])
+        {
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                    event.name, thread, event.begin * 1e-3, (event.end - event.begin) * 1e-3, event.frame);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    const bool written = !ferror(file);
+    if (fclose(file) != 0 || !written)
+    {
+        error = std::string("Could not write ") + path;
+        return false;
+    }
+    return true;
+}
+
+double AAPLReplayPercentile(std::vector<double> values, double percentile)
+{
+    if (values.empty())
+        return 0.0;
+
+    std::sort(values.begin(), values.end());
+
+    const double rank = std::min(std::max(percentile, 0.0), 100.0) / 100.0 * (values.size() - 1);
+    const size_t lower = (size_t)rank;
+    const size_t upper = std::min(lower + 1, values.size() - 1);
+    return values[lower] + (values[upper] - values[lower]) * (rank - lower);
+}
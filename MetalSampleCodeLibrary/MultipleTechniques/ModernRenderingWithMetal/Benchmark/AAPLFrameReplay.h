@@ -0,0 +1,293 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the headless frame replay, which flies the camera along a waypoint path and
+ times the CPU work of each frame without a GPU.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Asset/AAPLTextureStreamingScheduler.h"
+#include "../Renderer/RenderTech/AAPLCPUCulling.h"
+#include "../Renderer/RenderTech/AAPLCPULightCulling.h"
+
+// Keypoint of a camera path.
+struct AAPLReplayKeypoint
+{
+    float       position[3];
+    float       forward[3];
+    float       up[3];
+    uint32_t    lightEnv;
+};
+
+// Camera path read from a .waypoints file, interpolated as AAPLCameraController does in
+//  its default, non looping mode.
+class AAPLReplayCameraPath
+{
+public:
+    // Reads `p`, `f`, `u`, `le` and `t` records, each keypoint ending with an `x` record.
+    //  Distances are computed along the path when the file has none.
+    bool load(const char* path, std::string& error);
+
+    // Length of the path, in the units of the controller's progress.
+    float length() const;
+
+    // Position and forward direction at `time`, which wraps around the path's length.
+    void sample(float time, float position[3], float forward[3]) const;
+
+    size_t keypointCount() const { return _keypoints.size(); }
+
+private:
+    uint32_t indexFor(float time, float& t) const;
+    void     indicesAt(float time, float& t, uint32_t kp[4]) const;
+    void     interpolate(float time, size_t member, float out[3]) const;
+    void     updateDistances();
+
+    std::vector<AAPLReplayKeypoint> _keypoints;
+    std::vector<float>              _distances;     // Distance from the first keypoint to each next one.
+    float                           _totalDistance = 0.0f;
+};
+
+// Same data as AAPLPointLightData and AAPLSpotLightData, in world space.
+struct AAPLReplayPointLight
+{
+    float   posRadius[4];
+    bool    forTransparent;
+};
+
+struct AAPLReplaySpotLight
+{
+    float   boundingSphere[4];
+    float   posAndHeight[4];
+    float   dirAndOuterAngle[4];            // Outer angle in radians.
+    bool    forTransparent;
+};
+
+// Lights, camera and occluders read from a .scene file, as AAPLScene loads them.
+struct AAPLReplayScene
+{
+    std::string                         meshFilename;
+    std::string                         cameraKeypointsFilename;
+
+    float                               cameraPosition[3];
+    float                               cameraDirection[3];
+    float                               cameraUp[3];
+    float                               sunDirection[3];
+
+    std::vector<AAPLReplayPointLight>   pointLights;
+    std::vector<AAPLReplaySpotLight>    spotLights;
+
+    // Occluder triangles, with positions moved into the mesh's space.
+    std::vector<float>                  occluderPositions;
+    std::vector<uint32_t>               occluderIndices;
+
+    bool load(const char* path, std::string& error);
+};
+
+// Same layout as AAPLCameraParams.  Matrices are column major.
+struct AAPLReplayCameraParams
+{
+    float   viewMatrix[16];
+    float   projectionMatrix[16];
+    float   viewProjectionMatrix[16];
+
+    float   invViewMatrix[16];
+    float   invProjectionMatrix[16];
+    float   invViewProjectionMatrix[16];
+
+    float   worldFrustumPlanes[6][4];
+
+    float   invProjZ[4];
+    float   invProjZNormalized[4];
+};
+
+// Fills `params` for a perspective camera, as AAPLCamera's `updateState`.  `direction`
+//  must be normalized and `up` perpendicular to it.
+void AAPLReplayUpdateCamera(const float position[3], const float direction[3], const float up[3],
+                            float viewAngle, float aspectRatio, float nearPlane, float farPlane,
+                            AAPLReplayCameraParams& params);
+
+//------------------------------------------------------------------------------
+
+// Stages of the CPU work of a frame, timed separately.
+enum AAPLReplayStage : uint32_t
+{
+    AAPLReplayStageCamera,              // Moves the camera along the path.
+    AAPLReplayStageUniforms,            // Packs camera and light data into the frame's buffers.
+    AAPLReplayStageOccluders,           // Rasterizes occluders and builds the depth pyramid.
+    AAPLReplayStageChunkCulling,
+    AAPLReplayStageLightCulling,        // Depth bounds, coarse and tile culling, clustering.
+    AAPLReplayStageTextureStreaming,    // Required mips and scheduling decisions.
+    AAPLReplayStageCount
+};
+
+const char* AAPLReplayStageName(AAPLReplayStage stage);
+
+struct AAPLFrameReplayConfig
+{
+    // View, as set up by the renderer's `loadAssets`.
+    uint32_t    width                   = 1920;
+    uint32_t    height                  = 1080;
+    float       viewAngle               = 65.0f * (3.14159265f / 180.0f);
+    float       nearPlane               = 0.1f;
+    float       farPlane                = 100.0f;
+
+    // Progress along the path per frame: the controller's update time of a 60 Hz frame.
+    float       frameTime               = 1.0f / 60.0f;
+    uint32_t    frameCount              = 0;        // 0 to cover the whole path once.
+
+    // Threads of the task pool that runs every stage, light culling included; 0 for one
+    //  thread per core.
+    unsigned    threadCount             = 0;
+
+    // Mesh file to cull the chunks of.  Without one, `syntheticChunkCount` chunks are
+    //  scattered over the scene's bounds from a fixed seed.
+    std::string meshPath;
+    uint32_t    syntheticChunkCount     = 65536;
+    uint32_t    syntheticMaterialCount  = 256;
+
+    bool        cullBackfaces           = false;
+    bool        occlusionCulling        = true;
+    uint32_t    occlusionDownscale      = 4;        // Size of the depth pyramid relative to the view.
+
+    uint32_t    lightCullingTileSize    = 32;       // Multiple of `occlusionDownscale`.
+    uint32_t    clusterDepth            = 64;
+    bool        lightClustering         = true;
+
+    // Texture streaming, with one block compressed texture per material whose mips are
+    //  required from the screen area of the material's chunks in the frustum.
+    uint32_t    textureSize             = 2048;
+    uint32_t    permanentTextureSize    = 64;
+    uint64_t    textureBudgetBytes      = 256ull << 20;
+    uint32_t    loadsPerFrame           = 32;
+    uint32_t    streamingLatencyFrames  = 2;        // Frames until a decision completes.
+
+    bool        trace                   = false;    // Records events for `writeTrace`.
+};
+
+// Timings and results of one frame.
+struct AAPLReplayFrame
+{
+    double      stageMilliseconds[AAPLReplayStageCount];
+    double      totalMilliseconds;
+
+    uint32_t    visibleChunks;
+    uint32_t    tileLights;                 // Sum of the opaque list lengths of all tiles.
+    uint32_t    streamingDecisions;
+
+    // Hash of the camera, chunk results, light lists and streaming decisions, which only
+    //  changes when the frame's results do.
+    uint64_t    checksum;
+};
+
+// Replays a camera path through a scene, running the CPU side of each frame: camera
+//  update, uniform packing, occluder rasterization, chunk culling, light culling and
+//  clustering, and texture streaming decisions.  Parallel stages run on a thread pool.
+class AAPLFrameReplay
+{
+public:
+    explicit AAPLFrameReplay(const AAPLFrameReplayConfig& config);
+    ~AAPLFrameReplay();
+
+    AAPLFrameReplay(const AAPLFrameReplay&) = delete;
+    AAPLFrameReplay& operator=(const AAPLFrameReplay&) = delete;
+
+    // Reads the scene, the path and the mesh file if configured.
+    bool load(const char* scenePath, const char* waypointsPath, std::string& error);
+
+    uint32_t frameCount() const;
+    unsigned threadCount() const;
+    size_t   chunkCount() const         { return _chunks.size(); }
+
+    const AAPLReplayScene& scene() const { return _scene; }
+
+    // Runs frame `frame` of the path.  Frames run in order, since streaming decisions
+    //  depend on the frames before them.
+    void runFrame(uint32_t frame, AAPLReplayFrame& result);
+
+    // Writes the events recorded so far in the Chrome trace event format.
+    bool writeTrace(const char* path, std::string& error) const;
+
+private:
+    struct TraceEvent
+    {
+        const char* name;
+        uint32_t    frame;
+        uint64_t    begin;                  // Nanoseconds since the replay was created.
+        uint64_t    end;
+    };
+
+    uint64_t now() const;
+    void     trace(uint32_t thread, const char* name, uint32_t frame, uint64_t begin, uint64_t end);
+
+    bool     loadMesh(std::string& error);
+    void     createSyntheticChunks();
+    void     setUpStreaming();
+
+    void     updateCamera(uint32_t frame);
+    void     packUniforms();
+    void     rasterizeOccluders();
+    void     cullChunks(uint32_t frame);
+    void     cullLights();
+    void     streamTextures(uint32_t frame);
+
+    AAPLFrameReplayConfig                   _config;
+    AAPLReplayScene                         _scene;
+    AAPLReplayCameraPath                    _path;
+
+    std::unique_ptr<AAPLTaskPool>           _pool;
+    uint64_t                                _startTime;
+
+    // Chunks in ranges of about equal size, one job each.
+    AAPLCPUCullChunks                       _chunks;
+    std::vector<uint32_t>                   _chunkMaterials;
+    std::vector<AAPLCPUCullChunks>          _chunkRanges;
+    std::vector<uint32_t>                   _chunkRangeBegins;
+    uint32_t                                _materialCount = 0;
+
+    // Per frame state.
+    AAPLReplayCameraParams                  _camera;
+    float                                   _cameraPosition[3];
+    AAPLCPUCullParams                       _cullParams;
+    AAPLCPUDepthPyramid                     _depthPyramid;
+    std::vector<float>                      _depth;
+    std::vector<float>                      _depthBounds;
+    std::vector<uint8_t>                    _cullResults;
+
+    // Buffers of each frame in flight, as the renderer's AAPLFrameData.
+    struct FrameBuffers
+    {
+        AAPLReplayCameraParams              cameraParams;
+        std::vector<AAPLCPUPointLight>      pointLights;
+        std::vector<AAPLCPUSpotLight>       spotLights;
+    };
+    std::vector<FrameBuffers>               _frameBuffers;
+    FrameBuffers*                           _currentBuffers = nullptr;
+
+    AAPLCPULightCullParams                  _lightCullParams;
+    AAPLCPULightCullResult                  _lightCullResult;
+
+    std::unique_ptr<AAPLTextureStreamingScheduler> _scheduler;
+    std::vector<std::vector<float>>         _materialAreas;         // Largest area per material, per thread.
+    struct PendingDecision
+    {
+        AAPLTextureStreamingScheduler::Decision decision;
+        uint32_t                                completionFrame;
+    };
+    std::vector<PendingDecision>            _pendingDecisions;
+
+    uint64_t                                _checksum = 0;
+    uint32_t                                _streamingDecisions = 0;
+
+    std::vector<std::vector<TraceEvent>>    _traceEvents;           // Per thread.
+};
+
+// Returns the `percentile` (0 to 100) of `values`, interpolating between the nearest ranks.
+double AAPLReplayPercentile(std::vector<double> values, double percentile);
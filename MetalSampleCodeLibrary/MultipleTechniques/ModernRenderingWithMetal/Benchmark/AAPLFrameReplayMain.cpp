@@ -0,0 +1,248 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that replays the camera path of a scene without a GPU and reports
+ the CPU time of each stage of the frame.
+*/
+#include "AAPLFrameReplay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --scene PATH         Scene file (default Assets/scene.scene)\n"
+            "  --waypoints PATH     Camera path (default from the scene's camera_keypoints_filename)\n"
+            "  --mesh PATH          Mesh file to cull the chunks of (default synthetic chunks)\n"
+            "  --chunks N           Number of synthetic chunks\n"
+            "  --frames N           Number of frames (default the whole path)\n"
+            "  --frame-time T       Progress along the path per frame (default 1/60)\n"
+            "  --warmup N           Frames excluded from the statistics (default 0)\n"
+            "  --threads N          Threads, including the main thread (default one per core)\n"
+            "  --width N            View width (default 1920)\n"
+            "  --height N           View height (default 1080)\n"
+            "  --no-occlusion       Skip the occlusion test of chunks\n"
+            "  --no-clustering      Skip light clustering\n"
+            "  --backfaces          Cull chunks that face away\n"
+            "  --trace PATH         Write a Chrome trace of the frames\n"
+            "  --csv PATH           Write the timings of each frame\n",
+            program);
+}
+
+struct Statistics
+{
+    double mean, p50, p90, p99, max;
+};
+
+Statistics statistics(const std::vector<double>& values)
+{
+    Statistics s = {};
+    if (values.empty())
+        return s;
+
+    for (double value : values)
+    {
+        s.mean += value;
+        s.max = std::max(s.max, value);
+    }
+    s.mean /= values.size();
+
+    s.p50 = AAPLReplayPercentile(values, 50.0);
+    s.p90 = AAPLReplayPercentile(values, 90.0);
+    s.p99 = AAPLReplayPercentile(values, 99.0);
+    return s;
+}
+
+void printStatistics(const char* name, const std::vector<double>& values)
+{
+    const Statistics s = statistics(values);
+    printf("%-20s %9.3f %9.3f %9.3f %9.3f %9.3f\n", name, s.mean, s.p50, s.p90, s.p99, s.max);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    AAPLFrameReplayConfig config;
+
+    std::string scenePath = "Assets/scene.scene";
+    std::string waypointsPath;
+    std::string tracePath;
+    std::string csvPath;
+    uint32_t warmupFrames = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        const auto takesValue = [&]()
+        {
+            if (!value)
+            {
+                fprintf(stderr, "Missing value for %s\n", arg);
+                exit(1);
+            }
+            ++i;
+            return value;
+        };
+
+        if (!strcmp(arg, "--scene"))
+            scenePath = takesValue();
+        else if (!strcmp(arg, "--waypoints"))
+            waypointsPath = takesValue();
+        else if (!strcmp(arg, "--mesh"))
+            config.meshPath = takesValue();
+        else if (!strcmp(arg, "--chunks"))
+            config.syntheticChunkCount = (uint32_t)atoi(takesValue());
+        else if (!strcmp(arg, "--frames"))
+            config.frameCount = (uint32_t)atoi(takesValue());
+        else if (!strcmp(arg, "--frame-time"))
+            config.frameTime = (float)atof(takesValue());
+        else if (!strcmp(arg, "--warmup"))
+            warmupFrames = (uint32_t)atoi(takesValue());
+        else if (!strcmp(arg, "--threads"))
+            config.threadCount = (unsigned)atoi(takesValue());
+        else if (!strcmp(arg, "--width"))
+            config.width = (uint32_t)atoi(takesValue());
+        else if (!strcmp(arg, "--height"))
+            config.height = (uint32_t)atoi(takesValue());
+        else if (!strcmp(arg, "--no-occlusion"))
+            config.occlusionCulling = false;
+        else if (!strcmp(arg, "--no-clustering"))
+            config.lightClustering = false;
+        else if (!strcmp(arg, "--backfaces"))
+            config.cullBackfaces = true;
+        else if (!strcmp(arg, "--trace"))
+            tracePath = takesValue();
+        else if (!strcmp(arg, "--csv"))
+            csvPath = takesValue();
+        else
+        {
+            printUsage(argv[0]);
+            return !strcmp(arg, "--help") ? 0 : 1;
+        }
+    }
+
+    if (config.frameTime <= 0.0f || config.width == 0 || config.height == 0)
+    {
+        fprintf(stderr, "The frame time and view size must be positive\n");
+        return 1;
+    }
+
+    config.trace = !tracePath.empty();
+
+    AAPLFrameReplay replay(config);
+
+    std::string error;
+    if (waypointsPath.empty())
+    {
+        // The scene names its path relative to its own directory, as AAPLScene does with the bundle.
+        AAPLReplayScene scene;
+        if (!scene.load(scenePath.c_str(), error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+
+        const size_t slash = scenePath.find_last_of('/');
+        const std::string directory = slash == std::string::npos ? std::string() : scenePath.substr(0, slash + 1);
+        waypointsPath = directory + scene.cameraKeypointsFilename + ".waypoints";
+    }
+
+    if (!replay.load(scenePath.c_str(), waypointsPath.c_str(), error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    const uint32_t frameCount = replay.frameCount();
+    printf("%u frames, %zu chunks, %zu point lights, %zu spot lights, %u threads\n",
+           frameCount, replay.chunkCount(), replay.scene().pointLights.size(), replay.scene().spotLights.size(),
+           replay.threadCount());
+
+    FILE* csv = nullptr;
+    if (!csvPath.empty())
+    {
+        csv = fopen(csvPath.c_str(), "w");
+        if (!csv)
+        {
+            fprintf(stderr, "Could not create %s\n", csvPath.c_str());
+            return 1;
+        }
+
+        fprintf(csv, "frame");
+        for (uint32_t s = 0; s < AAPLReplayStageCount; ++s)
+            fprintf(csv, ",%s", AAPLReplayStageName((AAPLReplayStage)s));
+        fprintf(csv, ",total,visible chunks,tile lights,streaming decisions,checksum\n");
+    }
+
+    std::vector<double> stageTimes[AAPLReplayStageCount];
+    std::vector<double> totalTimes;
+
+    uint64_t checksum = 0xCBF29CE484222325ull;
+    uint64_t visibleChunks = 0;
+    uint64_t tileLights = 0;
+    uint64_t streamingDecisions = 0;
+
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+    {
+        AAPLReplayFrame result;
+        replay.runFrame(frame, result);
+
+        if (csv)
+        {
+            fprintf(csv, "%u", frame);
+            for (uint32_t s = 0; s < AAPLReplayStageCount; ++s)
+                fprintf(csv, ",%.4f", result.stageMilliseconds[s]);
+            fprintf(csv, ",%.4f,%u,%u,%u,%016llx\n", result.totalMilliseconds, result.visibleChunks,
+                    result.tileLights, result.streamingDecisions, (unsigned long long)result.checksum);
+        }
+
+        // Frames combine in order, so that the checksum covers the whole replay.
+        for (int b = 0; b < 8; ++b)
+            checksum = (checksum ^ ((result.checksum >> (b * 8)) & 0xFF)) * 0x100000001B3ull;
+
+        visibleChunks       += result.visibleChunks;
+        tileLights          += result.tileLights;
+        streamingDecisions  += result.streamingDecisions;
+
+        if (frame < warmupFrames)
+            continue;
+
+        for (uint32_t s = 0; s < AAPLReplayStageCount; ++s)
+            stageTimes[s].push_back(result.stageMilliseconds[s]);
+        totalTimes.push_back(result.totalMilliseconds);
+    }
+
+    if (csv)
+        fclose(csv);
+
+    printf("\n%-20s %9s %9s %9s %9s %9s\n", "stage (ms)", "mean", "p50", "p90", "p99", "max");
+    for (uint32_t s = 0; s < AAPLReplayStageCount; ++s)
+        printStatistics(AAPLReplayStageName((AAPLReplayStage)s), stageTimes[s]);
+    printStatistics("frame", totalTimes);
+
+    if (frameCount)
+    {
+        printf("\nvisible chunks %.1f, tile lights %.1f, streaming decisions %.2f per frame\n",
+               (double)visibleChunks / frameCount, (double)tileLights / frameCount, (double)streamingDecisions / frameCount);
+    }
+    printf("checksum %016llx\n", (unsigned long long)checksum);
+
+    if (!tracePath.empty() && !replay.writeTrace(tracePath.c_str(), error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    return 0;
+}
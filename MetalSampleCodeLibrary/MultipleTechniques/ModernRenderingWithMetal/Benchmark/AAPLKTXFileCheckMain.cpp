@@ -0,0 +1,727 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that checks the KTX reader against synthetic KTX1 and KTX2 files, fuzzes
+ it with mutations of those files, and measures opening and parsing thousands of files.
+*/
+#include "../Asset/AAPLKTXFile.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define AAPL_HAS_ZLIB 1
+#endif
+
+#if __has_include(<zstd.h>)
+#include <zstd.h>
+#define AAPL_HAS_ZSTD 1
+#endif
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --fuzz N             Mutated files to parse and decode (default 200000)\n"
+            "  --files N            Synthetic files to measure opening (default 4000)\n"
+            "  --directory PATH     Measure opening the .ktx and .ktx2 files of a directory instead\n"
+            "  --seed N             Seed of the mutations (default 1)\n",
+            program);
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int failures = 0;
+
+void check(bool condition, const char* what, const std::string& context)
+{
+    if (!condition)
+    {
+        printf("  FAILED: %s (%s)\n", what, context.c_str());
+        failures++;
+    }
+}
+
+// MARK: - Synthetic files
+
+// Layout of a synthetic texture.  Zero height, depth or layer count store 0 in the header,
+//  as 1D, 2D and non array textures do, and zero levels ask the loader to generate them.
+struct TextureSpec
+{
+    const char* name;
+    uint32_t    glInternalFormat;
+    uint32_t    vkFormat;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    depth;
+    uint32_t    layerCount;
+    uint32_t    faceCount;
+    uint32_t    levelCount;
+};
+
+const TextureSpec TextureSpecs[] =
+{
+    { "RGBA8",          0x8058,  37,  256, 128, 0, 0, 1, 9 },
+    { "R8 padded",      0x8229,   9,   37,  19, 0, 0, 1, 6 },
+    { "ASTC 4x4",       0x93B0, 157, 1000, 600, 0, 0, 1, 10 },
+    { "ASTC 8x8",       0x93B7, 171,  130,  70, 0, 0, 1, 8 },
+    { "RGBA16F cube",   0x881A,  97,   64,  64, 0, 0, 6, 7 },
+    { "BC1 array",      0x8C4D, 134,   64,  64, 0, 4, 1, 7 },
+    { "RGBA8 cube array", 0x8058, 37,  32,  32, 0, 3, 6, 6 },
+    { "R32F 3D",        0x822E, 100,   16,  16, 8, 0, 1, 5 },
+    { "RGBA8 no mips",  0x8058,  37,   64,  64, 0, 0, 1, 0 },
+    { "R8 1D",          0x8229,   9,   33,   0, 0, 0, 1, 6 },
+};
+
+const uint8_t KTX1Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+const uint8_t KTX2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+// The value of this key is checked after parsing.
+const char OrientationKey[] = "KTXorientation";
+
+void append32(std::vector<uint8_t>& data, uint32_t value)
+{
+    data.insert(data.end(), (const uint8_t*)&value, (const uint8_t*)&value + sizeof(value));
+}
+
+void store32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+{
+    memcpy(&data[offset], &value, sizeof(value));
+}
+
+void store64(std::vector<uint8_t>& data, size_t offset, uint64_t value)
+{
+    memcpy(&data[offset], &value, sizeof(value));
+}
+
+void pad(std::vector<uint8_t>& data, size_t alignment)
+{
+    while (data.size() % alignment)
+        data.push_back(0);
+}
+
+// A value that differs between levels, images and bytes, so that misplaced data is caught.
+uint8_t pixelByte(uint32_t level, uint32_t image, size_t index)
+{
+    return (uint8_t)(level * 31 + image * 13 + index * 3);
+}
+
+// The images of a level, ordered by layer, face and slice.  KTX1 pads rows to 4 bytes.
+std::vector<uint8_t> levelImages(const TextureSpec& spec, const AAPLKTXFormat& format, uint32_t level, bool ktx1,
+                                 uint64_t& bytesPerImage)
+{
+    const uint32_t width  = std::max(spec.width >> level, 1u);
+    const uint32_t height = std::max(std::max(spec.height, 1u) >> level, 1u);
+    const uint32_t depth  = std::max(std::max(spec.depth, 1u) >> level, 1u);
+
+    uint64_t bytesPerRow = (uint64_t)((width + format.blockWidth - 1) / format.blockWidth) * format.bytesPerBlock;
+    if (ktx1)
+        bytesPerRow = (bytesPerRow + 3) & ~3ull;
+    bytesPerImage = bytesPerRow * ((height + format.blockHeight - 1) / format.blockHeight);
+
+    const uint32_t imageCount = std::max(spec.layerCount, 1u) * spec.faceCount * depth;
+
+    std::vector<uint8_t> images;
+    images.reserve(bytesPerImage * imageCount);
+    for (uint32_t image = 0; image < imageCount; ++image)
+        for (size_t i = 0; i < bytesPerImage; ++i)
+            images.push_back(pixelByte(level, image, i));
+    return images;
+}
+
+std::vector<uint8_t> keyValueData()
+{
+    const char orientation[] = "KTXorientation\0rd";
+    const char writer[] = "KTXwriter\0AAPLKTXFileCheck";
+
+    std::vector<uint8_t> data;
+    for (const auto& keyValue : { std::make_pair(orientation, sizeof(orientation)), std::make_pair(writer, sizeof(writer)) })
+    {
+        append32(data, (uint32_t)keyValue.second);
+        data.insert(data.end(), keyValue.first, keyValue.first + keyValue.second);
+        pad(data, 4);
+    }
+    return data;
+}
+
+std::vector<uint8_t> createKTX1(const TextureSpec& spec, const AAPLKTXFormat& format)
+{
+    const std::vector<uint8_t> keyValues = keyValueData();
+
+    std::vector<uint8_t> data(KTX1Identifier, KTX1Identifier + sizeof(KTX1Identifier));
+    for (uint32_t value : { 0x04030201u, 0u, 1u, 0u, spec.glInternalFormat, 0u, spec.width, spec.height, spec.depth,
+                            spec.layerCount, spec.faceCount, spec.levelCount, (uint32_t)keyValues.size() })
+        append32(data, value);
+    data.insert(data.end(), keyValues.begin(), keyValues.end());
+
+    for (uint32_t level = 0; level < std::max(spec.levelCount, 1u); ++level)
+    {
+        uint64_t bytesPerImage;
+        const std::vector<uint8_t> images = levelImages(spec, format, level, true, bytesPerImage);
+
+        // The image size of a cube map that isn't an array covers one face.
+        if (spec.faceCount == 6 && spec.layerCount == 0)
+        {
+            const size_t faceSize = images.size() / 6;
+            append32(data, (uint32_t)faceSize);
+            for (uint32_t face = 0; face < 6; ++face)
+            {
+                data.insert(data.end(), images.begin() + face * faceSize, images.begin() + (face + 1) * faceSize);
+                pad(data, 4);
+            }
+        }
+        else
+        {
+            append32(data, (uint32_t)images.size());
+            data.insert(data.end(), images.begin(), images.end());
+            pad(data, 4);
+        }
+    }
+    return data;
+}
+
+// Compresses a level with a KTX2 supercompression scheme.  Returns false if the tool was
+//  built without the scheme's library.
+bool supercompress(AAPLKTXFile::Supercompression scheme, const std::vector<uint8_t>& source, std::vector<uint8_t>& compressed)
+{
+    switch (scheme)
+    {
+        case AAPLKTXFile::SupercompressionNone:
+            compressed = source;
+            return true;
+
+#if AAPL_HAS_ZSTD
+        case AAPLKTXFile::SupercompressionZstd:
+            compressed.resize(ZSTD_compressBound(source.size()));
+            compressed.resize(ZSTD_compress(compressed.data(), compressed.size(), source.data(), source.size(), 3));
+            return true;
+#endif
+
+#if AAPL_HAS_ZLIB
+        case AAPLKTXFile::SupercompressionZlib:
+        {
+            uLongf size = compressBound((uLong)source.size());
+            compressed.resize(size);
+            compress2(compressed.data(), &size, source.data(), (uLong)source.size(), 6);
+            compressed.resize(size);
+            return true;
+        }
+#endif
+
+        default:
+            return false;
+    }
+}
+
+// Writes the levels from the smallest, as the specification recommends.  The data format
+//  descriptor is a placeholder the reader doesn't interpret.
+bool createKTX2(const TextureSpec& spec, const AAPLKTXFormat& format, AAPLKTXFile::Supercompression scheme,
+                std::vector<uint8_t>& data)
+{
+    const uint32_t levelCount = std::max(spec.levelCount, 1u);
+
+    data.assign(KTX2Identifier, KTX2Identifier + sizeof(KTX2Identifier));
+    for (uint32_t value : { spec.vkFormat, 1u, spec.width, spec.height, spec.depth, spec.layerCount,
+                            spec.faceCount, spec.levelCount, (uint32_t)scheme })
+        append32(data, value);
+
+    const size_t indexOffset = data.size();
+    data.resize(data.size() + 32 + levelCount * 24);
+    const size_t levelIndexOffset = indexOffset + 32;
+
+    const size_t descriptorOffset = data.size();
+    append32(data, 8);
+    append32(data, 0);
+
+    const std::vector<uint8_t> keyValues = keyValueData();
+    const size_t keyValueOffset = data.size();
+    data.insert(data.end(), keyValues.begin(), keyValues.end());
+
+    store32(data, indexOffset, (uint32_t)descriptorOffset);
+    store32(data, indexOffset + 4, 8);
+    store32(data, indexOffset + 8, (uint32_t)keyValueOffset);
+    store32(data, indexOffset + 12, (uint32_t)keyValues.size());
+
+    for (uint32_t level = levelCount; level-- > 0; )
+    {
+        uint64_t bytesPerImage;
+        const std::vector<uint8_t> images = levelImages(spec, format, level, false, bytesPerImage);
+
+        std::vector<uint8_t> compressed;
+        if (!supercompress(scheme, images, compressed))
+            return false;
+
+        pad(data, 16);
+        store64(data, levelIndexOffset + level * 24, data.size());
+        store64(data, levelIndexOffset + level * 24 + 8, compressed.size());
+        store64(data, levelIndexOffset + level * 24 + 16, images.size());
+        data.insert(data.end(), compressed.begin(), compressed.end());
+    }
+    return true;
+}
+
+const char* schemeName(AAPLKTXFile::Supercompression scheme)
+{
+    switch (scheme)
+    {
+        case AAPLKTXFile::SupercompressionNone:     return "none";
+        case AAPLKTXFile::SupercompressionBasisLZ:  return "BasisLZ";
+        case AAPLKTXFile::SupercompressionZstd:     return "Zstd";
+        case AAPLKTXFile::SupercompressionZlib:     return "zlib";
+    }
+    return "unknown";
+}
+
+// MARK: - Checks
+
+// Compares every image of a parsed file, both as spans of the file and decoded, with the
+//  images it was written from.
+void checkFile(const AAPLKTXFile& file, const TextureSpec& spec, bool ktx1, const std::string& context)
+{
+    check(file.version() == (ktx1 ? 1u : 2u), "version", context);
+    check(file.width() == spec.width, "width", context);
+    check(file.height() == std::max(spec.height, 1u), "height", context);
+    check(file.depth() == std::max(spec.depth, 1u), "depth", context);
+    check(file.layerCount() == std::max(spec.layerCount, 1u), "layer count", context);
+    check(file.isArray() == (spec.layerCount != 0), "array", context);
+    check(file.faceCount() == spec.faceCount, "face count", context);
+    check(file.levelCount() == std::max(spec.levelCount, 1u), "level count", context);
+    check(file.generatesMipmaps() == (spec.levelCount == 0), "generated mipmaps", context);
+
+    const AAPLKTXSpan orientation = file.value(OrientationKey);
+    check(file.keyValueCount() == 2, "key/value count", context);
+    check(orientation.size == 3 && !memcmp(orientation.data, "rd", 3), "orientation value", context);
+    check(file.value("missing").size == 0, "missing key", context);
+
+    const bool supercompressed = file.supercompression() != AAPLKTXFile::SupercompressionNone;
+    const uint32_t imageCount = file.layerCount() * file.faceCount();
+
+    for (uint32_t level = 0; level < file.levelCount(); ++level)
+    {
+        const std::string levelContext = context + ", level " + std::to_string(level);
+        const AAPLKTXFile::Level& levelInfo = file.level(level);
+
+        uint64_t bytesPerImage;
+        const std::vector<uint8_t> images = levelImages(spec, file.format(), level, ktx1, bytesPerImage);
+        check(levelInfo.bytesPerImage == bytesPerImage, "bytes per image", levelContext);
+        if (levelInfo.bytesPerImage != bytesPerImage)
+            continue;
+
+        for (uint32_t image = 0; image < imageCount; ++image)
+        {
+            for (uint32_t slice = 0; slice < levelInfo.depth; ++slice)
+            {
+                const uint8_t* expected = images.data() + (image * levelInfo.depth + slice) * bytesPerImage;
+                const AAPLKTXSpan span = file.image(level, image / file.faceCount(), image % file.faceCount(), slice);
+                if (supercompressed)
+                    check(span.size == 0, "supercompressed image span", levelContext);
+                else
+                    check(span.size == bytesPerImage && !memcmp(span.data, expected, bytesPerImage), "image span", levelContext);
+            }
+        }
+
+        // Decode the whole level, and in pieces of an odd size, and compare each image.
+        std::string error;
+        std::vector<uint8_t> decoded(levelInfo.uncompressedLength);
+        check(AAPLKTXDecodeLevel(file, level, decoded.data(), decoded.size(), error), "level decode", levelContext);
+
+        std::vector<uint8_t> streamed;
+        AAPLKTXLevelDecoder decoder;
+        check(decoder.begin(file, level, error), "decoder start", levelContext);
+        while (decoder.remaining())
+        {
+            uint8_t piece[777];
+            size_t written = 0;
+            if (!decoder.decode(piece, sizeof(piece), written, error) || written == 0)
+                break;
+            streamed.insert(streamed.end(), piece, piece + written);
+        }
+        check(streamed == decoded, "streamed decode", levelContext);
+
+        for (uint32_t image = 0; image < imageCount; ++image)
+        {
+            const uint64_t offset = image * levelInfo.faceStride;
+            const uint64_t size   = bytesPerImage * levelInfo.depth;
+            check(offset + size <= decoded.size() &&
+                  !memcmp(decoded.data() + offset, images.data() + image * size, size), "decoded image", levelContext);
+        }
+    }
+}
+
+// Checks that damaged files fail to parse or decode with an error instead of crashing.
+void checkErrors(const TextureSpec& spec, const AAPLKTXFormat& format)
+{
+    AAPLKTXFile file;
+    std::string error;
+
+    std::vector<uint8_t> data = createKTX1(spec, format);
+    store32(data, 28, 0x1234);
+    check(!file.parse(data.data(), data.size(), error), "unknown format fails", error);
+
+    data = createKTX1(spec, format);
+    data.resize(data.size() - 10);
+    check(!file.parse(data.data(), data.size(), error), "truncated file fails", error);
+
+    data = createKTX1(spec, format);
+    store32(data, 56, 20);
+    check(!file.parse(data.data(), data.size(), error), "too many levels fails", error);
+
+    createKTX2(spec, format, AAPLKTXFile::SupercompressionNone, data);
+    store32(data, 44, AAPLKTXFile::SupercompressionBasisLZ);
+    check(!file.parse(data.data(), data.size(), error), "BasisLZ fails", error);
+
+    // A supercompressed level cut in half parses, but fails to decode.
+    for (AAPLKTXFile::Supercompression scheme : { AAPLKTXFile::SupercompressionZstd, AAPLKTXFile::SupercompressionZlib })
+    {
+        if (!createKTX2(spec, format, scheme, data))
+            continue;
+
+        uint64_t length;
+        memcpy(&length, &data[80 + 8], sizeof(length));
+        store64(data, 80 + 8, length / 2);
+
+        if (file.parse(data.data(), data.size(), error))
+        {
+            std::vector<uint8_t> decoded(file.level(0).uncompressedLength);
+            check(!AAPLKTXDecodeLevel(file, 0, decoded.data(), decoded.size(), error), "truncated level fails", schemeName(scheme));
+        }
+        else
+        {
+            check(false, "truncated level parses", error);
+        }
+    }
+
+    check(!file.open("/nonexistent/texture.ktx", error), "missing file fails", error);
+}
+
+// MARK: - Fuzzing
+
+// Parses mutations of the synthetic files from an exactly sized allocation, so that the
+//  address sanitizer catches any read outside the file, reads the first and last byte of
+//  every span, and decodes every level.  Returns the number of files that parsed.
+size_t fuzz(const std::vector<std::vector<uint8_t>>& corpus, unsigned iterations, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    size_t parsedCount = 0;
+    volatile uint32_t sum = 0;
+
+    for (unsigned iteration = 0; iteration < iterations; ++iteration)
+    {
+        std::vector<uint8_t> data = corpus[random() % corpus.size()];
+
+        const unsigned mutationCount = 1 + random() % 8;
+        for (unsigned m = 0; m < mutationCount; ++m)
+        {
+            switch (random() % 6)
+            {
+                case 0:
+                    data[random() % data.size()] = (uint8_t)random();
+                    break;
+                case 1:
+                    data[random() % data.size()] ^= 1 << (random() % 8);
+                    break;
+                case 2:
+                    data.resize(random() % data.size() + 1);
+                    break;
+                case 3:
+                    data.insert(data.begin() + random() % data.size(), random() % 16, (uint8_t)random());
+                    break;
+                case 4:
+                {
+                    // A header field, either huge or plausible.
+                    const size_t offset = (random() % std::min<size_t>(data.size(), 256)) & ~3ull;
+                    const uint32_t value = random() % 3 == 0 ? 0xFFFFFFFF : random() % 0x20000;
+                    if (offset + sizeof(value) <= data.size())
+                        memcpy(&data[offset], &value, sizeof(value));
+                    break;
+                }
+                case 5:
+                {
+                    // A KTX2 index entry, either overflowing or within twice the file size.
+                    const size_t offset = 48 + random() % 96;
+                    const uint64_t value = random() % 2 ? ~0ull - random() % 100 : random() % (data.size() * 2);
+                    if (offset + sizeof(value) <= data.size())
+                        memcpy(&data[offset], &value, sizeof(value));
+                    break;
+                }
+            }
+        }
+
+        uint8_t* copy = (uint8_t*)malloc(data.size());
+        memcpy(copy, data.data(), data.size());
+
+        AAPLKTXFile file;
+        std::string error;
+        if (file.parse(copy, data.size(), error))
+        {
+            parsedCount++;
+
+            for (uint32_t level = 0; level < file.levelCount(); ++level)
+            {
+                const AAPLKTXSpan levelData = file.levelData(level);
+                if (levelData.size)
+                    sum += levelData.data[0] + levelData.data[levelData.size - 1];
+
+                for (uint32_t layer = 0; layer < std::min(file.layerCount(), 8u); ++layer)
+                {
+                    for (uint32_t face = 0; face < file.faceCount(); ++face)
+                    {
+                        for (uint32_t slice = 0; slice < std::min(file.level(level).depth, 8u); ++slice)
+                        {
+                            const AAPLKTXSpan image = file.image(level, layer, face, slice);
+                            if (image.size)
+                                sum += image.data[0] + image.data[image.size - 1];
+                        }
+                    }
+                }
+
+                if (file.level(level).uncompressedLength < (64u << 20))
+                {
+                    std::vector<uint8_t> decoded(file.level(level).uncompressedLength);
+                    AAPLKTXDecodeLevel(file, level, decoded.data(), decoded.size(), error);
+                }
+            }
+
+            for (size_t i = 0; i < file.keyValueCount(); ++i)
+            {
+                const AAPLKTXSpan value = file.value(i);
+                sum += (uint32_t)strlen(file.key(i));
+                if (value.size)
+                    sum += value.data[value.size - 1];
+            }
+        }
+
+        free(copy);
+    }
+
+    return parsedCount;
+}
+
+// MARK: - Measurements
+
+bool hasKTXExtension(const char* name)
+{
+    const char* extension = strrchr(name, '.');
+    return extension && (!strcmp(extension, ".ktx") || !strcmp(extension, ".ktx2"));
+}
+
+std::vector<std::string> listKTXFiles(const char* directory)
+{
+    std::vector<std::string> paths;
+    if (DIR* dir = opendir(directory))
+    {
+        while (const dirent* entry = readdir(dir))
+        {
+            if (hasKTXExtension(entry->d_name))
+                paths.push_back(std::string(directory) + "/" + entry->d_name);
+        }
+        closedir(dir);
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// Opens each file, parses it, and looks up the first image of every level, as a loader does
+//  before it allocates a texture.  Returns the number of files that opened.
+size_t openFiles(const std::vector<std::string>& paths, uint64_t& checksum)
+{
+    size_t openCount = 0;
+    AAPLKTXFile file;
+    std::string error;
+    for (const std::string& path : paths)
+    {
+        if (!file.open(path.c_str(), error))
+            continue;
+
+        openCount++;
+        for (uint32_t level = 0; level < file.levelCount(); ++level)
+            checksum += file.level(level).bytesPerImage + file.levelData(level).size + file.image(level, 0, 0).size;
+    }
+    return openCount;
+}
+
+void measure(const std::vector<std::vector<uint8_t>>& corpus, const std::vector<std::string>& paths)
+{
+    // Name the files the measurements skip.
+    for (const std::string& path : paths)
+    {
+        AAPLKTXFile file;
+        std::string error;
+        if (!file.open(path.c_str(), error))
+            printf("  %s\n", error.c_str());
+    }
+
+    uint64_t checksum = 0;
+    double best = 1e30;
+    size_t openCount = 0;
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        openCount = openFiles(paths, checksum);
+        best = std::min(best, seconds(begin));
+    }
+    printf("  Open, parse and look up %zu of %zu files: %.1f ms, %.2f us per file\n",
+           openCount, paths.size(), best * 1e3, best * 1e6 / std::max<size_t>(openCount, 1));
+
+    // Parsing alone, from memory.
+    const unsigned repeat = 100;
+    AAPLKTXFile file;
+    std::string error;
+    const auto begin = std::chrono::steady_clock::now();
+    for (unsigned r = 0; r < repeat; ++r)
+    {
+        for (const std::vector<uint8_t>& data : corpus)
+        {
+            if (!file.parse(data.data(), data.size(), error))
+                continue;
+            for (uint32_t level = 0; level < file.levelCount(); ++level)
+                checksum += file.level(level).bytesPerImage + file.image(level, 0, 0).size;
+        }
+    }
+    printf("  Parse and look up in memory: %.0f ns per file (checksum %llu)\n",
+           seconds(begin) * 1e9 / (repeat * corpus.size()), (unsigned long long)checksum);
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    unsigned fuzzIterations = 200000;
+    unsigned fileCount = 4000;
+    const char* directory = nullptr;
+    uint32_t seed = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--fuzz") && i + 1 < argc)
+        {
+            fuzzIterations = (unsigned)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--files") && i + 1 < argc)
+        {
+            fileCount = (unsigned)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--directory") && i + 1 < argc)
+        {
+            directory = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = (uint32_t)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    printf("Synthetic files\n");
+
+    std::vector<std::vector<uint8_t>> corpus;
+    for (const TextureSpec& spec : TextureSpecs)
+    {
+        const AAPLKTXFormat* format = AAPLKTXFormatForVkFormat(spec.vkFormat);
+        if (!format)
+        {
+            check(false, "format lookup", spec.name);
+            continue;
+        }
+
+        AAPLKTXFile file;
+        std::string error;
+
+        corpus.push_back(createKTX1(spec, *format));
+        const std::string context = std::string(spec.name) + ", KTX1";
+        if (file.parse(corpus.back().data(), corpus.back().size(), error))
+            checkFile(file, spec, true, context);
+        else
+            check(false, "parse", context + ": " + error);
+
+        for (AAPLKTXFile::Supercompression scheme : { AAPLKTXFile::SupercompressionNone,
+                                                      AAPLKTXFile::SupercompressionZstd,
+                                                      AAPLKTXFile::SupercompressionZlib })
+        {
+            std::vector<uint8_t> data;
+            if (!createKTX2(spec, *format, scheme, data))
+                continue;
+
+            corpus.push_back(data);
+            const std::string context = std::string(spec.name) + ", KTX2 " + schemeName(scheme);
+            if (file.parse(corpus.back().data(), corpus.back().size(), error))
+                checkFile(file, spec, false, context);
+            else
+                check(false, "parse", context + ": " + error);
+        }
+    }
+
+    checkErrors(TextureSpecs[0], *AAPLKTXFormatForVkFormat(TextureSpecs[0].vkFormat));
+    printf("  %zu files checked\n", corpus.size());
+
+    if (fuzzIterations)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        const size_t parsedCount = fuzz(corpus, fuzzIterations, seed);
+        printf("  %u mutated files, %zu parsed, in %.1f s\n", fuzzIterations, parsedCount, seconds(begin));
+    }
+
+    if (directory)
+    {
+        printf("\n%s\n", directory);
+        measure(corpus, listKTXFiles(directory));
+    }
+    else if (fileCount)
+    {
+        // Write copies of the synthetic files to a temporary directory.
+        const char* temp = getenv("TMPDIR");
+        std::string directoryTemplate = std::string(temp ? temp : "/tmp") + "/AAPLKTXFileCheck.XXXXXX";
+        if (!mkdtemp(&directoryTemplate[0]))
+        {
+            perror("mkdtemp");
+            return 1;
+        }
+
+        std::vector<std::string> paths;
+        for (unsigned i = 0; i < fileCount; ++i)
+        {
+            const std::vector<uint8_t>& data = corpus[i % corpus.size()];
+            char name[32];
+            snprintf(name, sizeof(name), "/%05u.%s", i, data[5] == '2' ? "ktx2" : "ktx");
+            paths.push_back(directoryTemplate + name);
+
+            FILE* output = fopen(paths.back().c_str(), "wb");
+            const bool written = output && fwrite(data.data(), 1, data.size(), output) == data.size();
+            if (output)
+                fclose(output);
+            check(written, "write", paths.back());
+        }
+
+        printf("\n%u synthetic files\n", fileCount);
+        measure(corpus, paths);
+
+        for (const std::string& path : paths)
+            unlink(path.c_str());
+        rmdir(directoryTemplate.c_str());
+    }
+
+    printf("\n%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,321 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that measures light culling and clustering on the CPU for each light
+ count, tile size and cluster depth, and checks the SIMD lists against the scalar ones.
+*/
+#include "../Renderer/RenderTech/AAPLCPULightCulling.h"
+#include "../Renderer/RenderTech/AAPLTaskPool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --lights LIST        Comma separated counts of point lights and of spot lights, up to 256\n"
+            "                       (default 32,128,256)\n"
+            "  --tile-size LIST     Comma separated tile sizes in pixels (default 16,32,64)\n"
+            "  --cluster-depth LIST Comma separated depth slices per cluster column (default 16,32,64)\n"
+            "  --width N            Width of the view in pixels (default 1920)\n"
+            "  --height N           Height of the view in pixels (default 1080)\n"
+            "  --threads N          Threads of the task pool, 0 for one per core (default 0)\n"
+            "  --repeat N           Culls per measurement, keeping the fastest (default 10)\n"
+            "  --seed N             Seed of the lights (default 1)\n",
+            program);
+}
+
+std::vector<uint32_t> parseList(const char* list)
+{
+    std::vector<uint32_t> values;
+    for (const char* p = list; *p; )
+    {
+        values.push_back((uint32_t)strtoul(p, (char**)&p, 10));
+        if (*p == ',')
+            ++p;
+        else if (*p)
+            return {};
+    }
+    return values;
+}
+
+struct Random
+{
+    uint32_t state;
+
+    // Returns a float in [0, 1).
+    float next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float range(float low, float high) { return low + (high - low) * next(); }
+};
+
+const float ViewAngle   = 65.0f * (float)M_PI / 180.0f;
+const float NearPlane   = 0.1f;
+const float FarPlane    = 100.0f;
+
+// Left handed perspective projection, as AAPLCamera.
+void setProjection(float aspectRatio, AAPLCPULightCullParams& params)
+{
+    const float ys = 1.0f / tanf(ViewAngle * 0.5f);
+    const float zs = FarPlane / (FarPlane - NearPlane);
+    const float projection[16] = { ys / aspectRatio, 0, 0, 0,
+                                   0, ys, 0, 0,
+                                   0, 0, zs, 1,
+                                   0, 0, -NearPlane * zs, 0 };
+    memcpy(params.projectionMatrix, projection, sizeof(projection));
+    params.nearPlane = NearPlane;
+}
+
+// Scatters lights through the view frustum, half of them affecting transparent geometry.
+void createLights(uint32_t count, float aspectRatio, uint32_t seed,
+                  std::vector<AAPLCPUPointLight>& pointLights, std::vector<AAPLCPUSpotLight>& spotLights)
+{
+    Random random = { seed };
+    const float tanY = tanf(ViewAngle * 0.5f);
+
+    const auto position = [&](float p[3])
+    {
+        p[2] = random.range(1.0f, 60.0f);
+        p[0] = random.range(-1.2f, 1.2f) * p[2] * tanY * aspectRatio;
+        p[1] = random.range(-1.2f, 1.2f) * p[2] * tanY;
+    };
+
+    pointLights.resize(count);
+    for (AAPLCPUPointLight& light : pointLights)
+    {
+        position(light.posRadius);
+        light.posRadius[3] = random.range(0.5f, 6.0f) * (random.next() < 0.5f ? 1.0f : -1.0f);
+    }
+
+    spotLights.resize(count);
+    for (AAPLCPUSpotLight& light : spotLights)
+    {
+        float dir[3] = { random.range(-1, 1), random.range(-1, 0.2f), random.range(-1, 1) };
+        const float invLength = 1.0f / sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+
+        const float height   = random.range(2.0f, 12.0f);
+        const float angle    = random.range(0.2f, 0.8f);
+        const float halfSide = height * tanf(angle);
+
+        position(light.posAndHeight);
+        light.posAndHeight[3] = height;
+
+        for (int c = 0; c < 3; ++c)
+        {
+            light.dirAndOuterAngle[c] = dir[c] * invLength;
+            light.posRadius[c]        = light.posAndHeight[c] + light.dirAndOuterAngle[c] * height * 0.5f;
+        }
+        light.dirAndOuterAngle[3] = cosf(angle);
+
+        const float radius = sqrtf(height * height * 0.25f + halfSide * halfSide);
+        light.posRadius[3] = random.next() < 0.5f ? radius : -radius;
+    }
+}
+
+// A floor rising toward the horizon with boxes standing on it, in view space depths.
+void createDepth(uint32_t width, uint32_t height, std::vector<float>& depth)
+{
+    depth.resize((size_t)width * height);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const float v = (float)y / height;
+        const float floor = v > 0.5f ? std::min(FarPlane, 2.0f / (v - 0.5f)) : FarPlane;
+
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const uint32_t box = (x / 96) * 7 + (y / 80) * 13;
+            const float boxDepth = (box % 5 == 0) ? 4.0f + (box % 37) : FarPlane;
+            depth[(size_t)y * width + x] = std::min(floor, boxDepth);
+        }
+    }
+}
+
+// Runs every stage, as the frame replay does.
+void cull(const AAPLCPULightCullParams& params, const std::vector<float>& depth, std::vector<float>& depthBounds,
+          const std::vector<AAPLCPUPointLight>& pointLights, const std::vector<AAPLCPUSpotLight>& spotLights,
+          AAPLCPULightCullResult& result)
+{
+    AAPLCPULightCullDepthBounds(params, depth.data(), depthBounds);
+    AAPLCPULightCullCoarse(params, pointLights.data(), pointLights.size(), spotLights.data(), spotLights.size(), result);
+    AAPLCPULightCullTiles(params, depthBounds.data(), pointLights.data(), pointLights.size(),
+                          spotLights.data(), spotLights.size(), result);
+    AAPLCPULightCullClusters(params, pointLights.data(), pointLights.size(), spotLights.data(), spotLights.size(), result);
+}
+
+bool sameLists(const AAPLCPULightCullResult& a, const AAPLCPULightCullResult& b)
+{
+    return a.pointLightXYCoarseCullIndices == b.pointLightXYCoarseCullIndices
+        && a.spotLightXYCoarseCullIndices == b.spotLightXYCoarseCullIndices
+        && a.pointLightIndices == b.pointLightIndices
+        && a.pointLightIndicesTransparent == b.pointLightIndicesTransparent
+        && a.spotLightIndices == b.spotLightIndices
+        && a.spotLightIndicesTransparent == b.spotLightIndicesTransparent
+        && a.pointLightClusterIndices == b.pointLightClusterIndices
+        && a.spotLightClusterIndices == b.spotLightClusterIndices;
+}
+
+// Mean count of the lists of `stride` bytes in `lists`.
+double meanCount(const std::vector<uint8_t>& lists, size_t stride)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < lists.size(); i += stride)
+        total += lists[i];
+    return lists.empty() ? 0.0 : total / (double)(lists.size() / stride);
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    std::vector<uint32_t> lightCounts = { 32, 128, 256 };
+    std::vector<uint32_t> tileSizes = { 16, 32, 64 };
+    std::vector<uint32_t> clusterDepths = { 16, 32, 64 };
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    unsigned threadCount = 0;
+    unsigned repeat = 10;
+    uint32_t seed = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--lights") && i + 1 < argc)
+        {
+            lightCounts = parseList(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--tile-size") && i + 1 < argc)
+        {
+            tileSizes = parseList(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--cluster-depth") && i + 1 < argc)
+        {
+            clusterDepths = parseList(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--width") && i + 1 < argc)
+        {
+            width = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--height") && i + 1 < argc)
+        {
+            height = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            threadCount = (unsigned)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+        {
+            repeat = (unsigned)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = (uint32_t)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    const auto invalid = [](const std::vector<uint32_t>& list, uint32_t maximum)
+    {
+        return list.empty() || std::count(list.begin(), list.end(), 0u) || *std::max_element(list.begin(), list.end()) > maximum;
+    };
+
+    // Lists store light indices in bytes.
+    if (invalid(lightCounts, 256) || invalid(tileSizes, 1024) || invalid(clusterDepths, 1024)
+        || width == 0 || height == 0 || repeat == 0 || seed == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    AAPLTaskPool pool(threadCount);
+
+    const float aspectRatio = (float)width / height;
+
+    std::vector<float> depth;
+    createDepth(width, height, depth);
+
+    printf("%u x %u, %u threads (ms per frame, mean lights per opaque tile and per cluster)\n\n", width, height, pool.threadCount());
+    printf("  %6s %5s %6s %8s %9s %9s %9s %10s %8s\n",
+           "lights", "tile", "depth", "tiles", "clusters", "SIMD", "scalar", "per tile", "per cluster");
+
+    int failures = 0;
+
+    for (uint32_t lightCount : lightCounts)
+    {
+        std::vector<AAPLCPUPointLight> pointLights;
+        std::vector<AAPLCPUSpotLight> spotLights;
+        createLights(lightCount, aspectRatio, seed, pointLights, spotLights);
+
+        for (uint32_t tileSize : tileSizes)
+        {
+            for (uint32_t clusterDepth : clusterDepths)
+            {
+                AAPLCPULightCullParams params;
+                setProjection(aspectRatio, params);
+                params.width                    = width;
+                params.height                   = height;
+                params.lightCullingTileSize     = tileSize;
+                params.lightClusteringTileSize  = tileSize;
+                params.clusterDepth             = clusterDepth;
+                params.taskPool                 = &pool;
+
+                AAPLCPULightCullResult simdResult, scalarResult;
+                AAPLCPULightCullCreateResult(params, pointLights.size(), spotLights.size(), simdResult);
+                AAPLCPULightCullCreateResult(params, pointLights.size(), spotLights.size(), scalarResult);
+
+                std::vector<float> depthBounds;
+
+                double times[2] = { 1e30, 1e30 };
+                for (int vectorized = 1; vectorized >= 0; --vectorized)
+                {
+                    params.vectorized = vectorized != 0;
+                    AAPLCPULightCullResult& result = vectorized ? simdResult : scalarResult;
+
+                    for (unsigned r = 0; r < repeat; ++r)
+                    {
+                        const auto begin = std::chrono::steady_clock::now();
+                        cull(params, depth, depthBounds, pointLights, spotLights, result);
+                        times[vectorized] = std::min(times[vectorized],
+                                                     std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+                    }
+                }
+
+                const bool match = sameLists(simdResult, scalarResult);
+                failures += !match;
+
+                const double perTile    = meanCount(simdResult.pointLightIndices, AAPLCPULightsPerTile)
+                                        + meanCount(simdResult.spotLightIndices, AAPLCPULightsPerTile);
+                const double perCluster = meanCount(simdResult.pointLightClusterIndices, AAPLCPULightsPerCluster)
+                                        + meanCount(simdResult.spotLightClusterIndices, AAPLCPULightsPerCluster);
+
+                printf("  %6u %5u %6u %8u %9u %9.3f %9.3f %10.1f %8.2f%s\n",
+                       lightCount, tileSize, clusterDepth, simdResult.tileCountX * simdResult.tileCountY,
+                       simdResult.tileCountClusterX * simdResult.tileCountClusterY * clusterDepth,
+                       times[1] * 1e3, times[0] * 1e3, perTile, perCluster, match ? "" : "   lists differ");
+            }
+        }
+    }
+
+    printf("\n%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
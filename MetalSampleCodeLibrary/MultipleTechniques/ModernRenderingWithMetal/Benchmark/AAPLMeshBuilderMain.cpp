@@ -0,0 +1,792 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that builds the chunks of an OBJ file or of raw vertex and index streams,
+ writes a mesh file the sample loads, reads it back, and reports the quality of the chunks.
+*/
+#include "../Asset/AAPLMeshChunkBuilder.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__APPLE__)
+#include "../Asset/AAPLMaterial.h"
+#endif
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options] [-o OUTPUT] INPUT.obj\n"
+            "       %s [options] [-o OUTPUT] --positions FILE --indices FILE [--normals FILE] [--uvs FILE]\n"
+            "       %s [options] [-o OUTPUT] --synthetic N\n"
+            "  -o OUTPUT            Mesh file to write; without it, only builds and checks the chunks\n"
+            "  --positions FILE     Raw float xyz positions\n"
+            "  --indices FILE       Raw uint32 triangle indices\n"
+            "  --normals FILE       Raw float xyz normals\n"
+            "  --uvs FILE           Raw float uv texture coordinates\n"
+            "  --synthetic N        Build a bumpy sphere of about N triangles instead\n"
+            "  --max-vertices N     Unique vertices per chunk (default 128)\n"
+            "  --max-triangles N    Triangles per chunk (default 128)\n"
+            "  --cone-weight F      From 0 for compact chunks to 1 for tight normal cones (default 0.5)\n"
+            "  --cache-size N       Entries of the post-transform cache to optimize for (default 16)\n"
+            "  --threads N          Build threads, 0 for one per core (default 0)\n"
+            "  --codec NAME         none, lz4, zlib, lzma, lzfse or zstd (default zlib)\n"
+            "  --block-size N       Uncompressed size of each compressed block (default 65536)\n",
+            program, program, program);
+}
+
+// Layout of AAPLMaterial, whose vector_float3 members take 16 bytes, for code built without
+//  the simd headers.
+struct alignas(16) MaterialLayout
+{
+    float               baseColor[4];
+    uint32_t            baseColorTextureHash;
+    bool                hasBaseColorTexture;
+    bool                hasDiffuseMask;
+    alignas(16) float   metallicRoughness[4];
+    uint32_t            metallicRoughnessHash;
+    bool                hasMetallicRoughnessTexture;
+    uint32_t            normalMapHash;
+    bool                hasNormalMap;
+    alignas(16) float   emissiveColor[4];
+    uint32_t            emissiveTextureHash;
+    bool                hasEmissiveTexture;
+    float               opacity;
+};
+
+static_assert(sizeof(MaterialLayout) == 96, "Unexpected layout");
+
+#if defined(__APPLE__)
+static_assert(sizeof(MaterialLayout) == sizeof(AAPLMaterial)
+              && offsetof(MaterialLayout, metallicRoughness) == offsetof(AAPLMaterial, metallicRoughness)
+              && offsetof(MaterialLayout, opacity) == offsetof(AAPLMaterial, opacity),
+              "MaterialLayout doesn't match AAPLMaterial");
+#endif
+
+// A raw mesh with its submeshes' indices, which AAPLMeshBuilderInput points into.
+struct Mesh
+{
+    std::vector<float>                  positions;
+    std::vector<float>                  normals;
+    std::vector<float>                  uvs;
+
+    std::vector<std::vector<uint32_t>>  submeshIndices;
+    std::vector<AAPLMeshBlendMode>      blendModes;
+    std::vector<MaterialLayout>         materials;
+
+    size_t vertexCount() const { return positions.size() / 3; }
+};
+
+MaterialLayout defaultMaterial()
+{
+    MaterialLayout material = {};
+    material.baseColor[0] = material.baseColor[1] = material.baseColor[2] = 0.8f;
+    material.metallicRoughness[1] = 0.5f;
+    material.opacity = 1.0f;
+    return material;
+}
+
+bool readFile(const char* path, std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Could not open '%s'\n", path);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    data.resize((size_t)std::max(0L, ftell(file)));
+    fseek(file, 0, SEEK_SET);
+    const bool read = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+
+    if (!read)
+        fprintf(stderr, "Could not read '%s'\n", path);
+    return read;
+}
+
+template <typename T>
+bool readStream(const char* path, size_t components, std::vector<T>& values)
+{
+    std::vector<uint8_t> data;
+    if (!readFile(path, data))
+        return false;
+
+    if (data.size() % (components * sizeof(T)) != 0)
+    {
+        fprintf(stderr, "The size of '%s' isn't a multiple of %zu bytes\n", path, components * sizeof(T));
+        return false;
+    }
+
+    values.resize(data.size() / sizeof(T));
+    memcpy(values.data(), data.data(), data.size());
+    return true;
+}
+
+bool loadRaw(const char* positionsPath, const char* indicesPath, const char* normalsPath, const char* uvsPath, Mesh& mesh)
+{
+    mesh.submeshIndices.resize(1);
+    if (!readStream(positionsPath, 3, mesh.positions) || !readStream(indicesPath, 3, mesh.submeshIndices[0]))
+        return false;
+
+    if ((normalsPath && !readStream(normalsPath, 3, mesh.normals)) || (uvsPath && !readStream(uvsPath, 2, mesh.uvs)))
+        return false;
+
+    if ((!mesh.normals.empty() && mesh.normals.size() != mesh.positions.size())
+        || (!mesh.uvs.empty() && mesh.uvs.size() / 2 != mesh.vertexCount()))
+    {
+        fprintf(stderr, "The vertex streams have different vertex counts\n");
+        return false;
+    }
+
+    mesh.blendModes.push_back(AAPLMeshBlendMode::Opaque);
+    mesh.materials.push_back(defaultMaterial());
+    return true;
+}
+
+// Reads the diffuse color and opacity of each material of an MTL file.  Materials with an
+//  alpha texture are alpha masked and those with an opacity below 1 are transparent.
+void loadMaterialLibrary(const std::string& path, std::map<std::string, std::pair<MaterialLayout, AAPLMeshBlendMode>>& library)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file)
+    {
+        fprintf(stderr, "Could not open '%s', using default materials\n", path.c_str());
+        return;
+    }
+
+    std::pair<MaterialLayout, AAPLMeshBlendMode>* current = nullptr;
+    char line[1024];
+    while (fgets(line, sizeof(line), file))
+    {
+        char name[512];
+        float r, g, b, a;
+
+        if (sscanf(line, " newmtl %511s", name) == 1)
+        {
+            current = &library[name];
+            *current = { defaultMaterial(), AAPLMeshBlendMode::Opaque };
+        }
+        else if (!current)
+        {
+            continue;
+        }
+        else if (sscanf(line, " Kd %f %f %f", &r, &g, &b) == 3)
+        {
+            current->first.baseColor[0] = r;
+            current->first.baseColor[1] = g;
+            current->first.baseColor[2] = b;
+        }
+        else if (sscanf(line, " Ke %f %f %f", &r, &g, &b) == 3)
+        {
+            current->first.emissiveColor[0] = r;
+            current->first.emissiveColor[1] = g;
+            current->first.emissiveColor[2] = b;
+        }
+        else if (sscanf(line, " d %f", &a) == 1 || sscanf(line, " Tr %f", &a) == 1)
+        {
+            // Tr is transparency rather than opacity.
+            current->first.opacity = strstr(line, "Tr") ? 1.0f - a : a;
+            if (current->first.opacity < 1.0f && current->second == AAPLMeshBlendMode::Opaque)
+                current->second = AAPLMeshBlendMode::Transparent;
+        }
+        else if (sscanf(line, " map_d %511s", name) == 1)
+        {
+            current->first.hasDiffuseMask = true;
+            current->second = AAPLMeshBlendMode::AlphaMasked;
+        }
+    }
+
+    fclose(file);
+}
+
+// Resolves a 1 based OBJ index, or a negative one relative to the end, to a 0 based index.
+bool resolveIndex(long index, size_t count, uint32_t& out)
+{
+    const long resolved = index < 0 ? (long)count + index : index - 1;
+    if (resolved < 0 || (size_t)resolved >= count)
+        return false;
+    out = (uint32_t)resolved;
+    return true;
+}
+
+// Reads the positions, normals, texture coordinates, and faces of an OBJ file, with one
+//  submesh per material.  Polygons are split into triangle fans.
+bool loadOBJ(const char* path, Mesh& mesh)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+    {
+        fprintf(stderr, "Could not open '%s'\n", path);
+        return false;
+    }
+
+    std::string directory = path;
+    directory = directory.substr(0, directory.find_last_of('/') + 1);
+
+    std::vector<float> positions, normals, uvs;
+    std::map<std::string, std::pair<MaterialLayout, AAPLMeshBlendMode>> library;
+    std::map<std::string, uint32_t> submeshForMaterial;
+    uint32_t submesh = UINT32_MAX;
+
+    // Each distinct position, texture coordinate and normal triple becomes a vertex.
+    struct Key
+    {
+        uint32_t p, t, n;
+        bool operator==(const Key& o) const { return p == o.p && t == o.t && n == o.n; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& k) const { return (k.p * 0x9E3779B1u) ^ (k.t * 0x85EBCA77u) ^ (k.n * 0xC2B2AE3Du); }
+    };
+    std::unordered_map<Key, uint32_t, KeyHash> vertices;
+
+    const auto useMaterial = [&](const std::string& name)
+    {
+        auto found = submeshForMaterial.find(name);
+        if (found == submeshForMaterial.end())
+        {
+            const auto material = library.find(name);
+            found = submeshForMaterial.emplace(name, (uint32_t)mesh.submeshIndices.size()).first;
+            mesh.submeshIndices.emplace_back();
+            mesh.materials.push_back(material != library.end() ? material->second.first : defaultMaterial());
+            mesh.blendModes.push_back(material != library.end() ? material->second.second : AAPLMeshBlendMode::Opaque);
+        }
+        submesh = found->second;
+    };
+
+    std::vector<uint32_t> polygon;
+    size_t lineNumber = 0;
+    char buffer[4096];
+    bool valid = true;
+
+    while (valid && fgets(buffer, sizeof(buffer), file))
+    {
+        ++lineNumber;
+
+        const char* p = buffer;
+        while (*p == ' ' || *p == '\t')
+            ++p;
+
+        float x, y, z;
+        char name[512];
+
+        if (!strncmp(p, "v ", 2) && sscanf(p + 2, "%f %f %f", &x, &y, &z) == 3)
+        {
+            positions.insert(positions.end(), { x, y, z });
+        }
+        else if (!strncmp(p, "vn ", 3) && sscanf(p + 3, "%f %f %f", &x, &y, &z) == 3)
+        {
+            normals.insert(normals.end(), { x, y, z });
+        }
+        else if (!strncmp(p, "vt ", 3) && sscanf(p + 3, "%f %f", &x, &y) == 2)
+        {
+            // OBJ texture coordinates start at the bottom of the image, Metal's at the top.
+            uvs.insert(uvs.end(), { x, 1.0f - y });
+        }
+        else if (sscanf(p, "mtllib %511s", name) == 1)
+        {
+            loadMaterialLibrary(directory + name, library);
+        }
+        else if (sscanf(p, "usemtl %511s", name) == 1)
+        {
+            useMaterial(name);
+        }
+        else if (!strncmp(p, "f ", 2))
+        {
+            if (submesh == UINT32_MAX)
+                useMaterial("");
+
+            polygon.clear();
+            for (const char* c = p + 2; valid && *c; )
+            {
+                while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')
+                    ++c;
+                if (!*c)
+                    break;
+
+                long indices[3] = { 0, 0, 0 };
+                char* end;
+                for (int k = 0; k < 3; ++k)
+                {
+                    indices[k] = strtol(c, &end, 10);
+                    c = end;
+                    if (*c != '/')
+                        break;
+                    ++c;
+                }
+
+                Key key = { 0, UINT32_MAX, UINT32_MAX };
+                valid = resolveIndex(indices[0], positions.size() / 3, key.p)
+                     && (!indices[1] || resolveIndex(indices[1], uvs.size() / 2, key.t))
+                     && (!indices[2] || resolveIndex(indices[2], normals.size() / 3, key.n));
+
+                if (valid)
+                {
+                    const auto inserted = vertices.emplace(key, (uint32_t)vertices.size());
+                    if (inserted.second)
+                    {
+                        mesh.positions.insert(mesh.positions.end(), &positions[key.p * 3], &positions[key.p * 3] + 3);
+                        if (key.n != UINT32_MAX)
+                            mesh.normals.insert(mesh.normals.end(), &normals[key.n * 3], &normals[key.n * 3] + 3);
+                        else
+                            mesh.normals.insert(mesh.normals.end(), { 0.0f, 0.0f, 0.0f });
+                        if (key.t != UINT32_MAX)
+                            mesh.uvs.insert(mesh.uvs.end(), &uvs[key.t * 2], &uvs[key.t * 2] + 2);
+                        else
+                            mesh.uvs.insert(mesh.uvs.end(), { 0.0f, 0.0f });
+                    }
+                    polygon.push_back(inserted.first->second);
+                }
+            }
+
+            std::vector<uint32_t>& indices = mesh.submeshIndices[submesh];
+            for (size_t i = 2; valid && i < polygon.size(); ++i)
+                indices.insert(indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+        }
+    }
+
+    fclose(file);
+
+    if (!valid)
+    {
+        fprintf(stderr, "%s:%zu: Face refers to a missing vertex\n", path, lineNumber);
+        return false;
+    }
+
+    if (normals.empty())
+        mesh.normals.clear();
+    if (uvs.empty())
+        mesh.uvs.clear();
+
+    return true;
+}
+
+// A sphere of `rows` x 2 * `rows` quads with bumps, so that chunks have varied normal cones.
+void createSyntheticMesh(size_t triangleCount, Mesh& mesh)
+{
+    const uint32_t rows    = std::max<uint32_t>(2, (uint32_t)sqrt(triangleCount / 4.0));
+    const uint32_t columns = rows * 2;
+
+    for (uint32_t r = 0; r <= rows; ++r)
+    {
+        for (uint32_t c = 0; c <= columns; ++c)
+        {
+            const float theta = (float)M_PI * r / rows;
+            const float phi   = 2.0f * (float)M_PI * c / columns;
+            const float n[3]  = { sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) };
+            const float bump  = 10.0f + 0.5f * sinf(phi * 24.0f) * sinf(theta * 12.0f);
+
+            mesh.positions.insert(mesh.positions.end(), { n[0] * bump, n[1] * bump, n[2] * bump });
+            mesh.normals.insert(mesh.normals.end(), { n[0], n[1], n[2] });
+            mesh.uvs.insert(mesh.uvs.end(), { (float)c / columns, (float)r / rows });
+        }
+    }
+
+    mesh.submeshIndices.resize(1);
+    for (uint32_t r = 0; r < rows; ++r)
+    {
+        for (uint32_t c = 0; c < columns; ++c)
+        {
+            const uint32_t v = r * (columns + 1) + c;
+            mesh.submeshIndices[0].insert(mesh.submeshIndices[0].end(),
+                                          { v, v + columns + 1, v + 1, v + 1, v + columns + 1, v + columns + 2 });
+        }
+    }
+
+    mesh.blendModes.push_back(AAPLMeshBlendMode::Opaque);
+    mesh.materials.push_back(defaultMaterial());
+}
+
+// A triangle by its positions, rotated to start with its smallest vertex, to compare the
+//  input and output triangles independently of vertex numbering.
+struct Triangle
+{
+    float p[9];
+
+    bool operator<(const Triangle& o) const  { return memcmp(p, o.p, sizeof(p)) < 0; }
+    bool operator==(const Triangle& o) const { return memcmp(p, o.p, sizeof(p)) == 0; }
+};
+
+Triangle makeTriangle(const float* positions, const uint32_t* tri)
+{
+    int first = 0;
+    for (int k = 1; k < 3; ++k)
+    {
+        if (memcmp(&positions[(size_t)tri[k] * 3], &positions[(size_t)tri[first] * 3], 3 * sizeof(float)) < 0)
+            first = k;
+    }
+
+    Triangle t;
+    for (int k = 0; k < 3; ++k)
+        memcpy(&t.p[k * 3], &positions[(size_t)tri[(first + k) % 3] * 3], 3 * sizeof(float));
+    return t;
+}
+
+// Checks that the chunks hold every non degenerate input triangle once, that they respect
+//  the limits, and that their bounds and normal cones hold their triangles.  Returns the
+//  number of failures.
+int checkChunks(const Mesh& mesh, const AAPLMeshFileContents& contents, const AAPLMeshChunkBuilderConfig& config)
+{
+    int failures = 0;
+    const auto fail = [&failures](const char* message, size_t chunk)
+    {
+        if (failures++ < 10)
+            printf("  Chunk %zu: %s\n", chunk, message);
+    };
+
+    const float* positions        = (const float*)contents.vertexData.data();
+    const uint32_t* indices       = (const uint32_t*)contents.indexData.data();
+    const AAPLMeshFileChunk* chunks = (const AAPLMeshFileChunk*)contents.chunkData.data();
+
+    std::vector<Triangle> input;
+    for (const std::vector<uint32_t>& submesh : mesh.submeshIndices)
+    {
+        for (size_t t = 0; t + 2 < submesh.size(); t += 3)
+        {
+            const uint32_t* tri = &submesh[t];
+            if (tri[0] != tri[1] && tri[1] != tri[2] && tri[0] != tri[2])
+                input.push_back(makeTriangle(mesh.positions.data(), tri));
+        }
+    }
+
+    std::vector<Triangle> output;
+    std::vector<uint32_t> chunkVertices;
+
+    for (size_t c = 0; c < contents.chunkCount; ++c)
+    {
+        const AAPLMeshFileChunk& chunk = chunks[c];
+        if ((uint64_t)chunk.indexBegin + chunk.indexCount > contents.indexCount || chunk.indexCount % 3 != 0)
+        {
+            fail("index range outside the index buffer", c);
+            continue;
+        }
+
+        chunkVertices.assign(indices + chunk.indexBegin, indices + chunk.indexBegin + chunk.indexCount);
+        std::sort(chunkVertices.begin(), chunkVertices.end());
+        chunkVertices.erase(std::unique(chunkVertices.begin(), chunkVertices.end()), chunkVertices.end());
+
+        if (chunk.indexCount / 3 > config.maxTriangles || chunkVertices.size() > config.maxVertices)
+            fail("too many triangles or vertices", c);
+
+        const float* sphere = chunk.boundingSphere;
+        const float  extent = std::max(fabsf(sphere[0]), std::max(fabsf(sphere[1]), fabsf(sphere[2]))) + sphere[3];
+        const float  epsilon = extent * 1e-5f + 1e-6f;
+
+        for (uint32_t v : chunkVertices)
+        {
+            if (v >= contents.vertexCount)
+            {
+                fail("index outside the vertex buffer", c);
+                break;
+            }
+
+            const float* p = &positions[(size_t)v * 3];
+            const float d[3] = { p[0] - sphere[0], p[1] - sphere[1], p[2] - sphere[2] };
+            if (sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) > sphere[3] + epsilon)
+                fail("vertex outside the bounding sphere", c);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                if (p[k] < chunk.boxMin[k] - epsilon || p[k] > chunk.boxMax[k] + epsilon)
+                    fail("vertex outside the bounding box", c);
+            }
+        }
+
+        for (uint32_t i = chunk.indexBegin; i < chunk.indexBegin + chunk.indexCount; i += 3)
+        {
+            const uint32_t* tri = indices + i;
+            if (std::max(tri[0], std::max(tri[1], tri[2])) >= contents.vertexCount)
+                continue;
+
+            output.push_back(makeTriangle(positions, tri));
+
+            // Face normal, which must lie inside the cone.
+            const float* a = &positions[(size_t)tri[0] * 3];
+            const float* b = &positions[(size_t)tri[1] * 3];
+            const float* e = &positions[(size_t)tri[2] * 3];
+            const float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const float w[3] = { e[0] - a[0], e[1] - a[1], e[2] - a[2] };
+            float n[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+            const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length <= FLT_MIN)
+                continue;
+
+            const float* cone = chunk.normalDistribution;
+            const float cosine = (n[0] * cone[0] + n[1] * cone[1] + n[2] * cone[2]) / length;
+            if (cosine < cone[3] - 1e-3f)
+                fail("face normal outside the normal cone", c);
+        }
+    }
+
+    std::sort(input.begin(), input.end());
+    std::sort(output.begin(), output.end());
+    if (input != output)
+    {
+        printf("  The chunks hold %zu triangles, not the %zu of the input, or different ones\n", output.size(), input.size());
+        failures++;
+    }
+
+    return failures;
+}
+
+// Reads the file back and compares its counts and streams with `contents`.  Returns the
+//  number of failures.
+int checkFile(const char* path, const AAPLMeshFileContents& contents)
+{
+    AAPLMeshFile file;
+    if (!file.open(path))
+    {
+        printf("  %s\n", file.error().c_str());
+        return 1;
+    }
+
+    int failures = 0;
+
+    const uint64_t counts[][2] =
+    {
+        { file.vertexCount(),           contents.vertexCount },
+        { file.indexCount(),            contents.indexCount },
+        { file.chunkCount(),            contents.chunkCount },
+        { file.meshCount(),             contents.meshCount },
+        { file.materialCount(),         contents.materialCount },
+        { file.opaqueChunkCount(),      contents.opaqueChunkCount },
+        { file.opaqueMeshCount(),       contents.opaqueMeshCount },
+        { file.alphaMaskedChunkCount(), contents.alphaMaskedChunkCount },
+        { file.alphaMaskedMeshCount(),  contents.alphaMaskedMeshCount },
+        { file.transparentChunkCount(), contents.transparentChunkCount },
+        { file.transparentMeshCount(),  contents.transparentMeshCount },
+    };
+    for (const auto& count : counts)
+        failures += count[0] != count[1];
+
+    const std::pair<AAPLMeshFileBlock, const std::vector<uint8_t>*> streams[] =
+    {
+        { file.vertexBlock(),   &contents.vertexData },
+        { file.normalBlock(),   &contents.normalData },
+        { file.tangentBlock(),  &contents.tangentData },
+        { file.uvBlock(),       &contents.uvData },
+        { file.indexBlock(),    &contents.indexData },
+        { file.chunkBlock(),    &contents.chunkData },
+        { file.meshBlock(),     &contents.meshData },
+        { file.materialBlock(), &contents.materialData },
+    };
+    for (const auto& stream : streams)
+    {
+        std::vector<uint8_t> data(stream.first.uncompressedSize());
+        if (!AAPLMeshFile::decompress(stream.first, data.data(), data.size()) || data != *stream.second)
+            failures++;
+    }
+
+    if (failures)
+        printf("  %d counts or streams read back from '%s' differ from those written\n", failures, path);
+    return failures;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    const char* outputPath = nullptr;
+    const char* objPath = nullptr;
+    const char* positionsPath = nullptr;
+    const char* indicesPath = nullptr;
+    const char* normalsPath = nullptr;
+    const char* uvsPath = nullptr;
+    size_t syntheticTriangles = 0;
+    uint32_t codec = AAPLCompressionModeZLIB;
+    uint32_t blockSize = 65536;
+    AAPLMeshChunkBuilderConfig config;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--positions") && i + 1 < argc)
+        {
+            positionsPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--indices") && i + 1 < argc)
+        {
+            indicesPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--normals") && i + 1 < argc)
+        {
+            normalsPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--uvs") && i + 1 < argc)
+        {
+            uvsPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--synthetic") && i + 1 < argc)
+        {
+            syntheticTriangles = (size_t)atol(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--max-vertices") && i + 1 < argc)
+        {
+            config.maxVertices = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--max-triangles") && i + 1 < argc)
+        {
+            config.maxTriangles = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--cone-weight") && i + 1 < argc)
+        {
+            config.coneWeight = (float)atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--cache-size") && i + 1 < argc)
+        {
+            config.cacheSize = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            config.threadCount = (unsigned)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--codec") && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            codec = UINT32_MAX;
+            for (uint32_t mode : { AAPLCompressionModeNone, AAPLCompressionModeLZ4, AAPLCompressionModeZLIB,
+                                   AAPLCompressionModeLZMA, AAPLCompressionModeLZFSE, AAPLCompressionModeZSTD })
+            {
+                if (!strcmp(name, AAPLCompressionModeName(mode)))
+                    codec = mode;
+            }
+        }
+        else if (!strcmp(argv[i], "--block-size") && i + 1 < argc)
+        {
+            blockSize = (uint32_t)atoi(argv[++i]);
+        }
+        else if (argv[i][0] != '-' && !objPath)
+        {
+            objPath = argv[i];
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    const int inputCount = (objPath != nullptr) + (positionsPath || indicesPath) + (syntheticTriangles != 0);
+    if (inputCount != 1 || (positionsPath && !indicesPath) || (!positionsPath && indicesPath) || codec == UINT32_MAX
+        || blockSize == 0 || config.maxVertices < 3 || config.maxTriangles == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (codec != AAPLCompressionModeNone)
+    {
+        const AAPLCompressionCodec* encoder = AAPLCompressionCodecForMode(codec);
+        if (!encoder || !encoder->canEncode())
+        {
+            fprintf(stderr, "Can't encode %s on this platform\n", AAPLCompressionModeName(codec));
+            return 1;
+        }
+    }
+
+    Mesh mesh;
+    if (objPath)
+    {
+        if (!loadOBJ(objPath, mesh))
+            return 1;
+    }
+    else if (positionsPath)
+    {
+        if (!loadRaw(positionsPath, indicesPath, normalsPath, uvsPath, mesh))
+            return 1;
+    }
+    else
+    {
+        createSyntheticMesh(syntheticTriangles, mesh);
+    }
+
+    AAPLMeshBuilderInput input;
+    input.positions     = mesh.positions.data();
+    input.normals       = mesh.normals.empty() ? nullptr : mesh.normals.data();
+    input.uvs           = mesh.uvs.empty() ? nullptr : mesh.uvs.data();
+    input.vertexCount   = mesh.vertexCount();
+    input.materialData  = mesh.materials.data();
+    input.materialCount = mesh.materials.size();
+    input.materialSize  = sizeof(MaterialLayout);
+
+    size_t inputTriangles = 0;
+    for (size_t i = 0; i < mesh.submeshIndices.size(); ++i)
+    {
+        AAPLMeshBuilderSubmesh submesh;
+        submesh.materialIndex   = (uint32_t)i;
+        submesh.blendMode       = mesh.blendModes[i];
+        submesh.indices         = mesh.submeshIndices[i].data();
+        submesh.indexCount      = mesh.submeshIndices[i].size();
+        input.submeshes.push_back(submesh);
+
+        inputTriangles += submesh.indexCount / 3;
+    }
+
+    printf("%zu vertices, %zu triangles, %zu materials\n", input.vertexCount, inputTriangles, input.materialCount);
+
+    AAPLMeshFileContents contents;
+    AAPLMeshChunkBuilderStats stats;
+
+    const auto begin = std::chrono::steady_clock::now();
+    if (!AAPLBuildMeshChunks(input, config, contents, &stats))
+    {
+        fprintf(stderr, "The input mesh is malformed\n");
+        return 1;
+    }
+    const double buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    printf("Built %zu chunks in %.2f s\n\n", stats.chunkCount, buildTime);
+    printf("  vertices per chunk         %8.1f\n", stats.averageVertices);
+    printf("  triangles per chunk        %8.1f\n", stats.averageTriangles);
+    printf("  cone angle (mean, max)     %8.1f %8.1f degrees\n", stats.averageConeAngle, stats.maxConeAngle);
+    printf("  back face cullable         %8.1f %%\n", stats.backfaceCullableRatio * 100.0);
+    printf("  sphere tightness           %8.3f\n", stats.averageSphereTightness);
+    printf("  ACMR (input, chunks)       %8.3f %8.3f\n", stats.inputACMR, stats.outputACMR);
+    printf("  opaque, alpha masked, transparent chunks  %llu %llu %llu\n\n",
+           (unsigned long long)contents.opaqueChunkCount, (unsigned long long)contents.alphaMaskedChunkCount,
+           (unsigned long long)contents.transparentChunkCount);
+
+    int failures = checkChunks(mesh, contents, config);
+
+    if (outputPath)
+    {
+        std::string error;
+        if (!AAPLWriteMeshFile(outputPath, contents, codec, blockSize, error))
+        {
+            fprintf(stderr, "%s: %s\n", outputPath, error.c_str());
+            return 1;
+        }
+
+        failures += checkFile(outputPath, contents);
+
+        FILE* file = fopen(outputPath, "rb");
+        if (file)
+        {
+            fseek(file, 0, SEEK_END);
+            printf("Wrote '%s', %.1f KB with %s\n", outputPath, ftell(file) / 1024.0, AAPLCompressionModeName(codec));
+            fclose(file);
+        }
+    }
+
+    printf("\n%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
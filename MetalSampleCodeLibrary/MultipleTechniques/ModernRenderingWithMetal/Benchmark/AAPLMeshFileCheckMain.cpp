@@ -0,0 +1,649 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that checks the memory-mapped mesh file reader against the files its
+ writer produces and, built as Objective-C++ on macOS, against the keyed archive reader the
+ sample used before.  It also measures loading a mesh file in place against copying it.
+*/
+#include "../Asset/AAPLMeshFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if defined(__OBJC__)
+#import <Foundation/Foundation.h>
+#endif
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --mesh PATH          Mesh file to check and measure, instead of synthetic files\n"
+            "  --dump               Print the size and hash of each stream and texture of --mesh\n",
+            program);
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// FNV-1a, so that dumps from different machines can be compared.
+uint64_t hashBytes(const void* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ ((const uint8_t*)data)[i]) * 1099511628211ull;
+    return hash;
+}
+
+// The keys of the root archive object, in the order AAPLMeshData declared them.
+const char* IntegerKeys[] =
+{
+    "vertexCount", "indexCount", "indexType", "chunkCount", "meshCount", "materialCount",
+    "opaqueChunkCount", "opaqueMeshCount", "alphaMaskedChunkCount", "alphaMaskedMeshCount",
+    "transparentChunkCount", "transparentMeshCount",
+};
+
+const char* StreamKeys[] =
+{
+    "vertexData", "normalData", "tangentData", "uvData", "indexData", "chunkData", "meshData", "materialData",
+};
+
+int failures = 0;
+
+void check(bool condition, const char* what, const std::string& context)
+{
+    if (!condition)
+    {
+        printf("  FAILED: %s (%s)\n", what, context.c_str());
+        failures++;
+    }
+}
+
+// MARK: - Synthetic files
+
+uint32_t nextRandom(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Bytes that compress somewhat, like vertex streams: slowly varying values with some noise.
+std::vector<uint8_t> makeStream(size_t size, uint32_t& state)
+{
+    std::vector<uint8_t> stream(size);
+    for (size_t i = 0; i < size; ++i)
+        stream[i] = (uint8_t)((i / 64) + (nextRandom(state) % 4));
+    return stream;
+}
+
+AAPLMeshFileContents makeContents(uint32_t seed)
+{
+    uint32_t state = seed * 2654435761u + 1;
+
+    AAPLMeshFileContents contents;
+    contents.vertexCount            = 10000 + nextRandom(state) % 1000;
+    contents.indexCount             = 3 * (20000 + nextRandom(state) % 1000);
+    contents.chunkCount             = 1 + contents.indexCount / 384;
+    contents.meshCount              = 3;
+    contents.materialCount          = 2;
+    contents.opaqueChunkCount       = contents.chunkCount - 2;
+    contents.opaqueMeshCount        = 1;
+    contents.alphaMaskedChunkCount  = 1;
+    contents.alphaMaskedMeshCount   = 1;
+    contents.transparentChunkCount  = 1;
+    contents.transparentMeshCount   = 1;
+
+    contents.vertexData     = makeStream(contents.vertexCount * 12, state);
+    contents.normalData     = makeStream(contents.vertexCount * 12, state);
+    contents.tangentData    = makeStream(contents.vertexCount * 12, state);
+    contents.uvData         = makeStream(contents.vertexCount * 8, state);
+    contents.indexData      = makeStream(contents.indexCount * 4, state);
+    contents.chunkData      = makeStream(contents.chunkCount * sizeof(AAPLMeshFileChunk), state);
+    contents.meshData       = makeStream(contents.meshCount * sizeof(AAPLMeshFileSubMesh), state);
+    contents.materialData   = makeStream(contents.materialCount * 16, state);
+
+    for (uint32_t t = 0; t < 3; ++t)
+    {
+        AAPLMeshFileTexture texture;
+        texture.path                = "Textures/texture" + std::to_string(t) + ".ktx";
+        texture.width               = 64u << t;
+        texture.height              = 32u << t;
+        texture.mipmapLevelCount    = 6 + t;
+        texture.pixelFormat         = 130 + t;
+        texture.pixelDataOffset     = contents.textureData.size();
+
+        for (uint64_t mip = 0; mip < texture.mipmapLevelCount; ++mip)
+        {
+            const uint64_t length = std::max<uint64_t>((texture.width >> mip) * (texture.height >> mip), 16);
+            texture.mipOffsets.push_back(contents.textureData.size() - texture.pixelDataOffset);
+            texture.mipLengths.push_back(length);
+            const std::vector<uint8_t> mipData = makeStream(length, state);
+            contents.textureData.insert(contents.textureData.end(), mipData.begin(), mipData.end());
+        }
+
+        texture.pixelDataLength = contents.textureData.size() - texture.pixelDataOffset;
+        contents.textures.push_back(texture);
+    }
+
+    return contents;
+}
+
+std::string temporaryPath()
+{
+    char path[] = "/tmp/AAPLMeshFileCheckXXXXXX";
+    const int fd = mkstemp(path);
+    if (fd >= 0)
+        close(fd);
+    return path;
+}
+
+bool writeBytes(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    const bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return (fclose(file) == 0) && written;
+}
+
+std::vector<uint8_t> readBytes(const std::string& path)
+{
+    std::vector<uint8_t> bytes;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return bytes;
+    uint8_t buffer[65536];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        bytes.insert(bytes.end(), buffer, buffer + size);
+    fclose(file);
+    return bytes;
+}
+
+// Writes `contents` with `codec`, reads it back, and compares every value.
+void checkRoundTrip(const AAPLMeshFileContents& contents, uint32_t codec, const char* codecName)
+{
+    const std::string context = std::string("codec ") + codecName;
+    const std::string path = temporaryPath();
+
+    std::string error;
+    check(AAPLWriteMeshFile(path.c_str(), contents, codec, 16384, error), "write", context + ": " + error);
+
+    AAPLMeshFile file;
+    const bool opened = file.open(path.c_str());
+    check(opened, "open", context + ": " + file.error());
+    unlink(path.c_str());
+    if (!opened)
+        return;
+
+    const uint64_t expectedIntegers[] =
+    {
+        contents.vertexCount, contents.indexCount, contents.indexType, contents.chunkCount,
+        contents.meshCount, contents.materialCount, contents.opaqueChunkCount, contents.opaqueMeshCount,
+        contents.alphaMaskedChunkCount, contents.alphaMaskedMeshCount, contents.transparentChunkCount,
+        contents.transparentMeshCount,
+    };
+    for (size_t i = 0; i < sizeof(IntegerKeys) / sizeof(IntegerKeys[0]); ++i)
+        check(file.integer(IntegerKeys[i]) == expectedIntegers[i], "integer", context + ": " + IntegerKeys[i]);
+
+    const std::vector<uint8_t>* expectedStreams[] =
+    {
+        &contents.vertexData, &contents.normalData, &contents.tangentData, &contents.uvData,
+        &contents.indexData, &contents.chunkData, &contents.meshData, &contents.materialData,
+    };
+    for (size_t i = 0; i < sizeof(StreamKeys) / sizeof(StreamKeys[0]); ++i)
+    {
+        const AAPLMeshFileBlock block = file.block(StreamKeys[i]);
+        const std::vector<uint8_t>& expected = *expectedStreams[i];
+
+        check(block.valid() && block.uncompressedSize() == expected.size(), "stream size", context + ": " + StreamKeys[i]);
+
+        std::vector<uint8_t> stream(block.uncompressedSize());
+        check(AAPLMeshFile::decompress(block, stream.data(), stream.size()) && stream == expected,
+              "stream contents", context + ": " + StreamKeys[i]);
+
+        // A destination that is too small must be refused rather than overrun.
+        if (!stream.empty())
+            check(!AAPLMeshFile::decompress(block, stream.data(), stream.size() - 1), "short destination", context + ": " + StreamKeys[i]);
+    }
+
+    std::vector<uint8_t> storage;
+    const AAPLSpan<AAPLMeshFileChunk> chunks = file.typedBlock<AAPLMeshFileChunk>(file.chunkBlock(), storage);
+    check(chunks.size() == contents.chunkCount && memcmp(chunks.data, contents.chunkData.data(), contents.chunkData.size()) == 0,
+          "typed chunks", context);
+
+    // Uncompressed blocks and texture data are referenced in the mapping, not copied.
+    const AAPLSpan<uint8_t> textureData = file.textureData();
+    check(textureData.size() == contents.textureData.size() &&
+          memcmp(textureData.data, contents.textureData.data(), textureData.size()) == 0, "texture data", context);
+    if (codec == AAPLCompressionModeNone)
+    {
+        storage.clear();
+        file.typedBlock<AAPLMeshFileChunk>(file.chunkBlock(), storage);
+        check(storage.empty(), "uncompressed blocks in place", context);
+    }
+
+    check(file.textures().size() == contents.textures.size(), "texture count", context);
+    for (size_t t = 0; t < std::min(file.textures().size(), contents.textures.size()); ++t)
+    {
+        const AAPLMeshFileTexture& read = file.textures()[t];
+        const AAPLMeshFileTexture& expected = contents.textures[t];
+        check(read.path == expected.path && read.width == expected.width && read.height == expected.height &&
+              read.mipmapLevelCount == expected.mipmapLevelCount && read.pixelFormat == expected.pixelFormat &&
+              read.pixelDataOffset == expected.pixelDataOffset && read.pixelDataLength == expected.pixelDataLength &&
+              read.mipOffsets == expected.mipOffsets && read.mipLengths == expected.mipLengths,
+              "texture", context + ": " + expected.path);
+    }
+}
+
+// Damaged files must fail to open, or open with invalid blocks, but never crash.
+void checkDamagedFiles(const AAPLMeshFileContents& contents)
+{
+    const std::string path = temporaryPath();
+    std::string error;
+    if (!AAPLWriteMeshFile(path.c_str(), contents, AAPLCompressionModeNone, 16384, error))
+    {
+        check(false, "write", error);
+        return;
+    }
+    const std::vector<uint8_t> original = readBytes(path);
+
+    const auto openDamaged = [&](const std::vector<uint8_t>& bytes)
+    {
+        writeBytes(path, bytes);
+        AAPLMeshFile file;
+        if (!file.open(path.c_str()))
+            return false;
+
+        // Touch every stream to give the sanitizers a chance to catch reads out of bounds.
+        for (const char* key : StreamKeys)
+        {
+            const AAPLMeshFileBlock block = file.block(key);
+            std::vector<uint8_t> stream(block.valid() ? block.uncompressedSize() : 0);
+            if (block.valid() && stream.size() < (1u << 30))
+                AAPLMeshFile::decompress(block, stream.data(), stream.size());
+        }
+        return true;
+    };
+
+    std::vector<uint8_t> bytes = original;
+    bytes[0] ^= 0xFF;
+    check(!openDamaged(bytes), "bad magic refused", "damaged");
+
+    bytes = original;
+    bytes[4] ^= 0xFF;
+    check(!openDamaged(bytes), "bad version refused", "damaged");
+
+    for (size_t size : { (size_t)0, sizeof(AAPLFileHeader), original.size() / 2, original.size() - 1 })
+    {
+        bytes.assign(original.begin(), original.begin() + size);
+        check(!openDamaged(bytes), "truncated file refused", "damaged at " + std::to_string(size) + " bytes");
+    }
+
+    // Flip bytes through the archive and the streams.
+    uint32_t state = 12345;
+    for (int i = 0; i < 200; ++i)
+    {
+        bytes = original;
+        bytes[sizeof(AAPLFileHeader) + nextRandom(state) % (bytes.size() - sizeof(AAPLFileHeader))] ^= (uint8_t)(1 + nextRandom(state) % 255);
+        openDamaged(bytes);
+    }
+
+    unlink(path.c_str());
+}
+
+int checkSynthetic()
+{
+    const AAPLMeshFileContents contents = makeContents(1);
+
+    const struct { uint32_t mode; const char* name; } codecs[] =
+    {
+        { AAPLCompressionModeNone,      "none" },
+        { AAPLCompressionModeLZ4Raw,    "lz4-raw" },
+        { AAPLCompressionModeZLIB,      "zlib" },
+        { AAPLCompressionModeLZFSE,     "lzfse" },
+        { AAPLCompressionModeZSTD,      "zstd" },
+    };
+
+    for (const auto& codec : codecs)
+    {
+        const AAPLCompressionCodec* implementation = AAPLCompressionCodecForMode(codec.mode);
+        if (!implementation || !implementation->canEncode())
+        {
+            printf("Round trip with %-8s skipped, no encoder on this platform\n", codec.name);
+            continue;
+        }
+
+        const int before = failures;
+        checkRoundTrip(contents, codec.mode, codec.name);
+        printf("Round trip with %-8s %s\n", codec.name, failures == before ? "passed" : "FAILED");
+    }
+
+    const int before = failures;
+    checkDamagedFiles(contents);
+    printf("Damaged files            %s\n", failures == before ? "passed" : "FAILED");
+
+    return failures;
+}
+
+// MARK: - Real files
+
+#if defined(__OBJC__)
+
+// The keyed archive reader the sample used before AAPLMeshFile, reduced to the values it decodes.
+@interface AAPLReferenceObject : NSObject <NSSecureCoding>
+@property (nonatomic, readonly) NSDictionary *values;
+@end
+
+@implementation AAPLReferenceObject
+
++ (BOOL)supportsSecureCoding
+{
+    return YES;
+}
+
+- (instancetype)initWithCoder:(NSCoder *)coder
+{
+    self = [super init];
+    if (self)
+    {
+        NSSet *classes = [NSSet setWithArray:@[ [AAPLReferenceObject class], [NSArray class], [NSData class],
+                                                [NSNumber class], [NSString class] ]];
+        NSMutableDictionary *values = [NSMutableDictionary new];
+        for (NSString *key in @[ @"path", @"mipOffsets", @"mipLengths", @"textures", @"textureData" ])
+        {
+            id value = [coder decodeObjectOfClasses:classes forKey:key];
+            if (value)
+                values[key] = value;
+        }
+        for (const char* key : StreamKeys)
+        {
+            id value = [coder decodeObjectOfClass:[NSData class] forKey:@(key)];
+            if (value)
+                values[@(key)] = value;
+        }
+        for (NSString *key in @[ @"width", @"height", @"mipmapLevelCount", @"pixelFormat", @"pixelDataOffset", @"pixelDataLength" ])
+            values[key] = @([coder decodeInt64ForKey:key]);
+        for (const char* key : IntegerKeys)
+            values[@(key)] = @([coder decodeInt64ForKey:@(key)]);
+        _values = values;
+    }
+    return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder
+{
+}
+
+@end
+
+// Compares everything AAPLMeshFile reads with what NSKeyedUnarchiver reads from the same file.
+void checkAgainstKeyedArchive(const char* path, const AAPLMeshFile& file)
+{
+    NSData *fileData = [NSData dataWithContentsOfFile:@(path) options:NSDataReadingMappedIfSafe error:nil];
+    AAPLFileHeader header;
+    memcpy(&header, fileData.bytes, sizeof(header));
+    NSData *archive = [fileData subdataWithRange:NSMakeRange(sizeof(header), header.dataOffset)];
+
+    [NSKeyedUnarchiver setClass:[AAPLReferenceObject class] forClassName:@"Texture"];
+    [NSKeyedUnarchiver setClass:[AAPLReferenceObject class] forClassName:@"Mesh"];
+
+    NSError *error;
+    AAPLReferenceObject *mesh = [NSKeyedUnarchiver unarchivedObjectOfClass:[AAPLReferenceObject class]
+                                                                  fromData:archive
+                                                                     error:&error];
+    check(mesh != nil, "keyed archive", error.description.UTF8String ?: "");
+    if (!mesh)
+        return;
+
+    NSDictionary *values = mesh.values;
+    for (const char* key : IntegerKeys)
+        check([values[@(key)] unsignedLongLongValue] == file.integer(key), "integer matches keyed archive", key);
+
+    for (const char* key : StreamKeys)
+    {
+        NSData *data = values[@(key)];
+        const AAPLSpan<uint8_t> bytes = file.bytes(key);
+        check(data.length == bytes.size() && memcmp(data.bytes, bytes.data, bytes.size()) == 0,
+              "stream matches keyed archive", key);
+    }
+
+    NSData *textureData = values[@"textureData"];
+    check(textureData.length == file.textureData().size() &&
+          memcmp(textureData.bytes, file.textureData().data, textureData.length) == 0,
+          "texture data matches keyed archive", path);
+
+    NSArray<AAPLReferenceObject *> *textures = values[@"textures"];
+    check(textures.count == file.textures().size(), "texture count matches keyed archive", path);
+    for (NSUInteger t = 0; t < MIN(textures.count, file.textures().size()); ++t)
+    {
+        NSDictionary *texture = textures[t].values;
+        const AAPLMeshFileTexture& read = file.textures()[t];
+        bool same = [texture[@"path"] isEqualToString:@(read.path.c_str())] &&
+                    [texture[@"width"] unsignedLongLongValue] == read.width &&
+                    [texture[@"height"] unsignedLongLongValue] == read.height &&
+                    [texture[@"mipmapLevelCount"] unsignedLongLongValue] == read.mipmapLevelCount &&
+                    [texture[@"pixelFormat"] unsignedLongLongValue] == read.pixelFormat &&
+                    [texture[@"pixelDataOffset"] unsignedLongLongValue] == read.pixelDataOffset &&
+                    [texture[@"pixelDataLength"] unsignedLongLongValue] == read.pixelDataLength &&
+                    [texture[@"mipOffsets"] count] == read.mipOffsets.size();
+        for (size_t mip = 0; same && mip < read.mipOffsets.size(); ++mip)
+        {
+            same = [texture[@"mipOffsets"][mip] unsignedLongLongValue] == read.mipOffsets[mip] &&
+                   [texture[@"mipLengths"][mip] unsignedLongLongValue] == read.mipLengths[mip];
+        }
+        check(same, "texture matches keyed archive", read.path);
+    }
+}
+
+#endif // defined(__OBJC__)
+
+// Peak resident memory of a finished child process, in megabytes.
+double childPeakMegabytes(const struct rusage& usage)
+{
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+// Loads the file the way the sample does now: map it, and uncompress each stream straight
+//  into its destination.  Returns false if a stream fails to uncompress.
+bool loadInPlace(const char* path, std::vector<std::vector<uint8_t>>& destinations)
+{
+    AAPLMeshFile file;
+    if (!file.open(path))
+        return false;
+
+    std::vector<AAPLDecompressRequest> requests;
+    for (const char* key : StreamKeys)
+    {
+        const AAPLMeshFileBlock block = file.block(key);
+        if (!block.valid())
+            return false;
+        destinations.emplace_back(block.uncompressedSize());
+        requests.push_back({ block.header, block.payload.data, destinations.back().data() });
+    }
+    return AAPLDecompressBlocks(requests.data(), requests.size());
+}
+
+// Loads the file the way the keyed archive path did: copy each stream and the texture data
+//  out of the file, then uncompress the copies.
+bool loadCopying(const char* path, std::vector<std::vector<uint8_t>>& destinations)
+{
+    AAPLMeshFile file;
+    if (!file.open(path))
+        return false;
+
+    std::vector<std::vector<uint8_t>> copies;
+    std::vector<AAPLDecompressRequest> requests;
+    for (const char* key : StreamKeys)
+    {
+        const AAPLMeshFileBlock block = file.block(key);
+        if (!block.valid())
+            return false;
+        copies.emplace_back(block.payload.data, block.payload.data + block.payload.size());
+        destinations.emplace_back(block.uncompressedSize());
+        requests.push_back({ block.header, copies.back().data(), destinations.back().data() });
+    }
+    copies.emplace_back(file.textureData().begin(), file.textureData().end());
+    return AAPLDecompressBlocks(requests.data(), requests.size());
+}
+
+// Runs a load in a child process, so that each load's peak memory is measured on its own.
+void measureLoad(const char* name, const char* path, bool (*load)(const char*, std::vector<std::vector<uint8_t>>&))
+{
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        std::vector<std::vector<uint8_t>> destinations;
+        const bool loaded = load(path, destinations);
+        printf("  %-24s %10.1f ms", name, seconds(begin) * 1e3);
+        fflush(stdout);
+        _exit(loaded ? 0 : 1);
+    }
+
+    int status = 0;
+    struct rusage usage = {};
+    if (pid < 0 || wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        printf("\n  FAILED: %s load\n", name);
+        failures++;
+        return;
+    }
+    printf(" %10.1f MB peak\n", childPeakMegabytes(usage));
+}
+
+// Checks that the streams uncompress and agree with the counts.  Returns false if the file
+//  doesn't open.
+bool checkContents(const char* path, bool dump)
+{
+    AAPLMeshFile file;
+    const auto begin = std::chrono::steady_clock::now();
+    if (!file.open(path))
+    {
+        printf("FAILED: %s\n", file.error().c_str());
+        return false;
+    }
+    printf("Opened %s in %.2f ms: %llu vertices, %llu indices, %llu chunks, %zu textures\n", path,
+           seconds(begin) * 1e3, (unsigned long long)file.vertexCount(), (unsigned long long)file.indexCount(),
+           (unsigned long long)file.chunkCount(), file.textures().size());
+
+    std::vector<std::vector<uint8_t>> streams;
+    for (const char* key : StreamKeys)
+    {
+        const AAPLMeshFileBlock block = file.block(key);
+        streams.emplace_back(block.valid() ? block.uncompressedSize() : 0);
+        check(block.valid() && AAPLMeshFile::decompress(block, streams.back().data(), streams.back().size()),
+              "stream uncompresses", key);
+        if (dump)
+        {
+            printf("  %-24s %12llu bytes  %016llx\n", key, (unsigned long long)streams.back().size(),
+                   (unsigned long long)hashBytes(streams.back().data(), streams.back().size()));
+        }
+    }
+
+    check(streams[0].size() == file.vertexCount() * 12, "vertex stream size", path);
+    check(streams[4].size() == file.indexCount() * (file.indexType() == 1 ? 4 : 2), "index stream size", path);
+    check(streams[5].size() == file.chunkCount() * sizeof(AAPLMeshFileChunk), "chunk stream size", path);
+    check(streams[6].size() == file.meshCount() * sizeof(AAPLMeshFileSubMesh), "mesh stream size", path);
+
+    const AAPLMeshFileChunk* chunks = (const AAPLMeshFileChunk*)streams[5].data();
+    for (uint64_t c = 0; c < streams[5].size() / sizeof(AAPLMeshFileChunk); ++c)
+    {
+        if ((uint64_t)chunks[c].indexBegin + chunks[c].indexCount > file.indexCount() || chunks[c].materialIndex >= file.materialCount())
+        {
+            check(false, "chunk in range", "chunk " + std::to_string(c));
+            break;
+        }
+    }
+
+    const AAPLSpan<uint8_t> textureData = file.textureData();
+    for (const AAPLMeshFileTexture& texture : file.textures())
+    {
+        check(texture.pixelDataOffset + texture.pixelDataLength <= textureData.size(), "texture in range", texture.path);
+        if (dump && texture.pixelDataOffset + texture.pixelDataLength <= textureData.size())
+        {
+            printf("  %-40s %5llux%-5llu %2llu mips  %016llx\n", texture.path.c_str(),
+                   (unsigned long long)texture.width, (unsigned long long)texture.height,
+                   (unsigned long long)texture.mipmapLevelCount,
+                   (unsigned long long)hashBytes(textureData.data + texture.pixelDataOffset, texture.pixelDataLength));
+        }
+    }
+
+#if defined(__OBJC__)
+    const int before = failures;
+    @autoreleasepool
+    {
+        checkAgainstKeyedArchive(path, file);
+    }
+    printf("Comparison with the keyed archive reader %s\n", failures == before ? "passed" : "FAILED");
+#endif
+
+    return true;
+}
+
+int checkFile(const char* path, bool dump)
+{
+    // Release the checked streams first, so that they don't count toward the loads' peak memory.
+    if (!checkContents(path, dump))
+        return 1;
+
+    printf("Loading the streams:\n");
+    measureLoad("in place", path, loadInPlace);
+    measureLoad("copying", path, loadCopying);
+
+    return failures;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    const char* meshPath = nullptr;
+    bool dump = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--mesh") && i + 1 < argc)
+        {
+            meshPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--dump"))
+        {
+            dump = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    const int result = meshPath ? checkFile(meshPath, dump) : checkSynthetic();
+
+    printf("\n%s\n", result ? "FAILED" : "passed");
+    return result ? 1 : 0;
+}
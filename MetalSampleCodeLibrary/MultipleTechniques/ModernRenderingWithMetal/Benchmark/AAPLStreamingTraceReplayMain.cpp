@@ -0,0 +1,220 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that replays a recorded texture streaming trace with each combination of
+ scheduler settings, to tune the streaming budgets offline.
+*/
+#include "../Asset/AAPLTextureStreamingScheduler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options] TRACE\n"
+            "  TRACE                Trace recorded with RECORD_STREAMING_TRACE, which the sample writes\n"
+            "                       to TextureStreaming.trace in its temporary directory\n"
+            "  --synthetic N        Replay a synthetic trace of N frames instead\n"
+            "  --budget-mb LIST     Comma separated memory budgets in megabytes (default 64,128,256)\n"
+            "  --upload-mb LIST     Comma separated upload caps per frame in megabytes (default 4,16)\n"
+            "  --loads LIST         Comma separated load counts per frame (default 16)\n"
+            "  --latency LIST       Comma separated frames each decision takes to complete (default 2)\n"
+            "  --no-evict           Don't drop mips to make room, as with sparse textures\n",
+            program);
+}
+
+std::vector<uint64_t> parseList(const char* list)
+{
+    std::vector<uint64_t> values;
+    for (const char* p = list; *p; )
+    {
+        values.push_back(strtoull(p, (char**)&p, 10));
+        if (*p == ',')
+            ++p;
+        else if (*p)
+            return {};
+    }
+    return values;
+}
+
+// Records a camera sweeping over a row of textures, with the textures near its middle
+//  requiring their finest mips, as the sample's scheduler would see it.
+void writeSyntheticTrace(FILE* file, uint32_t frameCount)
+{
+    AAPLTextureStreamingScheduler scheduler({});
+    scheduler.record(file);
+
+    uint32_t state = 0x2545F491u;
+    auto random = [&state]()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    const uint32_t textureCount = 2048;
+    std::vector<uint32_t> mipCounts(textureCount);
+    for (uint32_t i = 0; i < textureCount; ++i)
+    {
+        // Square block compressed textures from 256 to 4096 texels, resident from 64 x 64.
+        mipCounts[i] = 9 + random() % 5;
+
+        std::vector<uint64_t> mipSizes(mipCounts[i]);
+        for (uint32_t mip = 0; mip < mipCounts[i]; ++mip)
+        {
+            const uint64_t size = std::max<uint64_t>(1ull << (mipCounts[i] - 1 - mip), 4);
+            mipSizes[mip] = size * size;
+        }
+
+        scheduler.addTexture(mipSizes.data(), mipCounts[i], mipCounts[i] - 7);
+    }
+
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+    {
+        const uint32_t window = textureCount / 8;
+        const uint32_t first  = (uint32_t)((textureCount - window) * (0.5f - 0.5f * cosf(frame * 0.01f)));
+
+        for (uint32_t i = 0; i < window; ++i)
+        {
+            const float distance = fabsf((float)i / window - 0.5f) * 2.0f;
+            const uint32_t texture = first + i;
+            const uint32_t mip = (uint32_t)(distance * 4.0f) + random() % 2;
+
+            scheduler.setRequiredMip(texture, std::min(mip, mipCounts[texture] - 1), (1.0f - distance) * 4096.0f);
+        }
+
+        // Complete each decision at once; the replay applies its own latency.
+        for (const AAPLTextureStreamingScheduler::Decision& decision : scheduler.schedule())
+            scheduler.complete(decision.texture, decision.mip);
+    }
+
+    scheduler.record(nullptr);
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    const char* tracePath = nullptr;
+    uint32_t syntheticFrames = 0;
+    std::vector<uint64_t> budgets = { 64, 128, 256 };
+    std::vector<uint64_t> uploads = { 4, 16 };
+    std::vector<uint64_t> loadCounts = { 16 };
+    std::vector<uint64_t> latencies = { 2 };
+    bool evict = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--synthetic") && i + 1 < argc)
+        {
+            syntheticFrames = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--budget-mb") && i + 1 < argc)
+        {
+            budgets = parseList(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--upload-mb") && i + 1 < argc)
+        {
+            uploads = parseList(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--loads") && i + 1 < argc)
+        {
+            loadCounts = parseList(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--latency") && i + 1 < argc)
+        {
+            latencies = parseList(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--no-evict"))
+        {
+            evict = false;
+        }
+        else if (argv[i][0] != '-' && !tracePath)
+        {
+            tracePath = argv[i];
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ((!tracePath == !syntheticFrames) || budgets.empty() || uploads.empty() || loadCounts.empty() || latencies.empty())
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    FILE* trace;
+    if (tracePath)
+    {
+        trace = fopen(tracePath, "r");
+        if (!trace)
+        {
+            fprintf(stderr, "Could not open '%s'\n", tracePath);
+            return 1;
+        }
+    }
+    else
+    {
+        trace = tmpfile();
+        if (!trace)
+        {
+            fprintf(stderr, "Could not create a temporary file\n");
+            return 1;
+        }
+        writeSyntheticTrace(trace, syntheticFrames);
+    }
+
+    printf("%9s %9s %6s %8s %7s %9s %9s %12s %9s %15s\n",
+           "budget MB", "upload MB", "loads", "latency", "frames", "loads", "drops", "uploaded MB", "peak MB", "missing/frame");
+
+    for (uint64_t budget : budgets)
+    {
+        for (uint64_t upload : uploads)
+        {
+            for (uint64_t loadCount : loadCounts)
+            {
+                for (uint64_t latency : latencies)
+                {
+                    AAPLTextureStreamingScheduler::Config config;
+                    config.budgetBytes          = budget << 20;
+                    config.uploadBytesPerFrame  = upload << 20;
+                    config.loadsPerFrame        = (uint32_t)loadCount;
+                    config.evict                = evict;
+
+                    rewind(trace);
+
+                    AAPLTextureStreamingReplayStats stats;
+                    if (!AAPLReplayTextureStreamingTrace(trace, config, (uint32_t)latency, stats))
+                    {
+                        fprintf(stderr, "The trace is malformed\n");
+                        fclose(trace);
+                        return 1;
+                    }
+
+                    printf("%9llu %9llu %6llu %8llu %7u %9llu %9llu %12.1f %9.1f %15.1f\n",
+                           (unsigned long long)budget, (unsigned long long)upload, (unsigned long long)loadCount,
+                           (unsigned long long)latency, stats.frames, (unsigned long long)stats.loads,
+                           (unsigned long long)stats.drops, stats.uploadedBytes / 1048576.0,
+                           stats.peakCommittedBytes / 1048576.0, stats.missingPriority / std::max(stats.frames, 1u));
+                }
+            }
+        }
+    }
+
+    fclose(trace);
+    return 0;
+}
@@ -0,0 +1,496 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that stresses the texture streaming state machine with a simulated blit
+ backend which follows the threading of AAPLTextureManager without Metal.
+*/
+#include "../Asset/AAPLTextureStreamer.h"
+#include "../Asset/AAPLTextureStreamingScheduler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --textures N         Number of textures, added while streaming runs (default 4096)\n"
+            "  --frames N           Number of frames (default 3000)\n"
+            "  --workers N          Number of streaming worker threads (default 4)\n"
+            "  --budget-mb N        Streaming budget in megabytes (default 256)\n"
+            "  --seed N             Seed of the simulated scene (default 1)\n",
+            program);
+}
+
+struct Random
+{
+    uint32_t state;
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    uint32_t below(uint32_t count) { return next() % count; }
+};
+
+std::atomic<unsigned> g_failures{0};
+
+void fail(const char* message, uint32_t texture)
+{
+    if (g_failures++ < 10)
+        fprintf(stderr, "FAILED: %s (texture %u)\n", message, texture);
+}
+
+// Stands in for the texture manager's TextureEntry.  `pendingMip` plays the part of
+//  `pendingTexture`, which the blit completion handler writes and the main thread reads.
+struct TextureEntry
+{
+    uint32_t            index       = 0;
+    uint32_t            mipCount    = 0;
+    uint32_t            permanentMip = 0;
+    uint32_t            currentMip  = 0;
+    uint32_t            pendingMip  = 0;
+
+    // Set while the backend owns the texture, to catch a texture processed twice at once.
+    std::atomic<bool>   processing  { false };
+};
+
+// Runs command buffer completion handlers on their own thread, in submission order, after
+//  a random delay.
+class SimulatedCommandQueue
+{
+public:
+    SimulatedCommandQueue() : _thread([this]() { run(); }) {}
+
+    ~SimulatedCommandQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _quit = true;
+        }
+        _wake.notify_all();
+        _thread.join();
+    }
+
+    void commit(std::function<void()> completedHandler)
+    {
+        static thread_local Random random = { 0x12345u + (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()) };
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(random.below(200));
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _buffers.push_back({ deadline, std::move(completedHandler) });
+        }
+        _wake.notify_one();
+    }
+
+private:
+    struct CommandBuffer
+    {
+        std::chrono::steady_clock::time_point   deadline;
+        std::function<void()>                   completedHandler;
+    };
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;)
+        {
+            _wake.wait(lock, [this]() { return _quit || !_buffers.empty(); });
+            if (_buffers.empty())
+                return;
+
+            CommandBuffer buffer = std::move(_buffers.front());
+            _buffers.pop_front();
+
+            lock.unlock();
+            std::this_thread::sleep_until(buffer.deadline);
+            buffer.completedHandler();
+            lock.lock();
+        }
+    }
+
+    std::mutex                  _mutex;
+    std::condition_variable     _wake;
+    std::deque<CommandBuffer>   _buffers;
+    bool                        _quit = false;
+    std::thread                 _thread;
+};
+
+// Mirrors AAPLTextureManager: workers process requests, drops complete through their own
+//  command buffer, and loads queue a pending blit which a blit thread batches into one
+//  command buffer.  Entries are reached through stable pointers indexed by streamer index.
+class SimulatedBackend : public AAPLTextureStreamer::Backend
+{
+public:
+    explicit SimulatedBackend(const std::vector<TextureEntry*>& entries)
+        : _entries(entries), _blitThread([this]() { blitThreadLoop(); }) {}
+
+    ~SimulatedBackend()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_blitMutex);
+            _quit = true;
+        }
+        _blitCondition.notify_all();
+        _blitThread.join();
+    }
+
+    void setStreamer(AAPLTextureStreamer* streamer) { _streamer = streamer; }
+
+    void process(uint32_t texture, uint32_t mip) override
+    {
+        static thread_local Random random = { 0xC0FFEEu + (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()) };
+
+        TextureEntry& te = *_entries[texture];
+
+        if (te.processing.exchange(true, std::memory_order_acquire))
+            fail("texture processed twice at once", texture);
+
+        if (mip == te.currentMip || mip >= te.mipCount)
+            fail("request for the resident mip", texture);
+
+        const bool dropMips = mip > te.currentMip;
+
+        // Loads sometimes fail to allocate, like a full heap.
+        if (!dropMips && random.below(32) == 0)
+        {
+            te.processing.store(false, std::memory_order_release);
+            _streamer->cancel(texture, te.currentMip);
+            return;
+        }
+
+        if (dropMips)
+        {
+            _queue.commit([this, &te, texture, mip]()
+            {
+                finish(te, texture, mip);
+            });
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(_blitMutex);
+            _pendingBlits.push_back({ &te, mip });
+            _blitCondition.notify_one();
+        }
+    }
+
+    // Completes a drop that the main thread starts itself, like sparse textures.
+    void commitDrop(TextureEntry& te, uint32_t mip)
+    {
+        if (te.processing.exchange(true, std::memory_order_acquire))
+            fail("texture processed twice at once", te.index);
+
+        _queue.commit([this, &te, mip]()
+        {
+            finish(te, te.index, mip);
+        });
+    }
+
+private:
+    struct PendingBlit
+    {
+        TextureEntry*   entry;
+        uint32_t        mip;
+    };
+
+    void finish(TextureEntry& te, uint32_t texture, uint32_t mip)
+    {
+        te.pendingMip = mip;
+        te.processing.store(false, std::memory_order_release);
+        _streamer->complete(texture, mip);
+    }
+
+    void blitThreadLoop()
+    {
+        for (;;)
+        {
+            std::vector<PendingBlit> pendingBlits;
+            {
+                std::unique_lock<std::mutex> lock(_blitMutex);
+                _blitCondition.wait(lock, [this]() { return _quit || !_pendingBlits.empty(); });
+                if (_quit)
+                    return;
+
+                std::swap(pendingBlits, _pendingBlits);
+            }
+
+            _queue.commit([this, pendingBlits]()
+            {
+                for (const PendingBlit& blit : pendingBlits)
+                    finish(*blit.entry, blit.entry->index, blit.mip);
+            });
+        }
+    }
+
+    const std::vector<TextureEntry*>&   _entries;
+    AAPLTextureStreamer*                _streamer = nullptr;
+
+    SimulatedCommandQueue               _queue;
+
+    std::mutex                          _blitMutex;
+    std::condition_variable             _blitCondition;
+    std::vector<PendingBlit>            _pendingBlits;
+    bool                                _quit = false;
+    std::thread                         _blitThread;
+};
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    uint32_t textureCount = 4096;
+    uint32_t frameCount = 3000;
+    unsigned workerCount = 4;
+    uint64_t budgetMB = 256;
+    uint32_t seed = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--textures") && i + 1 < argc)
+        {
+            textureCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            frameCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--workers") && i + 1 < argc)
+        {
+            workerCount = (unsigned)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--budget-mb") && i + 1 < argc)
+        {
+            budgetMB = (uint64_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = (uint32_t)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (textureCount == 0 || textureCount > AAPLTextureStreamer::MaxTextures || frameCount == 0 || seed == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Random random = { seed };
+
+    // Entries live in a hash map that grows while streaming runs, as in the texture manager,
+    //  and other threads only reach them through these pointers.
+    std::unordered_map<uint32_t, TextureEntry> textures;
+    std::vector<TextureEntry*> entries;
+    entries.reserve(AAPLTextureStreamer::MaxTextures);
+
+    AAPLTextureStreamingScheduler::Config config;
+    config.budgetBytes          = budgetMB << 20;
+    config.uploadBytesPerFrame  = 16 << 20;
+    config.loadsPerFrame        = 64;
+
+    SimulatedBackend backend(entries);
+    AAPLTextureStreamer streamer(backend, workerCount);
+    AAPLTextureStreamingScheduler scheduler(config);
+    backend.setStreamer(&streamer);
+
+    uint64_t loads = 0;
+    uint64_t drops = 0;
+    uint64_t mainThreadDrops = 0;
+    uint64_t failedAllocations = 0;
+    size_t outstanding = 0;
+    size_t maxOutstanding = 0;
+
+    const auto drain = [&]()
+    {
+        outstanding -= streamer.drainCompletions([&](uint32_t index, uint32_t mip, bool completed)
+        {
+            TextureEntry& te = *entries[index];
+
+            if (te.processing.load(std::memory_order_acquire))
+                fail("completion delivered while the backend owns the texture", index);
+
+            if (!completed)
+            {
+                scheduler.cancel(index, true);
+                ++failedAllocations;
+                return;
+            }
+
+            if (te.pendingMip != mip)
+                fail("completion for a mip other than the one processed", index);
+
+            scheduler.complete(index, mip);
+            te.currentMip = mip;
+        });
+    };
+
+    const auto addTextures = [&](uint32_t count)
+    {
+        for (uint32_t i = 0; i < count && entries.size() < textureCount; ++i)
+        {
+            uint32_t hash;
+            do
+                hash = random.next();
+            while (textures.count(hash));
+
+            // Square textures from 64 to 4096 texels with 1 byte per texel, resident from 64 x 64.
+            const uint32_t mipCount = 7 + random.below(6);
+            std::vector<uint64_t> mipSizes(mipCount);
+            for (uint32_t mip = 0; mip < mipCount; ++mip)
+                mipSizes[mip] = (1ull << (mipCount - 1 - mip)) * (1ull << (mipCount - 1 - mip));
+
+            TextureEntry& te    = textures[hash];
+            te.mipCount         = mipCount;
+            te.permanentMip     = mipCount - 7;
+            te.currentMip       = te.permanentMip;
+            te.pendingMip       = te.permanentMip;
+            te.index            = streamer.addTexture(te.permanentMip);
+
+            const uint32_t schedulerIndex = scheduler.addTexture(mipSizes.data(), mipCount, te.permanentMip);
+            if (schedulerIndex != te.index)
+                fail("streamer and scheduler disagree on the texture index", te.index);
+
+            entries.push_back(&te);
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    addTextures(std::min<uint32_t>(textureCount, 256));
+
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+    {
+        // Add textures while requests are in flight, so that the map rehashes under the workers.
+        if (frame % 8 == 0)
+            addTextures(64);
+
+        drain();
+
+        // A camera that moves through the scene: a window of textures is visible, with the
+        //  textures closest to its middle requiring the finest mips.
+        const uint32_t loaded = (uint32_t)entries.size();
+        const uint32_t window = std::max(1u, loaded / 4);
+        const uint32_t first  = (frame * 7) % loaded;
+        for (uint32_t i = 0; i < window; ++i)
+        {
+            const uint32_t index = (first + i) % loaded;
+            const TextureEntry& te = *entries[index];
+
+            const float distance = fabsf((float)i / window - 0.5f) * 2.0f;
+            const uint32_t mip = std::min(te.permanentMip, (uint32_t)(distance * te.mipCount) + random.below(2));
+            scheduler.setRequiredMip(index, mip, (1.0f - distance) * 1000.0f + random.below(100));
+        }
+
+        // Now and then, drop mips on this thread, as the texture manager does for sparse textures.
+        if (frame % 3 == 0)
+        {
+            const uint32_t index = random.below(loaded);
+            TextureEntry& te = *entries[index];
+
+            if (!scheduler.inFlight(index) && te.currentMip < te.permanentMip
+                && streamer.beginProcessing(index, te.currentMip + 1))
+            {
+                scheduler.markInFlight(index, te.currentMip + 1);
+                backend.commitDrop(te, te.currentMip + 1);
+                ++outstanding;
+                ++mainThreadDrops;
+            }
+        }
+
+        bool loadsIssued = false;
+        for (const AAPLTextureStreamingScheduler::Decision& decision : scheduler.schedule())
+        {
+            const TextureEntry& te = *entries[decision.texture];
+
+            if (decision.mip == te.currentMip)
+                fail("decision for the resident mip", decision.texture);
+
+            // The scheduler only decides for textures without a request.
+            if (!streamer.request(decision.texture, decision.mip))
+            {
+                fail("decision for a texture with a request", decision.texture);
+                scheduler.cancel(decision.texture, false);
+                continue;
+            }
+
+            loadsIssued = loadsIssued || decision.mip < te.currentMip;
+
+            if (decision.mip < te.currentMip)
+                ++loads;
+            else
+                ++drops;
+            ++outstanding;
+        }
+
+        // Loads are only issued while they fit, even though drops release memory later.
+        if (loadsIssued && scheduler.committedBytes() > config.budgetBytes)
+            fail("loads exceed the budget", 0);
+
+        maxOutstanding = std::max(maxOutstanding, outstanding);
+
+        std::this_thread::yield();
+    }
+
+    // Every request must come back.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (outstanding > 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (outstanding > 0)
+        fail("requests never completed", (uint32_t)outstanding);
+
+    uint64_t residentBytes = 0;
+    for (uint32_t i = 0; i < (uint32_t)entries.size(); ++i)
+    {
+        const TextureEntry& te = *entries[i];
+
+        if (streamer.state(i) != AAPLTextureStreamer::RequestState::NONE || scheduler.inFlight(i))
+            fail("request left in flight", i);
+        if (scheduler.residentMip(i) != te.currentMip || streamer.requestedMip(i) != te.currentMip)
+            fail("resident mip disagrees with the texture", i);
+
+        residentBytes += scheduler.chainBytes(i, te.currentMip);
+    }
+
+    if (residentBytes != scheduler.committedBytes())
+        fail("committed memory disagrees with the resident mips", 0);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%u frames, %zu textures, %u workers in %.2f s\n", frameCount, entries.size(), workerCount, seconds);
+    printf("  loads %llu, drops %llu, main thread drops %llu, failed allocations %llu, most in flight %zu\n",
+           (unsigned long long)loads, (unsigned long long)drops, (unsigned long long)mainThreadDrops,
+           (unsigned long long)failedAllocations, maxOutstanding);
+
+    printf("\n%s\n", g_failures ? "FAILED" : "passed");
+    return g_failures ? 1 : 0;
+}
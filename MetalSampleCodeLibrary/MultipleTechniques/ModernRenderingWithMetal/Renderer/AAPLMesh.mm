@@ -22,6 +22,8 @@ Implemenation of class storing data to draw a mesh including vertex buffers, sub
     NSData *    _materialData;
     // AAPLMeshChunk data for CPU access.
     NSData *    _chunkData;
+    // Shared buffer backing `_chunkData`, kept when the GPU copy is moved to private storage.
+    id<MTLBuffer> _chunkStorage;
 }
 
 - (const AAPLMeshChunk *)chunkData
@@ -75,46 +77,61 @@ Implemenation of class storing data to draw a mesh including vertex buffers, sub
 
     if (self)
     {
-        NSData *compressedVertexData    = mesh.vertexData;
-        NSData *compressedNormalData    = mesh.normalData;
-        NSData *compressedTangentData   = mesh.tangentData;
-        NSData *compressedUVData        = mesh.uvData;
-        NSData *compressedIndexData     = mesh.indexData;
-        NSData *compressedMaterialData  = mesh.materialData;
-        NSData *compressedMeshData      = mesh.meshData;
-        NSData *compressedChunkData     = mesh.chunkData;
+        // Uncompress straight from the mapped file into the buffers.
+        const AAPLMeshFile& file = *mesh.file;
+
+        const AAPLMeshFileBlock blocks[] =
+        {
+            file.vertexBlock(),
+            file.normalBlock(),
+            file.tangentBlock(),
+            file.uvBlock(),
+            file.indexBlock(),
+            file.chunkBlock(),
+            file.materialBlock(),
+            file.meshBlock(),
+        };
 
         MTLResourceOptions options = 0;
-        uncompressData(compressedVertexData,    ^(size_t size) {
-            self->_vertices = [device newBufferWithLength:size options:options];
-            self->_vertices.label   = @"Vertices";
-            return (uint8_t *)self->_vertices.contents;
-        });
-        uncompressData(compressedNormalData,    ^(size_t size) {
-            self->_normals = [device newBufferWithLength:size options:options];
-            self->_normals.label    = @"Normals";
-            return (uint8_t *)self->_normals.contents;
-        });
-        uncompressData(compressedTangentData,   ^(size_t size) {
-            self->_tangents = [device newBufferWithLength:size options:options];
-            self->_tangents.label   = @"Tangents";
-            return (uint8_t *)self->_tangents.contents;
-        });
-        uncompressData(compressedUVData,        ^(size_t size) {
-            self->_uvs = [device newBufferWithLength:size options:options];
-            self->_uvs.label        = @"UVs";
-            return (uint8_t *)self->_uvs.contents;
-        });
-        uncompressData(compressedIndexData,     ^(size_t size) {
-            self->_indices = [device newBufferWithLength:size options:options];
-            self->_indices.label    = @"Indices";
-            return (uint8_t *)self->_indices.contents;
-        });
-        uncompressData(compressedChunkData,     ^(size_t size) {
-            self->_chunks = [device newBufferWithLength:size options:options];
-            self->_chunks.label     = @"Chunks";
-            return (uint8_t *)self->_chunks.contents;
-        });
+        auto NewBuffer = [&](const AAPLMeshFileBlock& block, NSString *label)
+        {
+            id<MTLBuffer> buffer = [device newBufferWithLength:block.uncompressedSize() options:options];
+            buffer.label = label;
+            return buffer;
+        };
+        _vertices   = NewBuffer(blocks[0],  @"Vertices");
+        _normals    = NewBuffer(blocks[1],  @"Normals");
+        _tangents   = NewBuffer(blocks[2],  @"Tangents");
+        _uvs        = NewBuffer(blocks[3],  @"UVs");
+        _indices    = NewBuffer(blocks[4],  @"Indices");
+        _chunks     = NewBuffer(blocks[5],  @"Chunks");
+
+        NSMutableData *materialData = [NSMutableData dataWithLength:blocks[6].uncompressedSize()];
+        NSMutableData *meshData     = [NSMutableData dataWithLength:blocks[7].uncompressedSize()];
+
+        // Uncompress all streams in one batch so that their blocks are decoded in parallel.
+        uint8_t * const dstBuffers[] =
+        {
+            (uint8_t *)_vertices.contents,
+            (uint8_t *)_normals.contents,
+            (uint8_t *)_tangents.contents,
+            (uint8_t *)_uvs.contents,
+            (uint8_t *)_indices.contents,
+            (uint8_t *)_chunks.contents,
+            (uint8_t *)materialData.mutableBytes,
+            (uint8_t *)meshData.mutableBytes,
+        };
+        uncompressData(blocks, dstBuffers, sizeof(blocks) / sizeof(blocks[0]));
+
+        _materialData   = materialData;
+        _meshData       = meshData;
+
+        // The chunks are read on both the CPU and the GPU, so keep the shared buffer
+        //  for CPU access instead of uncompressing the chunk data a second time.
+        _chunkStorage   = _chunks;
+        _chunkData      = [NSData dataWithBytesNoCopy:_chunkStorage.contents
+                                               length:_chunkStorage.length
+                                         freeWhenDone:NO];
 
         if(!device.hasUnifiedMemory)
         {
@@ -140,10 +157,6 @@ Implemenation of class storing data to draw a mesh including vertex buffers, sub
             [cmdBuffer commit];
         }
 
-        _materialData   = uncompressData(compressedMaterialData);
-        _meshData       = uncompressData(compressedMeshData);
-        _chunkData      = uncompressData(compressedChunkData);
-
         _vertexCount            = mesh.vertexCount;
         _indexCount             = mesh.indexCount;
 
@@ -17,6 +17,7 @@ Implementation of a renderer class, which manages render state and performs per-
 #import "AAPLScatterVolume.h"
 #import "AAPLAmbientObscurance.h"
 #import "AAPLMeshRenderer.h"
+#import "AAPLRendererFrameGraph.h"
 
 #import "AAPLCamera.h"
 #import "AAPLCameraController.h"
@@ -27,6 +28,7 @@ Implementation of a renderer class, which manages render state and performs per-
 #import "AAPLCommon.h"
 #import "AAPLMaterial.h"
 #import "AAPLAsset.h"
+#import "AAPLKTXFile.h"
 #import "AAPLMeshTypes.h"
 #import "AAPLUtilities.h"
 #import "AAPLMathUtilities.h"
@@ -396,6 +398,17 @@ struct AAPLFrameData
     AAPLLightingEnvironmentState*   _lightingEnvironment;
     AAPLScene*                      _scene;
     AAPLMesh*                       _mesh;
+
+    // Passes of the current configuration with the resources they access.  The compiled graph
+    //  decides which of the passes `drawInMTKView` encodes, culling those whose results no
+    //  other pass uses, and measures the transient memory a heap would need when aliasing
+    //  them.  Rebuilt only when the options change.
+    AAPLFrameGraph                  _frameGraph;
+    AAPLRendererFrameGraphOptions   _frameGraphOptions;
+    AAPLRendererFrameGraphPasses    _frameGraphPasses;
+    bool                            _frameGraphBuilt;
+    bool                            _frameGraphCompiled;
+    NSString*                       _frameGraphInfo;
 }
 
 -(NSString*) info { return _info; };
@@ -1137,6 +1150,101 @@ struct AAPLFrameData
     return texture;
 }
 
+// Helper method to load a KTX1 or KTX2 texture from a file path.
+//  Maps the file and blits every image from one staging buffer into a private texture,
+//  decoding supercompressed levels into the staging buffer.
+- (id<MTLTexture>)loadKTXTextureFromPath:(NSString *)filePath
+{
+    NSURL* url = [[NSBundle mainBundle] URLForResource:filePath withExtension:@""];
+
+    AAPLKTXFile ktx;
+    std::string error;
+    MTLPixelFormat pixelFormat = MTLPixelFormatInvalid;
+    if (ktx.open(url.fileSystemRepresentation, error))
+    {
+        pixelFormat = AAPLKTXMetalPixelFormat(ktx.format(), true);
+        if (pixelFormat == MTLPixelFormatInvalid)
+            error = "No Metal pixel format matches the file's format";
+    }
+
+    if (pixelFormat == MTLPixelFormatInvalid)
+    {
+        NSString* reason = [NSString stringWithFormat:@"Error loading texture (%@) : %s", filePath, error.c_str()];
+        NSException* exc = [NSException exceptionWithName:@"Texture loading exception"
+                                                   reason:reason
+                                                 userInfo:nil];
+        @throw exc;
+    }
+
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor new];
+    if (ktx.isCube())
+        desc.textureType    = ktx.isArray() ? MTLTextureTypeCubeArray : MTLTextureTypeCube;
+    else if (ktx.depth() > 1)
+        desc.textureType    = MTLTextureType3D;
+    else
+        desc.textureType    = ktx.isArray() ? MTLTextureType2DArray : MTLTextureType2D;
+    desc.pixelFormat        = pixelFormat;
+    desc.width              = ktx.width();
+    desc.height             = ktx.height();
+    desc.depth              = ktx.depth();
+    desc.arrayLength        = ktx.layerCount();
+    desc.mipmapLevelCount   = ktx.levelCount();
+    desc.usage              = MTLTextureUsageShaderRead;
+    desc.storageMode        = MTLStorageModePrivate;
+
+    id<MTLTexture> texture = [_device newTextureWithDescriptor:desc];
+    texture.label = filePath;
+
+    // Place each level in the staging buffer at an offset aligned for any pixel format.
+    std::vector<NSUInteger> levelOffsets(ktx.levelCount());
+    NSUInteger stagingSize = 0;
+    for (uint32_t level = 0; level < ktx.levelCount(); ++level)
+    {
+        levelOffsets[level] = stagingSize;
+        stagingSize = alignUp(stagingSize + (NSUInteger)ktx.level(level).uncompressedLength, 16);
+    }
+
+    id<MTLBuffer> stagingBuffer = [_device newBufferWithLength:stagingSize options:MTLResourceStorageModeShared];
+
+    id<MTLCommandBuffer> commandBuffer = [_commandQueue commandBuffer];
+    commandBuffer.label = filePath;
+    id<MTLBlitCommandEncoder> blitEncoder = [commandBuffer blitCommandEncoder];
+
+    for (uint32_t level = 0; level < ktx.levelCount(); ++level)
+    {
+        const AAPLKTXFile::Level& levelInfo = ktx.level(level);
+        uint8_t* levelData = (uint8_t*)stagingBuffer.contents + levelOffsets[level];
+
+        if (!AAPLKTXDecodeLevel(ktx, level, levelData, (size_t)levelInfo.uncompressedLength, error))
+        {
+            NSString* reason = [NSString stringWithFormat:@"Error loading texture (%@) : %s", filePath, error.c_str()];
+            NSException* exc = [NSException exceptionWithName:@"Texture loading exception"
+                                                       reason:reason
+                                                     userInfo:nil];
+            @throw exc;
+        }
+
+        // Each face of each layer is one slice of the texture.
+        for (uint32_t slice = 0; slice < ktx.layerCount() * ktx.faceCount(); ++slice)
+        {
+            [blitEncoder copyFromBuffer:stagingBuffer
+                           sourceOffset:levelOffsets[level] + slice * levelInfo.faceStride
+                      sourceBytesPerRow:levelInfo.bytesPerRow
+                    sourceBytesPerImage:levelInfo.bytesPerImage
+                             sourceSize:MTLSizeMake(levelInfo.width, levelInfo.height, levelInfo.depth)
+                              toTexture:texture
+                       destinationSlice:slice
+                       destinationLevel:level
+                      destinationOrigin:MTLOriginMake(0, 0, 0)];
+        }
+    }
+
+    [blitEncoder endEncoding];
+    [commandBuffer commit];
+
+    return texture;
+}
+
 - (void)configureMaterial:(const AAPLMaterial &)material
 {
     NSUInteger baseColorMip = 0;
@@ -1317,9 +1425,9 @@ struct AAPLFrameData
     }
 
     _blueNoiseTexture   = [self loadTextureFromPath:@"blueNoise.png"];
-    _envMapTexture      = [self loadTextureFromPath:@"san_giuseppe_bridge_4k_ibl.ktx"];
-    _dfgLutTexture      = [self loadTextureFromPath:@"DFGLUT.ktx"];
-    _perlinNoiseTexture = [self loadTextureFromPath:@"Perlin.ktx"];
+    _envMapTexture      = [self loadKTXTextureFromPath:@"san_giuseppe_bridge_4k_ibl.ktx"];
+    _dfgLutTexture      = [self loadKTXTextureFromPath:@"DFGLUT.ktx"];
+    _perlinNoiseTexture = [self loadKTXTextureFromPath:@"Perlin.ktx"];
 
     [_globalTexturesEncoder setTexture:_dfgLutTexture atIndex:AAPLGlobalTextureIndexDFG];
     [_globalTexturesEncoder setTexture:_envMapTexture atIndex:AAPLGlobalTextureIndexEnvMap];
@@ -2464,6 +2572,107 @@ static float halton(uint32_t index, uint32_t base)
     }
 }
 
+// Declares the passes of the frame for the current configuration and compiles them, if the
+//  configuration changed since the last frame.
+- (void)updateFrameGraph
+{
+    AAPLRendererFrameGraphOptions options;
+
+    options.physicalWidth               = _physicalWidth;
+    options.physicalHeight              = _physicalHeight;
+    options.mainViewWidth               = _mainViewWidth;
+    options.mainViewHeight              = _mainViewHeight;
+    options.customMainView              = _mainView != nil;
+
+    options.deferred                    = lightingModeIsDeferred(_config.lightingMode);
+    options.clustered                   = _config.lightingMode == AAPLLightingModeDeferredClustered;
+    options.hasTransparentMeshes        = _mesh.transparentMeshCount > 0;
+
+    const AAPLRenderCullType renderCullType = _cullingVisualizationMode ? AAPLRenderCullTypeVisualization : _config.renderCullType;
+
+    options.indirect                    = _config.renderMode == AAPLRenderModeIndirect;
+    options.occlusionCulling            = renderCullType == AAPLRenderCullTypeFrustumDepth;
+    options.occluders                   = _occludersEnabled;
+
+#if RENDER_SHADOWS
+    options.shadows                     = true;
+#else
+    options.shadows                     = false;
+#endif
+    options.shadowsIndirect             = _config.shadowRenderMode == AAPLRenderModeIndirect;
+    options.shadowOcclusionCulling      = _config.shadowCullType == AAPLRenderCullTypeFrustumDepth;
+    options.shadowMapSize               = ShadowMapSize;
+    options.shadowCascadeCount          = SHADOW_CASCADE_COUNT;
+
+    options.singlePassDeferred          = _config.singlePassDeferredLighting;
+    options.depthPrepassTileShaders     = _config.useDepthPrepassTileShaders;
+    options.lightCullingTileShaders     = _config.useLightCullingTileShaders;
+    options.depthDownsampleTileShader   = _config.useDepthDownsampleTileShader;
+
+#if USE_SCALABLE_AMBIENT_OBSCURANCE
+    options.ambientObscurance           = true;
+#else
+    options.ambientObscurance           = false;
+#endif
+#if USE_SCATTERING_VOLUME
+    options.scattering                  = true;
+    options.scatteringTileSize          = SCATTERING_TILE_SIZE;
+    options.scatteringDepth             = SCATTERING_VOLUME_DEPTH;
+#else
+    options.scattering                  = false;
+#endif
+
+    options.temporalAA                  = _config.useTemporalAA;
+#if ENABLE_DEBUG_RENDERING
+    options.debugRendering              = true;
+#else
+    options.debugRendering              = false;
+#endif
+#if USE_VIRTUAL_JOYSTICKS
+    options.userInterface               = _renderUI;
+#else
+    options.userInterface               = false;
+#endif
+
+    const uint2 lightCount = [self getLightCount];
+
+    options.lightCullingTileSize        = _lightCullingTileSize;
+    options.lightsPerTile               = MAX_LIGHTS_PER_TILE;
+    options.lightsPerCluster            = MAX_LIGHTS_PER_CLUSTER;
+    options.clusterDepth                = LIGHT_CLUSTER_DEPTH;
+    options.pointLightCount             = lightCount.x;
+    options.spotLightCount              = lightCount.y;
+
+    if(_frameGraphBuilt && options == _frameGraphOptions)
+        return;
+
+    _frameGraphOptions = options;
+    _frameGraphBuilt = true;
+
+    AAPLBuildRendererFrameGraph(options, _frameGraph, _frameGraphPasses);
+
+    _frameGraphCompiled = _frameGraph.compile();
+    if(!_frameGraphCompiled)
+    {
+        NSLog(@"Failed to compile the frame graph: %s", _frameGraph.error().c_str());
+        _frameGraphInfo = @"Frame graph: failed to compile\n";
+        return;
+    }
+
+    _frameGraphInfo = [NSString stringWithFormat:@"Frame graph: %u/%u passes, %.1f MB transient (%.1f MB unaliased)\n",
+                                                 (uint32_t)_frameGraph.schedule().size(), _frameGraph.passCount(),
+                                                 _frameGraph.heapSize() / (1024.0f * 1024.0f),
+                                                 _frameGraph.unaliasedSize() / (1024.0f * 1024.0f)];
+}
+
+// Whether to encode `pass` of the frame graph: the configuration decides which passes the
+//  frame has, and the graph culls those whose results aren't used.  Every pass the
+//  configuration enables is encoded if the graph failed to compile.
+- (bool)frameGraphKeepsPass:(uint32_t)pass
+{
+    return pass == AAPLFrameGraph::InvalidIndex || !_frameGraphCompiled || _frameGraph.isLive(pass);
+}
+
 - (void)drawInMTKView:(nonnull MTKView *)view
 {
     if (_firstFrame)
@@ -2481,6 +2690,10 @@ static float halton(uint32_t index, uint32_t base)
     AAPLFrameData& currentFrame = _frameData[_frameIndex];
 
     [self updateState];
+    [self updateFrameGraph];
+
+    // Statistics of the frame graph for the completion handler, as a later frame may rebuild it.
+    NSString* frameGraphInfo = _frameGraphInfo;
 
     AAPLCamera* cullCamera = self.getCullCamera;
     const float4x4 cullViewProjMatrix = cullCamera.cameraParams.viewProjectionMatrix;
@@ -2524,6 +2737,9 @@ static float halton(uint32_t index, uint32_t base)
         }
         dispatch_semaphore_signal(block_sema);
 
+        [self->_info appendString:@"-----\n"];
+        [self->_info appendString:frameGraphInfo];
+
         [self->_info appendString:@"-----\n"];
         [self->_info appendString:self->_textureManager.info];
     }];
@@ -2536,16 +2752,19 @@ static float halton(uint32_t index, uint32_t base)
 #endif
 
     uint2 lightCount = self.getLightCount;
-    [_lightCuller executeCoarseCulling:_culledLights
-                         commandBuffer:commandBuffer
-                       pointLightCount:lightCount.x
-                        spotLightCount:lightCount.y
-                           pointLights:currentFrame.pointLightsCullingBuffer
-                            spotLights:currentFrame.spotLightsCullingBuffer
-                       frameDataBuffer:currentFrame.frameDataBuffer
-                    cameraParamsBuffer:currentFrame.viewData[0].cameraParamsBuffer
-                                rrData:rrMapData
-                             nearPlane:_viewCamera.nearPlane];
+    if([self frameGraphKeepsPass:_frameGraphPasses.coarseLightCulling])
+    {
+        [_lightCuller executeCoarseCulling:_culledLights
+                             commandBuffer:commandBuffer
+                           pointLightCount:lightCount.x
+                            spotLightCount:lightCount.y
+                               pointLights:currentFrame.pointLightsCullingBuffer
+                                spotLights:currentFrame.spotLightsCullingBuffer
+                           frameDataBuffer:currentFrame.frameDataBuffer
+                        cameraParamsBuffer:currentFrame.viewData[0].cameraParamsBuffer
+                                    rrData:rrMapData
+                                 nearPlane:_viewCamera.nearPlane];
+    }
 
     id<MTLRasterizationRateMap> rateMap;
 
@@ -2554,14 +2773,14 @@ static float halton(uint32_t index, uint32_t base)
     rateMap = _rateMap;
 #endif
 
-    if (_occludersEnabled)
+    if (_occludersEnabled && [self frameGraphKeepsPass:_frameGraphPasses.occluders])
         [self drawOccluders:_depthTexture
               commandBuffer:commandBuffer
                     rateMap:rateMap
              viewProjMatrix:cullViewProjMatrix];
 
     // Generate depth pyramid and run chunk culling for main view
-    if(_config.renderMode == AAPLRenderModeIndirect)
+    if(_config.renderMode == AAPLRenderModeIndirect && [self frameGraphKeepsPass:_frameGraphPasses.mainViewCulling])
     {
         [_culling resetIndirectCommandBuffersForViews:currentFrame.viewICBData
                                             viewCount:1
@@ -2607,7 +2826,7 @@ static float halton(uint32_t index, uint32_t base)
     }
 
 #if RENDER_SHADOWS
-    if(_config.shadowRenderMode == AAPLRenderModeIndirect)
+    if(_config.shadowRenderMode == AAPLRenderModeIndirect && [self frameGraphKeepsPass:_frameGraphPasses.shadowCulling])
     {
         id <MTLTexture> shadowSlices[SHADOW_CASCADE_COUNT];
         if(_config.shadowCullType == AAPLRenderCullTypeFrustumDepth)
@@ -2847,6 +3066,8 @@ static float halton(uint32_t index, uint32_t base)
     }
 
 #if USE_SCALABLE_AMBIENT_OBSCURANCE
+    // Only ambient obscurance reads the mipped depth, so the graph keeps both or neither.
+    if([self frameGraphKeepsPass:_frameGraphPasses.ambientObscurance])
     {
         id<MTLComputeCommandEncoder> computeEncoder = [commandBuffer computeCommandEncoder];
         computeEncoder.label = @"Mipped Depth Downsample";
@@ -2874,7 +3095,7 @@ static float halton(uint32_t index, uint32_t base)
     }
 #endif
 
-    if(!_config.useLightCullingTileShaders)
+    if(!_config.useLightCullingTileShaders && [self frameGraphKeepsPass:_frameGraphPasses.lightCulling])
     {
         [_lightCuller executeTraditionalCulling:_culledLights
                                 pointLightCount:lightCount.x
@@ -2888,7 +3109,7 @@ static float halton(uint32_t index, uint32_t base)
                                 onCommandBuffer:commandBuffer];
     }
 
-    if (isClustered && !_config.useLightCullingTileShaders)
+    if (isClustered && !_config.useLightCullingTileShaders && [self frameGraphKeepsPass:_frameGraphPasses.lightClustering])
     {
         [_lightCuller executeTraditionalClustering:_culledLights
                                      commandBuffer:commandBuffer
@@ -2903,8 +3124,11 @@ static float halton(uint32_t index, uint32_t base)
     }
 
 #if RENDER_SHADOWS
-    [self renderShadowsForFrame:currentFrame
-                toCommandBuffer:commandBuffer];
+    if([self frameGraphKeepsPass:_frameGraphPasses.shadows])
+    {
+        [self renderShadowsForFrame:currentFrame
+                    toCommandBuffer:commandBuffer];
+    }
 #endif
 
 #if USE_SCATTERING_VOLUME
@@ -2922,20 +3146,23 @@ static float halton(uint32_t index, uint32_t base)
         spotLightIndices = _culledLights.spotLightIndicesTransparentBuffer;
     }
 
-    [_scatterVolume update:commandBuffer
-           frameDataBuffer:frameDataBuffer
-          cameraParamsBuffer:currentFrame.viewData[0].cameraParamsBuffer
-                 shadowMap:_shadowMap
-          pointLightBuffer:currentFrame.pointLightsBuffer
-           spotLightBuffer:currentFrame.spotLightsBuffer
-         pointLightIndices:pointLightIndices
-          spotLightIndices:spotLightIndices
+    if([self frameGraphKeepsPass:_frameGraphPasses.scattering])
+    {
+        [_scatterVolume update:commandBuffer
+               frameDataBuffer:frameDataBuffer
+              cameraParamsBuffer:currentFrame.viewData[0].cameraParamsBuffer
+                     shadowMap:_shadowMap
+              pointLightBuffer:currentFrame.pointLightsBuffer
+               spotLightBuffer:currentFrame.spotLightsBuffer
+             pointLightIndices:pointLightIndices
+              spotLightIndices:spotLightIndices
 #if USE_SPOT_LIGHT_SHADOWS
-          spotLightShadows:_spotShadowMaps
+              spotLightShadows:_spotShadowMaps
 #endif
-                    rrData:rrMapData
-                 clustered:isClustered
-              resetHistory:_resetHistory];
+                        rrData:rrMapData
+                     clustered:isClustered
+                  resetHistory:_resetHistory];
+    }
 
 #endif // USE_SCATTERING_VOLUME
 
@@ -3083,7 +3310,7 @@ static float halton(uint32_t index, uint32_t base)
 
         const bool needsForwardPass = (_config.lightingMode == AAPLLightingModeForward) || _mesh.transparentMeshCount > 0;
 
-        if(needsForwardPass)
+        if(needsForwardPass && [self frameGraphKeepsPass:_frameGraphPasses.forward])
         {
             _forwardPassDescriptor.depthAttachment.texture      = _depthTexture;
             _forwardPassDescriptor.colorAttachments[0].texture  = _lightingBuffer;
@@ -3204,7 +3431,7 @@ static float halton(uint32_t index, uint32_t base)
         [renderEncoder endEncoding];
 
 #if SUPPORT_TEMPORAL_ANTIALIASING
-        if(_config.useTemporalAA)
+        if(_config.useTemporalAA && [self frameGraphKeepsPass:_frameGraphPasses.copyHistory])
         {
             // copy history
             id <MTLBlitCommandEncoder> blitEncoder = [commandBuffer blitCommandEncoder];
@@ -3222,18 +3449,21 @@ static float halton(uint32_t index, uint32_t base)
 #endif // USE_RESOLVE_PASS
 
 #if ENABLE_DEBUG_RENDERING
-        [self renderDebug:commandBuffer
-                   target:resolveTarget
-          frameDataBuffer:frameDataBuffer
-             cameraParams:currentFrame.viewData[0].cameraParamsBuffer
-           viewProjMatrix:_viewCamera.cameraParams.viewProjectionMatrix
-               cullCamera:cullCamera];
+        if([self frameGraphKeepsPass:_frameGraphPasses.debug])
+        {
+            [self renderDebug:commandBuffer
+                       target:resolveTarget
+              frameDataBuffer:frameDataBuffer
+                 cameraParams:currentFrame.viewData[0].cameraParamsBuffer
+               viewProjMatrix:_viewCamera.cameraParams.viewProjectionMatrix
+                   cullCamera:cullCamera];
+        }
 #endif
 
         id <MTLTexture> backBuffer = getViewRenderPassDescriptor().colorAttachments[0].texture;
 
 #if USE_VIRTUAL_JOYSTICKS
-        if(_renderUI)
+        if(_renderUI && [self frameGraphKeepsPass:_frameGraphPasses.userInterface])
         {
             MTLRenderPassDescriptor *passDescriptor = [MTLRenderPassDescriptor new];
             passDescriptor.colorAttachments[0].texture      = resolveTarget;
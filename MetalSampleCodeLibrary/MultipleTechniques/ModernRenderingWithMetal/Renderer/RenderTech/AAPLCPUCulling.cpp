@@ -0,0 +1,506 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of mesh chunk culling on the CPU.
+*/
+#include "AAPLCPUCulling.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "AAPLCPUSIMD.h"
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+using namespace AAPLSIMD;
+
+inline float saturate(float f)
+{
+    return std::min(std::max(f, 0.0f), 1.0f);
+}
+
+// Multiplies a column major matrix by (x, y, z, 1).
+inline void transformPoint(const float m[16], float x, float y, float z, float out[4])
+{
+    for (int r = 0; r < 4; ++r)
+        out[r] = m[r] * x + m[4 + r] * y + m[8 + r] * z + m[12 + r];
+}
+
+// Generates an outcode for a clip space vertex, as in AAPLCulling.metal.
+inline uint32_t outcode(const float f[4])
+{
+    return
+        (( f[0] > f[3]) << 0) |
+        (( f[1] > f[3]) << 1) |
+        (( f[2] > f[3]) << 2) |
+        ((-f[0] > f[3]) << 3) |
+        ((-f[1] > f[3]) << 4) |
+        ((-f[2] > f[3]) << 5);
+}
+
+// Same as AAPLSphere::distanceToPlane.
+inline float distanceToPlane(const float plane[4], float x, float y, float z, float radius)
+{
+    const float centerDist = plane[0] * x + plane[1] * y + plane[2] * z + plane[3];
+    return centerDist > 0 ? std::max(0.0f, centerDist - radius) : std::min(0.0f, centerDist + radius);
+}
+
+// Returns true if all normals of the chunk face away from the camera.
+inline bool chunkBackfacing(const AAPLCPUCullChunks& chunks, const AAPLCPUCullParams& params, size_t i)
+{
+    if (params.orthographic)
+    {
+        const float facing = params.viewDirection[0] * chunks.coneX[i]
+                           + params.viewDirection[1] * chunks.coneY[i]
+                           + params.viewDirection[2] * chunks.coneZ[i];
+
+        return facing > chunks.coneSinAngle[i];
+    }
+
+    const float dx = chunks.centerX[i] - params.cameraPosition[0];
+    const float dy = chunks.centerY[i] - params.cameraPosition[1];
+    const float dz = chunks.centerZ[i] - params.cameraPosition[2];
+
+    const float facing   = dx * chunks.coneX[i] + dy * chunks.coneY[i] + dz * chunks.coneZ[i];
+    const float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+    return facing > chunks.coneSinAngle[i] * distance + chunks.radius[i];
+}
+
+inline bool chunkOccluded(const AAPLCPUCullChunks& chunks, const AAPLCPUCullParams& params,
+                          const AAPLCPUDepthPyramid& depthPyramid, size_t i)
+{
+    const float boxMin[3] = { chunks.minX[i], chunks.minY[i], chunks.minZ[i] };
+    const float boxMax[3] = { chunks.maxX[i], chunks.maxY[i], chunks.maxZ[i] };
+
+    return depthPyramid.isOccluded(boxMin, boxMax, params.viewProjectionMatrix);
+}
+
+inline AAPLCullResult cullChunk(const AAPLCPUCullChunks& chunks, const AAPLCPUCullParams& params,
+                                const AAPLCPUDepthPyramid* depthPyramid, size_t i)
+{
+    float distance = FLT_MAX;
+    for (int p = 0; p < 6; ++p)
+        distance = std::min(distance, distanceToPlane(params.frustumPlanes[p], chunks.centerX[i], chunks.centerY[i],
+                                                      chunks.centerZ[i], chunks.radius[i]));
+
+    if (!(distance >= 0.0f))
+        return AAPLCullResultFrustumCulled;
+
+    if (params.cullBackfaces && chunkBackfacing(chunks, params, i))
+        return AAPLCullResultBackfaceCulled;
+
+    if (depthPyramid && chunkOccluded(chunks, params, *depthPyramid, i))
+        return AAPLCullResultOcclusionCulled;
+
+    return AAPLCullResultNotCulled;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+void AAPLCPUCullChunks::clear()
+{
+    for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &radius,
+                                       &coneX, &coneY, &coneZ, &coneSinAngle,
+                                       &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+        array->clear();
+}
+
+void AAPLCPUCullChunks::reserve(size_t count)
+{
+    for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &radius,
+                                       &coneX, &coneY, &coneZ, &coneSinAngle,
+                                       &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+        array->reserve(count);
+}
+
+void AAPLCPUCullChunks::push_back(const float center[3], float r, const float normalDistribution[4],
+                                  const float boxMin[3], const float boxMax[3])
+{
+    centerX.push_back(center[0]);
+    centerY.push_back(center[1]);
+    centerZ.push_back(center[2]);
+    radius.push_back(r);
+
+    // The cone faces away when the view direction is within 90 degrees minus the cone
+    //  angle of its axis, so compare the cosine of that angle with the sine of the cone's.
+    const float cosAngle = normalDistribution[3];
+
+    coneX.push_back(normalDistribution[0]);
+    coneY.push_back(normalDistribution[1]);
+    coneZ.push_back(normalDistribution[2]);
+    coneSinAngle.push_back(cosAngle > 0.0f ? sqrtf(1.0f - std::min(cosAngle * cosAngle, 1.0f)) : 2.0f);
+
+    minX.push_back(boxMin[0]);
+    minY.push_back(boxMin[1]);
+    minZ.push_back(boxMin[2]);
+    maxX.push_back(boxMax[0]);
+    maxY.push_back(boxMax[1]);
+    maxZ.push_back(boxMax[2]);
+}
+
+//------------------------------------------------------------------------------
+
+void AAPLCPUDepthPyramid::resize(uint32_t width, uint32_t height)
+{
+    _width  = std::max(width, 1u);
+    _height = std::max(height, 1u);
+    _stride = (_width + 7) & ~7u;
+
+    // Full mip chain, as for the GPU's pyramid texture.
+    uint32_t levelCount = 1;
+    while ((std::max(_width, _height) >> levelCount) > 0)
+        ++levelCount;
+
+    _levels.resize(levelCount);
+    _levels[0].assign((size_t)_stride * _height, 1.0f);
+
+    for (uint32_t i = 1; i < levelCount; ++i)
+        _levels[i].assign((size_t)std::max(_width >> i, 1u) * std::max(_height >> i, 1u), 1.0f);
+}
+
+void AAPLCPUDepthPyramid::clear()
+{
+    std::fill(_levels[0].begin(), _levels[0].end(), 1.0f);
+}
+
+void AAPLCPUDepthPyramid::loadDepth(const float* depth)
+{
+    for (uint32_t y = 0; y < _height; ++y)
+        std::copy(depth + (size_t)y * _width, depth + (size_t)(y + 1) * _width, _levels[0].data() + (size_t)y * _stride);
+}
+
+void AAPLCPUDepthPyramid::storeDepth(float* depth) const
+{
+    for (uint32_t y = 0; y < _height; ++y)
+        std::copy(_levels[0].data() + (size_t)y * _stride, _levels[0].data() + (size_t)y * _stride + _width, depth + (size_t)y * _width);
+}
+
+float AAPLCPUDepthPyramid::depth(uint32_t level, uint32_t x, uint32_t y) const
+{
+    const uint32_t stride = level == 0 ? _stride : std::max(_width >> level, 1u);
+
+    return _levels[level][(size_t)y * stride + x];
+}
+
+void AAPLCPUDepthPyramid::rasterizeTriangles(const float* positions, const uint32_t* indices, size_t triangleCount,
+                                             const float viewProjectionMatrix[16])
+{
+    const float width  = (float)_width;
+    const float height = (float)_height;
+
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        float sx[3], sy[3];
+        float depth = 0.0f;
+        bool  clipped = false;
+
+        for (int v = 0; v < 3; ++v)
+        {
+            const float* p = positions + (size_t)indices[t * 3 + v] * 3;
+
+            float f[4];
+            transformPoint(viewProjectionMatrix, p[0], p[1], p[2], f);
+
+            if (f[3] <= FLT_EPSILON || f[2] < 0.0f)
+            {
+                clipped = true;
+                break;
+            }
+
+            // Pixel coordinates with y down, as the shaders' `xy * (0.5, -0.5) + 0.5`.
+            sx[v] = (f[0] / f[3] * 0.5f + 0.5f) * width;
+            sy[v] = (f[1] / f[3] * -0.5f + 0.5f) * height;
+            depth = std::max(depth, f[2] / f[3]);
+        }
+
+        if (clipped)
+            continue;
+
+        // Counterclockwise in pixel coordinates, so that the edge functions are positive inside.
+        float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+        if (area < 0.0f)
+        {
+            std::swap(sx[1], sx[2]);
+            std::swap(sy[1], sy[2]);
+            area = -area;
+        }
+        if (!(area > 0.0f))
+            continue;
+
+        const int x0 = std::max((int)floorf(std::min(sx[0], std::min(sx[1], sx[2]))), 0);
+        const int y0 = std::max((int)floorf(std::min(sy[0], std::min(sy[1], sy[2]))), 0);
+        const int x1 = std::min((int)ceilf(std::max(sx[0], std::max(sx[1], sx[2]))), (int)_width);
+        const int y1 = std::min((int)ceilf(std::max(sy[0], std::max(sy[1], sy[2]))), (int)_height);
+
+        if (x0 >= x1 || y0 >= y1)
+            continue;
+
+        // Edge i runs from vertex i to vertex i + 1: E(x, y) = a * x + b * y + c, evaluated at
+        //  pixel centers.  Neighboring triangles evaluate their shared edge with opposite signs,
+        //  so the top-left rule covers each pixel along it exactly once.
+        float a[3], b[3], c[3];
+        bool  topLeft[3];
+        for (int e = 0; e < 3; ++e)
+        {
+            const int n = (e + 1) % 3;
+
+            a[e] = sy[e] - sy[n];
+            b[e] = sx[n] - sx[e];
+            c[e] = sx[e] * sy[n] - sy[e] * sx[n];
+
+            topLeft[e] = a[e] > 0.0f || (a[e] == 0.0f && b[e] > 0.0f);
+        }
+
+        const Float ramp    = Float::ramp();
+        const Float zero    = Float::splat(0.0f);
+        const Float allSet  = zero >= zero;
+        const Float noneSet = zero > zero;
+        const Float tl0     = topLeft[0] ? allSet : noneSet;
+        const Float tl1     = topLeft[1] ? allSet : noneSet;
+        const Float tl2     = topLeft[2] ? allSet : noneSet;
+        const Float z       = Float::splat(depth);
+        const Float a0      = Float::splat(a[0]);
+        const Float a1      = Float::splat(a[1]);
+        const Float a2      = Float::splat(a[2]);
+
+        // Start rows on a vector boundary; the padding of the rows keeps stores in bounds.
+        const int xStart = x0 & ~(int)(Float::Lanes - 1);
+
+        for (int y = y0; y < y1; ++y)
+        {
+            const float py = (float)y + 0.5f;
+
+            const Float r0 = Float::splat(b[0] * py + c[0]);
+            const Float r1 = Float::splat(b[1] * py + c[1]);
+            const Float r2 = Float::splat(b[2] * py + c[2]);
+
+            float* row = _levels[0].data() + (size_t)y * _stride;
+
+            for (int x = xStart; x < x1; x += Float::Lanes)
+            {
+                const Float px = Float::splat((float)x + 0.5f) + ramp;
+
+                const Float e0 = a0 * px + r0;
+                const Float e1 = a1 * px + r1;
+                const Float e2 = a2 * px + r2;
+
+                const Float inside = select(tl0, e0 >= zero, e0 > zero)
+                                   & select(tl1, e1 >= zero, e1 > zero)
+                                   & select(tl2, e2 >= zero, e2 > zero);
+
+                if (!bits(inside))
+                    continue;
+
+                const Float old = Float::load(row + x);
+                select(inside, min(old, z), old).store(row + x);
+            }
+        }
+    }
+}
+
+void AAPLCPUDepthPyramid::build()
+{
+    // Same as the `depthPyramid` kernel: each texel takes the farthest of the 2x2 texels
+    //  above it, and of the third row or column when the level above has an odd size.
+    for (uint32_t level = 1; level < _levels.size(); ++level)
+    {
+        const uint32_t srcWidth  = std::max(_width >> (level - 1), 1u);
+        const uint32_t srcHeight = std::max(_height >> (level - 1), 1u);
+        const uint32_t dstWidth  = std::max(_width >> level, 1u);
+        const uint32_t dstHeight = std::max(_height >> level, 1u);
+
+        float* dst = _levels[level].data();
+
+        for (uint32_t y = 0; y < dstHeight; ++y)
+        {
+            const uint32_t sy0 = std::min(y * 2, srcHeight - 1);
+            const uint32_t sy1 = std::min(y * 2 + 1, srcHeight - 1);
+            const bool edgeY   = (y * 2 == srcHeight - 3);
+
+            for (uint32_t x = 0; x < dstWidth; ++x)
+            {
+                const uint32_t sx0 = std::min(x * 2, srcWidth - 1);
+                const uint32_t sx1 = std::min(x * 2 + 1, srcWidth - 1);
+                const bool edgeX   = (x * 2 == srcWidth - 3);
+
+                float d = std::max(std::max(depth(level - 1, sx0, sy0), depth(level - 1, sx0, sy1)),
+                                   std::max(depth(level - 1, sx1, sy0), depth(level - 1, sx1, sy1)));
+
+                if (edgeX)
+                    d = std::max(d, std::max(depth(level - 1, x * 2 + 2, sy0), depth(level - 1, x * 2 + 2, sy1)));
+                if (edgeY)
+                    d = std::max(d, std::max(depth(level - 1, sx0, y * 2 + 2), depth(level - 1, sx1, y * 2 + 2)));
+                if (edgeX && edgeY)
+                    d = std::max(d, depth(level - 1, x * 2 + 2, y * 2 + 2));
+
+                dst[(size_t)y * dstWidth + x] = d;
+            }
+        }
+    }
+}
+
+bool AAPLCPUDepthPyramid::isOccluded(const float boxMin[3], const float boxMax[3], const float viewProjectionMatrix[16]) const
+{
+    float projMin[3] = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+    float projMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    // Frustum culling
+    uint32_t flags = 0xFF;
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        // Same corner order as AAPLBoundingBox3::GetCorner.
+        float f[4];
+        transformPoint(viewProjectionMatrix,
+                       (i & 0b100) ? boxMin[0] : boxMax[0],
+                       (i & 0b010) ? boxMin[1] : boxMax[1],
+                       (i & 0b001) ? boxMin[2] : boxMax[2], f);
+
+        flags &= outcode(f);
+
+        // prevent issues with corners behind camera
+        f[2] = std::max(f[2], 0.0f);
+
+        const float fp[3] =
+        {
+            saturate(f[0] / f[3] * 0.5f + 0.5f),
+            saturate(f[1] / f[3] * -0.5f + 0.5f),
+            saturate(f[2] / f[3])
+        };
+
+        for (int c = 0; c < 3; ++c)
+        {
+            projMin[c] = std::min(projMin[c], fp[c]);
+            projMax[c] = std::max(projMax[c], fp[c]);
+        }
+    }
+
+    if (flags)
+        return true;
+
+    // Depth buffer culling.
+    const float extent = std::max((float)_width * (projMax[0] - projMin[0]), (float)_height * (projMax[1] - projMin[1]));
+
+    // The GPU clamps the level when sampling; clamp it before scaling as well, so that the
+    //  scale stays finite.
+    const uint32_t lod = extent > 1.0f ? std::min((uint32_t)ceilf(log2f(extent)), levelCount() - 1) : 0;
+
+    const uint32_t lodWidth  = _width & (0xFFFFFFFF << lod);
+    const uint32_t lodHeight = _height & (0xFFFFFFFF << lod);
+    const float lodScaleX    = lodWidth ? (float)_width / (float)lodWidth : 1.0f;
+    const float lodScaleY    = lodHeight ? (float)_height / (float)lodHeight : 1.0f;
+
+    // Nearest sampling with clamp to edge.
+    const uint32_t levelWidth  = std::max(_width >> lod, 1u);
+    const uint32_t levelHeight = std::max(_height >> lod, 1u);
+
+    const auto texel = [](float coord, uint32_t size)
+    {
+        const float t = floorf(coord * (float)size);
+        return t <= 0.0f ? 0u : std::min((uint32_t)t, size - 1);
+    };
+
+    const uint32_t x0 = texel(projMin[0] * lodScaleX, levelWidth);
+    const uint32_t x1 = texel(projMax[0] * lodScaleX, levelWidth);
+    const uint32_t y0 = texel(projMin[1] * lodScaleY, levelHeight);
+    const uint32_t y1 = texel(projMax[1] * lodScaleY, levelHeight);
+
+    const float maxDepth = std::max(std::max(depth(lod, x0, y0), depth(lod, x0, y1)),
+                                    std::max(depth(lod, x1, y0), depth(lod, x1, y1)));
+
+    return projMin[2] >= maxDepth;
+}
+
+//------------------------------------------------------------------------------
+
+void AAPLCPUCullChunksScalar(const AAPLCPUCullChunks& chunks, const AAPLCPUCullParams& params,
+                             const AAPLCPUDepthPyramid* depthPyramid, uint8_t* results)
+{
+    for (size_t i = 0; i < chunks.size(); ++i)
+        results[i] = cullChunk(chunks, params, depthPyramid, i);
+}
+
+void AAPLCPUCullChunksBatch(const AAPLCPUCullChunks& chunks, const AAPLCPUCullParams& params,
+                            const AAPLCPUDepthPyramid* depthPyramid, uint8_t* results)
+{
+    const size_t count     = chunks.size();
+    const size_t bulkCount = count - count % Float::Lanes;
+
+    Float planes[6][4];
+    for (int p = 0; p < 6; ++p)
+        for (int c = 0; c < 4; ++c)
+            planes[p][c] = Float::splat(params.frustumPlanes[p][c]);
+
+    const Float zero = Float::splat(0.0f);
+
+    const Float eyeX = Float::splat(params.orthographic ? params.viewDirection[0] : params.cameraPosition[0]);
+    const Float eyeY = Float::splat(params.orthographic ? params.viewDirection[1] : params.cameraPosition[1]);
+    const Float eyeZ = Float::splat(params.orthographic ? params.viewDirection[2] : params.cameraPosition[2]);
+
+    for (size_t i = 0; i < bulkCount; i += Float::Lanes)
+    {
+        const Float cx = Float::load(&chunks.centerX[i]);
+        const Float cy = Float::load(&chunks.centerY[i]);
+        const Float cz = Float::load(&chunks.centerZ[i]);
+        const Float r  = Float::load(&chunks.radius[i]);
+
+        // A sphere is inside when its distance to every plane is at least minus its radius,
+        //  which is the sign test of AAPLSphere::distanceToPlane.
+        Float inside = (planes[0][0] * cx + planes[0][1] * cy + planes[0][2] * cz + planes[0][3] + r >= zero);
+        for (int p = 1; p < 6; ++p)
+            inside = inside & (planes[p][0] * cx + planes[p][1] * cy + planes[p][2] * cz + planes[p][3] + r >= zero);
+
+        const uint32_t insideBits = bits(inside);
+
+        uint32_t backfacingBits = 0;
+        if (params.cullBackfaces && insideBits)
+        {
+            const Float ax  = Float::load(&chunks.coneX[i]);
+            const Float ay  = Float::load(&chunks.coneY[i]);
+            const Float az  = Float::load(&chunks.coneZ[i]);
+            const Float sin = Float::load(&chunks.coneSinAngle[i]);
+
+            if (params.orthographic)
+            {
+                backfacingBits = bits(eyeX * ax + eyeY * ay + eyeZ * az > sin);
+            }
+            else
+            {
+                const Float dx = cx - eyeX;
+                const Float dy = cy - eyeY;
+                const Float dz = cz - eyeZ;
+
+                const Float facing   = dx * ax + dy * ay + dz * az;
+                const Float distance = sqrt(dx * dx + dy * dy + dz * dz);
+
+                backfacingBits = bits(facing > sin * distance + r);
+            }
+        }
+
+        for (uint32_t lane = 0; lane < Float::Lanes; ++lane)
+        {
+            const uint32_t bit = 1u << lane;
+
+            if (!(insideBits & bit))
+                results[i + lane] = AAPLCullResultFrustumCulled;
+            else if (backfacingBits & bit)
+                results[i + lane] = AAPLCullResultBackfaceCulled;
+            else if (depthPyramid && chunkOccluded(chunks, params, *depthPyramid, i + lane))
+                results[i + lane] = AAPLCullResultOcclusionCulled;
+            else
+                results[i + lane] = AAPLCullResultNotCulled;
+        }
+    }
+
+    for (size_t i = bulkCount; i < count; ++i)
+        results[i] = cullChunk(chunks, params, depthPyramid, i);
+}
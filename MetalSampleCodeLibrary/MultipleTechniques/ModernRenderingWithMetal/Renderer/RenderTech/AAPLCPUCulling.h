@@ -0,0 +1,144 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for culling mesh chunks on the CPU, with the same tests and results as the
+ GPU culling kernels, for shadow cascades, offline visibility and tools.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "../Shaders/AAPLCullingShared.h"
+
+// Bounds of mesh chunks in structure of arrays layout, so that several chunks are
+//  tested at once.
+struct AAPLCPUCullChunks
+{
+    // Bounding spheres.
+    std::vector<float>  centerX, centerY, centerZ, radius;
+
+    // Normal cones: axis and sine of the cone's half angle, or a value above 1 for
+    //  chunks whose normals span a hemisphere or more and never face away.
+    std::vector<float>  coneX, coneY, coneZ, coneSinAngle;
+
+    // Bounding boxes, used by the occlusion test.
+    std::vector<float>  minX, minY, minZ, maxX, maxY, maxZ;
+
+    size_t size() const { return radius.size(); }
+
+    void clear();
+    void reserve(size_t count);
+
+    // `normalDistribution` follows AAPLMeshChunk: xyz = average normal; w = cos(max angle).
+    void push_back(const float center[3], float radius, const float normalDistribution[4],
+                   const float boxMin[3], const float boxMax[3]);
+
+    // Fills the arrays from AAPLMeshChunk or any type with the same members.
+    template <typename Chunk>
+    void assign(const Chunk* chunks, size_t count)
+    {
+        clear();
+        reserve(count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Chunk& c = chunks[i];
+
+            const float center[3]   = { c.boundingSphere.data.x, c.boundingSphere.data.y, c.boundingSphere.data.z };
+            const float cone[4]     = { c.normalDistribution.x, c.normalDistribution.y, c.normalDistribution.z, c.normalDistribution.w };
+            const float boxMin[3]   = { c.boundingBox.min.x, c.boundingBox.min.y, c.boundingBox.min.z };
+            const float boxMax[3]   = { c.boundingBox.max.x, c.boundingBox.max.y, c.boundingBox.max.z };
+
+            push_back(center, c.boundingSphere.data.w, cone, boxMin, boxMax);
+        }
+    }
+};
+
+// Camera for culling.  Matrices are column major, as in AAPLCameraParams.
+struct AAPLCPUCullParams
+{
+    float   frustumPlanes[6][4];        // World space planes facing into the frustum.
+    float   viewProjectionMatrix[16];
+
+    // Rejects chunks whose normal cone faces away from the camera.  Only enable this for
+    //  geometry rendered with back face culling.
+    bool    cullBackfaces   = false;
+    bool    orthographic    = false;
+    float   cameraPosition[3];          // For perspective cameras.
+    float   viewDirection[3];           // For orthographic cameras.
+
+    // Fills the frustum and matrix from AAPLCameraParams or any type with the same members.
+    template <typename CameraParams>
+    void setCamera(const CameraParams& camera)
+    {
+        for (int i = 0; i < 6; ++i)
+        {
+            frustumPlanes[i][0] = camera.worldFrustumPlanes[i].x;
+            frustumPlanes[i][1] = camera.worldFrustumPlanes[i].y;
+            frustumPlanes[i][2] = camera.worldFrustumPlanes[i].z;
+            frustumPlanes[i][3] = camera.worldFrustumPlanes[i].w;
+        }
+
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+                viewProjectionMatrix[c * 4 + r] = camera.viewProjectionMatrix.columns[c][r];
+    }
+};
+
+// Hierarchical depth buffer holding the farthest depth of each texel, like the depth pyramid
+//  built on the GPU.  Level 0 is either copied from a depth buffer or rasterized in software
+//  from occluder triangles.
+class AAPLCPUDepthPyramid
+{
+public:
+    void resize(uint32_t width, uint32_t height);
+
+    // Sets level 0 to the far plane.
+    void clear();
+
+    // Copies level 0 from `depth`, which holds `width` * `height` depths in rows.
+    void loadDepth(const float* depth);
+
+    // Copies level 0 to `depth`, which holds `width` * `height` depths in rows.
+    void storeDepth(float* depth) const;
+
+    // Rasterizes occluders into level 0.  `positions` holds world space xyz triples.  Pixels
+    //  are covered when their centers are inside triangles, as on the GPU, and take the
+    //  farthest depth of the triangle, so occluders never hide more than they do on screen.
+    //  Triangles crossing the near plane are skipped.
+    void rasterizeTriangles(const float* positions, const uint32_t* indices, size_t triangleCount,
+                            const float viewProjectionMatrix[16]);
+
+    // Builds the coarser levels from level 0.
+    void build();
+
+    // Returns true if the box is outside the frustum or behind the depths in the pyramid,
+    //  following `chunkOccluded` in AAPLCulling.metal.
+    bool isOccluded(const float boxMin[3], const float boxMax[3], const float viewProjectionMatrix[16]) const;
+
+    uint32_t width() const      { return _width; }
+    uint32_t height() const     { return _height; }
+    uint32_t levelCount() const { return (uint32_t)_levels.size(); }
+
+private:
+    float depth(uint32_t level, uint32_t x, uint32_t y) const;
+
+    uint32_t                        _width = 0;
+    uint32_t                        _height = 0;
+    uint32_t                        _stride = 0;    // Level 0 rows are padded for SIMD stores.
+    std::vector<std::vector<float>> _levels;
+};
+
+// Culls chunks, writing an AAPLCullResult for each.  Spheres are tested against the frustum,
+//  then normal cones if enabled, then boxes against `depthPyramid` if not null.  Uses SSE, AVX2
+//  or NEON when available.
+void AAPLCPUCullChunksBatch(const AAPLCPUCullChunks& chunks, const AAPLCPUCullParams& params,
+                            const AAPLCPUDepthPyramid* depthPyramid, uint8_t* results);
+
+// Scalar version of AAPLCPUCullChunksBatch, producing identical results.
+void AAPLCPUCullChunksScalar(const AAPLCPUCullChunks& chunks, const AAPLCPUCullParams& params,
+                             const AAPLCPUDepthPyramid* depthPyramid, uint8_t* results);
@@ -0,0 +1,803 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of light culling and clustering on the CPU.
+*/
+#include "AAPLCPULightCulling.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "AAPLCPUSIMD.h"
+#include "AAPLTaskPool.h"
+
+#if defined(__APPLE__)
+#include "../Shaders/AAPLShaderTypes.h"
+
+static_assert(AAPLCPULightsPerTile == MAX_LIGHTS_PER_TILE && AAPLCPULightsPerCluster == MAX_LIGHTS_PER_CLUSTER,
+              "Light list capacities don't match AAPLConfig.h");
+static_assert(sizeof(AAPLCPUPointLight) == sizeof(AAPLPointLightCullingData)
+              && sizeof(AAPLCPUSpotLight) == sizeof(AAPLSpotLightCullingData),
+              "Light layouts don't match AAPLShaderTypes.h");
+#endif
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+using namespace AAPLSIMD;
+
+// Runs `task` for every index in [0, count) on the task pool of `params`.
+void parallelFor(const AAPLCPULightCullParams& params, size_t count, const std::function<void(size_t)>& task)
+{
+    AAPLTaskPool& pool = params.taskPool ? *params.taskPool : AAPLTaskPool::shared();
+    pool.parallelFor(count, [&task](size_t index, unsigned) { task(index); });
+}
+
+// Same as `a < b ? a : b`, which the vector `min` follows.
+inline float minf(float a, float b)
+{
+    return a < b ? a : b;
+}
+
+inline float saturate(float f)
+{
+    return std::min(std::max(f, 0.0f), 1.0f);
+}
+
+//------------------------------------------------------------------------------
+// Coarse culling, following AAPLLightCullingShared.h.
+
+// Calculates the view space bounds of a sphere along the X (axis 0) or Y (axis 1) axis,
+//  as getBoundsForAxis.
+void boundsForAxis(int axis, const float center[3], float radius, float nearZ, float upper[3], float lower[3])
+{
+    const bool needsClipping = (center[2] - radius) < nearZ;
+
+    const float az[2] = { center[axis], center[2] };
+    const float lengthSquared = az[0] * az[0] + az[1] * az[1];
+    const float tSquared = lengthSquared - radius * radius;
+
+    float cosTheta = 0, sinTheta = 0;
+    if (tSquared > 0)
+    {
+        const float t       = sqrtf(tSquared);
+        const float cLength = sqrtf(lengthSquared);
+        cosTheta = t / cLength;
+        sinTheta = radius / cLength;
+    }
+
+    float sqrtPart = 0;
+    if (needsClipping)
+    {
+        const float dz = nearZ - az[1];
+        sqrtPart = sqrtf(radius * radius - dz * dz);
+    }
+
+    float bounds[2][2] = {};
+    for (int i = 0; i < 2; ++i)
+    {
+        if (tSquared > 0)
+        {
+            bounds[i][0] = cosTheta * (cosTheta * az[0] + sinTheta * az[1]);
+            bounds[i][1] = cosTheta * (-sinTheta * az[0] + cosTheta * az[1]);
+        }
+
+        if (needsClipping && (tSquared <= 0 || bounds[i][1] < nearZ))
+        {
+            bounds[i][0] = az[0] + sqrtPart;
+            bounds[i][1] = nearZ;
+        }
+
+        sinTheta *= -1;
+        sqrtPart *= -1;
+    }
+
+    for (int c = 0; c < 2; ++c)
+    {
+        upper[c] = c == axis ? bounds[0][0] : 0.0f;
+        lower[c] = c == axis ? bounds[1][0] : 0.0f;
+    }
+    upper[2] = bounds[0][1];
+    lower[2] = bounds[1][1];
+}
+
+// Returns the clip space coordinate `axis` of a view space point.
+inline float project(const float m[16], const float p[3], int axis)
+{
+    const float v = m[axis] * p[0] + m[4 + axis] * p[1] + m[8 + axis] * p[2] + m[12 + axis];
+    const float w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+    return v / w;
+}
+
+// Writes the first tile and tile count in X and Y covered by a light, as LightCoarseCulling.
+void coarseCullLight(const AAPLCPULightCullParams& params, const float posRadius[4], uint16_t* culledBounds)
+{
+    const float r = fabsf(posRadius[3]);
+
+    const float tileDims[2] = { (float)params.width / (float)params.lightCullingTileSize,
+                                (float)params.height / (float)params.lightCullingTileSize };
+
+    uint16_t result[4] = { 0, 0, 0, 0 };
+
+    if ((posRadius[2] + r) > 0)
+    {
+        float xUpper[3], xLower[3], yUpper[3], yLower[3];
+        boundsForAxis(0, posRadius, r, params.nearPlane, xUpper, xLower);
+        boundsForAxis(1, posRadius, r, params.nearPlane, yUpper, yLower);
+
+        // Y is negated to match the space of culling.
+        float boxMin[2] = {  project(params.projectionMatrix, xLower, 0), -project(params.projectionMatrix, yUpper, 1) };
+        float boxMax[2] = {  project(params.projectionMatrix, xUpper, 0), -project(params.projectionMatrix, yLower, 1) };
+
+        if (boxMin[0] < boxMax[0] && boxMin[1] < boxMax[1]
+            && boxMin[0] <  1.0f
+            && boxMin[1] <  1.0f
+            && boxMax[0] > -1.0f
+            && boxMax[1] > -1.0f)
+        {
+            for (int c = 0; c < 2; ++c)
+            {
+                boxMin[c] = saturate(boxMin[c] * 0.5f + 0.5f);
+                boxMax[c] = saturate(boxMax[c] * 0.5f + 0.5f);
+
+                result[c * 2 + 0] = (uint16_t)(boxMin[c] * tileDims[c]);
+                result[c * 2 + 1] = (uint16_t)(ceilf(boxMax[c] * tileDims[c]) - result[c * 2 + 0]);
+            }
+        }
+    }
+
+    std::copy(result, result + 4, culledBounds);
+}
+
+//------------------------------------------------------------------------------
+// Fine culling, following AAPLLightCulling.metal.
+
+struct TileFrustum
+{
+    float   tileMinZ;
+    float   tileMaxZ;
+    float   minZFrustumXY[4];
+    float   maxZFrustumXY[4];
+    float   tileBoundingSphere[4];
+    float   tileBoundingSphereTransparent[4];
+};
+
+// Calculates the frustum of a tile between two depths, as computeTileFrustum.
+TileFrustum computeTileFrustum(const AAPLCPULightCullParams& params, uint32_t x, uint32_t y, float tileMinZ, float tileMaxZ)
+{
+    const float* m = params.projectionMatrix;
+
+    const float tileScale[2]    = { (float)params.width / (float)(2 * params.lightClusteringTileSize),
+                                    (float)params.height / (float)(2 * params.lightClusteringTileSize) };
+    const float tileMinScale[2] = { tileMinZ / m[0], tileMinZ / m[5] };
+    const float tileMaxScale[2] = { tileMaxZ / m[0], tileMaxZ / m[5] };
+    const int32_t group[2]      = { (int32_t)x, (int32_t)y };
+    const float sign[2]         = { -1.0f, 1.0f };
+    const float screenScale[2]  = { 0.5f, -0.5f };
+
+    // Corners in clip space, through screen space and back as without a rasterization rate map.
+    float minClip[2], maxClip[2];
+    for (int c = 0; c < 2; ++c)
+    {
+        minClip[c] = (1.0f - (float)(group[c] - 1) / tileScale[c]) * sign[c];
+        maxClip[c] = (1.0f - (float)(group[c] + 1) / tileScale[c]) * sign[c];
+
+        minClip[c] = (minClip[c] * screenScale[c] + 0.5f) * 2.0f - 1.0f;
+        maxClip[c] = (maxClip[c] * screenScale[c] + 0.5f) * 2.0f - 1.0f;
+    }
+    minClip[1] *= -1.0f;
+    maxClip[1] *= -1.0f;
+
+    TileFrustum f;
+    f.tileMinZ = tileMinZ;
+    f.tileMaxZ = tileMaxZ;
+
+    const float corners[4] = { minClip[0], maxClip[0], minClip[1], maxClip[1] };
+    for (int i = 0; i < 4; ++i)
+    {
+        f.minZFrustumXY[i] = corners[i] * tileMinScale[i / 2];
+        f.maxZFrustumXY[i] = corners[i] * tileMaxScale[i / 2];
+    }
+
+    const float minZCenter[3] = { (f.minZFrustumXY[0] + f.minZFrustumXY[1]) / 2, (f.minZFrustumXY[2] + f.minZFrustumXY[3]) / 2, tileMinZ };
+    const float maxZCenter[3] = { (f.maxZFrustumXY[0] + f.maxZFrustumXY[1]) / 2, (f.maxZFrustumXY[2] + f.maxZFrustumXY[3]) / 2, tileMaxZ };
+
+    // The kernel derives the XY extent from the far corners only.
+    const auto boundingSphere = [&](const float center[3], float halfDepth, float sphere[4])
+    {
+        float offset[3];
+        for (int c = 0; c < 2; ++c)
+            offset[c] = std::max(fabsf(f.maxZFrustumXY[c * 2] - center[c]), fabsf(f.maxZFrustumXY[c * 2 + 1] - center[c]));
+        offset[2] = halfDepth;
+
+        sphere[0] = center[0];
+        sphere[1] = center[1];
+        sphere[2] = center[2];
+        sphere[3] = sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+    };
+
+    float tileCenter[3];
+    for (int c = 0; c < 3; ++c)
+        tileCenter[c] = (minZCenter[c] + maxZCenter[c]) / 2;
+    boundingSphere(tileCenter, (tileMaxZ - tileMinZ) / 2, f.tileBoundingSphere);
+
+    // Sphere for transparent geometry, from the near plane.
+    for (int c = 0; c < 3; ++c)
+        tileCenter[c] = maxZCenter[c] / 2;
+    boundingSphere(tileCenter, tileMaxZ / 2, f.tileBoundingSphereTransparent);
+
+    return f;
+}
+
+// Frustum to test lights against: the tile's, or for transparent geometry the same with the
+//  near plane at 0, as intersectsFrustumTile selects.
+struct FrustumTest
+{
+    float   sphere[4];
+    float   minZFrustumXY[4];
+    float   maxZFrustumXY[4];
+    float   tileMinZ;
+    float   tileMaxZ;
+
+    FrustumTest(const TileFrustum& f, bool transparent)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            sphere[i]        = transparent ? f.tileBoundingSphereTransparent[i] : f.tileBoundingSphere[i];
+            minZFrustumXY[i] = transparent ? 0.0f : f.minZFrustumXY[i];
+            maxZFrustumXY[i] = f.maxZFrustumXY[i];
+        }
+        tileMinZ = transparent ? 0.0f : f.tileMinZ;
+        tileMaxZ = f.tileMaxZ;
+    }
+};
+
+// Separating axis test of the frustum against a light's bounding sphere, along the
+//  direction from the light to the tile's bounding sphere.  A light centered on the tile
+//  has no direction and is kept.
+bool intersectsFrustum(const FrustumTest& t, const float pos[3], float r)
+{
+    float n[3] = { t.sphere[0] - pos[0], t.sphere[1] - pos[1], t.sphere[2] - pos[2] };
+
+    const float lengthSquared = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+    const float invLength = lengthSquared > 0 ? 1.0f / sqrtf(lengthSquared) : 0.0f;
+    for (float& c : n)
+        c = c * invLength;
+
+    float minD1 = -(n[0] * pos[0] + n[1] * pos[1] + n[2] * pos[2]);
+    float minD2 = minD1;
+    minD1 = minD1 + minf(n[0] * t.minZFrustumXY[0], n[0] * t.minZFrustumXY[1]);
+    minD1 = minD1 + minf(n[1] * t.minZFrustumXY[2], n[1] * t.minZFrustumXY[3]);
+    minD1 = minD1 + n[2] * t.tileMinZ;
+    minD2 = minD2 + minf(n[0] * t.maxZFrustumXY[0], n[0] * t.maxZFrustumXY[1]);
+    minD2 = minD2 + minf(n[1] * t.maxZFrustumXY[2], n[1] * t.maxZFrustumXY[3]);
+    minD2 = minD2 + n[2] * t.tileMaxZ;
+
+    return minf(minD1, minD2) <= r;
+}
+
+// More accurate cone against sphere test for spot lights, as isLightVisibleFine.
+bool visibleFine(const AAPLCPUPointLight&, const float[4])
+{
+    return true;
+}
+
+bool visibleFine(const AAPLCPUSpotLight& light, const float sphere[4])
+{
+    const float cosAngle = light.dirAndOuterAngle[3];
+    const float sinAngle = sqrtf(1.0f - cosAngle * cosAngle);
+
+    const float v[3] = { sphere[0] - light.posAndHeight[0], sphere[1] - light.posAndHeight[1], sphere[2] - light.posAndHeight[2] };
+    const float vLengthSquared = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    const float v1Length = v[0] * light.dirAndOuterAngle[0] + v[1] * light.dirAndOuterAngle[1] + v[2] * light.dirAndOuterAngle[2];
+    const float distanceClosestPoint = cosAngle * sqrtf(vLengthSquared - v1Length * v1Length) - v1Length * sinAngle;
+
+    const bool angleCull = distanceClosestPoint > sphere[3];
+    const bool frontCull = v1Length > sphere[3] + light.posAndHeight[3];
+    const bool backCull  = v1Length < -sphere[3];
+    return !(angleCull || frontCull || backCull);
+}
+
+template <typename Light>
+bool intersectsFrustumTile(const Light& light, const FrustumTest& t)
+{
+    return intersectsFrustum(t, light.posRadius, fabsf(light.posRadius[3])) && visibleFine(light, t.sphere);
+}
+
+// Light list being filled, with its count in the first byte.
+struct LightList
+{
+    uint8_t*    indices;
+    uint32_t    capacity;
+    uint32_t    count;
+
+    LightList(uint8_t* indices, uint32_t capacity)
+        : indices(indices)
+        , capacity(capacity)
+        , count(0)
+    {
+    }
+
+    void push_back(uint32_t index)
+    {
+        if (count + 1 < capacity)
+            indices[count + 1] = (uint8_t)index;
+        ++count;
+    }
+
+    ~LightList()
+    {
+        indices[0] = (uint8_t)std::min(count, capacity - 1);
+    }
+};
+
+//------------------------------------------------------------------------------
+// Vector versions of the fine tests, over lights in structure of arrays layout.
+
+// Lights in structure of arrays layout, padded to whole vectors with lights that are never
+//  visible.
+struct LightArrays
+{
+    std::vector<uint32_t>   index;
+    std::vector<float>      x, y, z, r, transparent;
+    std::vector<float>      tileBeginX, tileEndX;       // Coarse bounds, as floats.
+
+    // Spot lights only.
+    std::vector<float>      apexX, apexY, apexZ, height, dirX, dirY, dirZ, cosAngle;
+
+    size_t size() const { return index.size(); }
+
+    void clear()
+    {
+        index.clear();
+        for (std::vector<float>* array : { &x, &y, &z, &r, &transparent, &tileBeginX, &tileEndX,
+                                           &apexX, &apexY, &apexZ, &height, &dirX, &dirY, &dirZ, &cosAngle })
+            array->clear();
+    }
+
+    void push_back(uint32_t i, const float posRadius[4], const uint16_t* coarse)
+    {
+        index.push_back(i);
+        x.push_back(posRadius[0]);
+        y.push_back(posRadius[1]);
+        z.push_back(posRadius[2]);
+        r.push_back(fabsf(posRadius[3]));
+        transparent.push_back(posRadius[3] >= 0.0f ? 1.0f : 0.0f);
+        tileBeginX.push_back(coarse ? coarse[0] : 0.0f);
+        tileEndX.push_back(coarse ? (float)coarse[0] + (float)coarse[1] : 0.0f);
+    }
+
+    void push_back(uint32_t i, const AAPLCPUPointLight& light, const uint16_t* coarse)
+    {
+        push_back(i, light.posRadius, coarse);
+    }
+
+    void push_back(uint32_t i, const AAPLCPUSpotLight& light, const uint16_t* coarse)
+    {
+        push_back(i, light.posRadius, coarse);
+        apexX.push_back(light.posAndHeight[0]);
+        apexY.push_back(light.posAndHeight[1]);
+        apexZ.push_back(light.posAndHeight[2]);
+        height.push_back(light.posAndHeight[3]);
+        dirX.push_back(light.dirAndOuterAngle[0]);
+        dirY.push_back(light.dirAndOuterAngle[1]);
+        dirZ.push_back(light.dirAndOuterAngle[2]);
+        cosAngle.push_back(light.dirAndOuterAngle[3]);
+    }
+
+    // Pads with opaque lights behind the camera that cover no tiles.
+    template <typename Light>
+    void pad()
+    {
+        Light hidden = {};
+        hidden.posRadius[2] = -FLT_MAX;
+        hidden.posRadius[3] = -1.0f;
+
+        while (size() % Float::Lanes)
+            push_back(UINT32_MAX, hidden, nullptr);
+    }
+};
+
+inline Float dot(Float ax, Float ay, Float az, Float bx, Float by, Float bz)
+{
+    return ax * bx + ay * by + az * bz;
+}
+
+// Vector intersectsFrustum, for lights [i, i + Float::Lanes).
+inline uint32_t intersectsFrustum(const FrustumTest& t, const LightArrays& lights, size_t i)
+{
+    const Float x = Float::load(&lights.x[i]);
+    const Float y = Float::load(&lights.y[i]);
+    const Float z = Float::load(&lights.z[i]);
+    const Float r = Float::load(&lights.r[i]);
+
+    Float nx = Float::splat(t.sphere[0]) - x;
+    Float ny = Float::splat(t.sphere[1]) - y;
+    Float nz = Float::splat(t.sphere[2]) - z;
+
+    const Float lengthSquared = dot(nx, ny, nz, nx, ny, nz);
+    const Float zero = Float::splat(0.0f);
+    const Float invLength = select(lengthSquared > zero, Float::splat(1.0f) / sqrt(lengthSquared), zero);
+    nx = nx * invLength;
+    ny = ny * invLength;
+    nz = nz * invLength;
+
+    Float minD1 = zero - dot(nx, ny, nz, x, y, z);
+    Float minD2 = minD1;
+    minD1 = minD1 + min(nx * Float::splat(t.minZFrustumXY[0]), nx * Float::splat(t.minZFrustumXY[1]));
+    minD1 = minD1 + min(ny * Float::splat(t.minZFrustumXY[2]), ny * Float::splat(t.minZFrustumXY[3]));
+    minD1 = minD1 + nz * Float::splat(t.tileMinZ);
+    minD2 = minD2 + min(nx * Float::splat(t.maxZFrustumXY[0]), nx * Float::splat(t.maxZFrustumXY[1]));
+    minD2 = minD2 + min(ny * Float::splat(t.maxZFrustumXY[2]), ny * Float::splat(t.maxZFrustumXY[3]));
+    minD2 = minD2 + nz * Float::splat(t.tileMaxZ);
+
+    return bits(min(minD1, minD2) <= r);
+}
+
+// Vector visibleFine, for lights [i, i + Float::Lanes).
+inline uint32_t visibleFine(const AAPLCPUPointLight*, const LightArrays&, size_t, const float[4])
+{
+    return (1u << Float::Lanes) - 1;
+}
+
+inline uint32_t visibleFine(const AAPLCPUSpotLight*, const LightArrays& lights, size_t i, const float sphere[4])
+{
+    const Float cosAngle = Float::load(&lights.cosAngle[i]);
+    const Float sinAngle = sqrt(Float::splat(1.0f) - cosAngle * cosAngle);
+
+    const Float vx = Float::splat(sphere[0]) - Float::load(&lights.apexX[i]);
+    const Float vy = Float::splat(sphere[1]) - Float::load(&lights.apexY[i]);
+    const Float vz = Float::splat(sphere[2]) - Float::load(&lights.apexZ[i]);
+
+    const Float vLengthSquared = dot(vx, vy, vz, vx, vy, vz);
+    const Float v1Length = dot(vx, vy, vz, Float::load(&lights.dirX[i]), Float::load(&lights.dirY[i]), Float::load(&lights.dirZ[i]));
+    const Float distanceClosestPoint = cosAngle * sqrt(vLengthSquared - v1Length * v1Length) - v1Length * sinAngle;
+
+    const Float radius = Float::splat(sphere[3]);
+    const Float culled = (distanceClosestPoint > radius)
+                       | (v1Length > radius + Float::load(&lights.height[i]))
+                       | (v1Length < Float::splat(-sphere[3]));
+
+    return ~bits(culled) & ((1u << Float::Lanes) - 1);
+}
+
+// Appends the lights of set bits, lowest first.
+inline void appendLights(LightList& list, const LightArrays& lights, size_t i, uint32_t mask)
+{
+    for (; mask; mask &= mask - 1)
+    {
+        uint32_t lane = 0;
+        while (!(mask & (1u << lane)))
+            ++lane;
+        list.push_back(lights.index[i + lane]);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Culls the lights of one type for a tile, as cullLightList.  `rowLights` holds the lights
+//  whose coarse bounds cover the tile's row.
+template <typename Light>
+void cullTileVectorized(const TileFrustum& frustum, uint32_t x, const LightArrays& rowLights,
+                        LightList& list, LightList& transparentList)
+{
+    const FrustumTest opaque(frustum, false);
+    const FrustumTest transparent(frustum, true);
+
+    const Float tileX   = Float::splat((float)x);
+    const Float minZ    = Float::splat(-frustum.tileMinZ);
+    const Float maxZ    = Float::splat(frustum.tileMaxZ);
+    const Float zero    = Float::splat(0.0f);
+
+    for (size_t i = 0; i < rowLights.size(); i += Float::Lanes)
+    {
+        const Float z = Float::load(&rowLights.z[i]);
+        const Float r = Float::load(&rowLights.r[i]);
+
+        const uint32_t candidates = bits((tileX >= Float::load(&rowLights.tileBeginX[i]))
+                                       & (tileX < Float::load(&rowLights.tileEndX[i]))
+                                       & ((z - r) < maxZ));
+        if (!candidates)
+            continue;
+
+        uint32_t visible = candidates & bits((z + r) > minZ);
+        if (visible)
+            visible &= intersectsFrustum(opaque, rowLights, i) & visibleFine((const Light*)nullptr, rowLights, i, opaque.sphere);
+
+        uint32_t visibleTransparent = candidates & bits(((z + r) > zero) & (Float::load(&rowLights.transparent[i]) > zero));
+        if (visibleTransparent)
+            visibleTransparent &= intersectsFrustum(transparent, rowLights, i) & visibleFine((const Light*)nullptr, rowLights, i, transparent.sphere);
+
+        appendLights(list, rowLights, i, visible);
+        appendLights(transparentList, rowLights, i, visibleTransparent);
+    }
+}
+
+template <typename Light>
+void cullTileScalar(const TileFrustum& frustum, uint32_t x, uint32_t y, const Light* lights, size_t lightCount,
+                    const uint16_t* coarseCulledXY, LightList& list, LightList& transparentList)
+{
+    const FrustumTest opaque(frustum, false);
+    const FrustumTest transparent(frustum, true);
+
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        const float* posRadius = lights[i].posRadius;
+        const bool transparentFlag = posRadius[3] >= 0.0f;
+        const float r = fabsf(posRadius[3]);
+
+        const bool inFrustumMinZ  = (posRadius[2] + r) > -frustum.tileMinZ;
+        const bool inFrustumMaxZ  = (posRadius[2] - r) < frustum.tileMaxZ;
+        const bool inFrustumNearZ = (posRadius[2] + r) > 0;
+
+        const uint16_t* mask = coarseCulledXY + i * 4;
+        if ((uint32_t)(x - mask[0]) < mask[1] && (uint32_t)(y - mask[2]) < mask[3] && inFrustumMaxZ)
+        {
+            if (inFrustumMinZ && intersectsFrustumTile(lights[i], opaque))
+                list.push_back(i);
+
+            if (inFrustumNearZ && transparentFlag && intersectsFrustumTile(lights[i], transparent))
+                transparentList.push_back(i);
+        }
+    }
+}
+
+template <typename Light>
+void cullTileRow(const AAPLCPULightCullParams& params, const float* depthBounds, uint32_t y,
+                 const Light* lights, size_t lightCount, const uint16_t* coarseCulledXY,
+                 uint8_t* indices, uint8_t* transparentIndices, uint32_t tileCountX)
+{
+    LightArrays rowLights;
+    if (params.vectorized)
+    {
+        for (uint32_t i = 0; i < lightCount; ++i)
+        {
+            const uint16_t* mask = coarseCulledXY + i * 4;
+            if ((uint32_t)(y - mask[2]) < mask[3])
+                rowLights.push_back(i, lights[i], mask);
+        }
+        rowLights.pad<Light>();
+    }
+
+    for (uint32_t x = 0; x < tileCountX; ++x)
+    {
+        const size_t tile = (size_t)y * tileCountX + x;
+        const TileFrustum frustum = computeTileFrustum(params, x, y, depthBounds[tile * 2], depthBounds[tile * 2 + 1]);
+
+        LightList list(indices + tile * AAPLCPULightsPerTile, AAPLCPULightsPerTile);
+        LightList transparentList(transparentIndices + tile * AAPLCPULightsPerTile, AAPLCPULightsPerTile);
+
+        if (params.vectorized)
+            cullTileVectorized<Light>(frustum, x, rowLights, list, transparentList);
+        else
+            cullTileScalar(frustum, x, y, lights, lightCount, coarseCulledXY, list, transparentList);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+inline float sliceToZ(const AAPLCPULightCullParams& params, uint32_t slice)
+{
+    if (params.exponentialClusters)
+    {
+        // scatterSliceToZ.
+        const float d = (float)slice / (float)params.clusterDepth;
+        return (exp2f(d * 3.0f) - 1.0f) * (1.0f / 7.0f) * params.clusterRange;
+    }
+
+    const float depthStep = params.clusterRange / (float)params.clusterDepth;
+    return depthStep * (float)slice;
+}
+
+// Gathers the lights of a tile's transparent list for clustering.
+template <typename Light>
+void gatherTileLights(const Light* lights, const uint8_t* transparentIndices, LightArrays& tileLights)
+{
+    tileLights.clear();
+    for (uint32_t i = 0; i < transparentIndices[0]; ++i)
+    {
+        const uint32_t lightIndex = transparentIndices[i + 1];
+        tileLights.push_back(lightIndex, lights[lightIndex], nullptr);
+    }
+    tileLights.pad<Light>();
+}
+
+// Culls the transparent lights of a tile against one of its depth slices, as LightClustering.
+template <typename Light>
+void clusterLights(const AAPLCPULightCullParams& params, const FrustumTest& test, const Light* lights,
+                   const uint8_t* transparentIndices, const LightArrays& tileLights, LightList& list)
+{
+    if (params.vectorized)
+    {
+        const Float minZ = Float::splat(test.tileMinZ);
+        const Float maxZ = Float::splat(test.tileMaxZ);
+        const Float zero = Float::splat(0.0f);
+
+        for (size_t i = 0; i < tileLights.size(); i += Float::Lanes)
+        {
+            const Float z = Float::load(&tileLights.z[i]);
+            const Float r = Float::load(&tileLights.r[i]);
+
+            uint32_t visible = bits(((z - r) <= maxZ) & ((z + r) >= minZ) & (Float::load(&tileLights.transparent[i]) > zero));
+            if (visible)
+                visible &= intersectsFrustum(test, tileLights, i) & visibleFine((const Light*)nullptr, tileLights, i, test.sphere);
+
+            appendLights(list, tileLights, i, visible);
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < transparentIndices[0]; ++i)
+    {
+        const uint32_t lightIndex = transparentIndices[i + 1];
+        const float* posRadius = lights[lightIndex].posRadius;
+        const float r = fabsf(posRadius[3]);
+
+        const bool isInsideCluster = (posRadius[2] - r <= test.tileMaxZ) && (posRadius[2] + r >= test.tileMinZ);
+        if (isInsideCluster && posRadius[3] >= 0.0f && intersectsFrustumTile(lights[lightIndex], test))
+            list.push_back(lightIndex);
+    }
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+void AAPLCPULightCullCreateResult(const AAPLCPULightCullParams& params, size_t pointLightCount, size_t spotLightCount,
+                                  AAPLCPULightCullResult& result)
+{
+    result.tileCountX = (params.width + params.lightCullingTileSize - 1) / params.lightCullingTileSize;
+    result.tileCountY = (params.height + params.lightCullingTileSize - 1) / params.lightCullingTileSize;
+
+    const size_t tileCount = (size_t)result.tileCountX * result.tileCountY;
+
+    result.pointLightIndices.assign(tileCount * AAPLCPULightsPerTile, 0);
+    result.pointLightIndicesTransparent.assign(tileCount * AAPLCPULightsPerTile, 0);
+    result.spotLightIndices.assign(tileCount * AAPLCPULightsPerTile, 0);
+    result.spotLightIndicesTransparent.assign(tileCount * AAPLCPULightsPerTile, 0);
+
+    result.pointLightXYCoarseCullIndices.assign(std::max<size_t>(pointLightCount, 1) * 4, 0);
+    result.spotLightXYCoarseCullIndices.assign(std::max<size_t>(spotLightCount, 1) * 4, 0);
+
+    // Clusters use the light culling tiles, as in createResultInstance.
+    result.tileCountClusterX = result.tileCountX;
+    result.tileCountClusterY = result.tileCountY;
+    result.clusterDepth      = params.clusterDepth;
+
+    const size_t clusterCount = tileCount * params.clusterDepth;
+
+    result.pointLightClusterIndices.assign(clusterCount * AAPLCPULightsPerCluster, 0);
+    result.spotLightClusterIndices.assign(clusterCount * AAPLCPULightsPerCluster, 0);
+}
+
+void AAPLCPULightCullDepthBounds(const AAPLCPULightCullParams& params, const float* linearDepth,
+                                 std::vector<float>& depthBounds)
+{
+    const uint32_t tileSize   = params.lightCullingTileSize;
+    const uint32_t tileCountX = (params.width + tileSize - 1) / tileSize;
+    const uint32_t tileCountY = (params.height + tileSize - 1) / tileSize;
+
+    depthBounds.resize((size_t)tileCountX * tileCountY * 2);
+
+    parallelFor(params, tileCountY, [&](size_t ty)
+    {
+        // Same initial bounds as the kernel's atomics.
+        std::vector<float> bounds(tileCountX * 2);
+        for (uint32_t tx = 0; tx < tileCountX; ++tx)
+        {
+            bounds[tx * 2 + 0] = FLT_MAX;
+            bounds[tx * 2 + 1] = 0.0f;
+        }
+
+        const uint32_t yEnd = std::min((uint32_t)(ty + 1) * tileSize, params.height);
+        for (uint32_t y = (uint32_t)ty * tileSize; y < yEnd; ++y)
+        {
+            const float* row = linearDepth + (size_t)y * params.width;
+            for (uint32_t x = 0; x < params.width; ++x)
+            {
+                float* tile = &bounds[(x / tileSize) * 2];
+                tile[0] = std::min(tile[0], row[x]);
+                tile[1] = std::max(tile[1], row[x]);
+            }
+        }
+
+        std::copy(bounds.begin(), bounds.end(), depthBounds.begin() + ty * tileCountX * 2);
+    });
+}
+
+void AAPLCPULightCullCoarse(const AAPLCPULightCullParams& params,
+                            const AAPLCPUPointLight* pointLights, size_t pointLightCount,
+                            const AAPLCPUSpotLight* spotLights, size_t spotLightCount,
+                            AAPLCPULightCullResult& result)
+{
+    // Batches of lights, as the kernels' threadgroups of 64.
+    const size_t batchSize = 256;
+    const size_t pointBatches = (pointLightCount + batchSize - 1) / batchSize;
+    const size_t spotBatches = (spotLightCount + batchSize - 1) / batchSize;
+
+    parallelFor(params, pointBatches + spotBatches, [&](size_t batch)
+    {
+        const bool spot = batch >= pointBatches;
+        const size_t begin = (spot ? batch - pointBatches : batch) * batchSize;
+        const size_t end = std::min(begin + batchSize, spot ? spotLightCount : pointLightCount);
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (spot)
+                coarseCullLight(params, spotLights[i].posRadius, &result.spotLightXYCoarseCullIndices[i * 4]);
+            else
+                coarseCullLight(params, pointLights[i].posRadius, &result.pointLightXYCoarseCullIndices[i * 4]);
+        }
+    });
+}
+
+void AAPLCPULightCullTiles(const AAPLCPULightCullParams& params, const float* depthBounds,
+                           const AAPLCPUPointLight* pointLights, size_t pointLightCount,
+                           const AAPLCPUSpotLight* spotLights, size_t spotLightCount,
+                           AAPLCPULightCullResult& result)
+{
+    // One job per tile row.
+    parallelFor(params, result.tileCountY, [&](size_t y)
+    {
+        cullTileRow(params, depthBounds, (uint32_t)y, pointLights, pointLightCount, result.pointLightXYCoarseCullIndices.data(),
+                    result.pointLightIndices.data(), result.pointLightIndicesTransparent.data(), result.tileCountX);
+
+        cullTileRow(params, depthBounds, (uint32_t)y, spotLights, spotLightCount, result.spotLightXYCoarseCullIndices.data(),
+                    result.spotLightIndices.data(), result.spotLightIndicesTransparent.data(), result.tileCountX);
+    });
+}
+
+void AAPLCPULightCullClusters(const AAPLCPULightCullParams& params,
+                              const AAPLCPUPointLight* pointLights, size_t,
+                              const AAPLCPUSpotLight* spotLights, size_t,
+                              AAPLCPULightCullResult& result)
+{
+    const size_t sliceStride = (size_t)result.tileCountClusterX * result.tileCountClusterY * AAPLCPULightsPerCluster;
+
+    std::vector<float> sliceZ(params.clusterDepth + 1);
+    for (uint32_t slice = 0; slice <= params.clusterDepth; ++slice)
+        sliceZ[slice] = sliceToZ(params, slice);
+
+    // One job per tile row, covering every slice of its tiles.
+    parallelFor(params, result.tileCountClusterY, [&](size_t y)
+    {
+        LightArrays pointTileLights, spotTileLights;
+
+        for (uint32_t x = 0; x < result.tileCountClusterX; ++x)
+        {
+            const size_t tile = y * result.tileCountClusterX + x;
+
+            const uint8_t* pointIndices = &result.pointLightIndicesTransparent[tile * AAPLCPULightsPerTile];
+            const uint8_t* spotIndices  = &result.spotLightIndicesTransparent[tile * AAPLCPULightsPerTile];
+
+            if (params.vectorized)
+            {
+                gatherTileLights(pointLights, pointIndices, pointTileLights);
+                gatherTileLights(spotLights, spotIndices, spotTileLights);
+            }
+
+            for (uint32_t slice = 0; slice < params.clusterDepth; ++slice)
+            {
+                const size_t cluster = slice * sliceStride + tile * AAPLCPULightsPerCluster;
+
+                LightList pointList(&result.pointLightClusterIndices[cluster], AAPLCPULightsPerCluster);
+                LightList spotList(&result.spotLightClusterIndices[cluster], AAPLCPULightsPerCluster);
+
+                if (!pointIndices[0] && !spotIndices[0])
+                    continue;
+
+                const TileFrustum frustum = computeTileFrustum(params, x, (uint32_t)y, sliceZ[slice], sliceZ[slice + 1]);
+                const FrustumTest test(frustum, false);
+
+                clusterLights(params, test, pointLights, pointIndices, pointTileLights, pointList);
+                clusterLights(params, test, spotLights, spotIndices, spotTileLights, spotList);
+            }
+        }
+    });
+}
@@ -0,0 +1,127 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for culling and clustering lights on the CPU, with the same tests and output
+ buffer layouts as AAPLLightCuller and the light culling kernels.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+class AAPLTaskPool;
+
+// Capacities of the light lists, as MAX_LIGHTS_PER_TILE and MAX_LIGHTS_PER_CLUSTER in
+//  AAPLConfig.h.  The first byte of a list holds its count, so a list holds one light less.
+static const uint32_t AAPLCPULightsPerTile      = 64;
+static const uint32_t AAPLCPULightsPerCluster   = 16;
+
+// Same layout as AAPLPointLightCullingData: the view space bounding sphere, whose radius
+//  is positive for lights that also affect transparent geometry.
+struct AAPLCPUPointLight
+{
+    float   posRadius[4];
+};
+
+// Same layout as AAPLSpotLightCullingData.
+struct AAPLCPUSpotLight
+{
+    float   posRadius[4];
+    float   posAndHeight[4];        // View space position and height of the cone.
+    float   dirAndOuterAngle[4];    // View space direction and cosine of the outer angle.
+};
+
+// View and settings for culling, following the function constants of the kernels.
+struct AAPLCPULightCullParams
+{
+    float       projectionMatrix[16];           // Column major, as in AAPLCameraParams.
+    float       nearPlane;
+
+    uint32_t    width;                          // Physical size of the view in pixels.
+    uint32_t    height;
+
+    uint32_t    lightCullingTileSize    = 32;
+    uint32_t    lightClusteringTileSize = 32;
+
+    // Depth slices of each cluster column, which cover `clusterRange` view space units
+    //  linearly or, as with LOCAL_LIGHT_SCATTERING, with the slices of the scattering volume.
+    uint32_t    clusterDepth            = 64;
+    float       clusterRange            = 100.0f;
+    bool        exponentialClusters     = true;
+
+    // Tests 4 or 8 lights at a time with SIMD instructions when available.  The scalar
+    //  path produces identical lists and serves as a reference.
+    bool        vectorized              = true;
+
+    // Runs the parallel loops; null for AAPLTaskPool::shared().
+    AAPLTaskPool* taskPool              = nullptr;
+
+    // Fills the matrix from AAPLCameraParams or any type with the same members.
+    template <typename CameraParams>
+    void setCamera(const CameraParams& camera)
+    {
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+                projectionMatrix[c * 4 + r] = camera.projectionMatrix.columns[c][r];
+    }
+};
+
+// Same buffers as LightCullResult.  Coarse bounds hold a ushort4 per light: the first tile
+//  and tile count in X, then in Y.  Tile lists hold `AAPLCPULightsPerTile` bytes per tile
+//  in rows; cluster lists hold `AAPLCPULightsPerCluster` bytes per cluster, slice by slice.
+//  Light indices are stored in bytes, as on the GPU.
+struct AAPLCPULightCullResult
+{
+    std::vector<uint16_t>   pointLightXYCoarseCullIndices;
+    std::vector<uint16_t>   spotLightXYCoarseCullIndices;
+
+    std::vector<uint8_t>    pointLightIndices;
+    std::vector<uint8_t>    pointLightIndicesTransparent;
+    std::vector<uint8_t>    spotLightIndices;
+    std::vector<uint8_t>    spotLightIndicesTransparent;
+
+    std::vector<uint8_t>    pointLightClusterIndices;
+    std::vector<uint8_t>    spotLightClusterIndices;
+
+    uint32_t                tileCountX          = 0;
+    uint32_t                tileCountY          = 0;
+
+    uint32_t                tileCountClusterX   = 0;
+    uint32_t                tileCountClusterY   = 0;
+    uint32_t                clusterDepth        = 0;
+};
+
+// Sizes the buffers of `result` for the view and light counts, as createResultInstance.
+void AAPLCPULightCullCreateResult(const AAPLCPULightCullParams& params, size_t pointLightCount, size_t spotLightCount,
+                                  AAPLCPULightCullResult& result);
+
+// Computes the minimum and maximum of `linearDepth`, which holds `width` * `height` view
+//  space depths in rows, over each light culling tile, as the traditional culling kernel.
+//  Writes a min, max pair per tile in rows to `depthBounds`.
+void AAPLCPULightCullDepthBounds(const AAPLCPULightCullParams& params, const float* linearDepth,
+                                 std::vector<float>& depthBounds);
+
+// Projects light bounding spheres to the tiles they cover, as executeCoarseCulling.
+void AAPLCPULightCullCoarse(const AAPLCPULightCullParams& params,
+                            const AAPLCPUPointLight* pointLights, size_t pointLightCount,
+                            const AAPLCPUSpotLight* spotLights, size_t spotLightCount,
+                            AAPLCPULightCullResult& result);
+
+// Culls the coarse culled lights against the frustum of each tile between its depth
+//  bounds, and against the frustum from the near plane for lights affecting transparent
+//  geometry, as executeTraditionalCulling.  Tile rows run in parallel.  Lists are ordered
+//  by light index, where the GPU's are in the order its threads append.
+void AAPLCPULightCullTiles(const AAPLCPULightCullParams& params, const float* depthBounds,
+                           const AAPLCPUPointLight* pointLights, size_t pointLightCount,
+                           const AAPLCPUSpotLight* spotLights, size_t spotLightCount,
+                           AAPLCPULightCullResult& result);
+
+// Culls the transparent lists of each tile against its depth slices, as
+//  executeTraditionalClustering.  Tile rows run in parallel.
+void AAPLCPULightCullClusters(const AAPLCPULightCullParams& params,
+                              const AAPLCPUPointLight* pointLights, size_t pointLightCount,
+                              const AAPLCPUSpotLight* spotLights, size_t spotLightCount,
+                              AAPLCPULightCullResult& result);
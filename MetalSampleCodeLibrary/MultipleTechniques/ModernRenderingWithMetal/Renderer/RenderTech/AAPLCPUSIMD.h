@@ -0,0 +1,170 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the portable float vector used by the CPU culling code and the BC encoder.
+*/
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Keeps the compiler from fusing multiplies and adds in the scalar code of the including
+//  file, so that it rounds exactly like the vector code.  GCC ignores the standard pragma.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace AAPLSIMD
+{
+
+// Vector of `Lanes` floats and the few operations the culling code needs.  Comparisons
+//  return masks with all bits of the lanes set where true.  `min` and `max` return their
+//  second operand when either is NaN, like the SSE instructions and `a < b ? a : b`.
+#if defined(__AVX2__)
+
+struct Float
+{
+    static const uint32_t Lanes = 8;
+
+    __m256 v;
+
+    static Float load(const float* p)               { return { _mm256_loadu_ps(p) }; }
+    static Float splat(float f)                     { return { _mm256_set1_ps(f) }; }
+    static Float ramp()                             { return { _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7) }; }
+    void store(float* p) const                      { _mm256_storeu_ps(p, v); }
+};
+
+inline Float operator+(Float a, Float b)            { return { _mm256_add_ps(a.v, b.v) }; }
+inline Float operator-(Float a, Float b)            { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Float operator*(Float a, Float b)            { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Float operator/(Float a, Float b)            { return { _mm256_div_ps(a.v, b.v) }; }
+inline Float operator&(Float a, Float b)            { return { _mm256_and_ps(a.v, b.v) }; }
+inline Float operator|(Float a, Float b)            { return { _mm256_or_ps(a.v, b.v) }; }
+inline Float operator>=(Float a, Float b)           { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline Float operator>(Float a, Float b)            { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline Float operator<=(Float a, Float b)           { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline Float operator<(Float a, Float b)            { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline Float min(Float a, Float b)                  { return { _mm256_min_ps(a.v, b.v) }; }
+inline Float max(Float a, Float b)                  { return { _mm256_max_ps(a.v, b.v) }; }
+inline Float sqrt(Float a)                          { return { _mm256_sqrt_ps(a.v) }; }
+inline Float select(Float mask, Float a, Float b)   { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+inline uint32_t bits(Float mask)                    { return (uint32_t)_mm256_movemask_ps(mask.v); }
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+struct Float
+{
+    static const uint32_t Lanes = 4;
+
+    __m128 v;
+
+    static Float load(const float* p)               { return { _mm_loadu_ps(p) }; }
+    static Float splat(float f)                     { return { _mm_set1_ps(f) }; }
+    static Float ramp()                             { return { _mm_setr_ps(0, 1, 2, 3) }; }
+    void store(float* p) const                      { _mm_storeu_ps(p, v); }
+};
+
+inline Float operator+(Float a, Float b)            { return { _mm_add_ps(a.v, b.v) }; }
+inline Float operator-(Float a, Float b)            { return { _mm_sub_ps(a.v, b.v) }; }
+inline Float operator*(Float a, Float b)            { return { _mm_mul_ps(a.v, b.v) }; }
+inline Float operator/(Float a, Float b)            { return { _mm_div_ps(a.v, b.v) }; }
+inline Float operator&(Float a, Float b)            { return { _mm_and_ps(a.v, b.v) }; }
+inline Float operator|(Float a, Float b)            { return { _mm_or_ps(a.v, b.v) }; }
+inline Float operator>=(Float a, Float b)           { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline Float operator>(Float a, Float b)            { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline Float operator<=(Float a, Float b)           { return { _mm_cmple_ps(a.v, b.v) }; }
+inline Float operator<(Float a, Float b)            { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline Float min(Float a, Float b)                  { return { _mm_min_ps(a.v, b.v) }; }
+inline Float max(Float a, Float b)                  { return { _mm_max_ps(a.v, b.v) }; }
+inline Float sqrt(Float a)                          { return { _mm_sqrt_ps(a.v) }; }
+inline Float select(Float mask, Float a, Float b)   { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+inline uint32_t bits(Float mask)                    { return (uint32_t)_mm_movemask_ps(mask.v); }
+
+#elif defined(__ARM_NEON)
+
+struct Float
+{
+    static const uint32_t Lanes = 4;
+
+    float32x4_t v;
+
+    static Float load(const float* p)               { return { vld1q_f32(p) }; }
+    static Float splat(float f)                     { return { vdupq_n_f32(f) }; }
+    static Float ramp()                             { const float r[4] = { 0, 1, 2, 3 }; return { vld1q_f32(r) }; }
+    void store(float* p) const                      { vst1q_f32(p, v); }
+};
+
+inline float32x4_t fromMask(uint32x4_t m)           { return vreinterpretq_f32_u32(m); }
+inline uint32x4_t toMask(float32x4_t f)             { return vreinterpretq_u32_f32(f); }
+
+inline Float operator+(Float a, Float b)            { return { vaddq_f32(a.v, b.v) }; }
+inline Float operator-(Float a, Float b)            { return { vsubq_f32(a.v, b.v) }; }
+inline Float operator*(Float a, Float b)            { return { vmulq_f32(a.v, b.v) }; }
+inline Float operator/(Float a, Float b)            { return { vdivq_f32(a.v, b.v) }; }
+inline Float operator&(Float a, Float b)            { return { fromMask(vandq_u32(toMask(a.v), toMask(b.v))) }; }
+inline Float operator|(Float a, Float b)            { return { fromMask(vorrq_u32(toMask(a.v), toMask(b.v))) }; }
+inline Float operator>=(Float a, Float b)           { return { fromMask(vcgeq_f32(a.v, b.v)) }; }
+inline Float operator>(Float a, Float b)            { return { fromMask(vcgtq_f32(a.v, b.v)) }; }
+inline Float operator<=(Float a, Float b)           { return { fromMask(vcleq_f32(a.v, b.v)) }; }
+inline Float operator<(Float a, Float b)            { return { fromMask(vcltq_f32(a.v, b.v)) }; }
+inline Float select(Float mask, Float a, Float b)   { return { vbslq_f32(toMask(mask.v), a.v, b.v) }; }
+inline Float min(Float a, Float b)                  { return select(a < b, a, b); }
+inline Float max(Float a, Float b)                  { return select(a > b, a, b); }
+inline Float sqrt(Float a)                          { return { vsqrtq_f32(a.v) }; }
+
+inline uint32_t bits(Float mask)
+{
+    const int32_t shifts[4] = { -31, -30, -29, -28 };
+    return vaddvq_u32(vshlq_u32(toMask(mask.v), vld1q_s32(shifts)));
+}
+
+#else
+
+// One lane, so that the vector code also builds without SIMD instructions.
+struct Float
+{
+    static const uint32_t Lanes = 1;
+
+    float v;
+
+    static Float load(const float* p)               { return { *p }; }
+    static Float splat(float f)                     { return { f }; }
+    static Float ramp()                             { return { 0.0f }; }
+    void store(float* p) const                      { *p = v; }
+};
+
+inline Float mask(bool b)                           { uint32_t u = b ? ~0u : 0u; float f; memcpy(&f, &u, 4); return { f }; }
+inline uint32_t toBits(Float a)                     { uint32_t u; memcpy(&u, &a.v, 4); return u; }
+inline Float fromBits(uint32_t u)                   { float f; memcpy(&f, &u, 4); return { f }; }
+
+inline Float operator+(Float a, Float b)            { return { a.v + b.v }; }
+inline Float operator-(Float a, Float b)            { return { a.v - b.v }; }
+inline Float operator*(Float a, Float b)            { return { a.v * b.v }; }
+inline Float operator/(Float a, Float b)            { return { a.v / b.v }; }
+inline Float operator&(Float a, Float b)            { return fromBits(toBits(a) & toBits(b)); }
+inline Float operator|(Float a, Float b)            { return fromBits(toBits(a) | toBits(b)); }
+inline Float operator>=(Float a, Float b)           { return mask(a.v >= b.v); }
+inline Float operator>(Float a, Float b)            { return mask(a.v > b.v); }
+inline Float operator<=(Float a, Float b)           { return mask(a.v <= b.v); }
+inline Float operator<(Float a, Float b)            { return mask(a.v < b.v); }
+inline Float min(Float a, Float b)                  { return { a.v < b.v ? a.v : b.v }; }
+inline Float max(Float a, Float b)                  { return { a.v > b.v ? a.v : b.v }; }
+inline Float sqrt(Float a)                          { return { sqrtf(a.v) }; }
+inline Float select(Float mask, Float a, Float b)   { return toBits(mask) ? a : b; }
+inline uint32_t bits(Float mask)                    { return toBits(mask) & 1; }
+
+#endif
+
+} // namespace AAPLSIMD
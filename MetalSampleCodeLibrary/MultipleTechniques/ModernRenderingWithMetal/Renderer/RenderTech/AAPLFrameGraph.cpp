@@ -0,0 +1,512 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the portable frame graph.
+*/
+#include "AAPLFrameGraph.h"
+
+#include <algorithm>
+
+namespace
+{
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+const uint32_t AAPLFrameGraph::InvalidIndex;
+
+uint64_t AAPLFrameGraph::textureBytes(uint32_t width, uint32_t height, uint32_t depth, uint32_t bytesPerPixel,
+                                      bool mipmapped, uint32_t arrayLength, uint64_t alignment)
+{
+    uint64_t size = 0;
+    for (uint32_t mip = 0; ; ++mip)
+    {
+        const uint64_t w = std::max(width >> mip, 1u);
+        const uint64_t h = std::max(height >> mip, 1u);
+        const uint64_t d = std::max(depth >> mip, 1u);
+        size += w * h * d * bytesPerPixel;
+
+        if (!mipmapped || (w == 1 && h == 1 && d == 1))
+            break;
+    }
+
+    return alignUp(size * arrayLength, alignment);
+}
+
+void AAPLFrameGraph::clear()
+{
+    _passes.clear();
+    _resources.clear();
+    _accesses.clear();
+    _schedule.clear();
+    _waits.clear();
+    _levelCount     = 0;
+    _heapSize       = 0;
+    _unaliasedSize  = 0;
+    _slotCount      = 0;
+    _error.clear();
+}
+
+uint32_t AAPLFrameGraph::addTransient(const char* name, uint64_t size, uint64_t alignment)
+{
+    Resource r = { name, ResourceTypeTransient, false, size, std::max<uint64_t>(alignment, 1), Placement() };
+    _resources.push_back(r);
+    return (uint32_t)_resources.size() - 1;
+}
+
+uint32_t AAPLFrameGraph::addMemoryless(const char* name)
+{
+    Resource r = { name, ResourceTypeMemoryless, false, 0, 1, Placement() };
+    _resources.push_back(r);
+    return (uint32_t)_resources.size() - 1;
+}
+
+uint32_t AAPLFrameGraph::importResource(const char* name, bool output)
+{
+    Resource r = { name, ResourceTypeImported, output, 0, 1, Placement() };
+    _resources.push_back(r);
+    return (uint32_t)_resources.size() - 1;
+}
+
+uint32_t AAPLFrameGraph::addPass(const char* name, PassType type)
+{
+    Pass p;
+    p.name          = name;
+    p.type          = type;
+    p.sideEffects   = false;
+    p.signals       = false;
+    p.cost          = 1.0f;
+    p.firstAccess   = (uint32_t)_accesses.size();
+    p.accessCount   = 0;
+    p.scheduleIndex = InvalidIndex;
+    p.level         = 0;
+    p.firstWait     = 0;
+    p.waitCount     = 0;
+    _passes.push_back(std::move(p));
+    return (uint32_t)_passes.size() - 1;
+}
+
+void AAPLFrameGraph::read(uint32_t pass, uint32_t resource)
+{
+    access(pass, resource, true, false);
+}
+
+void AAPLFrameGraph::write(uint32_t pass, uint32_t resource)
+{
+    access(pass, resource, false, true);
+}
+
+void AAPLFrameGraph::modify(uint32_t pass, uint32_t resource)
+{
+    access(pass, resource, true, true);
+}
+
+// Accesses are stored per pass in declaration order, so only the last pass may add them.
+//  Repeated accesses to a resource merge.
+void AAPLFrameGraph::access(uint32_t pass, uint32_t resource, bool read, bool write)
+{
+    if (pass + 1 != _passes.size() || resource >= _resources.size())
+    {
+        if (_error.empty())
+            _error = "Resources must be added to the last pass declared";
+        return;
+    }
+
+    Pass& p = _passes[pass];
+    for (uint32_t i = p.firstAccess; i < p.firstAccess + p.accessCount; ++i)
+    {
+        if (_accesses[i].resource == resource)
+        {
+            _accesses[i].read  |= read;
+            _accesses[i].write |= write;
+            return;
+        }
+    }
+
+    _accesses.push_back({ pass, resource, read, write, InvalidIndex });
+    ++p.accessCount;
+}
+
+bool AAPLFrameGraph::fail(const std::string& message)
+{
+    _error = message;
+    _schedule.clear();
+    return false;
+}
+
+//------------------------------------------------------------------------------
+
+bool AAPLFrameGraph::compile()
+{
+    if (!_error.empty())
+        return fail(_error);
+
+    _schedule.clear();
+    _waits.clear();
+    _levelCount = 0;
+
+    for (Pass& p : _passes)
+    {
+        p.signals       = false;
+        p.scheduleIndex = InvalidIndex;
+        p.level         = 0;
+        p.firstWait     = 0;
+        p.waitCount     = 0;
+    }
+
+    // Find the producer of each read.  A pass reading and writing a resource reads what
+    //  the earlier passes wrote.
+    _lastWriter.assign(_resources.size(), InvalidIndex);
+    for (uint32_t pass = 0; pass < _passes.size(); ++pass)
+    {
+        const Pass& p = _passes[pass];
+
+        for (uint32_t i = p.firstAccess; i < p.firstAccess + p.accessCount; ++i)
+        {
+            Access& a = _accesses[i];
+            if (!a.read)
+                continue;
+
+            a.producer = _lastWriter[a.resource];
+
+            const Resource& r = _resources[a.resource];
+            if (a.producer == InvalidIndex && r.type != ResourceTypeImported)
+                return fail(std::string(p.name) + " reads " + r.name + " before any pass writes it");
+        }
+
+        for (uint32_t i = p.firstAccess; i < p.firstAccess + p.accessCount; ++i)
+            if (_accesses[i].write)
+                _lastWriter[_accesses[i].resource] = pass;
+    }
+
+    cull();
+
+    if (!allocate())
+        return false;
+
+    addDependencies();
+
+    return true;
+}
+
+// Keeps the passes with side effects and those whose results they read, directly or not.
+void AAPLFrameGraph::cull()
+{
+    std::vector<uint32_t>& live = _live;
+    live.assign(_passes.size(), 0);
+
+    _stack.clear();
+    for (uint32_t pass = 0; pass < _passes.size(); ++pass)
+    {
+        const Pass& p = _passes[pass];
+
+        bool root = p.sideEffects;
+        for (uint32_t i = p.firstAccess; i < p.firstAccess + p.accessCount && !root; ++i)
+            root = _accesses[i].write && _resources[_accesses[i].resource].output;
+
+        if (root)
+        {
+            live[pass] = 1;
+            _stack.push_back(pass);
+        }
+    }
+
+    while (!_stack.empty())
+    {
+        const Pass& p = _passes[_stack.back()];
+        _stack.pop_back();
+
+        for (uint32_t i = p.firstAccess; i < p.firstAccess + p.accessCount; ++i)
+        {
+            const uint32_t producer = _accesses[i].producer;
+            if (_accesses[i].read && producer != InvalidIndex && !live[producer])
+            {
+                live[producer] = 1;
+                _stack.push_back(producer);
+            }
+        }
+    }
+
+    for (uint32_t pass = 0; pass < _passes.size(); ++pass)
+    {
+        if (live[pass])
+        {
+            _passes[pass].scheduleIndex = (uint32_t)_schedule.size();
+            _schedule.push_back(pass);
+        }
+    }
+}
+
+// Places transient resources in a heap.  Resources are taken in order of their first use,
+//  larger first, and each goes to the free slot that fits it best: the smallest that is
+//  large enough, or else the largest, which grows.  A slot is free once the last pass
+//  using its current resource has passed.  This colours the interval graph of lifetimes
+//  with as many slots as there are resources alive at once.
+bool AAPLFrameGraph::allocate()
+{
+    _heapSize       = 0;
+    _unaliasedSize  = 0;
+    _slotCount      = 0;
+
+    for (Resource& r : _resources)
+        r.placement = Placement();
+
+    for (uint32_t pass : _schedule)
+    {
+        const Pass& p = _passes[pass];
+        for (uint32_t i = p.firstAccess; i < p.firstAccess + p.accessCount; ++i)
+        {
+            Placement& placement = _resources[_accesses[i].resource].placement;
+            if (placement.firstPass == InvalidIndex)
+                placement.firstPass = p.scheduleIndex;
+            placement.lastPass = p.scheduleIndex;
+        }
+    }
+
+    _stack.clear();
+    for (uint32_t resource = 0; resource < _resources.size(); ++resource)
+    {
+        const Resource& r = _resources[resource];
+        if (r.placement.firstPass == InvalidIndex)
+            continue;
+
+        if (r.type == ResourceTypeMemoryless && r.placement.firstPass != r.placement.lastPass)
+            return fail(std::string("Memoryless ") + r.name + " is used by several passes");
+
+        if (r.type == ResourceTypeTransient)
+            _stack.push_back(resource);
+    }
+
+    std::sort(_stack.begin(), _stack.end(), [this](uint32_t a, uint32_t b)
+    {
+        const Resource& ra = _resources[a];
+        const Resource& rb = _resources[b];
+        if (ra.placement.firstPass != rb.placement.firstPass)
+            return ra.placement.firstPass < rb.placement.firstPass;
+        if (ra.size != rb.size)
+            return ra.size > rb.size;
+        return a < b;
+    });
+
+    _slotLastPass.clear();
+    _slotLastResource.clear();
+    _slotSize.clear();
+    _slotAlignment.clear();
+
+    for (uint32_t resource : _stack)
+    {
+        Resource& r = _resources[resource];
+        _unaliasedSize = alignUp(_unaliasedSize, r.alignment) + r.size;
+
+        uint32_t bestFit = InvalidIndex;
+        uint32_t largest = InvalidIndex;
+        for (uint32_t s = 0; s < _slotLastPass.size(); ++s)
+        {
+            if (_slotLastPass[s] >= r.placement.firstPass)
+                continue;
+
+            if (_slotSize[s] >= r.size && (bestFit == InvalidIndex || _slotSize[s] < _slotSize[bestFit]))
+                bestFit = s;
+            if (largest == InvalidIndex || _slotSize[s] > _slotSize[largest])
+                largest = s;
+        }
+
+        uint32_t slot = bestFit != InvalidIndex ? bestFit : largest;
+        if (slot == InvalidIndex)
+        {
+            slot = (uint32_t)_slotLastPass.size();
+            _slotLastPass.push_back(0);
+            _slotLastResource.push_back(InvalidIndex);
+            _slotSize.push_back(0);
+            _slotAlignment.push_back(1);
+        }
+
+        _slotLastPass[slot]     = r.placement.lastPass;
+        _slotLastResource[slot] = resource;
+        _slotSize[slot]         = std::max(_slotSize[slot], r.size);
+        _slotAlignment[slot]    = std::max(_slotAlignment[slot], r.alignment);
+
+        r.placement.slot = slot;
+        r.placement.size = r.size;
+    }
+
+    // Lay the slots out one after the other.
+    _slotCount = (uint32_t)_slotSize.size();
+    _slotOffset.resize(_slotCount);
+    for (uint32_t s = 0; s < _slotCount; ++s)
+    {
+        _slotOffset[s] = alignUp(_heapSize, _slotAlignment[s]);
+        _heapSize = _slotOffset[s] + _slotSize[s];
+    }
+
+    for (uint32_t resource : _stack)
+    {
+        Placement& placement = _resources[resource].placement;
+        placement.offset = _slotOffset[placement.slot];
+    }
+
+    return true;
+}
+
+// Derives the passes each pass waits for.  A pass depends on the last writer of each
+//  resource it accesses, on the readers since then of the resources it writes, and on the
+//  passes that used the memory of an aliased resource before its first use.
+void AAPLFrameGraph::addDependencies()
+{
+    const uint32_t liveCount = (uint32_t)_schedule.size();
+    const size_t   words     = (liveCount + 63) / 64;
+
+    _ancestors.assign(liveCount * words, 0);
+
+    // Resource holding each slot before each resource, found by replaying the allocation.
+    _previousInSlot.assign(_resources.size(), InvalidIndex);
+    _slotLastResource.assign(_slotCount, InvalidIndex);
+    for (uint32_t resource : _stack)
+    {
+        const uint32_t slot = _resources[resource].placement.slot;
+        _previousInSlot[resource] = _slotLastResource[slot];
+        _slotLastResource[slot] = resource;
+    }
+
+    // Last live writer of each resource and the live readers since, as schedule indices.
+    _lastWriter.assign(_resources.size(), InvalidIndex);
+    _readers.resize(std::max(_readers.size(), _resources.size()));
+    for (std::vector<uint32_t>& readers : _readers)
+        readers.clear();
+
+    for (uint32_t index = 0; index < liveCount; ++index)
+    {
+        Pass& p = _passes[_schedule[index]];
+
+        _dependencies.clear();
+        const auto depend = [&](uint32_t other)
+        {
+            if (other != InvalidIndex && other != index)
+                _dependencies.push_back(other);
+        };
+
+        for (uint32_t i = p.firstAccess; i < p.firstAccess + p.accessCount; ++i)
+        {
+            const Access& a = _accesses[i];
+            depend(_lastWriter[a.resource]);
+
+            if (a.write)
+                for (uint32_t reader : _readers[a.resource])
+                    depend(reader);
+
+            // Aliased memory: wait for every pass using the previous resource in the slot.
+            const Placement& placement = _resources[a.resource].placement;
+            const uint32_t previous = _previousInSlot[a.resource];
+            if (placement.firstPass == index && previous != InvalidIndex)
+            {
+                const Placement& previousPlacement = _resources[previous].placement;
+                for (uint32_t j = previousPlacement.firstPass; j <= previousPlacement.lastPass; ++j)
+                {
+                    const Pass& user = _passes[_schedule[j]];
+                    for (uint32_t k = user.firstAccess; k < user.firstAccess + user.accessCount; ++k)
+                        if (_accesses[k].resource == previous)
+                            depend(j);
+                }
+            }
+        }
+
+        for (uint32_t i = p.firstAccess; i < p.firstAccess + p.accessCount; ++i)
+        {
+            const Access& a = _accesses[i];
+            if (a.write)
+            {
+                _lastWriter[a.resource] = index;
+                _readers[a.resource].clear();
+            }
+            else
+            {
+                _readers[a.resource].push_back(index);
+            }
+        }
+
+        std::sort(_dependencies.begin(), _dependencies.end());
+        _dependencies.erase(std::unique(_dependencies.begin(), _dependencies.end()), _dependencies.end());
+
+        uint64_t* ancestors = &_ancestors[index * words];
+        for (uint32_t d : _dependencies)
+        {
+            const uint64_t* dependencyAncestors = &_ancestors[d * words];
+            for (size_t w = 0; w < words; ++w)
+                ancestors[w] |= dependencyAncestors[w];
+            ancestors[d / 64] |= 1ull << (d % 64);
+
+            p.level = std::max(p.level, _passes[_schedule[d]].level + 1);
+        }
+
+        // Waiting for a dependency also waits for its ancestors, so keep only the
+        //  dependencies no other dependency descends from.
+        p.firstWait = (uint32_t)_waits.size();
+        for (uint32_t d : _dependencies)
+        {
+            bool implied = false;
+            for (uint32_t e : _dependencies)
+            {
+                if (e != d && (_ancestors[e * words + d / 64] >> (d % 64)) & 1)
+                {
+                    implied = true;
+                    break;
+                }
+            }
+
+            if (!implied)
+            {
+                _waits.push_back(_schedule[d]);
+                _passes[_schedule[d]].signals = true;
+            }
+        }
+        p.waitCount = (uint32_t)_waits.size() - p.firstWait;
+
+        _levelCount = std::max(_levelCount, p.level + 1);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void AAPLFrameGraph::encodingGroups(uint32_t maxGroups, std::vector<uint32_t>& groupBegins) const
+{
+    groupBegins.clear();
+    groupBegins.push_back(0);
+
+    if (_schedule.empty())
+        return;
+
+    float totalCost = 0.0f;
+    for (uint32_t pass : _schedule)
+        totalCost += _passes[pass].cost;
+
+    // Cut once the cost so far reaches the next multiple of the average group's cost.
+    const uint32_t groupCount = std::max(1u, std::min(maxGroups, (uint32_t)_schedule.size()));
+    float cost = 0.0f;
+    for (uint32_t index = 0; index + 1 < _schedule.size(); ++index)
+    {
+        cost += _passes[_schedule[index]].cost;
+
+        const uint32_t group = (uint32_t)groupBegins.size();
+        if (group < groupCount && cost >= totalCost * group / groupCount)
+            groupBegins.push_back(index + 1);
+    }
+
+    groupBegins.push_back((uint32_t)_schedule.size());
+}
+
+void AAPLFrameGraph::execute(uint32_t begin, uint32_t end) const
+{
+    for (uint32_t index = begin; index < end && index < _schedule.size(); ++index)
+    {
+        const uint32_t pass = _schedule[index];
+        if (_passes[pass].execute)
+            _passes[pass].execute(pass);
+    }
+}
@@ -0,0 +1,223 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the portable frame graph, which orders the passes of a frame from the resources
+ they read and write, culls passes whose results are unused, and aliases the memory of
+ transient resources whose lifetimes don't overlap.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Passes are declared in submission order together with the resources they access.  A read
+//  depends on the last pass declared before it that writes the resource, so declaration
+//  order is always a valid schedule and compiling never reorders passes.
+//
+// `compile` then:
+//  - keeps passes with side effects or writes to output resources, and the passes producing
+//    what they read, culling the rest;
+//  - measures the lifetime of each transient resource over the remaining passes and assigns
+//    offsets in a single heap, reusing the memory of resources that are no longer used by
+//    interval colouring;
+//  - derives the passes each pass has to wait for, for data hazards and for aliased memory,
+//    reduced to those not already implied by others;
+//  - assigns each pass a level one above its deepest dependency, so that passes of a level
+//    don't depend on each other.
+//
+// The graph knows nothing of the GPU API: sizes are in bytes, and passes record commands
+//  through the functions set with `setExecute`.
+class AAPLFrameGraph
+{
+public:
+    enum PassType : uint8_t
+    {
+        PassTypeRender,
+        PassTypeCompute,
+        PassTypeBlit,
+    };
+
+    enum ResourceType : uint8_t
+    {
+        ResourceTypeTransient,      // Allocated from the graph's heap for part of the frame.
+        ResourceTypeMemoryless,     // Lives in tile memory for the duration of one pass.
+        ResourceTypeImported,       // Owned outside the graph, such as history or the drawable.
+    };
+
+    static const uint32_t InvalidIndex = UINT32_MAX;
+
+    // Place of a transient resource in the heap, and the range of the schedule using it.
+    struct Placement
+    {
+        uint64_t    offset      = 0;
+        uint64_t    size        = 0;
+        uint32_t    slot        = InvalidIndex;     // Resources sharing a slot alias.
+        uint32_t    firstPass   = InvalidIndex;     // Indices into `schedule`.
+        uint32_t    lastPass    = InvalidIndex;
+    };
+
+    // Use of a resource by a pass.
+    struct Access
+    {
+        uint32_t    pass;
+        uint32_t    resource;
+        bool        read;
+        bool        write;
+        uint32_t    producer;               // Last earlier pass writing the resource, for reads.
+    };
+
+    typedef std::function<void(uint32_t pass)> ExecuteFunction;
+
+    // Size of a texture with `mipmapped` holding a full mip chain, rounded up to `alignment`.
+    static uint64_t textureBytes(uint32_t width, uint32_t height, uint32_t depth, uint32_t bytesPerPixel,
+                                 bool mipmapped, uint32_t arrayLength = 1, uint64_t alignment = 65536);
+
+    // Removes all passes and resources, keeping allocations for the next frame's graph.
+    void clear();
+
+    uint32_t addTransient(const char* name, uint64_t size, uint64_t alignment = 65536);
+    uint32_t addMemoryless(const char* name);
+
+    // Writes to outputs are side effects, which keep their passes.
+    uint32_t importResource(const char* name, bool output);
+
+    uint32_t addPass(const char* name, PassType type);
+
+    void read(uint32_t pass, uint32_t resource);
+    void write(uint32_t pass, uint32_t resource);       // Replaces the contents.
+    void modify(uint32_t pass, uint32_t resource);      // Reads, then writes.
+
+    // Keeps a pass whose results are used outside the graph.
+    void setSideEffects(uint32_t pass)                      { _passes[pass].sideEffects = true; }
+
+    // Relative encoding cost of a pass, for `encodingGroups`.
+    void setCost(uint32_t pass, float cost)                 { _passes[pass].cost = cost; }
+
+    void setExecute(uint32_t pass, ExecuteFunction execute) { _passes[pass].execute = std::move(execute); }
+
+    // On failure returns false and sets `error`.
+    bool compile();
+
+    const std::string& error() const                        { return _error; }
+
+    // Passes that survived culling, in submission order.
+    const std::vector<uint32_t>& schedule() const           { return _schedule; }
+
+    bool     isLive(uint32_t pass) const                    { return _passes[pass].scheduleIndex != InvalidIndex; }
+    uint32_t level(uint32_t pass) const                     { return _passes[pass].level; }
+    uint32_t levelCount() const                             { return _levelCount; }
+
+    // Passes that `pass` must wait for before it starts.
+    const uint32_t* waits(uint32_t pass, size_t& count) const
+    {
+        const Pass& p = _passes[pass];
+        count = p.waitCount;
+        return _waits.data() + p.firstWait;
+    }
+
+    // Whether later passes wait for `pass`, which then has to signal its completion.
+    bool signals(uint32_t pass) const                       { return _passes[pass].signals; }
+
+    const Placement& placement(uint32_t resource) const     { return _resources[resource].placement; }
+
+    uint64_t heapSize() const                               { return _heapSize; }
+    uint64_t unaliasedSize() const                          { return _unaliasedSize; }
+    uint32_t slotCount() const                              { return _slotCount; }
+
+    // Splits the schedule into at most `maxGroups` runs of about equal cost.  Each run can be
+    //  encoded on its own thread into a command buffer enqueued in order.  Writes the schedule
+    //  index of the first pass of each run, then the schedule's length, to `groupBegins`.
+    void encodingGroups(uint32_t maxGroups, std::vector<uint32_t>& groupBegins) const;
+
+    // Runs the execute functions of the passes at schedule indices [begin, end).
+    void execute(uint32_t begin, uint32_t end) const;
+    void execute() const                                    { execute(0, (uint32_t)_schedule.size()); }
+
+    uint32_t     passCount() const                          { return (uint32_t)_passes.size(); }
+    uint32_t     resourceCount() const                      { return (uint32_t)_resources.size(); }
+    const char*  passName(uint32_t pass) const              { return _passes[pass].name; }
+    PassType     passType(uint32_t pass) const              { return _passes[pass].type; }
+    const char*  resourceName(uint32_t resource) const      { return _resources[resource].name; }
+    ResourceType resourceType(uint32_t resource) const      { return _resources[resource].type; }
+    bool         isOutput(uint32_t resource) const          { return _resources[resource].output; }
+    uint64_t     resourceSize(uint32_t resource) const      { return _resources[resource].size; }
+    uint64_t     resourceAlignment(uint32_t resource) const { return _resources[resource].alignment; }
+    bool         hasSideEffects(uint32_t pass) const        { return _passes[pass].sideEffects; }
+    float        cost(uint32_t pass) const                  { return _passes[pass].cost; }
+
+    // Resources `pass` accesses, in the order it first declared them.  Producers are set once
+    //  compiled.
+    const Access* accesses(uint32_t pass, size_t& count) const
+    {
+        const Pass& p = _passes[pass];
+        count = p.accessCount;
+        return _accesses.data() + p.firstAccess;
+    }
+
+private:
+    struct Pass
+    {
+        const char*     name;
+        PassType        type;
+        bool            sideEffects;
+        bool            signals;
+        float           cost;
+        uint32_t        firstAccess;        // Range of `_accesses`.
+        uint32_t        accessCount;
+        uint32_t        scheduleIndex;
+        uint32_t        level;
+        uint32_t        firstWait;          // Range of `_waits`.
+        uint32_t        waitCount;
+        ExecuteFunction execute;
+    };
+
+    struct Resource
+    {
+        const char*     name;
+        ResourceType    type;
+        bool            output;
+        uint64_t        size;
+        uint64_t        alignment;
+        Placement       placement;
+    };
+
+    void access(uint32_t pass, uint32_t resource, bool read, bool write);
+    bool fail(const std::string& message);
+
+    void cull();
+    bool allocate();
+    void addDependencies();
+
+    std::vector<Pass>       _passes;
+    std::vector<Resource>   _resources;
+    std::vector<Access>     _accesses;      // In declaration order, so grouped by pass.
+
+    std::vector<uint32_t>   _schedule;
+    std::vector<uint32_t>   _waits;
+    uint32_t                _levelCount     = 0;
+
+    uint64_t                _heapSize       = 0;
+    uint64_t                _unaliasedSize  = 0;
+    uint32_t                _slotCount      = 0;
+
+    std::string             _error;
+
+    // Scratch space reused across compilations.
+    std::vector<uint32_t>               _stack;
+    std::vector<uint32_t>               _live;
+    std::vector<uint32_t>               _lastWriter;
+    std::vector<uint32_t>               _previousInSlot;
+    std::vector<std::vector<uint32_t>>  _readers;
+    std::vector<uint32_t>               _dependencies;
+    std::vector<uint64_t>               _ancestors;     // Bit set of the passes each pass depends on.
+    std::vector<uint32_t>               _slotLastPass;
+    std::vector<uint32_t>               _slotLastResource;
+    std::vector<uint64_t>               _slotSize;
+    std::vector<uint64_t>               _slotAlignment;
+    std::vector<uint64_t>               _slotOffset;
+};
@@ -0,0 +1,332 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the description of the renderer's frame as a frame graph.
+*/
+#include "AAPLRendererFrameGraph.h"
+
+namespace
+{
+
+// Relative encoding cost of passes drawing the scene's meshes, compared with full screen
+//  and compute passes.
+static const float SceneDrawCost = 4.0f;
+
+// Bytes per pixel of the pixel formats the renderer uses.
+static const uint32_t Depth32FloatBytes     = 4;    // DepthStencilFormat.
+static const uint32_t RGBA16FloatBytes      = 8;    // LightingPixelFormat.
+static const uint32_t RGBA8Bytes            = 4;
+static const uint32_t R32FloatBytes         = 4;
+static const uint32_t R8Bytes               = 1;
+
+static const uint64_t BufferAlignment       = 256;
+
+inline uint32_t divideRoundUp(uint32_t value, uint32_t divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+
+} // namespace
+
+bool AAPLRendererFrameGraphOptions::operator==(const AAPLRendererFrameGraphOptions& o) const
+{
+    return physicalWidth == o.physicalWidth && physicalHeight == o.physicalHeight
+        && mainViewWidth == o.mainViewWidth && mainViewHeight == o.mainViewHeight
+        && customMainView == o.customMainView
+        && deferred == o.deferred && clustered == o.clustered && hasTransparentMeshes == o.hasTransparentMeshes
+        && indirect == o.indirect && occlusionCulling == o.occlusionCulling && occluders == o.occluders
+        && shadows == o.shadows && shadowsIndirect == o.shadowsIndirect && shadowOcclusionCulling == o.shadowOcclusionCulling
+        && shadowMapSize == o.shadowMapSize && shadowCascadeCount == o.shadowCascadeCount
+        && singlePassDeferred == o.singlePassDeferred && depthPrepassTileShaders == o.depthPrepassTileShaders
+        && lightCullingTileShaders == o.lightCullingTileShaders && depthDownsampleTileShader == o.depthDownsampleTileShader
+        && ambientObscurance == o.ambientObscurance && scattering == o.scattering
+        && scatteringTileSize == o.scatteringTileSize && scatteringDepth == o.scatteringDepth
+        && temporalAA == o.temporalAA && debugRendering == o.debugRendering && userInterface == o.userInterface
+        && lightCullingTileSize == o.lightCullingTileSize && lightsPerTile == o.lightsPerTile
+        && lightsPerCluster == o.lightsPerCluster && clusterDepth == o.clusterDepth
+        && pointLightCount == o.pointLightCount && spotLightCount == o.spotLightCount;
+}
+
+void AAPLBuildRendererFrameGraph(const AAPLRendererFrameGraphOptions& o, AAPLFrameGraph& graph,
+                                 AAPLRendererFrameGraphPasses& passes)
+{
+    typedef AAPLFrameGraph G;
+
+    graph.clear();
+    passes = AAPLRendererFrameGraphPasses();
+
+    const uint32_t width  = o.physicalWidth;
+    const uint32_t height = o.physicalHeight;
+
+    const uint32_t tileCount    = divideRoundUp(width, o.lightCullingTileSize) * divideRoundUp(height, o.lightCullingTileSize);
+    const uint32_t clusterCount = tileCount * o.clusterDepth;
+
+    const bool tileShaderPrepass = o.depthPrepassTileShaders || o.lightCullingTileShaders;
+
+    // Resources.
+    //--------------
+
+    const uint32_t backBuffer   = graph.importResource("Drawable", true);
+    const uint32_t history      = graph.importResource("History", true);
+    const uint32_t mainViewICB  = graph.importResource("Main View ICB", false);
+    const uint32_t shadowICBs   = graph.importResource("Shadow ICBs", false);
+    const uint32_t spotShadows  = graph.importResource("Spot Shadow Maps", false);
+    const uint32_t scatterHistory = graph.importResource("Scattering History", false);
+
+    const uint32_t depth = graph.addTransient("DepthTexture", G::textureBytes(width, height, 1, Depth32FloatBytes, false));
+    const uint32_t depthPyramid = graph.addTransient("DepthPyramid", G::textureBytes(width / 2, height / 2, 1, R32FloatBytes, true));
+    const uint32_t depthImageblock = graph.addMemoryless("DepthImageblockTexture");
+
+    const uint32_t shadowMap = graph.addTransient("ShadowMap", G::textureBytes(o.shadowMapSize, o.shadowMapSize, 1, Depth32FloatBytes,
+                                                                               false, o.shadowCascadeCount));
+    const uint32_t shadowPyramid = graph.addTransient("ShadowDepthPyramid", G::textureBytes(o.shadowMapSize / 2, o.shadowMapSize / 2, 1,
+                                                                                            R32FloatBytes, true, o.shadowCascadeCount));
+
+    const uint32_t coarseBounds = graph.addTransient("Coarse Light Bounds", (uint64_t)(o.pointLightCount + o.spotLightCount) * 8,
+                                                     BufferAlignment);
+    const uint32_t tileLights = graph.addTransient("Light Indices", (uint64_t)tileCount * o.lightsPerTile * 2, BufferAlignment);
+    const uint32_t transparentTileLights = graph.addTransient("Light Indices Transparent", (uint64_t)tileCount * o.lightsPerTile * 2,
+                                                              BufferAlignment);
+    const uint32_t clusterLights = graph.addTransient("Light Cluster Indices", (uint64_t)clusterCount * o.lightsPerCluster * 2,
+                                                      BufferAlignment);
+
+    const uint32_t saoDepth = graph.addTransient("SAOMippedDepth", G::textureBytes(width / 2, height / 2, 1, R32FloatBytes, true));
+    const uint32_t ao = graph.addTransient("SAOTexture", G::textureBytes(width, height, 1, R8Bytes, false));
+
+    const uint32_t scatterAccum = graph.addTransient("Scattering Volume Accum",
+                                                     G::textureBytes(divideRoundUp(width, o.scatteringTileSize),
+                                                                     divideRoundUp(height, o.scatteringTileSize),
+                                                                     o.scatteringDepth, RGBA16FloatBytes, false));
+
+    // G-buffer textures are memoryless when lighting reads them from tile memory.
+    static const char* const GBufferNames[] = { "Albedo/Alpha", "Normals", "Emissive", "F0/Roughnes" };
+    static const uint32_t GBufferBytes[]    = { RGBA8Bytes, RGBA16FloatBytes, RGBA8Bytes, RGBA8Bytes };
+    uint32_t gBuffer[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        gBuffer[i] = o.singlePassDeferred ? graph.addMemoryless(GBufferNames[i])
+                                          : graph.addTransient(GBufferNames[i], G::textureBytes(width, height, 1, GBufferBytes[i], false));
+    }
+
+    const uint32_t lighting = graph.addTransient("Lighting Buffer", G::textureBytes(width, height, 1, RGBA16FloatBytes, false));
+
+    const uint32_t resolveTarget = o.customMainView
+        ? graph.addTransient("MainViewTexture", G::textureBytes(o.mainViewWidth, o.mainViewHeight, 1, RGBA8Bytes, false))
+        : backBuffer;
+
+    // Passes, in the order `drawInMTKView` encodes them.
+    //--------------
+
+    uint32_t p = passes.coarseLightCulling = graph.addPass("Coarse Light Culling", G::PassTypeCompute);
+    graph.write(p, coarseBounds);
+
+    // The renderer draws occluders whenever they're enabled, but only the depth pyramid of
+    //  occlusion culling reads them, so the graph culls them otherwise.
+    const bool occluderDepth = o.occluders && o.indirect && o.occlusionCulling;
+    if (o.occluders)
+    {
+        p = passes.occluders = graph.addPass("Occluders", G::PassTypeRender);
+        graph.write(p, depth);
+    }
+
+    if (o.indirect)
+    {
+        p = passes.mainViewCulling = graph.addPass("ICBMainViewEncoder", G::PassTypeCompute);
+        if (occluderDepth)
+        {
+            graph.read(p, depth);
+            graph.write(p, depthPyramid);
+        }
+        graph.write(p, mainViewICB);
+    }
+
+    if (o.shadows && o.shadowsIndirect)
+    {
+        if (o.shadowOcclusionCulling)
+        {
+            p = passes.shadowOccluders = graph.addPass("Shadow Occluders", G::PassTypeRender);
+            graph.write(p, shadowMap);
+        }
+
+        p = passes.shadowCulling = graph.addPass("ICBShadowEncoder", G::PassTypeCompute);
+        if (o.shadowOcclusionCulling)
+        {
+            graph.read(p, shadowMap);
+            graph.write(p, shadowPyramid);
+        }
+        graph.write(p, shadowICBs);
+    }
+
+    // Depth prepass, which culls lights and downsamples depth in tile shaders when it can.
+    p = passes.depthPrepass = graph.addPass(o.lightCullingTileShaders ? "DepthPrepass+LightCulling" : "DepthPrepass",
+                                            G::PassTypeRender);
+    graph.setCost(p, SceneDrawCost);
+    graph.write(p, depth);
+    if (o.indirect)
+        graph.read(p, mainViewICB);
+    if (tileShaderPrepass)
+        graph.write(p, depthImageblock);
+    if (o.lightCullingTileShaders)
+    {
+        graph.read(p, coarseBounds);
+        graph.write(p, tileLights);
+        graph.write(p, transparentTileLights);
+        if (o.clustered)
+            graph.write(p, clusterLights);
+    }
+    const bool tileDownsample = o.ambientObscurance && o.depthDownsampleTileShader && tileShaderPrepass;
+    if (tileDownsample)
+        graph.write(p, saoDepth);
+
+    if (o.ambientObscurance)
+    {
+        p = passes.depthDownsample = graph.addPass("Mipped Depth Downsample", G::PassTypeCompute);
+        if (tileDownsample)
+        {
+            graph.modify(p, saoDepth);
+        }
+        else
+        {
+            graph.read(p, depth);
+            graph.write(p, saoDepth);
+        }
+
+        p = passes.ambientObscurance = graph.addPass("Ambient Obscurance", G::PassTypeCompute);
+        graph.read(p, depth);
+        graph.read(p, saoDepth);
+        graph.write(p, ao);
+    }
+
+    if (!o.lightCullingTileShaders)
+    {
+        p = passes.lightCulling = graph.addPass("Light Culling", G::PassTypeCompute);
+        graph.read(p, depth);
+        graph.read(p, coarseBounds);
+        graph.write(p, tileLights);
+        graph.write(p, transparentTileLights);
+
+        if (o.clustered)
+        {
+            p = passes.lightClustering = graph.addPass("Light Clustering", G::PassTypeCompute);
+            graph.read(p, coarseBounds);
+            graph.read(p, transparentTileLights);
+            graph.write(p, clusterLights);
+        }
+    }
+
+    if (o.shadows)
+    {
+        p = passes.shadows = graph.addPass("Shadows", G::PassTypeRender);
+        graph.setCost(p, SceneDrawCost);
+        graph.write(p, shadowMap);
+        if (o.shadowsIndirect)
+            graph.read(p, shadowICBs);
+    }
+
+    const uint32_t transparentLights = o.clustered ? clusterLights : transparentTileLights;
+
+    if (o.scattering)
+    {
+        p = passes.scattering = graph.addPass("Scattering", G::PassTypeCompute);
+        if (o.shadows)
+            graph.read(p, shadowMap);
+        graph.read(p, spotShadows);
+        graph.read(p, transparentLights);
+        graph.modify(p, scatterHistory);
+        graph.write(p, scatterAccum);
+    }
+
+    // Reads the lighting inputs other than the G-buffer.
+    const auto readLightingInputs = [&](uint32_t pass)
+    {
+        graph.read(pass, tileLights);
+        graph.read(pass, spotShadows);
+        if (o.shadows)
+            graph.read(pass, shadowMap);
+        if (o.scattering)
+            graph.read(pass, scatterAccum);
+        if (o.ambientObscurance)
+            graph.read(pass, ao);
+    };
+
+    if (o.deferred)
+    {
+        // With single pass deferred lighting, one encoder fills the G-buffer in tile memory
+        //  and lights it.
+        p = passes.gBuffer = passes.lighting = graph.addPass(o.singlePassDeferred ? "GBuffer+Lighting Pass" : "GBuffer Pass",
+                                                             G::PassTypeRender);
+        graph.setCost(p, SceneDrawCost);
+        graph.modify(p, depth);
+        if (o.indirect)
+            graph.read(p, mainViewICB);
+        for (uint32_t texture : gBuffer)
+            graph.write(p, texture);
+
+        if (!o.singlePassDeferred)
+        {
+            p = passes.lighting = graph.addPass("LightingPassEncoder", G::PassTypeRender);
+            for (uint32_t texture : gBuffer)
+                graph.read(p, texture);
+            graph.read(p, depth);
+        }
+        readLightingInputs(p);
+        graph.write(p, lighting);
+    }
+
+    if (!o.deferred || o.hasTransparentMeshes)
+    {
+        p = passes.forward = graph.addPass("Forward Pass", G::PassTypeRender);
+        graph.setCost(p, o.deferred ? 1.0f : SceneDrawCost);
+        if (o.deferred)
+        {
+            graph.read(p, depth);
+            graph.modify(p, lighting);
+        }
+        else
+        {
+            graph.modify(p, depth);
+            graph.write(p, lighting);
+        }
+        if (o.indirect)
+            graph.read(p, mainViewICB);
+        readLightingInputs(p);
+        if (o.hasTransparentMeshes)
+            graph.read(p, transparentLights);
+    }
+
+    p = passes.resolve = graph.addPass("ResolvePassEncoder", G::PassTypeRender);
+    graph.read(p, lighting);
+    graph.read(p, depth);
+    if (o.temporalAA)
+        graph.read(p, history);
+    graph.write(p, resolveTarget);
+
+    if (o.temporalAA)
+    {
+        p = passes.copyHistory = graph.addPass("CopyHistoryEncoder", G::PassTypeBlit);
+        graph.read(p, resolveTarget);
+        graph.write(p, history);
+    }
+
+    if (o.debugRendering)
+    {
+        p = passes.debug = graph.addPass("Debug", G::PassTypeRender);
+        graph.read(p, depth);
+        graph.read(p, tileLights);
+        graph.modify(p, resolveTarget);
+    }
+
+    if (o.userInterface)
+    {
+        p = passes.userInterface = graph.addPass("UI", G::PassTypeRender);
+        graph.modify(p, resolveTarget);
+    }
+
+    if (o.customMainView)
+    {
+        p = passes.copyToBackBuffer = graph.addPass("CopyResolveToBackbuffer", G::PassTypeRender);
+        graph.read(p, resolveTarget);
+        graph.write(p, backBuffer);
+    }
+}
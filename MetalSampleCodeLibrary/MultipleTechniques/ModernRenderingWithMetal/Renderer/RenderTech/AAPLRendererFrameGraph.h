@@ -0,0 +1,97 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the description of the renderer's frame as a frame graph.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include "AAPLFrameGraph.h"
+
+// Settings of the renderer that change the passes of its frame, following AAPLConfig and
+//  the feature defines of AAPLConfig.h.
+struct AAPLRendererFrameGraphOptions
+{
+    // Size of the rendering, which rasterization rate maps shrink from the main view's size.
+    uint32_t    physicalWidth               = 1920;
+    uint32_t    physicalHeight              = 1080;
+    uint32_t    mainViewWidth               = 1920;
+    uint32_t    mainViewHeight              = 1080;
+    bool        customMainView              = false;    // Renders to a texture smaller than the drawable.
+
+    bool        deferred                    = true;
+    bool        clustered                   = true;     // AAPLLightingModeDeferredClustered.
+    bool        hasTransparentMeshes        = true;
+
+    bool        indirect                    = true;     // AAPLRenderModeIndirect for the main view.
+    bool        occlusionCulling            = true;     // AAPLRenderCullTypeFrustumDepth.
+    bool        occluders                   = true;
+
+    bool        shadows                     = true;
+    bool        shadowsIndirect             = true;
+    bool        shadowOcclusionCulling      = true;
+    uint32_t    shadowMapSize               = 1024;
+    uint32_t    shadowCascadeCount          = 3;
+
+    bool        singlePassDeferred          = false;
+    bool        depthPrepassTileShaders     = false;
+    bool        lightCullingTileShaders     = false;
+    bool        depthDownsampleTileShader   = false;
+
+    bool        ambientObscurance           = true;
+    bool        scattering                  = true;
+    uint32_t    scatteringTileSize          = 8;
+    uint32_t    scatteringDepth             = 64;
+
+    bool        temporalAA                  = true;
+    bool        debugRendering              = false;
+    bool        userInterface               = false;
+
+    uint32_t    lightCullingTileSize        = 32;
+    uint32_t    lightsPerTile               = 64;
+    uint32_t    lightsPerCluster            = 16;
+    uint32_t    clusterDepth                = 64;
+    uint32_t    pointLightCount             = 100;
+    uint32_t    spotLightCount              = 31;
+
+    // Whether the options declare the same graph, so that the renderer rebuilds it only when
+    //  its configuration changes.
+    bool operator==(const AAPLRendererFrameGraphOptions& other) const;
+    bool operator!=(const AAPLRendererFrameGraphOptions& other) const { return !(*this == other); }
+};
+
+// Indices in the graph of the passes `drawInMTKView` encodes, or `InvalidIndex` for those the
+//  options leave out.  With a single pass deferred G-buffer, `lighting` is the G-buffer pass.
+struct AAPLRendererFrameGraphPasses
+{
+    uint32_t    coarseLightCulling          = AAPLFrameGraph::InvalidIndex;
+    uint32_t    occluders                   = AAPLFrameGraph::InvalidIndex;
+    uint32_t    mainViewCulling             = AAPLFrameGraph::InvalidIndex;
+    uint32_t    shadowOccluders             = AAPLFrameGraph::InvalidIndex;
+    uint32_t    shadowCulling               = AAPLFrameGraph::InvalidIndex;
+    uint32_t    depthPrepass                = AAPLFrameGraph::InvalidIndex;
+    uint32_t    depthDownsample             = AAPLFrameGraph::InvalidIndex;
+    uint32_t    ambientObscurance           = AAPLFrameGraph::InvalidIndex;
+    uint32_t    lightCulling                = AAPLFrameGraph::InvalidIndex;
+    uint32_t    lightClustering             = AAPLFrameGraph::InvalidIndex;
+    uint32_t    shadows                     = AAPLFrameGraph::InvalidIndex;
+    uint32_t    scattering                  = AAPLFrameGraph::InvalidIndex;
+    uint32_t    gBuffer                     = AAPLFrameGraph::InvalidIndex;
+    uint32_t    lighting                    = AAPLFrameGraph::InvalidIndex;
+    uint32_t    forward                     = AAPLFrameGraph::InvalidIndex;
+    uint32_t    resolve                     = AAPLFrameGraph::InvalidIndex;
+    uint32_t    copyHistory                 = AAPLFrameGraph::InvalidIndex;
+    uint32_t    debug                       = AAPLFrameGraph::InvalidIndex;
+    uint32_t    userInterface               = AAPLFrameGraph::InvalidIndex;
+    uint32_t    copyToBackBuffer            = AAPLFrameGraph::InvalidIndex;
+};
+
+// Clears `graph` and declares the passes `drawInMTKView` encodes for `options`, with the
+//  textures and buffers each reads and writes, and sets `passes` to their indices.  Textures
+//  the renderer creates at each resize are transient, except for those rendered in tile
+//  memory, which are memoryless; history, cached shadow maps, indirect command buffers and
+//  the drawable are imported.
+void AAPLBuildRendererFrameGraph(const AAPLRendererFrameGraphOptions& options, AAPLFrameGraph& graph,
+                                 AAPLRendererFrameGraphPasses& passes);
@@ -0,0 +1,107 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the pool of worker threads that runs the sample's parallel CPU loops.
+*/
+#include "AAPLTaskPool.h"
+
+#include <algorithm>
+
+AAPLTaskPool::AAPLTaskPool(unsigned threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    _ranges = std::vector<Range>(threadCount);
+
+    for (unsigned t = 1; t < threadCount; ++t)
+        _threads.emplace_back([this, t]() { workerMain(t); });
+}
+
+AAPLTaskPool::~AAPLTaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wake.notify_all();
+
+    for (std::thread& thread : _threads)
+        thread.join();
+}
+
+AAPLTaskPool& AAPLTaskPool::shared()
+{
+    static AAPLTaskPool pool;
+    return pool;
+}
+
+void AAPLTaskPool::parallelFor(size_t count, const std::function<void(size_t, unsigned)>& task)
+{
+    // Small loops, and loops that start while the workers are taken, run on this thread.
+    bool idle = false;
+
+    if (count <= 1 || _threads.empty() || !_looping.compare_exchange_strong(idle, true, std::memory_order_acquire))
+    {
+        for (size_t i = 0; i < count; ++i)
+            task(i, 0);
+        return;
+    }
+
+    const unsigned threadCount = (unsigned)_ranges.size();
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        _ranges[t].next.store(count * t / threadCount, std::memory_order_relaxed);
+        _ranges[t].end = count * (t + 1) / threadCount;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &task;
+        _busy = (unsigned)_threads.size();
+        ++_generation;
+    }
+    _wake.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [this]() { return _busy == 0; });
+    _task = nullptr;
+
+    _looping.store(false, std::memory_order_release);
+}
+
+void AAPLTaskPool::runTasks(unsigned thread)
+{
+    const unsigned threadCount = (unsigned)_ranges.size();
+
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        Range& range = _ranges[(thread + i) % threadCount];
+        for (size_t index; (index = range.next.fetch_add(1, std::memory_order_relaxed)) < range.end; )
+            (*_task)(index, thread);
+    }
+}
+
+void AAPLTaskPool::workerMain(unsigned thread)
+{
+    uint64_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&]() { return _quit || _generation != generation; });
+            if (_quit)
+                return;
+            generation = _generation;
+        }
+
+        runTasks(thread);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_busy == 0)
+            _done.notify_one();
+    }
+}
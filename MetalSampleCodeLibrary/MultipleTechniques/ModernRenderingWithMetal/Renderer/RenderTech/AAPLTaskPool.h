@@ -0,0 +1,69 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the pool of worker threads that runs the sample's parallel CPU loops: block
+ decompression, light culling, and the stages of the frame replay.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Workers that start once and wait for parallel loops, which the calling thread joins.
+//  Each thread of a loop owns a contiguous range of the loop's indices and, when it runs
+//  out, steals indices from the ranges of the others.
+class AAPLTaskPool
+{
+public:
+    // Starts `threadCount - 1` workers; 0 for one thread per core.
+    explicit AAPLTaskPool(unsigned threadCount = 0);
+    ~AAPLTaskPool();
+
+    AAPLTaskPool(const AAPLTaskPool&) = delete;
+    AAPLTaskPool& operator=(const AAPLTaskPool&) = delete;
+
+    // The workers and the calling thread.
+    unsigned threadCount() const { return (unsigned)_threads.size() + 1; }
+
+    // Runs `task(index, thread)` for every index in [0, count) and returns once all have
+    //  finished.  `thread` is 0 for the calling thread and below `threadCount()` for the
+    //  workers.  A loop started while another is running, including from inside a task, runs
+    //  on the calling thread alone.
+    void parallelFor(size_t count, const std::function<void(size_t, unsigned)>& task);
+
+    // A pool with one thread per core, started on first use.
+    static AAPLTaskPool& shared();
+
+private:
+    struct alignas(64) Range
+    {
+        std::atomic<size_t>     next;
+        size_t                  end;
+    };
+
+    void runTasks(unsigned thread);
+    void workerMain(unsigned thread);
+
+    std::vector<std::thread>                        _threads;
+    std::vector<Range>                              _ranges;
+
+    // Set for the length of a loop, so that one loop at a time uses the workers.
+    std::atomic<bool>                               _looping    { false };
+
+    std::mutex                                      _mutex;
+    std::condition_variable                         _wake;
+    std::condition_variable                         _done;
+
+    const std::function<void(size_t, unsigned)>*    _task       = nullptr;
+    unsigned                                        _busy       = 0;
+    uint64_t                                        _generation = 0;
+    bool                                            _quit       = false;
+};
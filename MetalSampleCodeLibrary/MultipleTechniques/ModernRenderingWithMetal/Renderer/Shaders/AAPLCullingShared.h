@@ -5,6 +5,12 @@ Abstract:
 Header for types shared between Metal and ObjC mesh culling code.
 */
 
+#ifndef __METAL_VERSION__
+// Metal's `uint`, for the CPU culler on platforms whose system headers don't declare it.
+#include <stdint.h>
+typedef uint32_t uint;
+#endif
+
 // Enum to index the members of the AAPLEncodeArguments argument buffer.
 typedef enum AAPLEncodeArgsIndex
 {
@@ -26,6 +32,7 @@ typedef enum AAPLCullResult
     AAPLCullResultNotCulled                 = 0,
     AAPLCullResultFrustumCulled             = 1,
     AAPLCullResultOcclusionCulled           = 2,
+    AAPLCullResultBackfaceCulled            = 3,    // Only produced by the CPU culler.
 } AAPLCullResult;
 
 #define CULLING_THREADGROUP_SIZE  (128)
@@ -6,43 +6,27 @@ Implementation of mesh and submesh objects used for managing model data.
 */
 
 #import "AAPLMeshData.h"
+#import "AAPLMeshOptimizer.h"
+#import "AAPLObjFile.h"
+#import <string>
 #import <vector>
-#import <unordered_map>
-
-
-// Implement `operator==` to use `AAPLVertexData` as a hash key in an unordered map.
-bool operator==(const AAPLVertexData & lhs, const AAPLVertexData & rhs)
-{
-    return(simd::all(lhs.position == rhs.position) &&
-           simd::all(lhs.normal == rhs.normal) &&
-           simd::all(lhs.texcoord == rhs.texcoord));
-}
-
-// Implement a hash function for `AAPLVertexData` to use it as a key in an unordered map.
-template<> struct std::hash<AAPLVertexData>
-{
-    std::size_t operator()(const AAPLVertexData& k) const
-    {
-        std::size_t hash = 0;
-        for (uint w = 0; w < sizeof(AAPLVertexData) / sizeof(std::size_t); w++)
-            hash ^= (((std::size_t*)&k)[w] ^ (hash << 8) ^ (hash >> 8));
-        return hash;
-    }
-};
 
 @implementation AAPLSubmeshData
 {
     std::vector<uint32_t> _indexVector;
 }
 
-- (void)addIndex:(uint32_t)index
+- (nonnull instancetype)initWithIndices:(const uint32_t *)indices
+                                 count:(NSUInteger)indexCount
+                       baseColorMapURL:(nullable NSURL *)baseColorMapURL
 {
-    _indexVector.push_back(index);
-}
-
-- (void)setBaseColorMapURL:(nullable NSURL *)baseColorMapURL
-{
-    _baseColorMapURL = baseColorMapURL;
+    self = [super init];
+    if(self)
+    {
+        _indexVector.assign(indices, indices + indexCount);
+        _baseColorMapURL = baseColorMapURL;
+    }
+    return self;
 }
 
 - (uint32_t*) indexData
@@ -59,16 +43,8 @@ template<> struct std::hash<AAPLVertexData>
 @implementation AAPLMeshData
 {
     NSMutableDictionary<NSString*, AAPLSubmeshData *> *_submeshes;
-    AAPLSubmeshData *_currentSubmesh;
 
-    std::vector<vector_float3>  _positions;
-    std::vector<vector_float3>  _normals;
-    std::vector<vector_float2>  _texcoords;
     std::vector<AAPLVertexData> _vertices;
-
-    std::unordered_map<AAPLVertexData, uint32_t> _vertexMap;
-
-    NSURL *_OBJURL;
 }
 
 - (NSDictionary<NSString*, AAPLSubmeshData *>*)submeshes
@@ -86,176 +62,68 @@ template<> struct std::hash<AAPLVertexData>
     return &_vertices[0];
 }
 
-- (void)parseMaterialFile:(NSURL*)materialURL
+- (BOOL)parseOBJFile:(NSURL*)URL error:(NSError * __nullable * __nullable)error
 {
-    NSError *error;
-    NSString *fileString = [[NSString alloc] initWithContentsOfURL:materialURL
-                                                          encoding:NSUTF8StringEncoding
-                                                             error:&error];
-
-    if(!fileString)
-    {
-        NSLog(@"Failed to open .mtl file, error: %@.", error);
-        assert(!"Failed to open .mtl file.");
-    }
-
-    NSArray<NSString*> *lines = [fileString componentsSeparatedByString:@"\n"];
-
-    fileString = nil;
-
-    AAPLSubmeshData * currentSubmesh;
-
-    char scannedString[256];
-
-    for(NSString* line in lines)
+    // Parse the file, and the material files it names, on one thread per core.
+    AAPLObjFile file;
+    std::string fileError;
+    if(!file.open(URL.fileSystemRepresentation, 0, fileError))
     {
-        if (sscanf(line.UTF8String, " newmtl %256s", scannedString) == 1)
+        if(error)
         {
-            NSString *materialNameString = [[NSString alloc] initWithUTF8String:scannedString];
-
-            currentSubmesh = [AAPLSubmeshData new];
-
-            _submeshes[materialNameString] = currentSubmesh;
-        }
-        else if (sscanf(line.UTF8String, " map_Kd %256s", scannedString) == 1)
-        {
-            assert(currentSubmesh);
-
-            NSString *textureString = [[NSString alloc] initWithUTF8String:scannedString];
-            NSURL *URL = [_OBJURL URLByDeletingLastPathComponent];
-            URL = [URL URLByAppendingPathComponent:textureString];
-            [currentSubmesh setBaseColorMapURL:URL];
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain
+                                         code:NSFileReadCorruptFileError
+                                     userInfo:@{ NSLocalizedDescriptionKey : @(fileError.c_str()) }];
         }
+        return NO;
     }
-}
-
-- (uint32_t) findIndexOrPushVertex:(const AAPLVertexData &)vertex
-{
-    auto ref = _vertexMap.find(vertex);
 
-    if(ref == _vertexMap.end())
+    // Reorder each submesh's triangles for the vertex cache and overdraw, then reorder the
+    // vertices in the order that the submeshes first use them.
+    std::vector<uint32_t> indices = file.indices();
+    const size_t vertexCount = file.vertices().size();
+    for(const AAPLObjSubmesh &submesh : file.submeshes())
     {
-        _vertexMap.insert(std::pair<AAPLVertexData,uint32_t>(vertex, _vertices.size()));
-        _vertices.push_back(vertex);
-        return (uint32_t)(_vertices.size() - 1);
+        uint32_t *submeshIndices = indices.data() + submesh.firstIndex;
+        AAPLMeshOptimizeVertexCache(submeshIndices, submeshIndices, submesh.indexCount, vertexCount);
+        AAPLMeshOptimizeOverdraw(submeshIndices, submeshIndices, submesh.indexCount,
+                                 file.vertices()[0].position, vertexCount, sizeof(AAPLObjFileVertex),
+                                 AAPLMeshDefaultOverdrawThreshold);
     }
-    else
-    {
-        return ref->second;
-    }
-}
-
-- (void)readLine:(NSString*)line
-{
-    float x = 0.0f;
-    float y = 0.0f;
-    float z = 0.0f;
-    uint ivp[4];  // Position Index
-    uint ivn[4]; // Normal Index
-    uint ivt[4]; // Texture Coordinate Index
 
-    char scannedString[256];
+    std::vector<uint32_t> remap(vertexCount);
+    AAPLMeshOptimizeVertexFetchRemap(remap.data(), indices.data(), indices.size(), vertexCount);
+    AAPLMeshRemapIndices(indices.data(), indices.data(), indices.size(), remap.data());
 
-    if (sscanf(line.UTF8String, " v %f %f %f", &x, &y, &z) == 3)
-    {
-        // If a position is specified
-        _positions.push_back( (vector_float3) {x,y,z} );
-    }
-    else if (sscanf(line.UTF8String, " vt %f %f %f", &x, &y, &z) == 3)
-    {
-        // A texture coordinate is specified
-        _texcoords.push_back( (vector_float2) {x,y} );
-    }
-    else if (sscanf(line.UTF8String, " vn %f %f %f", &x, &y, &z) == 3)
-    {
-        // A normal is specified
-        _normals.push_back( (vector_float3) {x,y,z} );
-    }
-    else if (sscanf(line.UTF8String, " f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-                    &ivp[0], &ivt[0], &ivn[0], &ivp[1],
-                    &ivt[1], &ivn[1], &ivp[2], &ivt[2],
-                    &ivn[2], &ivp[3], &ivt[3], &ivn[3]) == 12)
-    {
-        // If a quad is specified
-        uint32_t indices[4];
-        for (uint v = 0; v < 4; v++)
-        {
-            AAPLVertexData vertex;
-            vertex.position = _positions[ivp[v]-1];
-            vertex.normal   = _normals  [ivn[v]-1];
-            vertex.texcoord = _texcoords[ivt[v]-1];
-            indices[v] = [self findIndexOrPushVertex:vertex];
-        }
-        [_currentSubmesh addIndex:indices[0]];
-        [_currentSubmesh addIndex:indices[1]];
-        [_currentSubmesh addIndex:indices[2]];
-        [_currentSubmesh addIndex:indices[0]];
-        [_currentSubmesh addIndex:indices[2]];
-        [_currentSubmesh addIndex:indices[3]];
-    }
-    else if (sscanf(line.UTF8String, " f %d/%d/%d %d/%d/%d %d/%d/%d",
-                    &ivp[0], &ivt[0], &ivn[0],
-                    &ivp[1], &ivt[1], &ivn[1],
-                    &ivp[2], &ivt[2], &ivn[2]) == 9) // triangle
-    {
-        // If a triangle is specified
-        uint32_t indices[3];
-        for (uint v = 0; v < 3; v++)
-        {
-            AAPLVertexData vertex;
-            vertex.position = _positions[ivp[v]-1];
-            vertex.normal   = _normals  [ivn[v]-1];
-            vertex.texcoord = _texcoords[ivt[v]-1];
-            indices[v] = [self findIndexOrPushVertex:vertex];
-        }
-        [_currentSubmesh addIndex:indices[0]];
-        [_currentSubmesh addIndex:indices[1]];
-        [_currentSubmesh addIndex:indices[2]];
-    }
-    else if (sscanf(line.UTF8String, " mtllib %256s", scannedString) == 1)
+    _vertices.resize(vertexCount);
+    for(size_t index = 0; index < vertexCount; index++)
     {
-        NSString *materialFileNameString = [[NSString alloc] initWithUTF8String:scannedString];
-        NSURL *materialFileURL = [_OBJURL URLByDeletingLastPathComponent];
-        materialFileURL = [materialFileURL URLByAppendingPathComponent:materialFileNameString];
-        [self parseMaterialFile:materialFileURL];
+        const AAPLObjFileVertex &vertex = file.vertices()[index];
+        AAPLVertexData &vertexData = _vertices[remap[index]];
+        vertexData.position = (vector_float3) { vertex.position[0], vertex.position[1], vertex.position[2] };
+        vertexData.normal   = (vector_float3) { vertex.normal[0], vertex.normal[1], vertex.normal[2] };
+        vertexData.texcoord = (vector_float2) { vertex.texcoord[0], vertex.texcoord[1] };
     }
-    else if (sscanf(line.UTF8String, " usemtl %256s", scannedString) == 1)
-    {
-        NSString *materialNameString = [[NSString alloc] initWithUTF8String:scannedString];
-        _currentSubmesh = _submeshes[materialNameString];
-        assert(_currentSubmesh);
-    }
-}
 
-- (void)parseOBJFile
-{
-    NSError *error;
-
-    NSString *fileString = [[NSString alloc] initWithContentsOfURL:_OBJURL
-                                                          encoding:NSUTF8StringEncoding
-                                                             error:&error];
-
-    if(!fileString)
+    // Each material gets a submesh with the triangles that use it.  Base color maps are
+    // relative to the OBJ file.
+    NSURL *directoryURL = [URL URLByDeletingLastPathComponent];
+    for(const AAPLObjSubmesh &submesh : file.submeshes())
     {
-        NSLog(@"Failed to open .obj file, error: %@.", error);
-        assert(!"Failed to open .obj file.");
-    }
+        const AAPLObjMaterial &material = file.materials()[submesh.material];
 
-    NSArray<NSString*> *lines = [fileString componentsSeparatedByString:@"\n"];
-
-    fileString = nil;
+        NSURL *baseColorMapURL = nil;
+        if(!material.diffuseMap.empty())
+        {
+            baseColorMapURL = [directoryURL URLByAppendingPathComponent:@(material.diffuseMap.c_str())];
+        }
 
-    for(NSString* line in lines)
-    {
-        [self readLine:line];
+        _submeshes[@(material.name.c_str())] = [[AAPLSubmeshData alloc] initWithIndices:indices.data() + submesh.firstIndex
+                                                                                   count:submesh.indexCount
+                                                                         baseColorMapURL:baseColorMapURL];
     }
 
-    lines = nil;
-
-    _positions.clear();
-    _texcoords.clear();
-    _normals.clear();
-    _vertexMap.clear();
+    return YES;
 }
 
 - (nullable instancetype)initWithURL:(nonnull NSURL*)URL
@@ -264,11 +132,12 @@ template<> struct std::hash<AAPLVertexData>
     self = [super init];
     if(self)
     {
-        _OBJURL = URL;
-
         _submeshes = [NSMutableDictionary new];
 
-        [self parseOBJFile];
+        if(![self parseOBJFile:URL error:error])
+        {
+            return nil;
+        }
     }
     return self;
 }
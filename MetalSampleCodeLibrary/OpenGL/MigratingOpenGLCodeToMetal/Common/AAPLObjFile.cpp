@@ -0,0 +1,925 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the OBJ reader.
+*/
+
+#include "AAPLObjFile.h"
+
+#include <fcntl.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+
+// Size of the pieces of a file that the threads parse, before moving their ends to the
+//  next line.  The results don't depend on it.
+static const size_t ChunkSize = 1 << 20;
+
+// Marks an attribute that a face vertex doesn't give, and a material the faces haven't named.
+static const uint32_t NoIndex = UINT32_MAX;
+
+static const double PowersOf10[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// The indices of the attributes of one vertex of a face.
+struct Corner
+{
+    uint32_t    position;
+    uint32_t    texcoord;
+    uint32_t    normal;
+
+    bool operator==(const Corner& other) const
+    {
+        return position == other.position && texcoord == other.texcoord && normal == other.normal;
+    }
+};
+
+// Which indices of a corner count back from the attributes before their line.
+enum RelativeIndex : uint8_t
+{
+    RelativePosition    = 1 << 0,
+    RelativeTexcoord    = 1 << 1,
+    RelativeNormal      = 1 << 2,
+};
+
+struct MaterialUse
+{
+    uint32_t    triangle;   // First triangle of the chunk that uses the material.
+    std::string name;
+};
+
+// A piece of the file that one thread parses, and then deduplicates the vertices of.
+struct Chunk
+{
+    const char*                 begin           = nullptr;
+    const char*                 end             = nullptr;
+
+    std::vector<float>          positions;
+    std::vector<float>          normals;
+    std::vector<float>          texcoords;
+
+    // Three corners for each triangle.
+    std::vector<Corner>         corners;
+    std::vector<std::pair<uint32_t, uint8_t>> relativeCorners;
+
+    std::vector<MaterialUse>    materialUses;
+    std::vector<std::string>    materialLibraries;
+    size_t                      faceCount       = 0;
+
+    // The chunk's distinct corners in the order it first uses them, and the one each
+    //  corner uses.
+    std::vector<Corner>         vertices;
+    std::vector<uint32_t>       vertexIndices;
+
+    // The mesh's vertex for each of the chunk's distinct corners.
+    std::vector<uint32_t>       meshVertices;
+
+    const char*                 errorPosition   = nullptr;
+    const char*                 errorMessage    = nullptr;
+};
+
+// A run of a chunk's triangles that use the same material.
+struct MaterialRun
+{
+    uint32_t    material;
+    uint32_t    chunk;
+    uint32_t    firstTriangle;
+    uint32_t    triangleCount;
+    uint32_t    firstIndex;
+};
+
+unsigned resolveThreadCount(unsigned threadCount)
+{
+    return threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void parallelFor(size_t count, unsigned threadCount, const std::function<void(size_t)>& task)
+{
+    threadCount = (unsigned)std::min<size_t>(resolveThreadCount(threadCount), count);
+
+    std::atomic<size_t> next(0);
+    const auto worker = [&]()
+    {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+            task(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < threadCount; t++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+// A hash map from corners to vertex indices that keeps its entries in one array and probes
+//  linearly, which avoids the allocation of each entry of `std::unordered_map`.
+class CornerMap
+{
+public:
+    explicit CornerMap(size_t expectedCount)
+    {
+        size_t capacity = 64;
+        while (capacity < expectedCount * 2)
+            capacity *= 2;
+        _entries.assign(capacity, Entry{ { 0, 0, 0 }, NoIndex });
+    }
+
+    // Returns the index of a corner, adding it with `index` if the map doesn't have it.
+    uint32_t findOrInsert(const Corner& corner, uint32_t index)
+    {
+        if ((_count + 1) * 2 > _entries.size())
+            grow();
+
+        Entry* entry = find(corner);
+        if (entry->index == NoIndex)
+        {
+            entry->corner = corner;
+            entry->index = index;
+            _count++;
+        }
+        return entry->index;
+    }
+
+private:
+    struct Entry
+    {
+        Corner      corner;
+        uint32_t    index;
+    };
+
+    static size_t hash(const Corner& corner)
+    {
+        uint64_t h = corner.position * 0x9E3779B97F4A7C15ull;
+        h ^= (corner.texcoord + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+        h ^= (corner.normal + 0x165667B19E3779F9ull) * 0x85EBCA77C2B2AE63ull;
+        return (size_t)(h ^ (h >> 29));
+    }
+
+    Entry* find(const Corner& corner)
+    {
+        const size_t mask = _entries.size() - 1;
+        for (size_t slot = hash(corner) & mask; ; slot = (slot + 1) & mask)
+        {
+            Entry& entry = _entries[slot];
+            if (entry.index == NoIndex || entry.corner == corner)
+                return &entry;
+        }
+    }
+
+    void grow()
+    {
+        std::vector<Entry> entries(_entries.size() * 2, Entry{ { 0, 0, 0 }, NoIndex });
+        entries.swap(_entries);
+        for (const Entry& entry : entries)
+        {
+            if (entry.index != NoIndex)
+                *find(entry.corner) = entry;
+        }
+    }
+
+    std::vector<Entry>  _entries;
+    size_t              _count  = 0;
+};
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c)
+{
+    return (unsigned)(c - '0') < 10;
+}
+
+inline const char* skipSpaces(const char* p, const char* end)
+{
+    while (p < end && isSpace(*p))
+        p++;
+    return p;
+}
+
+// The rest of a line, without the spaces around it.
+std::string restOfLine(const char* p, const char* end)
+{
+    p = skipSpaces(p, end);
+    while (end > p && isSpace(end[-1]))
+        end--;
+    return std::string(p, end);
+}
+
+// Parses a decimal number.  Numbers of up to 19 significant digits with a power of ten that a
+//  double holds exactly take one multiplication or division, which rounds correctly; others,
+//  and infinities and NaNs, go through `strtof`, so the result always matches it.
+bool parseFloat(const char*& p, const char* end, float& value)
+{
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    bool exact = true;
+
+    for (; p < end && isDigit(*p); p++)
+    {
+        hasDigits = true;
+        if (significantDigits < 19)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            significantDigits += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+            exact &= *p == '0';
+        }
+    }
+
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && isDigit(*p); p++)
+        {
+            hasDigits = true;
+            if (significantDigits < 19)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                significantDigits += mantissa != 0;
+                exponent--;
+            }
+            else
+            {
+                exact &= *p == '0';
+            }
+        }
+    }
+
+    if (hasDigits && p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negativeExponent = *q++ == '-';
+
+        if (q < end && isDigit(*q))
+        {
+            int e = 0;
+            for (; q < end && isDigit(*q); q++)
+                e = std::min(e * 10 + (*q - '0'), 100000);
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    if (hasDigits && (p == end || isSpace(*p)))
+    {
+        const double maxExactMantissa = 9007199254740992.0;   // 2^53
+        if (exact && (double)mantissa <= maxExactMantissa && exponent >= -22 && exponent <= 22)
+        {
+            double result = (double)mantissa;
+            result = exponent < 0 ? result / PowersOf10[-exponent] : result * PowersOf10[exponent];
+
+            // Rounding the double to a float rounds the number the same way, unless the double
+            //  landed halfway between two floats, or outside the range of normal floats.
+            uint64_t bits;
+            memcpy(&bits, &result, sizeof(bits));
+            const bool halfway = (bits & 0x1FFFFFFFull) == 0x10000000ull;
+            if (result == 0.0 || (!halfway && result >= FLT_MIN && result <= FLT_MAX))
+            {
+                value = (float)(negative ? -result : result);
+                return true;
+            }
+        }
+    }
+
+    // Copy the token to terminate it for `strtof`.
+    p = start;
+    while (p < end && !isSpace(*p))
+        p++;
+
+    char token[64];
+    const size_t length = (size_t)(p - start);
+    if (length == 0 || length >= sizeof(token))
+        return false;
+
+    memcpy(token, start, length);
+    token[length] = '\0';
+
+    char* tokenEnd;
+    value = strtof(token, &tokenEnd);
+    return tokenEnd == token + length;
+}
+
+// Parses up to `maxCount` numbers, and fills the rest with zeros.
+int parseFloats(const char*& p, const char* end, float* values, int maxCount)
+{
+    int count = 0;
+    for (p = skipSpaces(p, end); count < maxCount && p < end; p = skipSpaces(p, end))
+    {
+        if (!parseFloat(p, end, values[count]))
+            return -1;
+        count++;
+    }
+
+    for (int i = count; i < maxCount; i++)
+        values[i] = 0.0f;
+    return count;
+}
+
+// Parses an OBJ index, which counts from 1, or back from the end when negative.
+bool parseIndex(const char*& p, const char* end, int64_t& index)
+{
+    bool negative = false;
+    if (p < end && *p == '-')
+    {
+        negative = true;
+        p++;
+    }
+
+    if (p == end || !isDigit(*p))
+        return false;
+
+    int64_t value = 0;
+    for (; p < end && isDigit(*p); p++)
+    {
+        value = value * 10 + (*p - '0');
+        if (value > (int64_t)UINT32_MAX)
+            return false;
+    }
+
+    index = negative ? -value : value;
+    return index != 0;
+}
+
+// Turns an index into one that counts from 0, or for a negative index, from the attributes
+//  before the line in this chunk; the reader adds the attributes of earlier chunks later.
+inline uint32_t resolveIndex(int64_t index, size_t countBefore, uint8_t relativeFlag, uint8_t& relative)
+{
+    if (index > 0)
+        return (uint32_t)(index - 1);
+
+    relative |= relativeFlag;
+    return (uint32_t)((int64_t)countBefore + index);
+}
+
+bool parseChunk(Chunk& chunk)
+{
+    const auto fail = [&](const char* position, const char* message)
+    {
+        chunk.errorPosition = position;
+        chunk.errorMessage = message;
+        return false;
+    };
+
+    std::vector<Corner> polygon;
+    std::vector<uint8_t> polygonRelative;
+
+    for (const char* line = chunk.begin; line < chunk.end; )
+    {
+        const char* lineEnd = (const char*)memchr(line, '\n', (size_t)(chunk.end - line));
+        if (!lineEnd)
+            lineEnd = chunk.end;
+
+        const char* p = skipSpaces(line, lineEnd);
+        const char* keyword = p;
+        while (p < lineEnd && !isSpace(*p))
+            p++;
+        const size_t keywordLength = (size_t)(p - keyword);
+
+        if (keywordLength == 1 && keyword[0] == 'v')
+        {
+            float values[3];
+            if (parseFloats(p, lineEnd, values, 3) < 3)
+                return fail(line, "A position needs three numbers");
+            chunk.positions.insert(chunk.positions.end(), values, values + 3);
+        }
+        else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 'n')
+        {
+            float values[3];
+            if (parseFloats(p, lineEnd, values, 3) < 3)
+                return fail(line, "A normal needs three numbers");
+            chunk.normals.insert(chunk.normals.end(), values, values + 3);
+        }
+        else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 't')
+        {
+            float values[3];
+            if (parseFloats(p, lineEnd, values, 3) < 1)
+                return fail(line, "A texture coordinate needs a number");
+            chunk.texcoords.insert(chunk.texcoords.end(), values, values + 3);
+        }
+        else if (keywordLength == 1 && keyword[0] == 'f')
+        {
+            polygon.clear();
+            polygonRelative.clear();
+
+            // Each corner is `v`, `v/vt`, `v//vn` or `v/vt/vn`.
+            for (p = skipSpaces(p, lineEnd); p < lineEnd; p = skipSpaces(p, lineEnd))
+            {
+                Corner corner = { 0, NoIndex, NoIndex };
+                uint8_t relative = 0;
+                int64_t index;
+
+                if (!parseIndex(p, lineEnd, index))
+                    return fail(line, "A face has a bad position index");
+                corner.position = resolveIndex(index, chunk.positions.size() / 3, RelativePosition, relative);
+
+                if (p < lineEnd && *p == '/')
+                {
+                    p++;
+                    if (p < lineEnd && *p != '/')
+                    {
+                        if (!parseIndex(p, lineEnd, index))
+                            return fail(line, "A face has a bad texture coordinate index");
+                        corner.texcoord = resolveIndex(index, chunk.texcoords.size() / 3, RelativeTexcoord, relative);
+                    }
+
+                    if (p < lineEnd && *p == '/')
+                    {
+                        p++;
+                        if (!parseIndex(p, lineEnd, index))
+                            return fail(line, "A face has a bad normal index");
+                        corner.normal = resolveIndex(index, chunk.normals.size() / 3, RelativeNormal, relative);
+                    }
+                }
+
+                if (p < lineEnd && !isSpace(*p))
+                    return fail(line, "A face has a bad vertex");
+
+                polygon.push_back(corner);
+                polygonRelative.push_back(relative);
+            }
+
+            if (polygon.size() < 3)
+                return fail(line, "A face needs three vertices");
+
+            // Split the polygon into a fan of triangles.
+            for (size_t i = 2; i < polygon.size(); i++)
+            {
+                const size_t triangle[3] = { 0, i - 1, i };
+                for (size_t corner : triangle)
+                {
+                    if (polygonRelative[corner])
+                        chunk.relativeCorners.emplace_back((uint32_t)chunk.corners.size(), polygonRelative[corner]);
+                    chunk.corners.push_back(polygon[corner]);
+                }
+            }
+            chunk.faceCount++;
+        }
+        else if (keywordLength == 6 && !memcmp(keyword, "usemtl", 6))
+        {
+            chunk.materialUses.push_back({ (uint32_t)(chunk.corners.size() / 3), restOfLine(p, lineEnd) });
+        }
+        else if (keywordLength == 6 && !memcmp(keyword, "mtllib", 6))
+        {
+            chunk.materialLibraries.push_back(restOfLine(p, lineEnd));
+        }
+
+        line = lineEnd + 1;
+    }
+    return true;
+}
+
+// Resolves the chunk's relative indices, checks every index, and finds the chunk's
+//  distinct corners.
+bool deduplicateChunk(Chunk& chunk, size_t positionBase, size_t texcoordBase, size_t normalBase,
+                      size_t positionCount, size_t texcoordCount, size_t normalCount)
+{
+    for (const std::pair<uint32_t, uint8_t>& relative : chunk.relativeCorners)
+    {
+        Corner& corner = chunk.corners[relative.first];
+        const int64_t position = (int32_t)corner.position + (int64_t)positionBase;
+        const int64_t texcoord = (int32_t)corner.texcoord + (int64_t)texcoordBase;
+        const int64_t normal = (int32_t)corner.normal + (int64_t)normalBase;
+
+        if (((relative.second & RelativePosition) && position < 0) ||
+            ((relative.second & RelativeTexcoord) && texcoord < 0) ||
+            ((relative.second & RelativeNormal) && normal < 0))
+        {
+            chunk.errorMessage = "A face refers to an attribute before the start of the file";
+            return false;
+        }
+
+        if (relative.second & RelativePosition)
+            corner.position = (uint32_t)position;
+        if (relative.second & RelativeTexcoord)
+            corner.texcoord = (uint32_t)texcoord;
+        if (relative.second & RelativeNormal)
+            corner.normal = (uint32_t)normal;
+    }
+
+    // Most meshes have about one distinct corner for each two triangles.
+    CornerMap map(chunk.corners.size() / 6);
+    chunk.vertexIndices.resize(chunk.corners.size());
+    for (size_t i = 0; i < chunk.corners.size(); i++)
+    {
+        const Corner& corner = chunk.corners[i];
+        if (corner.position >= positionCount ||
+            (corner.texcoord != NoIndex && corner.texcoord >= texcoordCount) ||
+            (corner.normal != NoIndex && corner.normal >= normalCount))
+        {
+            chunk.errorMessage = "A face refers to an attribute that the file doesn't have";
+            return false;
+        }
+
+        const uint32_t index = map.findOrInsert(corner, (uint32_t)chunk.vertices.size());
+        if (index == chunk.vertices.size())
+            chunk.vertices.push_back(corner);
+        chunk.vertexIndices[i] = index;
+    }
+
+    return true;
+}
+
+// Reads a whole small file, like an MTL file.
+bool readFile(const std::string& path, std::string& contents)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    char buffer[16384];
+    size_t count;
+    contents.clear();
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        contents.append(buffer, count);
+
+    const bool failed = ferror(file);
+    fclose(file);
+    return !failed;
+}
+
+} // namespace
+
+bool AAPLObjFile::open(const char* path, unsigned threadCount, std::string& error)
+{
+    clear();
+
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        error = std::string("Couldn't open ") + path;
+        return false;
+    }
+
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0)
+    {
+        ::close(fd);
+        error = std::string("Couldn't read the size of ") + path;
+        return false;
+    }
+
+    const std::string directory(path, strrchr(path, '/') ? strrchr(path, '/') + 1 - path : 0);
+    if (fileInfo.st_size == 0)
+    {
+        ::close(fd);
+        return true;
+    }
+
+    void* mapping = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps the file's pages available after closing it.
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        error = std::string("Couldn't map ") + path;
+        return false;
+    }
+
+    const bool parsed = parse((const char*)mapping, (size_t)fileInfo.st_size,
+                              directory.empty() ? "./" : directory.c_str(), threadCount, error);
+    munmap(mapping, (size_t)fileInfo.st_size);
+
+    if (!parsed)
+        error = std::string(path) + ": " + error;
+    return parsed;
+}
+
+void AAPLObjFile::clear()
+{
+    _vertices.clear();
+    _indices.clear();
+    _materials.clear();
+    _submeshes.clear();
+
+    _positionCount  = 0;
+    _normalCount    = 0;
+    _texcoordCount  = 0;
+    _faceCount      = 0;
+}
+
+bool AAPLObjFile::parse(const char* data, size_t size, const char* materialDirectory, unsigned threadCount,
+                        std::string& error)
+{
+    clear();
+
+    // Split the file into chunks that each end after a line.
+    std::vector<Chunk> chunks;
+    for (const char* begin = data, * end = data + size; begin < end; )
+    {
+        const char* chunkEnd = begin + std::min(ChunkSize, (size_t)(end - begin));
+        const char* newline = chunkEnd < end ? (const char*)memchr(chunkEnd, '\n', (size_t)(end - chunkEnd)) : nullptr;
+        chunkEnd = newline ? newline + 1 : (chunkEnd < end ? end : chunkEnd);
+
+        chunks.emplace_back();
+        chunks.back().begin = begin;
+        chunks.back().end = chunkEnd;
+        begin = chunkEnd;
+    }
+
+    const auto chunkFailed = [&]()
+    {
+        for (const Chunk& chunk : chunks)
+        {
+            if (!chunk.errorMessage)
+                continue;
+
+            error = chunk.errorMessage;
+            if (chunk.errorPosition)
+                error += " on line " + std::to_string(std::count(data, chunk.errorPosition, '\n') + 1);
+            clear();
+            return true;
+        }
+        return false;
+    };
+
+    parallelFor(chunks.size(), threadCount, [&](size_t i) { parseChunk(chunks[i]); });
+    if (chunkFailed())
+        return false;
+
+    // Find where each chunk's attributes start among all of them.
+    std::vector<size_t> positionBases(chunks.size()), texcoordBases(chunks.size()), normalBases(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        positionBases[i]    = _positionCount;
+        texcoordBases[i]    = _texcoordCount;
+        normalBases[i]      = _normalCount;
+
+        _positionCount  += chunks[i].positions.size() / 3;
+        _texcoordCount  += chunks[i].texcoords.size() / 3;
+        _normalCount    += chunks[i].normals.size() / 3;
+        _faceCount      += chunks[i].faceCount;
+    }
+
+    if (_positionCount >= NoIndex || _texcoordCount >= NoIndex || _normalCount >= NoIndex)
+    {
+        error = "The file has too many vertices";
+        clear();
+        return false;
+    }
+
+    parallelFor(chunks.size(), threadCount, [&](size_t i)
+    {
+        deduplicateChunk(chunks[i], positionBases[i], texcoordBases[i], normalBases[i],
+                         _positionCount, _texcoordCount, _normalCount);
+    });
+    if (chunkFailed())
+        return false;
+
+    // Give each distinct corner a vertex of the mesh, in the order of the chunks.
+    size_t distinctCount = 0;
+    for (const Chunk& chunk : chunks)
+        distinctCount += chunk.vertices.size();
+
+    std::vector<Corner> vertexCorners;
+    CornerMap map(distinctCount / 2);
+    for (Chunk& chunk : chunks)
+    {
+        chunk.meshVertices.resize(chunk.vertices.size());
+        for (size_t i = 0; i < chunk.vertices.size(); i++)
+        {
+            const uint32_t index = map.findOrInsert(chunk.vertices[i], (uint32_t)vertexCorners.size());
+            if (index == vertexCorners.size())
+                vertexCorners.push_back(chunk.vertices[i]);
+            chunk.meshVertices[i] = index;
+        }
+    }
+
+    // Read the materials of the MTL files, then give each material that a `usemtl` line names
+    //  an index, carrying each chunk's last material over to the next chunk.
+    std::unordered_map<std::string, uint32_t> materialIndices;
+    std::vector<std::string> libraries;
+    for (const Chunk& chunk : chunks)
+    {
+        for (const std::string& library : chunk.materialLibraries)
+        {
+            if (!materialDirectory || std::find(libraries.begin(), libraries.end(), library) != libraries.end())
+                continue;
+
+            libraries.push_back(library);
+            if (!parseMaterialFile(materialDirectory + library, error))
+            {
+                clear();
+                return false;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < _materials.size(); i++)
+        materialIndices.emplace(_materials[i].name, i);
+
+    const auto materialIndex = [&](const std::string& name)
+    {
+        auto found = materialIndices.find(name);
+        if (found != materialIndices.end())
+            return found->second;
+
+        _materials.push_back({ name, { 1.0f, 1.0f, 1.0f }, std::string() });
+        materialIndices.emplace(name, (uint32_t)_materials.size() - 1);
+        return (uint32_t)_materials.size() - 1;
+    };
+
+    std::vector<MaterialRun> runs;
+    std::vector<uint32_t> submeshOfMaterial;
+    uint32_t material = NoIndex;
+    for (uint32_t c = 0; c < chunks.size(); c++)
+    {
+        const uint32_t triangleCount = (uint32_t)(chunks[c].corners.size() / 3);
+        uint32_t triangle = 0;
+        for (size_t use = 0; use <= chunks[c].materialUses.size(); use++)
+        {
+            const uint32_t runEnd = use < chunks[c].materialUses.size() ? chunks[c].materialUses[use].triangle : triangleCount;
+            if (runEnd > triangle)
+            {
+                if (material == NoIndex)
+                    material = materialIndex(std::string());
+
+                if (submeshOfMaterial.size() <= material)
+                    submeshOfMaterial.resize(material + 1, NoIndex);
+                if (submeshOfMaterial[material] == NoIndex)
+                {
+                    submeshOfMaterial[material] = (uint32_t)_submeshes.size();
+                    _submeshes.push_back({ material, 0, 0 });
+                }
+
+                runs.push_back({ material, c, triangle, runEnd - triangle, 0 });
+                _submeshes[submeshOfMaterial[material]].indexCount += (runEnd - triangle) * 3;
+                triangle = runEnd;
+            }
+
+            if (use < chunks[c].materialUses.size())
+                material = materialIndex(chunks[c].materialUses[use].name);
+        }
+    }
+
+    // Place the submeshes one after another, and each run after the earlier runs of its submesh.
+    uint32_t indexCount = 0;
+    for (AAPLObjSubmesh& submesh : _submeshes)
+    {
+        submesh.firstIndex = indexCount;
+        indexCount += submesh.indexCount;
+    }
+
+    std::vector<uint32_t> submeshCursors(_submeshes.size());
+    for (size_t i = 0; i < _submeshes.size(); i++)
+        submeshCursors[i] = _submeshes[i].firstIndex;
+
+    std::vector<std::vector<uint32_t>> chunkRuns(chunks.size());
+    for (uint32_t i = 0; i < runs.size(); i++)
+    {
+        uint32_t& cursor = submeshCursors[submeshOfMaterial[runs[i].material]];
+        runs[i].firstIndex = cursor;
+        cursor += runs[i].triangleCount * 3;
+        chunkRuns[runs[i].chunk].push_back(i);
+    }
+
+    _indices.resize(indexCount);
+    parallelFor(chunks.size(), threadCount, [&](size_t c)
+    {
+        const Chunk& chunk = chunks[c];
+        for (uint32_t run : chunkRuns[c])
+        {
+            const MaterialRun& materialRun = runs[run];
+            const uint32_t firstCorner = materialRun.firstTriangle * 3;
+            for (uint32_t i = 0; i < materialRun.triangleCount * 3; i++)
+                _indices[materialRun.firstIndex + i] = chunk.meshVertices[chunk.vertexIndices[firstCorner + i]];
+        }
+    });
+
+    // Gather the attributes of the chunks, and build the vertices from them.
+    std::vector<float> positions(_positionCount * 3), texcoords(_texcoordCount * 3), normals(_normalCount * 3);
+    parallelFor(chunks.size(), threadCount, [&](size_t c)
+    {
+        std::copy(chunks[c].positions.begin(), chunks[c].positions.end(), positions.begin() + positionBases[c] * 3);
+        std::copy(chunks[c].texcoords.begin(), chunks[c].texcoords.end(), texcoords.begin() + texcoordBases[c] * 3);
+        std::copy(chunks[c].normals.begin(), chunks[c].normals.end(), normals.begin() + normalBases[c] * 3);
+    });
+    chunks.clear();
+
+    _vertices.resize(vertexCorners.size());
+    const size_t blockSize = 65536;
+    parallelFor((vertexCorners.size() + blockSize - 1) / blockSize, threadCount, [&](size_t block)
+    {
+        const size_t end = std::min(vertexCorners.size(), (block + 1) * blockSize);
+        for (size_t i = block * blockSize; i < end; i++)
+        {
+            const Corner& corner = vertexCorners[i];
+            AAPLObjFileVertex& vertex = _vertices[i];
+            memcpy(vertex.position, &positions[corner.position * (size_t)3], sizeof(vertex.position));
+
+            if (corner.normal != NoIndex)
+                memcpy(vertex.normal, &normals[corner.normal * (size_t)3], sizeof(vertex.normal));
+            else
+                memset(vertex.normal, 0, sizeof(vertex.normal));
+
+            if (corner.texcoord != NoIndex)
+                memcpy(vertex.texcoord, &texcoords[corner.texcoord * (size_t)3], sizeof(vertex.texcoord));
+            else
+                memset(vertex.texcoord, 0, sizeof(vertex.texcoord));
+        }
+    });
+
+    return true;
+}
+
+bool AAPLObjFile::parseMaterialFile(const std::string& path, std::string& error)
+{
+    std::string contents;
+    if (!readFile(path, contents))
+    {
+        error = "Couldn't read " + path;
+        return false;
+    }
+
+    AAPLObjMaterial* material = nullptr;
+    const char* end = contents.data() + contents.size();
+    for (const char* line = contents.data(); line < end; )
+    {
+        const char* lineEnd = (const char*)memchr(line, '\n', (size_t)(end - line));
+        if (!lineEnd)
+            lineEnd = end;
+
+        const char* p = skipSpaces(line, lineEnd);
+        const char* keyword = p;
+        while (p < lineEnd && !isSpace(*p))
+            p++;
+        const std::string name(keyword, p);
+
+        if (name == "newmtl")
+        {
+            _materials.push_back({ restOfLine(p, lineEnd), { 1.0f, 1.0f, 1.0f }, std::string() });
+            material = &_materials.back();
+        }
+        else if (name == "Kd" && material)
+        {
+            float color[3];
+            const int count = parseFloats(p, lineEnd, color, 3);
+            if (count < 1)
+            {
+                error = path + ": A diffuse color needs a number";
+                return false;
+            }
+
+            // A single number sets all three channels.
+            for (int i = 0; i < 3; i++)
+                material->diffuseColor[i] = count == 1 ? color[0] : color[i];
+        }
+        else if (name == "map_Kd" && material)
+        {
+            material->diffuseMap = restOfLine(p, lineEnd);
+        }
+
+        line = lineEnd + 1;
+    }
+    return true;
+}
+
+size_t AAPLObjFile::indexSize() const
+{
+    return _vertices.size() <= Max16BitVertexCount ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void AAPLObjFile::copyIndices(void* destination, size_t indexSize, uint32_t first, uint32_t count) const
+{
+    if (indexSize == sizeof(uint32_t))
+    {
+        memcpy(destination, _indices.data() + first, count * sizeof(uint32_t));
+        return;
+    }
+
+    uint16_t* indices = (uint16_t*)destination;
+    for (uint32_t i = 0; i < count; i++)
+        indices[i] = (uint16_t)_indices[first + i];
+}
@@ -0,0 +1,500 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that measures what motion blur costs the CPU motion bounding volume
+ hierarchy, against rebuilding a static hierarchy for each time sample.
+*/
+
+#include "../Renderer/AAPLObjFile.h"
+#include "../Renderer/CPUMotionBVH.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void printUsage(const char * program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --obj PATH           Load a keyframe from an OBJ file; repeat for each keyframe\n"
+            "  --triangles N        Triangles of the generated model without --obj (default 100000)\n"
+            "  --keyframes N        Keyframes of the generated model (default 2)\n"
+            "  --motion M           How far the generated model moves, in its heights (default 0.5)\n"
+            "  --width N            Rays across the model (default 256)\n"
+            "  --height N           Rays down the model (default 256)\n"
+            "  --samples N          Time samples for each ray, and static rebuilds for the baseline (default 8)\n"
+            "  --shutter S          Fraction of the animation the shutter is open, around its middle (default 1;\n"
+            "                       the sample uses 0.2)\n"
+            "  --temporal-depth N   Temporal splits down any path of the motion hierarchy (default 4)\n"
+            "  --threads LIST       Comma-separated thread counts to build and trace with (default: one per core)\n",
+            program);
+}
+
+std::vector<unsigned> parseList(const char * list) {
+    std::vector<unsigned> values;
+    for (const char * p = list; p; ) {
+        values.push_back((unsigned)atoi(p));
+        p = strchr(p, ',');
+        if (p)
+            p++;
+    }
+    return values;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void parallelFor(size_t count, unsigned threadCount, const std::function<void(size_t)> & task) {
+    threadCount = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    threadCount = (unsigned)std::min<size_t>(threadCount, count);
+
+    std::atomic<size_t> next(0);
+    const auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+            task(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < threadCount; t++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread & thread : threads)
+        thread.join();
+}
+
+// Load the triangles of an OBJ file as three vertices each, like `addGeometryWithURL:`.
+bool loadOBJ(const char * path, std::vector<Vec3> & triangles) {
+    AAPLObjFile file;
+    std::string error;
+    if (!file.open(path, 0, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return false;
+    }
+
+    for (const AAPLObjSubmesh & submesh : file.submeshes()) {
+        for (uint32_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.indexCount; i++) {
+            const float * position = file.vertices()[file.indices()[i]].position;
+            triangles.push_back(Vec3(position[0], position[1], position[2]));
+        }
+    }
+
+    return !triangles.empty();
+}
+
+// Generate a lumpy figure about the size of the ninja model, standing on the origin, that
+// leans and twists further at each keyframe, more toward its top.
+void generateModel(uint32_t triangleCount, uint32_t keyframeCount, float motion, CPUKeyframedMesh & mesh) {
+    const uint32_t rings = std::max(2u, (uint32_t)sqrtf(triangleCount / 4.0f));
+    const uint32_t segments = std::max(3u, triangleCount / (2 * rings));
+    const float height = 5.0f;
+
+    mesh.keyframes.assign(keyframeCount, std::vector<Vec3>());
+    for (uint32_t k = 0; k < keyframeCount; k++) {
+        // Ease the motion, so that more than two keyframes don't fall on a line.
+        const float phase = keyframeCount > 1 ? sinf(0.5f * (float)M_PI * k / (keyframeCount - 1)) : 0.0f;
+
+        std::vector<Vec3> vertices;
+        for (uint32_t r = 0; r <= rings; r++) {
+            for (uint32_t s = 0; s <= segments; s++) {
+                const float theta = (float)M_PI * r / rings;
+                const float phi = 2.0f * (float)M_PI * s / segments;
+                const float radius = 1.0f + 0.15f * sinf(theta * 7.0f) * cosf(phi * 5.0f);
+                const float y = 0.5f * height * (1.0f - cosf(theta));
+                const float lean = y / height;
+                const float twist = phi + phase * motion * 2.0f * lean;
+
+                vertices.push_back(Vec3(radius * sinf(theta) * cosf(twist) + phase * motion * height * lean * lean,
+                                        y,
+                                        radius * sinf(theta) * sinf(twist)));
+            }
+        }
+
+        for (uint32_t r = 0; r < rings; r++) {
+            for (uint32_t s = 0; s < segments; s++) {
+                const uint32_t i0 = r * (segments + 1) + s;
+                const uint32_t i1 = i0 + segments + 1;
+                const uint32_t triangles[] = { i0, i1, i0 + 1, i0 + 1, i1, i1 + 1 };
+                for (uint32_t index : triangles)
+                    mesh.keyframes[k].push_back(vertices[index]);
+            }
+        }
+    }
+}
+
+// Intersect every triangle at the ray's time, with the same arithmetic as the hierarchy.
+CPUMotionIntersection intersectBruteForce(const CPUKeyframedMesh & mesh, const CPUMotionRay & ray, bool acceptAny) {
+    uint32_t keyframe;
+    float fraction;
+    mesh.keyframeAtTime(ray.time, keyframe, fraction);
+
+    const std::vector<Vec3> & vertices0 = mesh.keyframes[keyframe];
+    const std::vector<Vec3> & vertices1 = mesh.keyframes[mesh.keyframeCount() < 2 ? keyframe : keyframe + 1];
+
+    CPUMotionIntersection intersection = { false, 0.0f, 0, 0.0f, 0.0f };
+    float maxDistance = ray.maxDistance;
+    for (uint32_t primitive = 0; primitive < mesh.triangleCount(); primitive++) {
+        const Vec3 v0 = mix(vertices0[primitive * 3 + 0], vertices1[primitive * 3 + 0], fraction);
+        const Vec3 v1 = mix(vertices0[primitive * 3 + 1], vertices1[primitive * 3 + 1], fraction);
+        const Vec3 v2 = mix(vertices0[primitive * 3 + 2], vertices1[primitive * 3 + 2], fraction);
+
+        const Vec3 e1 = v1 - v0;
+        const Vec3 e2 = v2 - v0;
+        const Vec3 p = cross(ray.direction, e2);
+        const float det = dot(e1, p);
+        if (det == 0.0f)
+            continue;
+
+        const float inverseDet = 1.0f / det;
+        const Vec3 t = ray.origin - v0;
+        const float u = dot(t, p) * inverseDet;
+        if (!(u >= 0.0f && u <= 1.0f))
+            continue;
+
+        const Vec3 q = cross(t, e1);
+        const float v = dot(ray.direction, q) * inverseDet;
+        if (!(v >= 0.0f && u + v <= 1.0f))
+            continue;
+
+        const float distance = dot(e2, q) * inverseDet;
+        if (distance >= ray.minDistance && distance <= maxDistance) {
+            maxDistance = distance;
+            intersection = { true, distance, primitive, u, v };
+            if (acceptAny)
+                break;
+        }
+    }
+    return intersection;
+}
+
+bool matches(const CPUMotionIntersection & a, const CPUMotionIntersection & b, bool acceptAny) {
+    if (a.hit != b.hit)
+        return false;
+    return !a.hit || acceptAny || a.distance == b.distance;
+}
+
+bool sameBVH(const CPUMotionBVH & a, const CPUMotionBVH & b) {
+    return a.nodes().size() == b.nodes().size() && a.primitives() == b.primitives() &&
+           !memcmp(a.nodes().data(), b.nodes().data(), a.nodes().size() * sizeof(CPUMotionBVHNode)) &&
+           a.bounds().size() == b.bounds().size() &&
+           !memcmp(a.bounds().data(), b.bounds().data(), a.bounds().size() * sizeof(CPUMotionBounds));
+}
+
+// Primary rays from the sample's camera through a grid over the model's bounds at every
+// keyframe, each at a stratified random time while the shutter is open.
+std::vector<CPUMotionRay> primaryRays(const CPUKeyframedMesh & mesh, uint32_t width, uint32_t height,
+                                      uint32_t sampleCount, float shutter)
+{
+    const Vec3 position(0.0f, 1.0f, 3.42f);
+    const Vec3 forward = normalize(Vec3(0.0f, 1.0f, 0.0f) - position);
+    const Vec3 right = normalize(cross(forward, Vec3(0.0f, 1.0f, 0.0f)));
+    const Vec3 up = cross(right, forward);
+
+    float left = 1e30f, rightEdge = -1e30f, bottom = 1e30f, top = -1e30f;
+    for (const std::vector<Vec3> & vertices : mesh.keyframes) {
+        for (Vec3 vertex : vertices) {
+            const Vec3 d = vertex - position;
+            const float x = dot(d, right) / dot(d, forward);
+            const float y = dot(d, up) / dot(d, forward);
+            left = std::min(left, x);
+            rightEdge = std::max(rightEdge, x);
+            bottom = std::min(bottom, y);
+            top = std::max(top, y);
+        }
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    std::vector<CPUMotionRay> rays;
+    rays.reserve((size_t)width * height * sampleCount);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const float u = left + (rightEdge - left) * (x + 0.5f) / width;
+            const float v = bottom + (top - bottom) * (y + 0.5f) / height;
+            const Vec3 direction = normalize(right * u + up * v + forward);
+
+            for (uint32_t s = 0; s < sampleCount; s++) {
+                const float time = 0.5f + ((s + uniform(random)) / sampleCount - 0.5f) * shutter;
+                rays.push_back({ position, 0.0f, direction, INFINITY, time });
+            }
+        }
+    }
+    return rays;
+}
+
+// Shadow rays from where the primary rays hit toward the sample's light.
+std::vector<CPUMotionRay> shadowRays(const std::vector<CPUMotionRay> & rays,
+                                     const std::vector<CPUMotionIntersection> & intersections)
+{
+    const Vec3 light(0.0f, 1.98f, 0.0f);
+
+    std::vector<CPUMotionRay> shadows;
+    for (size_t i = 0; i < rays.size(); i++) {
+        if (!intersections[i].hit)
+            continue;
+
+        const Vec3 point = rays[i].origin + rays[i].direction * intersections[i].distance;
+        const Vec3 toLight = light - point;
+        const float distance = length(toLight);
+        shadows.push_back({ point, 1e-3f, toLight * (1.0f / distance), distance, rays[i].time });
+    }
+    return shadows;
+}
+
+// The time sample that rebuilding for each time sample renders a ray at.
+uint32_t timeSample(float time, uint32_t sampleCount, float shutter) {
+    const float open = 0.5f - 0.5f * shutter;
+    const float sample = shutter > 0.0f ? (time - open) / shutter * sampleCount : 0.0f;
+    return std::min((uint32_t)std::max(sample, 0.0f), sampleCount - 1);
+}
+
+void trace(const CPUMotionBVH & bvh, const std::vector<CPUMotionRay> & rays, bool acceptAny, unsigned threadCount,
+           std::vector<CPUMotionIntersection> & intersections)
+{
+    const size_t chunkSize = 4096;
+    intersections.resize(rays.size());
+    parallelFor((rays.size() + chunkSize - 1) / chunkSize, threadCount, [&](size_t chunk) {
+        const size_t end = std::min(rays.size(), (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; i++)
+            intersections[i] = bvh.intersect(rays[i], acceptAny);
+    });
+}
+
+// Check the hierarchy against intersecting every triangle, on a sample of the rays.
+size_t verify(const CPUMotionBVH & bvh, const CPUKeyframedMesh & mesh, const std::vector<CPUMotionRay> & rays,
+              bool acceptAny, size_t sampleCount)
+{
+    size_t mismatches = 0;
+    const size_t step = std::max<size_t>(1, rays.size() / sampleCount);
+    for (size_t i = 0; i < rays.size(); i += step)
+        mismatches += !matches(bvh.intersect(rays[i], acceptAny), intersectBruteForce(mesh, rays[i], acceptAny), acceptAny);
+    return mismatches;
+}
+
+struct Result {
+    double buildSeconds = 0.0;
+    double traceSeconds = 0.0;
+    size_t rayCount = 0;
+};
+
+void printResult(const char * name, const Result & result, const CPUMotionBVH * bvh) {
+    printf("%-34s %9.2f %9.2f %10.2f %9.2f", name, result.buildSeconds * 1e3, result.traceSeconds * 1e3,
+           result.rayCount / result.traceSeconds * 1e-6, (result.buildSeconds + result.traceSeconds) * 1e3);
+    if (bvh)
+        printf(" %8zu %9u %7.1f", bvh->nodes().size(), bvh->temporalSplitCount(), bvh->cost());
+    printf("\n");
+}
+
+// Build and trace a motion hierarchy, and check it against intersecting every triangle.
+Result benchmarkMotion(const CPUKeyframedMesh & mesh, const CPUMotionBVHBuildOptions & options,
+                       const std::vector<CPUMotionRay> & rays, CPUMotionBVH & bvh, size_t & mismatches)
+{
+    Result result;
+    auto begin = std::chrono::steady_clock::now();
+    bvh.build(mesh, options);
+    result.buildSeconds = seconds(begin);
+
+    std::vector<CPUMotionIntersection> intersections;
+    begin = std::chrono::steady_clock::now();
+    trace(bvh, rays, false, options.threadCount, intersections);
+    const std::vector<CPUMotionRay> shadows = shadowRays(rays, intersections);
+    result.traceSeconds = seconds(begin);
+
+    std::vector<CPUMotionIntersection> shadowIntersections;
+    begin = std::chrono::steady_clock::now();
+    trace(bvh, shadows, true, options.threadCount, shadowIntersections);
+    result.traceSeconds += seconds(begin);
+    result.rayCount = rays.size() + shadows.size();
+
+    mismatches += verify(bvh, mesh, rays, false, 2000) + verify(bvh, mesh, shadows, true, 2000);
+    return result;
+}
+
+// Render each time sample from a static hierarchy over the vertices at that time, rebuilt
+// for each time sample, which is the alternative to a motion hierarchy.
+Result benchmarkRebuild(const CPUKeyframedMesh & mesh, const CPUMotionBVHBuildOptions & options,
+                        const std::vector<CPUMotionRay> & rays, uint32_t sampleCount, float shutter, size_t & mismatches)
+{
+    std::vector<std::vector<CPUMotionRay>> sampleRays(sampleCount);
+    std::vector<float> sampleTimes(sampleCount);
+    for (uint32_t s = 0; s < sampleCount; s++)
+        sampleTimes[s] = 0.5f + ((s + 0.5f) / sampleCount - 0.5f) * shutter;
+
+    for (CPUMotionRay ray : rays) {
+        const uint32_t s = timeSample(ray.time, sampleCount, shutter);
+        ray.time = sampleTimes[s];
+        sampleRays[s].push_back(ray);
+    }
+
+    Result result;
+    CPUKeyframedMesh frame;
+    frame.keyframes.resize(1);
+    for (uint32_t s = 0; s < sampleCount; s++) {
+        // Blending the vertices is part of the cost of each rebuild.
+        auto begin = std::chrono::steady_clock::now();
+        frame.keyframes[0].resize(mesh.keyframes[0].size());
+        parallelFor(frame.keyframes[0].size(), options.threadCount, [&](size_t i) {
+            frame.keyframes[0][i] = mesh.vertexAtTime((uint32_t)i, sampleTimes[s]);
+        });
+
+        CPUMotionBVH bvh;
+        bvh.build(frame, options);
+        result.buildSeconds += seconds(begin);
+
+        std::vector<CPUMotionIntersection> intersections;
+        begin = std::chrono::steady_clock::now();
+        trace(bvh, sampleRays[s], false, options.threadCount, intersections);
+        const std::vector<CPUMotionRay> shadows = shadowRays(sampleRays[s], intersections);
+
+        std::vector<CPUMotionIntersection> shadowIntersections;
+        trace(bvh, shadows, true, options.threadCount, shadowIntersections);
+        result.traceSeconds += seconds(begin);
+        result.rayCount += sampleRays[s].size() + shadows.size();
+
+        mismatches += verify(bvh, frame, sampleRays[s], false, 2000 / sampleCount + 1);
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    std::vector<const char *> objPaths;
+    uint32_t triangleCount = 100000;
+    uint32_t keyframeCount = 2;
+    float motion = 0.5f;
+    uint32_t width = 256, height = 256;
+    uint32_t sampleCount = 8;
+    float shutter = 1.0f;
+    uint32_t temporalDepth = 4;
+    std::vector<unsigned> threadCounts = { 0 };
+
+    for (int i = 1; i < argc; i++) {
+        const char * arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(arg, "--obj") && hasValue)
+            objPaths.push_back(argv[++i]);
+        else if (!strcmp(arg, "--triangles") && hasValue)
+            triangleCount = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--keyframes") && hasValue)
+            keyframeCount = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--motion") && hasValue)
+            motion = (float)atof(argv[++i]);
+        else if (!strcmp(arg, "--width") && hasValue)
+            width = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--height") && hasValue)
+            height = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--samples") && hasValue)
+            sampleCount = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--shutter") && hasValue)
+            shutter = (float)atof(argv[++i]);
+        else if (!strcmp(arg, "--temporal-depth") && hasValue)
+            temporalDepth = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--threads") && hasValue)
+            threadCounts = parseList(argv[++i]);
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (width == 0 || height == 0 || sampleCount == 0 || keyframeCount == 0 || !(shutter >= 0.0f && shutter <= 1.0f) ||
+        threadCounts.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    CPUKeyframedMesh mesh;
+    if (!objPaths.empty()) {
+        for (const char * path : objPaths) {
+            mesh.keyframes.emplace_back();
+            if (!loadOBJ(path, mesh.keyframes.back())) {
+                fprintf(stderr, "%s: can't load the model\n", path);
+                return 1;
+            }
+            if (mesh.keyframes.back().size() != mesh.keyframes[0].size()) {
+                fprintf(stderr, "%s: the keyframes have different numbers of triangles\n", path);
+                return 1;
+            }
+        }
+    }
+    else {
+        generateModel(triangleCount, keyframeCount, motion, mesh);
+    }
+
+    // Place the model where the sample places its animated ninja.
+    for (std::vector<Vec3> & vertices : mesh.keyframes) {
+        for (Vec3 & vertex : vertices)
+            vertex = vertex * 0.2f + Vec3(0.5f, 0.0f, 0.0f);
+    }
+
+    // The same model, still in the middle of the shutter interval, for the cost without blur.
+    CPUKeyframedMesh still;
+    still.keyframes.resize(1);
+    for (uint32_t i = 0; i < (uint32_t)mesh.keyframes[0].size(); i++)
+        still.keyframes[0].push_back(mesh.vertexAtTime(i, 0.5f));
+
+    const std::vector<CPUMotionRay> rays = primaryRays(mesh, width, height, sampleCount, shutter);
+    std::vector<CPUMotionRay> stillRays = rays;
+    for (CPUMotionRay & ray : stillRays)
+        ray.time = 0.5f;
+
+    printf("%u triangles, %u keyframes, %zu primary rays, %u time samples\n",
+           mesh.triangleCount(), mesh.keyframeCount(), rays.size(), sampleCount);
+
+    int result = 0;
+    CPUMotionBVH reference;
+    for (unsigned threadCount : threadCounts) {
+        printf("\n%u threads\n", threadCount);
+        printf("%-34s %9s %9s %10s %9s %8s %9s %7s\n", "hierarchy", "build ms", "trace ms", "Mrays/s", "total ms",
+               "nodes", "temporal", "cost");
+
+        CPUMotionBVHBuildOptions options;
+        options.threadCount = threadCount;
+        options.maxTemporalSplitDepth = 0;
+
+        size_t mismatches = 0;
+        CPUMotionBVH stillBVH, spatialBVH, temporalBVH;
+        printResult("static, no blur", benchmarkMotion(still, options, stillRays, stillBVH, mismatches), &stillBVH);
+
+        char name[64];
+        snprintf(name, sizeof(name), "rebuild for each of %u samples", sampleCount);
+        printResult(name, benchmarkRebuild(mesh, options, rays, sampleCount, shutter, mismatches), nullptr);
+
+        const Result spatial = benchmarkMotion(mesh, options, rays, spatialBVH, mismatches);
+        printResult("motion, spatial splits", spatial, &spatialBVH);
+
+        options.maxTemporalSplitDepth = temporalDepth;
+        const Result temporal = benchmarkMotion(mesh, options, rays, temporalBVH, mismatches);
+        printResult("motion, spatial and temporal splits", temporal, &temporalBVH);
+
+        // The hierarchies must come out the same for any number of threads.
+        const bool same = threadCount == threadCounts[0] || sameBVH(temporalBVH, reference);
+        if (threadCount == threadCounts[0])
+            reference = temporalBVH;
+
+        if (mismatches || !same) {
+            printf("%zu intersections differ from intersecting every triangle%s\n", mismatches,
+                   same ? "" : ", and the hierarchy differs from the first thread count's");
+            result = 1;
+        }
+    }
+
+    return result;
+}
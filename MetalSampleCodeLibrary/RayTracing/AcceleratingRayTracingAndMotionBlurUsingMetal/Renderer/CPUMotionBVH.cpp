@@ -0,0 +1,758 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The implementation of the CPU motion bounding volume hierarchy.
+*/
+
+#include "CPUMotionBVH.h"
+
+#include <float.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <numeric>
+#include <thread>
+
+namespace {
+
+// Nodes with this few primitives build as independent subtrees on the worker threads.
+const uint32_t SubtreeSize = 4096;
+
+// Nodes this large measure their primitives on the worker threads.
+const uint32_t ParallelRangeSize = 65536;
+const uint32_t ParallelChunkSize = 16384;
+
+// Below this depth, nodes split in the middle rather than by the surface area heuristic,
+// which bounds the depth of the hierarchy and so the size of the traversal stack.
+const uint32_t MedianSplitDepth = 48;
+const uint32_t MaxStackSize = 128;
+
+const uint32_t MaxBinCount = 32;
+
+// Widens the far distance of a box by the rounding error of the slab distances, so that
+// rays can't slip past a flat box or between the boxes of neighboring primitives.
+const float BoxErrorScale = 1.0000004f;
+
+// Widens the stored bounds by the rounding error of blending them, which differs from the
+// rounding error of blending the vertices inside them.
+const float BoundsErrorScale = 1e-6f;
+
+struct Bounds {
+    Vec3 min = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vec3 max = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+    void grow(Vec3 p) {
+        min = ::min(min, p);
+        max = ::max(max, p);
+    }
+
+    void grow(const Bounds & bounds) {
+        min = ::min(min, bounds.min);
+        max = ::max(max, bounds.max);
+    }
+
+    float area() const {
+        if (min.x > max.x)
+            return 0.0f;
+
+        const Vec3 extent = max - min;
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+};
+
+// A time at which a node stores its bounds, and the keyframe at that time, if any.
+struct Sample {
+    float time;
+    int keyframe;
+};
+
+unsigned resolveThreadCount(unsigned threadCount) {
+    return threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void parallelFor(size_t count, unsigned threadCount, const std::function<void(size_t)> & task) {
+    threadCount = (unsigned)std::min<size_t>(resolveThreadCount(threadCount), count);
+
+    std::atomic<size_t> next(0);
+    const auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+            task(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < threadCount; t++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread & thread : threads)
+        thread.join();
+}
+
+float reciprocal(float d) {
+    return 1.0f / (fabsf(d) > 1e-20f ? d : copysignf(1e-20f, d));
+}
+
+// The area of bounds that blend linearly between samples, averaged over the samples' time
+// range with the trapezoid rule.
+float averageArea(const Bounds * bounds, const Sample * samples, uint32_t sampleCount) {
+    if (sampleCount == 1)
+        return bounds[0].area();
+
+    float area = 0.0f;
+    for (uint32_t i = 0; i + 1 < sampleCount; i++)
+        area += (samples[i + 1].time - samples[i].time) * (bounds[i].area() + bounds[i + 1].area());
+
+    const float duration = samples[sampleCount - 1].time - samples[0].time;
+    return duration > 0.0f ? area * 0.5f / duration : bounds[0].area();
+}
+
+// Builds a hierarchy whose nodes split either their primitives, by binning the primitives'
+// centroids along each axis, or their time range, whichever the surface area heuristic over
+// the time-averaged areas of the children prefers. A temporal split helps where primitives
+// move far enough that boxes over the whole time range overlap much more than boxes over
+// half of it.
+class MotionBVHBuilder {
+public:
+    MotionBVHBuilder(const CPUKeyframedMesh & mesh, const CPUMotionBVHBuildOptions & options)
+        : _mesh(mesh)
+        , _options(options)
+    {
+        _options.binCount = std::min(std::max(_options.binCount, 2u), MaxBinCount);
+        _options.maxLeafSize = std::max(_options.maxLeafSize, 1u);
+        if (mesh.keyframeCount() < 2)
+            _options.maxTemporalSplitDepth = 0;
+    }
+
+    void build(std::vector<CPUMotionBVHNode> & nodes, std::vector<CPUMotionBounds> & bounds,
+               std::vector<uint32_t> & primitives);
+
+private:
+    struct Task {
+        uint32_t node;
+        std::vector<uint32_t> primitives;
+        float startTime;
+        float endTime;
+        uint32_t depth;
+        uint32_t temporalDepth;
+    };
+
+    struct Output {
+        std::vector<CPUMotionBVHNode> nodes;
+        std::vector<CPUMotionBounds> bounds;
+        std::vector<uint32_t> primitives;
+    };
+
+    // The primitives of a node, measured at each of its samples.
+    struct Measure {
+        std::vector<Sample> samples;
+        std::vector<Bounds> bounds;
+        std::vector<Bounds> primitiveBounds;
+        std::vector<Vec3> centroids;
+        Bounds centroidBounds;
+    };
+
+    struct Split {
+        int axis = -1;
+        uint32_t bin = 0;
+        bool temporal = false;
+        Sample time = { 0.0f, -1 };
+        float cost = FLT_MAX;
+    };
+
+    std::vector<Sample> samples(float startTime, float endTime) const;
+    Bounds primitiveBounds(uint32_t primitive, Sample sample) const;
+    void measure(const Task & task, Measure & measure) const;
+    uint32_t binIndex(Vec3 centroid, int axis, const Bounds & centroidBounds) const;
+    void findSpatialSplit(const Task & task, const Measure & measure, Split & split) const;
+    void findTemporalSplit(const Task & task, const Measure & measure, Split & split) const;
+    void buildTasks(Output & output, Task root, std::vector<Task> * subtrees) const;
+
+    const CPUKeyframedMesh & _mesh;
+    CPUMotionBVHBuildOptions _options;
+
+    // The bounds of each primitive at each keyframe.
+    std::vector<std::vector<Bounds>> _keyframeBounds;
+};
+
+std::vector<Sample> MotionBVHBuilder::samples(float startTime, float endTime) const {
+    const uint32_t keyframeCount = _mesh.keyframeCount();
+    if (keyframeCount < 2)
+        return { { 0.0f, 0 } };
+
+    // The start and end of the range, and the keyframes inside it, between which the
+    // vertices and so the bounds move linearly.
+    std::vector<Sample> samples;
+    for (uint32_t k = 0; k < keyframeCount; k++) {
+        const float time = (float)k / (keyframeCount - 1);
+        if (time >= startTime && time <= endTime)
+            samples.push_back({ time, (int)k });
+    }
+
+    if (samples.empty() || samples.front().time > startTime)
+        samples.insert(samples.begin(), { startTime, -1 });
+    if (samples.back().time < endTime)
+        samples.push_back({ endTime, -1 });
+    return samples;
+}
+
+Bounds MotionBVHBuilder::primitiveBounds(uint32_t primitive, Sample sample) const {
+    if (sample.keyframe >= 0)
+        return _keyframeBounds[sample.keyframe][primitive];
+
+    Bounds bounds;
+    for (uint32_t i = 0; i < 3; i++)
+        bounds.grow(_mesh.vertexAtTime(primitive * 3 + i, sample.time));
+    return bounds;
+}
+
+void MotionBVHBuilder::measure(const Task & task, Measure & measure) const {
+    measure.samples = samples(task.startTime, task.endTime);
+
+    const uint32_t count = (uint32_t)task.primitives.size();
+    const uint32_t sampleCount = (uint32_t)measure.samples.size();
+    measure.primitiveBounds.resize((size_t)count * sampleCount);
+    measure.centroids.resize(count);
+
+    struct Chunk {
+        std::vector<Bounds> bounds;
+        Bounds centroidBounds;
+    };
+
+    // Each primitive's centroid is the average of its centroids at the samples.
+    const auto measureChunk = [&](uint32_t begin, uint32_t end, Chunk & chunk) {
+        chunk.bounds.assign(sampleCount, Bounds());
+        for (uint32_t i = begin; i < end; i++) {
+            Vec3 centroid(0.0f, 0.0f, 0.0f);
+            for (uint32_t s = 0; s < sampleCount; s++) {
+                const Bounds bounds = primitiveBounds(task.primitives[i], measure.samples[s]);
+                measure.primitiveBounds[(size_t)i * sampleCount + s] = bounds;
+                chunk.bounds[s].grow(bounds);
+                centroid = centroid + (bounds.min + bounds.max);
+            }
+
+            measure.centroids[i] = centroid * (0.5f / sampleCount);
+            chunk.centroidBounds.grow(measure.centroids[i]);
+        }
+    };
+
+    // Minimums and maximums combine in any order, so the result doesn't depend on the threads.
+    std::vector<Chunk> chunks((count + ParallelChunkSize - 1) / ParallelChunkSize);
+    if (count < ParallelRangeSize) {
+        chunks.resize(1);
+        measureChunk(0, count, chunks[0]);
+    }
+    else {
+        parallelFor(chunks.size(), _options.threadCount, [&](size_t chunk) {
+            const uint32_t begin = (uint32_t)chunk * ParallelChunkSize;
+            measureChunk(begin, std::min(begin + ParallelChunkSize, count), chunks[chunk]);
+        });
+    }
+
+    measure.bounds.assign(sampleCount, Bounds());
+    measure.centroidBounds = Bounds();
+    for (const Chunk & chunk : chunks) {
+        for (uint32_t s = 0; s < sampleCount; s++)
+            measure.bounds[s].grow(chunk.bounds[s]);
+        measure.centroidBounds.grow(chunk.centroidBounds);
+    }
+}
+
+uint32_t MotionBVHBuilder::binIndex(Vec3 centroid, int axis, const Bounds & centroidBounds) const {
+    const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+    const float scale = _options.binCount * (1.0f - 1e-6f) / extent;
+    const int bin = (int)((centroid[axis] - centroidBounds.min[axis]) * scale);
+    return (uint32_t)std::min(std::max(bin, 0), (int)_options.binCount - 1);
+}
+
+void MotionBVHBuilder::findSpatialSplit(const Task & task, const Measure & measure, Split & split) const {
+    const uint32_t binCount = _options.binCount;
+    const uint32_t count = (uint32_t)task.primitives.size();
+    const uint32_t sampleCount = (uint32_t)measure.samples.size();
+    const Sample * samples = measure.samples.data();
+
+    const float parentArea = averageArea(measure.bounds.data(), samples, sampleCount);
+    const float inverseParentArea = parentArea > 0.0f ? 1.0f / parentArea : 1.0f;
+
+    // Each bin keeps its bounds at every sample, so the areas of the sides average over time.
+    std::vector<Bounds> bins(binCount * sampleCount);
+    std::vector<uint32_t> binCounts(binCount);
+    std::vector<Bounds> side(sampleCount);
+    std::vector<float> rightAreas(binCount);
+    std::vector<uint32_t> rightCounts(binCount);
+
+    for (int axis = 0; axis < 3; axis++) {
+        if (measure.centroidBounds.max[axis] <= measure.centroidBounds.min[axis])
+            continue;
+
+        std::fill(bins.begin(), bins.end(), Bounds());
+        std::fill(binCounts.begin(), binCounts.end(), 0u);
+        for (uint32_t i = 0; i < count; i++) {
+            const uint32_t bin = binIndex(measure.centroids[i], axis, measure.centroidBounds);
+            for (uint32_t s = 0; s < sampleCount; s++)
+                bins[bin * sampleCount + s].grow(measure.primitiveBounds[(size_t)i * sampleCount + s]);
+            binCounts[bin]++;
+        }
+
+        // Sweep the bins from the right to find the area of each right side, then from the
+        // left to find the cost of each split. Without area, fall back to counts.
+        std::fill(side.begin(), side.end(), Bounds());
+        uint32_t rightCount = 0;
+        for (uint32_t i = binCount - 1; i > 0; i--) {
+            for (uint32_t s = 0; s < sampleCount; s++)
+                side[s].grow(bins[i * sampleCount + s]);
+            rightCount += binCounts[i];
+            rightAreas[i] = parentArea > 0.0f ? averageArea(side.data(), samples, sampleCount) : 1.0f;
+            rightCounts[i] = rightCount;
+        }
+
+        std::fill(side.begin(), side.end(), Bounds());
+        uint32_t leftCount = 0;
+        for (uint32_t i = 0; i + 1 < binCount; i++) {
+            for (uint32_t s = 0; s < sampleCount; s++)
+                side[s].grow(bins[i * sampleCount + s]);
+            leftCount += binCounts[i];
+            if (leftCount == 0 || rightCounts[i + 1] == 0)
+                continue;
+
+            const float leftArea = parentArea > 0.0f ? averageArea(side.data(), samples, sampleCount) : 1.0f;
+            const float cost = _options.traversalCost + _options.intersectionCost * inverseParentArea *
+                               (leftCount * leftArea + rightCounts[i + 1] * rightAreas[i + 1]);
+            if (cost < split.cost) {
+                split.axis = axis;
+                split.bin = i;
+                split.temporal = false;
+                split.cost = cost;
+            }
+        }
+    }
+}
+
+void MotionBVHBuilder::findTemporalSplit(const Task & task, const Measure & measure, Split & split) const {
+    if (task.temporalDepth >= _options.maxTemporalSplitDepth)
+        return;
+
+    const uint32_t count = (uint32_t)task.primitives.size();
+    const uint32_t sampleCount = (uint32_t)measure.samples.size();
+    const Sample * samples = measure.samples.data();
+
+    // Split at the keyframe closest to the middle of the range, or without one inside the
+    // range, at the middle.
+    const float middle = (task.startTime + task.endTime) * 0.5f;
+    uint32_t closest = 0;
+    for (uint32_t s = 1; s + 1 < sampleCount; s++) {
+        if (!closest || fabsf(samples[s].time - middle) < fabsf(samples[closest].time - middle))
+            closest = s;
+    }
+
+    std::vector<Bounds> bounds(measure.bounds);
+    std::vector<Sample> times(samples, samples + sampleCount);
+    if (!closest) {
+        Bounds middleBounds;
+        for (uint32_t i = 0; i < count; i++)
+            middleBounds.grow(primitiveBounds(task.primitives[i], { middle, -1 }));
+
+        closest = 1;
+        bounds.insert(bounds.begin() + 1, middleBounds);
+        times.insert(times.begin() + 1, { middle, -1 });
+    }
+
+    const float duration = task.endTime - task.startTime;
+    const float parentArea = averageArea(measure.bounds.data(), samples, sampleCount);
+    if (!(duration > 0.0f) || !(parentArea > 0.0f))
+        return;
+
+    // Both children hold all the primitives, but rays only reach the child whose time range
+    // contains their time.
+    const float leftArea = averageArea(bounds.data(), times.data(), closest + 1);
+    const float rightArea = averageArea(bounds.data() + closest, times.data() + closest, (uint32_t)times.size() - closest);
+    const float leftDuration = times[closest].time - task.startTime;
+    const float rightDuration = task.endTime - times[closest].time;
+    const float cost = _options.traversalCost + _options.intersectionCost * count *
+                       (leftDuration * leftArea + rightDuration * rightArea) / (duration * parentArea);
+    if (cost < split.cost) {
+        split.axis = -1;
+        split.temporal = true;
+        split.time = times[closest];
+        split.cost = cost;
+    }
+}
+
+// Builds the nodes of a task. With `subtrees`, it stops at tasks small enough to build on
+// their own, and leaves them for the caller.
+void MotionBVHBuilder::buildTasks(Output & output, Task root, std::vector<Task> * subtrees) const {
+    const uint32_t rootNode = root.node;
+    std::vector<Task> stack;
+    stack.push_back(std::move(root));
+
+    Measure measure;
+    while (!stack.empty()) {
+        Task task = std::move(stack.back());
+        stack.pop_back();
+
+        const uint32_t count = (uint32_t)task.primitives.size();
+        if (subtrees && count <= SubtreeSize && task.node != rootNode) {
+            subtrees->push_back(std::move(task));
+            continue;
+        }
+
+        this->measure(task, measure);
+
+        CPUMotionBVHNode & node = output.nodes[task.node];
+        node.firstBounds = (uint32_t)output.bounds.size();
+        node.boundsCount = (uint16_t)measure.samples.size();
+        node.temporalSplit = 0;
+        node.startTime = task.startTime;
+        node.endTime = task.endTime;
+
+        for (size_t s = 0; s < measure.samples.size(); s++) {
+            const Bounds & bounds = measure.bounds[s];
+            const Vec3 error = (max(bounds.max, -bounds.min) + max(bounds.max - bounds.min, Vec3(0.0f, 0.0f, 0.0f))) * BoundsErrorScale;
+            output.bounds.push_back({ bounds.min - error, measure.samples[s].time, bounds.max + error, 0.0f });
+        }
+
+        Split split;
+        if (count > 1 && task.depth < MedianSplitDepth) {
+            findSpatialSplit(task, measure, split);
+            findTemporalSplit(task, measure, split);
+        }
+
+        const bool fits = count <= _options.maxLeafSize;
+        if (count <= 1 || (fits && (split.cost == FLT_MAX || count * _options.intersectionCost <= split.cost))) {
+            output.nodes[task.node].childOrFirst = (uint32_t)output.primitives.size();
+            output.nodes[task.node].count = count;
+            output.primitives.insert(output.primitives.end(), task.primitives.begin(), task.primitives.end());
+            continue;
+        }
+
+        Task children[2];
+        if (split.temporal) {
+            children[0] = { 0, task.primitives, task.startTime, split.time.time, task.depth + 1, task.temporalDepth + 1 };
+            children[1] = { 0, std::move(task.primitives), split.time.time, task.endTime, task.depth + 1, task.temporalDepth + 1 };
+        }
+        else {
+            children[0] = { 0, {}, task.startTime, task.endTime, task.depth + 1, task.temporalDepth };
+            children[1] = { 0, {}, task.startTime, task.endTime, task.depth + 1, task.temporalDepth };
+
+            if (split.axis >= 0) {
+                for (uint32_t i = 0; i < count; i++) {
+                    const bool left = binIndex(measure.centroids[i], split.axis, measure.centroidBounds) <= split.bin;
+                    children[left ? 0 : 1].primitives.push_back(task.primitives[i]);
+                }
+            }
+            else {
+                // Split in the middle of the longest axis of the centroids, in a fixed order.
+                const Vec3 extent = measure.centroidBounds.max - measure.centroidBounds.min;
+                const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+                std::vector<uint32_t> order(count);
+                std::iota(order.begin(), order.end(), 0u);
+                std::nth_element(order.begin(), order.begin() + count / 2, order.end(), [&](uint32_t a, uint32_t b) {
+                    const float ca = measure.centroids[a][axis];
+                    const float cb = measure.centroids[b][axis];
+                    return ca < cb || (ca == cb && task.primitives[a] < task.primitives[b]);
+                });
+
+                for (uint32_t i = 0; i < count; i++)
+                    children[i < count / 2 ? 0 : 1].primitives.push_back(task.primitives[order[i]]);
+            }
+        }
+
+        const uint32_t first = (uint32_t)output.nodes.size();
+        output.nodes.resize(first + 2);
+        output.nodes[task.node].childOrFirst = first;
+        output.nodes[task.node].count = 0;
+        output.nodes[task.node].temporalSplit = split.temporal;
+
+        children[0].node = first;
+        children[1].node = first + 1;
+        stack.push_back(std::move(children[1]));
+        stack.push_back(std::move(children[0]));
+    }
+}
+
+void MotionBVHBuilder::build(std::vector<CPUMotionBVHNode> & nodes, std::vector<CPUMotionBounds> & bounds,
+                             std::vector<uint32_t> & primitives)
+{
+    nodes.clear();
+    bounds.clear();
+    primitives.clear();
+
+    const uint32_t count = _mesh.triangleCount();
+    if (count == 0)
+        return;
+
+    // Bound the primitives at every keyframe on the worker threads, in chunks of each keyframe.
+    const uint32_t keyframeCount = _mesh.keyframeCount();
+    const uint32_t chunkCount = (count + ParallelChunkSize - 1) / ParallelChunkSize;
+    _keyframeBounds.assign(keyframeCount, std::vector<Bounds>(count));
+    parallelFor((size_t)keyframeCount * chunkCount, _options.threadCount, [&](size_t task) {
+        const std::vector<Vec3> & vertices = _mesh.keyframes[task / chunkCount];
+        std::vector<Bounds> & keyframeBounds = _keyframeBounds[task / chunkCount];
+
+        const uint32_t begin = (uint32_t)(task % chunkCount) * ParallelChunkSize;
+        const uint32_t end = std::min(begin + ParallelChunkSize, count);
+        for (uint32_t i = begin; i < end; i++) {
+            keyframeBounds[i] = Bounds();
+            keyframeBounds[i].grow(vertices[i * 3 + 0]);
+            keyframeBounds[i].grow(vertices[i * 3 + 1]);
+            keyframeBounds[i].grow(vertices[i * 3 + 2]);
+        }
+    });
+
+    // Build the top of the hierarchy here, measuring large nodes on the worker threads, and
+    // then the subtrees below it on the worker threads.
+    Task root = { 0, std::vector<uint32_t>(count), 0.0f, 1.0f, 0, 0 };
+    std::iota(root.primitives.begin(), root.primitives.end(), 0u);
+
+    Output output;
+    output.nodes.resize(1);
+    std::vector<Task> subtrees;
+    buildTasks(output, std::move(root), &subtrees);
+
+    std::vector<uint32_t> subtreeNodes(subtrees.size());
+    std::vector<Output> subtreeOutputs(subtrees.size());
+    parallelFor(subtrees.size(), _options.threadCount, [&](size_t i) {
+        subtreeNodes[i] = subtrees[i].node;
+        subtrees[i].node = 0;
+        subtreeOutputs[i].nodes.resize(1);
+        buildTasks(subtreeOutputs[i], std::move(subtrees[i]), nullptr);
+    });
+
+    nodes = std::move(output.nodes);
+    bounds = std::move(output.bounds);
+    primitives = std::move(output.primitives);
+
+    // Place each subtree's root at the node that left it, and the rest of its nodes, bounds,
+    // and primitives at the ends, in a fixed order, so the result doesn't depend on the threads.
+    for (size_t i = 0; i < subtrees.size(); i++) {
+        const Output & subtree = subtreeOutputs[i];
+        const uint32_t nodeBase = (uint32_t)nodes.size() - 1;
+        const uint32_t boundsBase = (uint32_t)bounds.size();
+        const uint32_t primitiveBase = (uint32_t)primitives.size();
+
+        for (size_t n = 0; n < subtree.nodes.size(); n++) {
+            CPUMotionBVHNode node = subtree.nodes[n];
+            node.childOrFirst += node.count ? primitiveBase : nodeBase;
+            node.firstBounds += boundsBase;
+
+            if (n == 0)
+                nodes[subtreeNodes[i]] = node;
+            else
+                nodes.push_back(node);
+        }
+
+        bounds.insert(bounds.end(), subtree.bounds.begin(), subtree.bounds.end());
+        primitives.insert(primitives.end(), subtree.primitives.begin(), subtree.primitives.end());
+    }
+}
+
+// The bounds of a node at a time inside its time range, blended between its samples.
+void boundsAtTime(const CPUMotionBVHNode & node, const CPUMotionBounds * bounds, float time, Vec3 & min, Vec3 & max) {
+    const CPUMotionBounds * b = bounds + node.firstBounds;
+    if (node.boundsCount == 1) {
+        min = b[0].min;
+        max = b[0].max;
+        return;
+    }
+
+    uint32_t i = 0;
+    while (i + 2 < node.boundsCount && time > b[i + 1].time)
+        i++;
+
+    const float t = std::min(std::max((time - b[i].time) / (b[i + 1].time - b[i].time), 0.0f), 1.0f);
+    min = mix(b[i].min, b[i + 1].min, t);
+    max = mix(b[i].max, b[i + 1].max, t);
+}
+
+bool intersectBox(Vec3 min, Vec3 max, Vec3 origin, Vec3 inverseDirection,
+                  float minDistance, float maxDistance, float & distance)
+{
+    const float tx0 = (min.x - origin.x) * inverseDirection.x;
+    const float tx1 = (max.x - origin.x) * inverseDirection.x;
+    const float ty0 = (min.y - origin.y) * inverseDirection.y;
+    const float ty1 = (max.y - origin.y) * inverseDirection.y;
+    const float tz0 = (min.z - origin.z) * inverseDirection.z;
+    const float tz1 = (max.z - origin.z) * inverseDirection.z;
+
+    const float near = std::max(std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::min(tz0, tz1)), minDistance);
+    const float far = std::min(std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::max(tz0, tz1)) * BoxErrorScale, maxDistance);
+
+    distance = near;
+    return near <= far;
+}
+
+struct StackEntry {
+    uint32_t node;
+    float distance;
+};
+
+} // namespace
+
+void CPUKeyframedMesh::keyframeAtTime(float time, uint32_t & keyframe, float & fraction) const {
+    const uint32_t count = keyframeCount();
+    if (count < 2) {
+        keyframe = 0;
+        fraction = 0.0f;
+        return;
+    }
+
+    const float scaledTime = std::min(std::max(time, 0.0f), 1.0f) * (count - 1);
+    keyframe = std::min((uint32_t)scaledTime, count - 2);
+    fraction = std::min(scaledTime - keyframe, 1.0f);
+}
+
+Vec3 CPUKeyframedMesh::vertexAtTime(uint32_t vertex, float time) const {
+    uint32_t keyframe;
+    float fraction;
+    keyframeAtTime(time, keyframe, fraction);
+
+    if (keyframeCount() < 2)
+        return keyframes[0][vertex];
+    return mix(keyframes[keyframe][vertex], keyframes[keyframe + 1][vertex], fraction);
+}
+
+void CPUMotionBVH::build(const CPUKeyframedMesh & mesh, const CPUMotionBVHBuildOptions & options) {
+    _mesh = &mesh;
+
+    MotionBVHBuilder builder(mesh, options);
+    builder.build(_nodes, _bounds, _primitives);
+}
+
+uint32_t CPUMotionBVH::temporalSplitCount() const {
+    uint32_t count = 0;
+    for (const CPUMotionBVHNode & node : _nodes)
+        count += node.count == 0 && node.temporalSplit;
+    return count;
+}
+
+float CPUMotionBVH::cost() const {
+    if (_nodes.empty())
+        return 0.0f;
+
+    // A node's area counts in proportion to the rays that reach its time range.
+    const auto weightedArea = [&](const CPUMotionBVHNode & node) {
+        std::vector<Bounds> bounds(node.boundsCount);
+        std::vector<Sample> samples(node.boundsCount);
+        for (uint32_t s = 0; s < node.boundsCount; s++) {
+            const CPUMotionBounds & b = _bounds[node.firstBounds + s];
+            bounds[s].min = b.min;
+            bounds[s].max = b.max;
+            samples[s] = { b.time, -1 };
+        }
+        return averageArea(bounds.data(), samples.data(), node.boundsCount) * (node.endTime - node.startTime);
+    };
+
+    const float rootArea = weightedArea(_nodes[0]) > 0.0f ? weightedArea(_nodes[0]) : 1.0f;
+
+    float cost = 0.0f;
+    for (const CPUMotionBVHNode & node : _nodes)
+        cost += weightedArea(node) / rootArea * (node.count ? node.count : 1.0f);
+    return cost;
+}
+
+CPUMotionIntersection CPUMotionBVH::intersect(const CPUMotionRay & ray, bool acceptAny) const {
+    CPUMotionIntersection intersection = { false, 0.0f, 0, 0.0f, 0.0f };
+    if (_nodes.empty())
+        return intersection;
+
+    // Clamp the time like the acceleration structure's border modes, and find the keyframes
+    // that the triangles blend between once for the whole ray.
+    const float time = std::min(std::max(ray.time, 0.0f), 1.0f);
+    uint32_t keyframe;
+    float fraction;
+    _mesh->keyframeAtTime(time, keyframe, fraction);
+
+    const std::vector<Vec3> & vertices0 = _mesh->keyframes[keyframe];
+    const std::vector<Vec3> & vertices1 = _mesh->keyframes[_mesh->keyframeCount() < 2 ? keyframe : keyframe + 1];
+
+    const Vec3 origin = ray.origin;
+    const Vec3 direction = ray.direction;
+    const Vec3 inverseDirection(reciprocal(direction.x), reciprocal(direction.y), reciprocal(direction.z));
+    float maxDistance = ray.maxDistance;
+
+    Vec3 boxMin, boxMax;
+    float distance;
+    boundsAtTime(_nodes[0], _bounds.data(), time, boxMin, boxMax);
+    if (!intersectBox(boxMin, boxMax, origin, inverseDirection, ray.minDistance, maxDistance, distance))
+        return intersection;
+
+    StackEntry stack[MaxStackSize];
+    uint32_t stackSize = 0;
+    uint32_t index = 0;
+    for (;;) {
+        const CPUMotionBVHNode & node = _nodes[index];
+        if (node.count) {
+            for (uint32_t i = node.childOrFirst; i < node.childOrFirst + node.count; i++) {
+                const uint32_t primitive = _primitives[i];
+                const Vec3 v0 = mix(vertices0[primitive * 3 + 0], vertices1[primitive * 3 + 0], fraction);
+                const Vec3 v1 = mix(vertices0[primitive * 3 + 1], vertices1[primitive * 3 + 1], fraction);
+                const Vec3 v2 = mix(vertices0[primitive * 3 + 2], vertices1[primitive * 3 + 2], fraction);
+
+                // Intersect both sides of the triangle, like an intersector without culling.
+                const Vec3 e1 = v1 - v0;
+                const Vec3 e2 = v2 - v0;
+                const Vec3 p = cross(direction, e2);
+                const float det = dot(e1, p);
+                if (det == 0.0f)
+                    continue;
+
+                const float inverseDet = 1.0f / det;
+                const Vec3 t = origin - v0;
+                const float u = dot(t, p) * inverseDet;
+                if (!(u >= 0.0f && u <= 1.0f))
+                    continue;
+
+                const Vec3 q = cross(t, e1);
+                const float v = dot(direction, q) * inverseDet;
+                if (!(v >= 0.0f && u + v <= 1.0f))
+                    continue;
+
+                const float hitDistance = dot(e2, q) * inverseDet;
+                if (hitDistance >= ray.minDistance && hitDistance <= maxDistance) {
+                    maxDistance = hitDistance;
+                    intersection = { true, hitDistance, primitive, u, v };
+                    if (acceptAny)
+                        return intersection;
+                }
+            }
+        }
+        else if (node.temporalSplit) {
+            // The children split the node's time range, so only one can hold the ray's time.
+            const uint32_t child = time <= _nodes[node.childOrFirst].endTime ? node.childOrFirst : node.childOrFirst + 1;
+            boundsAtTime(_nodes[child], _bounds.data(), time, boxMin, boxMax);
+            if (intersectBox(boxMin, boxMax, origin, inverseDirection, ray.minDistance, maxDistance, distance)) {
+                index = child;
+                continue;
+            }
+        }
+        else {
+            float distance0, distance1;
+            const uint32_t child = node.childOrFirst;
+            boundsAtTime(_nodes[child], _bounds.data(), time, boxMin, boxMax);
+            const bool hit0 = intersectBox(boxMin, boxMax, origin, inverseDirection, ray.minDistance, maxDistance, distance0);
+            boundsAtTime(_nodes[child + 1], _bounds.data(), time, boxMin, boxMax);
+            const bool hit1 = intersectBox(boxMin, boxMax, origin, inverseDirection, ray.minDistance, maxDistance, distance1);
+
+            if (hit0 && hit1) {
+                const bool firstIsNear = distance0 <= distance1;
+                stack[stackSize++] = { firstIsNear ? child + 1 : child, firstIsNear ? distance1 : distance0 };
+                index = firstIsNear ? child : child + 1;
+                continue;
+            }
+            if (hit0 || hit1) {
+                index = hit0 ? child : child + 1;
+                continue;
+            }
+        }
+
+        // Skip the nodes that a closer intersection has moved out of reach.
+        do {
+            if (stackSize == 0)
+                return intersection;
+            stackSize--;
+        } while (stack[stackSize].distance > maxDistance);
+        index = stack[stackSize].node;
+    }
+}
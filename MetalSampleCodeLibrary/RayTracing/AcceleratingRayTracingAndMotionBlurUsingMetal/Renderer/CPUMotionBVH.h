@@ -0,0 +1,151 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The header for a CPU bounding volume hierarchy over keyframed triangles, which intersects rays
+ at a time between the keyframes the way a primitive motion acceleration structure does.
+*/
+
+#ifndef CPUMotionBVH_h
+#define CPUMotionBVH_h
+
+#include <math.h>
+#include <stdint.h>
+
+#include <vector>
+
+struct Vec3 {
+    float x, y, z;
+
+    Vec3() = default;
+    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    float operator[](int i) const { return (&x)[i]; }
+    float & operator[](int i) { return (&x)[i]; }
+};
+
+inline Vec3 operator+(Vec3 a, Vec3 b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Vec3 operator-(Vec3 a, Vec3 b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vec3 operator*(Vec3 a, Vec3 b) { return Vec3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline Vec3 operator*(Vec3 a, float s) { return Vec3(a.x * s, a.y * s, a.z * s); }
+inline Vec3 operator*(float s, Vec3 a) { return a * s; }
+inline Vec3 operator-(Vec3 a) { return Vec3(-a.x, -a.y, -a.z); }
+
+inline float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float length(Vec3 a) { return sqrtf(dot(a, a)); }
+inline Vec3 normalize(Vec3 a) { return a * (1.0f / length(a)); }
+inline Vec3 min(Vec3 a, Vec3 b) { return Vec3(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z); }
+inline Vec3 max(Vec3 a, Vec3 b) { return Vec3(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z); }
+
+// The same blend as the kernel uses between the vertex attributes of two keyframes.
+inline Vec3 mix(Vec3 a, Vec3 b, float t) { return a * (1.0f - t) + b * t; }
+
+inline Vec3 cross(Vec3 a, Vec3 b) {
+    return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+// The vertex positions of a triangle mesh at evenly spaced times from 0 to 1, three vertices
+// for each triangle, like the sample's `TriangleKeyframeData`.
+struct CPUKeyframedMesh {
+    std::vector<std::vector<Vec3>> keyframes;
+
+    uint32_t keyframeCount() const { return (uint32_t)keyframes.size(); }
+    uint32_t triangleCount() const { return keyframes.empty() ? 0 : (uint32_t)(keyframes[0].size() / 3); }
+
+    // The keyframe before a time and how far the time is toward the next one. Like a motion
+    // acceleration structure with clamped border modes, times outside 0 to 1 clamp to the
+    // first or last keyframe.
+    void keyframeAtTime(float time, uint32_t & keyframe, float & fraction) const;
+
+    // The position of a vertex at a time, blended between the keyframes around it.
+    Vec3 vertexAtTime(uint32_t vertex, float time) const;
+};
+
+struct CPUMotionRay {
+    Vec3 origin;
+    float minDistance;
+    Vec3 direction;
+    float maxDistance;
+    float time;
+};
+
+struct CPUMotionIntersection {
+    bool hit;
+    float distance;
+    uint32_t primitiveID;
+    float u, v;
+};
+
+struct CPUMotionBVHBuildOptions {
+    // Threads to build on, or 0 for one per core.
+    unsigned threadCount = 0;
+
+    uint32_t binCount = 16;
+    uint32_t maxLeafSize = 4;
+
+    // The costs of the surface area heuristic.
+    float traversalCost = 1.0f;
+    float intersectionCost = 1.0f;
+
+    // Lets nodes split their time range in two instead of their primitives when that costs
+    // less, up to this many times down any path from the root. 0 builds a hierarchy that only
+    // splits primitives, like a motion acceleration structure without temporal splits.
+    uint32_t maxTemporalSplitDepth = 4;
+};
+
+// A node covers its primitives over a range of time. Its bounds are stored at the start and
+// end of the range and at each keyframe inside it, and blend linearly between them.
+struct CPUMotionBVHNode {
+    // The first child, or the first primitive of a leaf.
+    uint32_t childOrFirst;
+
+    // The primitives of a leaf, or 0 for an interior node.
+    uint32_t count;
+
+    uint32_t firstBounds;
+    uint16_t boundsCount;
+
+    // Whether the node's two children split its time range rather than its primitives.
+    uint16_t temporalSplit;
+
+    float startTime;
+    float endTime;
+};
+
+struct CPUMotionBounds {
+    Vec3 min;
+    float time;
+    Vec3 max;
+    float padding;
+};
+
+class CPUMotionBVH {
+public:
+    // Build the hierarchy over the mesh's triangles. The mesh must outlive the hierarchy,
+    // which intersects the triangles at the time of each ray.
+    void build(const CPUKeyframedMesh & mesh, const CPUMotionBVHBuildOptions & options);
+
+    // Find the closest intersection along the ray at the ray's time, or with `acceptAny`, any
+    // intersection, like the intersector in the kernel.
+    CPUMotionIntersection intersect(const CPUMotionRay & ray, bool acceptAny) const;
+
+    const std::vector<CPUMotionBVHNode> & nodes() const { return _nodes; }
+    const std::vector<CPUMotionBounds> & bounds() const { return _bounds; }
+
+    // The triangles of the leaves. A triangle appears once for each temporal split above it.
+    const std::vector<uint32_t> & primitives() const { return _primitives; }
+
+    uint32_t temporalSplitCount() const;
+
+    // The expected cost of tracing a ray at a uniformly random time, by the surface area
+    // heuristic over the time-averaged areas of the nodes, relative to the root.
+    float cost() const;
+
+private:
+    const CPUKeyframedMesh * _mesh = nullptr;
+    std::vector<CPUMotionBVHNode> _nodes;
+    std::vector<CPUMotionBounds> _bounds;
+    std::vector<uint32_t> _primitives;
+};
+
+#endif
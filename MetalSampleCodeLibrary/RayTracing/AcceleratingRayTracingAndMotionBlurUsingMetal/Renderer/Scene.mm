@@ -7,9 +7,10 @@ The implementation of the class that describes objects in a scene.
 
 #import "Scene.h"
 
+#import <string>
 #import <vector>
 
-#import <ModelIO/ModelIO.h>
+#import "AAPLObjFile.h"
 
 using namespace simd;
 
@@ -214,29 +215,27 @@ float3 getTriangleNormal(float3 v0, float3 v1, float3 v2)
 
 - (void)addGeometryWithURL:(NSURL *)URL
 {
-    MDLAsset *asset = [[MDLAsset alloc] initWithURL:URL];
+    // Parse the OBJ file and its materials on one thread per core.
+    AAPLObjFile file;
+    std::string error;
+    bool loaded = file.open(URL.fileSystemRepresentation, 0, error);
     
-    NSAssert(asset, @"Could not open %@", URL);
+    NSAssert(loaded, @"Could not open %@: %s", URL, error.c_str());
     
-    MDLMesh *mesh = (MDLMesh *)asset[0];
+    const std::vector<AAPLObjFileVertex> & vertices = file.vertices();
+    const std::vector<uint32_t> & indices = file.indices();
     
-    struct MeshVertex {
-        float position[3];
-        float normal[3];
-        float uv[2];
-    };
-    
-    MeshVertex *meshVertices = (MeshVertex *)mesh.vertexBuffers[0].map.bytes;
+    _vertices.reserve(_vertices.size() + indices.size());
+    _normals.reserve(_normals.size() + indices.size());
+    _colors.reserve(_colors.size() + indices.size());
     
-    for (MDLSubmesh *submesh in mesh.submeshes) {
-        uint32_t *indices = (uint32_t *)submesh.indexBuffer.map.bytes;
+    for (const AAPLObjSubmesh & submesh : file.submeshes()) {
+        const float *diffuseColor = file.materials()[submesh.material].diffuseColor;
         
-        vector_float3 color = [submesh.material propertyWithSemantic:MDLMaterialSemanticBaseColor].float3Value;
+        vector_float3 color = vector3(diffuseColor[0], diffuseColor[1], diffuseColor[2]);
         
-        for (NSUInteger i = 0; i < submesh.indexCount; i++) {
-            uint32_t index = indices[i];
-            
-            MeshVertex & vertex = meshVertices[index];
+        for (uint32_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.indexCount; i++) {
+            const AAPLObjFileVertex & vertex = vertices[indices[i]];
             
             _vertices.push_back(vector3(vertex.position[0], vertex.position[1], vertex.position[2]));
             _normals.push_back(vector3(vertex.normal[0], vertex.normal[1], vertex.normal[2]));
@@ -0,0 +1,244 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that renders the sample's scene with the CPU path tracer, measures how its
+ samples per second scale with threads, and compares rendered images.
+*/
+
+#include "../Renderer/CPUPathTracer.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace {
+
+void printUsage(const char * program) {
+    fprintf(stderr,
+            "Usage: %s render [options] -o OUTPUT.pfm\n"
+            "       %s scale [options]\n"
+            "  --width N            Width of the image (default 800)\n"
+            "  --height N           Height of the image (default 600)\n"
+            "  --frames N           Frames to accumulate (default 64)\n"
+            "  --tile N             Size of the tiles the threads render (default 16)\n"
+            "  --seed N             Seed for each pixel's offset into the Halton sequence (default 0)\n"
+            "  --boxes              Render the short box instead of the sphere, like the sample\n"
+            "                       without intersection functions\n"
+            "  --adaptive T         Stop tiles whose error falls below T\n"
+            "  --min-frames N       Frames a tile renders before it can stop (default 16)\n"
+            "  --threads LIST       Thread counts; render uses the first (default: one per core)\n"
+            "       %s diff [--tolerance T] A.pfm B.pfm\n"
+            "  --tolerance T        Largest root mean square difference to pass (default 0)\n",
+            program, program, program);
+}
+
+std::vector<unsigned> parseList(const char * list) {
+    std::vector<unsigned> values;
+    for (const char * p = list; p; ) {
+        values.push_back((unsigned)atoi(p));
+        p = strchr(p, ',');
+        if (p)
+            p++;
+    }
+    return values;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+struct Arguments {
+    CPUPathTracerOptions options;
+    std::vector<unsigned> threadCounts = { 0 };
+    uint32_t frameCount = 64;
+    bool boxes = false;
+    const char * output = nullptr;
+};
+
+bool parseArguments(int argc, char ** argv, Arguments & arguments) {
+    for (int i = 2; i < argc; i++) {
+        const char * arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(arg, "--width") && hasValue)
+            arguments.options.width = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--height") && hasValue)
+            arguments.options.height = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--frames") && hasValue)
+            arguments.frameCount = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--tile") && hasValue)
+            arguments.options.tileSize = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--seed") && hasValue)
+            arguments.options.seed = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        else if (!strcmp(arg, "--boxes"))
+            arguments.boxes = true;
+        else if (!strcmp(arg, "--adaptive") && hasValue)
+            arguments.options.adaptiveThreshold = (float)atof(argv[++i]);
+        else if (!strcmp(arg, "--min-frames") && hasValue)
+            arguments.options.adaptiveMinFrames = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--threads") && hasValue)
+            arguments.threadCounts = parseList(argv[++i]);
+        else if (!strcmp(arg, "-o") && hasValue)
+            arguments.output = argv[++i];
+        else
+            return false;
+    }
+
+    return arguments.options.width > 0 && arguments.options.height > 0 && arguments.frameCount > 0 &&
+           !arguments.threadCounts.empty();
+}
+
+int render(int argc, char ** argv) {
+    Arguments arguments;
+    if (!parseArguments(argc, argv, arguments) || !arguments.output) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Draw the light colors the way the sample does.
+    srand(1);
+    const CPUScene scene = newInstancedCornellBoxScene(!arguments.boxes);
+
+    arguments.options.threadCount = arguments.threadCounts[0];
+    CPUPathTracer pathTracer(scene, arguments.options);
+
+    auto begin = std::chrono::steady_clock::now();
+    pathTracer.render(arguments.frameCount);
+    const double elapsed = seconds(begin);
+
+    printf("%u x %u, %llu samples in %.2f s: %.2f Msamples/s, %.2f Mrays/s",
+           pathTracer.width(), pathTracer.height(), (unsigned long long)pathTracer.sampleCount(), elapsed,
+           pathTracer.sampleCount() / elapsed * 1e-6, pathTracer.rayCount() / elapsed * 1e-6);
+    if (arguments.options.adaptiveThreshold > 0.0f)
+        printf(", %u of %u tiles converged", pathTracer.convergedTileCount(), pathTracer.tileCount());
+    printf("\n");
+
+    if (!pathTracer.writePFM(arguments.output)) {
+        fprintf(stderr, "%s: %s\n", arguments.output, strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+int scale(int argc, char ** argv) {
+    Arguments arguments;
+    arguments.threadCounts = { 1, 2, 4, 8, 16, 32, 64 };
+    arguments.frameCount = 16;
+    if (!parseArguments(argc, argv, arguments)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    srand(1);
+    const CPUScene scene = newInstancedCornellBoxScene(!arguments.boxes);
+
+    // Render the same frames with each thread count, and check that the images match.
+    int result = 0;
+    double baseline = 0.0;
+    std::vector<float> reference;
+
+    printf("%7s %9s %12s %10s %9s %10s\n", "threads", "seconds", "Msamples/s", "Mrays/s", "speedup", "efficiency");
+    for (unsigned threadCount : arguments.threadCounts) {
+        arguments.options.threadCount = threadCount;
+        CPUPathTracer pathTracer(scene, arguments.options);
+
+        auto begin = std::chrono::steady_clock::now();
+        pathTracer.render(arguments.frameCount);
+        const double elapsed = seconds(begin);
+
+        const double samplesPerSecond = pathTracer.sampleCount() / elapsed;
+        if (baseline == 0.0)
+            baseline = samplesPerSecond / std::max(threadCount, 1u);
+
+        const bool same = reference.empty() || pathTracer.image() == reference;
+        if (reference.empty())
+            reference = pathTracer.image();
+
+        printf("%7u %9.2f %12.3f %10.3f %8.2fx %9.0f%%%s\n", threadCount, elapsed, samplesPerSecond * 1e-6,
+               pathTracer.rayCount() / elapsed * 1e-6, samplesPerSecond / baseline,
+               samplesPerSecond / baseline / std::max(threadCount, 1u) * 100.0, same ? "" : "  DIFFERENT");
+        result |= !same;
+    }
+
+    return result;
+}
+
+int diff(int argc, char ** argv) {
+    double tolerance = 0.0;
+    std::vector<const char *> paths;
+
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else if (argv[i][0] != '-')
+            paths.push_back(argv[i]);
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (paths.size() != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<float> images[2];
+    uint32_t widths[2], heights[2];
+    for (int i = 0; i < 2; i++) {
+        if (!CPUReadPFM(paths[i], images[i], widths[i], heights[i])) {
+            fprintf(stderr, "%s: can't read the image\n", paths[i]);
+            return 1;
+        }
+    }
+
+    if (widths[0] != widths[1] || heights[0] != heights[1]) {
+        fprintf(stderr, "The images are different sizes\n");
+        return 1;
+    }
+
+    // Compare the colors after the sample's tone mapping, so bright pixels don't dominate.
+    double sumSquares = 0.0;
+    double largest = 0.0;
+    size_t different = 0;
+    const size_t pixelCount = (size_t)widths[0] * heights[0];
+    for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+        bool same = true;
+        for (int c = 0; c < 3; c++) {
+            const float a = images[0][pixel * 4 + c];
+            const float b = images[1][pixel * 4 + c];
+            const double difference = a / (1.0 + a) - b / (1.0 + b);
+
+            sumSquares += difference * difference;
+            largest = std::max(largest, fabs(difference));
+            same &= a == b;
+        }
+        different += !same;
+    }
+
+    const double rootMeanSquare = sqrt(sumSquares / (pixelCount * 3));
+    printf("RMS %.6f, largest %.6f, %zu of %zu pixels differ\n", rootMeanSquare, largest, different, pixelCount);
+    return rootMeanSquare > tolerance;
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    if (argc >= 2 && !strcmp(argv[1], "render"))
+        return render(argc, argv);
+    if (argc >= 2 && !strcmp(argv[1], "scale"))
+        return scale(argc, argv);
+    if (argc >= 2 && !strcmp(argv[1], "diff"))
+        return diff(argc, argv);
+
+    printUsage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,495 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that builds the CPU ray tracer's acceleration structures for the sample's
+ scene and measures how many rays per second each way of tracing intersects.
+*/
+
+#include "../Renderer/CPURayTracer.h"
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+void printUsage(const char * program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --scene NAME         spheres, triangles, or ninja (default: all three)\n"
+            "  --obj PATH           OBJ model to place in the ninja scene, like the motion blur sample\n"
+            "  --triangles N        Triangles of the generated model without --obj (default 100000)\n"
+            "  --width N            Width of the primary rays' image (default 512)\n"
+            "  --height N           Height of the primary rays' image (default 512)\n"
+            "  --threads LIST       Comma separated thread counts to trace with (default 1,4)\n"
+            "  --repeat N           Runs of each measurement to average (default 3)\n",
+            program);
+}
+
+std::vector<unsigned> parseList(const char * list) {
+    std::vector<unsigned> values;
+    for (const char * p = list; p; ) {
+        values.push_back((unsigned)atoi(p));
+        p = strchr(p, ',');
+        if (p)
+            p++;
+    }
+    return values;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Load the positions and faces of an OBJ file as triangles.
+bool loadOBJ(const char * path, CPUGeometry & geometry) {
+    FILE * file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == 'v' && line[1] == ' ') {
+            Vec3 v(0.0f, 0.0f, 0.0f);
+            sscanf(line + 2, "%f %f %f", &v.x, &v.y, &v.z);
+            geometry.vertices.push_back(v);
+        }
+        else if (line[0] == 'f' && line[1] == ' ') {
+            // Split polygons into fans, resolving negative indices against the vertices so far.
+            std::vector<uint32_t> face;
+            for (char * p = line + 2; *p; ) {
+                char * end;
+                long index = strtol(p, &end, 10);
+                if (end == p)
+                    break;
+
+                index = index < 0 ? (long)geometry.vertices.size() + index : index - 1;
+                if (index < 0 || index >= (long)geometry.vertices.size()) {
+                    fclose(file);
+                    return false;
+                }
+                face.push_back((uint32_t)index);
+
+                p = end;
+                while (*p && *p != ' ' && *p != '\t')
+                    p++;
+            }
+
+            for (size_t i = 2; i < face.size(); i++) {
+                geometry.indices.push_back(face[0]);
+                geometry.indices.push_back(face[i - 1]);
+                geometry.indices.push_back(face[i]);
+            }
+        }
+    }
+
+    fclose(file);
+    return !geometry.indices.empty();
+}
+
+// Generate a lumpy figure about the size of the ninja model, standing on the origin.
+void generateModel(uint32_t triangleCount, CPUGeometry & geometry) {
+    const uint32_t rings = std::max(2u, (uint32_t)sqrtf(triangleCount / 4.0f));
+    const uint32_t segments = std::max(3u, triangleCount / (2 * rings));
+
+    for (uint32_t r = 0; r <= rings; r++) {
+        for (uint32_t s = 0; s <= segments; s++) {
+            const float theta = (float)M_PI * r / rings;
+            const float phi = 2.0f * (float)M_PI * s / segments;
+            const float radius = 1.0f + 0.15f * sinf(theta * 7.0f) * cosf(phi * 5.0f);
+
+            geometry.vertices.push_back(Vec3(radius * sinf(theta) * cosf(phi),
+                                             2.5f * (1.0f - cosf(theta)),
+                                             radius * sinf(theta) * sinf(phi)));
+        }
+    }
+
+    for (uint32_t r = 0; r < rings; r++) {
+        for (uint32_t s = 0; s < segments; s++) {
+            const uint32_t i0 = r * (segments + 1) + s;
+            const uint32_t i1 = i0 + segments + 1;
+            const uint32_t triangles[] = { i0, i1, i0 + 1, i0 + 1, i1, i1 + 1 };
+            geometry.indices.insert(geometry.indices.end(), triangles, triangles + 6);
+        }
+    }
+}
+
+// The instanced Cornell box, with two models in each box where the motion blur sample
+// places its ninjas.
+CPUScene newNinjaScene(const CPUGeometry & model) {
+    CPUScene scene = newInstancedCornellBoxScene(false);
+
+    const uint32_t geometry = (uint32_t)scene.geometries.size();
+    scene.geometries.push_back(model);
+
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            const Transform box = transformTranslation(x * 2.5f, y * 2.5f, 0.0f);
+
+            scene.instances.push_back({ geometry, box * transformTranslation(-0.45f, 0.0f, 1.0f) * transformScale(0.2f, 0.2f, 0.2f),
+                                        GEOMETRY_MASK_TRIANGLE });
+            scene.instances.push_back({ geometry, box * transformTranslation(0.5f, 0.0f, 0.0f) * transformScale(0.2f, 0.2f, 0.2f),
+                                        GEOMETRY_MASK_TRIANGLE });
+        }
+    }
+
+    return scene;
+}
+
+struct RaySet {
+    const char * name;
+    std::vector<CPURay> rays;
+    unsigned int mask;
+    bool acceptAny;
+};
+
+Vec3 randomDirection(std::mt19937 & random) {
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    for (;;) {
+        const Vec3 d(uniform(random), uniform(random), uniform(random));
+        const float lengthSquared = dot(d, d);
+        if (lengthSquared > 1e-4f && lengthSquared <= 1.0f)
+            return d * (1.0f / sqrtf(lengthSquared));
+    }
+}
+
+// Make primary rays the way the sample's ray generation does, and from where they hit,
+// shadow rays toward a point on a light and secondary rays in random directions.
+std::vector<RaySet> makeRaySets(const CPUScene & scene, const CPUAccelerationStructure & accelerationStructure,
+                                uint32_t width, uint32_t height)
+{
+    std::vector<RaySet> sets(3);
+    sets[0] = { "primary", {}, RAY_MASK_PRIMARY, false };
+    sets[1] = { "shadow", {}, RAY_MASK_SHADOW, true };
+    sets[2] = { "secondary", {}, RAY_MASK_SECONDARY, false };
+
+    const Vec3 forward = normalize(scene.cameraTarget - scene.cameraPosition);
+    Vec3 right = normalize(cross(forward, scene.cameraUp));
+    Vec3 up = normalize(cross(right, forward));
+
+    const float fieldOfView = 45.0f * ((float)M_PI / 180.0f);
+    const float imagePlaneHeight = tanf(fieldOfView / 2.0f);
+    right *= imagePlaneHeight * ((float)width / (float)height);
+    up *= imagePlaneHeight;
+
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const float u = (x + 0.5f) / width * 2.0f - 1.0f;
+            const float v = (y + 0.5f) / height * 2.0f - 1.0f;
+
+            CPURay ray;
+            ray.origin = scene.cameraPosition;
+            ray.direction = normalize(u * right + v * up + forward);
+            ray.minDistance = 0.0f;
+            ray.maxDistance = INFINITY;
+            sets[0].rays.push_back(ray);
+        }
+    }
+
+    std::vector<CPUIntersection> intersections(sets[0].rays.size());
+    CPUStreamOptions options;
+    accelerationStructure.intersectStream(sets[0].rays.data(), sets[0].rays.size(), RAY_MASK_PRIMARY, false,
+                                          intersections.data(), options);
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    for (size_t i = 0; i < intersections.size(); i++) {
+        const CPUIntersection & intersection = intersections[i];
+        if (intersection.type == CPUIntersectionTypeNone ||
+            scene.instances[intersection.instanceID].mask == GEOMETRY_MASK_LIGHT)
+            continue;
+
+        const CPURay & primary = sets[0].rays[i];
+        const Vec3 position = primary.origin + primary.direction * intersection.distance;
+
+        const CPUAreaLight & light = scene.lights[random() % scene.lights.size()];
+        const Vec3 toLight = light.position + light.right * uniform(random) + light.up * uniform(random) - position;
+        const float lightDistance = length(toLight);
+
+        CPURay shadow;
+        shadow.origin = position;
+        shadow.direction = toLight * (1.0f / lightDistance);
+        shadow.minDistance = 1e-3f;
+        shadow.maxDistance = lightDistance - 1e-3f;
+        sets[1].rays.push_back(shadow);
+
+        CPURay secondary;
+        secondary.origin = position;
+        secondary.direction = randomDirection(random);
+        secondary.minDistance = 1e-3f;
+        secondary.maxDistance = INFINITY;
+        sets[2].rays.push_back(secondary);
+    }
+
+    return sets;
+}
+
+// Intersect a ray with every primitive of every instance, with the tracer's math.
+CPUIntersection intersectBruteForce(const CPUScene & scene, const CPURay & ray, unsigned int mask, bool acceptAny) {
+    CPUIntersection result = { CPUIntersectionTypeNone, 0.0f, 0, 0, 0.0f, 0.0f };
+    float maxDistance = ray.maxDistance;
+
+    for (uint32_t i = 0; i < scene.instances.size(); i++) {
+        const CPUGeometryInstance & instance = scene.instances[i];
+        if ((instance.mask & mask) == 0)
+            continue;
+
+        const Transform worldToObject = instance.transform.inverse();
+        const Vec3 origin = worldToObject.transformPoint(ray.origin);
+        const Vec3 direction = worldToObject.transformDirection(ray.direction);
+        const CPUGeometry & geometry = scene.geometries[instance.geometry];
+
+        for (uint32_t p = 0; p < geometry.primitiveCount(); p++) {
+            if (geometry.usesIntersectionFunction()) {
+                const CPUSphere & sphere = geometry.spheres[p];
+                const Vec3 oc = origin - sphere.origin;
+                const float a = dot(direction, direction);
+                const float b = 2 * dot(oc, direction);
+                const float c = dot(oc, oc) - sphere.radius * sphere.radius;
+                const float disc = b * b - 4 * a * c;
+                if (disc <= 0.0f)
+                    continue;
+
+                const float distance = (-b - sqrtf(disc)) / (2 * a);
+                if (distance >= ray.minDistance && distance <= maxDistance) {
+                    maxDistance = distance;
+                    result = { CPUIntersectionTypeBoundingBox, distance, i, p, 0.0f, 0.0f };
+                }
+            }
+            else {
+                const Vec3 v0 = geometry.vertices[geometry.indices[p * 3 + 0]];
+                const Vec3 e1 = geometry.vertices[geometry.indices[p * 3 + 1]] - v0;
+                const Vec3 e2 = geometry.vertices[geometry.indices[p * 3 + 2]] - v0;
+
+                const Vec3 pv = cross(direction, e2);
+                const float det = dot(e1, pv);
+                if (det == 0.0f)
+                    continue;
+
+                const float inverseDet = 1.0f / det;
+                const Vec3 t = origin - v0;
+                const float u = dot(t, pv) * inverseDet;
+                if (!(u >= 0.0f && u <= 1.0f))
+                    continue;
+
+                const Vec3 q = cross(t, e1);
+                const float v = dot(direction, q) * inverseDet;
+                if (!(v >= 0.0f && u + v <= 1.0f))
+                    continue;
+
+                const float distance = dot(e2, q) * inverseDet;
+                if (distance >= ray.minDistance && distance <= maxDistance) {
+                    maxDistance = distance;
+                    result = { CPUIntersectionTypeTriangle, distance, i, p, u, v };
+                }
+            }
+
+            if (acceptAny && result.type != CPUIntersectionTypeNone)
+                return result;
+        }
+    }
+
+    return result;
+}
+
+// Whether two results agree: both miss or both hit, and closest hits at the same distance.
+bool matches(const CPUIntersection & a, const CPUIntersection & b, bool acceptAny) {
+    if ((a.type == CPUIntersectionTypeNone) != (b.type == CPUIntersectionTypeNone))
+        return false;
+    if (acceptAny || a.type == CPUIntersectionTypeNone)
+        return true;
+    return fabsf(a.distance - b.distance) <= 1e-4f * std::max(1.0f, fabsf(a.distance));
+}
+
+bool sameBVH(const CPUBVH & a, const CPUBVH & b) {
+    return a.nodes.size() == b.nodes.size() && a.primitives == b.primitives &&
+           (a.nodes.empty() || !memcmp(a.nodes.data(), b.nodes.data(), a.nodes.size() * sizeof(CPUBVHNode)));
+}
+
+struct Mode {
+    const char * name;
+    uint32_t packetWidth;
+    bool sort;
+};
+
+int benchmarkScene(const char * name, const CPUScene & scene, uint32_t width, uint32_t height,
+                   const std::vector<unsigned> & threadCounts, uint32_t repeat)
+{
+    size_t primitiveCount = 0;
+    for (const CPUGeometryInstance & instance : scene.instances)
+        primitiveCount += scene.geometries[instance.geometry].primitiveCount();
+
+    printf("\n%s: %zu instances, %zu primitives\n", name, scene.instances.size(), primitiveCount);
+
+    int result = 0;
+
+    // Build with each thread count, checking that the hierarchies come out the same.
+    CPUAccelerationStructure accelerationStructure;
+    for (size_t t = 0; t < threadCounts.size(); t++) {
+        CPUBVHBuildOptions options;
+        options.threadCount = threadCounts[t];
+
+        CPUAccelerationStructure built;
+        double elapsed = 0.0;
+        for (uint32_t r = 0; r < repeat; r++) {
+            auto begin = std::chrono::steady_clock::now();
+            built.build(scene, options);
+            elapsed += seconds(begin);
+        }
+        elapsed /= repeat;
+
+        bool same = true;
+        if (t > 0) {
+            same = sameBVH(built.instanceBVH(), accelerationStructure.instanceBVH());
+            for (uint32_t g = 0; g < scene.geometries.size(); g++)
+                same &= sameBVH(built.primitiveBVH(g), accelerationStructure.primitiveBVH(g));
+        }
+
+        printf("  build, %2u thr    %9.2f ms  %8zu nodes  SAH cost %.1f%s\n", threadCounts[t], elapsed * 1e3,
+               built.nodeCount(), built.instanceBVH().cost(), same ? "" : "  DIFFERENT");
+        result |= !same;
+
+        if (t == 0)
+            accelerationStructure = built;
+    }
+
+    const std::vector<RaySet> sets = makeRaySets(scene, accelerationStructure, width, height);
+
+    const Mode modes[] = {
+        { "scalar", 1, false },
+        { "packet4", 4, false },
+        { "packet8", 8, false },
+        { "stream4", 4, true },
+        { "stream8", 8, true },
+    };
+
+    printf("  %-10s %-9s %7s %10s\n", "rays", "mode", "threads", "Mrays/s");
+    for (const RaySet & set : sets) {
+        const size_t count = set.rays.size();
+        if (count == 0)
+            continue;
+
+        // Check single rays against every primitive on a sample of the rays.
+        std::vector<CPUIntersection> reference(count);
+        for (size_t i = 0; i < count; i++)
+            reference[i] = accelerationStructure.intersect(set.rays[i], set.mask, set.acceptAny);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < count; i += std::max<size_t>(1, count / 1000))
+            mismatches += !matches(intersectBruteForce(scene, set.rays[i], set.mask, set.acceptAny), reference[i], set.acceptAny);
+
+        if (mismatches) {
+            printf("  %-10s %zu rays differ from brute force\n", set.name, mismatches);
+            result = 1;
+        }
+
+        std::vector<CPUIntersection> intersections(count);
+        for (const Mode & mode : modes) {
+            for (unsigned threadCount : threadCounts) {
+                CPUStreamOptions options;
+                options.packetWidth = mode.packetWidth;
+                options.threadCount = threadCount;
+                options.sort = mode.sort;
+
+                double elapsed = 0.0;
+                for (uint32_t r = 0; r < repeat; r++) {
+                    auto begin = std::chrono::steady_clock::now();
+                    accelerationStructure.intersectStream(set.rays.data(), count, set.mask, set.acceptAny,
+                                                          intersections.data(), options);
+                    elapsed += seconds(begin);
+                }
+                elapsed /= repeat;
+
+                size_t differences = 0;
+                for (size_t i = 0; i < count; i++)
+                    differences += !matches(intersections[i], reference[i], set.acceptAny);
+
+                printf("  %-10s %-9s %7u %10.2f", set.name, mode.name, threadCount, count / elapsed * 1e-6);
+                if (differences)
+                    printf("  %zu DIFFERENT", differences);
+                printf("\n");
+                result |= differences != 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char ** argv) {
+    std::vector<unsigned> threadCounts = { 1, 4 };
+    std::string sceneName;
+    const char * objPath = nullptr;
+    uint32_t triangleCount = 100000;
+    uint32_t width = 512;
+    uint32_t height = 512;
+    uint32_t repeat = 3;
+
+    for (int i = 1; i < argc; i++) {
+        const char * arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(arg, "--scene") && hasValue)
+            sceneName = argv[++i];
+        else if (!strcmp(arg, "--obj") && hasValue)
+            objPath = argv[++i];
+        else if (!strcmp(arg, "--triangles") && hasValue)
+            triangleCount = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--width") && hasValue)
+            width = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--height") && hasValue)
+            height = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--threads") && hasValue)
+            threadCounts = parseList(argv[++i]);
+        else if (!strcmp(arg, "--repeat") && hasValue)
+            repeat = (uint32_t)atoi(argv[++i]);
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (width == 0 || height == 0 || repeat == 0 || threadCounts.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    int result = 0;
+
+    // Draw the light colors the way the sample does.
+    srand(1);
+
+    if (sceneName.empty() || sceneName == "spheres")
+        result |= benchmarkScene("Cornell box with spheres", newInstancedCornellBoxScene(true), width, height, threadCounts, repeat);
+
+    if (sceneName.empty() || sceneName == "triangles")
+        result |= benchmarkScene("Cornell box", newInstancedCornellBoxScene(false), width, height, threadCounts, repeat);
+
+    if (sceneName.empty() || sceneName == "ninja") {
+        CPUGeometry model;
+        if (objPath) {
+            if (!loadOBJ(objPath, model)) {
+                fprintf(stderr, "%s: can't load the model\n", objPath);
+                return 1;
+            }
+        }
+        else {
+            generateModel(triangleCount, model);
+        }
+
+        result |= benchmarkScene(objPath ? "Cornell box with the model" : "Cornell box with a generated model",
+                                 newNinjaScene(model), width, height, threadCounts, repeat);
+    }
+
+    return result;
+}
@@ -0,0 +1,442 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The implementation of the CPU path tracer.
+*/
+
+#include "CPUPathTracer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace {
+
+const unsigned int primes[] = {
+    2,   3,  5,  7,
+    11, 13, 17, 19,
+    23, 29, 31, 37,
+    41, 43, 47, 53,
+    59, 61, 67, 71,
+    73, 79, 83, 89
+};
+
+// The same Halton sequence as the kernel's `halton`.
+float halton(unsigned int i, unsigned int d) {
+    unsigned int b = primes[d];
+
+    float f = 1.0f;
+    float invB = 1.0f / b;
+
+    float r = 0;
+
+    while (i > 0) {
+        f = f * invB;
+        r = r + f * (i % b);
+        i = i / b;
+    }
+
+    return r;
+}
+
+inline float saturate(float x) {
+    return std::min(std::max(x, 0.0f), 1.0f);
+}
+
+inline Vec3 divide(Vec3 a, float s) {
+    return Vec3(a.x / s, a.y / s, a.z / s);
+}
+
+inline Vec3 interpolateVertexAttribute(const Vec3 * attributes, float u, float v) {
+    return (1.0f - u - v) * attributes[0] + u * attributes[1] + v * attributes[2];
+}
+
+inline Vec3 sampleCosineWeightedHemisphere(float u, float v) {
+    float phi = 2.0f * (float)M_PI * u;
+
+    float cos_phi = cosf(phi);
+    float sin_phi = sinf(phi);
+
+    float cos_theta = sqrtf(v);
+    float sin_theta = sqrtf(1.0f - cos_theta * cos_theta);
+
+    return Vec3(sin_theta * cos_phi, cos_theta, sin_theta * sin_phi);
+}
+
+inline void sampleAreaLight(const CPUAreaLight & light, float u, float v, Vec3 position,
+                            Vec3 & lightDirection, Vec3 & lightColor, float & lightDistance)
+{
+    // Map to -1..1
+    u = u * 2.0f - 1.0f;
+    v = v * 2.0f - 1.0f;
+
+    Vec3 samplePosition = light.position + light.right * u + light.up * v;
+
+    lightDirection = samplePosition - position;
+
+    lightDistance = length(lightDirection);
+
+    float inverseLightDistance = 1.0f / std::max(lightDistance, 1e-3f);
+
+    lightDirection *= inverseLightDistance;
+
+    lightColor = light.color;
+    lightColor *= (inverseLightDistance * inverseLightDistance);
+    lightColor *= saturate(dot(-lightDirection, light.forward));
+}
+
+inline Vec3 alignHemisphereWithNormal(Vec3 sample, Vec3 normal) {
+    Vec3 up = normal;
+    Vec3 right = normalize(cross(normal, Vec3(0.0072f, 1.0f, 0.0034f)));
+    Vec3 forward = cross(right, up);
+
+    return sample.x * right + sample.y * up + sample.z * forward;
+}
+
+// Hashes a seed and a pixel index to the pixel's offset into the Halton sequence, in the
+// same range as the random values the sample draws with `rand()`.
+uint32_t pixelOffset(uint32_t seed, uint32_t pixel) {
+    uint32_t x = pixel * 0x9e3779b9u ^ seed;
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x % (1024 * 1024);
+}
+
+void parallelFor(size_t count, unsigned threadCount, const std::function<void(size_t)> & task) {
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = (unsigned)std::min<size_t>(threadCount, count);
+
+    std::atomic<size_t> next(0);
+    const auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+            task(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < threadCount; t++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread & thread : threads)
+        thread.join();
+}
+
+} // namespace
+
+CPUPathTracer::CPUPathTracer(const CPUScene & scene, const CPUPathTracerOptions & options)
+    : _scene(scene)
+    , _options(options)
+{
+    _options.tileSize = std::max(_options.tileSize, 1u);
+
+    CPUBVHBuildOptions buildOptions;
+    buildOptions.threadCount = _options.threadCount;
+    _accelerationStructure.build(scene, buildOptions);
+
+    // Set up the camera the same way as `-[Renderer updateUniforms]`.
+    Vec3 position = scene.cameraPosition;
+    Vec3 target = scene.cameraTarget;
+    Vec3 up = scene.cameraUp;
+
+    Vec3 forward = normalize(target - position);
+    Vec3 right = normalize(cross(forward, up));
+    up = normalize(cross(right, forward));
+
+    float fieldOfView = 45.0f * (M_PI / 180.0f);
+    float aspectRatio = (float)_options.width / (float)_options.height;
+    float imagePlaneHeight = tanf(fieldOfView / 2.0f);
+    float imagePlaneWidth = aspectRatio * imagePlaneHeight;
+
+    _cameraForward = forward;
+    _cameraRight = right * imagePlaneWidth;
+    _cameraUp = up * imagePlaneHeight;
+
+    const size_t pixelCount = (size_t)_options.width * _options.height;
+    _offsets.resize(pixelCount);
+    for (size_t i = 0; i < pixelCount; i++)
+        _offsets[i] = pixelOffset(_options.seed, (uint32_t)i);
+
+    _image.assign(pixelCount * 4, 0.0f);
+    if (_options.adaptiveThreshold > 0.0f)
+        _evenImage.assign(pixelCount * 3, 0.0f);
+
+    for (uint32_t y = 0; y < _options.height; y += _options.tileSize) {
+        for (uint32_t x = 0; x < _options.width; x += _options.tileSize) {
+            _tiles.push_back({ x, y,
+                               std::min(_options.tileSize, _options.width - x),
+                               std::min(_options.tileSize, _options.height - y),
+                               0, false, 0 });
+        }
+    }
+}
+
+// Trace one path for a pixel with the same steps as `raytracingKernel`.
+Vec3 CPUPathTracer::tracePath(uint32_t x, uint32_t y, uint32_t frameIndex, uint64_t & rayCount) const {
+    const unsigned int offset = _offsets[(size_t)y * _options.width + x];
+    const unsigned int lightCount = (unsigned int)_scene.lights.size();
+
+    // Add a random offset to the pixel coordinates for antialiasing.
+    float pixelX = (float)x + halton(offset + frameIndex, 0);
+    float pixelY = (float)y + halton(offset + frameIndex, 1);
+
+    // Map pixel coordinates to -1..1.
+    float u = pixelX / (float)_options.width * 2.0f - 1.0f;
+    float v = pixelY / (float)_options.height * 2.0f - 1.0f;
+
+    CPURay ray;
+    ray.origin = _scene.cameraPosition;
+    ray.direction = normalize(u * _cameraRight + v * _cameraUp + _cameraForward);
+    ray.minDistance = 0.0f;
+    ray.maxDistance = INFINITY;
+
+    Vec3 color(1.0f, 1.0f, 1.0f);
+    Vec3 accumulatedColor(0.0f, 0.0f, 0.0f);
+
+    for (int bounce = 0; bounce < 3; bounce++) {
+        CPUIntersection intersection = _accelerationStructure.intersect(ray, bounce == 0 ? RAY_MASK_PRIMARY : RAY_MASK_SECONDARY, false);
+        rayCount++;
+
+        // Stop if the ray didn't hit anything and has bounced out of the scene.
+        if (intersection.type == CPUIntersectionTypeNone)
+            break;
+
+        const CPUGeometryInstance & instance = _scene.instances[intersection.instanceID];
+        unsigned int mask = instance.mask;
+
+        // If the ray hit a light source, set the color to white, and stop immediately.
+        if (mask == GEOMETRY_MASK_LIGHT) {
+            accumulatedColor = Vec3(1.0f, 1.0f, 1.0f);
+            break;
+        }
+
+        const Transform & objectToWorldSpaceTransform = instance.transform;
+        const CPUGeometry & geometry = _scene.geometries[instance.geometry];
+
+        Vec3 worldSpaceIntersectionPoint = ray.origin + ray.direction * intersection.distance;
+
+        unsigned int primitiveIndex = intersection.primitiveID;
+
+        Vec3 worldSpaceSurfaceNormal(0.0f, 0.0f, 0.0f);
+        Vec3 surfaceColor(0.0f, 0.0f, 0.0f);
+
+        if (mask & GEOMETRY_MASK_TRIANGLE) {
+            Vec3 normals[3];
+            Vec3 colors[3];
+            for (int i = 0; i < 3; i++) {
+                normals[i] = geometry.normals[geometry.indices[primitiveIndex * 3 + i]];
+                colors[i] = geometry.colors[geometry.indices[primitiveIndex * 3 + i]];
+            }
+
+            Vec3 objectSpaceSurfaceNormal = interpolateVertexAttribute(normals, intersection.u, intersection.v);
+            surfaceColor = interpolateVertexAttribute(colors, intersection.u, intersection.v);
+
+            worldSpaceSurfaceNormal = normalize(objectToWorldSpaceTransform.transformDirection(objectSpaceSurfaceNormal));
+        }
+        else if (mask & GEOMETRY_MASK_SPHERE) {
+            const CPUSphere & sphere = geometry.spheres[primitiveIndex];
+
+            Vec3 worldSpaceOrigin = objectToWorldSpaceTransform.transformPoint(sphere.origin);
+            worldSpaceSurfaceNormal = normalize(worldSpaceIntersectionPoint - worldSpaceOrigin);
+            surfaceColor = sphere.color;
+        }
+
+        color *= surfaceColor;
+
+        if (lightCount > 0) {
+            // Choose a random light source to sample.
+            float lightSample = halton(offset + frameIndex, 2 + bounce * 5 + 0);
+            unsigned int lightIndex = std::min((unsigned int)(lightSample * lightCount), lightCount - 1);
+
+            // Choose a random point to sample on the light source.
+            float r0 = halton(offset + frameIndex, 2 + bounce * 5 + 1);
+            float r1 = halton(offset + frameIndex, 2 + bounce * 5 + 2);
+
+            Vec3 worldSpaceLightDirection;
+            Vec3 lightColor;
+            float lightDistance;
+
+            sampleAreaLight(_scene.lights[lightIndex], r0, r1, worldSpaceIntersectionPoint, worldSpaceLightDirection,
+                            lightColor, lightDistance);
+
+            lightColor *= saturate(dot(worldSpaceSurfaceNormal, worldSpaceLightDirection));
+            lightColor *= (float)lightCount;
+
+            // Add the light if nothing lies between the intersection point and the light.
+            CPURay shadowRay;
+            shadowRay.origin = worldSpaceIntersectionPoint + worldSpaceSurfaceNormal * 1e-3f;
+            shadowRay.direction = worldSpaceLightDirection;
+            shadowRay.minDistance = 0.0f;
+            shadowRay.maxDistance = lightDistance - 1e-3f;
+
+            intersection = _accelerationStructure.intersect(shadowRay, RAY_MASK_SHADOW, true);
+            rayCount++;
+
+            if (intersection.type == CPUIntersectionTypeNone)
+                accumulatedColor += lightColor * color;
+        }
+
+        // Continue the path in a cosine weighted direction about the normal.
+        float r0 = halton(offset + frameIndex, 2 + bounce * 5 + 3);
+        float r1 = halton(offset + frameIndex, 2 + bounce * 5 + 4);
+
+        Vec3 worldSpaceSampleDirection = sampleCosineWeightedHemisphere(r0, r1);
+        worldSpaceSampleDirection = alignHemisphereWithNormal(worldSpaceSampleDirection, worldSpaceSurfaceNormal);
+
+        ray.origin = worldSpaceIntersectionPoint + worldSpaceSurfaceNormal * 1e-3f;
+        ray.direction = worldSpaceSampleDirection;
+    }
+
+    return accumulatedColor;
+}
+
+// The mean over a tile's pixels of the difference between the average of all frames and
+// the average of the even frames, relative to the square root of the pixel's brightness.
+float CPUPathTracer::tileError(const Tile & tile) const {
+    float error = 0.0f;
+    for (uint32_t y = tile.y; y < tile.y + tile.height; y++) {
+        for (uint32_t x = tile.x; x < tile.x + tile.width; x++) {
+            const size_t pixel = (size_t)y * _options.width + x;
+            const float * all = &_image[pixel * 4];
+            const float * even = &_evenImage[pixel * 3];
+
+            const float difference = fabsf(all[0] - even[0]) + fabsf(all[1] - even[1]) + fabsf(all[2] - even[2]);
+            error += difference / std::max(sqrtf(all[0] + all[1] + all[2]), 1e-3f);
+        }
+    }
+    return error / (tile.width * tile.height);
+}
+
+void CPUPathTracer::renderTile(Tile & tile, uint32_t frameCount) {
+    const bool adaptive = _options.adaptiveThreshold > 0.0f;
+
+    for (uint32_t frame = 0; frame < frameCount && !tile.converged; frame++) {
+        const uint32_t frameIndex = tile.frameIndex;
+
+        for (uint32_t y = tile.y; y < tile.y + tile.height; y++) {
+            for (uint32_t x = tile.x; x < tile.x + tile.width; x++) {
+                const size_t pixel = (size_t)y * _options.width + x;
+                const Vec3 sample = tracePath(x, y, frameIndex, tile.rayCount);
+
+                // Average this frame's sample with all of the previous frames.
+                float * prevColor = &_image[pixel * 4];
+                Vec3 accumulatedColor = sample;
+                if (frameIndex > 0) {
+                    accumulatedColor += Vec3(prevColor[0], prevColor[1], prevColor[2]) * (float)frameIndex;
+                    accumulatedColor = divide(accumulatedColor, (float)(frameIndex + 1));
+                }
+
+                prevColor[0] = accumulatedColor.x;
+                prevColor[1] = accumulatedColor.y;
+                prevColor[2] = accumulatedColor.z;
+                prevColor[3] = 1.0f;
+
+                // Keep a second average of only the even frames.
+                if (adaptive && frameIndex % 2 == 0) {
+                    float * evenColor = &_evenImage[pixel * 3];
+                    const uint32_t evenIndex = frameIndex / 2;
+
+                    Vec3 evenAccumulatedColor = sample;
+                    if (evenIndex > 0) {
+                        evenAccumulatedColor += Vec3(evenColor[0], evenColor[1], evenColor[2]) * (float)evenIndex;
+                        evenAccumulatedColor = divide(evenAccumulatedColor, (float)(evenIndex + 1));
+                    }
+
+                    evenColor[0] = evenAccumulatedColor.x;
+                    evenColor[1] = evenAccumulatedColor.y;
+                    evenColor[2] = evenAccumulatedColor.z;
+                }
+            }
+        }
+
+        tile.frameIndex++;
+
+        // Stop the tile once the two averages agree, comparing them after the odd frames so
+        // that each has half of the tile's frames.
+        if (adaptive && tile.frameIndex >= _options.adaptiveMinFrames && tile.frameIndex % 2 == 0)
+            tile.converged = tileError(tile) < _options.adaptiveThreshold;
+    }
+}
+
+void CPUPathTracer::render(uint32_t frameCount) {
+    parallelFor(_tiles.size(), _options.threadCount, [&](size_t tile) {
+        renderTile(_tiles[tile], frameCount);
+    });
+}
+
+uint64_t CPUPathTracer::sampleCount() const {
+    uint64_t count = 0;
+    for (const Tile & tile : _tiles)
+        count += (uint64_t)tile.frameIndex * tile.width * tile.height;
+    return count;
+}
+
+uint64_t CPUPathTracer::rayCount() const {
+    uint64_t count = 0;
+    for (const Tile & tile : _tiles)
+        count += tile.rayCount;
+    return count;
+}
+
+uint32_t CPUPathTracer::convergedTileCount() const {
+    uint32_t count = 0;
+    for (const Tile & tile : _tiles)
+        count += tile.converged;
+    return count;
+}
+
+bool CPUPathTracer::writePFM(const char * path) const {
+    FILE * file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    // A negative scale marks little-endian floats. The rows go from the bottom up, the
+    // same order as the kernel's thread positions.
+    fprintf(file, "PF\n%u %u\n-1.0\n", _options.width, _options.height);
+
+    std::vector<float> row(_options.width * 3);
+    bool written = true;
+    for (uint32_t y = 0; y < _options.height && written; y++) {
+        for (uint32_t x = 0; x < _options.width; x++) {
+            const float * pixel = &_image[((size_t)y * _options.width + x) * 4];
+            memcpy(&row[x * 3], pixel, sizeof(float) * 3);
+        }
+        written = fwrite(row.data(), sizeof(float), row.size(), file) == row.size();
+    }
+
+    return fclose(file) == 0 && written;
+}
+
+bool CPUReadPFM(const char * path, std::vector<float> & image, uint32_t & width, uint32_t & height) {
+    FILE * file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    char format[3] = {};
+    float scale = 0.0f;
+    bool read = fscanf(file, "%2s %u %u %f", format, &width, &height, &scale) == 4 &&
+                !strcmp(format, "PF") && scale < 0.0f && fgetc(file) != EOF &&
+                width > 0 && height > 0 && width <= 65536 && height <= 65536;
+
+    if (read) {
+        std::vector<float> row(width * 3);
+        image.assign((size_t)width * height * 4, 1.0f);
+        for (uint32_t y = 0; y < height && read; y++) {
+            read = fread(row.data(), sizeof(float), row.size(), file) == row.size();
+            for (uint32_t x = 0; x < width && read; x++)
+                memcpy(&image[((size_t)y * width + x) * 4], &row[x * 3], sizeof(float) * 3);
+        }
+    }
+
+    fclose(file);
+    return read;
+}
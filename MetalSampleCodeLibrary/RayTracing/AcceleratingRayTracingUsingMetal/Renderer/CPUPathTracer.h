@@ -0,0 +1,102 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The header for the CPU path tracer, which renders the sample's scene with the same integrator
+ as the ray tracing kernel in `Shaders.metal`.
+*/
+
+#ifndef CPUPathTracer_h
+#define CPUPathTracer_h
+
+#include "CPURayTracer.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+struct CPUPathTracerOptions {
+    uint32_t width = 800;
+    uint32_t height = 600;
+
+    // Size of the square tiles that the threads render.
+    uint32_t tileSize = 16;
+
+    // Threads to render on, or 0 for one per core.
+    unsigned threadCount = 0;
+
+    // Seed for the random offset into the Halton sequence that decorrelates each pixel.
+    // Each pixel's offset depends only on the seed and the pixel, so the image doesn't
+    // depend on the number of threads.
+    uint32_t seed = 0;
+
+    // With a threshold above 0, a tile stops once the difference between the average of
+    // all its frames and the average of its even frames, relative to the square root of its
+    // brightness, falls below the threshold.
+    float adaptiveThreshold = 0.0f;
+
+    // Frames a tile renders before it can stop.
+    uint32_t adaptiveMinFrames = 16;
+};
+
+// Renders frames of the scene the way the sample's ray tracing kernel does: up to three
+// bounces with Halton sampling, a shadow ray toward a random point on a random light at each
+// bounce, and progressive accumulation of the frames.
+class CPUPathTracer {
+public:
+    CPUPathTracer(const CPUScene & scene, const CPUPathTracerOptions & options);
+
+    // Render and accumulate frames, like the kernel does once each frame.
+    void render(uint32_t frameCount);
+
+    // The accumulated image, in the same RGBA layout as the kernel's accumulation target,
+    // from the bottom row to the top row.
+    const std::vector<float> & image() const { return _image; }
+
+    uint32_t width() const { return _options.width; }
+    uint32_t height() const { return _options.height; }
+
+    // The paths and rays the tracer has traced.
+    uint64_t sampleCount() const;
+    uint64_t rayCount() const;
+
+    uint32_t tileCount() const { return (uint32_t)_tiles.size(); }
+    uint32_t convergedTileCount() const;
+
+    // Write the accumulated image as a portable float map.
+    bool writePFM(const char * path) const;
+
+private:
+    struct Tile {
+        uint32_t x, y;
+        uint32_t width, height;
+        uint32_t frameIndex;
+        bool converged;
+        uint64_t rayCount;
+    };
+
+    Vec3 tracePath(uint32_t x, uint32_t y, uint32_t frameIndex, uint64_t & rayCount) const;
+    void renderTile(Tile & tile, uint32_t frameCount);
+    float tileError(const Tile & tile) const;
+
+    const CPUScene & _scene;
+    CPUPathTracerOptions _options;
+    CPUAccelerationStructure _accelerationStructure;
+
+    // The camera, scaled to the image plane like the kernel's uniforms.
+    Vec3 _cameraRight;
+    Vec3 _cameraUp;
+    Vec3 _cameraForward;
+
+    std::vector<uint32_t> _offsets;
+    std::vector<Tile> _tiles;
+    std::vector<float> _image;
+
+    // The average of the even frames, for adaptive sampling.
+    std::vector<float> _evenImage;
+};
+
+// Read a portable float map into RGBA.
+bool CPUReadPFM(const char * path, std::vector<float> & image, uint32_t & width, uint32_t & height);
+
+#endif
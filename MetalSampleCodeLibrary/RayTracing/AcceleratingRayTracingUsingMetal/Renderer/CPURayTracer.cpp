@@ -0,0 +1,1027 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The implementation of the CPU ray tracer.
+*/
+
+#include "CPURayTracer.h"
+
+#include <float.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <numeric>
+#include <thread>
+
+namespace {
+
+// Ranges of primitives this small build as independent subtrees on the worker threads.
+const uint32_t SubtreeSize = 4096;
+
+// Ranges this large measure and bin their primitives on the worker threads.
+const uint32_t ParallelRangeSize = 65536;
+const uint32_t ParallelChunkSize = 16384;
+
+// Below this depth, nodes split in the middle rather than by the surface area heuristic,
+// which bounds the depth of the hierarchy and so the size of the traversal stacks.
+const uint32_t MedianSplitDepth = 48;
+const uint32_t MaxStackSize = 128;
+
+const uint32_t MaxBinCount = 32;
+
+// Rays of a stream that sort and trace together.
+const uint32_t StreamWindowSize = 4096;
+
+// Widens the far distance of a box by the rounding error of the slab distances, so that
+// rays can't slip past a flat box or between the boxes of neighboring primitives.
+const float BoxErrorScale = 1.0000004f;
+
+struct Bounds {
+    Vec3 min = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    Vec3 max = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+    void grow(Vec3 p) {
+        min = ::min(min, p);
+        max = ::max(max, p);
+    }
+
+    void grow(const Bounds & bounds) {
+        min = ::min(min, bounds.min);
+        max = ::max(max, bounds.max);
+    }
+
+    float area() const {
+        if (min.x > max.x)
+            return 0.0f;
+
+        const Vec3 extent = max - min;
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+};
+
+unsigned resolveThreadCount(unsigned threadCount) {
+    return threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void parallelFor(size_t count, unsigned threadCount, const std::function<void(size_t)> & task) {
+    threadCount = (unsigned)std::min<size_t>(resolveThreadCount(threadCount), count);
+
+    std::atomic<size_t> next(0);
+    const auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+            task(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < threadCount; t++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread & thread : threads)
+        thread.join();
+}
+
+float reciprocal(float d) {
+    return 1.0f / (fabsf(d) > 1e-20f ? d : copysignf(1e-20f, d));
+}
+
+// Builds a hierarchy by binning the centroids of the primitives along each axis and
+// splitting where the surface area heuristic is lowest.
+class BVHBuilder {
+public:
+    BVHBuilder(const Vec3 * boundsMin, const Vec3 * boundsMax, uint32_t count, const CPUBVHBuildOptions & options)
+        : _boundsMin(boundsMin)
+        , _boundsMax(boundsMax)
+        , _options(options)
+        , _centroids(count)
+    {
+        _options.binCount = std::min(std::max(_options.binCount, 2u), MaxBinCount);
+        _options.maxLeafSize = std::max(_options.maxLeafSize, 1u);
+
+        for (uint32_t i = 0; i < count; i++)
+            _centroids[i] = (boundsMin[i] + boundsMax[i]) * 0.5f;
+    }
+
+    void build(CPUBVH & bvh);
+
+private:
+    struct Range {
+        uint32_t node;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t depth;
+    };
+
+    struct Measure {
+        Bounds bounds;
+        Bounds centroidBounds;
+    };
+
+    struct Bin {
+        Bounds bounds;
+        uint32_t count = 0;
+    };
+
+    struct Split {
+        int axis = -1;
+        uint32_t bin = 0;
+        float cost = FLT_MAX;
+    };
+
+    Measure measure(uint32_t begin, uint32_t end) const;
+    uint32_t binIndex(Vec3 centroid, int axis, const Bounds & centroidBounds) const;
+    Split findSplit(uint32_t begin, uint32_t end, const Measure & measure) const;
+    void buildRanges(std::vector<CPUBVHNode> & nodes, Range root, std::vector<Range> * subtrees);
+
+    const Vec3 * _boundsMin;
+    const Vec3 * _boundsMax;
+    CPUBVHBuildOptions _options;
+    std::vector<Vec3> _centroids;
+    uint32_t * _indices = nullptr;
+};
+
+BVHBuilder::Measure BVHBuilder::measure(uint32_t begin, uint32_t end) const {
+    const auto measureChunk = [&](uint32_t chunkBegin, uint32_t chunkEnd) {
+        Measure measure;
+        for (uint32_t i = chunkBegin; i < chunkEnd; i++) {
+            const uint32_t primitive = _indices[i];
+            measure.bounds.grow(_boundsMin[primitive]);
+            measure.bounds.grow(_boundsMax[primitive]);
+            measure.centroidBounds.grow(_centroids[primitive]);
+        }
+        return measure;
+    };
+
+    if (end - begin < ParallelRangeSize)
+        return measureChunk(begin, end);
+
+    // Minimums and maximums combine in any order, so the result doesn't depend on the threads.
+    std::vector<Measure> chunks((end - begin + ParallelChunkSize - 1) / ParallelChunkSize);
+    parallelFor(chunks.size(), _options.threadCount, [&](size_t chunk) {
+        const uint32_t chunkBegin = begin + (uint32_t)chunk * ParallelChunkSize;
+        chunks[chunk] = measureChunk(chunkBegin, std::min(chunkBegin + ParallelChunkSize, end));
+    });
+
+    Measure measure;
+    for (const Measure & chunk : chunks) {
+        measure.bounds.grow(chunk.bounds);
+        measure.centroidBounds.grow(chunk.centroidBounds);
+    }
+    return measure;
+}
+
+uint32_t BVHBuilder::binIndex(Vec3 centroid, int axis, const Bounds & centroidBounds) const {
+    const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+    const float scale = _options.binCount * (1.0f - 1e-6f) / extent;
+    const int bin = (int)((centroid[axis] - centroidBounds.min[axis]) * scale);
+    return (uint32_t)std::min(std::max(bin, 0), (int)_options.binCount - 1);
+}
+
+BVHBuilder::Split BVHBuilder::findSplit(uint32_t begin, uint32_t end, const Measure & measure) const {
+    const uint32_t binCount = _options.binCount;
+
+    const auto binChunk = [&](uint32_t chunkBegin, uint32_t chunkEnd, Bin * bins) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (measure.centroidBounds.max[axis] <= measure.centroidBounds.min[axis])
+                continue;
+
+            for (uint32_t i = chunkBegin; i < chunkEnd; i++) {
+                const uint32_t primitive = _indices[i];
+                Bin & bin = bins[axis * MaxBinCount + binIndex(_centroids[primitive], axis, measure.centroidBounds)];
+                bin.bounds.grow(_boundsMin[primitive]);
+                bin.bounds.grow(_boundsMax[primitive]);
+                bin.count++;
+            }
+        }
+    };
+
+    Bin bins[3 * MaxBinCount];
+    if (end - begin < ParallelRangeSize) {
+        binChunk(begin, end, bins);
+    }
+    else {
+        const size_t chunkCount = (end - begin + ParallelChunkSize - 1) / ParallelChunkSize;
+        std::vector<Bin> chunkBins(chunkCount * 3 * MaxBinCount);
+        parallelFor(chunkCount, _options.threadCount, [&](size_t chunk) {
+            const uint32_t chunkBegin = begin + (uint32_t)chunk * ParallelChunkSize;
+            binChunk(chunkBegin, std::min(chunkBegin + ParallelChunkSize, end), &chunkBins[chunk * 3 * MaxBinCount]);
+        });
+
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            for (uint32_t i = 0; i < 3 * MaxBinCount; i++) {
+                bins[i].bounds.grow(chunkBins[chunk * 3 * MaxBinCount + i].bounds);
+                bins[i].count += chunkBins[chunk * 3 * MaxBinCount + i].count;
+            }
+        }
+    }
+
+    // Sweep the bins from the right to find the area of each right side, then from the
+    // left to find the cost of each split. Without area, fall back to counts.
+    const float parentArea = measure.bounds.area();
+    const float inverseParentArea = parentArea > 0.0f ? 1.0f / parentArea : 1.0f;
+
+    Split split;
+    for (int axis = 0; axis < 3; axis++) {
+        if (measure.centroidBounds.max[axis] <= measure.centroidBounds.min[axis])
+            continue;
+
+        const Bin * axisBins = &bins[axis * MaxBinCount];
+
+        float rightAreas[MaxBinCount];
+        uint32_t rightCounts[MaxBinCount];
+        Bounds right;
+        uint32_t rightCount = 0;
+        for (uint32_t i = binCount - 1; i > 0; i--) {
+            right.grow(axisBins[i].bounds);
+            rightCount += axisBins[i].count;
+            rightAreas[i] = parentArea > 0.0f ? right.area() : 1.0f;
+            rightCounts[i] = rightCount;
+        }
+
+        Bounds left;
+        uint32_t leftCount = 0;
+        for (uint32_t i = 0; i + 1 < binCount; i++) {
+            left.grow(axisBins[i].bounds);
+            leftCount += axisBins[i].count;
+            if (leftCount == 0 || rightCounts[i + 1] == 0)
+                continue;
+
+            const float leftArea = parentArea > 0.0f ? left.area() : 1.0f;
+            const float cost = _options.traversalCost + _options.intersectionCost * inverseParentArea *
+                               (leftCount * leftArea + rightCounts[i + 1] * rightAreas[i + 1]);
+            if (cost < split.cost) {
+                split.axis = axis;
+                split.bin = i;
+                split.cost = cost;
+            }
+        }
+    }
+    return split;
+}
+
+// Builds the nodes of a range. With `subtrees`, it stops at ranges small enough to build
+// on their own, and leaves them for the caller.
+void BVHBuilder::buildRanges(std::vector<CPUBVHNode> & nodes, Range root, std::vector<Range> * subtrees) {
+    std::vector<Range> stack(1, root);
+    while (!stack.empty()) {
+        const Range range = stack.back();
+        stack.pop_back();
+
+        const uint32_t count = range.end - range.begin;
+        if (subtrees && count <= SubtreeSize && range.node != root.node) {
+            subtrees->push_back(range);
+            continue;
+        }
+
+        const Measure measure = this->measure(range.begin, range.end);
+        nodes[range.node].min = measure.bounds.min;
+        nodes[range.node].max = measure.bounds.max;
+
+        Split split;
+        if (count > 1 && range.depth < MedianSplitDepth)
+            split = findSplit(range.begin, range.end, measure);
+
+        const bool fits = count <= _options.maxLeafSize;
+        if (count <= 1 || (fits && (split.axis < 0 || count * _options.intersectionCost <= split.cost))) {
+            nodes[range.node].childOrFirst = range.begin;
+            nodes[range.node].count = count;
+            continue;
+        }
+
+        uint32_t middle;
+        if (split.axis >= 0) {
+            uint32_t * first = _indices + range.begin;
+            uint32_t * last = _indices + range.end;
+            middle = (uint32_t)(std::partition(first, last, [&](uint32_t primitive) {
+                return binIndex(_centroids[primitive], split.axis, measure.centroidBounds) <= split.bin;
+            }) - _indices);
+        }
+        else {
+            // Split in the middle of the longest axis of the centroids, in a fixed order.
+            const Vec3 extent = measure.centroidBounds.max - measure.centroidBounds.min;
+            const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            middle = range.begin + count / 2;
+            std::nth_element(_indices + range.begin, _indices + middle, _indices + range.end, [&](uint32_t a, uint32_t b) {
+                return _centroids[a][axis] < _centroids[b][axis] || (_centroids[a][axis] == _centroids[b][axis] && a < b);
+            });
+        }
+
+        const uint32_t children = (uint32_t)nodes.size();
+        nodes.resize(children + 2);
+        nodes[range.node].childOrFirst = children;
+        nodes[range.node].count = 0;
+
+        stack.push_back({ children + 1, middle, range.end, range.depth + 1 });
+        stack.push_back({ children, range.begin, middle, range.depth + 1 });
+    }
+}
+
+void BVHBuilder::build(CPUBVH & bvh) {
+    const uint32_t count = (uint32_t)_centroids.size();
+    bvh.nodes.clear();
+    bvh.primitives.resize(count);
+    std::iota(bvh.primitives.begin(), bvh.primitives.end(), 0u);
+    _indices = bvh.primitives.data();
+
+    if (count == 0)
+        return;
+
+    // Build the top of the hierarchy here, measuring and binning large ranges on the worker
+    // threads, and then the subtrees below it on the worker threads.
+    std::vector<Range> subtrees;
+    bvh.nodes.resize(1);
+    buildRanges(bvh.nodes, { 0, 0, count, 0 }, &subtrees);
+
+    std::vector<std::vector<CPUBVHNode>> subtreeNodes(subtrees.size());
+    parallelFor(subtrees.size(), _options.threadCount, [&](size_t i) {
+        Range root = subtrees[i];
+        root.node = 0;
+        subtreeNodes[i].resize(1);
+        buildRanges(subtreeNodes[i], root, nullptr);
+    });
+
+    // Place each subtree's root at its node, and the rest of its nodes at the end.
+    for (size_t i = 0; i < subtrees.size(); i++) {
+        const std::vector<CPUBVHNode> & nodes = subtreeNodes[i];
+        const uint32_t base = (uint32_t)bvh.nodes.size() - 1;
+        for (size_t n = 0; n < nodes.size(); n++) {
+            CPUBVHNode node = nodes[n];
+            if (node.count == 0)
+                node.childOrFirst += base;
+
+            if (n == 0)
+                bvh.nodes[subtrees[i].node] = node;
+            else
+                bvh.nodes.push_back(node);
+        }
+    }
+}
+
+bool intersectBox(const CPUBVHNode & node, Vec3 origin, Vec3 inverseDirection,
+                  float minDistance, float maxDistance, float & distance)
+{
+    const float tx0 = (node.min.x - origin.x) * inverseDirection.x;
+    const float tx1 = (node.max.x - origin.x) * inverseDirection.x;
+    const float ty0 = (node.min.y - origin.y) * inverseDirection.y;
+    const float ty1 = (node.max.y - origin.y) * inverseDirection.y;
+    const float tz0 = (node.min.z - origin.z) * inverseDirection.z;
+    const float tz1 = (node.max.z - origin.z) * inverseDirection.z;
+
+    const float near = std::max(std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::min(tz0, tz1)), minDistance);
+    const float far = std::min(std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::max(tz0, tz1)) * BoxErrorScale, maxDistance);
+
+    distance = near;
+    return near <= far;
+}
+
+struct StackEntry {
+    uint32_t node;
+    float distance;
+};
+
+// Visits the leaves of a hierarchy that a ray reaches, nearest child first, until `leaf`
+// returns true. The leaf may shorten `maxDistance`.
+template <typename Leaf>
+void traverse(const CPUBVH & bvh, Vec3 origin, Vec3 direction, float minDistance, float & maxDistance, Leaf leaf) {
+    if (bvh.nodes.empty())
+        return;
+
+    const Vec3 inverseDirection(reciprocal(direction.x), reciprocal(direction.y), reciprocal(direction.z));
+
+    float distance;
+    if (!intersectBox(bvh.nodes[0], origin, inverseDirection, minDistance, maxDistance, distance))
+        return;
+
+    StackEntry stack[MaxStackSize];
+    uint32_t stackSize = 0;
+    uint32_t index = 0;
+    for (;;) {
+        const CPUBVHNode & node = bvh.nodes[index];
+        if (node.count) {
+            if (leaf(node))
+                return;
+        }
+        else {
+            float distance0, distance1;
+            const uint32_t child = node.childOrFirst;
+            const bool hit0 = intersectBox(bvh.nodes[child], origin, inverseDirection, minDistance, maxDistance, distance0);
+            const bool hit1 = intersectBox(bvh.nodes[child + 1], origin, inverseDirection, minDistance, maxDistance, distance1);
+
+            if (hit0 && hit1) {
+                const bool firstIsNear = distance0 <= distance1;
+                stack[stackSize++] = { firstIsNear ? child + 1 : child, firstIsNear ? distance1 : distance0 };
+                index = firstIsNear ? child : child + 1;
+                continue;
+            }
+            if (hit0 || hit1) {
+                index = hit0 ? child : child + 1;
+                continue;
+            }
+        }
+
+        // Skip the nodes that a closer intersection has moved out of reach.
+        do {
+            if (stackSize == 0)
+                return;
+            stackSize--;
+        } while (stack[stackSize].distance > maxDistance);
+        index = stack[stackSize].node;
+    }
+}
+
+} // namespace
+
+float CPUBVH::cost() const {
+    if (nodes.empty())
+        return 0.0f;
+
+    Bounds root;
+    root.min = nodes[0].min;
+    root.max = nodes[0].max;
+    const float rootArea = root.area() > 0.0f ? root.area() : 1.0f;
+
+    float cost = 0.0f;
+    for (const CPUBVHNode & node : nodes) {
+        Bounds bounds;
+        bounds.min = node.min;
+        bounds.max = node.max;
+        cost += bounds.area() / rootArea * (node.count ? node.count : 1.0f);
+    }
+    return cost;
+}
+
+void CPUBuildBVH(const Vec3 * boundsMin, const Vec3 * boundsMax, uint32_t count,
+                 const CPUBVHBuildOptions & options, CPUBVH & bvh)
+{
+    BVHBuilder builder(boundsMin, boundsMax, count, options);
+    builder.build(bvh);
+}
+
+void CPUAccelerationStructure::build(const CPUScene & scene, const CPUBVHBuildOptions & options) {
+    _geometries.clear();
+    _geometries.resize(scene.geometries.size());
+
+    std::vector<Vec3> boundsMin, boundsMax;
+    for (size_t g = 0; g < scene.geometries.size(); g++) {
+        const CPUGeometry & source = scene.geometries[g];
+        Geometry & geometry = _geometries[g];
+
+        const uint32_t count = source.primitiveCount();
+        boundsMin.resize(count);
+        boundsMax.resize(count);
+
+        if (source.usesIntersectionFunction()) {
+            // The same bounding boxes the sample gives the intersection function.
+            for (uint32_t i = 0; i < count; i++) {
+                const CPUSphere & sphere = source.spheres[i];
+                const Vec3 radius(sphere.radius, sphere.radius, sphere.radius);
+                boundsMin[i] = sphere.origin - radius;
+                boundsMax[i] = sphere.origin + radius;
+            }
+
+            CPUBuildBVH(boundsMin.data(), boundsMax.data(), count, options, geometry.bvh);
+
+            for (uint32_t primitive : geometry.bvh.primitives) {
+                const CPUSphere & sphere = source.spheres[primitive];
+                geometry.spheres.push_back({ sphere.origin, sphere.radius * sphere.radius, primitive });
+            }
+        }
+        else {
+            for (uint32_t i = 0; i < count; i++) {
+                const Vec3 v0 = source.vertices[source.indices[i * 3 + 0]];
+                const Vec3 v1 = source.vertices[source.indices[i * 3 + 1]];
+                const Vec3 v2 = source.vertices[source.indices[i * 3 + 2]];
+                boundsMin[i] = min(min(v0, v1), v2);
+                boundsMax[i] = max(max(v0, v1), v2);
+            }
+
+            CPUBuildBVH(boundsMin.data(), boundsMax.data(), count, options, geometry.bvh);
+
+            for (uint32_t primitive : geometry.bvh.primitives) {
+                const Vec3 v0 = source.vertices[source.indices[primitive * 3 + 0]];
+                const Vec3 v1 = source.vertices[source.indices[primitive * 3 + 1]];
+                const Vec3 v2 = source.vertices[source.indices[primitive * 3 + 2]];
+                geometry.triangles.push_back({ v0, v1 - v0, v2 - v0, primitive });
+            }
+        }
+    }
+
+    // Bound each instance by the corners of its geometry's bounds, and leave out instances
+    // of empty geometry.
+    _instances.clear();
+    std::vector<uint32_t> instanceIndices;
+    boundsMin.clear();
+    boundsMax.clear();
+    for (size_t i = 0; i < scene.instances.size(); i++) {
+        const CPUGeometryInstance & instance = scene.instances[i];
+        _instances.push_back({ instance.transform.inverse(), instance.geometry, instance.mask });
+
+        const CPUBVH & bvh = _geometries[instance.geometry].bvh;
+        if (bvh.nodes.empty())
+            continue;
+
+        Bounds bounds;
+        for (int corner = 0; corner < 8; corner++) {
+            const Vec3 p((corner & 1) ? bvh.nodes[0].max.x : bvh.nodes[0].min.x,
+                         (corner & 2) ? bvh.nodes[0].max.y : bvh.nodes[0].min.y,
+                         (corner & 4) ? bvh.nodes[0].max.z : bvh.nodes[0].min.z);
+            bounds.grow(instance.transform.transformPoint(p));
+        }
+
+        instanceIndices.push_back((uint32_t)i);
+        boundsMin.push_back(bounds.min);
+        boundsMax.push_back(bounds.max);
+    }
+
+    CPUBuildBVH(boundsMin.data(), boundsMax.data(), (uint32_t)instanceIndices.size(), options, _instanceBVH);
+    for (uint32_t & primitive : _instanceBVH.primitives)
+        primitive = instanceIndices[primitive];
+}
+
+size_t CPUAccelerationStructure::nodeCount() const {
+    size_t count = _instanceBVH.nodes.size();
+    for (const Geometry & geometry : _geometries)
+        count += geometry.bvh.nodes.size();
+    return count;
+}
+
+void CPUAccelerationStructure::intersectGeometry(const Geometry & geometry, const CPURay & ray, float & maxDistance,
+                                                 uint32_t instanceID, bool acceptAny, CPUIntersection & intersection) const
+{
+    const Vec3 origin = ray.origin;
+    const Vec3 direction = ray.direction;
+
+    traverse(geometry.bvh, origin, direction, ray.minDistance, maxDistance, [&](const CPUBVHNode & node) {
+        bool hit = false;
+        for (uint32_t i = node.childOrFirst; i < node.childOrFirst + node.count; i++) {
+            if (!geometry.spheres.empty()) {
+                // The same math as the sample's sphere intersection function.
+                const PackedSphere & sphere = geometry.spheres[i];
+                const Vec3 oc = origin - sphere.origin;
+
+                const float a = dot(direction, direction);
+                const float b = 2 * dot(oc, direction);
+                const float c = dot(oc, oc) - sphere.radiusSquared;
+
+                const float disc = b * b - 4 * a * c;
+                if (disc <= 0.0f)
+                    continue;
+
+                const float distance = (-b - sqrtf(disc)) / (2 * a);
+                if (distance >= ray.minDistance && distance <= maxDistance) {
+                    maxDistance = distance;
+                    intersection = { CPUIntersectionTypeBoundingBox, distance, instanceID, sphere.primitiveID, 0.0f, 0.0f };
+                    hit = true;
+                }
+            }
+            else {
+                // Intersect both sides of the triangle, like an intersector without culling.
+                const PackedTriangle & triangle = geometry.triangles[i];
+                const Vec3 p = cross(direction, triangle.e2);
+                const float det = dot(triangle.e1, p);
+                if (det == 0.0f)
+                    continue;
+
+                const float inverseDet = 1.0f / det;
+                const Vec3 t = origin - triangle.v0;
+                const float u = dot(t, p) * inverseDet;
+                if (!(u >= 0.0f && u <= 1.0f))
+                    continue;
+
+                const Vec3 q = cross(t, triangle.e1);
+                const float v = dot(direction, q) * inverseDet;
+                if (!(v >= 0.0f && u + v <= 1.0f))
+                    continue;
+
+                const float distance = dot(triangle.e2, q) * inverseDet;
+                if (distance >= ray.minDistance && distance <= maxDistance) {
+                    maxDistance = distance;
+                    intersection = { CPUIntersectionTypeTriangle, distance, instanceID, triangle.primitiveID, u, v };
+                    hit = true;
+                }
+            }
+
+            if (hit && acceptAny)
+                return true;
+        }
+        return false;
+    });
+}
+
+CPUIntersection CPUAccelerationStructure::intersect(const CPURay & ray, unsigned int mask, bool acceptAny) const {
+    CPUIntersection intersection = { CPUIntersectionTypeNone, 0.0f, 0, 0, 0.0f, 0.0f };
+    float maxDistance = ray.maxDistance;
+
+    traverse(_instanceBVH, ray.origin, ray.direction, ray.minDistance, maxDistance, [&](const CPUBVHNode & node) {
+        for (uint32_t i = node.childOrFirst; i < node.childOrFirst + node.count; i++) {
+            const uint32_t instanceID = _instanceBVH.primitives[i];
+            const Instance & instance = _instances[instanceID];
+            if ((instance.mask & mask) == 0)
+                continue;
+
+            // Intersect the geometry in object space. The distances along the transformed
+            // direction, which keeps its length, are the same as in world space.
+            CPURay objectRay = ray;
+            objectRay.origin = instance.worldToObject.transformPoint(ray.origin);
+            objectRay.direction = instance.worldToObject.transformDirection(ray.direction);
+
+            intersectGeometry(_geometries[instance.geometry], objectRay, maxDistance, instanceID, acceptAny, intersection);
+            if (acceptAny && intersection.type != CPUIntersectionTypeNone)
+                return true;
+        }
+        return false;
+    });
+
+    return intersection;
+}
+
+#define ALWAYS_INLINE __attribute__((always_inline))
+
+// The 8-wide vectors only pass by value through the always inlined helpers below, so GCC's
+// warning that passing them without AVX changes the ABI doesn't apply. GCC reports it at the
+// end of the file, so it stays off from here on.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+template <int N> struct SIMDTypes;
+
+template <> struct SIMDTypes<4> {
+    typedef float Float __attribute__((vector_size(16)));
+    typedef int32_t Int __attribute__((vector_size(16)));
+};
+
+template <> struct SIMDTypes<8> {
+    typedef float Float __attribute__((vector_size(32)));
+    typedef int32_t Int __attribute__((vector_size(32)));
+};
+
+// Traverses the hierarchies with a packet of N rays, one in each SIMD lane. The lanes
+// visit a node when any of them reaches it, and the same math as the single ray path
+// runs in every lane.
+template <int N>
+struct CPUPacketTraversal {
+    typedef typename SIMDTypes<N>::Float Float;
+    typedef typename SIMDTypes<N>::Int Int;
+    typedef CPUAccelerationStructure::Geometry Geometry;
+
+    struct Rays {
+        Float ox, oy, oz;
+        Float dx, dy, dz;
+        Float rx, ry, rz;
+        Float minDistance;
+        Float maxDistance;
+        Int active;
+    };
+
+    ALWAYS_INLINE static Float splat(float value) {
+        return Float{} + value;
+    }
+
+    ALWAYS_INLINE static Float select(const Int & mask, const Float & a, const Float & b) {
+        return (Float)((mask & (Int)a) | (~mask & (Int)b));
+    }
+
+    ALWAYS_INLINE static Float vmin(const Float & a, const Float & b) { return select(a < b, a, b); }
+    ALWAYS_INLINE static Float vmax(const Float & a, const Float & b) { return select(a > b, a, b); }
+
+    ALWAYS_INLINE static bool any(const Int & mask) {
+        uint64_t words[N / 2];
+        memcpy(words, &mask, sizeof(mask));
+
+        uint64_t result = 0;
+        for (int i = 0; i < N / 2; i++)
+            result |= words[i];
+        return result != 0;
+    }
+
+    ALWAYS_INLINE static Float reciprocal(const Float & d) {
+        const Int sign = (Int)d & splatInt((int32_t)0x80000000);
+        const Float magnitude = (Float)((Int)d & splatInt(0x7fffffff));
+        const Float tiny = (Float)(sign | (Int)splat(1e-20f));
+        return splat(1.0f) / select(magnitude > splat(1e-20f), d, tiny);
+    }
+
+    ALWAYS_INLINE static Int splatInt(int32_t value) {
+        return Int{} + value;
+    }
+
+    ALWAYS_INLINE static void updateReciprocals(Rays & rays) {
+        rays.rx = reciprocal(rays.dx);
+        rays.ry = reciprocal(rays.dy);
+        rays.rz = reciprocal(rays.dz);
+    }
+
+    ALWAYS_INLINE static Int intersectBox(const CPUBVHNode & node, const Rays & rays, Float & distance) {
+        const Float tx0 = (splat(node.min.x) - rays.ox) * rays.rx;
+        const Float tx1 = (splat(node.max.x) - rays.ox) * rays.rx;
+        const Float ty0 = (splat(node.min.y) - rays.oy) * rays.ry;
+        const Float ty1 = (splat(node.max.y) - rays.oy) * rays.ry;
+        const Float tz0 = (splat(node.min.z) - rays.oz) * rays.rz;
+        const Float tz1 = (splat(node.max.z) - rays.oz) * rays.rz;
+
+        const Float near = vmax(vmax(vmax(vmin(tx0, tx1), vmin(ty0, ty1)), vmin(tz0, tz1)), rays.minDistance);
+        const Float far = vmin(vmin(vmin(vmax(tx0, tx1), vmax(ty0, ty1)), vmax(tz0, tz1)) * splat(BoxErrorScale), rays.maxDistance);
+
+        distance = near;
+        return rays.active & (near <= far);
+    }
+
+    // The nearest distance at which any lane in `mask` enters a box.
+    ALWAYS_INLINE static float nearest(const Int & mask, const Float & distance) {
+        float result = FLT_MAX;
+        for (int i = 0; i < N; i++)
+            result = mask[i] ? std::min(result, distance[i]) : result;
+        return result;
+    }
+
+    // Visits the leaves that any active lane reaches, until `leaf` returns true.
+    template <typename Leaf>
+    static void traverse(const CPUBVH & bvh, Rays & rays, Leaf leaf) {
+        if (bvh.nodes.empty())
+            return;
+
+        Float distance;
+        if (!any(intersectBox(bvh.nodes[0], rays, distance)))
+            return;
+
+        uint32_t stack[MaxStackSize];
+        uint32_t stackSize = 0;
+        uint32_t index = 0;
+        for (;;) {
+            const CPUBVHNode & node = bvh.nodes[index];
+            if (node.count) {
+                if (leaf(node))
+                    return;
+            }
+            else {
+                Float distance0, distance1;
+                const uint32_t child = node.childOrFirst;
+                const Int hit0 = intersectBox(bvh.nodes[child], rays, distance0);
+                const Int hit1 = intersectBox(bvh.nodes[child + 1], rays, distance1);
+                const bool any0 = any(hit0);
+                const bool any1 = any(hit1);
+
+                if (any0 && any1) {
+                    const bool firstIsNear = nearest(hit0, distance0) <= nearest(hit1, distance1);
+                    stack[stackSize++] = firstIsNear ? child + 1 : child;
+                    index = firstIsNear ? child : child + 1;
+                    continue;
+                }
+                if (any0 || any1) {
+                    index = any0 ? child : child + 1;
+                    continue;
+                }
+            }
+
+            // Skip the nodes that closer intersections have moved out of reach of every lane.
+            do {
+                if (stackSize == 0)
+                    return;
+                index = stack[--stackSize];
+            } while (!any(intersectBox(bvh.nodes[index], rays, distance)));
+        }
+    }
+
+    static void intersectGeometry(const Geometry & geometry, Rays & rays, uint32_t instanceID, bool acceptAny,
+                                  CPUIntersection * intersections)
+    {
+        traverse(geometry.bvh, rays, [&](const CPUBVHNode & node) {
+            for (uint32_t i = node.childOrFirst; i < node.childOrFirst + node.count; i++) {
+                Int hit;
+                Float distance, u, v;
+
+                if (!geometry.spheres.empty()) {
+                    const CPUAccelerationStructure::PackedSphere & sphere = geometry.spheres[i];
+                    const Float ocx = rays.ox - splat(sphere.origin.x);
+                    const Float ocy = rays.oy - splat(sphere.origin.y);
+                    const Float ocz = rays.oz - splat(sphere.origin.z);
+
+                    const Float a = rays.dx * rays.dx + rays.dy * rays.dy + rays.dz * rays.dz;
+                    const Float b = splat(2) * (ocx * rays.dx + ocy * rays.dy + ocz * rays.dz);
+                    const Float c = (ocx * ocx + ocy * ocy + ocz * ocz) - splat(sphere.radiusSquared);
+
+                    const Float disc = b * b - splat(4) * a * c;
+                    hit = rays.active & (disc > splat(0.0f));
+                    if (!any(hit))
+                        continue;
+
+                    Float root;
+                    for (int lane = 0; lane < N; lane++)
+                        root[lane] = sqrtf(std::max(disc[lane], 0.0f));
+
+                    distance = (-b - root) / (splat(2) * a);
+                    u = v = splat(0.0f);
+                }
+                else {
+                    const CPUAccelerationStructure::PackedTriangle & triangle = geometry.triangles[i];
+                    const Float e1x = splat(triangle.e1.x), e1y = splat(triangle.e1.y), e1z = splat(triangle.e1.z);
+                    const Float e2x = splat(triangle.e2.x), e2y = splat(triangle.e2.y), e2z = splat(triangle.e2.z);
+
+                    const Float px = rays.dy * e2z - rays.dz * e2y;
+                    const Float py = rays.dz * e2x - rays.dx * e2z;
+                    const Float pz = rays.dx * e2y - rays.dy * e2x;
+                    const Float det = e1x * px + e1y * py + e1z * pz;
+                    hit = rays.active & (det != splat(0.0f));
+                    if (!any(hit))
+                        continue;
+
+                    const Float inverseDet = splat(1.0f) / select(hit, det, splat(1.0f));
+                    const Float tx = rays.ox - splat(triangle.v0.x);
+                    const Float ty = rays.oy - splat(triangle.v0.y);
+                    const Float tz = rays.oz - splat(triangle.v0.z);
+                    u = (tx * px + ty * py + tz * pz) * inverseDet;
+                    hit &= (u >= splat(0.0f)) & (u <= splat(1.0f));
+
+                    const Float qx = ty * e1z - tz * e1y;
+                    const Float qy = tz * e1x - tx * e1z;
+                    const Float qz = tx * e1y - ty * e1x;
+                    v = (rays.dx * qx + rays.dy * qy + rays.dz * qz) * inverseDet;
+                    hit &= (v >= splat(0.0f)) & (u + v <= splat(1.0f));
+
+                    distance = (e2x * qx + e2y * qy + e2z * qz) * inverseDet;
+                }
+
+                hit &= (distance >= rays.minDistance) & (distance <= rays.maxDistance);
+                if (!any(hit))
+                    continue;
+
+                rays.maxDistance = select(hit, distance, rays.maxDistance);
+                const CPUIntersectionType type = geometry.spheres.empty() ? CPUIntersectionTypeTriangle : CPUIntersectionTypeBoundingBox;
+                const uint32_t primitiveID = geometry.spheres.empty() ? geometry.triangles[i].primitiveID : geometry.spheres[i].primitiveID;
+                for (int lane = 0; lane < N; lane++) {
+                    if (hit[lane])
+                        intersections[lane] = { type, distance[lane], instanceID, primitiveID, u[lane], v[lane] };
+                }
+
+                // A lane that accepts any intersection is done with its first.
+                if (acceptAny) {
+                    rays.active &= ~hit;
+                    if (!any(rays.active))
+                        return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    static void intersect(const CPUAccelerationStructure & accelerationStructure, const CPURay * source, uint32_t count,
+                          unsigned int mask, bool acceptAny, CPUIntersection * intersections)
+    {
+        Rays rays;
+        for (int lane = 0; lane < N; lane++) {
+            const CPURay & ray = source[std::min((uint32_t)lane, count - 1)];
+            rays.ox[lane] = ray.origin.x;
+            rays.oy[lane] = ray.origin.y;
+            rays.oz[lane] = ray.origin.z;
+            rays.dx[lane] = ray.direction.x;
+            rays.dy[lane] = ray.direction.y;
+            rays.dz[lane] = ray.direction.z;
+            rays.minDistance[lane] = ray.minDistance;
+            rays.maxDistance[lane] = ray.maxDistance;
+            rays.active[lane] = (uint32_t)lane < count ? -1 : 0;
+        }
+        updateReciprocals(rays);
+
+        CPUIntersection results[N];
+        for (int lane = 0; lane < N; lane++)
+            results[lane] = { CPUIntersectionTypeNone, 0.0f, 0, 0, 0.0f, 0.0f };
+
+        const CPUBVH & instanceBVH = accelerationStructure._instanceBVH;
+        traverse(instanceBVH, rays, [&](const CPUBVHNode & node) {
+            for (uint32_t i = node.childOrFirst; i < node.childOrFirst + node.count; i++) {
+                const uint32_t instanceID = instanceBVH.primitives[i];
+                const CPUAccelerationStructure::Instance & instance = accelerationStructure._instances[instanceID];
+                if ((instance.mask & mask) == 0)
+                    continue;
+
+                // Transform the packet to object space, keeping the lanes' distances.
+                const Transform & m = instance.worldToObject;
+                Rays objectRays = rays;
+                objectRays.ox = splat(m.columns[0].x) * rays.ox + splat(m.columns[1].x) * rays.oy + splat(m.columns[2].x) * rays.oz + splat(m.columns[3].x);
+                objectRays.oy = splat(m.columns[0].y) * rays.ox + splat(m.columns[1].y) * rays.oy + splat(m.columns[2].y) * rays.oz + splat(m.columns[3].y);
+                objectRays.oz = splat(m.columns[0].z) * rays.ox + splat(m.columns[1].z) * rays.oy + splat(m.columns[2].z) * rays.oz + splat(m.columns[3].z);
+                objectRays.dx = splat(m.columns[0].x) * rays.dx + splat(m.columns[1].x) * rays.dy + splat(m.columns[2].x) * rays.dz;
+                objectRays.dy = splat(m.columns[0].y) * rays.dx + splat(m.columns[1].y) * rays.dy + splat(m.columns[2].y) * rays.dz;
+                objectRays.dz = splat(m.columns[0].z) * rays.dx + splat(m.columns[1].z) * rays.dy + splat(m.columns[2].z) * rays.dz;
+                updateReciprocals(objectRays);
+
+                intersectGeometry(accelerationStructure._geometries[instance.geometry], objectRays, instanceID, acceptAny, results);
+
+                rays.maxDistance = objectRays.maxDistance;
+                rays.active = objectRays.active;
+                if (!any(rays.active))
+                    return true;
+            }
+            return false;
+        });
+
+        for (uint32_t lane = 0; lane < count; lane++)
+            intersections[lane] = results[lane];
+    }
+};
+
+void CPUAccelerationStructure::intersectPacket(const CPURay * rays, uint32_t count, uint32_t width, unsigned int mask,
+                                               bool acceptAny, CPUIntersection * intersections) const
+{
+    if (count == 0)
+        return;
+
+    if (width == 8)
+        CPUPacketTraversal<8>::intersect(*this, rays, std::min(count, 8u), mask, acceptAny, intersections);
+    else
+        CPUPacketTraversal<4>::intersect(*this, rays, std::min(count, 4u), mask, acceptAny, intersections);
+}
+
+// Interleaves the low 5 bits of a value with two zero bits between each.
+static uint32_t spreadBits(uint32_t x) {
+    x &= 0x1f;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+void CPUAccelerationStructure::intersectStream(const CPURay * rays, size_t count, unsigned int mask, bool acceptAny,
+                                               CPUIntersection * intersections, const CPUStreamOptions & options) const
+{
+    const uint32_t width = options.packetWidth >= 8 ? 8 : (options.packetWidth >= 4 ? 4 : 1);
+
+    // Quantize the origins to a grid of 32 cells on each axis of their bounds for sorting.
+    Bounds bounds;
+    if (options.sort) {
+        for (size_t i = 0; i < count; i++)
+            bounds.grow(rays[i].origin);
+    }
+
+    const Vec3 extent = bounds.max - bounds.min;
+    const Vec3 scale(extent.x > 0.0f ? 31.0f / extent.x : 0.0f,
+                     extent.y > 0.0f ? 31.0f / extent.y : 0.0f,
+                     extent.z > 0.0f ? 31.0f / extent.z : 0.0f);
+
+    // Trace windows of the stream on the threads. With sorting, order each window's rays by
+    // the octant of their direction, then along a Morton curve through their origins, so that
+    // neighboring rays start close together and head the same way. Sorting within windows
+    // keeps it cheap, and the stable sort leaves rays that are already in a coherent order,
+    // like primary rays, close to that order.
+    parallelFor((count + StreamWindowSize - 1) / StreamWindowSize, options.threadCount, [&](size_t window) {
+        const size_t first = window * StreamWindowSize;
+        const uint32_t windowSize = (uint32_t)std::min<size_t>(StreamWindowSize, count - first);
+
+        uint16_t order[StreamWindowSize];
+        for (uint32_t i = 0; i < windowSize; i++)
+            order[i] = (uint16_t)i;
+
+        if (options.sort) {
+            uint32_t keys[StreamWindowSize];
+            uint32_t runs = 0;
+            for (uint32_t i = 0; i < windowSize; i++) {
+                const CPURay & ray = rays[first + i];
+                const Vec3 p = (ray.origin - bounds.min) * scale;
+                const uint32_t octant = (ray.direction.x < 0.0f) | ((ray.direction.y < 0.0f) << 1) | ((ray.direction.z < 0.0f) << 2);
+                const uint32_t morton = spreadBits((uint32_t)p.x) | (spreadBits((uint32_t)p.y) << 1) | (spreadBits((uint32_t)p.z) << 2);
+                keys[i] = (octant << 15) | morton;
+                runs += i == 0 || keys[i] != keys[i - 1];
+            }
+
+            // Radix sort the 18 bit keys, 9 bits at a time, unless the rays already come in
+            // runs at least a packet long.
+            uint16_t sorted[StreamWindowSize];
+            for (uint32_t shift = 0; runs * width > windowSize && shift < 18; shift += 9) {
+                uint32_t offsets[513] = {};
+                for (uint32_t i = 0; i < windowSize; i++)
+                    offsets[((keys[order[i]] >> shift) & 511) + 1]++;
+                for (uint32_t bucket = 1; bucket < 513; bucket++)
+                    offsets[bucket] += offsets[bucket - 1];
+                for (uint32_t i = 0; i < windowSize; i++)
+                    sorted[offsets[(keys[order[i]] >> shift) & 511]++] = order[i];
+                memcpy(order, sorted, windowSize * sizeof(uint16_t));
+            }
+        }
+
+        CPURay packetRays[8];
+        CPUIntersection packetIntersections[8];
+        for (uint32_t packet = 0; packet < windowSize; packet += width) {
+            const uint32_t packetSize = std::min(width, windowSize - packet);
+
+            if (width == 1) {
+                const size_t index = first + order[packet];
+                intersections[index] = intersect(rays[index], mask, acceptAny);
+                continue;
+            }
+
+            for (uint32_t i = 0; i < packetSize; i++)
+                packetRays[i] = rays[first + order[packet + i]];
+
+            intersectPacket(packetRays, packetSize, width, mask, acceptAny, packetIntersections);
+
+            for (uint32_t i = 0; i < packetSize; i++)
+                intersections[first + order[packet + i]] = packetIntersections[i];
+        }
+    });
+}
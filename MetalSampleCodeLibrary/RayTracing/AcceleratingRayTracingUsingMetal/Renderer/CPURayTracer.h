@@ -0,0 +1,157 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The header for the CPU ray tracer, which builds bounding volume hierarchies for the sample's
+ scene and intersects rays with them the way the Metal intersector does.
+*/
+
+#ifndef CPURayTracer_h
+#define CPURayTracer_h
+
+#include "CPUScene.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+struct CPURay {
+    Vec3 origin;
+    float minDistance;
+    Vec3 direction;
+    float maxDistance;
+};
+
+enum CPUIntersectionType : uint32_t {
+    CPUIntersectionTypeNone,
+    CPUIntersectionTypeTriangle,
+    CPUIntersectionTypeBoundingBox,
+};
+
+// The result of an intersection, with the same fields as the intersector's result type.
+struct CPUIntersection {
+    CPUIntersectionType type;
+    float distance;
+    uint32_t instanceID;
+    uint32_t primitiveID;
+
+    // The triangle's barycentric coordinates, which weight its second and third vertices.
+    float u;
+    float v;
+};
+
+// A node of a bounding volume hierarchy. An interior node has two children at
+// `childOrFirst` and `childOrFirst + 1`, and a leaf has `count` primitives from `childOrFirst`.
+struct CPUBVHNode {
+    Vec3 min;
+    uint32_t childOrFirst;
+    Vec3 max;
+    uint32_t count;
+};
+
+struct CPUBVH {
+    std::vector<CPUBVHNode> nodes;
+
+    // The primitives in the order of the leaves.
+    std::vector<uint32_t> primitives;
+
+    // The expected cost of a ray, by the surface area heuristic.
+    float cost() const;
+};
+
+struct CPUBVHBuildOptions {
+    // Threads to build on, or 0 for one per core.
+    unsigned threadCount = 0;
+
+    // Bins for each axis when searching for the cheapest split.
+    uint32_t binCount = 16;
+
+    // Largest number of primitives in a leaf.
+    uint32_t maxLeafSize = 4;
+
+    // Costs of visiting a node and of intersecting a primitive, relative to each other.
+    float traversalCost = 1.0f;
+    float intersectionCost = 1.0f;
+};
+
+// Build a bounding volume hierarchy over boxes with the surface area heuristic, binning the
+// centroids of the boxes. The hierarchy doesn't depend on the number of threads.
+void CPUBuildBVH(const Vec3 * boundsMin, const Vec3 * boundsMax, uint32_t count,
+                 const CPUBVHBuildOptions & options, CPUBVH & bvh);
+
+struct CPUStreamOptions {
+    // Rays to trace together: 1, 4, or 8.
+    uint32_t packetWidth = 8;
+
+    // Threads to trace on, or 0 for one per core.
+    unsigned threadCount = 0;
+
+    // Sort the rays by direction and origin before tracing, so that each packet's rays
+    // take similar paths through the hierarchy.
+    bool sort = true;
+};
+
+// A two-level acceleration structure over a scene: a primitive hierarchy for each piece
+// of geometry, and an instance hierarchy over the instances. Like the sample's instance
+// acceleration structure, it skips instances whose mask shares no bits with the ray's mask,
+// and it intersects spheres the way the sample's sphere intersection function does.
+class CPUAccelerationStructure {
+public:
+    void build(const CPUScene & scene, const CPUBVHBuildOptions & options);
+
+    // Find the closest intersection or, with `acceptAny`, any intersection, like an
+    // intersector with `accept_any_intersection`.
+    CPUIntersection intersect(const CPURay & ray, unsigned int mask, bool acceptAny) const;
+
+    // Intersect up to `width` rays at once, where `width` is 4 or 8, using a SIMD lane for each ray.
+    void intersectPacket(const CPURay * rays, uint32_t count, uint32_t width, unsigned int mask, bool acceptAny,
+                         CPUIntersection * intersections) const;
+
+    // Intersect a stream of rays in packets on several threads.
+    void intersectStream(const CPURay * rays, size_t count, unsigned int mask, bool acceptAny,
+                         CPUIntersection * intersections, const CPUStreamOptions & options) const;
+
+    size_t nodeCount() const;
+
+    const CPUBVH & instanceBVH() const { return _instanceBVH; }
+    const CPUBVH & primitiveBVH(uint32_t geometry) const { return _geometries[geometry].bvh; }
+
+private:
+    struct PackedTriangle {
+        Vec3 v0;
+        Vec3 e1;
+        Vec3 e2;
+        uint32_t primitiveID;
+    };
+
+    struct PackedSphere {
+        Vec3 origin;
+        float radiusSquared;
+        uint32_t primitiveID;
+    };
+
+    // The primitives of a piece of geometry, in the order of its hierarchy's leaves.
+    struct Geometry {
+        CPUBVH bvh;
+        std::vector<PackedTriangle> triangles;
+        std::vector<PackedSphere> spheres;
+    };
+
+    struct Instance {
+        Transform worldToObject;
+        uint32_t geometry;
+        unsigned int mask;
+    };
+
+    template <int N> friend struct CPUPacketTraversal;
+
+    void intersectGeometry(const Geometry & geometry, const CPURay & ray, float & maxDistance,
+                           uint32_t instanceID, bool acceptAny, CPUIntersection & intersection) const;
+
+    std::vector<Geometry> _geometries;
+    std::vector<Instance> _instances;
+    CPUBVH _instanceBVH;
+};
+
+#endif
@@ -0,0 +1,240 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The implementation of the portable description of the sample's scene.
+*/
+
+#include "CPUScene.h"
+
+#include <stdlib.h>
+
+Transform Transform::inverse() const {
+    const Vec3 & a = columns[0];
+    const Vec3 & b = columns[1];
+    const Vec3 & c = columns[2];
+
+    // The rows of the inverse of the 3x3 part are the cross products of its columns,
+    // divided by its determinant.
+    const Vec3 r0 = cross(b, c);
+    const Vec3 r1 = cross(c, a);
+    const Vec3 r2 = cross(a, b);
+    const float inverseDeterminant = 1.0f / dot(a, r0);
+
+    Transform result;
+    result.columns[0] = Vec3(r0.x, r1.x, r2.x) * inverseDeterminant;
+    result.columns[1] = Vec3(r0.y, r1.y, r2.y) * inverseDeterminant;
+    result.columns[2] = Vec3(r0.z, r1.z, r2.z) * inverseDeterminant;
+    result.columns[3] = -result.transformDirection(columns[3]);
+    return result;
+}
+
+Transform operator*(const Transform & a, const Transform & b) {
+    Transform result;
+    for (int i = 0; i < 3; i++)
+        result.columns[i] = a.transformDirection(b.columns[i]);
+    result.columns[3] = a.transformPoint(b.columns[3]);
+    return result;
+}
+
+Transform transformIdentity() {
+    return transformScale(1.0f, 1.0f, 1.0f);
+}
+
+Transform transformTranslation(float tx, float ty, float tz) {
+    Transform result = transformIdentity();
+    result.columns[3] = Vec3(tx, ty, tz);
+    return result;
+}
+
+Transform transformRotation(float radians, Vec3 axis) {
+    axis = normalize(axis);
+    float ct = cosf(radians);
+    float st = sinf(radians);
+    float ci = 1 - ct;
+    float x = axis.x, y = axis.y, z = axis.z;
+
+    Transform result;
+    result.columns[0] = Vec3(ct + x * x * ci,     y * x * ci + z * st, z * x * ci - y * st);
+    result.columns[1] = Vec3(x * y * ci - z * st,     ct + y * y * ci, z * y * ci + x * st);
+    result.columns[2] = Vec3(x * z * ci + y * st, y * z * ci - x * st,     ct + z * z * ci);
+    result.columns[3] = Vec3(0.0f, 0.0f, 0.0f);
+    return result;
+}
+
+Transform transformScale(float sx, float sy, float sz) {
+    Transform result;
+    result.columns[0] = Vec3(sx, 0.0f, 0.0f);
+    result.columns[1] = Vec3(0.0f, sy, 0.0f);
+    result.columns[2] = Vec3(0.0f, 0.0f, sz);
+    result.columns[3] = Vec3(0.0f, 0.0f, 0.0f);
+    return result;
+}
+
+static Vec3 getTriangleNormal(Vec3 v0, Vec3 v1, Vec3 v2) {
+    Vec3 e1 = normalize(v1 - v0);
+    Vec3 e2 = normalize(v2 - v0);
+
+    return cross(e1, e2);
+}
+
+// Add a face the same way as `-[TriangleGeometry addCubeFaceWithCubeVertices:...]`.
+static void addCubeFace(CPUGeometry & geometry, const Vec3 * cubeVertices, Vec3 color,
+                        int i0, int i1, int i2, int i3, bool inwardNormals)
+{
+    const Vec3 v0 = cubeVertices[i0];
+    const Vec3 v1 = cubeVertices[i1];
+    const Vec3 v2 = cubeVertices[i2];
+    const Vec3 v3 = cubeVertices[i3];
+
+    Vec3 n0 = getTriangleNormal(v0, v1, v2);
+    Vec3 n1 = getTriangleNormal(v0, v2, v3);
+
+    if (inwardNormals) {
+        n0 = -n0;
+        n1 = -n1;
+    }
+
+    const uint32_t baseIndex = (uint32_t)geometry.vertices.size();
+    const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+    for (uint32_t index : indices)
+        geometry.indices.push_back(baseIndex + index);
+
+    geometry.vertices.push_back(v0);
+    geometry.vertices.push_back(v1);
+    geometry.vertices.push_back(v2);
+    geometry.vertices.push_back(v3);
+
+    geometry.normals.push_back(normalize(n0 + n1));
+    geometry.normals.push_back(n0);
+    geometry.normals.push_back(normalize(n0 + n1));
+    geometry.normals.push_back(n1);
+
+    for (int i = 0; i < 4; i++)
+        geometry.colors.push_back(color);
+}
+
+void CPUGeometry::addCubeWithFaces(unsigned int faceMask, Vec3 color, const Transform & transform, bool inwardNormals) {
+    Vec3 cubeVertices[] = {
+        Vec3(-0.5f, -0.5f, -0.5f),
+        Vec3( 0.5f, -0.5f, -0.5f),
+        Vec3(-0.5f,  0.5f, -0.5f),
+        Vec3( 0.5f,  0.5f, -0.5f),
+        Vec3(-0.5f, -0.5f,  0.5f),
+        Vec3( 0.5f, -0.5f,  0.5f),
+        Vec3(-0.5f,  0.5f,  0.5f),
+        Vec3( 0.5f,  0.5f,  0.5f),
+    };
+
+    for (int i = 0; i < 8; i++)
+        cubeVertices[i] = transform.transformPoint(cubeVertices[i]);
+
+    const int cubeIndices[][4] = {
+        { 0, 4, 6, 2 },
+        { 1, 3, 7, 5 },
+        { 0, 1, 5, 4 },
+        { 2, 6, 7, 3 },
+        { 0, 2, 3, 1 },
+        { 4, 5, 7, 6 }
+    };
+
+    for (unsigned face = 0; face < 6; face++) {
+        if (faceMask & (1 << face)) {
+            addCubeFace(*this, cubeVertices, color,
+                        cubeIndices[face][0], cubeIndices[face][1], cubeIndices[face][2], cubeIndices[face][3],
+                        inwardNormals);
+        }
+    }
+}
+
+void CPUGeometry::addSphereWithOrigin(Vec3 origin, float radius, Vec3 color) {
+    CPUSphere sphere;
+
+    sphere.origin = origin;
+    sphere.radius = radius;
+    sphere.color = color;
+
+    spheres.push_back(sphere);
+}
+
+CPUScene newInstancedCornellBoxScene(bool useIntersectionFunctions) {
+    CPUScene scene;
+
+    // Set up the camera.
+    scene.cameraPosition = Vec3(0.0f, 1.0f, 10.0f);
+    scene.cameraTarget = Vec3(0.0f, 1.0f, 0.0f);
+    scene.cameraUp = Vec3(0.0f, 1.0f, 0.0f);
+
+    // Geometry 0 is the light source, and geometry 1 the Cornell box.
+    scene.geometries.resize(useIntersectionFunctions ? 3 : 2);
+    CPUGeometry & lightMesh = scene.geometries[0];
+    CPUGeometry & geometryMesh = scene.geometries[1];
+
+    Transform transform = transformTranslation(0.0f, 1.0f, 0.0f) * transformScale(0.5f, 1.98f, 0.5f);
+
+    // Add the light source.
+    lightMesh.addCubeWithFaces(FACE_MASK_POSITIVE_Y, Vec3(1.0f, 1.0f, 1.0f), transform, true);
+
+    transform = transformTranslation(0.0f, 1.0f, 0.0f) * transformScale(2.0f, 2.0f, 2.0f);
+
+    // Add the top, bottom, and back walls.
+    geometryMesh.addCubeWithFaces(FACE_MASK_NEGATIVE_Y | FACE_MASK_POSITIVE_Y | FACE_MASK_NEGATIVE_Z,
+                                  Vec3(0.725f, 0.71f, 0.68f), transform, true);
+
+    // Add the left wall.
+    geometryMesh.addCubeWithFaces(FACE_MASK_NEGATIVE_X, Vec3(0.63f, 0.065f, 0.05f), transform, true);
+
+    // Add the right wall.
+    geometryMesh.addCubeWithFaces(FACE_MASK_POSITIVE_X, Vec3(0.14f, 0.45f, 0.091f), transform, true);
+
+    transform = transformTranslation(-0.335f, 0.6f, -0.29f) *
+                transformRotation(0.3f, Vec3(0.0f, 1.0f, 0.0f)) *
+                transformScale(0.6f, 1.2f, 0.6f);
+
+    // Add the tall box.
+    geometryMesh.addCubeWithFaces(FACE_MASK_ALL, Vec3(0.725f, 0.71f, 0.68f), transform, false);
+
+    if (!useIntersectionFunctions) {
+        transform = transformTranslation(0.3275f, 0.3f, 0.3725f) *
+                    transformRotation(-0.3f, Vec3(0.0f, 1.0f, 0.0f)) *
+                    transformScale(0.6f, 0.6f, 0.6f);
+
+        // If the scene isn't using intersection functions, add the short box.
+        geometryMesh.addCubeWithFaces(FACE_MASK_ALL, Vec3(0.725f, 0.71f, 0.68f), transform, false);
+    }
+    else {
+        // Otherwise, geometry 2 is a sphere.
+        scene.geometries[2].addSphereWithOrigin(Vec3(0.3275f, 0.3f, 0.3725f), 0.3f, Vec3(0.725f, 0.71f, 0.68f));
+    }
+
+    // Create nine instances of the scene.
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            Transform transform = transformTranslation(x * 2.5f, y * 2.5f, 0.0f);
+
+            scene.instances.push_back({ 0, transform, GEOMETRY_MASK_LIGHT });
+            scene.instances.push_back({ 1, transform, GEOMETRY_MASK_TRIANGLE });
+
+            if (useIntersectionFunctions)
+                scene.instances.push_back({ 2, transform, GEOMETRY_MASK_SPHERE });
+
+            // Add a light for each box.
+            CPUAreaLight light;
+
+            light.position = Vec3(x * 2.5f, y * 2.5f + 1.98f, 0.0f);
+            light.forward = Vec3(0.0f, -1.0f, 0.0f);
+            light.right = Vec3(0.25f, 0.0f, 0.0f);
+            light.up = Vec3(0.0f, 0.0f, 0.25f);
+
+            float r = (float)rand() / (float)RAND_MAX;
+            float g = (float)rand() / (float)RAND_MAX;
+            float b = (float)rand() / (float)RAND_MAX;
+
+            light.color = Vec3(r * 4.0f, g * 4.0f, b * 4.0f);
+
+            scene.lights.push_back(light);
+        }
+    }
+
+    return scene;
+}
@@ -0,0 +1,148 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The header for a portable description of the sample's scene, which the CPU ray tracer traces
+ on platforms without Metal.
+*/
+
+#ifndef CPUScene_h
+#define CPUScene_h
+
+#include <math.h>
+#include <stdint.h>
+
+#include <vector>
+
+// The same instance masks and ray masks as the Metal shaders.
+#define GEOMETRY_MASK_TRIANGLE 1
+#define GEOMETRY_MASK_SPHERE   2
+#define GEOMETRY_MASK_LIGHT    4
+
+#define GEOMETRY_MASK_GEOMETRY (GEOMETRY_MASK_TRIANGLE | GEOMETRY_MASK_SPHERE)
+
+#define RAY_MASK_PRIMARY   (GEOMETRY_MASK_GEOMETRY | GEOMETRY_MASK_LIGHT)
+#define RAY_MASK_SHADOW    GEOMETRY_MASK_GEOMETRY
+#define RAY_MASK_SECONDARY GEOMETRY_MASK_GEOMETRY
+
+#define FACE_MASK_NONE       0
+#define FACE_MASK_NEGATIVE_X (1 << 0)
+#define FACE_MASK_POSITIVE_X (1 << 1)
+#define FACE_MASK_NEGATIVE_Y (1 << 2)
+#define FACE_MASK_POSITIVE_Y (1 << 3)
+#define FACE_MASK_NEGATIVE_Z (1 << 4)
+#define FACE_MASK_POSITIVE_Z (1 << 5)
+#define FACE_MASK_ALL        ((1 << 6) - 1)
+
+struct Vec3 {
+    float x, y, z;
+
+    Vec3() = default;
+    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    float operator[](int i) const { return (&x)[i]; }
+    float & operator[](int i) { return (&x)[i]; }
+};
+
+inline Vec3 operator+(Vec3 a, Vec3 b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Vec3 operator-(Vec3 a, Vec3 b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vec3 operator*(Vec3 a, Vec3 b) { return Vec3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline Vec3 operator*(Vec3 a, float s) { return Vec3(a.x * s, a.y * s, a.z * s); }
+inline Vec3 operator*(float s, Vec3 a) { return a * s; }
+inline Vec3 operator-(Vec3 a) { return Vec3(-a.x, -a.y, -a.z); }
+inline Vec3 & operator+=(Vec3 & a, Vec3 b) { return a = a + b; }
+inline Vec3 & operator*=(Vec3 & a, Vec3 b) { return a = a * b; }
+inline Vec3 & operator*=(Vec3 & a, float s) { return a = a * s; }
+
+inline float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float length(Vec3 a) { return sqrtf(dot(a, a)); }
+inline Vec3 normalize(Vec3 a) { return a * (1.0f / length(a)); }
+inline Vec3 min(Vec3 a, Vec3 b) { return Vec3(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z); }
+inline Vec3 max(Vec3 a, Vec3 b) { return Vec3(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z); }
+
+inline Vec3 cross(Vec3 a, Vec3 b) {
+    return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+// An affine transform with the columns of the first three rows of a 4x4 matrix, like the
+// transformation matrix of an `MTLAccelerationStructureInstanceDescriptor`.
+struct Transform {
+    Vec3 columns[4];
+
+    Vec3 transformPoint(Vec3 p) const {
+        return columns[0] * p.x + columns[1] * p.y + columns[2] * p.z + columns[3];
+    }
+
+    Vec3 transformDirection(Vec3 d) const {
+        return columns[0] * d.x + columns[1] * d.y + columns[2] * d.z;
+    }
+
+    Transform inverse() const;
+};
+
+Transform operator*(const Transform & a, const Transform & b);
+
+// The same transforms as `Transforms.h`.
+Transform transformIdentity();
+Transform transformTranslation(float tx, float ty, float tz);
+Transform transformRotation(float radians, Vec3 axis);
+Transform transformScale(float sx, float sy, float sz);
+
+struct CPUSphere {
+    Vec3 origin;
+    float radius;
+    Vec3 color;
+};
+
+// A piece of geometry made of either triangles or spheres, like the sample's `TriangleGeometry`
+// and `SphereGeometry`. The ray tracer intersects spheres the way the sample's sphere
+// intersection function does.
+struct CPUGeometry {
+    std::vector<uint32_t> indices;
+    std::vector<Vec3> vertices;
+    std::vector<Vec3> normals;
+    std::vector<Vec3> colors;
+
+    std::vector<CPUSphere> spheres;
+
+    bool usesIntersectionFunction() const { return !spheres.empty(); }
+
+    uint32_t primitiveCount() const {
+        return usesIntersectionFunction() ? (uint32_t)spheres.size() : (uint32_t)(indices.size() / 3);
+    }
+
+    void addCubeWithFaces(unsigned int faceMask, Vec3 color, const Transform & transform, bool inwardNormals);
+
+    void addSphereWithOrigin(Vec3 origin, float radius, Vec3 color);
+};
+
+// An instance of a piece of geometry, like the sample's `GeometryInstance`.
+struct CPUGeometryInstance {
+    uint32_t geometry;
+    Transform transform;
+    unsigned int mask;
+};
+
+struct CPUAreaLight {
+    Vec3 position;
+    Vec3 forward;
+    Vec3 right;
+    Vec3 up;
+    Vec3 color;
+};
+
+struct CPUScene {
+    std::vector<CPUGeometry> geometries;
+    std::vector<CPUGeometryInstance> instances;
+    std::vector<CPUAreaLight> lights;
+
+    Vec3 cameraPosition = Vec3(0.0f, 0.0f, -1.0f);
+    Vec3 cameraTarget = Vec3(0.0f, 0.0f, 0.0f);
+    Vec3 cameraUp = Vec3(0.0f, 1.0f, 0.0f);
+};
+
+// Create the same scene as `+[Scene newInstancedCornellBoxSceneWithDevice:useIntersectionFunctions:]`,
+// including the light colors it draws from `rand()`.
+CPUScene newInstancedCornellBoxScene(bool useIntersectionFunctions);
+
+#endif
@@ -0,0 +1,491 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that sweeps the sample's camera across its grid of bicubic patches, and
+ reports the triangles per frame and the projected error of the fixed levels of detail and of
+ the LOD selector.
+*/
+
+#include "../MeshShadersMetalCPP/Renderer/AAPLLODSelector.hpp"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace
+{
+
+// The sample's grid of objects, levels, and camera, from `AAPLShaderTypes.h` and `AAPLRenderer.cpp`
+const uint32_t NumObjectsX = 16;
+const uint32_t NumObjectsY = 8;
+const uint32_t NumObjectsZ = 1;
+const uint32_t NumObjectsXYZ = NumObjectsX * NumObjectsY * NumObjectsZ;
+const uint32_t NumLODs = 7;
+const float FieldOfViewY = 65.0f * (M_PI / 180.0f);
+const float NearZ = 0.1f;
+const float OffsetY = -1.5f;
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --frames N           Frames in the camera sweep (default 600)\n"
+            "  --height N           Viewport height in pixels (default 1080)\n"
+            "  --budget N           Triangle budget of the budgeted runs (default 8192)\n"
+            "  --hysteresis X       Hysteresis of the selector (default 0.25)\n",
+            program);
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// MARK: - Scene
+
+/// A column-major 4 x 4 matrix.
+struct Matrix
+{
+    float m[16];
+};
+
+Matrix translation(float x, float y, float z)
+{
+    Matrix t = {{ 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  x, y, z, 1 }};
+    return t;
+}
+
+/// Returns the matrix that translates by (x, y, z) after rotating by `angle` about Y, like the
+/// renderer's `matrix4x4_translation(x, y, z) * matrix4x4_YRotate(angle)`.
+Matrix objectTransform(float x, float y, float z, float angle)
+{
+    const float c = cosf(angle);
+    const float s = sinf(angle);
+    Matrix t = {{ c, 0, -s, 0,  0, 1, 0, 0,  s, 0, c, 0,  x, y, z, 1 }};
+    return t;
+}
+
+/// The patches' control points, which the renderer makes in the same order with `drand48`.
+struct Patch
+{
+    float controlPoints[16][3];
+};
+
+std::vector<Patch> makePatches()
+{
+    srand48(0);
+    std::vector<Patch> patches(NumObjectsXYZ);
+    for (Patch& patch : patches)
+    {
+        int k = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                patch.controlPoints[k][0] = i / 3.0f - 0.5f;
+                patch.controlPoints[k][1] = j / 3.0f - 0.5f;
+                patch.controlPoints[k][2] = -0.5 + 0.5 * drand48();
+                k++;
+            }
+        }
+    }
+    return patches;
+}
+
+/// Writes each object's transform for the frame, like the renderer's `updateStage`.
+void updateStage(float degree, std::vector<Matrix>& transforms)
+{
+    int count = 0;
+    for (size_t z = 0; z < NumObjectsZ; ++z)
+    {
+        float z_pos = -12.0f - z * 2.0f;
+        for (size_t y = 0; y < NumObjectsY; ++y)
+        {
+            float y_pos = 2 * (y - (float(NumObjectsY - 1) / 2));
+            for (size_t x = 0; x < NumObjectsX; ++x)
+            {
+                float x_pos = 2 * (x - (float(NumObjectsX - 1) / 2));
+                transforms[count++] = objectTransform(x_pos, y_pos, z_pos, degree);
+            }
+        }
+    }
+}
+
+/// The camera and objects of one frame of the sweep.  The camera moves through the slider's
+/// range and back, from 22 units away from the objects to 12, while the objects turn.
+struct Frame
+{
+    Matrix view;
+    std::vector<Matrix> transforms;
+};
+
+std::vector<Frame> makeSweep(uint32_t frameCount, float jitter)
+{
+    std::vector<Frame> frames(frameCount);
+    float degree = 0;
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        float offsetZ = 0.5f - 0.5f * cosf(2.0f * M_PI * frame / frameCount);
+        if (jitter > 0)
+        {
+            // Hold the camera where patches sit near a threshold, and shake it a little.
+            offsetZ = 0.5f + jitter * ((frame % 2) ? 1.0f : -1.0f);
+        }
+        frames[frame].view = translation(0, OffsetY, -10 + 10 * offsetZ);
+        frames[frame].transforms.resize(NumObjectsXYZ);
+        updateStage(degree, frames[frame].transforms);
+        degree += (jitter > 0 ? 0.0f : 0.25f) * M_PI / 180.0f;
+    }
+    return frames;
+}
+
+// MARK: - Error bound
+
+/// Returns the point of a bicubic patch at (u, v), like the renderer's `bicubicPoint`.
+void bicubicPoint(const Patch& patch, float u, float v, float point[3])
+{
+    const float binomial[4] = { 1, 3, 3, 1 };
+    point[0] = point[1] = point[2] = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            const float basis = binomial[i] * powf(u, float(i)) * powf(1 - u, float(3 - i))
+                              * binomial[j] * powf(v, float(j)) * powf(1 - v, float(3 - j));
+            for (int c = 0; c < 3; c++)
+                point[c] += basis * patch.controlPoints[4 * i + j][c];
+        }
+    }
+}
+
+/// Returns the farthest that the triangles of a grid of `quads` by `quads`, split like the
+/// renderer's `makePatchIndices`, stray from the patch at a grid of sample points in each quad.
+float measuredError(const Patch& patch, uint32_t quads)
+{
+    const int samples = 8;
+    float maxError = 0;
+    for (uint32_t qi = 0; qi < quads; qi++)
+    {
+        for (uint32_t qj = 0; qj < quads; qj++)
+        {
+            float corners[4][3];
+            bicubicPoint(patch, float(qi) / quads, float(qj) / quads, corners[0]);
+            bicubicPoint(patch, float(qi + 1) / quads, float(qj) / quads, corners[1]);
+            bicubicPoint(patch, float(qi) / quads, float(qj + 1) / quads, corners[2]);
+            bicubicPoint(patch, float(qi + 1) / quads, float(qj + 1) / quads, corners[3]);
+
+            for (int si = 0; si <= samples; si++)
+            {
+                for (int sj = 0; sj <= samples; sj++)
+                {
+                    const float s = float(si) / samples;
+                    const float t = float(sj) / samples;
+
+                    // The quad splits along the diagonal from (i + 1, j) to (i, j + 1).
+                    float linear[3];
+                    for (int c = 0; c < 3; c++)
+                    {
+                        if (s + t <= 1)
+                            linear[c] = corners[0][c] + s * (corners[1][c] - corners[0][c]) + t * (corners[2][c] - corners[0][c]);
+                        else
+                            linear[c] = corners[3][c] + (1 - s) * (corners[2][c] - corners[3][c]) + (1 - t) * (corners[1][c] - corners[3][c]);
+                    }
+
+                    float point[3];
+                    bicubicPoint(patch, (qi + s) / quads, (qj + t) / quads, point);
+                    const float dx = point[0] - linear[0];
+                    const float dy = point[1] - linear[1];
+                    const float dz = point[2] - linear[2];
+                    maxError = std::max(maxError, sqrtf(dx * dx + dy * dy + dz * dz));
+                }
+            }
+        }
+    }
+    return maxError;
+}
+
+/// Checks that each level's error bound is at least the error measured at sample points.
+uint32_t checkErrorBounds(const std::vector<Patch>& patches, const AAPLLODSelector& selector)
+{
+    uint32_t failures = 0;
+    float tightest = INFINITY;
+    float loosest = 0;
+    for (size_t patch = 0; patch < patches.size(); patch++)
+    {
+        for (uint32_t level = 0; level < NumLODs; level++)
+        {
+            const float measured = measuredError(patches[patch], NumLODs - level);
+            const float bound = selector.patchError(patch, level);
+            failures += measured > bound * 1.0001f + 1e-6f;
+            if (measured > 0)
+            {
+                tightest = std::min(tightest, bound / measured);
+                loosest = std::max(loosest, bound / measured);
+            }
+        }
+    }
+    printf("Error bounds of %zu patches at %u levels: %s (bound / measured error from %.2f to %.2f)\n",
+           patches.size(), NumLODs, failures ? "FAILED" : "passed", tightest, loosest);
+    return failures;
+}
+
+// MARK: - Sweeps
+
+struct SweepResult
+{
+    double trianglesPerFrame;
+    uint32_t mostTriangles;
+    double meanPixelError;
+    float maxPixelError;
+    double patchesOverTargetPerFrame;
+    double levelChangesPerFrame;
+    uint64_t checksum;
+};
+
+/// Runs the selector over every frame of a sweep.
+SweepResult runSweep(AAPLLODSelector& selector, const std::vector<Frame>& frames,
+                     const AAPLLODSettings& settings, float viewportHeight)
+{
+    SweepResult result = {};
+    result.checksum = 1469598103934665603ull;
+    for (const Frame& frame : frames)
+    {
+        AAPLLODView view;
+        view.viewMatrix = frame.view.m;
+        view.fieldOfViewY = FieldOfViewY;
+        view.viewportHeight = viewportHeight;
+        view.nearZ = NearZ;
+        selector.select(settings, view, frame.transforms[0].m);
+
+        const AAPLLODStats& stats = selector.stats();
+        result.trianglesPerFrame += stats.triangleCount;
+        result.mostTriangles = std::max(result.mostTriangles, stats.triangleCount);
+        result.meanPixelError += stats.meanPixelError;
+        result.maxPixelError = std::max(result.maxPixelError, stats.maxPixelError);
+        result.patchesOverTargetPerFrame += stats.patchesOverTarget;
+        result.levelChangesPerFrame += stats.levelChanges;
+        for (size_t patch = 0; patch < selector.patchCount(); patch++)
+            result.checksum = (result.checksum ^ selector.levels()[patch]) * 1099511628211ull;
+    }
+    result.trianglesPerFrame /= frames.size();
+    result.meanPixelError /= frames.size();
+    result.patchesOverTargetPerFrame /= frames.size();
+    result.levelChangesPerFrame /= frames.size();
+    return result;
+}
+
+/// Measures a fixed level for every patch, like the sample's former LOD choices.
+SweepResult runFixedSweep(AAPLLODSelector& selector, const std::vector<Frame>& frames,
+                          uint32_t level, float target, float viewportHeight)
+{
+    // Project each patch's error without choosing levels from it.
+    AAPLLODSettings settings;
+    settings.maxPixelError = 0;
+    settings.hysteresis = 0;
+
+    SweepResult result = {};
+    for (const Frame& frame : frames)
+    {
+        AAPLLODView view;
+        view.viewMatrix = frame.view.m;
+        view.fieldOfViewY = FieldOfViewY;
+        view.viewportHeight = viewportHeight;
+        view.nearZ = NearZ;
+        selector.select(settings, view, frame.transforms[0].m);
+
+        double errorSum = 0;
+        for (size_t patch = 0; patch < selector.patchCount(); patch++)
+        {
+            const float error = selector.pixelError(patch, level);
+            errorSum += error;
+            result.maxPixelError = std::max(result.maxPixelError, error);
+            result.patchesOverTargetPerFrame += error > target;
+        }
+        result.meanPixelError += errorSum / selector.patchCount();
+    }
+    result.mostTriangles = selector.triangleCount(level) * (uint32_t)selector.patchCount();
+    result.trianglesPerFrame = result.mostTriangles;
+    result.meanPixelError /= frames.size();
+    result.patchesOverTargetPerFrame /= frames.size();
+    return result;
+}
+
+void printResult(const char* name, const SweepResult& result)
+{
+    printf("  %-24s %10.0f %10u %10.2f %10.2f %12.1f %10.2f\n", name, result.trianglesPerFrame, result.mostTriangles,
+           result.meanPixelError, result.maxPixelError, result.patchesOverTargetPerFrame, result.levelChangesPerFrame);
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    uint32_t frameCount = 600;
+    float viewportHeight = 1080;
+    uint32_t budget = 8192;
+    float hysteresis = 0.25f;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            frameCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--height") && i + 1 < argc)
+        {
+            viewportHeight = (float)atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--budget") && i + 1 < argc)
+        {
+            budget = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--hysteresis") && i + 1 < argc)
+        {
+            hysteresis = (float)atof(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (frameCount == 0 || viewportHeight <= 0 || hysteresis < 0 || hysteresis >= 1)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const std::vector<Patch> patches = makePatches();
+    AAPLLODSelector selector(NumObjectsXYZ, NumLODs);
+    for (size_t patch = 0; patch < patches.size(); patch++)
+        selector.setPatch(patch, patches[patch].controlPoints);
+
+    uint32_t failures = checkErrorBounds(patches, selector);
+
+    const std::vector<Frame> sweep = makeSweep(frameCount, 0);
+    const float targets[3] = { 1.0f, 4.0f, 16.0f };
+    const char* targetNames[3] = { "High", "Medium", "Low" };
+
+    printf("\nCamera sweep of %u frames over %u patches at %.0f pixels high:\n", frameCount, NumObjectsXYZ, viewportHeight);
+    printf("  %-24s %10s %10s %10s %10s %12s %10s\n", "", "triangles", "most", "mean px", "max px", "over target", "changes");
+
+    // The former fixed levels: 8 x 8, 5 x 5, and 3 x 3 vertices, measured against 1 pixel
+    const uint32_t fixedLevels[3] = { 0, 3, 5 };
+    const char* fixedNames[3] = { "fixed 8x8", "fixed 5x5", "fixed 3x3" };
+    for (int i = 0; i < 3; i++)
+    {
+        AAPLLODSelector fixedSelector = selector;
+        printResult(fixedNames[i], runFixedSweep(fixedSelector, sweep, fixedLevels[i], targets[0], viewportHeight));
+    }
+
+    for (int budgeted = 0; budgeted < 2; budgeted++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            AAPLLODSettings settings;
+            settings.maxPixelError = targets[i];
+            settings.hysteresis = hysteresis;
+            settings.triangleBudget = budgeted ? budget : UINT32_MAX;
+
+            AAPLLODSelector sweepSelector = selector;
+            const SweepResult result = runSweep(sweepSelector, sweep, settings, viewportHeight);
+
+            char name[64];
+            snprintf(name, sizeof(name), "%s, %.0f px%s", targetNames[i], targets[i], budgeted ? ", budget" : "");
+            printResult(name, result);
+
+            // Without a budget, only patches at the finest level may miss the target.  With one,
+            // no frame may spend more than the budget, as long as it covers the coarsest levels.
+            if (budgeted && budget >= 2 * NumObjectsXYZ && result.mostTriangles > budget)
+            {
+                printf("  FAILED: a frame spent %u triangles, more than the budget\n", result.mostTriangles);
+                failures++;
+            }
+
+            // The same sweep must choose the same levels every time.
+            AAPLLODSelector repeatSelector = selector;
+            if (runSweep(repeatSelector, sweep, settings, viewportHeight).checksum != result.checksum)
+            {
+                printf("  FAILED: the same sweep chose different levels\n");
+                failures++;
+            }
+        }
+    }
+
+    {
+        // Without a budget, only patches at the finest level may miss the target.
+        AAPLLODSettings settings;
+        settings.maxPixelError = targets[1];
+        settings.hysteresis = hysteresis;
+        AAPLLODSelector checkSelector = selector;
+        uint32_t misses = 0;
+        for (const Frame& frame : sweep)
+        {
+            AAPLLODView view;
+            view.viewMatrix = frame.view.m;
+            view.fieldOfViewY = FieldOfViewY;
+            view.viewportHeight = viewportHeight;
+            view.nearZ = NearZ;
+            checkSelector.select(settings, view, frame.transforms[0].m);
+
+            for (size_t patch = 0; patch < checkSelector.patchCount(); patch++)
+            {
+                const uint8_t level = checkSelector.levels()[patch];
+                misses += level != 0 && checkSelector.pixelError(patch, level) > settings.maxPixelError;
+            }
+        }
+        if (misses)
+        {
+            printf("  FAILED: %u patches coarser than the finest level missed the target\n", misses);
+            failures++;
+        }
+    }
+
+    // Shake the camera where several patches sit near a threshold, with and without hysteresis.
+    const std::vector<Frame> jitter = makeSweep(frameCount, 0.02f);
+    printf("\nCamera shaking by 0.2 units for %u frames (level changes per frame):\n", frameCount);
+    double changes[2];
+    for (int withHysteresis = 0; withHysteresis < 2; withHysteresis++)
+    {
+        AAPLLODSettings settings;
+        settings.maxPixelError = targets[1];
+        settings.hysteresis = withHysteresis ? hysteresis : 0.0f;
+        AAPLLODSelector jitterSelector = selector;
+        changes[withHysteresis] = runSweep(jitterSelector, jitter, settings, viewportHeight).levelChangesPerFrame;
+        printf("  hysteresis %.2f: %8.3f\n", settings.hysteresis, changes[withHysteresis]);
+    }
+    if (hysteresis > 0 && changes[1] > changes[0])
+    {
+        printf("  FAILED: hysteresis changed levels more often\n");
+        failures++;
+    }
+
+    // Time the selection itself, with and without a budget.
+    printf("\nSelection at %.0f pixels (nanoseconds per patch):\n", targets[1]);
+    for (int budgeted = 0; budgeted < 2; budgeted++)
+    {
+        AAPLLODSettings settings;
+        settings.maxPixelError = targets[1];
+        settings.triangleBudget = budgeted ? budget : UINT32_MAX;
+        settings.hysteresis = hysteresis;
+        AAPLLODSelector timedSelector = selector;
+        const int rounds = 20;
+        auto begin = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++)
+            runSweep(timedSelector, sweep, settings, viewportHeight);
+        const double elapsed = seconds(begin);
+        printf("  %-24s %8.1f\n", budgeted ? "budget" : "no budget",
+               elapsed * 1e9 / (double(rounds) * frameCount * NumObjectsXYZ));
+    }
+
+    printf("\n%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The implementation of the class that chooses a level of detail for each bicubic patch from the
+ error its tessellation projects onto the screen.
+*/
+
+#include "AAPLLODSelector.hpp"
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+/// Returns the length of a + bScale * b + cScale * c, where c may be null.
+static float combinationLength(const float* a, const float* b, float bScale, const float* c, float cScale)
+{
+    float lengthSquared = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        float value = a[k] + bScale * b[k] + (c ? cScale * c[k] : 0.0f);
+        lengthSquared += value * value;
+    }
+    return sqrtf(lengthSquared);
+}
+
+/// Returns the fewest quads along each side whose error is at most the target.
+static uint32_t quadsForError(float pixelError, float target, uint32_t maxQuads)
+{
+    if (target <= 0)
+        return maxQuads;
+    float quads = ceilf(sqrtf(pixelError / target));
+    return (uint32_t)std::min(std::max(quads, 1.0f), float(maxQuads));
+}
+
+AAPLLODSelector::AAPLLODSelector(size_t patchCount, uint32_t levelCount)
+: _patches(patchCount)
+, _levelCount(levelCount)
+, _levels(patchCount, 0)
+, _quads(patchCount, 0)
+, _targetQuads(patchCount, 0)
+, _pixelErrors(patchCount, 0)
+{
+    assert(levelCount >= 1 && levelCount <= UINT8_MAX);
+    _refinable.reserve(patchCount);
+}
+
+void AAPLLODSelector::setPatch(size_t patch, const float controlPoints[16][3])
+{
+    PatchBounds& bounds = _patches[patch];
+
+    // The patch lies in the convex hull of its control points, so a sphere around them bounds it.
+    float minimum[3] = { INFINITY, INFINITY, INFINITY };
+    float maximum[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (int k = 0; k < 16; k++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            minimum[c] = std::min(minimum[c], controlPoints[k][c]);
+            maximum[c] = std::max(maximum[c], controlPoints[k][c]);
+        }
+    }
+    bounds.radius = 0;
+    for (int c = 0; c < 3; c++)
+        bounds.center[c] = 0.5f * (minimum[c] + maximum[c]);
+    for (int k = 0; k < 16; k++)
+    {
+        bounds.radius = std::max(bounds.radius, combinationLength(controlPoints[k], bounds.center, -1.0f, nullptr, 0.0f));
+    }
+
+    // Bound the second derivatives of the cubic patch by its control points' second differences,
+    // scaled by n(n - 1) = 6 along one direction and by n^2 = 9 across both.
+    float maxUU = 0;
+    float maxVV = 0;
+    float maxUV = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            const float* p = controlPoints[4 * i + j];
+            if (i < 2)
+                maxUU = std::max(maxUU, combinationLength(p, controlPoints[4 * (i + 1) + j], -2.0f, controlPoints[4 * (i + 2) + j], 1.0f));
+            if (j < 2)
+                maxVV = std::max(maxVV, combinationLength(p, controlPoints[4 * i + j + 1], -2.0f, controlPoints[4 * i + j + 2], 1.0f));
+            if (i < 3 && j < 3)
+            {
+                // p - p(i, j + 1) - p(i + 1, j) + p(i + 1, j + 1)
+                float difference[3];
+                for (int c = 0; c < 3; c++)
+                    difference[c] = p[c] - controlPoints[4 * i + j + 1][c] - controlPoints[4 * (i + 1) + j][c] + controlPoints[4 * (i + 1) + j + 1][c];
+                maxUV = std::max(maxUV, sqrtf(difference[0] * difference[0] + difference[1] * difference[1] + difference[2] * difference[2]));
+            }
+        }
+    }
+
+    // The triangles of a grid of cells h wide stray from a surface by at most
+    // (h^2 / 8) * (|P_uu| + 2 |P_uv| + |P_vv|), and h is one over the quads along a side.
+    bounds.error = (6.0f * maxUU + 2.0f * 9.0f * maxUV + 6.0f * maxVV) / 8.0f;
+}
+
+void AAPLLODSelector::select(const AAPLLODSettings& settings, const AAPLLODView& view, const float* modelMatrices)
+{
+    const uint32_t maxQuads = _levelCount;
+    const float* V = view.viewMatrix;
+    const float pixelsPerUnit = view.viewportHeight / (2.0f * tanf(view.fieldOfViewY * 0.5f));
+    const float target = settings.maxPixelError;
+    const float coarsenTarget = target * (1.0f - settings.hysteresis);
+
+    uint64_t triangles = 0;
+    for (size_t patch = 0; patch < _patches.size(); patch++)
+    {
+        const PatchBounds& bounds = _patches[patch];
+        const float* M = modelMatrices + 16 * patch;
+
+        // Move the bounding sphere into view space; the view matrix doesn't scale.
+        float world[3];
+        for (int r = 0; r < 3; r++)
+            world[r] = M[r] * bounds.center[0] + M[4 + r] * bounds.center[1] + M[8 + r] * bounds.center[2] + M[12 + r];
+        const float depth = -(V[2] * world[0] + V[6] * world[1] + V[10] * world[2] + V[14]);
+
+        float scale = 0;
+        for (int c = 0; c < 3; c++)
+            scale = std::max(scale, sqrtf(M[4 * c] * M[4 * c] + M[4 * c + 1] * M[4 * c + 1] + M[4 * c + 2] * M[4 * c + 2]));
+        const float radius = bounds.radius * scale;
+
+        // Project the error at the sphere's nearest depth.  A patch behind the camera gets the
+        // coarsest level, and one that crosses the near plane gets the error at the near plane.
+        float pixelError = 0;
+        if (depth + radius > view.nearZ)
+            pixelError = bounds.error * scale * pixelsPerUnit / std::max(depth - radius, view.nearZ);
+        _pixelErrors[patch] = pixelError;
+
+        // Refine as soon as the current level's error passes the target, but only coarsen once
+        // the coarser level's error is clearly below it.
+        const uint32_t previous = _hasSelected ? maxQuads - _levels[patch] : 0;
+        const uint32_t quads = std::max(quadsForError(pixelError, target, maxQuads),
+                                        std::min(previous, quadsForError(pixelError, coarsenTarget, maxQuads)));
+        _targetQuads[patch] = (uint8_t)quads;
+        _quads[patch] = (uint8_t)quads;
+        triangles += 2 * quads * quads;
+    }
+
+    if (triangles > settings.triangleBudget)
+    {
+        // Start every patch at its coarsest level, then repeatedly refine the patch with the
+        // largest error that the budget still has room for.  Patches that are coarser than their
+        // previous level come first among equals, so a tight budget doesn't shuffle levels.
+        const float bias = 1.0f + settings.hysteresis;
+        auto priority = [&](uint32_t patch)
+        {
+            const float quads = _quads[patch];
+            const bool belowPrevious = _hasSelected && _quads[patch] < maxQuads - _levels[patch];
+            return _pixelErrors[patch] / (quads * quads) * (belowPrevious ? bias : 1.0f);
+        };
+        auto lessUrgent = [&](uint32_t a, uint32_t b)
+        {
+            const float priorityA = priority(a);
+            const float priorityB = priority(b);
+            return priorityA < priorityB || (priorityA == priorityB && a > b);
+        };
+
+        triangles = 2 * _patches.size();
+        _refinable.clear();
+        for (uint32_t patch = 0; patch < _patches.size(); patch++)
+        {
+            _quads[patch] = 1;
+            if (_targetQuads[patch] > 1)
+                _refinable.push_back(patch);
+        }
+        std::make_heap(_refinable.begin(), _refinable.end(), lessUrgent);
+
+        while (!_refinable.empty())
+        {
+            std::pop_heap(_refinable.begin(), _refinable.end(), lessUrgent);
+            const uint32_t patch = _refinable.back();
+            _refinable.pop_back();
+
+            const uint32_t quads = _quads[patch];
+            const uint32_t cost = 2 * (2 * quads + 1);
+            if (triangles + cost > settings.triangleBudget)
+                continue;
+
+            triangles += cost;
+            _quads[patch] = (uint8_t)(quads + 1);
+            if (quads + 1 < _targetQuads[patch])
+            {
+                _refinable.push_back(patch);
+                std::push_heap(_refinable.begin(), _refinable.end(), lessUrgent);
+            }
+        }
+    }
+
+    AAPLLODStats stats;
+    stats.triangleCount = (uint32_t)std::min<uint64_t>(triangles, UINT32_MAX);
+    double errorSum = 0;
+    for (size_t patch = 0; patch < _patches.size(); patch++)
+    {
+        const uint32_t quads = _quads[patch];
+        const float error = _pixelErrors[patch] / float(quads * quads);
+        stats.maxPixelError = std::max(stats.maxPixelError, error);
+        errorSum += error;
+        stats.patchesOverTarget += error > target;
+
+        const uint8_t level = (uint8_t)(maxQuads - quads);
+        stats.levelChanges += _hasSelected && level != _levels[patch];
+        _levels[patch] = level;
+    }
+    stats.meanPixelError = _patches.empty() ? 0.0f : float(errorSum / _patches.size());
+
+    _stats = stats;
+    _hasSelected = true;
+}
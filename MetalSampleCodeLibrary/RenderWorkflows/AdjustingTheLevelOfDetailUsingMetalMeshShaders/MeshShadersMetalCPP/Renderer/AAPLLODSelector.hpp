@@ -0,0 +1,157 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The header for the class that chooses a level of detail for each bicubic patch from the error
+ its tessellation projects onto the screen.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// The error that the LOD selector aims for and the triangles it may spend.
+struct AAPLLODSettings
+{
+    /// The most, in pixels, that a patch's triangles may stray from the patch.
+    float maxPixelError{1.0f};
+
+    /// The most triangles that all the patches may have together.
+    uint32_t triangleBudget{UINT32_MAX};
+
+    /// The fraction by which a patch's error must fall below `maxPixelError` before the patch
+    /// switches to a coarser level, which keeps patches near the threshold from flickering.
+    float hysteresis{0.25f};
+};
+
+/// The camera that projects each patch's error onto the screen.
+struct AAPLLODView
+{
+    /// The column-major view matrix, which maps world space to a right-handed view space.
+    const float* viewMatrix{nullptr};
+    float fieldOfViewY{1.0f};
+    float viewportHeight{1.0f};
+    float nearZ{0.1f};
+};
+
+/// What the most recent selection chose.
+struct AAPLLODStats
+{
+    uint32_t triangleCount{0};
+
+    /// The projected error of each patch's chosen level, in pixels.
+    float maxPixelError{0};
+    float meanPixelError{0};
+
+    /// Patches whose error is above the target, because of the budget or the finest level.
+    uint32_t patchesOverTarget{0};
+
+    /// Patches whose level differs from the previous selection's.
+    uint32_t levelChanges{0};
+};
+
+/// Chooses a level of detail for each bicubic patch each frame.
+///
+/// Level 0 of a patch is a grid of `levelCount` by `levelCount` quads, and each level after it
+/// has one fewer quad along each side.  The selector bounds, from the second differences of a
+/// patch's control points, how far the triangles of each level can stray from the patch, and
+/// projects that bound onto the screen at the patch's nearest depth.  Each patch gets the
+/// coarsest level that meets the target error.  When those levels need more triangles than the
+/// budget, the selector instead refines whichever patch has the largest error, one level at a
+/// time, until the budget runs out.
+class AAPLLODSelector
+{
+public:
+    AAPLLODSelector(size_t patchCount, uint32_t levelCount);
+
+    /// Bounds a patch from its 16 control points, where point `4 * i + j` is the one whose
+    /// Bernstein basis functions are `i` along u and `j` along v.
+    void setPatch(size_t patch, const float controlPoints[16][3]);
+
+    /// Chooses a level for every patch, given a column-major model matrix for each.
+    void select(const AAPLLODSettings& settings, const AAPLLODView& view, const float* modelMatrices);
+
+    size_t patchCount() const;
+    uint32_t levelCount() const;
+
+    /// The triangles at a level of a patch.
+    uint32_t triangleCount(uint32_t level) const;
+
+    /// The most that the triangles of a level can stray from the patch, in the patch's units.
+    float patchError(size_t patch, uint32_t level) const;
+
+    /// The error of a level of a patch that the most recent selection projected, in pixels.
+    float pixelError(size_t patch, uint32_t level) const;
+
+    /// The level of each patch that the most recent selection chose.
+    const uint8_t* levels() const;
+
+    const AAPLLODStats& stats() const;
+
+private:
+    struct PatchBounds
+    {
+        float center[3];
+        float radius;
+
+        // The error of one quad along each side, which falls with the square of the quads.
+        float error;
+    };
+
+    std::vector<PatchBounds> _patches;
+    uint32_t _levelCount;
+
+    // Each patch's chosen level, and the quads along each side that it's working toward
+    std::vector<uint8_t> _levels;
+    std::vector<uint8_t> _quads;
+    std::vector<uint8_t> _targetQuads;
+    bool _hasSelected{false};
+
+    // The projected error of each patch at one quad along each side, in pixels
+    std::vector<float> _pixelErrors;
+
+    // The patches that can still refine when the budget runs short
+    std::vector<uint32_t> _refinable;
+
+    AAPLLODStats _stats;
+};
+
+inline size_t AAPLLODSelector::patchCount() const
+{
+    return _patches.size();
+}
+
+inline uint32_t AAPLLODSelector::levelCount() const
+{
+    return _levelCount;
+}
+
+inline uint32_t AAPLLODSelector::triangleCount(uint32_t level) const
+{
+    const uint32_t quads = _levelCount - level;
+    return 2 * quads * quads;
+}
+
+inline float AAPLLODSelector::patchError(size_t patch, uint32_t level) const
+{
+    const float quads = float(_levelCount - level);
+    return _patches[patch].error / (quads * quads);
+}
+
+inline float AAPLLODSelector::pixelError(size_t patch, uint32_t level) const
+{
+    const float quads = float(_levelCount - level);
+    return _pixelErrors[patch] / (quads * quads);
+}
+
+inline const uint8_t* AAPLLODSelector::levels() const
+{
+    return _levels.data();
+}
+
+inline const AAPLLODStats& AAPLLODSelector::stats() const
+{
+    return _stats;
+}
@@ -7,11 +7,17 @@ The renderer's mesh shader implementation that draws bicubic Bezier patches.
 
 #include <MetalKit/MetalKit.hpp>
 #include <simd/simd.h>
+#include <algorithm>
 #include <vector>
 
 #include "AAPLRenderer.hpp"
 
 constexpr bool _useMultisampleAntialiasing = true;
+constexpr float _fieldOfViewY = 65.0f * (M_PI / 180.0f);
+constexpr float _nearZ = 0.1f;
+
+/// The most that a patch's triangles may stray from the patch, in pixels, for each LOD choice.
+constexpr float _maxPixelErrors[3] = { 1.0f, 4.0f, 16.0f }; // High, Medium, Low
 
 #pragma mark - Matrix Math Utilities
 
@@ -79,7 +85,7 @@ float bernsteinBasisCubic(float u, int i)
 }
 
 /// Returns the bicubic patch point where k contains 16 elements.
-simd_float4 bicubicPoint(float u, float v, std::vector<simd_float3> controlPoints)
+simd_float4 bicubicPoint(float u, float v, const simd_float3* controlPoints)
 {
     simd_float3 p = simd_make_float3(0, 0, 0);
     int k = 0;
@@ -94,42 +100,39 @@ simd_float4 bicubicPoint(float u, float v, std::vector<simd_float3> controlPoint
     return simd_make_float4(p.x, p.y, p.z, 1.0f);
 }
 
-/// Returns a point on a bicubic patch.
-///
-/// The bicubic patch point is in parametric coordinates (u, v).
-simd_float4 bicubicPatch(int shape, float u, float v)
+/// Generates the 16 control points of a bicubic patch with a random height at each point.
+void makePatchControlPoints(simd_float3* controlPoints)
 {
-    static int gshape = -1;
-    static std::vector<simd_float3> controlPoints;
-    if (gshape != shape)
+    int k = 0;
+    for (int i = 0; i < 4; i++)
     {
-        // Generate control points if this object wasn't used before.
-        controlPoints.resize(16);
-        int k = 0;
-        for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
         {
-            for (int j = 0; j < 4; j++)
-            {
-                controlPoints[k].x = i / 3.0f - 0.5f;
-                controlPoints[k].y = j / 3.0f - 0.5f;
-                controlPoints[k].z = -0.5 + 0.5 * drand48();
-                k++;
-            }
+            controlPoints[k].x = i / 3.0f - 0.5f;
+            controlPoints[k].y = j / 3.0f - 0.5f;
+            controlPoints[k].z = -0.5 + 0.5 * drand48();
+            k++;
         }
-        gshape = shape;
     }
+}
+
+/// Returns a point on a bicubic patch.
+///
+/// The bicubic patch point is in parametric coordinates (u, v).
+simd_float4 bicubicPatch(const simd_float3* controlPoints, float u, float v)
+{
     return bicubicPoint(u, v, controlPoints);
 }
 
 /// Returns a point on a bicubic patch with coordinates (u, v) for one of the bicubic patches.
-simd_float3 bicubicPatch3(int shape, float u, float v)
+simd_float3 bicubicPatch3(const simd_float3* controlPoints, float u, float v)
 {
-    simd_float4 p = bicubicPatch(shape, u, v);
+    simd_float4 p = bicubicPatch(controlPoints, u, v);
     return simd_make_float3(p.x, p.y, p.z);
 }
 
 /// Calculates the vertex data for a bicubic patch and returns the number of vertices the method adds to the array.
-size_t makePatchVertices(int shape, size_t segmentsX, size_t segmentsY, std::vector<AAPLVertex>& vertices)
+size_t makePatchVertices(const simd_float3* controlPoints, size_t segmentsX, size_t segmentsY, std::vector<AAPLVertex>& vertices)
 {
     // Resize the vertex array and check that it meets the size limitations.
     size_t vertexCount = segmentsX * segmentsY;
@@ -141,11 +144,11 @@ size_t makePatchVertices(int shape, size_t segmentsX, size_t segmentsY, std::vec
             AAPLVertex vtx;
             float u = i / float(segmentsX - 1);
             float v = j / float(segmentsY - 1);
-            vtx.position = bicubicPatch(shape, u, v);
-            simd_float3 u1 = bicubicPatch3(shape, u - 0.01f, v);
-            simd_float3 u2 = bicubicPatch3(shape, u + 0.01f, v);
-            simd_float3 v1 = bicubicPatch3(shape, u, v - 0.01f);
-            simd_float3 v2 = bicubicPatch3(shape, u, v + 0.01f);
+            vtx.position = bicubicPatch(controlPoints, u, v);
+            simd_float3 u1 = bicubicPatch3(controlPoints, u - 0.01f, v);
+            simd_float3 u2 = bicubicPatch3(controlPoints, u + 0.01f, v);
+            simd_float3 v1 = bicubicPatch3(controlPoints, u, v - 0.01f);
+            simd_float3 v2 = bicubicPatch3(controlPoints, u, v + 0.01f);
             simd_float3 du = u2 - u1;
             simd_float3 dv = v2 - v1;
             simd_float3 N = simd_normalize(simd_cross(du, dv));
@@ -238,11 +241,20 @@ AAPLRenderer::AAPLRenderer(MTK::View& view)
     _pCommandQueue = _pDevice->newCommandQueue();
     for (size_t i = 0; i < AAPLMaxFramesInFlight; i++) {
         _pTransformsBuffer[i] = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(matrix_float4x4), MTL::ResourceStorageModeShared);
+        _pObjectLODsBuffer[i] = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(uint8_t), MTL::ResourceStorageModeShared);
     }
     _pMeshColorsBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(vector_float3), MTL::ResourceStorageModeShared);
-    const size_t LODCount = 3;
-    _pMeshVerticesBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(AAPLVertex) * AAPLMaxMeshletVertexCount * LODCount, MTL::ResourceStorageModeShared);
-    _pMeshIndicesBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(AAPLIndexType) * AAPLMaxPrimitiveCount * 6 * LODCount, MTL::ResourceStorageModeShared);
+
+    // Each level of detail has one fewer vertex along each side than the level before it.
+    size_t vertexCountPerObject = 0;
+    size_t indexCountPerObject = 0;
+    for (size_t lod = 0; lod < AAPLNumLODs; lod++) {
+        size_t segments = AAPLNumPatchSegmentsX - lod;
+        vertexCountPerObject += segments * segments;
+        indexCountPerObject += (segments - 1) * (segments - 1) * 6;
+    }
+    _pMeshVerticesBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(AAPLVertex) * vertexCountPerObject, MTL::ResourceStorageModeShared);
+    _pMeshIndicesBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(AAPLIndexType) * indexCountPerObject, MTL::ResourceStorageModeShared);
     _pMeshInfoBuffer = _pDevice->newBuffer(AAPLNumObjectsXYZ * sizeof(AAPLMeshInfo), MTL::ResourceStorageModeShared);
     buildShaders();
     makeMeshlets();
@@ -264,6 +276,7 @@ AAPLRenderer::~AAPLRenderer()
     _pMeshColorsBuffer->release();
     for (size_t i = 0; i < AAPLMaxFramesInFlight; i++) {
         _pTransformsBuffer[i]->release();
+        _pObjectLODsBuffer[i]->release();
     }
 }
 
@@ -328,8 +341,6 @@ void AAPLRenderer::buildShaders()
 /// Initializes the meshlet vertex data for all the bicubic patches.
 void AAPLRenderer::makeMeshlets()
 {
-    size_t segX = AAPLNumPatchSegmentsX;
-    size_t segY = AAPLNumPatchSegmentsY;
     meshVertices.clear();
     meshIndices.clear();
     meshInfo.resize(AAPLNumObjectsXYZ);
@@ -338,27 +349,29 @@ void AAPLRenderer::makeMeshlets()
         AAPLMeshInfo& mesh = meshInfo[i];
         mesh.patchIndex = i;
         mesh.color = simd_make_float4(1.0, 0.0, 1.0, 1.0);
-        mesh.numLODs = 3;
-        
-        if (mesh.numLODs >= 1)
-        {
-            mesh.lod1.startVertexIndex = (uint32_t)meshVertices.size();
-            mesh.vertexCount = (uint16_t)makePatchVertices(mesh.patchIndex, segX, segY, meshVertices);
-            addLODs(mesh.lod1, segX, segY, meshIndices);
-        }
-        
-        if (mesh.numLODs >= 2)
+        mesh.numLODs = AAPLNumLODs;
+        mesh.vertexCount = 0;
+
+        simd_float3 controlPoints[16];
+        makePatchControlPoints(controlPoints);
+
+        // Give the LOD selector the control points, which bound the error of each level.
+        float points[16][3];
+        for (int k = 0; k < 16; k++)
         {
-            mesh.lod2.startVertexIndex = (uint32_t)meshVertices.size();
-            mesh.vertexCount += (uint16_t)makePatchVertices(mesh.patchIndex, 5, 5, meshVertices);
-            addLODs(mesh.lod2, 5, 5, meshIndices);
+            points[k][0] = controlPoints[k].x;
+            points[k][1] = controlPoints[k].y;
+            points[k][2] = controlPoints[k].z;
         }
-        
-        if (mesh.numLODs >= 3)
+        _lodSelector.setPatch(i, points);
+
+        // Build every level, from the full patch down to a single quad.
+        for (uint32_t lod = 0; lod < mesh.numLODs; lod++)
         {
-            mesh.lod3.startVertexIndex = (uint32_t)meshVertices.size();
-            mesh.vertexCount += (uint16_t)makePatchVertices(mesh.patchIndex, 3, 3, meshVertices);
-            addLODs(mesh.lod3, 3, 3, meshIndices);
+            size_t segments = AAPLNumPatchSegmentsX - lod;
+            mesh.lods[lod].startVertexIndex = (uint32_t)meshVertices.size();
+            mesh.vertexCount += (uint16_t)makePatchVertices(controlPoints, segments, segments, meshVertices);
+            addLODs(mesh.lods[lod], segments, segments, meshIndices);
         }
     }
     
@@ -420,6 +433,26 @@ void AAPLRenderer::updateStage()
     }
 }
 
+/// Chooses each object's level of detail from the error its patch projects onto the screen.
+void AAPLRenderer::selectLODs(const matrix_float4x4& viewMatrix)
+{
+    AAPLLODSettings settings;
+    settings.maxPixelError = _maxPixelErrors[std::min(std::max(lodChoice, 0), 2)];
+    settings.triangleBudget = triangleBudget;
+
+    AAPLLODView view;
+    view.viewMatrix = reinterpret_cast<const float*>(&viewMatrix);
+    view.fieldOfViewY = _fieldOfViewY;
+    view.viewportHeight = _viewportHeight;
+    view.nearZ = _nearZ;
+
+    // Simd matrices store their columns one after another, like the selector expects.
+    const matrix_float4x4* transforms = reinterpret_cast<const matrix_float4x4*>(_pTransformsBuffer[_curFrameInFlight]->contents());
+    _lodSelector.select(settings, view, reinterpret_cast<const float*>(transforms));
+
+    memcpy(_pObjectLODsBuffer[_curFrameInFlight]->contents(), _lodSelector.levels(), AAPLNumObjectsXYZ * sizeof(uint8_t));
+}
+
 /// Draws the mesh shaders scene.
 void AAPLRenderer::draw(MTK::View* pView)
 {
@@ -436,8 +469,9 @@ void AAPLRenderer::draw(MTK::View* pView)
     matrix_float4x4 viewMatrix = matrix4x4_translation(0, offsetY, -10 + 10 * offsetZ);
     matrix_float4x4 viewProjectionMatrix = matrix_multiply(_projectionMatrix, viewMatrix);
 
-    // Update the object positions.
+    // Update the object positions, then choose their levels of detail.
     updateStage();
+    selectLODs(viewMatrix);
 
     pRenderEncoder->setFrontFacingWinding(MTL::Winding::WindingCounterClockwise);
     pRenderEncoder->setRenderPipelineState(_pRenderPipelineState[topologyChoice]);
@@ -451,7 +485,7 @@ void AAPLRenderer::draw(MTK::View* pView)
     pRenderEncoder->setObjectBuffer(_pTransformsBuffer[_curFrameInFlight], 0, AAPLBufferIndexTransforms);
     pRenderEncoder->setObjectBuffer(_pMeshColorsBuffer, 0, AAPLBufferIndexMeshColor);
     pRenderEncoder->setObjectBytes(&viewProjectionMatrix, sizeof(viewProjectionMatrix), AAPLBufferViewProjectionMatrix);
-    pRenderEncoder->setObjectBytes(&lodChoice, 4, AAPLBufferIndexLODChoice);
+    pRenderEncoder->setObjectBuffer(_pObjectLODsBuffer[_curFrameInFlight], 0, AAPLBufferIndexObjectLODs);
 
     // Pass data to the mesh stage.
     pRenderEncoder->setMeshBytes(&viewProjectionMatrix, sizeof(viewProjectionMatrix), AAPLBufferViewProjectionMatrix);
@@ -480,5 +514,6 @@ void AAPLRenderer::draw(MTK::View* pView)
 void AAPLRenderer::drawableSizeWillChange(CGSize size)
 {
     float aspect = size.width / (float)size.height;
-    _projectionMatrix = matrix_perspective_right_hand(65.0f * (M_PI / 180.0f), aspect, 0.1f, 100.0f);
+    _viewportHeight = size.height;
+    _projectionMatrix = matrix_perspective_right_hand(_fieldOfViewY, aspect, _nearZ, 100.0f);
 }
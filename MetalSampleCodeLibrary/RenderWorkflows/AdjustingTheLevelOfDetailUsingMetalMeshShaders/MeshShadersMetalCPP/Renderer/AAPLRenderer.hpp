@@ -14,6 +14,7 @@ The header for the renderer class that uses mesh shaders to draw bicubic Bezier
 #include <MetalKit/MetalKit.hpp>
 
 #include "AAPLShaderTypes.h"
+#include "AAPLLODSelector.hpp"
 
 class AAPLRenderer
 {
@@ -29,6 +30,7 @@ public:
     float offsetZ{0};
     int lodChoice{0};
     int topologyChoice{2};
+    uint32_t triangleBudget{AAPLNumObjectsXYZ * 64};
     
 private:
     static constexpr size_t AAPLMaxFramesInFlight = 3;
@@ -39,6 +41,7 @@ private:
     MTL::RenderPipelineState* _pRenderPipelineState[3];
     MTL::DepthStencilState* _pDepthStencilState;
     MTL::Buffer* _pTransformsBuffer[AAPLMaxFramesInFlight];
+    MTL::Buffer* _pObjectLODsBuffer[AAPLMaxFramesInFlight];
 
     MTL::Buffer* _pMeshColorsBuffer;
     MTL::Buffer* _pMeshVerticesBuffer;
@@ -46,13 +49,17 @@ private:
     MTL::Buffer* _pMeshInfoBuffer;
 
     matrix_float4x4 _projectionMatrix;
+    float _viewportHeight{1};
     float degree;
+
+    AAPLLODSelector _lodSelector{AAPLNumObjectsXYZ, AAPLNumLODs};
     
     std::vector<AAPLVertex> meshVertices;
     std::vector<AAPLIndexType> meshIndices;
     std::vector<AAPLMeshInfo> meshInfo;
     
     void updateStage();
+    void selectLODs(const matrix_float4x4& viewMatrix);
     void makeMeshlets();
     void makeMeshletColors();
 };
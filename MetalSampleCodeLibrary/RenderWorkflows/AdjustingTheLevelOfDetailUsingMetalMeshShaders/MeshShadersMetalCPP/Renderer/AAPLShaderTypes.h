@@ -25,7 +25,7 @@ typedef enum BufferIndex : int32_t
     AAPLBufferViewProjectionMatrix = 4,
     AAPLBufferIndexTransforms = 5,
     AAPLBufferIndexMeshColor = 6,
-    AAPLBufferIndexLODChoice = 7
+    AAPLBufferIndexObjectLODs = 7
 } BufferIndex;
 
 typedef struct AAPLVertex
@@ -47,17 +47,18 @@ typedef struct AAPLIndexRange
     uint32_t primitiveCount{0};
 } AAPLIndexRange;
 
+// The levels of detail of each patch, from 8 x 8 vertices, the most a meshlet holds, down to 2 x 2.
+static constexpr constant uint32_t AAPLNumLODs = 7;
+
 typedef struct AAPLMeshInfo
 {
-    uint16_t numLODs{3};
+    uint16_t numLODs{AAPLNumLODs};
     uint16_t patchIndex{3};
     simd_float4 color;
     
     uint16_t vertexCount{0};
     
-    AAPLIndexRange lod1;
-    AAPLIndexRange lod2;
-    AAPLIndexRange lod3;
+    AAPLIndexRange lods[AAPLNumLODs];
 } AAPLMeshInfo;
 
 /// Declare the constant data for the entire frame in this structure.
@@ -77,6 +78,8 @@ static constexpr constant uint32_t AAPLNumObjectsXYZ = AAPLNumObjectsXY * AAPLNu
 
 static constexpr constant uint32_t AAPLNumPatchSegmentsX = 8;
 static constexpr constant uint32_t AAPLNumPatchSegmentsY = 8;
+static_assert(AAPLNumLODs == AAPLNumPatchSegmentsX - 1 && AAPLNumPatchSegmentsX == AAPLNumPatchSegmentsY,
+              "Each level of detail has one fewer vertex along each side, down to 2 x 2");
 
 static constexpr constant uint32_t AAPLMaxMeshletVertexCount = 64;
 static constexpr constant uint32_t AAPLMaxPrimitiveCount = 126;
@@ -87,7 +87,7 @@ void meshShaderObjectStageFunction(object_data payload_t& payload            [[p
                                    constant float4x4*   transforms           [[buffer(AAPLBufferIndexTransforms)]],
                                    constant float3*     colors               [[buffer(AAPLBufferIndexMeshColor)]],
                                    constant float4x4&   viewProjectionMatrix [[buffer(AAPLBufferViewProjectionMatrix)]],
-                                   constant uint&       lod                  [[buffer(AAPLBufferIndexLODChoice)]],
+                                   constant uint8_t*    lods                 [[buffer(AAPLBufferIndexObjectLODs)]],
                                    uint3                positionInGrid       [[threadgroup_position_in_grid]])
 {
     // threadIndex is the object index.
@@ -97,34 +97,17 @@ void meshShaderObjectStageFunction(object_data payload_t& payload            [[p
     
     constant AAPLMeshInfo& meshInfo = meshes[threadIndex];
     
-    payload.lod = 0;
+    // Use the level of detail that the CPU chose for the object this frame.
+    uint8_t lod = min(lods[threadIndex], uint8_t(meshInfo.numLODs - 1));
+    constant AAPLIndexRange& lodRange = meshInfo.lods[lod];
+
+    payload.lod = lod;
     payload.color = colors[threadIndex];
     
-    uint startIndex = meshInfo.lod1.startIndex;
-    uint startVertexIndex = meshInfo.lod1.startVertexIndex;
-    
-    // Adjust parameters if using a lower level of detail.
-    if (lod == 0)
-    {
-        payload.primitiveCount = meshInfo.lod1.primitiveCount;
-        payload.vertexCount = meshInfo.lod1.vertexCount;
-    }
-    else if (lod == 1)
-    {
-        // Choose LOD 1.
-        startIndex = meshInfo.lod2.startIndex;
-        startVertexIndex = meshInfo.lod2.startVertexIndex;
-        payload.primitiveCount = meshInfo.lod2.primitiveCount;
-        payload.vertexCount = meshInfo.lod2.vertexCount;
-    }
-    else if (lod == 2)
-    {
-        // Choose LOD 2.
-        startIndex = meshInfo.lod3.startIndex;
-        startVertexIndex = meshInfo.lod3.startVertexIndex;
-        payload.primitiveCount = meshInfo.lod3.primitiveCount;
-        payload.vertexCount = meshInfo.lod3.vertexCount;
-    }
+    uint startIndex = lodRange.startIndex;
+    uint startVertexIndex = lodRange.startVertexIndex;
+    payload.primitiveCount = lodRange.primitiveCount;
+    payload.vertexCount = lodRange.vertexCount;
 
     // Copy the triangle indices into the payload.
     for (uint i = 0; i < payload.primitiveCount*3; i++)
@@ -0,0 +1,259 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that converts the sample's `.dat` models to model files, and measures how
+ fast each level of detail of a model file loads.
+*/
+#include "../Renderer/AAPLModelFile.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s convert [options] -o OUTPUT COARSEST.dat ... FINEST.dat\n"
+            "  --page-size N        Largest size of a page in KB before compression (default 256)\n"
+            "  --compress           Compress the pages with meshoptimizer\n"
+            "       %s bench [options] MODEL\n"
+            "  --threads LIST       Comma separated thread counts to load with (default 1,4)\n"
+            "  --repeat N           Loads of each level to average (default 5)\n"
+            "  --evict              Drop the file from the page cache before each load\n",
+            program, program);
+}
+
+std::vector<uint32_t> parseList(const char* list)
+{
+    std::vector<uint32_t> values;
+    for (const char* p = list; p; )
+    {
+        values.push_back((uint32_t)atoi(p));
+        p = strchr(p, ',');
+        if (p)
+            ++p;
+    }
+    return values;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Makes the next load read from the disk rather than the page cache, where the system allows it.
+void evict(const char* path)
+{
+#ifdef POSIX_FADV_DONTNEED
+    const int fd = open(path, O_RDONLY);
+    if (fd >= 0)
+    {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+int convert(int argc, char** argv)
+{
+    AAPLModelFileOptions options;
+    std::string output;
+    std::vector<const char*> inputs;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(arg, "--page-size") && hasValue)
+            options.pageSize = (uint32_t)atoi(argv[++i]) * 1024;
+        else if (!strcmp(arg, "--compress"))
+            options.compress = true;
+        else if (!strcmp(arg, "-o") && hasValue)
+            output = argv[++i];
+        else if (arg[0] != '-')
+            inputs.push_back(arg);
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (inputs.empty() || output.empty() || options.pageSize == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string error;
+    std::vector<AAPLModelLOD> lods(inputs.size());
+    std::vector<std::vector<uint8_t>> buffers(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        if (!AAPLReadModelDat(inputs[i], lods[i], &buffers[i], error))
+        {
+            fprintf(stderr, "%s: %s\n", inputs[i], error.c_str());
+            return 1;
+        }
+    }
+
+    if (!AAPLWriteModelFile(output.c_str(), lods, buffers, options, error))
+    {
+        fprintf(stderr, "%s: %s\n", output.c_str(), error.c_str());
+        return 1;
+    }
+
+    // Load every level back and check that it matches its `.dat` file.
+    AAPLModelFile file;
+    if (!file.open(output.c_str(), error))
+    {
+        fprintf(stderr, "%s: %s\n", output.c_str(), error.c_str());
+        return 1;
+    }
+
+    int result = 0;
+    printf("%-4s %10s %10s %6s %11s %11s\n", "lod", "vertices", "indices", "pages", "buffer KB", "file KB");
+    for (uint32_t l = 0; l < file.lodCount(); ++l)
+    {
+        const AAPLModelLOD& lod = file.lod(l);
+        std::vector<uint8_t> loaded(lod.bufferSize);
+        const bool correct = file.loadLOD(l, loaded.data(), 0, error) && loaded == buffers[l];
+
+        printf("%-4u %10u %10u %6u %11.1f %11.1f%s\n", l, lod.vertexCount, lod.indexCount, file.pageCount(l),
+               lod.bufferSize / 1024.0, file.fileSize(l) / 1024.0, correct ? "" : "  MISMATCH");
+        result |= !correct;
+    }
+    return result;
+}
+
+int bench(int argc, char** argv)
+{
+    std::vector<uint32_t> threadCounts = { 1, 4 };
+    uint32_t repeat = 5;
+    bool evicting = false;
+    const char* path = nullptr;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(arg, "--threads") && hasValue)
+            threadCounts = parseList(argv[++i]);
+        else if (!strcmp(arg, "--repeat") && hasValue)
+            repeat = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--evict"))
+            evicting = true;
+        else if (arg[0] != '-' && !path)
+            path = arg;
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!path || repeat == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string error;
+    AAPLModelFile file;
+    if (!file.open(path, error))
+    {
+        fprintf(stderr, "%s: %s\n", path, error.c_str());
+        return 1;
+    }
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 1;
+
+    printf("%-4s %6s %11s %-14s %9s %9s\n", "lod", "pages", "file KB", "load", "ms", "MB/s");
+
+    int result = 0;
+    for (uint32_t l = 0; l < file.lodCount(); ++l)
+    {
+        const AAPLModelLOD& lod = file.lod(l);
+        const double megabytes = lod.bufferSize / (1024.0 * 1024.0);
+        std::vector<uint8_t> buffer(lod.bufferSize);
+
+        // As a `.dat` file loads: one read of the level's bytes, which are contiguous in the file.
+        {
+            const uint64_t offset = file.pageCount(l) ? file.page(file.firstPage(l)).fileOffset : 0;
+            const uint64_t size   = file.fileSize(l);
+            std::vector<uint8_t> whole(size);
+
+            double elapsed = 0.0;
+            bool read = true;
+            for (uint32_t r = 0; r < repeat; ++r)
+            {
+                if (evicting)
+                    evict(path);
+                auto begin = std::chrono::steady_clock::now();
+                read &= pread(fd, whole.data(), whole.size(), (off_t)offset) == (ssize_t)whole.size();
+                elapsed += seconds(begin);
+            }
+            elapsed /= repeat;
+            printf("%-4u %6u %11.1f %-14s %9.2f %9.1f%s\n", l, file.pageCount(l), size / 1024.0, "single read",
+                   elapsed * 1e3, megabytes / elapsed, read ? "" : "  FAILED");
+            result |= !read;
+        }
+
+        for (uint32_t threadCount : threadCounts)
+        {
+            double elapsed = 0.0;
+            bool loaded = true;
+            for (uint32_t r = 0; r < repeat; ++r)
+            {
+                if (evicting)
+                    evict(path);
+                auto begin = std::chrono::steady_clock::now();
+                loaded &= file.loadLOD(l, buffer.data(), threadCount, error);
+                elapsed += seconds(begin);
+            }
+            elapsed /= repeat;
+
+            char name[32];
+            snprintf(name, sizeof(name), "pages, %u thr", threadCount);
+            printf("%-4u %6u %11.1f %-14s %9.2f %9.1f%s\n", l, file.pageCount(l), file.fileSize(l) / 1024.0, name,
+                   elapsed * 1e3, megabytes / elapsed, loaded ? "" : "  FAILED");
+            result |= !loaded;
+            if (!loaded)
+                fprintf(stderr, "%s\n", error.c_str());
+        }
+    }
+
+    close(fd);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc >= 2 && !strcmp(argv[1], "convert"))
+        return convert(argc, argv);
+    if (argc >= 2 && !strcmp(argv[1], "bench"))
+        return bench(argc, argv);
+
+    printUsage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,281 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that measures how fast the staging ring uploads mipmapped textures from a
+ file through the memcpy copy engine, against a temporary buffer for each level.
+*/
+#include "../Renderer/AAPLStagingRing.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --textures N         Textures to upload (default 6)\n"
+            "  --size N             Width and height of each texture's base level (default 4096)\n"
+            "  --buffers LIST       Comma separated staging buffer counts (default 1,2,3)\n"
+            "  --buffer-size MB     Size of each staging buffer (default 16)\n"
+            "  --readers LIST       Comma separated reader thread counts (default 0,1,4)\n"
+            "  --latency N          Microseconds the copy engine waits before each submit (default 0)\n"
+            "  --file PATH          Where to write the texture file (default a temporary file)\n",
+            program);
+}
+
+std::vector<uint32_t> parseList(const char* list)
+{
+    std::vector<uint32_t> values;
+    for (const char* p = list; p; )
+    {
+        values.push_back((uint32_t)atoi(p));
+        p = strchr(p, ',');
+        if (p)
+            ++p;
+    }
+    return values;
+}
+
+// A level of a texture with 4x4 blocks of 16 bytes, like BC7 or ASTC 4x4.
+struct Level
+{
+    size_t  fileOffset;
+    size_t  size;
+    size_t  bytesPerRow;    // Of a row of blocks.
+};
+
+struct Texture
+{
+    std::vector<Level>      levels;
+    std::vector<uint8_t>    memory;     // Destination of every level.
+};
+
+// Writes the levels of every texture to the file, and returns its size.
+size_t writeTextures(int file, std::vector<Texture>& textures, uint32_t size)
+{
+    size_t offset = 0;
+    std::vector<uint8_t> bytes;
+    for (size_t t = 0; t < textures.size(); ++t)
+    {
+        size_t textureSize = 0;
+        for (uint32_t dimension = size; ; dimension = std::max(dimension / 2, 1u))
+        {
+            const size_t blocks = std::max(dimension / 4, 1u);
+            Level level = { offset, blocks * blocks * 16, blocks * 16 };
+
+            bytes.resize(level.size);
+            for (size_t i = 0; i < bytes.size(); ++i)
+                bytes[i] = (uint8_t)((offset + i) * 2654435761u >> 13);
+            if (pwrite(file, bytes.data(), bytes.size(), offset) != (ssize_t)bytes.size())
+                return 0;
+
+            textures[t].levels.push_back(level);
+            textureSize += level.size;
+            offset += level.size;
+            if (dimension == 1)
+                break;
+        }
+        textures[t].memory.resize(textureSize);
+    }
+    return offset;
+}
+
+bool checkTextures(int file, const std::vector<Texture>& textures)
+{
+    std::vector<uint8_t> expected;
+    for (const Texture& texture : textures)
+    {
+        expected.resize(texture.memory.size());
+        if (pread(file, expected.data(), expected.size(), texture.levels[0].fileOffset) != (ssize_t)expected.size())
+            return false;
+        if (expected != texture.memory)
+            return false;
+    }
+    return true;
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Loads each texture as the sample did: a new buffer for each level, filled by one read,
+//  then the copies of every level, waiting for them before the next texture.
+double uploadWithTemporaryBuffers(AAPLMemcpyCopyEngine& engine, int file, std::vector<Texture>& textures)
+{
+    auto begin = std::chrono::steady_clock::now();
+    uint32_t index = 0;
+    for (Texture& texture : textures)
+    {
+        size_t destinationOffset = 0;
+        for (const Level& level : texture.levels)
+        {
+            uint8_t* buffer = static_cast<uint8_t*>(engine.createStagingBuffer(index, level.size));
+            if (pread(file, buffer, level.size, level.fileOffset) != (ssize_t)level.size)
+                return 0.0;
+
+            engine.copy({ (uint64_t)(uintptr_t)texture.memory.data(), destinationOffset, index, 0, level.size });
+            destinationOffset += level.size;
+            ++index;
+        }
+        engine.waitForFence(engine.submit());
+    }
+    return seconds(begin);
+}
+
+double uploadWithRing(AAPLMemcpyCopyEngine& engine, int file, std::vector<Texture>& textures,
+                      const AAPLStagingRingDesc& desc, AAPLStagingRingStats& stats)
+{
+    AAPLStagingRing ring(engine, desc);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (Texture& texture : textures)
+    {
+        size_t destinationOffset = 0;
+        for (const Level& level : texture.levels)
+        {
+            // The memcpy engine copies to the level's place within the texture's memory.
+            AAPLStagingUpload upload;
+            upload.destination  = (uint64_t)(uintptr_t)(texture.memory.data() + destinationOffset);
+            upload.size         = level.size;
+            upload.splitSize    = level.bytesPerRow;
+
+            const size_t fileOffset = level.fileOffset;
+            upload.read = [file, fileOffset](void* destination, size_t offset, size_t size)
+            {
+                return pread(file, destination, size, fileOffset + offset) == (ssize_t)size;
+            };
+            destinationOffset += level.size;
+
+            if (!ring.upload(upload))
+                return 0.0;
+        }
+    }
+    const bool succeeded = ring.finish();
+    const double elapsed = seconds(begin);
+    stats = ring.stats();
+    return succeeded ? elapsed : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t textureCount   = 6;
+    uint32_t size           = 4096;
+    uint32_t bufferSizeMB   = 16;
+    uint32_t latency        = 0;
+    std::vector<uint32_t> bufferCounts = { 1, 2, 3 };
+    std::vector<uint32_t> readerCounts = { 0, 1, 4 };
+    std::string path;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (!strcmp(arg, "--textures") && hasValue)
+            textureCount = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--size") && hasValue)
+            size = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--buffers") && hasValue)
+            bufferCounts = parseList(argv[++i]);
+        else if (!strcmp(arg, "--buffer-size") && hasValue)
+            bufferSizeMB = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--readers") && hasValue)
+            readerCounts = parseList(argv[++i]);
+        else if (!strcmp(arg, "--latency") && hasValue)
+            latency = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--file") && hasValue)
+            path = argv[++i];
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (textureCount == 0 || size < 4 || bufferSizeMB == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Write the textures once; later passes read them from the file cache.
+    std::vector<char> name;
+    int file = -1;
+    if (path.empty())
+    {
+        const char pattern[] = "/tmp/AAPLStagingRingXXXXXX";
+        name.assign(pattern, pattern + sizeof(pattern));
+        file = mkstemp(name.data());
+        path = name.data();
+    }
+    else
+    {
+        file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+
+    std::vector<Texture> textures(textureCount);
+    const size_t fileSize = file < 0 ? 0 : writeTextures(file, textures, size);
+    if (fileSize == 0)
+    {
+        fprintf(stderr, "Couldn't write the textures to %s\n", path.c_str());
+        return 1;
+    }
+
+    const double megabytes = fileSize / (1024.0 * 1024.0);
+    printf("%u textures of %u x %u with mipmaps, %.1f MB, copy latency %u us\n",
+           textureCount, size, size, megabytes, latency);
+    printf("%-18s %7s %7s %9s %9s %9s %6s %6s\n", "", "buffers", "readers", "ms", "MB/s", "ring MB/s", "depth", "waits");
+
+    int result = 0;
+    {
+        AAPLMemcpyCopyEngine engine(latency);
+        const double elapsed = uploadWithTemporaryBuffers(engine, file, textures);
+        const bool correct = elapsed > 0.0 && checkTextures(file, textures);
+        printf("%-18s %7s %7s %9.1f %9.1f %9s %6s %6s%s\n", "temporary buffers", "-", "-",
+               elapsed * 1e3, megabytes / elapsed, "-", "-", "-", correct ? "" : "  FAILED");
+        result |= !correct;
+    }
+
+    for (uint32_t bufferCount : bufferCounts)
+    {
+        for (uint32_t readerCount : readerCounts)
+        {
+            for (Texture& texture : textures)
+                std::fill(texture.memory.begin(), texture.memory.end(), 0);
+
+            AAPLStagingRingDesc desc;
+            desc.bufferCount        = std::max(bufferCount, 1u);
+            desc.bufferSize         = (size_t)bufferSizeMB << 20;
+            desc.readerThreadCount  = readerCount;
+
+            AAPLMemcpyCopyEngine engine(latency);
+            AAPLStagingRingStats stats = {};
+            const double elapsed = uploadWithRing(engine, file, textures, desc, stats);
+            const bool correct = elapsed > 0.0 && checkTextures(file, textures);
+            printf("%-18s %7u %7u %9.1f %9.1f %9.1f %6u %6llu%s\n", "staging ring", desc.bufferCount, readerCount,
+                   elapsed * 1e3, megabytes / elapsed, stats.bytesPerSecond() / (1024.0 * 1024.0),
+                   stats.maxQueueDepth, (unsigned long long)stats.fenceWaits, correct ? "" : "  FAILED");
+            result |= !correct;
+        }
+    }
+
+    close(file);
+    if (!name.empty())
+        unlink(name.data());
+    return result;
+}
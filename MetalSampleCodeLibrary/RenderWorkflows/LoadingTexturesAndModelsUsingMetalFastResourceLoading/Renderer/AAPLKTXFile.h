@@ -0,0 +1,288 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the KTX container reader, which maps KTX1 and KTX2 texture files and locates
+ the images of each mipmap level, array layer and cube face in place.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#ifdef __OBJC__
+#import <Metal/Metal.h>
+#endif
+
+// Bytes of a file, pointing into its mapping.
+struct AAPLKTXSpan
+{
+    const uint8_t*  data    = nullptr;
+    size_t          size    = 0;
+};
+
+// Layout of a pixel format.  Uncompressed formats have 1x1 blocks of one pixel.
+struct AAPLKTXFormat
+{
+    uint32_t    glInternalFormat;   // KTX1 code, or 0 if the format has none.
+    uint32_t    vkFormat;           // KTX2 code.
+    uint8_t     blockWidth;
+    uint8_t     blockHeight;
+    uint8_t     bytesPerBlock;
+    bool        sRGB;
+};
+
+// Return the format with a KTX1 or KTX2 code, or nullptr if the reader doesn't know it.
+const AAPLKTXFormat* AAPLKTXFormatForGLInternalFormat(uint32_t glInternalFormat);
+const AAPLKTXFormat* AAPLKTXFormatForVkFormat(uint32_t vkFormat);
+
+// Reads the header, key/value data and level index of a KTX1 or KTX2 file, checking that
+//  every image lies within the file.  Images of files that aren't supercompressed are
+//  returned as spans of the mapping without copying; the levels of supercompressed files
+//  decode through `AAPLKTXLevelDecoder`.
+//
+// Within a level, images are ordered by array layer, then cube face, then depth slice.
+class AAPLKTXFile
+{
+public:
+    enum Supercompression : uint32_t
+    {
+        SupercompressionNone    = 0,
+        SupercompressionBasisLZ = 1,
+        SupercompressionZstd    = 2,
+        SupercompressionZlib    = 3,
+    };
+
+    // Largest size of a dimension the reader accepts, which bounds the level count.
+    static const uint32_t MaxDimension  = 1u << 16;
+    static const uint32_t MaxLevelCount = 17;
+
+    struct Level
+    {
+        uint64_t    offset;             // Of the level's data from the start of the file.
+        uint64_t    length;             // Bytes in the file, compressed if supercompressed.
+        uint64_t    uncompressedLength;
+        uint64_t    bytesPerImage;      // Of one depth slice of one face of one layer.
+        uint64_t    faceStride;         // Between consecutive faces, or layers.
+        uint32_t    bytesPerRow;        // Of a row of blocks; KTX1 pads rows to 4 bytes.
+        uint32_t    width;
+        uint32_t    height;
+        uint32_t    depth;
+    };
+
+    AAPLKTXFile() = default;
+    ~AAPLKTXFile();
+
+    AAPLKTXFile(const AAPLKTXFile&) = delete;
+    AAPLKTXFile& operator=(const AAPLKTXFile&) = delete;
+
+    // Maps the file at `path` and parses it.
+    bool open(const char* path, std::string& error);
+
+    // Parses a file already in memory, which must outlive the reader.
+    bool parse(const void* data, size_t size, std::string& error);
+
+    // Unmaps the file and forgets its contents.
+    void close();
+
+    bool                 isOpen() const             { return _format != nullptr; }
+    uint32_t             version() const            { return _version; }
+    const AAPLKTXFormat& format() const             { return *_format; }
+    Supercompression     supercompression() const   { return _supercompression; }
+
+    // Dimensions are at least 1, whatever the header stores for 1D, 2D and non array textures.
+    uint32_t width() const                          { return _width; }
+    uint32_t height() const                         { return _height; }
+    uint32_t depth() const                          { return _depth; }
+    uint32_t layerCount() const                     { return _layerCount; }
+    uint32_t faceCount() const                      { return _faceCount; }
+    uint32_t levelCount() const                     { return _levelCount; }
+
+    bool isArray() const                            { return _isArray; }
+    bool isCube() const                             { return _faceCount == 6; }
+
+    // The file stores only the base level and asks the loader to generate the others.
+    bool generatesMipmaps() const                   { return _generatesMipmaps; }
+
+    const Level& level(uint32_t level) const        { return _levels[level]; }
+
+    // Data of a level as stored in the file.
+    AAPLKTXSpan levelData(uint32_t level) const;
+
+    // One depth slice of one face of one layer, or an empty span for supercompressed files.
+    AAPLKTXSpan image(uint32_t level, uint32_t layer, uint32_t face, uint32_t slice = 0) const;
+
+    // The whole mapping, so that file offsets can be turned into pointers.
+    AAPLKTXSpan fileData() const                    { return { _data, _size }; }
+
+    // Value of a key, including any terminating null character, or an empty span if the file
+    //  has no such key.
+    AAPLKTXSpan value(const char* key) const;
+
+    size_t      keyValueCount() const               { return _keyValues.size(); }
+    const char* key(size_t index) const             { return _keyValues[index].key; }
+    AAPLKTXSpan value(size_t index) const           { return _keyValues[index].value; }
+
+private:
+    struct KeyValue
+    {
+        const char* key;
+        AAPLKTXSpan value;
+    };
+
+    bool fail(std::string& error, const char* message);
+    bool parseKeyValues(size_t offset, size_t length, std::string& error);
+    bool setFormat(const AAPLKTXFormat* format, uint32_t width, uint32_t height, uint32_t depth,
+                   uint32_t layerCount, uint32_t faceCount, uint32_t levelCount, std::string& error);
+    bool parseKTX1(std::string& error);
+    bool parseKTX2(std::string& error);
+
+    void*                   _mapping            = nullptr;
+    size_t                  _mappingSize        = 0;
+
+    const uint8_t*          _data               = nullptr;
+    size_t                  _size               = 0;
+
+    const AAPLKTXFormat*    _format             = nullptr;
+    uint32_t                _version            = 0;
+    Supercompression        _supercompression   = SupercompressionNone;
+    uint32_t                _width              = 0;
+    uint32_t                _height             = 0;
+    uint32_t                _depth              = 0;
+    uint32_t                _layerCount         = 0;
+    uint32_t                _faceCount          = 0;
+    uint32_t                _levelCount         = 0;
+    bool                    _isArray            = false;
+    bool                    _generatesMipmaps   = false;
+
+    Level                   _levels[MaxLevelCount];
+    std::vector<KeyValue>   _keyValues;
+};
+
+// Decodes a level of a KTX file in pieces into buffers provided by the caller, so that a
+//  supercompressed level can stream into staging memory smaller than the level.  Levels
+//  that aren't supercompressed are copied.  Zlib decodes with libcompression on Apple
+//  platforms and zlib elsewhere; Zstd needs <zstd.h> at build time.
+class AAPLKTXLevelDecoder
+{
+public:
+    AAPLKTXLevelDecoder() = default;
+    ~AAPLKTXLevelDecoder();
+
+    AAPLKTXLevelDecoder(const AAPLKTXLevelDecoder&) = delete;
+    AAPLKTXLevelDecoder& operator=(const AAPLKTXLevelDecoder&) = delete;
+
+    // Starts decoding `level` of `file`, which must stay open until decoding ends.
+    bool begin(const AAPLKTXFile& file, uint32_t level, std::string& error);
+
+    // Decodes the next bytes of the level to `destination`, filling `capacity` bytes unless
+    //  the level ends first, and sets `written` to the number of bytes decoded.
+    bool decode(void* destination, size_t capacity, size_t& written, std::string& error);
+
+    // Uncompressed bytes of the level not decoded yet.
+    uint64_t remaining() const                      { return _remaining; }
+
+private:
+    void end();
+
+    AAPLKTXFile::Supercompression   _scheme     = AAPLKTXFile::SupercompressionNone;
+    AAPLKTXSpan                     _input;
+    size_t                          _consumed   = 0;
+    uint64_t                        _remaining  = 0;
+    void*                           _stream     = nullptr;
+};
+
+// Decodes a whole level into `destination`, which must hold its uncompressed length.
+bool AAPLKTXDecodeLevel(const AAPLKTXFile& file, uint32_t level, void* destination, size_t size, std::string& error);
+
+#ifdef __OBJC__
+
+// Metal pixel format of a KTX format, or MTLPixelFormatInvalid if Metal has none.  With
+//  `linear`, sRGB formats map to their linear counterparts so that sampling returns the
+//  stored values, as MTKTextureLoader does with MTKTextureLoaderOptionSRGB set to NO.
+inline MTLPixelFormat AAPLKTXMetalPixelFormat(const AAPLKTXFormat& format, bool linear = false)
+{
+    uint32_t vkFormat = format.vkFormat;
+    if (linear && format.sRGB)
+    {
+        // Compressed sRGB formats directly follow their linear counterparts.
+        if (vkFormat == 43)
+            vkFormat = 37;
+        else if (vkFormat == 50)
+            vkFormat = 44;
+        else
+            vkFormat--;
+    }
+
+    switch (vkFormat)
+    {
+        case 9:     return MTLPixelFormatR8Unorm;
+        case 16:    return MTLPixelFormatRG8Unorm;
+        case 37:    return MTLPixelFormatRGBA8Unorm;
+        case 43:    return MTLPixelFormatRGBA8Unorm_sRGB;
+        case 44:    return MTLPixelFormatBGRA8Unorm;
+        case 50:    return MTLPixelFormatBGRA8Unorm_sRGB;
+        case 76:    return MTLPixelFormatR16Float;
+        case 83:    return MTLPixelFormatRG16Float;
+        case 97:    return MTLPixelFormatRGBA16Float;
+        case 100:   return MTLPixelFormatR32Float;
+        case 103:   return MTLPixelFormatRG32Float;
+        case 109:   return MTLPixelFormatRGBA32Float;
+        case 122:   return MTLPixelFormatRG11B10Float;
+        case 123:   return MTLPixelFormatRGB9E5Float;
+        case 133:   return MTLPixelFormatBC1_RGBA;
+        case 134:   return MTLPixelFormatBC1_RGBA_sRGB;
+        case 135:   return MTLPixelFormatBC2_RGBA;
+        case 136:   return MTLPixelFormatBC2_RGBA_sRGB;
+        case 137:   return MTLPixelFormatBC3_RGBA;
+        case 138:   return MTLPixelFormatBC3_RGBA_sRGB;
+        case 139:   return MTLPixelFormatBC4_RUnorm;
+        case 140:   return MTLPixelFormatBC4_RSnorm;
+        case 141:   return MTLPixelFormatBC5_RGUnorm;
+        case 142:   return MTLPixelFormatBC5_RGSnorm;
+        case 143:   return MTLPixelFormatBC6H_RGBUfloat;
+        case 144:   return MTLPixelFormatBC6H_RGBFloat;
+        case 145:   return MTLPixelFormatBC7_RGBAUnorm;
+        case 146:   return MTLPixelFormatBC7_RGBAUnorm_sRGB;
+        case 147:   return MTLPixelFormatETC2_RGB8;
+        case 148:   return MTLPixelFormatETC2_RGB8_sRGB;
+        case 151:   return MTLPixelFormatEAC_RGBA8;
+        case 152:   return MTLPixelFormatEAC_RGBA8_sRGB;
+        case 153:   return MTLPixelFormatEAC_R11Unorm;
+        case 155:   return MTLPixelFormatEAC_RG11Unorm;
+        case 157:   return MTLPixelFormatASTC_4x4_LDR;
+        case 158:   return MTLPixelFormatASTC_4x4_sRGB;
+        case 159:   return MTLPixelFormatASTC_5x4_LDR;
+        case 160:   return MTLPixelFormatASTC_5x4_sRGB;
+        case 161:   return MTLPixelFormatASTC_5x5_LDR;
+        case 162:   return MTLPixelFormatASTC_5x5_sRGB;
+        case 163:   return MTLPixelFormatASTC_6x5_LDR;
+        case 164:   return MTLPixelFormatASTC_6x5_sRGB;
+        case 165:   return MTLPixelFormatASTC_6x6_LDR;
+        case 166:   return MTLPixelFormatASTC_6x6_sRGB;
+        case 167:   return MTLPixelFormatASTC_8x5_LDR;
+        case 168:   return MTLPixelFormatASTC_8x5_sRGB;
+        case 169:   return MTLPixelFormatASTC_8x6_LDR;
+        case 170:   return MTLPixelFormatASTC_8x6_sRGB;
+        case 171:   return MTLPixelFormatASTC_8x8_LDR;
+        case 172:   return MTLPixelFormatASTC_8x8_sRGB;
+        case 173:   return MTLPixelFormatASTC_10x5_LDR;
+        case 174:   return MTLPixelFormatASTC_10x5_sRGB;
+        case 175:   return MTLPixelFormatASTC_10x6_LDR;
+        case 176:   return MTLPixelFormatASTC_10x6_sRGB;
+        case 177:   return MTLPixelFormatASTC_10x8_LDR;
+        case 178:   return MTLPixelFormatASTC_10x8_sRGB;
+        case 179:   return MTLPixelFormatASTC_10x10_LDR;
+        case 180:   return MTLPixelFormatASTC_10x10_sRGB;
+        case 181:   return MTLPixelFormatASTC_12x10_LDR;
+        case 182:   return MTLPixelFormatASTC_12x10_sRGB;
+        case 183:   return MTLPixelFormatASTC_12x12_LDR;
+        case 184:   return MTLPixelFormatASTC_12x12_sRGB;
+        default:    return MTLPixelFormatInvalid;
+    }
+}
+
+#endif // __OBJC__
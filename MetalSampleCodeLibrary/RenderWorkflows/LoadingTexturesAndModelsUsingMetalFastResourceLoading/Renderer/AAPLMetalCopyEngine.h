@@ -0,0 +1,57 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The header for the copy engine that blits the staging ring's buffers to texture levels.
+*/
+
+#pragma once
+
+#import <Metal/Metal.h>
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#import "AAPLStagingRing.h"
+
+/// A copy engine that encodes the staging ring's copies into a blit encoder, and commits one command buffer for each submit.
+class AAPLMetalCopyEngine : public AAPLCopyEngine
+{
+public:
+    AAPLMetalCopyEngine(id<MTLDevice> device, id<MTLCommandQueue> commandQueue);
+
+    /// Return the destination of an upload of a texture level, with rows of blocks `bytesPerRow` bytes apart.
+    /// Each piece of the upload must hold whole rows of blocks.
+    uint64_t addTextureLevel(id<MTLTexture> texture, uint32_t level, uint32_t bytesPerRow, uint32_t blockHeight);
+
+    /// Forget the destinations, once every copy to them has finished.
+    void removeDestinations();
+
+    void*    createStagingBuffer(uint32_t index, size_t size) override;
+    void     copy(const AAPLStagingCopy& copy) override;
+    uint64_t submit() override;
+    uint64_t completedFence() override;
+    void     waitForFence(uint64_t fence) override;
+
+private:
+    struct TextureLevel
+    {
+        id<MTLTexture>  texture;
+        uint32_t        level;
+        uint32_t        bytesPerRow;
+        uint32_t        blockHeight;
+    };
+
+    id<MTLDevice>                                           _device;
+    id<MTLCommandQueue>                                     _commandQueue;
+    std::vector<id<MTLBuffer>>                              _buffers;
+    std::vector<TextureLevel>                               _destinations;
+
+    id<MTLCommandBuffer>                                    _commandBuffer;
+    id<MTLBlitCommandEncoder>                               _blitEncoder;
+    uint64_t                                                _nextFence      = 0;
+
+    /// The committed command buffers, oldest first, with their fences.
+    std::deque<std::pair<uint64_t, id<MTLCommandBuffer>>>   _inFlight;
+};
@@ -0,0 +1,100 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The implementation of the copy engine that blits the staging ring's buffers to texture levels.
+*/
+
+#import "AAPLMetalCopyEngine.h"
+
+#include <algorithm>
+
+AAPLMetalCopyEngine::AAPLMetalCopyEngine(id<MTLDevice> device, id<MTLCommandQueue> commandQueue)
+    : _device(device)
+    , _commandQueue(commandQueue)
+{
+}
+
+uint64_t AAPLMetalCopyEngine::addTextureLevel(id<MTLTexture> texture, uint32_t level, uint32_t bytesPerRow, uint32_t blockHeight)
+{
+    _destinations.push_back({ texture, level, bytesPerRow, blockHeight });
+    return _destinations.size() - 1;
+}
+
+void AAPLMetalCopyEngine::removeDestinations()
+{
+    _destinations.clear();
+}
+
+void* AAPLMetalCopyEngine::createStagingBuffer(uint32_t index, size_t size)
+{
+    if (_buffers.size() <= index)
+        _buffers.resize(index + 1);
+
+    // The CPU only writes the staging buffers, so it doesn't need them cached.
+    _buffers[index] = [_device newBufferWithLength:size
+                                           options:MTLResourceStorageModeShared | MTLResourceCPUCacheModeWriteCombined];
+    _buffers[index].label = [NSString stringWithFormat:@"Staging buffer %u", index];
+    return _buffers[index].contents;
+}
+
+void AAPLMetalCopyEngine::copy(const AAPLStagingCopy& copy)
+{
+    if (!_blitEncoder)
+    {
+        _commandBuffer = [_commandQueue commandBuffer];
+        _commandBuffer.label = @"Staging ring copies";
+        _blitEncoder = [_commandBuffer blitCommandEncoder];
+    }
+
+    // Copy the rows of blocks that the piece holds to the same rows of the level.
+    const TextureLevel& destination = _destinations[copy.destination];
+    const NSUInteger width  = std::max<NSUInteger>(destination.texture.width >> destination.level, 1);
+    const NSUInteger height = std::max<NSUInteger>(destination.texture.height >> destination.level, 1);
+    const NSUInteger firstRow = copy.destinationOffset / destination.bytesPerRow;
+    const NSUInteger rowCount = (copy.size + destination.bytesPerRow - 1) / destination.bytesPerRow;
+    const NSUInteger y = firstRow * destination.blockHeight;
+    assert(copy.destinationOffset % destination.bytesPerRow == 0 && y < height);
+
+    [_blitEncoder copyFromBuffer:_buffers[copy.buffer]
+                    sourceOffset:copy.bufferOffset
+               sourceBytesPerRow:destination.bytesPerRow
+             sourceBytesPerImage:rowCount * destination.bytesPerRow
+                      sourceSize:MTLSizeMake(width, std::min(rowCount * destination.blockHeight, height - y), 1)
+                       toTexture:destination.texture
+                destinationSlice:0
+                destinationLevel:destination.level
+               destinationOrigin:MTLOriginMake(0, y, 0)];
+}
+
+uint64_t AAPLMetalCopyEngine::submit()
+{
+    ++_nextFence;
+    if (_blitEncoder)
+    {
+        [_blitEncoder endEncoding];
+        [_commandBuffer commit];
+        _inFlight.emplace_back(_nextFence, _commandBuffer);
+        _blitEncoder = nil;
+        _commandBuffer = nil;
+    }
+    return _nextFence;
+}
+
+uint64_t AAPLMetalCopyEngine::completedFence()
+{
+    // Command buffers from one queue complete in the order of their commits.
+    while (!_inFlight.empty() && _inFlight.front().second.status >= MTLCommandBufferStatusCompleted)
+        _inFlight.pop_front();
+
+    return _inFlight.empty() ? _nextFence : _inFlight.front().first - 1;
+}
+
+void AAPLMetalCopyEngine::waitForFence(uint64_t fence)
+{
+    while (!_inFlight.empty() && _inFlight.front().first <= fence)
+    {
+        [_inFlight.front().second waitUntilCompleted];
+        _inFlight.pop_front();
+    }
+}
@@ -0,0 +1,553 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the model file reader and converter, and of the `.dat` file reader.
+*/
+#include "AAPLModelFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#if AAPL_HAS_MESHOPTIMIZER
+#include <meshoptimizer.h>
+#endif
+
+namespace
+{
+
+static const uint8_t  Identifier[8]     = { 0xAB, 'M', 'O', 'D', 'E', 'L', 0xBB, 0x0A };
+static const uint32_t Version           = 1;
+static const size_t   HeaderSize        = 64;
+static const size_t   LODEntrySize      = 64;
+static const size_t   PageEntrySize     = 32;
+static const uint64_t PageAlignment     = 16;
+
+// Largest element meshoptimizer's vertex codec takes.
+static const uint32_t MaxVertexSize     = 256;
+
+inline uint32_t readU32(const uint8_t* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint64_t readU64(const uint8_t* data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline void writeU32(uint8_t* data, uint32_t value)
+{
+    memcpy(data, &value, sizeof(value));
+}
+
+inline void writeU64(uint8_t* data, uint64_t value)
+{
+    memcpy(data, &value, sizeof(value));
+}
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Whether `count` elements of `stride` bytes at `offset` lie within `size` bytes.
+inline bool fits(uint64_t offset, uint64_t count, uint64_t stride, uint64_t size)
+{
+    return offset <= size && count <= (size - offset) / stride;
+}
+
+bool fail(std::string& error, const char* message)
+{
+    error = message;
+    return false;
+}
+
+// Reads `size` bytes at `offset`, continuing after short reads.
+bool readFully(int fd, void* destination, size_t size, uint64_t offset)
+{
+    uint8_t* bytes = static_cast<uint8_t*>(destination);
+    while (size)
+    {
+        const ssize_t result = pread(fd, bytes, size, (off_t)offset);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+
+        bytes  += result;
+        size   -= (size_t)result;
+        offset += (uint64_t)result;
+    }
+    return true;
+}
+
+bool writeFully(FILE* file, const void* data, size_t size)
+{
+    return fwrite(data, 1, size, file) == size;
+}
+
+void parallelFor(size_t count, unsigned threadCount, const std::function<void(size_t)>& task)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = (unsigned)std::min<size_t>(threadCount, count);
+
+    std::atomic<size_t> next(0);
+    const auto worker = [&]()
+    {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count; )
+            task(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < threadCount; ++t)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+// Checks that every stream of a level lies within its buffer.
+bool checkLOD(const AAPLModelLOD& lod, std::string& error)
+{
+    if (!fits(lod.positionsOffset, lod.vertexCount, AAPLModelPositionStride, lod.bufferSize) ||
+        !fits(lod.normalsOffset,   lod.vertexCount, AAPLModelNormalStride,   lod.bufferSize) ||
+        !fits(lod.texcoordsOffset, lod.vertexCount, AAPLModelTexcoordStride, lod.bufferSize) ||
+        !fits(lod.indexOffset,     lod.indexCount,  AAPLModelIndexStride,    lod.bufferSize))
+        return fail(error, "A stream of the model lies outside its buffer");
+    return true;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+bool AAPLReadModelDat(const char* path, AAPLModelLOD& lod, std::vector<uint8_t>* buffer, std::string& error)
+{
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return fail(error, "Couldn't open the model");
+
+    struct stat info;
+    AAPLModelBufferFileHeader header;
+    const bool read = fstat(fd, &info) == 0 && readFully(fd, &header, sizeof(header), 0);
+    if (!read || (uint64_t)info.st_size < sizeof(header))
+    {
+        ::close(fd);
+        return fail(error, "Couldn't read the model's header");
+    }
+
+    const uint64_t fileSize = (uint64_t)info.st_size;
+    if (header.vertexCount > UINT32_MAX || header.indexCount > UINT32_MAX ||
+        !fits(header.vertexFileOffset, header.bufferSizeInBytes, 1, fileSize))
+    {
+        ::close(fd);
+        return fail(error, "The model's buffer lies outside its file");
+    }
+
+    lod.vertexCount     = (uint32_t)header.vertexCount;
+    lod.indexCount      = (uint32_t)header.indexCount;
+    lod.bufferSize      = header.bufferSizeInBytes;
+    lod.positionsOffset = header.vertexPositionsOffset;
+    lod.normalsOffset   = header.vertexNormalsOffset;
+    lod.texcoordsOffset = header.vertexTexcoordOffset;
+    lod.indexOffset     = header.vertexSizeInBytes;     // As the renderer draws it.
+
+    bool succeeded = checkLOD(lod, error);
+    if (succeeded && buffer)
+    {
+        buffer->resize(lod.bufferSize);
+        succeeded = readFully(fd, buffer->data(), buffer->size(), header.vertexFileOffset);
+        if (!succeeded)
+            error = "Couldn't read the model's buffer";
+    }
+
+    ::close(fd);
+    return succeeded;
+}
+
+//------------------------------------------------------------------------------
+
+AAPLModelFile::~AAPLModelFile()
+{
+    close();
+}
+
+void AAPLModelFile::close()
+{
+    if (_fd >= 0)
+        ::close(_fd);
+    _fd = -1;
+    _lods.clear();
+    _pages.clear();
+}
+
+bool AAPLModelFile::open(const char* path, std::string& error)
+{
+    close();
+
+    _fd = ::open(path, O_RDONLY);
+    if (_fd < 0)
+        return fail(error, "Couldn't open the model file");
+
+    struct stat info;
+    uint8_t header[HeaderSize];
+    if (fstat(_fd, &info) != 0 || (uint64_t)info.st_size < HeaderSize || !readFully(_fd, header, HeaderSize, 0))
+    {
+        close();
+        return fail(error, "Couldn't read the model file's header");
+    }
+
+    if (memcmp(header, Identifier, sizeof(Identifier)) != 0 || readU32(header + 8) != Version)
+    {
+        close();
+        return fail(error, "The file isn't a model file of a known version");
+    }
+
+    const uint64_t fileSize         = (uint64_t)info.st_size;
+    const uint32_t lodCount         = readU32(header + 12);
+    const uint32_t pageCount        = readU32(header + 16);
+    const uint64_t lodTableOffset   = readU64(header + 24);
+    const uint64_t pageTableOffset  = readU64(header + 32);
+    if (lodCount == 0 || !fits(lodTableOffset, lodCount, LODEntrySize, fileSize) ||
+        !fits(pageTableOffset, pageCount, PageEntrySize, fileSize))
+    {
+        close();
+        return fail(error, "The model file's tables lie outside the file");
+    }
+
+    std::vector<uint8_t> table(lodCount * LODEntrySize + pageCount * PageEntrySize);
+    if (!readFully(_fd, table.data(), lodCount * LODEntrySize, lodTableOffset) ||
+        !readFully(_fd, table.data() + lodCount * LODEntrySize, pageCount * PageEntrySize, pageTableOffset))
+    {
+        close();
+        return fail(error, "Couldn't read the model file's tables");
+    }
+
+    _pages.resize(pageCount);
+    for (uint32_t i = 0; i < pageCount; ++i)
+    {
+        const uint8_t* entry = table.data() + lodCount * LODEntrySize + i * PageEntrySize;
+        Page& page = _pages[i];
+        page.fileOffset         = readU64(entry);
+        page.fileSize           = readU32(entry + 8);
+        page.kind               = (PageKind)entry[12];
+        page.codec              = (Codec)entry[13];
+        page.elementSize        = (uint16_t)(entry[14] | (entry[15] << 8));
+        page.destinationOffset  = readU64(entry + 16);
+        page.elementCount       = readU32(entry + 24);
+
+        const uint64_t size = (uint64_t)page.elementCount * page.elementSize;
+        bool valid = page.kind <= PageIndices && page.codec <= CodecMeshopt && page.elementSize > 0 &&
+                     fits(page.fileOffset, page.fileSize, 1, fileSize);
+        if (page.kind == PageIndices)
+            valid = valid && (page.elementSize == 2 || page.elementSize == 4);
+        if (page.codec == CodecNone)
+            valid = valid && page.fileSize == size;
+        else if (page.kind == PageVertices)
+            valid = valid && page.elementSize % 4 == 0 && page.elementSize <= MaxVertexSize;
+        else
+            valid = valid && page.elementCount % 3 == 0;
+
+        if (!valid)
+        {
+            close();
+            return fail(error, "A page of the model file is invalid");
+        }
+    }
+
+    _lods.resize(lodCount);
+    for (uint32_t i = 0; i < lodCount; ++i)
+    {
+        const uint8_t* entry = table.data() + i * LODEntrySize;
+        LODEntry& lod = _lods[i];
+        lod.lod.vertexCount     = readU32(entry);
+        lod.lod.indexCount      = readU32(entry + 4);
+        lod.firstPage           = readU32(entry + 8);
+        lod.pageCount           = readU32(entry + 12);
+        lod.lod.bufferSize      = readU64(entry + 16);
+        lod.lod.positionsOffset = readU64(entry + 24);
+        lod.lod.normalsOffset   = readU64(entry + 32);
+        lod.lod.texcoordsOffset = readU64(entry + 40);
+        lod.lod.indexOffset     = readU64(entry + 48);
+
+        if (lod.firstPage > pageCount || lod.pageCount > pageCount - lod.firstPage || !checkLOD(lod.lod, error))
+        {
+            close();
+            return fail(error, "A level of detail of the model file is invalid");
+        }
+
+        for (uint32_t p = lod.firstPage; p < lod.firstPage + lod.pageCount; ++p)
+        {
+            if (!fits(_pages[p].destinationOffset, _pages[p].elementCount, _pages[p].elementSize, lod.lod.bufferSize))
+            {
+                close();
+                return fail(error, "A page of the model file lies outside its buffer");
+            }
+        }
+    }
+
+    return true;
+}
+
+uint64_t AAPLModelFile::fileSize(uint32_t lod) const
+{
+    uint64_t size = 0;
+    for (uint32_t p = _lods[lod].firstPage; p < _lods[lod].firstPage + _lods[lod].pageCount; ++p)
+        size += _pages[p].fileSize;
+    return size;
+}
+
+bool AAPLModelFile::loadPage(uint32_t index, void* buffer, std::vector<uint8_t>& scratch, std::string& error) const
+{
+    const Page& page = _pages[index];
+    uint8_t* destination = static_cast<uint8_t*>(buffer) + page.destinationOffset;
+
+    if (page.codec == CodecNone)
+    {
+        if (!readFully(_fd, destination, page.fileSize, page.fileOffset))
+            return fail(error, "Couldn't read a page of the model file");
+        return true;
+    }
+
+#if AAPL_HAS_MESHOPTIMIZER
+    scratch.resize(page.fileSize);
+    if (!readFully(_fd, scratch.data(), scratch.size(), page.fileOffset))
+        return fail(error, "Couldn't read a page of the model file");
+
+    const int result = page.kind == PageVertices ?
+        meshopt_decodeVertexBuffer(destination, page.elementCount, page.elementSize, scratch.data(), scratch.size()) :
+        meshopt_decodeIndexBuffer(destination, page.elementCount, page.elementSize, scratch.data(), scratch.size());
+    if (result != 0)
+        return fail(error, "A page of the model file is corrupt");
+    return true;
+#else
+    (void)scratch;
+    (void)destination;
+    return fail(error, "This build can't decode meshoptimizer pages");
+#endif
+}
+
+bool AAPLModelFile::loadLOD(uint32_t lod, void* buffer, unsigned threadCount, std::string& error) const
+{
+    std::mutex errorMutex;
+    std::atomic<bool> failed(false);
+
+    const uint32_t firstPage = _lods[lod].firstPage;
+    parallelFor(_lods[lod].pageCount, threadCount, [&](size_t i)
+    {
+        if (failed.load(std::memory_order_relaxed))
+            return;
+
+        thread_local std::vector<uint8_t> scratch;
+        std::string pageError;
+        if (!loadPage(firstPage + (uint32_t)i, buffer, scratch, pageError))
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!failed.exchange(true))
+                error = pageError;
+        }
+    });
+    return !failed;
+}
+
+//------------------------------------------------------------------------------
+
+bool AAPLWriteModelFile(const char* path, const std::vector<AAPLModelLOD>& lods,
+                        const std::vector<std::vector<uint8_t>>& buffers,
+                        const AAPLModelFileOptions& options, std::string& error)
+{
+    if (lods.empty() || lods.size() != buffers.size())
+        return fail(error, "There must be a buffer for each level of detail");
+
+#if !AAPL_HAS_MESHOPTIMIZER
+    if (options.compress)
+        return fail(error, "This build can't compress pages with meshoptimizer");
+#endif
+
+    // Split each stream of each level into pages, holding whole triangles of indices.
+    struct PageSource
+    {
+        AAPLModelFile::Page     page;
+        const uint8_t*          data;
+        std::vector<uint8_t>    encoded;
+    };
+    std::vector<PageSource> sources;
+    std::vector<uint32_t> firstPages;
+
+    for (size_t l = 0; l < lods.size(); ++l)
+    {
+        const AAPLModelLOD& lod = lods[l];
+        if (buffers[l].size() != lod.bufferSize || !checkLOD(lod, error))
+            return fail(error, "A level of detail doesn't match its buffer");
+
+        struct Stream
+        {
+            uint64_t                    offset;
+            uint32_t                    count;
+            uint32_t                    stride;
+            AAPLModelFile::PageKind     kind;
+        };
+        const Stream streams[] =
+        {
+            { lod.positionsOffset, lod.vertexCount, AAPLModelPositionStride, AAPLModelFile::PageVertices },
+            { lod.normalsOffset,   lod.vertexCount, AAPLModelNormalStride,   AAPLModelFile::PageVertices },
+            { lod.texcoordsOffset, lod.vertexCount, AAPLModelTexcoordStride, AAPLModelFile::PageVertices },
+            { lod.indexOffset,     lod.indexCount,  AAPLModelIndexStride,    AAPLModelFile::PageIndices  },
+        };
+
+        firstPages.push_back((uint32_t)sources.size());
+        for (const Stream& stream : streams)
+        {
+            uint32_t perPage = std::max(options.pageSize / stream.stride, 1u);
+            if (stream.kind == AAPLModelFile::PageIndices)
+                perPage = std::max(perPage / 3 * 3, 3u);
+
+            for (uint32_t first = 0; first < stream.count; first += perPage)
+            {
+                PageSource source;
+                source.page.kind                = stream.kind;
+                source.page.codec               = AAPLModelFile::CodecNone;
+                source.page.elementSize         = (uint16_t)stream.stride;
+                source.page.elementCount        = std::min(perPage, stream.count - first);
+                source.page.destinationOffset   = stream.offset + (uint64_t)first * stream.stride;
+                source.data                     = buffers[l].data() + source.page.destinationOffset;
+                sources.push_back(std::move(source));
+            }
+        }
+    }
+    firstPages.push_back((uint32_t)sources.size());
+
+    // Compress the pages in parallel, keeping a page uncompressed unless that makes it smaller.
+    if (options.compress)
+    {
+#if AAPL_HAS_MESHOPTIMIZER
+        parallelFor(sources.size(), 0, [&](size_t i)
+        {
+            PageSource& source = sources[i];
+            const AAPLModelFile::Page& page = source.page;
+            const size_t size = (size_t)page.elementCount * page.elementSize;
+            if (page.kind == AAPLModelFile::PageVertices)
+            {
+                source.encoded.resize(meshopt_encodeVertexBufferBound(page.elementCount, page.elementSize));
+                source.encoded.resize(meshopt_encodeVertexBuffer(source.encoded.data(), source.encoded.size(),
+                                                                 source.data, page.elementCount, page.elementSize));
+            }
+            else if (page.elementCount % 3 == 0)
+            {
+                std::vector<uint32_t> indices(page.elementCount);
+                memcpy(indices.data(), source.data, size);
+
+                uint32_t vertexCount = 0;
+                for (uint32_t index : indices)
+                    vertexCount = std::max(vertexCount, index + 1);
+
+                source.encoded.resize(meshopt_encodeIndexBufferBound(page.elementCount, vertexCount));
+                source.encoded.resize(meshopt_encodeIndexBuffer(source.encoded.data(), source.encoded.size(),
+                                                                indices.data(), page.elementCount));
+            }
+
+            if (!source.encoded.empty() && source.encoded.size() < size)
+                source.page.codec = AAPLModelFile::CodecMeshopt;
+            else
+                source.encoded.clear();
+        });
+#endif
+    }
+
+    // Lay out the tables and then the pages.
+    const uint32_t lodCount         = (uint32_t)lods.size();
+    const uint32_t pageCount        = (uint32_t)sources.size();
+    const uint64_t pageTableOffset  = HeaderSize + lodCount * LODEntrySize;
+    const uint64_t dataOffset       = alignUp(pageTableOffset + pageCount * PageEntrySize, PageAlignment);
+
+    uint64_t offset = dataOffset;
+    for (PageSource& source : sources)
+    {
+        AAPLModelFile::Page& page = source.page;
+        const uint64_t size = page.codec == AAPLModelFile::CodecNone ? (uint64_t)page.elementCount * page.elementSize
+                                                                     : source.encoded.size();
+        if (size > UINT32_MAX)
+            return fail(error, "A page is too large");
+
+        page.fileOffset = offset;
+        page.fileSize   = (uint32_t)size;
+        offset = alignUp(offset + size, PageAlignment);
+    }
+
+    std::vector<uint8_t> table(dataOffset, 0);
+    memcpy(table.data(), Identifier, sizeof(Identifier));
+    writeU32(table.data() + 8,  Version);
+    writeU32(table.data() + 12, lodCount);
+    writeU32(table.data() + 16, pageCount);
+    writeU64(table.data() + 24, HeaderSize);
+    writeU64(table.data() + 32, pageTableOffset);
+    writeU64(table.data() + 40, dataOffset);
+
+    for (uint32_t l = 0; l < lodCount; ++l)
+    {
+        uint8_t* entry = table.data() + HeaderSize + l * LODEntrySize;
+        writeU32(entry,      lods[l].vertexCount);
+        writeU32(entry + 4,  lods[l].indexCount);
+        writeU32(entry + 8,  firstPages[l]);
+        writeU32(entry + 12, firstPages[l + 1] - firstPages[l]);
+        writeU64(entry + 16, lods[l].bufferSize);
+        writeU64(entry + 24, lods[l].positionsOffset);
+        writeU64(entry + 32, lods[l].normalsOffset);
+        writeU64(entry + 40, lods[l].texcoordsOffset);
+        writeU64(entry + 48, lods[l].indexOffset);
+    }
+
+    for (uint32_t p = 0; p < pageCount; ++p)
+    {
+        const AAPLModelFile::Page& page = sources[p].page;
+        uint8_t* entry = table.data() + pageTableOffset + p * PageEntrySize;
+        writeU64(entry,      page.fileOffset);
+        writeU32(entry + 8,  page.fileSize);
+        entry[12] = page.kind;
+        entry[13] = page.codec;
+        entry[14] = (uint8_t)page.elementSize;
+        entry[15] = (uint8_t)(page.elementSize >> 8);
+        writeU64(entry + 16, page.destinationOffset);
+        writeU32(entry + 24, page.elementCount);
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return fail(error, "Couldn't create the model file");
+
+    static const uint8_t padding[PageAlignment] = {};
+    bool written = writeFully(file, table.data(), table.size());
+    for (size_t p = 0; written && p < sources.size(); ++p)
+    {
+        const PageSource& source = sources[p];
+        const uint8_t* data = source.page.codec == AAPLModelFile::CodecNone ? source.data : source.encoded.data();
+        const size_t end = (size_t)(source.page.fileOffset + source.page.fileSize);
+        written = writeFully(file, data, source.page.fileSize) &&
+                  writeFully(file, padding, (size_t)(alignUp(end, PageAlignment) - end));
+    }
+
+    if (fclose(file) != 0 || !written)
+    {
+        remove(path);
+        return fail(error, "Couldn't write the model file");
+    }
+    return true;
+}
@@ -0,0 +1,156 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the model file, which holds every level of detail of a model in pages of
+ vertices and indices that load independently, and for the reader of the sample's `.dat` files.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#if __has_include(<meshoptimizer.h>)
+#define AAPL_HAS_MESHOPTIMIZER 1
+#else
+#define AAPL_HAS_MESHOPTIMIZER 0
+#endif
+
+// The header of a `.dat` file, which holds one level of detail of a model.  The file stores
+//  the Metal buffer the renderer draws from at `vertexFileOffset`.
+typedef struct AAPLModelBufferFileHeader
+{
+    char magic[8];
+    size_t bufferSizeInBytes;      // The size of the Metal buffer to allocate.
+    size_t vertexFileOffset;       // The location in the file where the vertex buffer starts.
+    size_t vertexSizeInBytes;      // The size of the Vertex section of the buffer.
+    size_t vertexCount;            // The number of vertices.
+    size_t vertexPositionsOffset;  // The offset into the Metal buffer where the positions start.
+    size_t vertexNormalsOffset;    // The offset into the Metal buffer where the normals start.
+    size_t vertexTexcoordOffset;   // The offset into the Metal buffer where the texture coordinates start.
+    size_t indexSizeInBytes;       // The size of the Index section of the buffer.
+    size_t indexFileOffset;        // The location in the file where the index buffer starts.
+    size_t indexCount;             // The number of triangle indices.
+    size_t indexOffset;            // The location into the Metal buffer where the indices start.
+} AAPLModelBufferFileHeader;
+
+// Strides of the streams of the renderer's buffers: `float3` positions and normals, `float2`
+//  texture coordinates, and 32-bit indices.
+static const uint32_t AAPLModelPositionStride   = 16;
+static const uint32_t AAPLModelNormalStride     = 16;
+static const uint32_t AAPLModelTexcoordStride   = 8;
+static const uint32_t AAPLModelIndexStride      = 4;
+
+// A level of detail as the renderer draws it: one buffer with each stream at an offset.
+struct AAPLModelLOD
+{
+    uint32_t    vertexCount;
+    uint32_t    indexCount;
+    uint64_t    bufferSize;
+    uint64_t    positionsOffset;
+    uint64_t    normalsOffset;
+    uint64_t    texcoordsOffset;
+    uint64_t    indexOffset;
+};
+
+// Reads the header of a `.dat` file and, if `buffer` isn't null, the buffer it holds.
+//  Checks that every stream lies within the buffer, and the buffer within the file.
+bool AAPLReadModelDat(const char* path, AAPLModelLOD& lod, std::vector<uint8_t>* buffer, std::string& error);
+
+// A model file holds a model converted offline from one `.dat` file for each level of detail:
+//
+//  - A 64-byte header with the counts and offsets of the tables.
+//  - For each level of detail, from the coarsest, its `AAPLModelLOD` and its range of pages.
+//  - For each page, where it is in the file, how it's compressed, and where it goes in the
+//     level's buffer.  A page holds a range of one stream, and indices in whole triangles.
+//  - The pages, in the order of the table, so that each level is contiguous in the file and
+//     the coarsest level comes first.
+//
+// The reader only keeps the tables in memory, so a renderer can load the coarsest level
+//  first and refine it later, and load a level's pages on several threads at once.
+class AAPLModelFile
+{
+public:
+    enum Codec : uint8_t
+    {
+        CodecNone       = 0,
+        CodecMeshopt    = 1,    // meshoptimizer's vertex or index buffer codec.
+    };
+
+    enum PageKind : uint8_t
+    {
+        PageVertices    = 0,
+        PageIndices     = 1,
+    };
+
+    struct Page
+    {
+        uint64_t    fileOffset;
+        uint32_t    fileSize;
+        PageKind    kind;
+        Codec       codec;
+        uint16_t    elementSize;
+        uint64_t    destinationOffset;  // In the level's buffer.
+        uint32_t    elementCount;
+    };
+
+    AAPLModelFile() = default;
+    ~AAPLModelFile();
+
+    AAPLModelFile(const AAPLModelFile&) = delete;
+    AAPLModelFile& operator=(const AAPLModelFile&) = delete;
+
+    // Opens the file at `path` and reads its tables.
+    bool open(const char* path, std::string& error);
+
+    void close();
+
+    bool                isOpen() const                  { return _fd >= 0; }
+    uint32_t            lodCount() const                { return (uint32_t)_lods.size(); }
+    const AAPLModelLOD& lod(uint32_t lod) const         { return _lods[lod].lod; }
+    uint32_t            firstPage(uint32_t lod) const   { return _lods[lod].firstPage; }
+    uint32_t            pageCount(uint32_t lod) const   { return _lods[lod].pageCount; }
+    const Page&         page(uint32_t page) const       { return _pages[page]; }
+
+    // Bytes the pages of a level take in the file.
+    uint64_t            fileSize(uint32_t lod) const;
+
+    // Reads a page and decodes it into its place in `buffer`, which holds the level's
+    //  `bufferSize` bytes.  Uncompressed pages read straight into the buffer; compressed ones
+    //  read into `scratch` first.  Several threads may load pages at once.
+    bool loadPage(uint32_t page, void* buffer, std::vector<uint8_t>& scratch, std::string& error) const;
+
+    // Loads every page of a level into `buffer` on `threadCount` threads, or one thread per
+    //  core if it's 0.
+    bool loadLOD(uint32_t lod, void* buffer, unsigned threadCount, std::string& error) const;
+
+private:
+    struct LODEntry
+    {
+        AAPLModelLOD    lod;
+        uint32_t        firstPage;
+        uint32_t        pageCount;
+    };
+
+    int                     _fd     = -1;
+    std::vector<LODEntry>   _lods;
+    std::vector<Page>       _pages;
+};
+
+struct AAPLModelFileOptions
+{
+    // Largest size of a page before compression.
+    uint32_t    pageSize    = 256 * 1024;
+
+    // Compresses the pages with meshoptimizer, which needs a build that has it.
+    bool        compress    = false;
+};
+
+// Writes the levels of detail of a model, from the coarsest, to a model file at `path`.
+//  Each buffer holds its level's `bufferSize` bytes.
+bool AAPLWriteModelFile(const char* path, const std::vector<AAPLModelLOD>& lods,
+                        const std::vector<std::vector<uint8_t>>& buffers,
+                        const AAPLModelFileOptions& options, std::string& error);
@@ -7,18 +7,26 @@ The implementation of the renderer class that performs Metal setup and per-frame
 
 #include <thread>
 #include <atomic>
+#include <memory>
 
 #import <Metal/Metal.h>
 
 #import "AAPLConfig.h"
 #import "Shaders/AAPLShaderTypes.h"
-#import "AAPLKTXTextureResource.hpp"
+#import "AAPLKTXFile.h"
 #import "AAPLMathUtilities.h"
+#import "AAPLMetalCopyEngine.h"
+#import "AAPLModelFile.h"
 #import "AAPLRenderer.h"
 
 static const NSUInteger AAPLMaxFramesInFlight = 3;
 static const NSUInteger AAPLNumObjects = 3;
 
+/// The staging ring's buffers, which the traditional loaders read the texture levels into.
+static const uint32_t AAPLStagingBufferCount = 3;
+static const size_t   AAPLStagingBufferSize  = 16 * 1024 * 1024;
+static const uint32_t AAPLStagingReaderCount = 4;
+
 enum ResourceDetailIndex {
     SmallIndex,
     LargeIndex,
@@ -32,22 +40,6 @@ enum LoadStatus
     LoadStatusLargeResourceLoaded,
 };
 
-typedef struct AAPLModelBufferFileHeader
-{
-    char magic[8];
-    size_t bufferSizeInBytes;      // The size of the Metal buffer to allocate.
-    size_t vertexFileOffset;       // The location in the file where the vertex buffer starts.
-    size_t vertexSizeInBytes;      // The size of the Vertex section of the buffer.
-    size_t vertexCount;            // The number of vertices.
-    size_t vertexPositionsOffset;  // The offset into the Metal buffer where the positions start.
-    size_t vertexNormalsOffset;    // The offset into the Metal buffer where the normals start.
-    size_t vertexTexcoordOffset;   // The offset into the Metal buffer where the texture coordinates start.
-    size_t indexSizeInBytes;       // The size of the Index section of the buffer.
-    size_t indexFileOffset;        // The location in the file where the index buffer starts.
-    size_t indexCount;             // The number of triangle indices.
-    size_t indexOffset;            // The location into the Metal buffer where the indices start.
-} AAPLModelBufferFileHeader;
-
 template <typename T>
 struct AAPLResourceCommon
 {
@@ -108,8 +100,8 @@ struct AAPLResourceCommon
 /// This data structure stores the parameters for a low- and high-resolution texture.
 struct AAPLTextureParams : public AAPLResourceCommon<id<MTLTexture>>
 {
-    /// Store the file headers for the high-resolution resources for streaming purposes.
-    AAPLKTXTextureResource ktx[NumDetailLevels];
+    /// Store the mapped files for the high-resolution resources for streaming purposes.
+    AAPLKTXFile ktx[NumDetailLevels];
 };
 
 /// This data structure stores the parameters for a low- and high-resolution mesh.
@@ -117,6 +109,10 @@ struct AAPLModelParams : public AAPLResourceCommon<id<MTLBuffer>>
 {
     /// Store the file headers for the high-resolution resources for streaming purposes.
     AAPLModelBufferFileHeader headers[NumDetailLevels];
+    /// Store the model file with every level of detail, which replaces the `.dat` files when the bundle has one.
+    AAPLModelFile modelFile;
+    /// Store the level of the model file for each detail level: the coarsest and the finest.
+    uint32_t modelFileLOD[NumDetailLevels];
 
     /// Store the vertex counts.
     size_t vertexCount[NumDetailLevels];
@@ -218,6 +214,15 @@ NSString* loadStatusToString(enum LoadStatus status)
     /// This data structure holds all the headers and file sizes and offsets for the three textures.
     AAPLTextureParams _textures[AAPLNumObjects];
     
+    /// The traditional loaders read textures into the staging ring, which the copy engine blits to them.
+    /// Declare the engine first so that it outlives the ring.
+    std::unique_ptr<AAPLMetalCopyEngine> _copyEngine;
+    std::unique_ptr<AAPLStagingRing>     _stagingRing;
+    /// These textures generate their mipmaps once their uploads finish.
+    NSMutableArray<id<MTLTexture>>*      _texturesToMipmap;
+    /// The throughput and largest queue depth of the last uploads, for the user interface.
+    AAPLStagingRingStats                 _stagingStats;
+    
 #if AAPL_USE_MTLIO
     /// These Metal resources are for use with MTLIO.
     id<MTLIOCommandQueue> _ioQueue;
@@ -265,6 +270,19 @@ NSString* loadStatusToString(enum LoadStatus status)
     _mtkView.depthStencilPixelFormat = MTLPixelFormatDepth32Float;
     _commandQueue = [_mtlDevice newCommandQueue];
     
+    // Create the staging ring for the traditional loaders.
+    {
+        AAPLStagingRingDesc desc;
+        desc.bufferCount = AAPLStagingBufferCount;
+        desc.bufferSize = AAPLStagingBufferSize;
+        desc.readerThreadCount = AAPLStagingReaderCount;
+        
+        _copyEngine = std::make_unique<AAPLMetalCopyEngine>(_mtlDevice, _commandQueue);
+        _stagingRing = std::make_unique<AAPLStagingRing>(*_copyEngine, desc);
+        _texturesToMipmap = [NSMutableArray new];
+        _stagingStats = {};
+    }
+    
     id<MTLLibrary> defaultLibrary = [_mtlDevice newDefaultLibrary];
     
     // Create the render pipeline to shade the geometry.
@@ -327,6 +345,9 @@ NSString* loadStatusToString(enum LoadStatus status)
         [self loadModelData:i resolutionIndex:SmallIndex];
         [self loadTextureData:i resolutionIndex:SmallIndex];
     }
+    
+    // Wait for the low-resolution textures.
+    [self finishTextureUploads];
 }
 
 #pragma mark - Model and texture loading methods.
@@ -338,10 +359,41 @@ NSString* loadStatusToString(enum LoadStatus status)
         {@"Assets/obj1-crazy-torus-lores.dat", @"Assets/obj2-menger-sponge-lores.dat", @"Assets/obj3-step-cylinder-lores.dat"},
         {@"Assets/obj1-crazy-torus-hires.dat", @"Assets/obj2-menger-sponge-hires.dat", @"Assets/obj3-step-cylinder-hires.dat"}
     };
+    NSString* modelFilePaths[AAPLNumObjects] = {
+        @"Assets/obj1-crazy-torus.model", @"Assets/obj2-menger-sponge.model", @"Assets/obj3-step-cylinder.model"
+    };
+
+    assert(index == SmallIndex || index == LargeIndex);
+    _models[i].resources[index] = nil;
+
+    // Prefer a model file, which the model tool converts from the `.dat` files, and draw its
+    // coarsest and finest levels.
+    NSURL* modelFileURL = [[NSBundle mainBundle] URLForResource:modelFilePaths[i] withExtension:nil];
+    if (modelFileURL)
+    {
+        std::string error;
+        if (!_models[i].modelFile.isOpen() && !_models[i].modelFile.open(modelFileURL.fileSystemRepresentation, error))
+        {
+            NSString* reason = [NSString stringWithFormat:@"Error loading resource (%@) : %s", modelFilePaths[i], error.c_str()];
+            NSException* exc = [NSException exceptionWithName:@"Model loading exception" reason:reason userInfo:nil];
+            @throw exc;
+        }
+
+        const uint32_t lod = index == SmallIndex ? 0 : _models[i].modelFile.lodCount() - 1;
+        const AAPLModelLOD& modelLOD = _models[i].modelFile.lod(lod);
+        _models[i].urls[index] = modelFileURL;
+        _models[i].modelFileLOD[index] = lod;
+        _models[i].vertexCount[index] = modelLOD.vertexCount;
+        _models[i].indexCount[index] = modelLOD.indexCount;
+        _models[i].positionsOffset[index] = modelLOD.positionsOffset;
+        _models[i].normalsOffset[index] = modelLOD.normalsOffset;
+        _models[i].texcoordsOffset[index] = modelLOD.texcoordsOffset;
+        _models[i].indexOffset[index] = modelLOD.indexOffset;
+        return;
+    }
 
     NSURL* url = [[NSBundle mainBundle] URLForResource:resources[index][i] withExtension:nil];
     assert(url);
-    assert(index == SmallIndex || index == LargeIndex);
     _models[i].urls[index] = url;
 
     FILE* fin = fopen(url.path.UTF8String, "rb");
@@ -354,7 +406,6 @@ NSString* loadStatusToString(enum LoadStatus status)
     _models[i].normalsOffset[index] = _models[i].headers[index].vertexNormalsOffset;
     _models[i].texcoordsOffset[index] = _models[i].headers[index].vertexTexcoordOffset;
     _models[i].indexOffset[index] = _models[i].headers[index].vertexSizeInBytes;
-    _models[i].resources[index] = nil;
 }
 
 /// Load a texture using MTKTextureLoader.
@@ -368,7 +419,27 @@ NSString* loadStatusToString(enum LoadStatus status)
     
     _textures[i].resources[index] = nil;
     _textures[i].urls[index] = [[NSBundle mainBundle] URLForResource:ktxPath withExtension:nil];
-    _textures[i].ktx[index].readHeaderFromPath(_textures[i].urls[index].path.UTF8String);
+    
+    std::string error;
+    if (!_textures[i].ktx[index].open(_textures[i].urls[index].fileSystemRepresentation, error))
+    {
+        NSString* reason = [NSString stringWithFormat:@"Error loading resource (%@) : %s", ktxPath, error.c_str()];
+        NSException* exc = [NSException exceptionWithName:@"Texture loading exception" reason:reason userInfo:nil];
+        @throw exc;
+    }
+}
+
+/// Return the Metal pixel format of a KTX texture.
+static MTLPixelFormat pixelFormatForKTX(const AAPLKTXFile& ktx)
+{
+    MTLPixelFormat pixelFormat = AAPLKTXMetalPixelFormat(ktx.format());
+    
+    // The sample's ASTC textures hold sRGB colors, although their files declare the linear format.
+    if (pixelFormat == MTLPixelFormatASTC_4x4_LDR)
+        pixelFormat = MTLPixelFormatASTC_4x4_sRGB;
+    
+    assert(pixelFormat != MTLPixelFormatInvalid);
+    return pixelFormat;
 }
 
 #pragma mark - Traditional `fread` loading methods.
@@ -377,6 +448,12 @@ NSString* loadStatusToString(enum LoadStatus status)
 - (void)loadModelData:(size_t)i resolutionIndex:(size_t)index
 {
     NSURL* sourceURL = _models[i].urls[index];
+    if (_models[i].modelFile.isOpen())
+    {
+        [self loadModelFileData:i resolutionIndex:index];
+        return;
+    }
+
     FILE* fin = fopen(sourceURL.path.UTF8String, "rb");
     const size_t sourceOffset = _models[i].headers[index].vertexFileOffset;
     const size_t sizeInBytes = _models[i].headers[index].bufferSizeInBytes;
@@ -391,72 +468,157 @@ NSString* loadStatusToString(enum LoadStatus status)
     _models[i].resources[index] = buffer;
 }
 
-/// Load a texture using fread.
+/// Load a level of a model file, decoding its pages on worker threads straight into the buffer.
+- (void)loadModelFileData:(size_t)i resolutionIndex:(size_t)index
+{
+    const AAPLModelFile& modelFile = _models[i].modelFile;
+    const uint32_t lod = _models[i].modelFileLOD[index];
+    
+    id<MTLBuffer> buffer = [_mtlDevice newBufferWithLength:modelFile.lod(lod).bufferSize options:MTLResourceStorageModeShared];
+    buffer.label = [NSString stringWithFormat:@"%@ LOD %u", _models[i].urls[index].lastPathComponent, lod];
+    
+    std::string error;
+    if (!modelFile.loadLOD(lod, buffer.contents, 0, error))
+    {
+        NSString* reason = [NSString stringWithFormat:@"Error loading resource (%@) : %s", buffer.label, error.c_str()];
+        NSException* exc = [NSException exceptionWithName:@"Model loading exception" reason:reason userInfo:nil];
+        @throw exc;
+    }
+    
+    // After loading the resource, make it available to use.
+    _models[i].resources[index] = buffer;
+}
+
+/// Load a texture by reading its mipmap levels into the staging ring, which blits them to the texture.
 - (void)loadTextureData:(size_t)i resolutionIndex:(size_t)index
 {
-    AAPLKTXTextureResource& ktx = _textures[i].ktx[index];
+    const AAPLKTXFile& ktx = _textures[i].ktx[index];
     
     // Assert a few requirements on the file format.
-    assert(ktx.header.pixelDepth == 0);
-    assert(ktx.header.numberOfArrayElements == 0);
-    assert(ktx.header.numberOfFaces == 1);
+    assert(ktx.depth() == 1);
+    assert(!ktx.isArray());
+    assert(ktx.faceCount() == 1);
     
-    // Open the file to read and copy into MTLBuffer and MTLTexture.
     NSURL* sourceURL = _textures[i].urls[index];
-    FILE* fin = fopen(sourceURL.path.UTF8String, "rb");
-    assert(fin);
     
     // Allocate the texture for the KTX texture.
     MTLTextureDescriptor* desc = [MTLTextureDescriptor new];
-    desc.width = ktx.header.pixelWidth;
-    desc.height = ktx.header.pixelHeight;
-    desc.mipmapLevelCount = ktx.mipmapCount;
-    desc.pixelFormat = ktx.pixelFormat;
+    desc.width = ktx.width();
+    desc.height = ktx.height();
+    desc.mipmapLevelCount = ktx.levelCount();
+    desc.pixelFormat = pixelFormatForKTX(ktx);
     
     id<MTLTexture> texture = [_mtlDevice newTextureWithDescriptor:desc];
     texture.label = sourceURL.lastPathComponent;
     
-    // Open the command buffer to blit the file contents.
-    auto commandBuffer = [_commandQueue commandBuffer];
-    id<MTLBlitCommandEncoder> blitEncoder = [commandBuffer blitCommandEncoder];
-    
-    // Copy each mipmap level into a buffer and use the blit encoder to copy it to the texture.
-    for (size_t level = 0; level < ktx.mipmapCount; level++)
+    // Upload each mipmap level through the staging ring.  The reader threads copy the rows of
+    // the level from the mapped file, or decode the whole level if the file is supercompressed.
+    const bool supercompressed = ktx.supercompression() != AAPLKTXFile::SupercompressionNone;
+    const AAPLKTXFile* file = &ktx;
+    for (uint32_t level = 0; level < ktx.levelCount(); level++)
     {
-        // Create a temporary buffer and get a pointer to its contents.
-        id<MTLBuffer> buffer = [_mtlDevice newBufferWithLength:ktx.mipmapBytesPerImage[level] options:MTLResourceStorageModeShared];
-        char* bufferPtr = (char*)buffer.contents;
+        const AAPLKTXFile::Level& levelInfo = ktx.level(level);
         
-        // Advance the file position and read the mipmap data into the buffer.
-        fseek(fin, ktx.mipmapFileOffsets[level], SEEK_SET);
-        fread(bufferPtr, ktx.mipmapBytesPerImage[level], 1, fin);
+        AAPLStagingUpload upload;
+        upload.size = supercompressed ? levelInfo.uncompressedLength : levelInfo.bytesPerImage;
+        upload.splitSize = supercompressed ? 0 : levelInfo.bytesPerRow;
         
-        [blitEncoder copyFromBuffer:buffer
-                       sourceOffset:0
-                  sourceBytesPerRow:ktx.mipmapBytesPerRow[level]
-                sourceBytesPerImage:ktx.mipmapBytesPerImage[level]
-                         sourceSize:ktx.mipmapSizes[level]
-                          toTexture:texture
-                   destinationSlice:0
-                   destinationLevel:level
-                  destinationOrigin:MTLOriginMake(0, 0, 0)];
-    }
-    
-    // After the reading the data, close the file.
-    fclose(fin);
+        if (!_stagingRing->canUpload(upload.size, upload.splitSize))
+        {
+            [self loadTextureLevel:level fromKTX:ktx toTexture:texture];
+            continue;
+        }
+        
+        upload.destination = _copyEngine->addTextureLevel(texture, level, levelInfo.bytesPerRow, ktx.format().blockHeight);
+        if (supercompressed)
+        {
+            upload.read = [file, level](void* destination, size_t, size_t size)
+            {
+                std::string error;
+                return AAPLKTXDecodeLevel(*file, level, destination, size, error);
+            };
+        }
+        else
+        {
+            const uint8_t* levelData = ktx.image(level, 0, 0).data;
+            upload.read = [levelData](void* destination, size_t offset, size_t size)
+            {
+                memcpy(destination, levelData + offset, size);
+                return true;
+            };
+        }
+        
+        const bool uploading = _stagingRing->upload(upload);
+        assert(uploading);
+    }
     
-    // If mipmaps aren't in the file, generate them.
-    if (!ktx.compressed && ktx.header.numberOfMipmapLevels == 1) {
-        [blitEncoder generateMipmapsForTexture:texture];
+    // If mipmaps aren't in the file, generate them after the upload.
+    const bool compressed = ktx.format().blockWidth > 1;
+    if (!compressed && ktx.levelCount() == 1) {
+        [_texturesToMipmap addObject:texture];
     }
     
-    // Submit GPU work.
+    // The texture is ready to use once `finishTextureUploads` returns.
+    _textures[i].resources[index] = texture;
+}
+
+/// Load a mipmap level that's too big for a staging buffer into a temporary buffer.
+- (void)loadTextureLevel:(uint32_t)level fromKTX:(const AAPLKTXFile&)ktx toTexture:(id<MTLTexture>)texture
+{
+    const AAPLKTXFile::Level& levelInfo = ktx.level(level);
+    id<MTLBuffer> buffer = [_mtlDevice newBufferWithLength:levelInfo.uncompressedLength options:MTLResourceStorageModeShared];
+    
+    std::string error;
+    if (!AAPLKTXDecodeLevel(ktx, level, buffer.contents, buffer.length, error))
+    {
+        NSString* reason = [NSString stringWithFormat:@"Error loading resource (%@) : %s", texture.label, error.c_str()];
+        NSException* exc = [NSException exceptionWithName:@"Texture loading exception" reason:reason userInfo:nil];
+        @throw exc;
+    }
+    
+    auto commandBuffer = [_commandQueue commandBuffer];
+    id<MTLBlitCommandEncoder> blitEncoder = [commandBuffer blitCommandEncoder];
+    [blitEncoder copyFromBuffer:buffer
+                   sourceOffset:0
+              sourceBytesPerRow:levelInfo.bytesPerRow
+            sourceBytesPerImage:levelInfo.bytesPerImage
+                     sourceSize:MTLSizeMake(levelInfo.width, levelInfo.height, 1)
+                      toTexture:texture
+               destinationSlice:0
+               destinationLevel:level
+              destinationOrigin:MTLOriginMake(0, 0, 0)];
     [blitEncoder endEncoding];
     [commandBuffer commit];
-    [commandBuffer waitUntilCompleted];
+}
+
+/// Wait for the uploads of every texture that `loadTextureData` started, and generate the mipmaps that the files don't have.
+- (void)finishTextureUploads
+{
+    const bool succeeded = _stagingRing->finish();
+    _copyEngine->removeDestinations();
+    _stagingStats = _stagingRing->stats();
     
-    // After loading and blitting the texture, make it available to use.
-    _textures[i].resources[index] = texture;
+    // A reader fails if a supercompressed level doesn't decode.
+    if (!succeeded)
+    {
+        NSException* exc = [NSException exceptionWithName:@"Texture loading exception"
+                                                   reason:@"Error loading resource : a texture level failed to decode"
+                                                 userInfo:nil];
+        @throw exc;
+    }
+    
+    // The command queue runs the mipmap generation after the copies, and after any temporary buffer copies.
+    auto commandBuffer = [_commandQueue commandBuffer];
+    if (_texturesToMipmap.count > 0)
+    {
+        id<MTLBlitCommandEncoder> blitEncoder = [commandBuffer blitCommandEncoder];
+        for (id<MTLTexture> texture in _texturesToMipmap)
+            [blitEncoder generateMipmapsForTexture:texture];
+        [blitEncoder endEncoding];
+        [_texturesToMipmap removeAllObjects];
+    }
+    [commandBuffer commit];
+    [commandBuffer waitUntilCompleted];
 }
 
 /// Process any requests to load high-resolution resources the "traditional" way.
@@ -473,6 +635,9 @@ NSString* loadStatusToString(enum LoadStatus status)
         }
     }
     
+    // Wait for the textures, whose levels upload together.
+    [self finishTextureUploads];
+    
     // Mark the high-resolution resources available for rendering.
     [self resourcesDidFinishLoading];
 }
@@ -503,6 +668,41 @@ NSString* loadStatusToString(enum LoadStatus status)
         _models[i].handles[index] = handle;
     }
     
+    // Load each uncompressed page of a model file with its own command, and decode compressed
+    // pages on the CPU, since MTLIO doesn't know their codec.
+    if (_models[i].modelFile.isOpen())
+    {
+        const AAPLModelFile& modelFile = _models[i].modelFile;
+        const uint32_t lod = _models[i].modelFileLOD[index];
+        id<MTLBuffer> buffer = [_mtlDevice newBufferWithLength:modelFile.lod(lod).bufferSize options:MTLResourceStorageModeShared];
+        buffer.label = [NSString stringWithFormat:@"%@ LOD %u", sourceURL.lastPathComponent, lod];
+        
+        std::string error;
+        std::vector<uint8_t> scratch;
+        for (uint32_t p = modelFile.firstPage(lod); p < modelFile.firstPage(lod) + modelFile.pageCount(lod); ++p)
+        {
+            const AAPLModelFile::Page& page = modelFile.page(p);
+            if (page.codec == AAPLModelFile::CodecNone)
+            {
+                [commandBuffer loadBuffer:buffer
+                                   offset:page.destinationOffset
+                                     size:page.fileSize
+                             sourceHandle:_models[i].handles[index]
+                       sourceHandleOffset:page.fileOffset];
+            }
+            else if (!modelFile.loadPage(p, buffer.contents, scratch, error))
+            {
+                NSString* reason = [NSString stringWithFormat:@"Error loading resource (%@) : %s", buffer.label, error.c_str()];
+                NSException* exc = [NSException exceptionWithName:@"Model loading exception" reason:reason userInfo:nil];
+                @throw exc;
+            }
+        }
+        
+        // After loading the resource, make it available to use.
+        _models[i].resources[index] = buffer;
+        return;
+    }
+    
     // Allocate a new buffer and add it to the command queue.
     id<MTLBuffer> buffer = [_mtlDevice newBufferWithLength:sizeInBytes options:MTLResourceStorageModeShared];
     buffer.label = sourceURL.lastPathComponent;
@@ -519,7 +719,10 @@ NSString* loadStatusToString(enum LoadStatus status)
 /// Encode the command to load the texture resource and its mipmaps with MTLIO.
 - (void)loadTextureDataWithMTLIO:(id<MTLIOCommandBuffer>)commandBuffer index:(size_t)i resolutionIndex:(size_t)index
 {
-    auto& ktx = _textures[i].ktx[index];
+    const AAPLKTXFile& ktx = _textures[i].ktx[index];
+    
+    // MTLIO reads the images straight from the file.
+    assert(ktx.supercompression() == AAPLKTXFile::SupercompressionNone);
     
     // Get the size and offset for this resource.
     NSURL* sourceURL = _textures[i].urls[index];
@@ -540,26 +743,27 @@ NSString* loadStatusToString(enum LoadStatus status)
     
     // Allocate a new buffer and add it to the command queue.
     MTLTextureDescriptor* desc = [MTLTextureDescriptor new];
-    desc.width = ktx.header.pixelWidth;
-    desc.height = ktx.header.pixelHeight;
-    desc.pixelFormat = ktx.pixelFormat;
-    desc.mipmapLevelCount = ktx.mipmapCount;
+    desc.width = ktx.width();
+    desc.height = ktx.height();
+    desc.pixelFormat = pixelFormatForKTX(ktx);
+    desc.mipmapLevelCount = ktx.levelCount();
     desc.storageMode = MTLStorageModePrivate;
     
     // Encode the command to load the texture mipmap level.
     id<MTLTexture> texture = [_mtlDevice newTextureWithDescriptor:desc];
     texture.label = sourceURL.lastPathComponent;
-    for (int level = 0; level < ktx.mipmapCount; level++)
+    for (uint32_t level = 0; level < ktx.levelCount(); level++)
     {
+        const AAPLKTXFile::Level& levelInfo = ktx.level(level);
         [commandBuffer loadTexture:texture
                              slice:0
                              level:level
-                              size:ktx.mipmapSizes[level]
-                 sourceBytesPerRow:ktx.mipmapBytesPerRow[level]
-               sourceBytesPerImage:ktx.mipmapSizesInBytes[level]
+                              size:MTLSizeMake(levelInfo.width, levelInfo.height, 1)
+                 sourceBytesPerRow:levelInfo.bytesPerRow
+               sourceBytesPerImage:levelInfo.bytesPerImage
                  destinationOrigin:MTLOriginMake(0, 0, 0)
                       sourceHandle:_textures[i].handles[index]
-                sourceHandleOffset:ktx.mipmapFileOffsets[level]];
+                sourceHandleOffset:levelInfo.offset];
     }
     
     // After loading the texture, make it available to use.
@@ -779,11 +983,11 @@ NSString* loadStatusToString(enum LoadStatus status)
     allocatedSizeInMiB /= 1048576.0;
     
     // Update the info string for the user interface.
-    _infoString = [[NSString alloc] initWithFormat:@"Object 1: %@|%@  Object 2: %@|%@  Object3: %@|%@  Memory: %3.2f MiB",
+    _infoString = [[NSString alloc] initWithFormat:@"Object 1: %@|%@  Object 2: %@|%@  Object3: %@|%@  Memory: %3.2f MiB  Staging: %.0f MiB/s, depth %u",
                    loadStatusToString(_models[0].loadStatus), loadStatusToString(_textures[0].loadStatus),
                    loadStatusToString(_models[1].loadStatus), loadStatusToString(_textures[1].loadStatus),
                    loadStatusToString(_models[2].loadStatus), loadStatusToString(_textures[2].loadStatus),
-                   allocatedSizeInMiB
+                   allocatedSizeInMiB, _stagingStats.bytesPerSecond() / 1048576.0, _stagingStats.maxQueueDepth
     ];
 }
 
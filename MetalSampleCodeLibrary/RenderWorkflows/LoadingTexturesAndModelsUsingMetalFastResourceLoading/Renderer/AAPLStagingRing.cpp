@@ -0,0 +1,344 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the staging ring and the memcpy copy engine.
+*/
+#include "AAPLStagingRing.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+// MARK: - Memcpy copy engine
+
+AAPLMemcpyCopyEngine::AAPLMemcpyCopyEngine(uint32_t latencyMicroseconds)
+    : _latencyMicroseconds(latencyMicroseconds)
+{
+    _thread = std::thread(&AAPLMemcpyCopyEngine::run, this);
+}
+
+AAPLMemcpyCopyEngine::~AAPLMemcpyCopyEngine()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _condition.notify_all();
+    _thread.join();
+}
+
+void* AAPLMemcpyCopyEngine::createStagingBuffer(uint32_t index, size_t size)
+{
+    if (_buffers.size() <= index)
+        _buffers.resize(index + 1);
+    _buffers[index].resize(size);
+    return _buffers[index].data();
+}
+
+void AAPLMemcpyCopyEngine::copy(const AAPLStagingCopy& copy)
+{
+    _recorded.push_back(copy);
+}
+
+uint64_t AAPLMemcpyCopyEngine::submit()
+{
+    Batch batch;
+    batch.copies.swap(_recorded);
+    batch.fence = ++_nextFence;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _batches.push_back(std::move(batch));
+    }
+    _condition.notify_all();
+    return _nextFence;
+}
+
+uint64_t AAPLMemcpyCopyEngine::completedFence()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _completedFence;
+}
+
+void AAPLMemcpyCopyEngine::waitForFence(uint64_t fence)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [&]() { return _completedFence >= fence; });
+}
+
+void AAPLMemcpyCopyEngine::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;)
+    {
+        _condition.wait(lock, [&]() { return _stopping || !_batches.empty(); });
+        if (_batches.empty())
+            return;
+
+        Batch batch = std::move(_batches.front());
+        _batches.pop_front();
+        lock.unlock();
+
+        if (_latencyMicroseconds)
+            std::this_thread::sleep_for(std::chrono::microseconds(_latencyMicroseconds));
+
+        for (const AAPLStagingCopy& copy : batch.copies)
+        {
+            uint8_t* destination = reinterpret_cast<uint8_t*>(static_cast<uintptr_t>(copy.destination));
+            memcpy(destination + copy.destinationOffset, _buffers[copy.buffer].data() + copy.bufferOffset, copy.size);
+        }
+
+        lock.lock();
+        _completedFence = batch.fence;
+        _condition.notify_all();
+    }
+}
+
+// MARK: - Staging ring
+
+AAPLStagingRing::AAPLStagingRing(AAPLCopyEngine& engine, const AAPLStagingRingDesc& desc)
+    : _engine(engine)
+    , _desc(desc)
+{
+    _desc.bufferCount = std::max(_desc.bufferCount, 1u);
+    _desc.alignment   = std::max(_desc.alignment, (size_t)1);
+
+    _buffers.resize(_desc.bufferCount);
+    for (uint32_t i = 0; i < _desc.bufferCount; ++i)
+        _buffers[i].data = static_cast<uint8_t*>(_engine.createStagingBuffer(i, _desc.bufferSize));
+
+    for (uint32_t i = 0; i < _desc.readerThreadCount; ++i)
+        _readers.emplace_back(&AAPLStagingRing::readerLoop, this);
+}
+
+AAPLStagingRing::~AAPLStagingRing()
+{
+    finish();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _readAvailable.notify_all();
+    for (std::thread& reader : _readers)
+        reader.join();
+}
+
+bool AAPLStagingRing::canUpload(size_t size, size_t splitSize) const
+{
+    return (splitSize ? splitSize : size) <= _desc.bufferSize;
+}
+
+// Largest piece of an upload that fits in an empty buffer.
+size_t AAPLStagingRing::maxPieceSize(size_t size, size_t splitSize) const
+{
+    if (splitSize == 0)
+        return size;
+    return _desc.bufferSize / splitSize * splitSize;
+}
+
+bool AAPLStagingRing::upload(const AAPLStagingUpload& upload)
+{
+    if (!canUpload(upload.size, upload.splitSize) || !upload.read)
+        return false;
+
+    _stats.uploadCount++;
+
+    auto shared = std::make_shared<const AAPLStagingUpload>(upload);
+    const size_t maxSize = maxPieceSize(upload.size, upload.splitSize);
+    for (size_t offset = 0; offset < upload.size;)
+    {
+        // Take the largest piece that fits in the rest of the current buffer, or else move
+        //  to the next buffer.
+        Buffer& buffer = _buffers[_current];
+        const size_t start = (buffer.used + _desc.alignment - 1) / _desc.alignment * _desc.alignment;
+        const size_t room  = start < _desc.bufferSize ? _desc.bufferSize - start : 0;
+
+        size_t size = std::min(upload.size - offset, maxSize);
+        if (size > room && upload.splitSize && room >= upload.splitSize)
+            size = room / upload.splitSize * upload.splitSize;
+
+        if (size > room)
+        {
+            submitBuffer(_current);
+            _current = (_current + 1) % _desc.bufferCount;
+
+            Buffer& next = _buffers[_current];
+            if (next.fence > _engine.completedFence())
+            {
+                _stats.fenceWaits++;
+                _engine.waitForFence(next.fence);
+            }
+            retire();
+            next.used = 0;
+            continue;
+        }
+
+        place(shared, offset, size);
+        buffer.used = start + size;
+        offset += size;
+    }
+    return true;
+}
+
+// Queues the read of a piece at the end of the current buffer.
+void AAPLStagingRing::place(const std::shared_ptr<const AAPLStagingUpload>& upload, size_t offset, size_t size)
+{
+    Buffer& buffer = _buffers[_current];
+
+    Read read;
+    read.upload                 = upload;
+    read.copy.destination       = upload->destination;
+    read.copy.destinationOffset = offset;
+    read.copy.buffer            = _current;
+    read.copy.bufferOffset      = (buffer.used + _desc.alignment - 1) / _desc.alignment * _desc.alignment;
+    read.copy.size              = size;
+
+    if (_queueDepth++ == 0)
+        _activeSince = std::chrono::steady_clock::now();
+    _stats.maxQueueDepth = std::max(_stats.maxQueueDepth, _queueDepth);
+
+    buffer.pieceCount++;
+
+    if (_readers.empty())
+    {
+        buffer.pendingReads++;
+        this->read(read);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        buffer.pendingReads++;
+        _reads.push_back(std::move(read));
+    }
+    _readAvailable.notify_one();
+}
+
+void AAPLStagingRing::read(const Read& read)
+{
+    const bool succeeded = read.upload->read(_buffers[read.copy.buffer].data + read.copy.bufferOffset,
+                                             read.copy.destinationOffset, read.copy.size);
+
+    std::unique_lock<std::mutex> lock(_mutex, std::defer_lock);
+    if (!_readers.empty())
+        lock.lock();
+
+    Buffer& buffer = _buffers[read.copy.buffer];
+    if (succeeded)
+    {
+        buffer.copies.push_back(read.copy);
+        _stats.bytesRead += read.copy.size;
+    }
+    else
+    {
+        _stats.failedReads++;
+        _failedSinceFinish++;
+    }
+
+    if (--buffer.pendingReads == 0)
+        _readDone.notify_all();
+}
+
+void AAPLStagingRing::readerLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;)
+    {
+        _readAvailable.wait(lock, [&]() { return _stopping || !_reads.empty(); });
+        if (_reads.empty())
+            return;
+
+        Read next = std::move(_reads.front());
+        _reads.pop_front();
+
+        lock.unlock();
+        read(next);
+        lock.lock();
+    }
+}
+
+// Waits for the reads of a buffer's pieces, then records and submits their copies.
+void AAPLStagingRing::submitBuffer(uint32_t index)
+{
+    Buffer& buffer = _buffers[index];
+    if (buffer.pieceCount == 0)
+        return;
+
+    std::vector<AAPLStagingCopy> copies;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _readDone.wait(lock, [&]() { return buffer.pendingReads == 0; });
+        copies.swap(buffer.copies);
+    }
+
+    // Copy in the order of the staging buffer, whatever order the reads finished in.
+    std::sort(copies.begin(), copies.end(), [](const AAPLStagingCopy& a, const AAPLStagingCopy& b)
+    {
+        return a.bufferOffset < b.bufferOffset;
+    });
+    size_t bytes = 0;
+    for (const AAPLStagingCopy& copy : copies)
+    {
+        _engine.copy(copy);
+        bytes += copy.size;
+    }
+
+    _lastFence   = _engine.submit();
+    buffer.fence = _lastFence;
+    _inFlight.push_back({ _lastFence, bytes, buffer.pieceCount });
+    buffer.pieceCount = 0;
+}
+
+// Forgets the pieces whose copies have finished.
+void AAPLStagingRing::retire()
+{
+    if (_inFlight.empty())
+        return;
+
+    const uint64_t completed = _engine.completedFence();
+    while (!_inFlight.empty() && _inFlight.front().fence <= completed)
+    {
+        _stats.bytesCompleted += _inFlight.front().bytes;
+        _queueDepth -= _inFlight.front().pieceCount;
+        _inFlight.pop_front();
+
+        if (_queueDepth == 0)
+            _stats.activeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - _activeSince).count();
+    }
+}
+
+uint64_t AAPLStagingRing::flush()
+{
+    submitBuffer(_current);
+    retire();
+    return _lastFence;
+}
+
+bool AAPLStagingRing::finish()
+{
+    _engine.waitForFence(flush());
+    retire();
+
+    // Everything has been copied, so the next upload can start from the first buffer.
+    for (Buffer& buffer : _buffers)
+        buffer.used = 0;
+    _current = 0;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    const bool succeeded = _failedSinceFinish == 0;
+    _failedSinceFinish = 0;
+    return succeeded;
+}
+
+AAPLStagingRingStats AAPLStagingRing::stats()
+{
+    retire();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    AAPLStagingRingStats stats = _stats;
+    stats.queueDepth = _queueDepth;
+    if (_queueDepth)
+        stats.activeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - _activeSince).count();
+    return stats;
+}
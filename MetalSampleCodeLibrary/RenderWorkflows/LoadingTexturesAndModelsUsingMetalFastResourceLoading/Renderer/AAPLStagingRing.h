@@ -0,0 +1,211 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the staging ring, which uploads data through a fixed pool of staging buffers,
+ reading it on a pool of threads while a copy engine copies earlier data to its destination.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A copy from a staging buffer to part of an upload's destination.
+struct AAPLStagingCopy
+{
+    uint64_t    destination;        // The upload's destination, which only the engine interprets.
+    size_t      destinationOffset;  // Of the copy's first byte within the upload.
+    uint32_t    buffer;             // Index of the staging buffer.
+    size_t      bufferOffset;
+    size_t      size;
+};
+
+// The part of a GPU or other backend that the ring drives.  The ring calls the engine from
+//  one thread at a time.
+class AAPLCopyEngine
+{
+public:
+    virtual ~AAPLCopyEngine() = default;
+
+    // Returns CPU-writable memory of `size` bytes for staging buffer `index`, which lives
+    //  as long as the engine.
+    virtual void* createStagingBuffer(uint32_t index, size_t size) = 0;
+
+    // Records a copy, which mustn't start before the next `submit`.
+    virtual void copy(const AAPLStagingCopy& copy) = 0;
+
+    // Starts the copies recorded since the last submit, and returns a fence greater than
+    //  any before that completes once they have finished.
+    virtual uint64_t submit() = 0;
+
+    // Largest fence whose copies, and all copies before them, have finished.
+    virtual uint64_t completedFence() = 0;
+
+    virtual void waitForFence(uint64_t fence) = 0;
+};
+
+// Runs copies with memcpy on a thread of its own, after an optional delay that stands in for
+//  the latency of a GPU.  Each upload's destination is a pointer to its memory.
+class AAPLMemcpyCopyEngine : public AAPLCopyEngine
+{
+public:
+    explicit AAPLMemcpyCopyEngine(uint32_t latencyMicroseconds = 0);
+    ~AAPLMemcpyCopyEngine() override;
+
+    void*    createStagingBuffer(uint32_t index, size_t size) override;
+    void     copy(const AAPLStagingCopy& copy) override;
+    uint64_t submit() override;
+    uint64_t completedFence() override;
+    void     waitForFence(uint64_t fence) override;
+
+private:
+    struct Batch
+    {
+        std::vector<AAPLStagingCopy>    copies;
+        uint64_t                        fence;
+    };
+
+    void run();
+
+    uint32_t                            _latencyMicroseconds;
+    std::vector<std::vector<uint8_t>>   _buffers;
+    std::vector<AAPLStagingCopy>        _recorded;
+    uint64_t                            _nextFence          = 0;
+
+    std::mutex                          _mutex;
+    std::condition_variable             _condition;
+    std::deque<Batch>                   _batches;
+    uint64_t                            _completedFence     = 0;
+    bool                                _stopping           = false;
+    std::thread                         _thread;
+};
+
+struct AAPLStagingRingDesc
+{
+    uint32_t    bufferCount         = 3;
+    size_t      bufferSize          = 16 << 20;
+    uint32_t    readerThreadCount   = 4;      // 0 to read on the thread that uploads.
+
+    // Of every allocation within a staging buffer, which must suit the engine's copies.
+    size_t      alignment           = 256;
+};
+
+// An upload of `size` bytes, which the ring reads in pieces, each a multiple of
+//  `splitSize` bytes, or in one piece if `splitSize` is 0.
+struct AAPLStagingUpload
+{
+    uint64_t    destination         = 0;
+    size_t      size                = 0;
+    size_t      splitSize           = 0;
+
+    // Fills `size` bytes at `destination` with the upload's bytes from `offset`.  Runs on a
+    //  reader thread, and returns false if the read fails.
+    std::function<bool(void* destination, size_t offset, size_t size)> read;
+};
+
+struct AAPLStagingRingStats
+{
+    uint64_t    uploadCount;
+    uint64_t    bytesRead;
+    uint64_t    bytesCompleted;     // Copied to their destinations.
+    double      activeSeconds;      // Time with pieces reading or copying, as the ring last saw it.
+    uint32_t    queueDepth;         // Pieces reading or copying.
+    uint32_t    maxQueueDepth;
+    uint64_t    fenceWaits;         // Times the ring waited for a staging buffer to be free.
+    uint64_t    failedReads;
+
+    double bytesPerSecond() const   { return activeSeconds > 0.0 ? bytesCompleted / activeSeconds : 0.0; }
+};
+
+// Uploads data through `bufferCount` staging buffers.  Each upload takes space from the
+//  current buffer; when that's full, the ring submits the buffer's copies once its reads are
+//  done, and moves to the next buffer, waiting for the engine to finish with it.  So reads
+//  into one buffer overlap the copies out of the others.
+//
+// The ring's methods must be called from one thread at a time.
+class AAPLStagingRing
+{
+public:
+    AAPLStagingRing(AAPLCopyEngine& engine, const AAPLStagingRingDesc& desc = AAPLStagingRingDesc());
+    ~AAPLStagingRing();
+
+    AAPLStagingRing(const AAPLStagingRing&) = delete;
+    AAPLStagingRing& operator=(const AAPLStagingRing&) = delete;
+
+    // Whether the ring can take an upload, which it can't if a piece is bigger than a buffer.
+    bool canUpload(size_t size, size_t splitSize) const;
+
+    // Starts reading an upload, which may wait for a staging buffer to be free.  Returns
+    //  false, without reading anything, if the ring can't take it.
+    bool upload(const AAPLStagingUpload& upload);
+
+    // Submits the copies of every upload so far, once their reads are done, and returns a
+    //  fence that completes after them.
+    uint64_t flush();
+
+    // Flushes and waits for every copy to finish.  Returns false if any read failed since
+    //  the last call, in which case the destinations of those uploads are incomplete.
+    bool finish();
+
+    AAPLStagingRingStats stats();
+
+private:
+    struct Buffer
+    {
+        uint8_t*                        data            = nullptr;
+        size_t                          used            = 0;
+        uint64_t                        fence           = 0;    // Of the last submit that copied from it.
+        uint32_t                        pieceCount      = 0;    // Not yet submitted.
+        uint32_t                        pendingReads    = 0;
+        std::vector<AAPLStagingCopy>    copies;                 // Of the pieces whose reads succeeded.
+    };
+
+    struct Read
+    {
+        std::shared_ptr<const AAPLStagingUpload>    upload;
+        AAPLStagingCopy                             copy;
+    };
+
+    struct Submission
+    {
+        uint64_t    fence;
+        size_t      bytes;
+        uint32_t    pieceCount;
+    };
+
+    size_t maxPieceSize(size_t size, size_t splitSize) const;
+    void   place(const std::shared_ptr<const AAPLStagingUpload>& upload, size_t offset, size_t size);
+    void   read(const Read& read);
+    void   readerLoop();
+    void   submitBuffer(uint32_t index);
+    void   retire();
+
+    AAPLCopyEngine&                         _engine;
+    AAPLStagingRingDesc                     _desc;
+    std::vector<Buffer>                     _buffers;
+    uint32_t                                _current            = 0;
+    uint64_t                                _lastFence          = 0;
+
+    // Guards the reads and the buffers' reads and copies.
+    std::mutex                              _mutex;
+    std::condition_variable                 _readAvailable;
+    std::condition_variable                 _readDone;
+    std::deque<Read>                        _reads;
+    bool                                    _stopping           = false;
+    std::vector<std::thread>                _readers;
+
+    std::deque<Submission>                  _inFlight;
+    uint32_t                                _queueDepth         = 0;
+    uint64_t                                _failedSinceFinish  = 0;
+    AAPLStagingRingStats                    _stats              = {};
+    std::chrono::steady_clock::time_point   _activeSince;
+};
@@ -0,0 +1,347 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that measures the tile cache against a cache built from a list and an
+ unordered map, replaying the puts, touches, and discards of a camera panning over tiles.
+*/
+#include "../Renderer/Sparse Texture/AAPLIndexLRUCache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --tiles N            Number of tiles (default 262144)\n"
+            "  --resident N         Tiles the heap holds at once (default a quarter of the tiles)\n"
+            "  --frames N           Number of frames (default 2000)\n"
+            "  --seed N             Seed of the access pattern (default 1)\n",
+            program);
+}
+
+// The cache the sample used before AAPLIndexLRUCache: a list of pointers and a map from each
+//  pointer to its list node.
+template <typename PointerType>
+class AAPLPointerLRUCache
+{
+public:
+    void put(PointerType dataPtr)
+    {
+        if (_lruNodes.count(dataPtr))
+            return;
+        _lru.push_front(dataPtr);
+        _lruNodes[dataPtr] = _lru.begin();
+    }
+
+    PointerType discardLeastRecentlyUsed()
+    {
+        if (_lru.empty())
+            return nullptr;
+        PointerType dataPtr = _lru.back();
+        _lru.pop_back();
+        _lruNodes.erase(dataPtr);
+        return dataPtr;
+    }
+
+    void discard(PointerType dataPtr)
+    {
+        auto nodeIter = _lruNodes.find(dataPtr);
+        if (nodeIter == _lruNodes.end())
+            return;
+        _lru.erase(nodeIter->second);
+        _lruNodes.erase(nodeIter);
+    }
+
+    size_t size() const { return _lruNodes.size(); }
+
+private:
+    std::list<PointerType> _lru;
+    std::unordered_map<PointerType, typename std::list<PointerType>::iterator> _lruNodes;
+};
+
+struct Tile
+{
+    uint8_t state;
+};
+
+// Adapts both caches to slots.  Touching a tile that's in use again removes it from either.
+struct IndexCache
+{
+    AAPLIndexLRUCache cache;
+
+    IndexCache(uint32_t tileCount, AAPLCachePolicy policy) : cache(tileCount, policy) {}
+
+    void     put(uint32_t slot)     { cache.put(slot); }
+    void     touch(uint32_t slot)   { cache.touch(slot); }
+    uint32_t discard()              { return cache.discardLeastRecentlyUsed(); }
+    size_t   size() const           { return cache.size(); }
+};
+
+struct PointerCache
+{
+    AAPLPointerLRUCache<Tile*>  cache;
+    std::vector<Tile>           tiles;
+
+    explicit PointerCache(uint32_t tileCount) : tiles(tileCount) {}
+
+    void     put(uint32_t slot)     { cache.put(&tiles[slot]); }
+    void     touch(uint32_t slot)   { cache.discard(&tiles[slot]); }
+    size_t   size() const           { return cache.size(); }
+
+    uint32_t discard()
+    {
+        Tile* tile = cache.discardLeastRecentlyUsed();
+        return tile ? (uint32_t)(tile - tiles.data()) : AAPLIndexLRUCache::InvalidSlot;
+    }
+};
+
+struct Result
+{
+    double                  seconds;        // Time of the cache operations alone.
+    std::vector<uint32_t>   operations;     // Operation in the top 2 bits, and slot.
+    uint64_t                maps;           // Tiles mapped because the GPU sampled them while unmapped.
+    uint64_t                hash;           // Hash of the order in which tiles were discarded.
+    bool                    consistent;     // Whether the cache size always matched the cached tiles.
+};
+
+enum : uint8_t
+{
+    Unmapped,
+    InUse,
+    Cached
+};
+
+enum : uint32_t
+{
+    PutOperation        = 0u << 30,
+    TouchOperation      = 1u << 30,
+    DiscardOperation    = 2u << 30,
+    SlotMask            = (1u << 30) - 1
+};
+
+// Each frame a window of tiles pans back and forth across the texture and tiles of a hot set
+//  are sampled now and then.  Tiles the GPU stops sampling enter the cache, tiles it samples
+//  again leave it, and mapping a tile when the heap is full discards the tile the cache
+//  chooses.  Records the cache operations, then times them on a new cache.
+template <typename Cache, typename... Arguments>
+Result run(uint32_t tileCount, uint32_t residentCount, uint32_t frameCount, uint32_t seed, Arguments... arguments)
+{
+    Cache cache(tileCount, arguments...);
+
+    std::vector<uint8_t>  state(tileCount, Unmapped);
+    std::vector<uint32_t> inUse;
+    std::vector<uint32_t> sampled;
+    std::vector<uint32_t> lastSampled(tileCount, UINT32_MAX);
+
+    uint32_t random = seed;
+    const auto next = [&random]()
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        return random;
+    };
+
+    const uint32_t window  = std::max(1u, residentCount / 2);
+    const uint32_t hotSize = std::max(1u, tileCount / 8);
+    const uint32_t range   = tileCount - window;
+
+    Result result = {};
+    result.hash       = 0xCBF29CE484222325ull;
+    result.consistent = true;
+
+    uint32_t mapped = 0;
+    uint64_t cached = 0;
+
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+    {
+        sampled.clear();
+
+        const uint32_t position = (uint32_t)((uint64_t)frame * 97 % (2 * range + 1));
+        const uint32_t first    = position <= range ? position : 2 * range - position;
+        for (uint32_t i = 0; i < window; ++i)
+            sampled.push_back(first + i);
+        for (uint32_t i = 0; i < hotSize / 32; ++i)
+            sampled.push_back(next() % hotSize * 61 % tileCount);
+
+        for (uint32_t tile : sampled)
+        {
+            if (lastSampled[tile] == frame)
+                continue;
+            lastSampled[tile] = frame;
+
+            if (state[tile] == Cached)
+            {
+                cache.touch(tile);
+                --cached;
+                result.operations.push_back(TouchOperation | tile);
+            }
+            else if (state[tile] == Unmapped)
+            {
+                if (mapped == residentCount)
+                {
+                    const uint32_t victim = cache.discard();
+                    result.operations.push_back(DiscardOperation | (victim & SlotMask));
+                    if (victim == AAPLIndexLRUCache::InvalidSlot)
+                        continue;
+
+                    result.consistent = result.consistent && state[victim] == Cached;
+                    result.hash       = (result.hash ^ victim) * 0x100000001B3ull;
+
+                    state[victim] = Unmapped;
+                    --cached;
+                    --mapped;
+                }
+
+                ++mapped;
+                ++result.maps;
+            }
+
+            if (state[tile] != InUse)
+                inUse.push_back(tile);
+            state[tile] = InUse;
+        }
+
+        // Tiles that weren't sampled this frame enter the cache.
+        size_t kept = 0;
+        for (uint32_t tile : inUse)
+        {
+            if (lastSampled[tile] == frame)
+            {
+                inUse[kept++] = tile;
+            }
+            else if (state[tile] == InUse)
+            {
+                state[tile] = Cached;
+                cache.put(tile);
+                ++cached;
+                result.operations.push_back(PutOperation | tile);
+            }
+        }
+        inUse.resize(kept);
+
+        result.consistent = result.consistent && cache.size() == cached;
+    }
+
+    // Replay the operations on a new cache, which must discard the same tiles.
+    Cache replay(tileCount, arguments...);
+    uint32_t mismatches = 0;
+
+    const auto begin = std::chrono::steady_clock::now();
+
+    for (uint32_t operation : result.operations)
+    {
+        const uint32_t slot = operation & SlotMask;
+        switch (operation & ~SlotMask)
+        {
+            case PutOperation:      replay.put(slot); break;
+            case TouchOperation:    replay.touch(slot); break;
+            default:                mismatches += (replay.discard() & SlotMask) != slot; break;
+        }
+    }
+
+    result.seconds    = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    result.consistent = result.consistent && mismatches == 0;
+    return result;
+}
+
+void print(const char* name, const Result& result)
+{
+    printf("  %-28s %8.1f ns/op %12llu ops %10llu maps   %s\n", name,
+           result.seconds * 1e9 / (double)std::max<size_t>(result.operations.size(), 1),
+           (unsigned long long)result.operations.size(), (unsigned long long)result.maps,
+           result.consistent ? "" : "INCONSISTENT");
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    uint32_t tileCount = 262144;
+    uint32_t residentCount = 0;
+    uint32_t frameCount = 2000;
+    uint32_t seed = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--tiles") && i + 1 < argc)
+        {
+            tileCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--resident") && i + 1 < argc)
+        {
+            residentCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            frameCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = (uint32_t)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (residentCount == 0)
+        residentCount = tileCount / 4;
+
+    if (tileCount < 64 || tileCount > SlotMask || residentCount == 0 || residentCount > tileCount || seed == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    printf("%u tiles, %u resident, %u frames\n\n", tileCount, residentCount, frameCount);
+
+    const Result pointer = run<PointerCache>(tileCount, residentCount, frameCount, seed);
+    print("list and unordered map", pointer);
+
+    bool passed = pointer.consistent;
+
+    const struct
+    {
+        const char*     name;
+        AAPLCachePolicy policy;
+    }
+    policies[] =
+    {
+        { "index cache, LRU",   AAPLCachePolicy::LeastRecentlyUsed },
+        { "index cache, CLOCK", AAPLCachePolicy::Clock },
+        { "index cache, 2Q",    AAPLCachePolicy::TwoQueue },
+    };
+
+    for (const auto& policy : policies)
+    {
+        const Result result = run<IndexCache>(tileCount, residentCount, frameCount, seed, policy.policy);
+        print(policy.name, result);
+
+        passed = passed && result.consistent;
+
+        // Both LRU caches must discard the same tiles in the same order.
+        if (policy.policy == AAPLCachePolicy::LeastRecentlyUsed && (result.hash != pointer.hash || result.maps != pointer.maps))
+        {
+            printf("  The LRU policy discarded different tiles than the list and unordered map\n");
+            passed = false;
+        }
+    }
+
+    printf("\n%s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,468 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that measures streaming sparse texture tiles from a tiled texture file
+ against copying them out of the memory-mapped KTX file, in page faults and latency.
+*/
+#include "../Renderer/Sparse Texture/AAPLKTXFile.h"
+#include "../Renderer/Sparse Texture/AAPLTiledTextureFile.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --ktx PATH           KTX file to stream, instead of a synthetic ASTC 4x4 texture\n"
+            "  --size N             Width and height of the synthetic texture (default 16384)\n"
+            "  --tile-size WxH      Tile size in pixels (default 128x128)\n"
+            "  --frames N           Frames of each camera path (default 200)\n"
+            "  --seed N             Seed of the random camera path (default 1)\n",
+            program);
+}
+
+double milliseconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Removes the files the tool writes, and their directory, however it exits.
+struct TemporaryDirectory
+{
+    std::string                 path;
+    std::vector<std::string>    files;
+
+    ~TemporaryDirectory()
+    {
+        for (const std::string& file : files)
+            unlink(file.c_str());
+        if (!path.empty())
+            rmdir(path.c_str());
+    }
+};
+
+struct TileRequest
+{
+    uint32_t level;
+    uint32_t x;
+    uint32_t y;
+};
+
+// Writes a KTX1 file of random ASTC 4x4 blocks with a full mipmap chain, which doesn't
+//  compress, so that the file's pages have to come from the disk.
+bool writeSyntheticKTX(const char* path, uint32_t size)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    const uint32_t levelCount = 32 - __builtin_clz(size);
+
+    const uint8_t identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+    const uint32_t header[13] = { 0x04030201, 0, 1, 0, 0x93B0, 0x1908, size, size, 0, 0, 1, levelCount, 0 };
+    bool written = fwrite(identifier, sizeof(identifier), 1, file) == 1 && fwrite(header, sizeof(header), 1, file) == 1;
+
+    uint64_t state = 88172645463325252ull;
+    std::vector<uint64_t> blocks;
+    for (uint32_t level = 0; level < levelCount && written; ++level)
+    {
+        const uint32_t blocksWide = (std::max(size >> level, 1u) + 3) / 4;
+        const uint32_t imageSize  = blocksWide * blocksWide * 16;
+
+        blocks.resize(imageSize / sizeof(uint64_t));
+        for (uint64_t& value : blocks)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            value = state;
+        }
+
+        written = fwrite(&imageSize, sizeof(imageSize), 1, file) == 1 &&
+                  fwrite(blocks.data(), imageSize, 1, file) == 1;
+    }
+
+    return fclose(file) == 0 && written;
+}
+
+// The tiles a camera newly sees each frame: a window of 8 x 6 tiles at the finest level and
+//  the matching windows of the 3 coarser levels, either panning half a tile per frame or
+//  jumping to a random place.  Each tile is requested once, as the heap never fills.
+std::vector<std::vector<TileRequest>> createFrames(const AAPLTiledTextureFile& tiled, uint32_t frameCount,
+                                                   bool pan, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::vector<std::vector<uint8_t>> requested(tiled.levelCount());
+    for (uint32_t level = 0; level < tiled.levelCount(); ++level)
+        requested[level].resize(tiled.tilesWide(level) * tiled.tilesHigh(level));
+
+    std::vector<std::vector<TileRequest>> frames(frameCount);
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+    {
+        const int centerX = pan ? 10 + frame / 2 : (int)(random() % tiled.tilesWide(0));
+        const int centerY = pan ? 20 + frame / 4 : (int)(random() % tiled.tilesHigh(0));
+
+        for (uint32_t level = 0; level < std::min(tiled.levelCount(), 4u); ++level)
+        {
+            const int width  = std::max(8 >> level, 1);
+            const int height = std::max(6 >> level, 1);
+            const int left   = (centerX >> level) - width / 2;
+            const int top    = (centerY >> level) - height / 2;
+
+            for (int y = std::max(top, 0); y < std::min(top + height, (int)tiled.tilesHigh(level)); ++y)
+            {
+                for (int x = std::max(left, 0); x < std::min(left + width, (int)tiled.tilesWide(level)); ++x)
+                {
+                    uint8_t& wasRequested = requested[level][y * tiled.tilesWide(level) + x];
+                    if (!wasRequested)
+                        frames[frame].push_back({ level, (uint32_t)x, (uint32_t)y });
+                    wasRequested = 1;
+                }
+            }
+        }
+    }
+    return frames;
+}
+
+// Copies the rows of blocks of a tile out of the mapped KTX file, as the sample does
+//  without a tiled file.
+void copyTileRows(const AAPLKTXFile& ktx, const AAPLTiledTextureFile& tiled, const TileRequest& request, uint8_t* tile)
+{
+    const AAPLKTXFormat& format         = ktx.format();
+    const AAPLKTXFile::Level& levelInfo = ktx.level(request.level);
+    const uint32_t blocksWide           = (levelInfo.width + format.blockWidth - 1) / format.blockWidth;
+    const uint32_t blocksHigh           = (levelInfo.height + format.blockHeight - 1) / format.blockHeight;
+    const uint32_t tileBlocksWide       = tiled.tileWidth() / format.blockWidth;
+    const uint32_t tileBlocksHigh       = tiled.tileHeight() / format.blockHeight;
+    const uint32_t rowCount             = std::min(tileBlocksHigh, blocksHigh - request.y * tileBlocksHigh);
+    const uint32_t columnCount          = std::min(tileBlocksWide, blocksWide - request.x * tileBlocksWide);
+
+    const uint8_t* levelData = ktx.image(request.level, 0, 0).data;
+    for (uint32_t row = 0; row < rowCount; ++row)
+    {
+        const uint8_t* source = levelData + (uint64_t)(request.y * tileBlocksHigh + row) * levelInfo.bytesPerRow +
+                                (uint64_t)request.x * tileBlocksWide * format.bytesPerBlock;
+        memcpy(tile + row * tiled.tileBytesPerRow(), source, columnCount * format.bytesPerBlock);
+    }
+}
+
+#if defined(POSIX_FADV_DONTNEED)
+#define AAPL_CAN_EVICT 1
+
+// Drops the pages of a file from the page cache, so that the next read comes from the disk.
+void evict(const char* path)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+#endif
+
+struct Measurement
+{
+    std::vector<double> frameMilliseconds;
+    double              totalMilliseconds   = 0;
+    long                minorFaults         = 0;
+    long                majorFaults         = 0;
+    uint64_t            readCount           = 0;
+    bool                succeeded           = true;
+};
+
+void faultCounts(long& minorFaults, long& majorFaults)
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    minorFaults = usage.ru_minflt;
+    majorFaults = usage.ru_majflt;
+}
+
+// Streams each frame's tiles into `staging`, either by copying rows out of a new mapping of
+//  the KTX file, or by reading them from the tiled file in one batch.
+Measurement measure(const char* ktxPath, const char* tiledPath, bool useTiledFile,
+                    const std::vector<std::vector<TileRequest>>& frames, std::vector<uint8_t>& staging)
+{
+    Measurement measurement;
+    std::string error;
+
+    long minorFaults, majorFaults;
+    faultCounts(minorFaults, majorFaults);
+    const auto begin = std::chrono::steady_clock::now();
+
+    AAPLKTXFile ktx;
+    AAPLTiledTextureFile tiled;
+    if (!tiled.open(tiledPath, error) || (!useTiledFile && !ktx.open(ktxPath, error)))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        measurement.succeeded = false;
+        return measurement;
+    }
+
+    const uint32_t tileLength = tiled.tileLength();
+    std::vector<AAPLTiledTextureFile::Request> requests;
+    AAPLTiledTextureFile::ReadStats stats;
+
+    for (const std::vector<TileRequest>& frame : frames)
+    {
+        const auto frameBegin = std::chrono::steady_clock::now();
+        if (useTiledFile)
+        {
+            requests.clear();
+            for (size_t i = 0; i < frame.size(); ++i)
+                requests.push_back({ frame[i].level, frame[i].x, frame[i].y, staging.data() + i * tileLength });
+            measurement.succeeded &= tiled.readTiles(requests.data(), requests.size(), error, &stats);
+        }
+        else
+        {
+            for (size_t i = 0; i < frame.size(); ++i)
+                copyTileRows(ktx, tiled, frame[i], staging.data() + i * tileLength);
+        }
+        measurement.frameMilliseconds.push_back(milliseconds(frameBegin));
+    }
+
+    measurement.totalMilliseconds = milliseconds(begin);
+
+    long endMinorFaults, endMajorFaults;
+    faultCounts(endMinorFaults, endMajorFaults);
+    measurement.minorFaults = endMinorFaults - minorFaults;
+    measurement.majorFaults = endMajorFaults - majorFaults;
+    measurement.readCount   = stats.readCount;
+    return measurement;
+}
+
+// Compares the tiles of every frame read from the tiled file with the rows of the KTX file.
+//  Returns the number of tiles that differ, or that failed to read.
+size_t checkFrames(const char* ktxPath, const char* tiledPath, const std::vector<std::vector<TileRequest>>& frames)
+{
+    std::string error;
+    AAPLKTXFile ktx;
+    AAPLTiledTextureFile tiled;
+    if (!ktx.open(ktxPath, error) || !tiled.open(tiledPath, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    const uint32_t tileLength = tiled.tileLength();
+    std::vector<uint8_t> expected(tileLength);
+    std::vector<uint8_t> tiles;
+    std::vector<AAPLTiledTextureFile::Request> requests;
+    size_t mismatchCount = 0;
+
+    for (const std::vector<TileRequest>& frame : frames)
+    {
+        tiles.assign(frame.size() * tileLength, 0);
+        requests.clear();
+        for (size_t i = 0; i < frame.size(); ++i)
+            requests.push_back({ frame[i].level, frame[i].x, frame[i].y, tiles.data() + i * tileLength });
+
+        if (!tiled.readTiles(requests.data(), requests.size(), error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return frame.size();
+        }
+
+        for (size_t i = 0; i < frame.size(); ++i)
+        {
+            std::fill(expected.begin(), expected.end(), 0);
+            copyTileRows(ktx, tiled, frame[i], expected.data());
+            if (memcmp(tiles.data() + i * tileLength, expected.data(), tileLength))
+                mismatchCount++;
+        }
+    }
+    return mismatchCount;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    const char* ktxPath = nullptr;
+    uint32_t size = 16384;
+    uint32_t tileWidth = 128;
+    uint32_t tileHeight = 128;
+    uint32_t frameCount = 200;
+    uint32_t seed = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--ktx") && i + 1 < argc)
+        {
+            ktxPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc)
+        {
+            size = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--tile-size") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &tileWidth, &tileHeight) != 2)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            frameCount = (uint32_t)atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+        {
+            seed = (uint32_t)atoi(argv[++i]);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (size == 0 || tileWidth == 0 || tileHeight == 0 || frameCount == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // The synthetic texture and the tiled file go to a temporary directory.
+    const char* temp = getenv("TMPDIR");
+    std::string directoryPath = std::string(temp ? temp : "/tmp") + "/AAPLTiledTextureBenchmark.XXXXXX";
+    if (!mkdtemp(&directoryPath[0]))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    TemporaryDirectory directory;
+    directory.path = directoryPath;
+
+    if (!ktxPath)
+    {
+        directory.files.push_back(directoryPath + "/synthetic.ktx");
+        if (!writeSyntheticKTX(directory.files.back().c_str(), size))
+        {
+            fprintf(stderr, "Couldn't write '%s'\n", directory.files.back().c_str());
+            return 1;
+        }
+    }
+
+    const std::string sourcePath = ktxPath ? ktxPath : directory.files.back();
+    directory.files.push_back(directoryPath + "/texture.tiles");
+    const std::string tiledPath = directory.files.back();
+
+    std::string error;
+    {
+        AAPLKTXFile ktx;
+        if (!ktx.open(sourcePath.c_str(), error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+
+        if (ktx.supercompression() != AAPLKTXFile::SupercompressionNone)
+        {
+            fprintf(stderr, "The levels of '%s' are supercompressed, so they can't be copied from a mapping\n",
+                    sourcePath.c_str());
+            return 1;
+        }
+
+        printf("%s: %ux%u, %u levels, %.1f MB, %ux%u tiles\n", sourcePath.c_str(), ktx.width(), ktx.height(),
+               ktx.levelCount(), ktx.fileData().size / (1024.0 * 1024.0), tileWidth, tileHeight);
+
+        if (!AAPLWriteTiledTextureFile(ktx, tiledPath.c_str(), tileWidth, tileHeight, error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    AAPLTiledTextureFile tiled;
+    if (!tiled.open(tiledPath.c_str(), error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+#if !AAPL_CAN_EVICT
+    printf("The platform can't drop files from the page cache, so only warm runs are measured.\n");
+#endif
+
+    printf("\n  %-7s %-5s %-7s %6s %9s %9s %7s %9s %9s %9s %8s\n",
+           "camera", "cache", "source", "tiles", "minor", "major", "reads", "us/tile", "p50 ms", "p99 ms", "max ms");
+
+    size_t failures = 0;
+
+    for (bool pan : { true, false })
+    {
+        const std::vector<std::vector<TileRequest>> frames = createFrames(tiled, frameCount, pan, seed);
+
+        size_t tileCount = 0;
+        size_t largestFrame = 0;
+        for (const std::vector<TileRequest>& frame : frames)
+        {
+            tileCount += frame.size();
+            largestFrame = std::max(largestFrame, frame.size());
+        }
+
+        failures += checkFrames(sourcePath.c_str(), tiledPath.c_str(), frames);
+
+        // Touch the staging memory first, as the sample's staging buffers are.
+        std::vector<uint8_t> staging(largestFrame * tiled.tileLength(), 1);
+
+        for (bool cold : { true, false })
+        {
+#if !AAPL_CAN_EVICT
+            if (cold)
+                continue;
+#endif
+            for (bool useTiledFile : { false, true })
+            {
+#if AAPL_CAN_EVICT
+                if (cold)
+                {
+                    evict(sourcePath.c_str());
+                    evict(tiledPath.c_str());
+                }
+#endif
+                const Measurement measurement = measure(sourcePath.c_str(), tiledPath.c_str(), useTiledFile, frames, staging);
+                if (!measurement.succeeded)
+                {
+                    failures++;
+                    continue;
+                }
+
+                std::vector<double> sorted = measurement.frameMilliseconds;
+                std::sort(sorted.begin(), sorted.end());
+
+                char reads[16] = "-";
+                if (useTiledFile)
+                    snprintf(reads, sizeof(reads), "%llu", (unsigned long long)measurement.readCount);
+
+                printf("  %-7s %-5s %-7s %6zu %9ld %9ld %7s %9.1f %9.2f %9.2f %8.2f\n",
+                       pan ? "pan" : "random", cold ? "cold" : "warm", useTiledFile ? "tiles" : "mmap",
+                       tileCount, measurement.minorFaults, measurement.majorFaults, reads,
+                       measurement.totalMilliseconds * 1e3 / std::max<size_t>(tileCount, 1),
+                       sorted[sorted.size() / 2], sorted[sorted.size() * 99 / 100], sorted.back());
+            }
+        }
+    }
+
+    printf("\n%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
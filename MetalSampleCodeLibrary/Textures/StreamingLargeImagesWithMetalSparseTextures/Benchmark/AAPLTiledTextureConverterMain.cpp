@@ -0,0 +1,215 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Command line tool that converts a 2D block-compressed KTX file to the tiled texture file
+ the sparse texture streams from, and checks every tile against the KTX file.
+*/
+#include "../Renderer/Sparse Texture/AAPLKTXFile.h"
+#include "../Renderer/Sparse Texture/AAPLTiledTextureFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+void printUsage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s input.ktx [options]\n"
+            "  -o PATH              Tiled texture file to write (default the input with the tiles extension)\n"
+            "  --tile-size WxH      Tile size in pixels, which must match the device's sparse tile size\n"
+            "                       for the format (default 128x128)\n"
+            "  --alignment N        Alignment of each tile in the file, in bytes (default 4096)\n",
+            program);
+}
+
+double seconds(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Copies the rows of blocks of a tile from its level, as the sample does from the mapped KTX
+//  file, leaving the blocks past the edge of the level zero.
+void copyTileRows(const uint8_t* levelData, uint32_t bytesPerRow, uint32_t blocksWide, uint32_t blocksHigh,
+                  const AAPLTiledTextureFile& tiled, uint32_t x, uint32_t y, uint8_t* tile)
+{
+    const AAPLKTXFormat& format    = tiled.format();
+    const uint32_t tileBlocksWide  = tiled.tileWidth() / format.blockWidth;
+    const uint32_t tileBlocksHigh  = tiled.tileHeight() / format.blockHeight;
+    const uint32_t rowCount        = std::min(tileBlocksHigh, blocksHigh - y * tileBlocksHigh);
+    const uint32_t columnCount     = std::min(tileBlocksWide, blocksWide - x * tileBlocksWide);
+
+    memset(tile, 0, tiled.tileLength());
+    for (uint32_t row = 0; row < rowCount; ++row)
+    {
+        const uint8_t* source = levelData + (uint64_t)(y * tileBlocksHigh + row) * bytesPerRow +
+                                (uint64_t)x * tileBlocksWide * format.bytesPerBlock;
+        memcpy(tile + row * tiled.tileBytesPerRow(), source, columnCount * format.bytesPerBlock);
+    }
+}
+
+// Reads back every tile of every level and compares it with the rows of the KTX file.
+//  Returns the number of tiles that differ.
+size_t checkTiles(const AAPLKTXFile& ktx, AAPLTiledTextureFile& tiled, std::string& error)
+{
+    // Tiles read per call, as a request list of a frame might.
+    const size_t batchSize = 256;
+
+    const uint32_t tileLength = tiled.tileLength();
+    std::vector<uint8_t> tiles(batchSize * tileLength);
+    std::vector<uint8_t> expected(tileLength);
+    std::vector<AAPLTiledTextureFile::Request> requests;
+    size_t mismatchCount = 0;
+
+    for (uint32_t level = 0; level < tiled.levelCount(); ++level)
+    {
+        // Supercompressed levels decode here, as the converter decodes them.
+        const AAPLKTXFile::Level& levelInfo = ktx.level(level);
+        std::vector<uint8_t> levelData((size_t)levelInfo.uncompressedLength);
+        if (!AAPLKTXDecodeLevel(ktx, level, levelData.data(), levelData.size(), error))
+            return ~(size_t)0;
+
+        const AAPLKTXFormat& format = ktx.format();
+        const uint32_t blocksWide   = (levelInfo.width + format.blockWidth - 1) / format.blockWidth;
+        const uint32_t blocksHigh   = (levelInfo.height + format.blockHeight - 1) / format.blockHeight;
+        const uint32_t tileCount    = tiled.tilesWide(level) * tiled.tilesHigh(level);
+
+        for (uint32_t first = 0; first < tileCount; first += batchSize)
+        {
+            requests.clear();
+            for (uint32_t i = first; i < std::min<uint32_t>(first + batchSize, tileCount); ++i)
+            {
+                requests.push_back({ level, i % tiled.tilesWide(level), i / tiled.tilesWide(level),
+                                     tiles.data() + (i - first) * tileLength });
+            }
+
+            if (!tiled.readTiles(requests.data(), requests.size(), error))
+                return ~(size_t)0;
+
+            for (const AAPLTiledTextureFile::Request& request : requests)
+            {
+                copyTileRows(levelData.data(), levelInfo.bytesPerRow, blocksWide, blocksHigh,
+                             tiled, request.x, request.y, expected.data());
+                if (memcmp(request.destination, expected.data(), tileLength))
+                    mismatchCount++;
+            }
+        }
+    }
+    return mismatchCount;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    const char* inputPath = nullptr;
+    std::string outputPath;
+    uint32_t tileWidth = 128;
+    uint32_t tileHeight = 128;
+    uint32_t alignment = AAPLTiledTextureFile::DefaultAlignment;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--tile-size") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &tileWidth, &tileHeight) != 2)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--alignment") && i + 1 < argc)
+        {
+            alignment = (uint32_t)atoi(argv[++i]);
+        }
+        else if (argv[i][0] != '-' && !inputPath)
+        {
+            inputPath = argv[i];
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!inputPath || tileWidth == 0 || tileHeight == 0 || alignment == 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (outputPath.empty())
+    {
+        outputPath = inputPath;
+        const size_t extension = outputPath.find_last_of("./");
+        if (extension != std::string::npos && outputPath[extension] == '.')
+            outputPath.resize(extension);
+        outputPath += ".tiles";
+    }
+
+    std::string error;
+    AAPLKTXFile ktx;
+    if (!ktx.open(inputPath, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    printf("%s: %ux%u, %u levels, %ux%u blocks of %u bytes\n", inputPath, ktx.width(), ktx.height(), ktx.levelCount(),
+           ktx.format().blockWidth, ktx.format().blockHeight, ktx.format().bytesPerBlock);
+
+    const auto begin = std::chrono::steady_clock::now();
+    if (!AAPLWriteTiledTextureFile(ktx, outputPath.c_str(), tileWidth, tileHeight, error, alignment))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const double convertSeconds = seconds(begin);
+
+    AAPLTiledTextureFile tiled;
+    if (!tiled.open(outputPath.c_str(), error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    size_t tileCount = 0;
+    for (uint32_t level = 0; level < tiled.levelCount(); ++level)
+    {
+        printf("  Level %2u: %4u x %-4u tiles\n", level, tiled.tilesWide(level), tiled.tilesHigh(level));
+        tileCount += tiled.tilesWide(level) * tiled.tilesHigh(level);
+    }
+
+    const size_t mismatchCount = checkTiles(ktx, tiled, error);
+    if (mismatchCount == ~(size_t)0)
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    struct stat status = {};
+    stat(outputPath.c_str(), &status);
+    printf("%s: %zu tiles of %ux%u pixels, %u bytes each, %.1f MB, written in %.0f ms\n",
+           outputPath.c_str(), tileCount, tiled.tileWidth(), tiled.tileHeight(), tiled.tileLength(),
+           status.st_size / (1024.0 * 1024.0), convertSeconds * 1e3);
+
+    if (mismatchCount)
+        printf("  %zu tiles differ from the KTX file\n", mismatchCount);
+
+    printf("\n%s\n", mismatchCount ? "FAILED" : "passed");
+    return mismatchCount ? 1 : 0;
+}
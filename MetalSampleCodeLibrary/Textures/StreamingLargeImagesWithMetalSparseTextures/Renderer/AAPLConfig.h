@@ -16,5 +16,9 @@ The header containing the build time configuration settings.
 /// Use this define to use a smaller heap size that exaggerates the mapping and unmapping process.
 #define USE_SMALL_SPARSE_TEXTURE_HEAP (0)
 
+/// Use this define to choose which unused tiles to unmap first when the heap is full:
+/// 0 for least recently used, 1 for CLOCK, 2 for 2Q.
+#define TILE_CACHE_POLICY             (0)
+
 static const NSUInteger AAPLMaxFramesInFlight = 3l;
 static const NSUInteger AAPLMaxStreamingBufferHeapInstCount = 64;
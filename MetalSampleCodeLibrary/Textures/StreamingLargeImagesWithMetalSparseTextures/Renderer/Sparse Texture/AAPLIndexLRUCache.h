@@ -0,0 +1,193 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+The header for the class that manages the least-recently used list of slot indices.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/// The policies that decide which slot AAPLIndexLRUCache discards.
+enum class AAPLCachePolicy : uint8_t
+{
+    /// Discards the least recently put slot.
+    LeastRecentlyUsed,
+    /// Discards the least recently put slot, except that a slot touched before it was last put
+    /// gets a second chance and moves to the front instead.
+    Clock,
+    /// Puts new slots in a probation queue, and slots touched before they were last put in a
+    /// main queue. Discards from the probation queue first, so that slots used once don't flush
+    /// the slots used repeatedly. This is the 2Q policy without its queue of discarded slots.
+    TwoQueue,
+};
+
+/// AAPLIndexLRUCache manages the least-recently used list of slots, which are indices below a capacity
+/// fixed at construction, such as the index of a texture tile.
+/// The list links live in arrays indexed by slot, so operations are O(1) and don't allocate memory.
+/// The cache holds only slots that aren't in use: touching a slot that's in use again removes it,
+/// and the policy remembers the use when the slot is put back.
+class AAPLIndexLRUCache
+{
+public:
+    /// The slot `discardLeastRecentlyUsed` returns when the cache is empty.
+    static const uint32_t InvalidSlot = UINT32_MAX;
+
+    AAPLIndexLRUCache() {}
+
+    AAPLIndexLRUCache(uint32_t capacity, AAPLCachePolicy policy = AAPLCachePolicy::LeastRecentlyUsed)
+    {
+        reset(capacity, policy);
+    }
+
+    /// Empties the cache and sets its capacity and policy. This is the only method that allocates memory.
+    void reset(uint32_t capacity, AAPLCachePolicy policy = AAPLCachePolicy::LeastRecentlyUsed)
+    {
+        _nodes.assign(capacity, Node{ InvalidSlot, InvalidSlot, NotCached, false });
+        _lists[MainList]      = List{ InvalidSlot, InvalidSlot, 0 };
+        _lists[ProbationList] = List{ InvalidSlot, InvalidSlot, 0 };
+        _policy               = policy;
+    }
+
+    /// Returns whether the slot is in the cache.
+    bool contains(uint32_t slot) const
+    {
+        return _nodes[slot].list != NotCached;
+    }
+
+    /// Adds the slot, which is no longer in use, to the front of the cache. Putting a slot that's
+    /// already in the cache does nothing.
+    void put(uint32_t slot)
+    {
+        if (contains(slot))
+            return;
+
+        const bool probation = _policy == AAPLCachePolicy::TwoQueue && !_nodes[slot].referenced;
+        pushFront(slot, probation ? ProbationList : MainList);
+    }
+
+    /// Removes the slot, which is in use again, from the cache, if it's there. The CLOCK and 2Q
+    /// policies favor the slot the next time it's put.
+    void touch(uint32_t slot)
+    {
+        Node& node = _nodes[slot];
+        if (node.list == NotCached)
+            return;
+
+        unlink(slot);
+        node.referenced = (_policy != AAPLCachePolicy::LeastRecentlyUsed);
+    }
+
+    /// Returns and removes the slot to discard according to the policy, or `InvalidSlot` if the cache is empty.
+    uint32_t discardLeastRecentlyUsed()
+    {
+        for (;;)
+        {
+            const uint8_t list = (_lists[ProbationList].size > _lists[MainList].size / 3 || _lists[MainList].size == 0) ? ProbationList : MainList;
+
+            const uint32_t slot = _lists[list].tail;
+            if (slot == InvalidSlot)
+                return InvalidSlot;
+
+            unlink(slot);
+
+            // Clock: give referenced slots a second chance.
+            if (_nodes[slot].referenced && _policy == AAPLCachePolicy::Clock)
+            {
+                _nodes[slot].referenced = false;
+                pushFront(slot, list);
+                continue;
+            }
+            _nodes[slot].referenced = false;
+            return slot;
+        }
+    }
+
+    /// Discards the slot from the cache and forgets that it was used.
+    void discard(uint32_t slot)
+    {
+        if (contains(slot))
+            unlink(slot);
+        _nodes[slot].referenced = false;
+    }
+
+    /// Returns the number of slots in the cache.
+    size_t size() const
+    {
+        return _lists[MainList].size + _lists[ProbationList].size;
+    }
+
+    /// Returns the largest slot plus one.
+    size_t capacity() const
+    {
+        return _nodes.size();
+    }
+
+private:
+    enum : uint8_t
+    {
+        MainList,
+        ProbationList,
+        NotCached
+    };
+
+    struct Node
+    {
+        uint32_t prev;
+        uint32_t next;
+        uint8_t  list;
+        bool     referenced;    // Touched since the cache last discarded the slot.
+    };
+
+    struct List
+    {
+        uint32_t head;
+        uint32_t tail;
+        uint32_t size;
+    };
+
+    std::vector<Node> _nodes;
+    List              _lists[2];
+    AAPLCachePolicy   _policy = AAPLCachePolicy::LeastRecentlyUsed;
+
+    /// Links the slot at the front of a list.
+    void pushFront(uint32_t slot, uint8_t list)
+    {
+        Node& node = _nodes[slot];
+        List& l    = _lists[list];
+
+        node.list = list;
+        node.prev = InvalidSlot;
+        node.next = l.head;
+
+        if (l.head != InvalidSlot)
+            _nodes[l.head].prev = slot;
+        else
+            l.tail = slot;
+
+        l.head = slot;
+        ++l.size;
+    }
+
+    /// Unlinks the slot from its list.
+    void unlink(uint32_t slot)
+    {
+        Node& node = _nodes[slot];
+        List& l    = _lists[node.list];
+
+        if (node.prev != InvalidSlot)
+            _nodes[node.prev].next = node.next;
+        else
+            l.head = node.next;
+
+        if (node.next != InvalidSlot)
+            _nodes[node.next].prev = node.prev;
+        else
+            l.tail = node.prev;
+
+        --l.size;
+        node.list = NotCached;
+    }
+};
@@ -0,0 +1,785 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the KTX container reader.
+*/
+#include "AAPLKTXFile.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#if defined(__APPLE__)
+#include <compression.h>
+#elif __has_include(<zlib.h>)
+#include <zlib.h>
+#define AAPL_HAS_ZLIB 1
+#endif
+
+#if __has_include(<zstd.h>)
+#include <zstd.h>
+#define AAPL_HAS_ZSTD 1
+#endif
+
+namespace
+{
+
+static const uint8_t KTX1Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+static const uint8_t KTX2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+static const size_t KTX1HeaderSize      = 64;
+static const size_t KTX2HeaderSize      = 80;   // Including the index of the data blocks.
+static const size_t KTX2LevelIndexSize  = 24;
+
+// Formats known to the reader, with their KTX1 and KTX2 codes.
+static const AAPLKTXFormat Formats[] =
+{
+    // glInternalFormat, vkFormat, blockWidth, blockHeight, bytesPerBlock, sRGB
+    { 0x8229,   9,  1,  1,  1,  false },    // R8
+    { 0x822B,  16,  1,  1,  2,  false },    // RG8
+    { 0x8058,  37,  1,  1,  4,  false },    // RGBA8
+    { 0x8C43,  43,  1,  1,  4,  true  },    // SRGB8_ALPHA8
+    { 0x93A1,  44,  1,  1,  4,  false },    // BGRA8
+    { 0,       50,  1,  1,  4,  true  },    // BGRA8 sRGB
+    { 0x822D,  76,  1,  1,  2,  false },    // R16F
+    { 0x822F,  83,  1,  1,  4,  false },    // RG16F
+    { 0x881A,  97,  1,  1,  8,  false },    // RGBA16F
+    { 0x822E, 100,  1,  1,  4,  false },    // R32F
+    { 0x8230, 103,  1,  1,  8,  false },    // RG32F
+    { 0x8814, 109,  1,  1, 16,  false },    // RGBA32F
+    { 0x8C3A, 122,  1,  1,  4,  false },    // R11F_G11F_B10F
+    { 0x8C3D, 123,  1,  1,  4,  false },    // RGB9_E5
+
+    { 0x83F1, 133,  4,  4,  8,  false },    // BC1
+    { 0x8C4D, 134,  4,  4,  8,  true  },
+    { 0x83F2, 135,  4,  4, 16,  false },    // BC2
+    { 0x8C4E, 136,  4,  4, 16,  true  },
+    { 0x83F3, 137,  4,  4, 16,  false },    // BC3
+    { 0x8C4F, 138,  4,  4, 16,  true  },
+    { 0x8DBB, 139,  4,  4,  8,  false },    // BC4
+    { 0x8DBC, 140,  4,  4,  8,  false },
+    { 0x8DBD, 141,  4,  4, 16,  false },    // BC5
+    { 0x8DBE, 142,  4,  4, 16,  false },
+    { 0x8E8F, 143,  4,  4, 16,  false },    // BC6H
+    { 0x8E8E, 144,  4,  4, 16,  false },
+    { 0x8E8C, 145,  4,  4, 16,  false },    // BC7
+    { 0x8E8D, 146,  4,  4, 16,  true  },
+
+    { 0x9274, 147,  4,  4,  8,  false },    // ETC2 RGB8
+    { 0x9275, 148,  4,  4,  8,  true  },
+    { 0x9278, 151,  4,  4, 16,  false },    // ETC2 RGBA8
+    { 0x9279, 152,  4,  4, 16,  true  },
+    { 0x9270, 153,  4,  4,  8,  false },    // EAC R11
+    { 0x9272, 155,  4,  4, 16,  false },    // EAC RG11
+
+    { 0x93B0, 157,  4,  4, 16,  false },    // ASTC
+    { 0x93D0, 158,  4,  4, 16,  true  },
+    { 0x93B1, 159,  5,  4, 16,  false },
+    { 0x93D1, 160,  5,  4, 16,  true  },
+    { 0x93B2, 161,  5,  5, 16,  false },
+    { 0x93D2, 162,  5,  5, 16,  true  },
+    { 0x93B3, 163,  6,  5, 16,  false },
+    { 0x93D3, 164,  6,  5, 16,  true  },
+    { 0x93B4, 165,  6,  6, 16,  false },
+    { 0x93D4, 166,  6,  6, 16,  true  },
+    { 0x93B5, 167,  8,  5, 16,  false },
+    { 0x93D5, 168,  8,  5, 16,  true  },
+    { 0x93B6, 169,  8,  6, 16,  false },
+    { 0x93D6, 170,  8,  6, 16,  true  },
+    { 0x93B7, 171,  8,  8, 16,  false },
+    { 0x93D7, 172,  8,  8, 16,  true  },
+    { 0x93B8, 173, 10,  5, 16,  false },
+    { 0x93D8, 174, 10,  5, 16,  true  },
+    { 0x93B9, 175, 10,  6, 16,  false },
+    { 0x93D9, 176, 10,  6, 16,  true  },
+    { 0x93BA, 177, 10,  8, 16,  false },
+    { 0x93DA, 178, 10,  8, 16,  true  },
+    { 0x93BB, 179, 10, 10, 16,  false },
+    { 0x93DB, 180, 10, 10, 16,  true  },
+    { 0x93BC, 181, 12, 10, 16,  false },
+    { 0x93DC, 182, 12, 10, 16,  true  },
+    { 0x93BD, 183, 12, 12, 16,  false },
+    { 0x93DD, 184, 12, 12, 16,  true  },
+};
+
+inline uint32_t readU32(const uint8_t* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint64_t readU64(const uint8_t* data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint64_t align4(uint64_t value)
+{
+    return (value + 3) & ~(uint64_t)3;
+}
+
+inline uint32_t divideRoundUp(uint32_t value, uint32_t divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+
+// Whether [offset, offset + length) lies within `size` bytes, without overflowing.
+inline bool inRange(uint64_t offset, uint64_t length, uint64_t size)
+{
+    return offset <= size && length <= size - offset;
+}
+
+inline bool multiply(uint64_t a, uint64_t b, uint64_t& result)
+{
+    return !__builtin_mul_overflow(a, b, &result);
+}
+
+} // namespace
+
+const AAPLKTXFormat* AAPLKTXFormatForGLInternalFormat(uint32_t glInternalFormat)
+{
+    if (glInternalFormat == 0)
+        return nullptr;
+
+    for (const AAPLKTXFormat& format : Formats)
+    {
+        if (format.glInternalFormat == glInternalFormat)
+            return &format;
+    }
+    return nullptr;
+}
+
+const AAPLKTXFormat* AAPLKTXFormatForVkFormat(uint32_t vkFormat)
+{
+    for (const AAPLKTXFormat& format : Formats)
+    {
+        if (format.vkFormat == vkFormat)
+            return &format;
+    }
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+AAPLKTXFile::~AAPLKTXFile()
+{
+    close();
+}
+
+bool AAPLKTXFile::open(const char* path, std::string& error)
+{
+    close();
+
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        error = std::string("Couldn't open ") + path;
+        return false;
+    }
+
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size <= 0)
+    {
+        ::close(fd);
+        error = std::string("Couldn't read the size of ") + path;
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps the file's pages available after closing it.
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        error = std::string("Couldn't map ") + path;
+        return false;
+    }
+
+    if (!parse(mapping, (size_t)fileInfo.st_size, error))
+    {
+        munmap(mapping, (size_t)fileInfo.st_size);
+        error = std::string(path) + ": " + error;
+        return false;
+    }
+
+    _mapping        = mapping;
+    _mappingSize    = (size_t)fileInfo.st_size;
+    return true;
+}
+
+bool AAPLKTXFile::parse(const void* data, size_t size, std::string& error)
+{
+    close();
+
+    _data = (const uint8_t*)data;
+    _size = size;
+
+    bool parsed;
+    if (size >= sizeof(KTX1Identifier) && !memcmp(data, KTX1Identifier, sizeof(KTX1Identifier)))
+        parsed = parseKTX1(error);
+    else if (size >= sizeof(KTX2Identifier) && !memcmp(data, KTX2Identifier, sizeof(KTX2Identifier)))
+        parsed = parseKTX2(error);
+    else
+        parsed = fail(error, "Not a KTX file");
+
+    return parsed;
+}
+
+void AAPLKTXFile::close()
+{
+    if (_mapping)
+        munmap(_mapping, _mappingSize);
+
+    _mapping            = nullptr;
+    _mappingSize        = 0;
+    _data               = nullptr;
+    _size               = 0;
+    _format             = nullptr;
+    _version            = 0;
+    _supercompression   = SupercompressionNone;
+    _width              = 0;
+    _height             = 0;
+    _depth              = 0;
+    _layerCount         = 0;
+    _faceCount          = 0;
+    _levelCount         = 0;
+    _isArray            = false;
+    _generatesMipmaps   = false;
+    _keyValues.clear();
+}
+
+AAPLKTXSpan AAPLKTXFile::levelData(uint32_t level) const
+{
+    const Level& l = _levels[level];
+    return { _data + l.offset, (size_t)l.length };
+}
+
+AAPLKTXSpan AAPLKTXFile::image(uint32_t level, uint32_t layer, uint32_t face, uint32_t slice) const
+{
+    if (_supercompression != SupercompressionNone)
+        return {};
+
+    const Level& l = _levels[level];
+    const uint64_t offset = l.offset + (layer * (uint64_t)_faceCount + face) * l.faceStride + slice * l.bytesPerImage;
+    return { _data + offset, (size_t)l.bytesPerImage };
+}
+
+AAPLKTXSpan AAPLKTXFile::value(const char* key) const
+{
+    for (const KeyValue& keyValue : _keyValues)
+    {
+        if (!strcmp(keyValue.key, key))
+            return keyValue.value;
+    }
+    return {};
+}
+
+bool AAPLKTXFile::fail(std::string& error, const char* message)
+{
+    error = message;
+    _format = nullptr;
+    _keyValues.clear();
+    return false;
+}
+
+// Reads the pairs of a key/value block, each a 32-bit length followed by a null terminated
+//  key, the value, and padding to 4 bytes.
+bool AAPLKTXFile::parseKeyValues(size_t offset, size_t length, std::string& error)
+{
+    const uint8_t* data = _data + offset;
+    const uint8_t* end  = data + length;
+
+    while (end - data >= 4)
+    {
+        const uint32_t pairLength = readU32(data);
+        data += 4;
+
+        if (pairLength > (size_t)(end - data))
+            return fail(error, "A key/value pair overruns the key/value data");
+
+        const uint8_t* terminator = (const uint8_t*)memchr(data, 0, pairLength);
+        if (!terminator)
+            return fail(error, "A key isn't null terminated");
+
+        KeyValue keyValue;
+        keyValue.key            = (const char*)data;
+        keyValue.value.data     = terminator + 1;
+        keyValue.value.size     = (size_t)(data + pairLength - keyValue.value.data);
+        _keyValues.push_back(keyValue);
+
+        // The padding of the last pair may extend to the end of the block, but no further.
+        const uint64_t padded = align4(pairLength);
+        if (padded > (size_t)(end - data))
+            break;
+        data += padded;
+    }
+    return true;
+}
+
+// Checks the dimensions of the texture and computes the size of the images of each level.
+bool AAPLKTXFile::setFormat(const AAPLKTXFormat* format, uint32_t width, uint32_t height, uint32_t depth,
+                            uint32_t layerCount, uint32_t faceCount, uint32_t levelCount, std::string& error)
+{
+    if (!format)
+        return fail(error, "Unsupported pixel format");
+
+    height      = std::max(height, 1u);
+    depth       = std::max(depth, 1u);
+    layerCount  = std::max(layerCount, 1u);
+
+    if (width == 0 || width > MaxDimension || height > MaxDimension || depth > MaxDimension)
+        return fail(error, "Invalid texture dimensions");
+
+    if (faceCount != 1 && faceCount != 6)
+        return fail(error, "Invalid face count");
+
+    if (faceCount == 6 && (width != height || depth != 1))
+        return fail(error, "Cube faces must be square and 2D");
+
+    uint32_t maxLevelCount = 1;
+    while ((std::max(width, std::max(height, depth)) >> maxLevelCount) != 0)
+        ++maxLevelCount;
+
+    if (levelCount > maxLevelCount)
+        return fail(error, "More mipmap levels than the dimensions allow");
+
+    // KTX1 aligns rows of uncompressed formats to 4 bytes, as GL_UNPACK_ALIGNMENT does.
+    const bool padRows = _version == 1 && format->blockWidth == 1 && format->blockHeight == 1;
+
+    for (uint32_t i = 0; i < levelCount; ++i)
+    {
+        Level& level = _levels[i];
+
+        level.width         = std::max(width >> i, 1u);
+        level.height        = std::max(height >> i, 1u);
+        level.depth         = std::max(depth >> i, 1u);
+
+        const uint32_t rowBytes = divideRoundUp(level.width, format->blockWidth) * format->bytesPerBlock;
+
+        level.bytesPerRow   = padRows ? (uint32_t)align4(rowBytes) : rowBytes;
+        level.bytesPerImage = (uint64_t)level.bytesPerRow * divideRoundUp(level.height, format->blockHeight);
+        level.faceStride    = level.bytesPerImage * level.depth;
+    }
+
+    _format     = format;
+    _width      = width;
+    _height     = height;
+    _depth      = depth;
+    _layerCount = layerCount;
+    _faceCount  = faceCount;
+    _levelCount = levelCount;
+    return true;
+}
+
+bool AAPLKTXFile::parseKTX1(std::string& error)
+{
+    _version = 1;
+
+    if (_size < KTX1HeaderSize)
+        return fail(error, "Truncated KTX header");
+
+    const uint32_t endianness = readU32(_data + 12);
+    if (endianness != 0x04030201)
+        return fail(error, endianness == 0x01020304 ? "Big endian KTX files aren't supported" : "Invalid KTX endianness");
+
+    const uint32_t glInternalFormat     = readU32(_data + 28);
+    const uint32_t pixelWidth           = readU32(_data + 36);
+    const uint32_t pixelHeight          = readU32(_data + 40);
+    const uint32_t pixelDepth           = readU32(_data + 44);
+    const uint32_t arrayElementCount    = readU32(_data + 48);
+    const uint32_t faceCount            = readU32(_data + 52);
+    const uint32_t mipmapLevelCount     = readU32(_data + 56);
+    const uint32_t keyValueLength       = readU32(_data + 60);
+
+    _isArray            = arrayElementCount != 0;
+    _generatesMipmaps   = mipmapLevelCount == 0;
+
+    if (!setFormat(AAPLKTXFormatForGLInternalFormat(glInternalFormat), pixelWidth, pixelHeight, pixelDepth,
+                   arrayElementCount, faceCount, std::max(mipmapLevelCount, 1u), error))
+        return false;
+
+    if (!inRange(KTX1HeaderSize, keyValueLength, _size))
+        return fail(error, "The key/value data overruns the file");
+
+    if (!parseKeyValues(KTX1HeaderSize, keyValueLength, error))
+        return false;
+
+    // Each level starts with its size in bytes.  The size covers all the images of the level,
+    //  except for cube maps that aren't arrays, where it covers one face and each face is
+    //  padded to 4 bytes.
+    const bool sizePerFace = _faceCount == 6 && !_isArray;
+
+    uint64_t offset = KTX1HeaderSize + keyValueLength;
+
+    for (uint32_t i = 0; i < _levelCount; ++i)
+    {
+        Level& level = _levels[i];
+
+        if (!inRange(offset, 4, _size))
+            return fail(error, "Truncated mipmap level");
+
+        const uint32_t imageSize = readU32(_data + offset);
+        offset += 4;
+
+        uint64_t length;
+        uint64_t next;
+        if (sizePerFace)
+        {
+            if (imageSize < level.faceStride)
+                return fail(error, "A mipmap level is smaller than its images");
+
+            level.faceStride    = align4(imageSize);
+            length              = level.faceStride * 5 + imageSize;
+            next                = offset + level.faceStride * 6;
+        }
+        else
+        {
+            uint64_t imagesLength;
+            if (!multiply(level.faceStride, (uint64_t)_layerCount * _faceCount, imagesLength) || imageSize < imagesLength)
+                return fail(error, "A mipmap level is smaller than its images");
+
+            length              = imageSize;
+            next                = offset + align4(imageSize);
+        }
+
+        if (!inRange(offset, length, _size))
+            return fail(error, "A mipmap level overruns the file");
+
+        level.offset                = offset;
+        level.length                = length;
+        level.uncompressedLength    = length;
+
+        offset = next;
+    }
+
+    return true;
+}
+
+bool AAPLKTXFile::parseKTX2(std::string& error)
+{
+    _version = 2;
+
+    if (_size < KTX2HeaderSize)
+        return fail(error, "Truncated KTX2 header");
+
+    const uint32_t vkFormat             = readU32(_data + 12);
+    const uint32_t pixelWidth           = readU32(_data + 20);
+    const uint32_t pixelHeight          = readU32(_data + 24);
+    const uint32_t pixelDepth           = readU32(_data + 28);
+    const uint32_t layerCount           = readU32(_data + 32);
+    const uint32_t faceCount            = readU32(_data + 36);
+    const uint32_t levelCount           = readU32(_data + 40);
+    const uint32_t supercompression     = readU32(_data + 44);
+
+    const uint32_t dfdOffset            = readU32(_data + 48);
+    const uint32_t dfdLength            = readU32(_data + 52);
+    const uint32_t keyValueOffset       = readU32(_data + 56);
+    const uint32_t keyValueLength       = readU32(_data + 60);
+    const uint64_t sgdOffset            = readU64(_data + 64);
+    const uint64_t sgdLength            = readU64(_data + 72);
+
+    if (supercompression > SupercompressionZlib)
+        return fail(error, "Unknown supercompression scheme");
+
+    if (supercompression == SupercompressionBasisLZ)
+        return fail(error, "BasisLZ supercompression isn't supported");
+
+    _supercompression   = (Supercompression)supercompression;
+    _isArray            = layerCount != 0;
+    _generatesMipmaps   = levelCount == 0;
+
+    if (!setFormat(AAPLKTXFormatForVkFormat(vkFormat), pixelWidth, pixelHeight, pixelDepth,
+                   layerCount, faceCount, std::max(levelCount, 1u), error))
+        return false;
+
+    if (!inRange(dfdOffset, dfdLength, _size) ||
+        !inRange(keyValueOffset, keyValueLength, _size) ||
+        !inRange(sgdOffset, sgdLength, _size))
+        return fail(error, "A data block overruns the file");
+
+    if (!inRange(KTX2HeaderSize, (uint64_t)_levelCount * KTX2LevelIndexSize, _size))
+        return fail(error, "Truncated level index");
+
+    if (!parseKeyValues(keyValueOffset, keyValueLength, error))
+        return false;
+
+    for (uint32_t i = 0; i < _levelCount; ++i)
+    {
+        Level& level = _levels[i];
+        const uint8_t* entry = _data + KTX2HeaderSize + i * KTX2LevelIndexSize;
+
+        level.offset                = readU64(entry);
+        level.length                = readU64(entry + 8);
+        level.uncompressedLength    = readU64(entry + 16);
+
+        if (!inRange(level.offset, level.length, _size))
+            return fail(error, "A mipmap level overruns the file");
+
+        uint64_t imagesLength;
+        if (!multiply(level.faceStride, (uint64_t)_layerCount * _faceCount, imagesLength))
+            return fail(error, "A mipmap level is smaller than its images");
+
+        if (_supercompression == SupercompressionNone)
+        {
+            if (level.length < imagesLength)
+                return fail(error, "A mipmap level is smaller than its images");
+            level.uncompressedLength = level.length;
+        }
+        else if (level.uncompressedLength != imagesLength)
+        {
+            return fail(error, "The uncompressed length of a mipmap level doesn't match its images");
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+AAPLKTXLevelDecoder::~AAPLKTXLevelDecoder()
+{
+    end();
+}
+
+bool AAPLKTXLevelDecoder::begin(const AAPLKTXFile& file, uint32_t level, std::string& error)
+{
+    end();
+
+    if (!file.isOpen() || level >= file.levelCount())
+    {
+        error = "Invalid mipmap level";
+        return false;
+    }
+
+    _scheme     = file.supercompression();
+    _input      = file.levelData(level);
+    _consumed   = 0;
+    _remaining  = file.level(level).uncompressedLength;
+
+    switch (_scheme)
+    {
+        case AAPLKTXFile::SupercompressionNone:
+            return true;
+
+        case AAPLKTXFile::SupercompressionZlib:
+        {
+#if defined(__APPLE__)
+            // libcompression decodes raw deflate, without the 2 byte header of a zlib stream.
+            if (_input.size < 2 || (_input.data[0] & 0x0F) != 8 || (_input.data[1] & 0x20) ||
+                ((_input.data[0] << 8) | _input.data[1]) % 31)
+            {
+                error = "Invalid zlib stream";
+                return false;
+            }
+            _consumed = 2;
+
+            compression_stream* stream = new compression_stream;
+            if (compression_stream_init(stream, COMPRESSION_STREAM_DECODE, COMPRESSION_ZLIB) != COMPRESSION_STATUS_OK)
+            {
+                delete stream;
+                error = "Couldn't create a zlib decoder";
+                return false;
+            }
+            _stream = stream;
+            return true;
+#elif AAPL_HAS_ZLIB
+            z_stream* stream = new z_stream();
+            if (inflateInit(stream) != Z_OK)
+            {
+                delete stream;
+                error = "Couldn't create a zlib decoder";
+                return false;
+            }
+            _stream = stream;
+            return true;
+#else
+            error = "This build can't decode zlib supercompression";
+            return false;
+#endif
+        }
+
+        case AAPLKTXFile::SupercompressionZstd:
+        {
+#if AAPL_HAS_ZSTD
+            ZSTD_DStream* stream = ZSTD_createDStream();
+            if (!stream || ZSTD_isError(ZSTD_initDStream(stream)))
+            {
+                ZSTD_freeDStream(stream);
+                error = "Couldn't create a Zstd decoder";
+                return false;
+            }
+            _stream = stream;
+            return true;
+#else
+            error = "This build can't decode Zstd supercompression";
+            return false;
+#endif
+        }
+
+        default:
+            error = "Unsupported supercompression scheme";
+            return false;
+    }
+}
+
+bool AAPLKTXLevelDecoder::decode(void* destination, size_t capacity, size_t& written, std::string& error)
+{
+    written = 0;
+
+    const size_t wanted = (size_t)std::min<uint64_t>(capacity, _remaining);
+    if (wanted == 0)
+        return true;
+
+    uint8_t* output = (uint8_t*)destination;
+
+    switch (_scheme)
+    {
+        case AAPLKTXFile::SupercompressionNone:
+        {
+            memcpy(output, _input.data + _consumed, wanted);
+            _consumed   += wanted;
+            written     = wanted;
+            break;
+        }
+
+        case AAPLKTXFile::SupercompressionZlib:
+        {
+#if defined(__APPLE__)
+            compression_stream* stream = (compression_stream*)_stream;
+            stream->dst_ptr     = output;
+            stream->dst_size    = wanted;
+            stream->src_ptr     = _input.data + _consumed;
+            stream->src_size    = _input.size - _consumed;
+
+            while (stream->dst_size != 0)
+            {
+                const size_t input  = stream->src_size;
+                const size_t space  = stream->dst_size;
+
+                const compression_status status = compression_stream_process(stream, stream->src_size ? 0 : COMPRESSION_STREAM_FINALIZE);
+                if (status == COMPRESSION_STATUS_ERROR || (status == COMPRESSION_STATUS_END && stream->dst_size != 0) ||
+                    (stream->src_size == input && stream->dst_size == space))
+                {
+                    error = "Corrupt or truncated zlib stream";
+                    return false;
+                }
+            }
+
+            _consumed   = _input.size - stream->src_size;
+            written     = wanted;
+#elif AAPL_HAS_ZLIB
+            z_stream* stream = (z_stream*)_stream;
+            while (written < wanted)
+            {
+                // zlib counts bytes in 32 bits.
+                const size_t input  = std::min<size_t>(_input.size - _consumed, UINT32_MAX);
+                const size_t space  = std::min<size_t>(wanted - written, UINT32_MAX);
+
+                stream->next_in     = (Bytef*)(_input.data + _consumed);
+                stream->avail_in    = (uInt)input;
+                stream->next_out    = output + written;
+                stream->avail_out   = (uInt)space;
+
+                const int status = inflate(stream, Z_NO_FLUSH);
+
+                const size_t consumed   = input - stream->avail_in;
+                const size_t produced   = space - stream->avail_out;
+                _consumed   += consumed;
+                written     += produced;
+
+                if ((status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) ||
+                    (status == Z_STREAM_END && written < wanted) ||
+                    (consumed == 0 && produced == 0))
+                {
+                    error = "Corrupt or truncated zlib stream";
+                    return false;
+                }
+            }
+#endif
+            break;
+        }
+
+        case AAPLKTXFile::SupercompressionZstd:
+        {
+#if AAPL_HAS_ZSTD
+            ZSTD_outBuffer out  = { output, wanted, 0 };
+            ZSTD_inBuffer in    = { _input.data, _input.size, _consumed };
+
+            while (out.pos < out.size)
+            {
+                const size_t inputPosition  = in.pos;
+                const size_t outputPosition = out.pos;
+
+                const size_t status = ZSTD_decompressStream((ZSTD_DStream*)_stream, &out, &in);
+                if (ZSTD_isError(status) || (in.pos == inputPosition && out.pos == outputPosition))
+                {
+                    error = "Corrupt or truncated Zstd stream";
+                    return false;
+                }
+            }
+
+            _consumed   = in.pos;
+            written     = out.pos;
+#endif
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    _remaining -= written;
+    if (_remaining == 0)
+        end();
+    return true;
+}
+
+void AAPLKTXLevelDecoder::end()
+{
+    if (_stream)
+    {
+#if defined(__APPLE__)
+        if (_scheme == AAPLKTXFile::SupercompressionZlib)
+        {
+            compression_stream_destroy((compression_stream*)_stream);
+            delete (compression_stream*)_stream;
+        }
+#elif AAPL_HAS_ZLIB
+        if (_scheme == AAPLKTXFile::SupercompressionZlib)
+        {
+            inflateEnd((z_stream*)_stream);
+            delete (z_stream*)_stream;
+        }
+#endif
+#if AAPL_HAS_ZSTD
+        if (_scheme == AAPLKTXFile::SupercompressionZstd)
+            ZSTD_freeDStream((ZSTD_DStream*)_stream);
+#endif
+        _stream = nullptr;
+    }
+}
+
+bool AAPLKTXDecodeLevel(const AAPLKTXFile& file, uint32_t level, void* destination, size_t size, std::string& error)
+{
+    AAPLKTXLevelDecoder decoder;
+    if (!decoder.begin(file, level, error))
+        return false;
+
+    if (size < decoder.remaining())
+    {
+        error = "The destination is smaller than the mipmap level";
+        return false;
+    }
+
+    size_t written;
+    return decoder.decode(destination, size, written, error);
+}
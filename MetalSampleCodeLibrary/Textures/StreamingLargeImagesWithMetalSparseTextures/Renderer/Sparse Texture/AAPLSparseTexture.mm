@@ -9,7 +9,8 @@ The implementation of the class that streams a sparse texture.
 #import "AAPLStreamedTextureDataBacking.h"
 #import "AAPLConfig.h"
 #import "AAPLShaderTypes.h"
-#import "AAPLPointerLRUCache.h"
+#import "AAPLIndexLRUCache.h"
+#import "AAPLTiledTextureFile.h"
 
 #import <vector>
 #import <map>
@@ -116,9 +117,12 @@ struct TextureTile
     
     // This is the KTX data backing that utilizes `mmap`.
     AAPLStreamedTextureDataBacking* _sparseTextureBacking;
+    // The tiled copy of the KTX file, if there is one, which streams each tile with one read.
+    AAPLTiledTextureFile _tiledTextureFile;
     
-    // LRU cache that holds the texture tile pointer data for tiles that are mapped but aren't sampled by the GPU.
-    AAPLPointerLRUCache<TextureTile*> _notUsedMappedTilesLRUCache;
+    // LRU cache that holds the slots of tiles that are mapped but aren't sampled by the GPU.
+    // Tiles the GPU samples again leave the cache.
+    AAPLIndexLRUCache _notUsedMappedTilesLRUCache;
     
     // The size of one sparse texture tile in bytes.
     NSUInteger              _sparseTileSizeInBytes;
@@ -138,6 +142,8 @@ struct TextureTile
     
     // Holds all the texture tile data for each mipmap level.
     std::vector<std::vector<TextureTile>> _tiles;
+    // Holds the slot of the first tile of each mipmap level; slots number the tiles of all levels.
+    std::vector<uint32_t> _tileSlotOffsets;
     // This vector represents how many parent tiles reference each tile of sparse texture.
     // It only applies for mipmap index one to mipmap firstMipmapTail - 1.
     std::vector<std::vector<NSUInteger>> _countRefParentTiles;
@@ -172,6 +178,7 @@ struct TextureTile
         [self createHeaps:heapSize];
         [self mapMipmapTails];
         [self blitMipmapTails];
+        [self openTiledTextureFile:path];
         [self createAccessCountersBuffer];
         [self updateResidencyBuffer];
     }
@@ -194,6 +201,21 @@ struct TextureTile
     return output;
 }
 
+/// Returns the slot that identifies the tile in the LRU cache.
+- (uint32_t)slotForTile:(const TextureTile*)tile
+{
+    return _tileSlotOffsets[tile->origin.z] + (uint32_t)calculateIndexFromTileOrigin(tile->origin, _sizeInTiles);
+}
+
+/// Returns the tile that the slot identifies.
+- (TextureTile*)tileForSlot:(uint32_t)slot
+{
+    NSUInteger mipmap = 0;
+    while (mipmap + 1 < _tileSlotOffsets.size() && slot >= _tileSlotOffsets[mipmap + 1])
+        ++mipmap;
+    return &_tiles[mipmap][slot - _tileSlotOffsets[mipmap]];
+}
+
 /// Update residency data so that it always reflects the finest available mipmap region.
 - (void)setTextureTileRegionFinestMipmap:(MTLOrigin)tileOrigin
                                newMipmap:(NSUInteger)newMipmap
@@ -321,15 +343,9 @@ struct TextureTile
     _unmapTilesRequest.push_back(tile);
 }
 
-/// Create a shared temporary buffer to stage a buffer copy later.
-/// The main functionality is to copy texture data from main memory to shared temp buffer.
-- (id<MTLBuffer>)streamTileToStagingBuffer:(TextureTile*)tile
+/// Copy the texture data of a tile from the memory-mapped KTX file to a shared temporary buffer.
+- (void)copyTileFromBacking:(TextureTile*)tile toStagingBuffer:(id<MTLBuffer>)tempBuffer
 {
-    id<MTLBuffer> tempBuffer = [_stagingBuffersHeap newBufferWithLength:_sparseTileSizeInBytes options:MTLResourceStorageModeShared];
-    
-    // The class checks for enough buffers in the heap in `newMapTileRequest` so this is an extra check.
-    assert(tempBuffer != nil);
-    
     // Block compressed formats require knowledge of the size of the block and bytes per block.
     // The data backing class stores this information in two properties.
     @autoreleasepool
@@ -346,8 +362,47 @@ struct TextureTile
                                    _tileSize,
                                    _sparseTextureBacking.blockSize);
     }
-    
-    return tempBuffer;
+}
+
+/// Create a shared temporary buffer for each tile to stage a buffer copy later, and stream the tiles into them.
+/// With a tiled texture file, the tiles of the whole request list are read together, so that tiles next to each
+/// other in the file take a single read. Otherwise, each tile is copied row by row from the memory-mapped KTX file.
+- (std::vector<id<MTLBuffer>>)streamTilesToStagingBuffers:(const std::vector<TextureTile*>&)tiles
+{
+    std::vector<id<MTLBuffer>> tempBuffers;
+    std::vector<AAPLTiledTextureFile::Request> readRequests;
+    tempBuffers.reserve(tiles.size());
+    readRequests.reserve(tiles.size());
+
+    for (TextureTile* tile : tiles)
+    {
+        id<MTLBuffer> tempBuffer = [_stagingBuffersHeap newBufferWithLength:_sparseTileSizeInBytes options:MTLResourceStorageModeShared];
+
+        // The class checks for enough buffers in the heap in `newMapTileRequest` so this is an extra check.
+        assert(tempBuffer != nil);
+
+        tempBuffers.push_back(tempBuffer);
+        readRequests.push_back({ (uint32_t)tile->origin.z, (uint32_t)tile->origin.x, (uint32_t)tile->origin.y, tempBuffer.contents });
+    }
+
+    if (_tiledTextureFile.isOpen())
+    {
+        std::string error;
+        if (_tiledTextureFile.readTiles(readRequests.data(), readRequests.size(), error))
+        {
+            return tempBuffers;
+        }
+
+        // Stream from the memory-mapped KTX file from now on.
+        NSLog(@"%s", error.c_str());
+        _tiledTextureFile.close();
+    }
+
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+        [self copyTileFromBacking:tiles[i] toStagingBuffer:tempBuffers[i]];
+    }
+    return tempBuffers;
 }
 
 #pragma mark - Update methods
@@ -431,7 +486,7 @@ struct TextureTile
                     // re-map the tile from the LRU cache.
                     if (iterTile->state == TileState::TileStateStoredInLRUCache)
                     {
-                        _notUsedMappedTilesLRUCache.discard(iterTile);
+                        _notUsedMappedTilesLRUCache.touch([self slotForTile:iterTile]);
                         iterTile->state = TileState::TileStateMapped;
                         [self setTextureTileRefCounterParent:iterTile higherMipmapQuality:YES];
                     }
@@ -455,7 +510,7 @@ struct TextureTile
                 if (tile->framesCount <= 0)
                 {
                     tile->state = TileState::TileStateStoredInLRUCache;
-                    _notUsedMappedTilesLRUCache.put(tile);
+                    _notUsedMappedTilesLRUCache.put([self slotForTile:tile]);
                     [self setTextureTileRefCounterParent:tile higherMipmapQuality:NO];
                 }
             }
@@ -473,11 +528,13 @@ struct TextureTile
     NSUInteger index = 0;
     for (; index < _numTilesToDiscardFromLRU; ++index)
     {
-        TextureTile* tile = _notUsedMappedTilesLRUCache.discardLeastRecentlyUsed();
-        if (!tile)
+        uint32_t slot = _notUsedMappedTilesLRUCache.discardLeastRecentlyUsed();
+        if (slot == AAPLIndexLRUCache::InvalidSlot)
         {
             break;
         }
+        TextureTile* tile = [self tileForSlot:slot];
+        assert(tile->state == TileState::TileStateStoredInLRUCache);
         [self newUnmapTileRequest:tile];
     }
     
@@ -540,9 +597,11 @@ struct TextureTile
         blitEncoder.label = @"Tile mapping blit encoder";
 
         // Stream the tiles from the source texture file into the sparse texture heap tiles.
-        for (const auto& tile: mapTilesRequest)
+        std::vector<id<MTLBuffer>> tempStreamingBuffers = [self streamTilesToStagingBuffers:mapTilesRequest];
+        for (size_t i = 0; i < mapTilesRequest.size(); ++i)
         {
-            id<MTLBuffer> tempStreamingBuffer = [self streamTileToStagingBuffer:tile];
+            const TextureTile* tile           = mapTilesRequest[i];
+            id<MTLBuffer> tempStreamingBuffer = tempStreamingBuffers[i];
             
             // `blocksWide` holds the number of blocks of compressed pixels spanning the width of the tile.
             NSUInteger blocksWide       = calculateBlocksWidth(_tileSize.width, _sparseTextureBacking.blockSize, 0);
@@ -637,6 +696,39 @@ struct TextureTile
     }
 }
 
+/// Open the tiled copy of the KTX file, which has the same name with the `tiles` extension.
+/// The sample streams from the memory-mapped KTX file instead when there's no such file, or when its
+/// tiles don't match the sparse texture tiles of the device.
+- (void)openTiledTextureFile:(NSURL*)path
+{
+    NSURL* tiledPath = [[path URLByDeletingPathExtension] URLByAppendingPathExtension:@"tiles"];
+    if ([tiledPath checkResourceIsReachableAndReturnError:nil] == NO)
+    {
+        return;
+    }
+
+    std::string error;
+    if (!_tiledTextureFile.open(tiledPath.fileSystemRepresentation, error))
+    {
+        NSLog(@"Couldn't load '%@': %s", tiledPath, error.c_str());
+        return;
+    }
+
+    const AAPLKTXFormat& format = _tiledTextureFile.format();
+    if (_tiledTextureFile.width() != _sparseTextureBacking.width ||
+        _tiledTextureFile.height() != _sparseTextureBacking.height ||
+        _tiledTextureFile.levelCount() < _sparseTexture.firstMipmapInTail ||
+        _tiledTextureFile.tileWidth() != _tileSize.width ||
+        _tiledTextureFile.tileHeight() != _tileSize.height ||
+        _tiledTextureFile.tileLength() > _sparseTileSizeInBytes ||
+        format.blockWidth != _sparseTextureBacking.blockSize ||
+        format.bytesPerBlock != _sparseTextureBacking.bytesPerBlock)
+    {
+        NSLog(@"The tiles of '%@' don't match the sparse texture tiles", tiledPath);
+        _tiledTextureFile.close();
+    }
+}
+
 /// Map the minimum mipmap level (the first mipmap tail level) for the sparse texture.
 - (void)mapMipmapTails
 {
@@ -717,6 +809,7 @@ struct TextureTile
             _countRefParentTiles.push_back(std::vector<NSUInteger>(totalW * totalH, 0));
         }
         _tiles.push_back(std::vector<TextureTile>(totalW * totalH));
+        _tileSlotOffsets.push_back(mipmap > 0 ? _tileSlotOffsets[mipmap - 1] + (uint32_t)_tiles[mipmap - 1].size() : 0);
         NSUInteger tileIndex = 0;
         for (NSUInteger h = 0; h < totalH; ++h)
         {
@@ -730,6 +823,10 @@ struct TextureTile
         }
     }
     
+    // Create the LRU cache with a slot for every tile, so that it never allocates memory after this.
+    uint32_t tileCount = _tileSlotOffsets.empty() ? 0 : _tileSlotOffsets.back() + (uint32_t)_tiles.back().size();
+    _notUsedMappedTilesLRUCache.reset(tileCount, (AAPLCachePolicy)TILE_CACHE_POLICY);
+    
     // Create an array to store the finest mipmap level for each tile.
     // Initially, it contains the level of the first mipmap in the tail.
     // This number will go up and down as the app maps and unmaps tiles.
@@ -0,0 +1,539 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Implementation of the tiled texture file reader and converter.
+*/
+#include "AAPLTiledTextureFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace
+{
+
+static const uint8_t  Identifier[8]     = { 0xAB, 'T', 'I', 'L', 'E', 'S', 0xBB, 0x0A };
+static const uint32_t Version           = 1;
+static const size_t   HeaderSize        = 64;
+static const size_t   LevelEntrySize    = 12;
+
+// Largest alignment of tiles the reader accepts, which bounds the padding it reads into.
+static const uint32_t MaxAlignment      = 1u << 20;
+
+// Vectors per `preadv`, within the limit of every platform.
+#ifdef IOV_MAX
+static const size_t   MaxVectorCount    = IOV_MAX < 1024 ? IOV_MAX : 1024;
+#else
+static const size_t   MaxVectorCount    = 1024;
+#endif
+
+inline uint32_t readU32(const uint8_t* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint64_t readU64(const uint8_t* data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline void writeU32(uint8_t* data, uint32_t value)
+{
+    memcpy(data, &value, sizeof(value));
+}
+
+inline void writeU64(uint8_t* data, uint64_t value)
+{
+    memcpy(data, &value, sizeof(value));
+}
+
+inline uint32_t divideRoundUp(uint32_t value, uint32_t divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+inline bool isPowerOfTwo(uint32_t value)
+{
+    return value && !(value & (value - 1));
+}
+
+// Interleaves the bits of x and y, so that sorting by the code walks a Z-order curve.
+inline uint32_t mortonCode(uint32_t x, uint32_t y)
+{
+    auto spread = [](uint32_t v)
+    {
+        v &= 0xFFFF;
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+// Tile counts of each level of a texture.
+void tileGrid(uint32_t width, uint32_t height, uint32_t levelCount, uint32_t tileWidth, uint32_t tileHeight,
+              uint32_t* tilesWide, uint32_t* tilesHigh)
+{
+    for (uint32_t level = 0; level < levelCount; ++level)
+    {
+        tilesWide[level] = divideRoundUp(std::max(width >> level, 1u), tileWidth);
+        tilesHigh[level] = divideRoundUp(std::max(height >> level, 1u), tileHeight);
+    }
+}
+
+// Reads all the bytes the vectors describe, continuing after short reads.
+bool readFully(int fd, struct iovec* vectors, size_t vectorCount, uint64_t offset, uint64_t& readCount)
+{
+    while (vectorCount)
+    {
+        const ssize_t result = preadv(fd, vectors, (int)vectorCount, (off_t)offset);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return false;
+
+        ++readCount;
+        offset += (uint64_t)result;
+
+        size_t remaining = (size_t)result;
+        while (vectorCount && remaining >= vectors->iov_len)
+        {
+            remaining -= vectors->iov_len;
+            ++vectors;
+            --vectorCount;
+        }
+        if (vectorCount)
+        {
+            vectors->iov_base = (uint8_t*)vectors->iov_base + remaining;
+            vectors->iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+bool writeFully(FILE* file, const void* data, size_t size)
+{
+    return fwrite(data, 1, size, file) == size;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+AAPLTiledTextureFile::~AAPLTiledTextureFile()
+{
+    close();
+}
+
+bool AAPLTiledTextureFile::open(const char* path, std::string& error)
+{
+    close();
+
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        error = std::string("Couldn't open ") + path;
+        return false;
+    }
+
+    auto fail = [&](const char* message)
+    {
+        ::close(fd);
+        _levels.clear();
+        _tileOffsets.clear();
+        error = std::string(path) + ": " + message;
+        return false;
+    };
+
+    struct stat fileInfo;
+    uint8_t header[HeaderSize];
+    if (fstat(fd, &fileInfo) != 0 || pread(fd, header, HeaderSize, 0) != (ssize_t)HeaderSize)
+        return fail("Couldn't read the header");
+
+    if (memcmp(header, Identifier, sizeof(Identifier)) || readU32(header + 8) != Version)
+        return fail("Not a tiled texture file");
+
+    const uint64_t fileSize     = (uint64_t)fileInfo.st_size;
+    const uint32_t vkFormat     = readU32(header + 12);
+    const uint32_t width        = readU32(header + 16);
+    const uint32_t height       = readU32(header + 20);
+    const uint32_t levelCount   = readU32(header + 24);
+    const uint32_t tileWidth    = readU32(header + 28);
+    const uint32_t tileHeight   = readU32(header + 32);
+    const uint32_t tileLength   = readU32(header + 36);
+    const uint32_t alignment    = readU32(header + 40);
+    const uint32_t tileCount    = readU32(header + 44);
+    const uint64_t indexOffset  = readU64(header + 48);
+    const uint64_t dataOffset   = readU64(header + 56);
+
+    const AAPLKTXFormat* format = AAPLKTXFormatForVkFormat(vkFormat);
+    if (!format)
+        return fail("Unsupported pixel format");
+
+    if (width == 0 || height == 0 || width > AAPLKTXFile::MaxDimension || height > AAPLKTXFile::MaxDimension)
+        return fail("Invalid texture size");
+
+    const uint32_t fullLevelCount = 32 - __builtin_clz(std::max(width, height));
+    if (levelCount == 0 || levelCount > fullLevelCount)
+        return fail("Invalid mipmap level count");
+
+    if (tileWidth == 0 || tileHeight == 0 || tileWidth > AAPLKTXFile::MaxDimension || tileHeight > AAPLKTXFile::MaxDimension ||
+        tileWidth % format->blockWidth || tileHeight % format->blockHeight ||
+        tileLength != (uint64_t)(tileWidth / format->blockWidth) * (tileHeight / format->blockHeight) * format->bytesPerBlock)
+        return fail("Invalid tile size");
+
+    if (!isPowerOfTwo(alignment) || alignment > MaxAlignment)
+        return fail("Invalid tile alignment");
+
+    // Check that the level table matches the texture, and that the index and tiles lie in the file.
+    uint32_t tilesWide[AAPLKTXFile::MaxLevelCount];
+    uint32_t tilesHigh[AAPLKTXFile::MaxLevelCount];
+    tileGrid(width, height, levelCount, tileWidth, tileHeight, tilesWide, tilesHigh);
+
+    std::vector<uint8_t> levelTable(levelCount * LevelEntrySize);
+    if (indexOffset != HeaderSize + levelTable.size() ||
+        pread(fd, levelTable.data(), levelTable.size(), HeaderSize) != (ssize_t)levelTable.size())
+        return fail("Couldn't read the level table");
+
+    uint32_t firstTile = 0;
+    for (uint32_t level = 0; level < levelCount; ++level)
+    {
+        const uint8_t* entry = levelTable.data() + level * LevelEntrySize;
+        const Level l = { readU32(entry), readU32(entry + 4), readU32(entry + 8) };
+        if (l.tilesWide != tilesWide[level] || l.tilesHigh != tilesHigh[level] || l.firstTile != firstTile)
+            return fail("Invalid level table");
+
+        _levels.push_back(l);
+        firstTile += l.tilesWide * l.tilesHigh;
+    }
+
+    if (tileCount != firstTile)
+        return fail("Invalid tile count");
+
+    _tileOffsets.resize(tileCount);
+    const size_t indexSize = tileCount * sizeof(uint64_t);
+    if (pread(fd, _tileOffsets.data(), indexSize, (off_t)indexOffset) != (ssize_t)indexSize)
+        return fail("Couldn't read the tile index");
+
+    if (dataOffset < indexOffset + indexSize || dataOffset > fileSize)
+        return fail("Invalid tile data offset");
+
+    for (uint64_t offset : _tileOffsets)
+    {
+        if (offset < dataOffset || offset % alignment || tileLength > fileSize - std::min(offset, fileSize))
+            return fail("Tile outside the file");
+    }
+
+    _fd         = fd;
+    _format     = format;
+    _width      = width;
+    _height     = height;
+    _tileWidth  = tileWidth;
+    _tileHeight = tileHeight;
+    _tileLength = tileLength;
+    _tileStride = (uint32_t)alignUp(tileLength, alignment);
+    _padding.resize(_tileStride - tileLength);
+    return true;
+}
+
+void AAPLTiledTextureFile::close()
+{
+    if (_fd >= 0)
+        ::close(_fd);
+
+    _fd         = -1;
+    _format     = nullptr;
+    _width      = 0;
+    _height     = 0;
+    _tileWidth  = 0;
+    _tileHeight = 0;
+    _tileLength = 0;
+    _tileStride = 0;
+    _levels.clear();
+    _tileOffsets.clear();
+    _padding.clear();
+}
+
+uint64_t AAPLTiledTextureFile::tileOffset(uint32_t level, uint32_t x, uint32_t y) const
+{
+    const Level& l = _levels[level];
+    return _tileOffsets[l.firstTile + y * l.tilesWide + x];
+}
+
+bool AAPLTiledTextureFile::readTiles(Request* requests, size_t count, std::string& error, ReadStats* stats)
+{
+    if (!isOpen())
+    {
+        error = "The tiled texture file isn't open";
+        return false;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Request& request = requests[i];
+        if (request.level >= _levels.size() ||
+            request.x >= _levels[request.level].tilesWide ||
+            request.y >= _levels[request.level].tilesHigh ||
+            !request.destination)
+        {
+            error = "Invalid tile request";
+            return false;
+        }
+    }
+
+    std::sort(requests, requests + count, [this](const Request& a, const Request& b)
+    {
+        return tileOffset(a.level, a.x, a.y) < tileOffset(b.level, b.x, b.y);
+    });
+
+    // Gather runs of tiles that follow each other in the file into one read, with the padding
+    //  between them going to a scratch buffer.
+    struct iovec vectors[MaxVectorCount];
+    uint64_t readCount = 0;
+    uint64_t byteCount = 0;
+
+    size_t first = 0;
+    while (first < count)
+    {
+        const uint64_t runOffset = tileOffset(requests[first].level, requests[first].x, requests[first].y);
+        uint64_t       nextOffset = runOffset;
+        size_t         vectorCount = 0;
+        size_t         last = first;
+
+        while (last < count && vectorCount + 2 <= MaxVectorCount)
+        {
+            const Request& request = requests[last];
+            const uint64_t offset = tileOffset(request.level, request.x, request.y);
+            // A tile requested twice starts a run of its own.
+            if (offset != nextOffset)
+                break;
+
+            if (last != first && !_padding.empty())
+                vectors[vectorCount++] = { _padding.data(), _padding.size() };
+            vectors[vectorCount++] = { request.destination, _tileLength };
+
+            nextOffset = offset + _tileStride;
+            ++last;
+        }
+
+        byteCount += (last - first) * (uint64_t)_tileStride - (_tileStride - _tileLength);
+        if (!readFully(_fd, vectors, vectorCount, runOffset, readCount))
+        {
+            error = std::string("Couldn't read tiles: ") + strerror(errno);
+            return false;
+        }
+
+        first = last;
+    }
+
+    if (stats)
+    {
+        stats->tileCount += count;
+        stats->readCount += readCount;
+        stats->byteCount += byteCount;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool AAPLWriteTiledTextureFile(const AAPLKTXFile& ktx, const char* path,
+                               uint32_t tileWidth, uint32_t tileHeight, std::string& error,
+                               uint32_t alignment)
+{
+    if (!ktx.isOpen())
+    {
+        error = "The KTX file isn't open";
+        return false;
+    }
+
+    if (ktx.isArray() || ktx.isCube() || ktx.depth() > 1)
+    {
+        error = "Only 2D textures can be tiled";
+        return false;
+    }
+
+    const AAPLKTXFormat& format = ktx.format();
+    if (tileWidth == 0 || tileHeight == 0 || tileWidth % format.blockWidth || tileHeight % format.blockHeight ||
+        tileWidth > AAPLKTXFile::MaxDimension || tileHeight > AAPLKTXFile::MaxDimension)
+    {
+        error = "The tile size isn't a multiple of the block size";
+        return false;
+    }
+
+    if (!isPowerOfTwo(alignment) || alignment > MaxAlignment)
+    {
+        error = "The alignment isn't a power of two";
+        return false;
+    }
+
+    const uint32_t levelCount       = ktx.levelCount();
+    const uint32_t tileBlocksWide   = tileWidth / format.blockWidth;
+    const uint32_t tileBlocksHigh   = tileHeight / format.blockHeight;
+    const uint32_t tileBytesPerRow  = tileBlocksWide * format.bytesPerBlock;
+    const uint64_t tileLength       = (uint64_t)tileBytesPerRow * tileBlocksHigh;
+    const uint64_t tileStride       = alignUp(tileLength, alignment);
+    if (tileLength > UINT32_MAX)
+    {
+        error = "The tiles are too large";
+        return false;
+    }
+
+    uint32_t tilesWide[AAPLKTXFile::MaxLevelCount];
+    uint32_t tilesHigh[AAPLKTXFile::MaxLevelCount];
+    uint32_t firstTile[AAPLKTXFile::MaxLevelCount];
+    tileGrid(ktx.width(), ktx.height(), levelCount, tileWidth, tileHeight, tilesWide, tilesHigh);
+
+    uint32_t tileCount = 0;
+    for (uint32_t level = 0; level < levelCount; ++level)
+    {
+        firstTile[level] = tileCount;
+        tileCount += tilesWide[level] * tilesHigh[level];
+    }
+
+    // Lay out the tiles with the coarsest level first, and along a Morton curve within a level.
+    struct Tile
+    {
+        uint32_t    level;
+        uint32_t    x;
+        uint32_t    y;
+        uint32_t    code;
+    };
+    std::vector<Tile> order;
+    order.reserve(tileCount);
+    for (uint32_t level = levelCount; level-- > 0;)
+    {
+        const size_t levelStart = order.size();
+        for (uint32_t y = 0; y < tilesHigh[level]; ++y)
+        {
+            for (uint32_t x = 0; x < tilesWide[level]; ++x)
+                order.push_back({ level, x, y, mortonCode(x, y) });
+        }
+        std::sort(order.begin() + levelStart, order.end(), [](const Tile& a, const Tile& b) { return a.code < b.code; });
+    }
+
+    const uint64_t indexOffset  = HeaderSize + levelCount * LevelEntrySize;
+    const uint64_t dataOffset   = alignUp(indexOffset + tileCount * sizeof(uint64_t), alignment);
+
+    std::vector<uint8_t> table(dataOffset, 0);
+    memcpy(table.data(), Identifier, sizeof(Identifier));
+    writeU32(table.data() + 8,  Version);
+    writeU32(table.data() + 12, format.vkFormat);
+    writeU32(table.data() + 16, ktx.width());
+    writeU32(table.data() + 20, ktx.height());
+    writeU32(table.data() + 24, levelCount);
+    writeU32(table.data() + 28, tileWidth);
+    writeU32(table.data() + 32, tileHeight);
+    writeU32(table.data() + 36, (uint32_t)tileLength);
+    writeU32(table.data() + 40, alignment);
+    writeU32(table.data() + 44, tileCount);
+    writeU64(table.data() + 48, indexOffset);
+    writeU64(table.data() + 56, dataOffset);
+
+    for (uint32_t level = 0; level < levelCount; ++level)
+    {
+        uint8_t* entry = table.data() + HeaderSize + level * LevelEntrySize;
+        writeU32(entry,     tilesWide[level]);
+        writeU32(entry + 4, tilesHigh[level]);
+        writeU32(entry + 8, firstTile[level]);
+    }
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const Tile& tile = order[i];
+        const uint32_t index = firstTile[tile.level] + tile.y * tilesWide[tile.level] + tile.x;
+        writeU64(table.data() + indexOffset + index * sizeof(uint64_t), dataOffset + i * tileStride);
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        error = std::string("Couldn't create ") + path;
+        return false;
+    }
+
+    auto fail = [&](const std::string& message)
+    {
+        fclose(file);
+        remove(path);
+        error = message;
+        return false;
+    };
+
+    if (!writeFully(file, table.data(), table.size()))
+        return fail(std::string("Couldn't write ") + path);
+
+    std::vector<uint8_t> tileData(tileStride);
+    std::vector<uint8_t> decoded;
+    const uint8_t* levelData = nullptr;
+    uint32_t currentLevel = UINT32_MAX;
+
+    for (const Tile& tile : order)
+    {
+        const AAPLKTXFile::Level& level = ktx.level(tile.level);
+
+        // Tiles are ordered by level, so each level is decoded once.
+        if (tile.level != currentLevel)
+        {
+            currentLevel = tile.level;
+            if (ktx.supercompression() == AAPLKTXFile::SupercompressionNone)
+            {
+                levelData = ktx.image(tile.level, 0, 0).data;
+            }
+            else
+            {
+                std::string decodeError;
+                decoded.resize(level.uncompressedLength);
+                if (!AAPLKTXDecodeLevel(ktx, tile.level, decoded.data(), decoded.size(), decodeError))
+                    return fail(decodeError);
+                levelData = decoded.data();
+            }
+        }
+
+        // Copy the blocks of the tile that lie within the level, leaving the rest zero.
+        const uint32_t levelBlocksWide  = divideRoundUp(level.width, format.blockWidth);
+        const uint32_t levelBlocksHigh  = divideRoundUp(level.height, format.blockHeight);
+        const uint32_t blockX           = tile.x * tileBlocksWide;
+        const uint32_t blockY           = tile.y * tileBlocksHigh;
+        const uint32_t copyBlocksWide   = std::min(tileBlocksWide, levelBlocksWide - blockX);
+        const uint32_t copyBlocksHigh   = std::min(tileBlocksHigh, levelBlocksHigh - blockY);
+
+        std::fill(tileData.begin(), tileData.end(), 0);
+        for (uint32_t row = 0; row < copyBlocksHigh; ++row)
+        {
+            memcpy(tileData.data() + row * (size_t)tileBytesPerRow,
+                   levelData + (blockY + row) * (uint64_t)level.bytesPerRow + blockX * (uint64_t)format.bytesPerBlock,
+                   copyBlocksWide * (size_t)format.bytesPerBlock);
+        }
+
+        if (!writeFully(file, tileData.data(), tileData.size()))
+            return fail(std::string("Couldn't write ") + path);
+    }
+
+    if (fclose(file) != 0)
+    {
+        remove(path);
+        error = std::string("Couldn't write ") + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,118 @@
+/*
+See LICENSE folder for this sample’s licensing information.
+
+Abstract:
+Header for the tiled texture file, which stores each tile of each mipmap level of a
+ block-compressed texture contiguously, so that streaming a tile takes one read.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "AAPLKTXFile.h"
+
+// A tiled texture file holds a 2D texture converted offline from a KTX file:
+//
+//  - A 64-byte header with the format, size and tile size of the texture.
+//  - For each mipmap level, the number of tiles across and down and the index of its first tile.
+//  - An index table with the file offset of each tile, ordered by level, then row, then column.
+//  - The tiles, each `tileLength` bytes of block rows ordered top to bottom, and starting at a
+//     multiple of the file's alignment.  Blocks past the edge of a level are zero.
+//
+// The converter writes the tiles of each level along a Morton curve, with the coarsest level
+//  first, so that the tiles of a region are close in the file and neighbouring requests
+//  read as one.
+//
+// The reader only keeps the descriptor and the index in memory; tiles are read on request
+//  with `pread`, rather than faulted in from a mapping of the whole file.
+class AAPLTiledTextureFile
+{
+public:
+    // A tile to read, and where to read it to.  `destination` holds `tileLength()` bytes.
+    struct Request
+    {
+        uint32_t    level;
+        uint32_t    x;
+        uint32_t    y;
+        void*       destination;
+    };
+
+    // Counts of the work of `readTiles`.
+    struct ReadStats
+    {
+        uint64_t    tileCount   = 0;
+        uint64_t    readCount   = 0;    // System calls that read data.
+        uint64_t    byteCount   = 0;    // Including the padding between tiles.
+    };
+
+    // Tile offsets are aligned to the page size by default.
+    static const uint32_t DefaultAlignment = 4096;
+
+    AAPLTiledTextureFile() = default;
+    ~AAPLTiledTextureFile();
+
+    AAPLTiledTextureFile(const AAPLTiledTextureFile&) = delete;
+    AAPLTiledTextureFile& operator=(const AAPLTiledTextureFile&) = delete;
+
+    // Opens the file at `path` and reads its header and index.
+    bool open(const char* path, std::string& error);
+
+    void close();
+
+    bool                 isOpen() const             { return _fd >= 0; }
+    const AAPLKTXFormat& format() const             { return *_format; }
+    uint32_t             width() const              { return _width; }
+    uint32_t             height() const             { return _height; }
+    uint32_t             levelCount() const         { return (uint32_t)_levels.size(); }
+    uint32_t             tileWidth() const          { return _tileWidth; }
+    uint32_t             tileHeight() const         { return _tileHeight; }
+    uint32_t             tileLength() const         { return _tileLength; }
+
+    // Bytes of a row of blocks in a tile.
+    uint32_t             tileBytesPerRow() const    { return _tileWidth / _format->blockWidth * _format->bytesPerBlock; }
+
+    uint32_t             tilesWide(uint32_t level) const { return _levels[level].tilesWide; }
+    uint32_t             tilesHigh(uint32_t level) const { return _levels[level].tilesHigh; }
+
+    // Offset of a tile from the start of the file.
+    uint64_t             tileOffset(uint32_t level, uint32_t x, uint32_t y) const;
+
+    // Reads the requested tiles, reordering `requests` by file offset so that tiles adjacent
+    //  in the file are read by a single `preadv`.  Returns false if a request is out of range
+    //  or a read fails; tiles of other requests may have been read by then.
+    bool readTiles(Request* requests, size_t count, std::string& error, ReadStats* stats = nullptr);
+
+private:
+    struct Level
+    {
+        uint32_t    tilesWide;
+        uint32_t    tilesHigh;
+        uint32_t    firstTile;
+    };
+
+    int                     _fd             = -1;
+    const AAPLKTXFormat*    _format         = nullptr;
+    uint32_t                _width          = 0;
+    uint32_t                _height         = 0;
+    uint32_t                _tileWidth      = 0;
+    uint32_t                _tileHeight     = 0;
+    uint32_t                _tileLength     = 0;
+    uint32_t                _tileStride     = 0;    // Tile length rounded up to the alignment.
+
+    std::vector<Level>      _levels;
+    std::vector<uint64_t>   _tileOffsets;
+
+    // Receives the padding between tiles that a read spans.
+    std::vector<uint8_t>    _padding;
+};
+
+// Converts every level of a 2D KTX texture to a tiled texture file at `path`, with tiles of
+//  `tileWidth` x `tileHeight` pixels, which must be multiples of the format's block size.
+//  Supercompressed levels are decoded one at a time.
+bool AAPLWriteTiledTextureFile(const AAPLKTXFile& ktx, const char* path,
+                               uint32_t tileWidth, uint32_t tileHeight, std::string& error,
+                               uint32_t alignment = AAPLTiledTextureFile::DefaultAlignment);